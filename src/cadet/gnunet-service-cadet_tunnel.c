@@ -98,6 +98,16 @@ struct CadetTunnelKXCtx
    */
   struct GNUNET_CRYPTO_SymmetricSessionKey d_key_old;
 
+  /**
+   * Cipher state for @c e_key_old, NULL until first used.
+   */
+  struct GNUNET_CRYPTO_SymmetricContext *e_ctx_old;
+
+  /**
+   * Cipher state for @c d_key_old, NULL until first used.
+   */
+  struct GNUNET_CRYPTO_SymmetricContext *d_ctx_old;
+
   /**
    * Challenge to send in a ping and expect in the pong.
    */
@@ -156,6 +166,16 @@ struct CadetTunnel
    */
   struct GNUNET_CRYPTO_SymmetricSessionKey d_key;
 
+  /**
+   * Cipher state for @c e_key, NULL until first used.
+   */
+  struct GNUNET_CRYPTO_SymmetricContext *e_ctx;
+
+  /**
+   * Cipher state for @c d_key, NULL until first used.
+   */
+  struct GNUNET_CRYPTO_SymmetricContext *d_ctx;
+
   /**
    * Task to start the rekey process.
    */
@@ -572,6 +592,53 @@ t_hmac (struct CadetTunnel *t, const void *plaintext, size_t size, uint32_t iv,
 }
 
 
+/**
+ * Get the cipher state for a key, setting it up on first use.
+ *
+ * @param ctx Location of the cached cipher state for @c key.
+ * @param key Key the cipher state is for.
+ *
+ * @return Cipher state for @c key.
+ */
+static struct GNUNET_CRYPTO_SymmetricContext *
+get_cipher (struct GNUNET_CRYPTO_SymmetricContext **ctx,
+            const struct GNUNET_CRYPTO_SymmetricSessionKey *key)
+{
+  if (NULL == *ctx)
+    *ctx = GNUNET_CRYPTO_symmetric_context_create (key);
+  return *ctx;
+}
+
+
+/**
+ * Release cached cipher state, if any.
+ *
+ * @param ctx Location of the cached cipher state.
+ */
+static void
+free_cipher (struct GNUNET_CRYPTO_SymmetricContext **ctx)
+{
+  if (NULL == *ctx)
+    return;
+  GNUNET_CRYPTO_symmetric_context_destroy (*ctx);
+  *ctx = NULL;
+}
+
+
+/**
+ * Destroy a Key eXchange context along with the old keys' cipher state.
+ *
+ * @param kx_ctx Context to destroy.
+ */
+static void
+destroy_kx_ctx (struct CadetTunnelKXCtx *kx_ctx)
+{
+  free_cipher (&kx_ctx->e_ctx_old);
+  free_cipher (&kx_ctx->d_ctx_old);
+  GNUNET_free (kx_ctx);
+}
+
+
 /**
  * Encrypt data with the tunnel key.
  *
@@ -591,6 +658,7 @@ t_encrypt (struct CadetTunnel *t, void *dst, const void *src,
 {
   struct GNUNET_CRYPTO_SymmetricInitializationVector siv;
   struct GNUNET_CRYPTO_SymmetricSessionKey *e_key;
+  struct GNUNET_CRYPTO_SymmetricContext **e_ctx;
   size_t out_size;
 
   LOG (GNUNET_ERROR_TYPE_DEBUG, "  t_encrypt start\n");
@@ -608,20 +676,24 @@ t_encrypt (struct CadetTunnel *t, void *dst, const void *src,
     {
       LOG (GNUNET_ERROR_TYPE_DEBUG, "  using old key\n");
       e_key = &t->kx_ctx->e_key_old;
+      e_ctx = &t->kx_ctx->e_ctx_old;
     }
     else
     {
       LOG (GNUNET_ERROR_TYPE_DEBUG, "  using new key\n");
       e_key = &t->e_key;
+      e_ctx = &t->e_ctx;
     }
   }
   else
   {
     e_key = &t->e_key;
+    e_ctx = &t->e_ctx;
   }
   GNUNET_CRYPTO_symmetric_derive_iv (&siv, e_key, &iv, sizeof (iv), NULL);
   LOG (GNUNET_ERROR_TYPE_DEBUG, "  t_encrypt IV derived\n");
-  out_size = GNUNET_CRYPTO_symmetric_encrypt (src, size, e_key, &siv, dst);
+  out_size = GNUNET_CRYPTO_symmetric_context_encrypt (get_cipher (e_ctx, e_key),
+                                                      src, size, &siv, dst);
   LOG (GNUNET_ERROR_TYPE_DEBUG, "  t_encrypt end\n");
 
   return out_size;
@@ -632,6 +704,7 @@ t_encrypt (struct CadetTunnel *t, void *dst, const void *src,
  * Decrypt and verify data with the appropriate tunnel key.
  *
  * @param key Key to use.
+ * @param ctx Location of the cached cipher state for @c key.
  * @param dst Destination for the plaintext.
  * @param src Source of the encrypted data. Can overlap with @c dst.
  * @param size Size of the encrypted data.
@@ -641,6 +714,7 @@ t_encrypt (struct CadetTunnel *t, void *dst, const void *src,
  */
 static int
 decrypt (const struct GNUNET_CRYPTO_SymmetricSessionKey *key,
+         struct GNUNET_CRYPTO_SymmetricContext **ctx,
          void *dst, const void *src, size_t size, uint32_t iv)
 {
   struct GNUNET_CRYPTO_SymmetricInitializationVector siv;
@@ -650,7 +724,8 @@ decrypt (const struct GNUNET_CRYPTO_SymmetricSessionKey *key,
   LOG (GNUNET_ERROR_TYPE_DEBUG, "  decrypt iv\n");
   GNUNET_CRYPTO_symmetric_derive_iv (&siv, key, &iv, sizeof (iv), NULL);
   LOG (GNUNET_ERROR_TYPE_DEBUG, "  decrypt iv done\n");
-  out_size = GNUNET_CRYPTO_symmetric_decrypt (src, size, key, &siv, dst);
+  out_size = GNUNET_CRYPTO_symmetric_context_decrypt (get_cipher (ctx, key),
+                                                      src, size, &siv, dst);
   LOG (GNUNET_ERROR_TYPE_DEBUG, "  decrypt end\n");
 
   return out_size;
@@ -690,7 +765,7 @@ t_decrypt (struct CadetTunnel *t, void *dst, const void *src,
     return -1;
   }
 
-  out_size = decrypt (key, dst, src, size, iv);
+  out_size = decrypt (key, &t->d_ctx, dst, src, size, iv);
 
   return out_size;
 }
@@ -721,7 +796,7 @@ t_decrypt_and_validate (struct CadetTunnel *t,
 
   /* Try primary (newest) key */
   key = &t->d_key;
-  decrypted_size = decrypt (key, dst, src, size, iv);
+  decrypted_size = decrypt (key, &t->d_ctx, dst, src, size, iv);
   t_hmac (t, src, size, iv, GNUNET_NO, &hmac);
   if (0 == memcmp (msg_hmac, &hmac, sizeof (hmac)))
     return decrypted_size;
@@ -738,7 +813,7 @@ t_decrypt_and_validate (struct CadetTunnel *t,
 
   /* Try secondary (from previous KX period) key */
   key = &t->kx_ctx->d_key_old;
-  decrypted_size = decrypt (key, dst, src, size, iv);
+  decrypted_size = decrypt (key, &t->kx_ctx->d_ctx_old, dst, src, size, iv);
   t_hmac (t, src, size, iv, GNUNET_NO, &hmac);
   if (0 == memcmp (msg_hmac, &hmac, sizeof (hmac)))
     return decrypted_size;
@@ -810,6 +885,8 @@ create_keys (struct CadetTunnel *t)
   derive_key_material (&km, &t->peers_ephemeral_key);
   derive_symmertic (&t->e_key, &my_full_id, GCP_get_id (t->peer), &km);
   derive_symmertic (&t->d_key, GCP_get_id (t->peer), &my_full_id, &km);
+  free_cipher (&t->e_ctx);
+  free_cipher (&t->d_ctx);
 }
 
 
@@ -1262,6 +1339,10 @@ rekey_tunnel (void *cls, const struct GNUNET_SCHEDULER_TaskContext *tc)
         GNUNET_CRYPTO_random_u32 (GNUNET_CRYPTO_QUALITY_NONCE, UINT32_MAX);
     t->kx_ctx->d_key_old = t->d_key;
     t->kx_ctx->e_key_old = t->e_key;
+    t->kx_ctx->d_ctx_old = t->d_ctx;
+    t->kx_ctx->e_ctx_old = t->e_ctx;
+    t->d_ctx = NULL;
+    t->e_ctx = NULL;
     create_keys (t);
     t->kx_ctx->rekey_start_time = GNUNET_TIME_absolute_get ();
     LOG (GNUNET_ERROR_TYPE_DEBUG, "  new challenge for %s: %u\n",
@@ -1729,7 +1810,7 @@ finish_kx (void *cls, const struct GNUNET_SCHEDULER_TaskContext *tc)
   if (0 != (tc->reason & GNUNET_SCHEDULER_REASON_SHUTDOWN))
     return;
 
-  GNUNET_free (t->kx_ctx);
+  destroy_kx_ctx (t->kx_ctx);
   t->kx_ctx = NULL;
 }
 
@@ -2439,8 +2520,10 @@ GCT_destroy (struct CadetTunnel *t)
   {
     if (GNUNET_SCHEDULER_NO_TASK != t->kx_ctx->finish_task)
       GNUNET_SCHEDULER_cancel (t->kx_ctx->finish_task);
-    GNUNET_free (t->kx_ctx);
+    destroy_kx_ctx (t->kx_ctx);
   }
+  free_cipher (&t->e_ctx);
+  free_cipher (&t->d_ctx);
   GNUNET_free (t);
 }
 
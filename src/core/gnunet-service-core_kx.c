@@ -279,6 +279,16 @@ struct GSC_KeyExchangeInfo
    */
   struct GNUNET_CRYPTO_SymmetricSessionKey decrypt_key;
 
+  /**
+   * Cipher state for @e encrypt_key, NULL if not yet set up.
+   */
+  struct GNUNET_CRYPTO_SymmetricContext *encrypt_ctx;
+
+  /**
+   * Cipher state for @e decrypt_key, NULL if not yet set up.
+   */
+  struct GNUNET_CRYPTO_SymmetricContext *decrypt_ctx;
+
   /**
    * At what time did the other peer generate the decryption key?
    */
@@ -522,6 +532,28 @@ derive_aes_key (const struct GNUNET_PeerIdentity *sender,
 }
 
 
+/**
+ * Release the cipher state of @a kx, to be called whenever the
+ * session keys change or the key exchange ends.
+ *
+ * @param kx key exchange context
+ */
+static void
+free_cipher_contexts (struct GSC_KeyExchangeInfo *kx)
+{
+  if (NULL != kx->encrypt_ctx)
+  {
+    GNUNET_CRYPTO_symmetric_context_destroy (kx->encrypt_ctx);
+    kx->encrypt_ctx = NULL;
+  }
+  if (NULL != kx->decrypt_ctx)
+  {
+    GNUNET_CRYPTO_symmetric_context_destroy (kx->decrypt_ctx);
+    kx->decrypt_ctx = NULL;
+  }
+}
+
+
 /**
  * Encrypt size bytes from @a in and write the result to @a out.  Use the
  * @a kx key for outbound traffic of the given neighbour.
@@ -543,9 +575,12 @@ do_encrypt (struct GSC_KeyExchangeInfo *kx,
     GNUNET_break (0);
     return GNUNET_NO;
   }
+  if (NULL == kx->encrypt_ctx)
+    kx->encrypt_ctx = GNUNET_CRYPTO_symmetric_context_create (&kx->encrypt_key);
   GNUNET_assert (size ==
-                 GNUNET_CRYPTO_symmetric_encrypt (in, (uint16_t) size,
-                                            &kx->encrypt_key, iv, out));
+                 GNUNET_CRYPTO_symmetric_context_encrypt (kx->encrypt_ctx,
+                                                          in, (uint16_t) size,
+                                                          iv, out));
   GNUNET_STATISTICS_update (GSC_stats, gettext_noop ("# bytes encrypted"), size,
                             GNUNET_NO);
   /* the following is too sensitive to write to log files by accident,
@@ -591,9 +626,12 @@ do_decrypt (struct GSC_KeyExchangeInfo *kx,
     GNUNET_break_op (0);
     return GNUNET_SYSERR;
   }
+  if (NULL == kx->decrypt_ctx)
+    kx->decrypt_ctx = GNUNET_CRYPTO_symmetric_context_create (&kx->decrypt_key);
   if (size !=
-      GNUNET_CRYPTO_symmetric_decrypt (in, (uint16_t) size, &kx->decrypt_key, iv,
-                                 out))
+      GNUNET_CRYPTO_symmetric_context_decrypt (kx->decrypt_ctx,
+                                               in, (uint16_t) size,
+                                               iv, out))
   {
     GNUNET_break (0);
     return GNUNET_SYSERR;
@@ -746,6 +784,7 @@ GSC_KX_stop (struct GSC_KeyExchangeInfo *kx)
   GNUNET_CONTAINER_DLL_remove (kx_head,
 			       kx_tail,
 			       kx);
+  free_cipher_contexts (kx);
   GNUNET_free (kx);
 }
 
@@ -789,6 +828,7 @@ derive_session_keys (struct GSC_KeyExchangeInfo *kx)
 		  &GSC_my_identity,
 		  &key_material,
 		  &kx->decrypt_key);
+  free_cipher_contexts (kx);
   memset (&key_material, 0, sizeof (key_material));
   /* fresh key, reset sequence numbers */
   kx->last_sequence_number_received = 0;
@@ -66,6 +66,7 @@ run (void *cls, char *const *args, const char *cfgfile,
   struct GNUNET_HashCode n;
   struct GNUNET_TIME_Absolute exp;
   struct GNUNET_TIME_Absolute start;
+  struct GNUNET_TIME_Relative delay;
   unsigned int i;
   char gstr[128];
 
@@ -92,8 +93,10 @@ run (void *cls, char *const *args, const char *cfgfile,
     k = n;
   }
   FPRINTF (stderr, "%s",  "\n");
-  FPRINTF (stdout, "Stored %u items in %s\n", ITERATIONS,
-	   GNUNET_STRINGS_relative_time_to_string (GNUNET_TIME_absolute_get_duration (start), GNUNET_YES));
+  delay = GNUNET_TIME_absolute_get_duration (start);
+  FPRINTF (stdout, "Stored %u items in %s (%llu ops/s)\n", ITERATIONS,
+	   GNUNET_STRINGS_relative_time_to_string (delay, GNUNET_YES),
+           ITERATIONS * 1000LL * 1000LL / (1 + delay.rel_value_us));
   GNUNET_snprintf (gstr, sizeof (gstr), "DATACACHE-%s", plugin_name);
   GAUGER (gstr, "Time to PUT item in datacache",
           GNUNET_TIME_absolute_get_duration (start).rel_value_us / 1000LL / ITERATIONS,
@@ -109,10 +112,12 @@ run (void *cls, char *const *args, const char *cfgfile,
     k = n;
   }
   FPRINTF (stderr, "%s",  "\n");
+  delay = GNUNET_TIME_absolute_get_duration (start);
   FPRINTF (stdout,
-           "Found %u/%u items in %s (%u were deleted during storage processing)\n",
+           "Found %u/%u items in %s (%llu ops/s, %u were deleted during storage processing)\n",
            found, ITERATIONS,
-           GNUNET_STRINGS_relative_time_to_string (GNUNET_TIME_absolute_get_duration (start), GNUNET_YES),
+           GNUNET_STRINGS_relative_time_to_string (delay, GNUNET_YES),
+           ITERATIONS * 1000LL * 1000LL / (1 + delay.rel_value_us),
            ITERATIONS - found);
   if (found > 0)
     GAUGER (gstr, "Time to GET item from datacache",
@@ -0,0 +1,544 @@
+/*
+     This file is part of GNUnet
+     (C) 2014 Christian Grothoff (and other contributing authors)
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+     Boston, MA 02111-1307, USA.
+*/
+
+/**
+ * @file datacache/plugin_datacache_arena.c
+ * @brief in-memory datacache backend using a slot arena, an
+ *        open-addressed index and CLOCK eviction
+ *
+ * All entry headers live in one contiguous array of slots; freed
+ * slots are chained into a free list and reused by the next PUT.
+ * The index is a linear-probing hash table of slot numbers keyed by
+ * the first word of the (already uniformly distributed) hash code,
+ * kept at most half full.  Eviction is a CLOCK sweep over the slots:
+ * a GET marks an entry as referenced, and the hand gives referenced
+ * entries a second chance while evicting expired ones immediately.
+ */
+#include "platform.h"
+#include "gnunet_util_lib.h"
+#include "gnunet_datacache_plugin.h"
+
+#define LOG(kind,...) GNUNET_log_from (kind, "datacache-arena", __VA_ARGS__)
+
+/**
+ * Marker for an unused cell in the index (and the end of the
+ * free list).
+ */
+#define EMPTY UINT32_MAX
+
+/**
+ * Initial number of slots in the arena (and half the initial
+ * number of cells in the index).
+ */
+#define INITIAL_SLOTS 1024
+
+
+/**
+ * Slot in the arena.
+ */
+struct Entry
+{
+  /**
+   * Key for the entry.
+   */
+  struct GNUNET_HashCode key;
+
+  /**
+   * Expiration time.
+   */
+  struct GNUNET_TIME_Absolute discard_time;
+
+  /**
+   * Payload followed by room for @e path_info_cap path entries;
+   * NULL if the slot is free.
+   */
+  char *data;
+
+  /**
+   * Number of bytes of payload in @e data.
+   */
+  size_t size;
+
+  /**
+   * Number of bytes charged against the quota for this entry.
+   */
+  size_t used;
+
+  /**
+   * Number of valid path entries after the payload.
+   */
+  unsigned int path_info_len;
+
+  /**
+   * Number of path entries that fit after the payload.
+   */
+  unsigned int path_info_cap;
+
+  /**
+   * Type of the block.
+   */
+  enum GNUNET_BLOCK_Type type;
+
+  /**
+   * Next free slot if this slot is free, otherwise #EMPTY.
+   */
+  uint32_t next_free;
+
+  /**
+   * #GNUNET_YES if the entry was used since the clock hand
+   * last passed it.
+   */
+  int referenced;
+};
+
+
+/**
+ * Context for all functions in this plugin.
+ */
+struct Plugin
+{
+  /**
+   * Our execution environment.
+   */
+  struct GNUNET_DATACACHE_PluginEnvironment *env;
+
+  /**
+   * Arena of entries, @e slots_size long, of which the first
+   * @e slots_used have ever been handed out.
+   */
+  struct Entry *slots;
+
+  /**
+   * Open-addressed index mapping keys to slot numbers,
+   * @e index_size cells (a power of two).
+   */
+  uint32_t *index;
+
+  /**
+   * Number of slots allocated in @e slots.
+   */
+  uint32_t slots_size;
+
+  /**
+   * High-water mark of slots in use.
+   */
+  uint32_t slots_used;
+
+  /**
+   * Head of the list of free slots below @e slots_used.
+   */
+  uint32_t free_head;
+
+  /**
+   * Number of cells in @e index.
+   */
+  uint32_t index_size;
+
+  /**
+   * Number of entries currently stored.
+   */
+  uint32_t count;
+
+  /**
+   * Position of the clock hand in @e slots.
+   */
+  uint32_t hand;
+
+};
+
+
+/**
+ * Compute the home cell of @a key in the index.
+ *
+ * @param plugin the plugin
+ * @param key key to look up
+ * @return cell where probing for @a key starts
+ */
+static uint32_t
+home_cell (const struct Plugin *plugin,
+           const struct GNUNET_HashCode *key)
+{
+  return key->bits[0] & (plugin->index_size - 1);
+}
+
+
+/**
+ * Add @a slot to the index.  There must be a free cell.
+ *
+ * @param plugin the plugin
+ * @param slot slot to index
+ */
+static void
+index_insert (struct Plugin *plugin,
+              uint32_t slot)
+{
+  uint32_t mask = plugin->index_size - 1;
+  uint32_t pos;
+
+  pos = home_cell (plugin, &plugin->slots[slot].key);
+  while (EMPTY != plugin->index[pos])
+    pos = (pos + 1) & mask;
+  plugin->index[pos] = slot;
+}
+
+
+/**
+ * Remove @a slot from the index, shifting later members of the
+ * probe sequence back so that lookups never need tombstones.
+ *
+ * @param plugin the plugin
+ * @param slot slot to remove
+ */
+static void
+index_remove (struct Plugin *plugin,
+              uint32_t slot)
+{
+  uint32_t mask = plugin->index_size - 1;
+  uint32_t hole;
+  uint32_t pos;
+  uint32_t home;
+
+  hole = home_cell (plugin, &plugin->slots[slot].key);
+  while (slot != plugin->index[hole])
+  {
+    GNUNET_assert (EMPTY != plugin->index[hole]);
+    hole = (hole + 1) & mask;
+  }
+  pos = hole;
+  while (1)
+  {
+    pos = (pos + 1) & mask;
+    if (EMPTY == plugin->index[pos])
+      break;
+    home = home_cell (plugin, &plugin->slots[plugin->index[pos]].key);
+    /* move the cell into the hole unless its home lies cyclically
+       in (hole, pos] */
+    if ( (hole <= pos)
+         ? ( (home <= hole) || (home > pos) )
+         : ( (home <= hole) && (home > pos) ) )
+    {
+      plugin->index[hole] = plugin->index[pos];
+      hole = pos;
+    }
+  }
+  plugin->index[hole] = EMPTY;
+}
+
+
+/**
+ * Double the size of the index and re-insert all entries.
+ *
+ * @param plugin the plugin
+ */
+static void
+index_grow (struct Plugin *plugin)
+{
+  uint32_t i;
+
+  GNUNET_free (plugin->index);
+  plugin->index_size *= 2;
+  plugin->index = GNUNET_malloc (plugin->index_size * sizeof (uint32_t));
+  memset (plugin->index, 0xFF, plugin->index_size * sizeof (uint32_t));
+  for (i = 0; i < plugin->slots_used; i++)
+    if (NULL != plugin->slots[i].data)
+      index_insert (plugin, i);
+}
+
+
+/**
+ * Obtain a free slot, growing the arena if necessary.
+ *
+ * @param plugin the plugin
+ * @return number of the slot
+ */
+static uint32_t
+slot_alloc (struct Plugin *plugin)
+{
+  uint32_t slot;
+
+  if (EMPTY != plugin->free_head)
+  {
+    slot = plugin->free_head;
+    plugin->free_head = plugin->slots[slot].next_free;
+    return slot;
+  }
+  if (plugin->slots_used == plugin->slots_size)
+    GNUNET_array_grow (plugin->slots,
+                       plugin->slots_size,
+                       plugin->slots_size * 2);
+  return plugin->slots_used++;
+}
+
+
+/**
+ * Remove the entry in @a slot from the index and release its
+ * memory, notifying the datacache about the freed space.
+ *
+ * @param plugin the plugin
+ * @param slot slot to free
+ */
+static void
+slot_free (struct Plugin *plugin,
+           uint32_t slot)
+{
+  struct Entry *e = &plugin->slots[slot];
+
+  index_remove (plugin, slot);
+  plugin->env->delete_notify (plugin->env->cls,
+                              &e->key,
+                              e->used);
+  GNUNET_free (e->data);
+  e->data = NULL;
+  e->next_free = plugin->free_head;
+  plugin->free_head = slot;
+  plugin->count--;
+}
+
+
+/**
+ * Store an item in the datastore.
+ *
+ * @param cls closure (our `struct Plugin`)
+ * @param key key to store data under
+ * @param size number of bytes in @a data
+ * @param data data to store
+ * @param type type of the value
+ * @param discard_time when to discard the value in any case
+ * @param path_info_len number of entries in @a path_info
+ * @param path_info a path through the network
+ * @return 0 if duplicate, -1 on error, number of bytes used otherwise
+ */
+static ssize_t
+arena_plugin_put (void *cls,
+                  const struct GNUNET_HashCode *key,
+                  size_t size,
+                  const char *data,
+                  enum GNUNET_BLOCK_Type type,
+                  struct GNUNET_TIME_Absolute discard_time,
+                  unsigned int path_info_len,
+                  const struct GNUNET_PeerIdentity *path_info)
+{
+  struct Plugin *plugin = cls;
+  struct Entry *e;
+  uint32_t mask = plugin->index_size - 1;
+  uint32_t pos;
+  uint32_t slot;
+  size_t path_size;
+
+  path_size = path_info_len * sizeof (struct GNUNET_PeerIdentity);
+  for (pos = home_cell (plugin, key);
+       EMPTY != plugin->index[pos];
+       pos = (pos + 1) & mask)
+  {
+    e = &plugin->slots[plugin->index[pos]];
+    if ( (e->size != size) ||
+         (e->type != type) ||
+         (0 != memcmp (key, &e->key, sizeof (struct GNUNET_HashCode))) ||
+         (0 != memcmp (e->data, data, size)) )
+      continue;
+    e->discard_time = GNUNET_TIME_absolute_max (e->discard_time,
+                                                discard_time);
+    /* replace old path with new path if it fits the allocation;
+       the space charged for the entry must not change */
+    if (path_info_len <= e->path_info_cap)
+    {
+      memcpy (&e->data[size], path_info, path_size);
+      e->path_info_len = path_info_len;
+    }
+    LOG (GNUNET_ERROR_TYPE_DEBUG,
+         "Got same value for key %s and type %d (size %u)\n",
+         GNUNET_h2s (key),
+         type,
+         (unsigned int) size);
+    return 0;
+  }
+  if (2 * (plugin->count + 1) > plugin->index_size)
+    index_grow (plugin);
+  slot = slot_alloc (plugin);
+  e = &plugin->slots[slot];
+  e->key = *key;
+  e->discard_time = discard_time;
+  e->data = GNUNET_malloc (size + path_size);
+  memcpy (e->data, data, size);
+  memcpy (&e->data[size], path_info, path_size);
+  e->size = size;
+  e->path_info_len = path_info_len;
+  e->path_info_cap = path_info_len;
+  e->type = type;
+  e->next_free = EMPTY;
+  e->referenced = GNUNET_YES;
+  /* slot header plus the two index cells it may occupy */
+  e->used = sizeof (struct Entry) + 2 * sizeof (uint32_t) + size + path_size;
+  index_insert (plugin, slot);
+  plugin->count++;
+  return e->used;
+}
+
+
+/**
+ * Iterate over the results for a particular key
+ * in the datastore.
+ *
+ * @param cls closure (our `struct Plugin`)
+ * @param key key to look for
+ * @param type entries of which type are relevant?
+ * @param iter maybe NULL (to just count)
+ * @param iter_cls closure for @a iter
+ * @return the number of results found
+ */
+static unsigned int
+arena_plugin_get (void *cls,
+                  const struct GNUNET_HashCode *key,
+                  enum GNUNET_BLOCK_Type type,
+                  GNUNET_DATACACHE_Iterator iter,
+                  void *iter_cls)
+{
+  struct Plugin *plugin = cls;
+  struct Entry *e;
+  uint32_t mask = plugin->index_size - 1;
+  uint32_t pos;
+  unsigned int cnt;
+
+  cnt = 0;
+  for (pos = home_cell (plugin, key);
+       EMPTY != plugin->index[pos];
+       pos = (pos + 1) & mask)
+  {
+    e = &plugin->slots[plugin->index[pos]];
+    if (0 != memcmp (key, &e->key, sizeof (struct GNUNET_HashCode)))
+      continue;
+    if ( (type != e->type) &&
+         (GNUNET_BLOCK_TYPE_ANY != type) )
+      continue;
+    e->referenced = GNUNET_YES;
+    cnt++;
+    if ( (NULL != iter) &&
+         (GNUNET_OK != iter (iter_cls,
+                             key,
+                             e->size,
+                             e->data,
+                             e->type,
+                             e->discard_time,
+                             e->path_info_len,
+                             (const struct GNUNET_PeerIdentity *) &e->data[e->size])) )
+      break;
+  }
+  return cnt;
+}
+
+
+/**
+ * Delete one entry from the datacache right now: advance the clock
+ * hand to the next entry that is expired or was not referenced
+ * since the hand last passed it.
+ *
+ * @param cls closure (our `struct Plugin`)
+ * @return #GNUNET_OK on success, #GNUNET_SYSERR on error
+ */
+static int
+arena_plugin_del (void *cls)
+{
+  struct Plugin *plugin = cls;
+  struct GNUNET_TIME_Absolute now;
+  struct Entry *e;
+  uint32_t slot;
+
+  if (0 == plugin->count)
+    return GNUNET_SYSERR;
+  now = GNUNET_TIME_absolute_get ();
+  /* terminates within two sweeps: the first clears all flags */
+  while (1)
+  {
+    if (plugin->hand >= plugin->slots_used)
+      plugin->hand = 0;
+    slot = plugin->hand++;
+    e = &plugin->slots[slot];
+    if (NULL == e->data)
+      continue;
+    if ( (GNUNET_YES == e->referenced) &&
+         (e->discard_time.abs_value_us > now.abs_value_us) )
+    {
+      e->referenced = GNUNET_NO;
+      continue;
+    }
+    slot_free (plugin, slot);
+    return GNUNET_OK;
+  }
+}
+
+
+/**
+ * Entry point for the plugin.
+ *
+ * @param cls closure (the `struct GNUNET_DATACACHE_PluginEnvironmnet`)
+ * @return the plugin's closure (our `struct Plugin`)
+ */
+void *
+libgnunet_plugin_datacache_arena_init (void *cls)
+{
+  struct GNUNET_DATACACHE_PluginEnvironment *env = cls;
+  struct GNUNET_DATACACHE_PluginFunctions *api;
+  struct Plugin *plugin;
+
+  plugin = GNUNET_new (struct Plugin);
+  plugin->env = env;
+  GNUNET_array_grow (plugin->slots,
+                     plugin->slots_size,
+                     INITIAL_SLOTS);
+  plugin->index_size = 2 * INITIAL_SLOTS;
+  plugin->index = GNUNET_malloc (plugin->index_size * sizeof (uint32_t));
+  memset (plugin->index, 0xFF, plugin->index_size * sizeof (uint32_t));
+  plugin->free_head = EMPTY;
+  api = GNUNET_new (struct GNUNET_DATACACHE_PluginFunctions);
+  api->cls = plugin;
+  api->get = &arena_plugin_get;
+  api->put = &arena_plugin_put;
+  api->del = &arena_plugin_del;
+  LOG (GNUNET_ERROR_TYPE_INFO, _("Arena datacache running\n"));
+  return api;
+}
+
+
+/**
+ * Exit point from the plugin.
+ *
+ * @param cls closure (our `struct Plugin`)
+ * @return NULL
+ */
+void *
+libgnunet_plugin_datacache_arena_done (void *cls)
+{
+  struct GNUNET_DATACACHE_PluginFunctions *api = cls;
+  struct Plugin *plugin = api->cls;
+  uint32_t i;
+
+  for (i = 0; i < plugin->slots_used; i++)
+    GNUNET_free_non_null (plugin->slots[i].data);
+  GNUNET_array_grow (plugin->slots,
+                     plugin->slots_size,
+                     0);
+  GNUNET_free (plugin->index);
+  GNUNET_free (plugin);
+  GNUNET_free (api);
+  return NULL;
+}
+
+
+/* end of plugin_datacache_arena.c */
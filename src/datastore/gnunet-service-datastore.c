@@ -59,6 +59,49 @@ static char *quota_stat_name;
  */
 #define MAX_STAT_SYNC_LAG 50
 
+/**
+ * Magic number of a `struct BloomfilterStamp` ("DSBF").
+ */
+#define BF_STAMP_MAGIC 0x44534246
+
+
+GNUNET_NETWORK_STRUCT_BEGIN
+
+/**
+ * Written next to the bloomfilter file on a clean shutdown, to record
+ * that the filter matches the database.  The stamp is removed at
+ * startup, so after a crash there is none and the filter is rebuilt.
+ */
+struct BloomfilterStamp
+{
+  /**
+   * #BF_STAMP_MAGIC, in NBO.
+   */
+  uint32_t magic GNUNET_PACKED;
+
+  /**
+   * CRC32 of the bits of the filter, in NBO.
+   */
+  uint32_t crc GNUNET_PACKED;
+
+  /**
+   * How often the filter was saved, in NBO.
+   */
+  uint64_t generation GNUNET_PACKED;
+
+  /**
+   * Payload of the database when the filter was saved, in NBO.
+   */
+  uint64_t payload GNUNET_PACKED;
+
+  /**
+   * Size of the filter in bytes, in NBO.
+   */
+  uint64_t bf_size GNUNET_PACKED;
+};
+
+GNUNET_NETWORK_STRUCT_END
+
 
 /**
  * Our datastore plugin.
@@ -141,6 +184,17 @@ static struct ReservationList *reservations;
  */
 static struct GNUNET_CONTAINER_BloomFilter *filter;
 
+/**
+ * Name of the `struct BloomfilterStamp` file of our bloomfilter,
+ * NULL if the bloomfilter is not stored in a file.
+ */
+static char *bf_stamp_fn;
+
+/**
+ * Generation of our bloomfilter, from its stamp.
+ */
+static uint64_t bf_generation;
+
 /**
  * How much space are we allowed to use?
  */
@@ -1265,6 +1319,112 @@ process_stat_done (void *cls, int success)
 }
 
 
+/**
+ * Compute the checksum of the bits of our bloomfilter.
+ *
+ * @param crc set to the checksum
+ * @return #GNUNET_OK on success, #GNUNET_SYSERR if we are out of memory
+ */
+static int
+bf_checksum (uint32_t *crc)
+{
+  size_t size;
+  char *data;
+
+  size = GNUNET_CONTAINER_bloomfilter_get_size (filter);
+  data = GNUNET_malloc_large (size);
+  if (NULL == data)
+    return GNUNET_SYSERR;
+  GNUNET_assert (GNUNET_OK ==
+                 GNUNET_CONTAINER_bloomfilter_get_raw_data (filter, data, size));
+  *crc = (uint32_t) GNUNET_CRYPTO_crc32_n (data, size);
+  GNUNET_free (data);
+  return GNUNET_OK;
+}
+
+
+/**
+ * Check if the stamp of our bloomfilter says that it matches the
+ * database.  If so, take the payload of the database from the stamp.
+ *
+ * @return #GNUNET_YES if the bloomfilter can be used as it is,
+ *         #GNUNET_NO if it must be rebuilt
+ */
+static int
+load_bf_stamp ()
+{
+  struct BloomfilterStamp stamp;
+  uint32_t crc;
+
+  if ( (GNUNET_YES != GNUNET_DISK_file_test (bf_stamp_fn)) ||
+       (sizeof (stamp) !=
+        GNUNET_DISK_fn_read (bf_stamp_fn, &stamp, sizeof (stamp))) )
+    return GNUNET_NO;
+  if ( (BF_STAMP_MAGIC != ntohl (stamp.magic)) ||
+       (GNUNET_CONTAINER_bloomfilter_get_size (filter) !=
+        GNUNET_ntohll (stamp.bf_size)) ||
+       (GNUNET_OK != bf_checksum (&crc)) ||
+       (crc != ntohl (stamp.crc)) )
+    return GNUNET_NO;
+  bf_generation = GNUNET_ntohll (stamp.generation);
+  payload = GNUNET_ntohll (stamp.payload);
+  stats_worked = GNUNET_YES;
+  GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
+              "Using bloomfilter generation %llu, payload is %llu\n",
+              (unsigned long long) bf_generation,
+              payload);
+  return GNUNET_YES;
+}
+
+
+/**
+ * Record that our bloomfilter matches the database.  The stamp is
+ * written to a temporary file first and then renamed, so that it is
+ * either complete or missing.
+ *
+ * @param crc checksum of the bits of the filter
+ * @param bf_size size of the filter in bytes
+ */
+static void
+save_bf_stamp (uint32_t crc,
+               size_t bf_size)
+{
+  struct BloomfilterStamp stamp;
+  struct GNUNET_DISK_FileHandle *fh;
+  char *tmp_fn;
+  int ok;
+
+  stamp.magic = htonl (BF_STAMP_MAGIC);
+  stamp.crc = htonl (crc);
+  stamp.generation = GNUNET_htonll (bf_generation + 1);
+  stamp.payload = GNUNET_htonll (payload);
+  stamp.bf_size = GNUNET_htonll (bf_size);
+  GNUNET_asprintf (&tmp_fn, "%s.tmp", bf_stamp_fn);
+  fh = GNUNET_DISK_file_open (tmp_fn,
+                              GNUNET_DISK_OPEN_WRITE |
+                              GNUNET_DISK_OPEN_CREATE |
+                              GNUNET_DISK_OPEN_TRUNCATE,
+                              GNUNET_DISK_PERM_USER_READ |
+                              GNUNET_DISK_PERM_USER_WRITE);
+  if (NULL == fh)
+  {
+    GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_WARNING, "open", tmp_fn);
+    GNUNET_free (tmp_fn);
+    return;
+  }
+  ok = ( (sizeof (stamp) == GNUNET_DISK_file_write (fh, &stamp, sizeof (stamp))) &&
+         (GNUNET_OK == GNUNET_DISK_file_sync (fh)) );
+  GNUNET_break (GNUNET_OK == GNUNET_DISK_file_close (fh));
+  if ( (! ok) ||
+       (0 != RENAME (tmp_fn, bf_stamp_fn)) )
+  {
+    GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_WARNING, "rename", tmp_fn);
+    (void) UNLINK (tmp_fn);
+  }
+  GNUNET_free (tmp_fn);
+}
+
+
 /**
  * Load the datastore plugin.
  */
@@ -1324,6 +1484,10 @@ unload_plugin (struct DatastorePlugin *plug)
 static void
 unload_task (void *cls, const struct GNUNET_SCHEDULER_TaskContext *tc)
 {
+  uint32_t crc;
+  size_t bf_size;
+  int save_bf;
+
   if (lastSync > 0)
     sync_stats ();
   if (GNUNET_YES == do_drop)
@@ -1332,9 +1496,20 @@ unload_task (void *cls, const struct GNUNET_SCHEDULER_TaskContext *tc)
   plugin = NULL;
   if (filter != NULL)
   {
+    /* only vouch for the filter if we know the payload that goes with it */
+    save_bf = ( (NULL != bf_stamp_fn) &&
+                (GNUNET_NO == do_drop) &&
+                (NULL == stat_get) &&
+                (GNUNET_OK == bf_checksum (&crc)) );
+    bf_size = GNUNET_CONTAINER_bloomfilter_get_size (filter);
+    /* freeing the filter flushes its file */
     GNUNET_CONTAINER_bloomfilter_free (filter);
     filter = NULL;
+    if (save_bf)
+      save_bf_stamp (crc, bf_size);
   }
+  GNUNET_free_non_null (bf_stamp_fn);
+  bf_stamp_fn = NULL;
   if (stat_get != NULL)
   {
     GNUNET_STATISTICS_get_cancel (stat_get);
@@ -1568,6 +1743,8 @@ run (void *cls, struct GNUNET_SERVER_Handle *server,
       filter = GNUNET_CONTAINER_bloomfilter_load (pfn, bf_size, 5);        /* approx. 3% false positives at max use */
       refresh_bf = GNUNET_YES;
     }
+    if (NULL != pfn)
+      GNUNET_asprintf (&bf_stamp_fn, "%s.stamp", pfn);
     GNUNET_free (pfn);
   }
   else
@@ -1580,6 +1757,8 @@ run (void *cls, struct GNUNET_SERVER_Handle *server,
   {
     GNUNET_log (GNUNET_ERROR_TYPE_ERROR,
                 _("Failed to initialize bloomfilter.\n"));
+    GNUNET_free_non_null (bf_stamp_fn);
+    bf_stamp_fn = NULL;
     if (stats != NULL)
     {
       GNUNET_STATISTICS_destroy (stats, GNUNET_YES);
@@ -1592,6 +1771,8 @@ run (void *cls, struct GNUNET_SERVER_Handle *server,
   {
     GNUNET_CONTAINER_bloomfilter_free (filter);
     filter = NULL;
+    GNUNET_free_non_null (bf_stamp_fn);
+    bf_stamp_fn = NULL;
     if (stats != NULL)
     {
       GNUNET_STATISTICS_destroy (stats, GNUNET_YES);
@@ -1599,7 +1780,26 @@ run (void *cls, struct GNUNET_SERVER_Handle *server,
     }
     return;
   }
-  stat_get =
+  if (NULL != bf_stamp_fn)
+  {
+    if ( (GNUNET_NO == refresh_bf) &&
+         (GNUNET_YES != load_bf_stamp ()) )
+    {
+      GNUNET_log (GNUNET_ERROR_TYPE_WARNING,
+                  _("Datastore was not shut down cleanly, bloomfilter is stale.\n"));
+      GNUNET_CONTAINER_bloomfilter_clear (filter);
+      refresh_bf = GNUNET_YES;
+    }
+    /* from now on the filter may diverge from the database until
+       we shut down cleanly */
+    if ( (0 != UNLINK (bf_stamp_fn)) &&
+         (ENOENT != errno) )
+      GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_WARNING, "unlink", bf_stamp_fn);
+  }
+  if (GNUNET_YES == stats_worked)
+    sync_stats ();
+  else
+    stat_get =
       GNUNET_STATISTICS_get (stats, "datastore", quota_stat_name,
                              GNUNET_TIME_UNIT_SECONDS, &process_stat_done,
                              &process_stat_in, plugin);
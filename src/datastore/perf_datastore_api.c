@@ -30,6 +30,9 @@
  * inserted and a "D" for every 40 blocks deleted.  The deletion
  * strategy uses the "random" iterator.  Priorities and expiration
  * dates are set using a pseudo-random value within a realistic range.
+ * Finally, the peer is restarted twice to measure how long the
+ * datastore takes to start with a cleanly saved bloomfilter and with
+ * one that must be rebuilt (as after a crash).
  */
 
 #include "platform.h"
@@ -80,6 +83,8 @@ static const char *plugin_name;
 
 static struct GNUNET_DATASTORE_Handle *datastore;
 
+static struct GNUNET_TESTING_Peer *peer;
+
 static int ok;
 
 
@@ -89,6 +94,8 @@ enum RunPhase
   RP_PUT,
   RP_CUT,
   RP_REPORT,
+  RP_RESTART_CLEAN,
+  RP_RESTART_CRASH,
   RP_ERROR
 };
 
@@ -107,6 +114,85 @@ static void
 run_continuation (void *cls, const struct GNUNET_SCHEDULER_TaskContext *tc);
 
 
+/**
+ * The restarted datastore answered our first request, report how
+ * long the restart took.
+ *
+ * @param cls our `struct CpsRunContext`
+ * @param key NULL (we ask for a key that is not stored)
+ * @param size 0
+ * @param data NULL
+ * @param type 0
+ * @param priority 0
+ * @param anonymity 0
+ * @param expiration zero
+ * @param uid 0
+ */
+static void
+restart_done (void *cls, const struct GNUNET_HashCode * key, size_t size,
+              const void *data, enum GNUNET_BLOCK_Type type, uint32_t priority,
+              uint32_t anonymity, struct GNUNET_TIME_Absolute expiration,
+              uint64_t uid)
+{
+  struct CpsRunContext *crc = cls;
+  struct GNUNET_TIME_Relative duration;
+  const char *what;
+  char gstr[128];
+
+  duration = GNUNET_TIME_absolute_get_duration (start_time);
+  what = (RP_RESTART_CLEAN == crc->phase)
+    ? "Datastore restart (saved bloomfilter)"
+    : "Datastore restart (rebuilt bloomfilter)";
+  printf ("\n%s took %s\n",
+          what,
+          GNUNET_STRINGS_relative_time_to_string (duration, GNUNET_YES));
+  GNUNET_snprintf (gstr, sizeof (gstr), "DATASTORE-%s", plugin_name);
+  GAUGER (gstr, what, duration.rel_value_us / 1000LL, "ms");
+  crc->phase = (RP_RESTART_CLEAN == crc->phase) ? RP_RESTART_CRASH : RP_DONE;
+  GNUNET_SCHEDULER_add_now (&run_continuation, crc);
+}
+
+
+/**
+ * Restart the peer and ask the datastore for a key it does not
+ * have, which it can only answer once it is fully up.
+ *
+ * @param crc our context
+ * @param stale #GNUNET_YES to remove the bloomfilter stamp first,
+ *        as if the datastore had crashed
+ */
+static void
+restart_datastore (struct CpsRunContext *crc,
+                   int stale)
+{
+  static struct GNUNET_HashCode missing;
+  char *fn;
+
+  GNUNET_DATASTORE_disconnect (datastore, GNUNET_NO);
+  GNUNET_assert (GNUNET_OK == GNUNET_TESTING_peer_stop (peer));
+  if ( (GNUNET_YES == stale) &&
+       (GNUNET_OK ==
+        GNUNET_CONFIGURATION_get_value_filename (crc->cfg, "DATASTORE",
+                                                 "BLOOMFILTER", &fn)) )
+  {
+    char *stamp_fn;
+
+    GNUNET_asprintf (&stamp_fn, "%s.%s.stamp", fn, plugin_name);
+    (void) UNLINK (stamp_fn);
+    GNUNET_free (stamp_fn);
+    GNUNET_free (fn);
+  }
+  GNUNET_assert (GNUNET_OK == GNUNET_TESTING_peer_start (peer));
+  datastore = GNUNET_DATASTORE_connect (crc->cfg);
+  memset (&missing, 42, sizeof (missing));
+  start_time = GNUNET_TIME_absolute_get ();
+  GNUNET_assert (NULL !=
+                 GNUNET_DATASTORE_get_key (datastore, 0, &missing,
+                                           GNUNET_BLOCK_TYPE_ANY, 0, 1,
+                                           TIMEOUT, &restart_done, crc));
+}
+
+
 static void
 check_success (void *cls, int success, struct GNUNET_TIME_Absolute min_expiration,  const char *msg)
 {
@@ -131,7 +217,7 @@ check_success (void *cls, int success, struct GNUNET_TIME_Absolute min_expiratio
     crc->j = 0;
     crc->i++;
     if (crc->i == ITERATIONS)
-      crc->phase = RP_DONE;
+      crc->phase = RP_RESTART_CLEAN;
     else
       crc->phase = RP_CUT;
   }
@@ -253,12 +339,18 @@ run_continuation (void *cls, const struct GNUNET_SCHEDULER_TaskContext *tc)
     GNUNET_SCHEDULER_add_continuation (&run_continuation, crc,
                                        GNUNET_SCHEDULER_REASON_PREREQ_DONE);
     break;
-  case RP_DONE:
+  case RP_RESTART_CLEAN:
     GNUNET_snprintf (gstr, sizeof (gstr), "DATASTORE-%s", plugin_name);
     if ((crc->i == ITERATIONS) && (stored_ops > 0))
       GAUGER (gstr, "PUT operation duration",
               GNUNET_TIME_absolute_get_duration (start_time).rel_value_us / 1000LL /
               stored_ops, "ms/operation");
+    restart_datastore (crc, GNUNET_NO);
+    break;
+  case RP_RESTART_CRASH:
+    restart_datastore (crc, GNUNET_YES);
+    break;
+  case RP_DONE:
     GNUNET_DATASTORE_disconnect (datastore, GNUNET_YES);
     GNUNET_free (crc);
     ok = 0;
@@ -296,11 +388,12 @@ run_tests (void *cls, int success, struct GNUNET_TIME_Absolute min_expiration, c
 static void
 run (void *cls,
      const struct GNUNET_CONFIGURATION_Handle *cfg,
-     struct GNUNET_TESTING_Peer *peer)
+     struct GNUNET_TESTING_Peer *p)
 {
   struct CpsRunContext *crc;
   static struct GNUNET_HashCode zkey;
 
+  peer = p;
   datastore = GNUNET_DATASTORE_connect (cfg);
   start_time = GNUNET_TIME_absolute_get ();
   crc = GNUNET_new (struct CpsRunContext);
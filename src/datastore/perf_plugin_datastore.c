@@ -440,18 +440,81 @@ load_plugin (const struct GNUNET_CONFIGURATION_Handle *cfg)
 }
 
 
+/**
+ * Measure how many puts per second the plugin achieves with the
+ * given number of puts per transaction (only supported by sqlite).
+ * The time includes committing the last group when the plugin is
+ * unloaded.
+ *
+ * @param c configuration to use
+ * @param group_commit_size value for the GROUP_COMMIT_SIZE option
+ */
+static void
+measure_puts (const struct GNUNET_CONFIGURATION_Handle *c,
+              unsigned long long group_commit_size)
+{
+  struct GNUNET_CONFIGURATION_Handle *cfg;
+  struct GNUNET_DATASTORE_PluginFunctions *api;
+  struct GNUNET_TIME_Absolute start;
+  struct GNUNET_TIME_Relative duration;
+  char name[64];
+  unsigned int j;
+
+  cfg = GNUNET_CONFIGURATION_dup (c);
+  GNUNET_CONFIGURATION_set_value_number (cfg, "datastore-sqlite",
+                                         "GROUP_COMMIT_SIZE",
+                                         group_commit_size);
+  api = load_plugin (cfg);
+  if (NULL == api)
+  {
+    GNUNET_CONFIGURATION_destroy (cfg);
+    return;
+  }
+  start = GNUNET_TIME_absolute_get ();
+  for (j = 0; j < PUT_10; j++)
+    putValue (api, j, 0);
+  api->drop (api->cls);
+  unload_plugin (api, cfg);
+  duration = GNUNET_TIME_absolute_get_duration (start);
+  GNUNET_CONFIGURATION_destroy (cfg);
+  GNUNET_snprintf (name, sizeof (name),
+                   "Storing items (%s)",
+                   (1 == group_commit_size) ? "autocommit" : "group commit");
+  printf ("%s took %s for %llu items (%llu puts/s)\n",
+          name,
+          GNUNET_STRINGS_relative_time_to_string (duration, GNUNET_YES),
+          PUT_10,
+          PUT_10 * 1000LL * 1000LL / (1 + duration.rel_value_us));
+  GAUGER (category, name,
+          PUT_10 * 1000LL * 1000LL / (1 + duration.rel_value_us),
+          "puts/s");
+}
+
+
 static void
 run (void *cls, char *const *args, const char *cfgfile,
      const struct GNUNET_CONFIGURATION_Handle *c)
 {
   struct GNUNET_DATASTORE_PluginFunctions *api;
   struct CpsRunContext *crc;
+  unsigned long long group_commit_size;
 
   if (NULL == c)
   {
     GNUNET_break (0);
     return;
   }
+  if (0 == strcmp (plugin_name, "sqlite"))
+  {
+    if ( (GNUNET_OK !=
+          GNUNET_CONFIGURATION_get_value_number (c, "datastore-sqlite",
+                                                 "GROUP_COMMIT_SIZE",
+                                                 &group_commit_size)) ||
+         (group_commit_size <= 1) )
+      group_commit_size = 64;
+    measure_puts (c, 1);
+    measure_puts (c, group_commit_size);
+  }
   api = load_plugin (c);
   if (api == NULL)
   {
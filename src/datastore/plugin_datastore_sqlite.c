@@ -48,6 +48,16 @@
  */
 #define BUSY_TIMEOUT_MS 250
 
+/**
+ * Default maximum number of puts we group into one transaction.
+ */
+#define DEFAULT_GROUP_COMMIT_SIZE 64
+
+/**
+ * Default maximum time (in ms) a put may remain uncommitted.
+ */
+#define DEFAULT_GROUP_COMMIT_DELAY_MS 50
+
 
 /**
  * Log an error message at log-level 'level' that indicates
@@ -118,6 +128,39 @@ struct Plugin
    */
   sqlite3_stmt *insertContent;
 
+  /**
+   * Task that commits the current group of puts, if a transaction
+   * is open.
+   */
+  GNUNET_SCHEDULER_TaskIdentifier commit_task;
+
+  /**
+   * Maximum time a put may remain uncommitted.
+   */
+  struct GNUNET_TIME_Relative group_commit_delay;
+
+  /**
+   * Maximum number of puts per transaction; 1 to commit
+   * every put on its own.
+   */
+  unsigned int group_commit_size;
+
+  /**
+   * Number of puts in the currently open transaction.
+   */
+  unsigned int pending_puts;
+
+  /**
+   * Number of bytes we reported as used for the puts in the
+   * currently open transaction.
+   */
+  unsigned long long pending_bytes;
+
+  /**
+   * Is a transaction for a group of puts open?
+   */
+  int in_transaction;
+
   /**
    * Should the database be dropped on shutdown?
    */
@@ -219,13 +262,51 @@ static int
 database_setup (const struct GNUNET_CONFIGURATION_Handle *cfg,
                 struct Plugin *plugin)
 {
+  static const char *const synchronous_choices[] = {
+    "OFF", "NORMAL", "FULL", NULL
+  };
+  static const char *const journal_mode_choices[] = {
+    "DELETE", "TRUNCATE", "PERSIST", "MEMORY", "WAL", "OFF", NULL
+  };
   sqlite3_stmt *stmt;
   char *afsdir;
+  const char *synchronous;
+  const char *journal_mode;
+  char *pragma;
+  unsigned long long group_commit_size;
 
 #if ENULL_DEFINED
   char *e;
 #endif
 
+  if (GNUNET_OK !=
+      GNUNET_CONFIGURATION_get_value_choice (cfg, "datastore-sqlite",
+                                             "SYNCHRONOUS",
+                                             synchronous_choices,
+                                             &synchronous))
+    synchronous = "OFF";
+  if (GNUNET_OK !=
+      GNUNET_CONFIGURATION_get_value_choice (cfg, "datastore-sqlite",
+                                             "JOURNAL_MODE",
+                                             journal_mode_choices,
+                                             &journal_mode))
+    journal_mode = "WAL";
+  if (GNUNET_OK !=
+      GNUNET_CONFIGURATION_get_value_number (cfg, "datastore-sqlite",
+                                             "GROUP_COMMIT_SIZE",
+                                             &group_commit_size))
+    group_commit_size = DEFAULT_GROUP_COMMIT_SIZE;
+  if (0 == group_commit_size)
+    group_commit_size = 1;
+  plugin->group_commit_size = (unsigned int) GNUNET_MIN (group_commit_size,
+                                                         UINT_MAX);
+  if (GNUNET_OK !=
+      GNUNET_CONFIGURATION_get_value_time (cfg, "datastore-sqlite",
+                                           "GROUP_COMMIT_DELAY",
+                                           &plugin->group_commit_delay))
+    plugin->group_commit_delay
+      = GNUNET_TIME_relative_multiply (GNUNET_TIME_UNIT_MILLISECONDS,
+                                       DEFAULT_GROUP_COMMIT_DELAY_MS);
   if (GNUNET_OK !=
       GNUNET_CONFIGURATION_get_value_filename (cfg, "datastore-sqlite",
                                                "FILENAME", &afsdir))
@@ -259,9 +340,10 @@ database_setup (const struct GNUNET_CONFIGURATION_Handle *cfg,
   CHECK (SQLITE_OK ==
          sqlite3_exec (plugin->dbh, "PRAGMA temp_store=MEMORY", NULL, NULL,
                        ENULL));
+  GNUNET_asprintf (&pragma, "PRAGMA synchronous=%s", synchronous);
   CHECK (SQLITE_OK ==
-         sqlite3_exec (plugin->dbh, "PRAGMA synchronous=OFF", NULL, NULL,
-                       ENULL));
+         sqlite3_exec (plugin->dbh, pragma, NULL, NULL, ENULL));
+  GNUNET_free (pragma);
   CHECK (SQLITE_OK ==
          sqlite3_exec (plugin->dbh, "PRAGMA legacy_file_format=OFF", NULL, NULL,
                        ENULL));
@@ -271,6 +353,11 @@ database_setup (const struct GNUNET_CONFIGURATION_Handle *cfg,
   CHECK (SQLITE_OK ==
          sqlite3_exec (plugin->dbh, "PRAGMA locking_mode=EXCLUSIVE", NULL, NULL,
                        ENULL));
+  /* after locking_mode, so that WAL does not need shared memory */
+  GNUNET_asprintf (&pragma, "PRAGMA journal_mode=%s", journal_mode);
+  CHECK (SQLITE_OK ==
+         sqlite3_exec (plugin->dbh, pragma, NULL, NULL, ENULL));
+  GNUNET_free (pragma);
   CHECK (SQLITE_OK ==
          sqlite3_exec (plugin->dbh, "PRAGMA count_changes=OFF", NULL, NULL,
                        ENULL));
@@ -364,6 +451,137 @@ database_setup (const struct GNUNET_CONFIGURATION_Handle *cfg,
 }
 
 
+/**
+ * The transaction holding the current group of puts was rolled
+ * back, so the puts in it are lost even though we reported them as
+ * stored.  Log this and correct the disk utilization.
+ *
+ * @param plugin the plugin context (state for this module)
+ */
+static void
+lose_puts (struct Plugin *plugin)
+{
+  int delta;
+
+  GNUNET_log_from (GNUNET_ERROR_TYPE_ERROR, "sqlite",
+                   _("Transaction rolled back, lost %u puts\n"),
+                   plugin->pending_puts);
+  while (plugin->pending_bytes > 0)
+  {
+    delta = (int) GNUNET_MIN (plugin->pending_bytes, INT_MAX);
+    plugin->env->duc (plugin->env->cls, -delta);
+    plugin->pending_bytes -= delta;
+  }
+  plugin->in_transaction = GNUNET_NO;
+  plugin->pending_puts = 0;
+}
+
+
+/**
+ * sqlite rolls back the whole transaction by itself on some errors
+ * (SQLITE_FULL, SQLITE_IOERR, ...).  Check whether this happened to
+ * the transaction holding the current group of puts.
+ *
+ * @param plugin the plugin context (state for this module)
+ */
+static void
+check_transaction (struct Plugin *plugin)
+{
+  if ( (GNUNET_YES == plugin->in_transaction) &&
+       (0 != sqlite3_get_autocommit (plugin->dbh)) )
+    lose_puts (plugin);
+}
+
+
+/**
+ * Commit the transaction holding the current group of puts, if any.
+ * If the commit fails, the transaction is rolled back.
+ *
+ * @param plugin the plugin context (state for this module)
+ * @param msg set to an error message on failure, can be NULL
+ * @return #GNUNET_OK on success, #GNUNET_SYSERR if the puts
+ *         were lost
+ */
+static int
+commit_puts (struct Plugin *plugin,
+             char **msg)
+{
+  if (GNUNET_SCHEDULER_NO_TASK != plugin->commit_task)
+  {
+    GNUNET_SCHEDULER_cancel (plugin->commit_task);
+    plugin->commit_task = GNUNET_SCHEDULER_NO_TASK;
+  }
+  check_transaction (plugin);
+  if (GNUNET_NO == plugin->in_transaction)
+    return GNUNET_OK;
+  GNUNET_log_from (GNUNET_ERROR_TYPE_DEBUG, "sqlite",
+                   "Committing %u puts\n", plugin->pending_puts);
+  if (SQLITE_OK ==
+      sqlite3_exec (plugin->dbh, "COMMIT", NULL, NULL, NULL))
+  {
+    plugin->in_transaction = GNUNET_NO;
+    plugin->pending_puts = 0;
+    plugin->pending_bytes = 0;
+    return GNUNET_OK;
+  }
+  LOG_SQLITE (plugin, msg, GNUNET_ERROR_TYPE_ERROR | GNUNET_ERROR_TYPE_BULK,
+              "sqlite3_exec");
+  /* after SQLITE_BUSY the transaction is still open */
+  if ( (0 == sqlite3_get_autocommit (plugin->dbh)) &&
+       (SQLITE_OK !=
+        sqlite3_exec (plugin->dbh, "ROLLBACK", NULL, NULL, NULL)) )
+    LOG_SQLITE (plugin, NULL, GNUNET_ERROR_TYPE_ERROR | GNUNET_ERROR_TYPE_BULK,
+                "sqlite3_exec");
+  lose_puts (plugin);
+  return GNUNET_SYSERR;
+}
+
+
+/**
+ * Task run to commit a group of puts once the maximum delay
+ * for group commits has passed.
+ *
+ * @param cls the plugin context (state for this module)
+ * @param tc scheduler context
+ */
+static void
+commit_task (void *cls,
+             const struct GNUNET_SCHEDULER_TaskContext *tc)
+{
+  struct Plugin *plugin = cls;
+
+  plugin->commit_task = GNUNET_SCHEDULER_NO_TASK;
+  (void) commit_puts (plugin, NULL);
+}
+
+
+/**
+ * Make sure a transaction for grouping puts is open (if group
+ * commits are enabled).
+ *
+ * @param plugin the plugin context (state for this module)
+ */
+static void
+begin_puts (struct Plugin *plugin)
+{
+  check_transaction (plugin);
+  if ( (1 == plugin->group_commit_size) ||
+       (GNUNET_YES == plugin->in_transaction) )
+    return;
+  if (SQLITE_OK !=
+      sqlite3_exec (plugin->dbh, "BEGIN", NULL, NULL, NULL))
+  {
+    LOG_SQLITE (plugin, NULL, GNUNET_ERROR_TYPE_ERROR | GNUNET_ERROR_TYPE_BULK,
+                "sqlite3_exec");
+    return;
+  }
+  plugin->in_transaction = GNUNET_YES;
+  plugin->commit_task
+    = GNUNET_SCHEDULER_add_delayed (plugin->group_commit_delay,
+                                    &commit_task, plugin);
+}
+
+
 /**
  * Shutdown database connection and associate data
  * structures.
@@ -379,6 +597,7 @@ database_shutdown (struct Plugin *plugin)
   sqlite3_stmt *stmt;
 #endif
 
+  (void) commit_puts (plugin, NULL);
   if (plugin->delRow != NULL)
     sqlite3_finalize (plugin->delRow);
   if (plugin->updPrio != NULL)
@@ -505,6 +724,7 @@ sqlite_plugin_put (void *cls,
 							   GNUNET_YES),
                    GNUNET_STRINGS_absolute_time_to_string (expiration));
   GNUNET_CRYPTO_hash (data, size, &vhash);
+  begin_puts (plugin);
   stmt = plugin->insertContent;
   rvalue = GNUNET_CRYPTO_random_u64 (GNUNET_CRYPTO_QUALITY_WEAK, UINT64_MAX);
   if ((SQLITE_OK != sqlite3_bind_int (stmt, 1, replication)) ||
@@ -559,7 +779,18 @@ sqlite_plugin_put (void *cls,
   if (SQLITE_OK != sqlite3_reset (stmt))
     LOG_SQLITE (plugin, NULL, GNUNET_ERROR_TYPE_ERROR | GNUNET_ERROR_TYPE_BULK,
                 "sqlite3_reset");
-  return ret;
+  if (GNUNET_OK != ret)
+  {
+    check_transaction (plugin);
+    return ret;
+  }
+  if (GNUNET_NO == plugin->in_transaction)
+    return GNUNET_OK;
+  plugin->pending_bytes += size + GNUNET_DATASTORE_ENTRY_OVERHEAD;
+  if ( (++plugin->pending_puts >= plugin->group_commit_size) &&
+       (GNUNET_OK != commit_puts (plugin, msg)) )
+    return GNUNET_SYSERR;
+  return GNUNET_OK;
 }
 
 
@@ -1156,6 +1387,8 @@ sqlite_plugin_estimate_size (void *cls)
                      ("sqlite version to old to determine size, assuming zero\n"));
     return 0;
   }
+  /* VACUUM cannot run inside a transaction */
+  (void) commit_puts (plugin, NULL);
   CHECK (SQLITE_OK == sqlite3_exec (plugin->dbh, "VACUUM", NULL, NULL, ENULL));
   CHECK (SQLITE_OK ==
          sqlite3_exec (plugin->dbh, "PRAGMA auto_vacuum=INCREMENTAL", NULL,
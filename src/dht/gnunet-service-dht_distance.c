@@ -0,0 +1,264 @@
+/*
+     This file is part of GNUnet.
+     (C) 2014 Christian Grothoff (and other contributing authors)
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+     Boston, MA 02111-1307, USA.
+*/
+
+/**
+ * @file dht/gnunet-service-dht_distance.c
+ * @brief index of hash codes for finding the closest one to a key,
+ *        implemented as a crit-bit tree
+ */
+#include "platform.h"
+#include "gnunet-service-dht_distance.h"
+
+
+/**
+ * Node in the crit-bit tree.  Leaves have a @e value, inner nodes
+ * have two children that differ first in bit @e bit.
+ */
+struct DistanceNode
+{
+  /**
+   * Children of an inner node, indexed by the value of bit @e bit.
+   */
+  struct DistanceNode *child[2];
+
+  /**
+   * Hash code of a leaf.
+   */
+  const struct GNUNET_HashCode *hash;
+
+  /**
+   * Value of a leaf, NULL for inner nodes.
+   */
+  void *value;
+
+  /**
+   * First bit in which the leaves below an inner node differ.
+   */
+  unsigned int bit;
+};
+
+
+/**
+ * Index of hash codes.
+ */
+struct GDS_DistanceIndex
+{
+  /**
+   * Root of the tree, NULL if empty.
+   */
+  struct DistanceNode *root;
+
+  /**
+   * Number of leaves in the tree.
+   */
+  unsigned int size;
+};
+
+
+/**
+ * Get a bit of a hash code, in the order used by
+ * #GNUNET_CRYPTO_hash_matching_bits.
+ *
+ * @param hc hash code
+ * @param bit which bit to get
+ * @return 0 or 1
+ */
+static unsigned int
+get_bit (const struct GNUNET_HashCode *hc,
+         unsigned int bit)
+{
+  return (((const unsigned char *) hc)[bit >> 3] >> (bit & 7)) & 1;
+}
+
+
+/**
+ * Create an empty distance index.
+ *
+ * @return the index
+ */
+struct GDS_DistanceIndex *
+GDS_DISTANCE_index_create ()
+{
+  return GNUNET_new (struct GDS_DistanceIndex);
+}
+
+
+/**
+ * Destroy a distance index.  The index must be empty.
+ *
+ * @param idx index to destroy
+ */
+void
+GDS_DISTANCE_index_destroy (struct GDS_DistanceIndex *idx)
+{
+  GNUNET_break (NULL == idx->root);
+  GNUNET_free (idx);
+}
+
+
+/**
+ * Add an entry to the index.
+ *
+ * @param idx index to add to
+ * @param hash hash code of the entry; must remain valid (and
+ *        unchanged) until the entry is removed again
+ * @param value value to associate with @a hash, must not be NULL
+ * @return #GNUNET_OK on success, #GNUNET_SYSERR if @a hash is
+ *         already in the index
+ */
+int
+GDS_DISTANCE_index_insert (struct GDS_DistanceIndex *idx,
+                           const struct GNUNET_HashCode *hash,
+                           void *value)
+{
+  struct DistanceNode *leaf;
+  struct DistanceNode *inner;
+  struct DistanceNode *pos;
+  struct DistanceNode **where;
+  unsigned int crit;
+
+  GNUNET_assert (NULL != value);
+  leaf = GNUNET_new (struct DistanceNode);
+  leaf->hash = hash;
+  leaf->value = value;
+  if (NULL == idx->root)
+  {
+    idx->root = leaf;
+    idx->size++;
+    return GNUNET_OK;
+  }
+  /* find the leaf we share the longest prefix with */
+  pos = idx->root;
+  while (NULL == pos->value)
+    pos = pos->child[get_bit (hash, pos->bit)];
+  crit = GNUNET_CRYPTO_hash_matching_bits (hash, pos->hash);
+  if (crit == sizeof (struct GNUNET_HashCode) * 8)
+  {
+    GNUNET_free (leaf);
+    return GNUNET_SYSERR;
+  }
+  /* insert a new inner node above the first node that
+     differs in a later bit */
+  where = &idx->root;
+  while ( (NULL == (*where)->value) &&
+          ((*where)->bit < crit) )
+    where = &(*where)->child[get_bit (hash, (*where)->bit)];
+  inner = GNUNET_new (struct DistanceNode);
+  inner->bit = crit;
+  inner->child[get_bit (hash, crit)] = leaf;
+  inner->child[1 - get_bit (hash, crit)] = *where;
+  *where = inner;
+  idx->size++;
+  return GNUNET_OK;
+}
+
+
+/**
+ * Remove an entry from the index.
+ *
+ * @param idx index to remove from
+ * @param hash hash code of the entry
+ * @return value associated with @a hash, NULL if not found
+ */
+void *
+GDS_DISTANCE_index_remove (struct GDS_DistanceIndex *idx,
+                           const struct GNUNET_HashCode *hash)
+{
+  struct DistanceNode **where;
+  struct DistanceNode **parent;
+  struct DistanceNode *leaf;
+  struct DistanceNode *inner;
+  unsigned int dir;
+  void *value;
+
+  if (NULL == idx->root)
+    return NULL;
+  parent = NULL;
+  dir = 0;
+  where = &idx->root;
+  while (NULL == (*where)->value)
+  {
+    parent = where;
+    dir = get_bit (hash, (*where)->bit);
+    where = &(*where)->child[dir];
+  }
+  leaf = *where;
+  if (0 != memcmp (leaf->hash, hash, sizeof (struct GNUNET_HashCode)))
+    return NULL;
+  value = leaf->value;
+  GNUNET_free (leaf);
+  idx->size--;
+  if (NULL == parent)
+  {
+    idx->root = NULL;
+    return value;
+  }
+  /* replace the parent with the sibling of the leaf */
+  inner = *parent;
+  *parent = inner->child[1 - dir];
+  GNUNET_free (inner);
+  return value;
+}
+
+
+/**
+ * Find the entry that is closest to @a key, that is the entry with
+ * the largest number of matching bits with @a key, breaking ties by
+ * the XOR distance in the bits that follow.
+ *
+ * @param idx index to search
+ * @param key key to search for
+ * @param hash set to the hash code of the entry found, can be NULL
+ * @return value of the closest entry, NULL if the index is empty
+ */
+void *
+GDS_DISTANCE_index_closest (const struct GDS_DistanceIndex *idx,
+                            const struct GNUNET_HashCode *key,
+                            const struct GNUNET_HashCode **hash)
+{
+  const struct DistanceNode *pos;
+
+  pos = idx->root;
+  if (NULL == pos)
+    return NULL;
+  /* All leaves below an inner node agree on the bits before its
+     critical bit, so following the key's value of that bit always
+     leads towards the smallest XOR distance. */
+  while (NULL == pos->value)
+    pos = pos->child[get_bit (key, pos->bit)];
+  if (NULL != hash)
+    *hash = pos->hash;
+  return pos->value;
+}
+
+
+/**
+ * Get the number of entries in the index.
+ *
+ * @param idx index to inspect
+ * @return number of entries
+ */
+unsigned int
+GDS_DISTANCE_index_size (const struct GDS_DistanceIndex *idx)
+{
+  return idx->size;
+}
+
+/* end of gnunet-service-dht_distance.c */
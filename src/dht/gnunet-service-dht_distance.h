@@ -0,0 +1,112 @@
+/*
+     This file is part of GNUnet.
+     (C) 2014 Christian Grothoff (and other contributing authors)
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+     Boston, MA 02111-1307, USA.
+*/
+
+/**
+ * @file dht/gnunet-service-dht_distance.h
+ * @brief index of hash codes for finding the closest one to a key
+ */
+#ifndef GNUNET_SERVICE_DHT_DISTANCE_H
+#define GNUNET_SERVICE_DHT_DISTANCE_H
+
+#include "gnunet_util_lib.h"
+
+
+/**
+ * Index of hash codes ordered by their bits (in the order used by
+ * #GNUNET_CRYPTO_hash_matching_bits), allowing to find the entry
+ * closest to a key in time proportional to the depth of the index
+ * instead of the number of entries.
+ */
+struct GDS_DistanceIndex;
+
+
+/**
+ * Create an empty distance index.
+ *
+ * @return the index
+ */
+struct GDS_DistanceIndex *
+GDS_DISTANCE_index_create (void);
+
+
+/**
+ * Destroy a distance index.  The index must be empty.
+ *
+ * @param idx index to destroy
+ */
+void
+GDS_DISTANCE_index_destroy (struct GDS_DistanceIndex *idx);
+
+
+/**
+ * Add an entry to the index.
+ *
+ * @param idx index to add to
+ * @param hash hash code of the entry; must remain valid (and
+ *        unchanged) until the entry is removed again
+ * @param value value to associate with @a hash, must not be NULL
+ * @return #GNUNET_OK on success, #GNUNET_SYSERR if @a hash is
+ *         already in the index
+ */
+int
+GDS_DISTANCE_index_insert (struct GDS_DistanceIndex *idx,
+                           const struct GNUNET_HashCode *hash,
+                           void *value);
+
+
+/**
+ * Remove an entry from the index.
+ *
+ * @param idx index to remove from
+ * @param hash hash code of the entry
+ * @return value associated with @a hash, NULL if not found
+ */
+void *
+GDS_DISTANCE_index_remove (struct GDS_DistanceIndex *idx,
+                           const struct GNUNET_HashCode *hash);
+
+
+/**
+ * Find the entry that is closest to @a key, that is the entry with
+ * the largest number of matching bits with @a key, breaking ties by
+ * the XOR distance in the bits that follow.
+ *
+ * @param idx index to search
+ * @param key key to search for
+ * @param hash set to the hash code of the entry found, can be NULL
+ * @return value of the closest entry, NULL if the index is empty
+ */
+void *
+GDS_DISTANCE_index_closest (const struct GDS_DistanceIndex *idx,
+                            const struct GNUNET_HashCode *key,
+                            const struct GNUNET_HashCode **hash);
+
+
+/**
+ * Get the number of entries in the index.
+ *
+ * @param idx index to inspect
+ * @return number of entries
+ */
+unsigned int
+GDS_DISTANCE_index_size (const struct GDS_DistanceIndex *idx);
+
+
+#endif
@@ -42,6 +42,7 @@
 #include "gnunet-service-dht.h"
 #include "gnunet-service-dht_clients.h"
 #include "gnunet-service-dht_datacache.h"
+#include "gnunet-service-dht_distance.h"
 #include "gnunet-service-dht_hello.h"
 #include "gnunet-service-dht_neighbours.h"
 #include "gnunet-service-dht_nse.h"
@@ -342,6 +343,17 @@ struct PeerInfo
    */
   struct GNUNET_PeerIdentity id;
 
+  /**
+   * Hash of @e id, computed once when the peer connects.
+   */
+  struct GNUNET_HashCode phash;
+
+  /**
+   * Is this peer in the #distance_index (that is, is it one of the
+   * first #bucket_size peers of its bucket)?
+   */
+  int in_distance_index;
+
 #if 0
   /**
    * What is the average latency for replies received?
@@ -420,6 +432,12 @@ static struct GNUNET_CONTAINER_MultiPeerMap *all_known_peers;
  */
 static unsigned int bucket_size = DEFAULT_BUCKET_SIZE;
 
+/**
+ * Index of the peers we route to (the first #bucket_size peers
+ * of each bucket) by their hashed identity, for greedy routing.
+ */
+static struct GDS_DistanceIndex *distance_index;
+
 /**
  * Task that sends FIND PEER requests.
  */
@@ -484,20 +502,16 @@ update_core_preference (void *cls,
   uint64_t preference;
   unsigned int matching;
   int bucket;
-  struct GNUNET_HashCode phash;
 
   peer->preference_task = GNUNET_SCHEDULER_NO_TASK;
   if ((tc->reason & GNUNET_SCHEDULER_REASON_SHUTDOWN) != 0)
     return;
-  GNUNET_CRYPTO_hash (&peer->id,
-		      sizeof (struct GNUNET_PeerIdentity),
-		      &phash);
   matching =
       GNUNET_CRYPTO_hash_matching_bits (&my_identity_hash,
-                                        &phash);
+                                        &peer->phash);
   if (matching >= 64)
     matching = 63;
-  bucket = find_bucket (&phash);
+  bucket = find_bucket (&peer->phash);
   if (bucket == GNUNET_SYSERR)
     preference = 0;
   else
@@ -633,6 +647,45 @@ send_find_peer_message (void *cls,
 }
 
 
+/**
+ * Add a peer to the distance index used for greedy routing.
+ *
+ * @param pi peer to add
+ */
+static void
+add_to_distance_index (struct PeerInfo *pi)
+{
+  GNUNET_assert (GNUNET_NO == pi->in_distance_index);
+  GNUNET_assert (GNUNET_OK ==
+                 GDS_DISTANCE_index_insert (distance_index,
+                                            &pi->phash,
+                                            pi));
+  pi->in_distance_index = GNUNET_YES;
+}
+
+
+/**
+ * A routing peer was removed from a bucket; add the peer that
+ * is now the last of the first #bucket_size peers of the bucket
+ * to the distance index (if there is such a peer).
+ *
+ * @param bucket index of the bucket
+ */
+static void
+promote_in_bucket (int bucket)
+{
+  struct PeerInfo *pos;
+  unsigned int count;
+
+  pos = k_buckets[bucket].head;
+  for (count = 1; (NULL != pos) && (count < bucket_size); count++)
+    pos = pos->next;
+  if ( (NULL != pos) &&
+       (GNUNET_NO == pos->in_distance_index) )
+    add_to_distance_index (pos);
+}
+
+
 /**
  * Method called whenever a peer connects.
  *
@@ -643,7 +696,6 @@ static void
 handle_core_connect (void *cls, const struct GNUNET_PeerIdentity *peer)
 {
   struct PeerInfo *ret;
-  struct GNUNET_HashCode phash;
   int peer_bucket;
 
   /* Check for connect to self message */
@@ -661,20 +713,22 @@ handle_core_connect (void *cls, const struct GNUNET_PeerIdentity *peer)
   }
   GNUNET_STATISTICS_update (GDS_stats, gettext_noop ("# peers connected"), 1,
                             GNUNET_NO);
-  GNUNET_CRYPTO_hash (peer,
-		      sizeof (struct GNUNET_PeerIdentity),
-		      &phash);
-  peer_bucket = find_bucket (&phash);
-  GNUNET_assert ((peer_bucket >= 0) && (peer_bucket < MAX_BUCKETS));
   ret = GNUNET_new (struct PeerInfo);
 #if 0
   ret->latency = latency;
   ret->distance = distance;
 #endif
   ret->id = *peer;
+  GNUNET_CRYPTO_hash (peer,
+		      sizeof (struct GNUNET_PeerIdentity),
+		      &ret->phash);
+  peer_bucket = find_bucket (&ret->phash);
+  GNUNET_assert ((peer_bucket >= 0) && (peer_bucket < MAX_BUCKETS));
   GNUNET_CONTAINER_DLL_insert_tail (k_buckets[peer_bucket].head,
                                     k_buckets[peer_bucket].tail, ret);
   k_buckets[peer_bucket].peers_size++;
+  if (k_buckets[peer_bucket].peers_size <= bucket_size)
+    add_to_distance_index (ret);
   closest_bucket = GNUNET_MAX (closest_bucket, peer_bucket);
   if ((peer_bucket > 0) && (k_buckets[peer_bucket].peers_size <= bucket_size))
   {
@@ -709,7 +763,6 @@ handle_core_disconnect (void *cls,
   int current_bucket;
   struct P2PPendingMessage *pos;
   unsigned int discarded;
-  struct GNUNET_HashCode phash;
 
   /* Check for disconnect from self message */
   if (0 == memcmp (&my_identity, peer, sizeof (struct GNUNET_PeerIdentity)))
@@ -735,15 +788,21 @@ handle_core_disconnect (void *cls,
     GNUNET_SCHEDULER_cancel (to_remove->preference_task);
     to_remove->preference_task = GNUNET_SCHEDULER_NO_TASK;
   }
-  GNUNET_CRYPTO_hash (peer,
-		      sizeof (struct GNUNET_PeerIdentity),
-		      &phash);
-  current_bucket = find_bucket (&phash);
+  current_bucket = find_bucket (&to_remove->phash);
   GNUNET_assert (current_bucket >= 0);
   GNUNET_CONTAINER_DLL_remove (k_buckets[current_bucket].head,
                                k_buckets[current_bucket].tail, to_remove);
   GNUNET_assert (k_buckets[current_bucket].peers_size > 0);
   k_buckets[current_bucket].peers_size--;
+  if (GNUNET_YES == to_remove->in_distance_index)
+  {
+    GNUNET_assert (to_remove ==
+                   GDS_DISTANCE_index_remove (distance_index,
+                                              &to_remove->phash));
+    /* another peer of the bucket may now be among the first
+       'bucket_size' ones */
+    promote_in_bucket (current_bucket);
+  }
   while ((closest_bucket > 0) && (k_buckets[closest_bucket].peers_size == 0))
     closest_bucket--;
 
@@ -995,7 +1054,6 @@ am_closest_peer (const struct GNUNET_HashCode *key,
   int bucket_num;
   int count;
   struct PeerInfo *pos;
-  struct GNUNET_HashCode phash;
 
   if (0 == memcmp (&my_identity_hash, key, sizeof (struct GNUNET_HashCode)))
     return GNUNET_YES;
@@ -1006,17 +1064,14 @@ am_closest_peer (const struct GNUNET_HashCode *key,
   count = 0;
   while ((pos != NULL) && (count < bucket_size))
   {
-    GNUNET_CRYPTO_hash (&pos->id,
-			sizeof (struct GNUNET_PeerIdentity),
-			&phash);
     if ((bloom != NULL) &&
         (GNUNET_YES ==
-         GNUNET_CONTAINER_bloomfilter_test (bloom, &phash)))
+         GNUNET_CONTAINER_bloomfilter_test (bloom, &pos->phash)))
     {
       pos = pos->next;
       continue;                 /* Skip already checked entries */
     }
-    other_bits = GNUNET_CRYPTO_hash_matching_bits (&phash, key);
+    other_bits = GNUNET_CRYPTO_hash_matching_bits (&pos->phash, key);
     if (other_bits > bits)
       return GNUNET_NO;
     if (other_bits == bits)     /* We match the same number of bits */
@@ -1053,55 +1108,30 @@ select_peer (const struct GNUNET_HashCode * key,
   unsigned int count;
   unsigned int selected;
   struct PeerInfo *pos;
-  unsigned int dist;
-  unsigned int smallest_distance;
   struct PeerInfo *chosen;
-  struct GNUNET_HashCode phash;
 
   if (hops >= GDS_NSE_get ())
   {
-    /* greedy selection (closest peer that is not in bloomfilter) */
-    smallest_distance = UINT_MAX;
-    chosen = NULL;
-    for (bc = 0; bc <= closest_bucket; bc++)
+    /* greedy selection (closest peer that is not in bloomfilter);
+       the distance index only contains the first 'bucket_size'
+       peers of each bucket, which are the ones we route to */
+    chosen = GDS_DISTANCE_index_closest (distance_index, key, NULL);
+    if ( (NULL != chosen) &&
+         ((unsigned int) -1 == get_distance (key, &chosen->phash)) )
+      chosen = NULL;            /* maximum distance never wins */
+    if ( (NULL != chosen) &&
+         (NULL != bloom) &&
+         (GNUNET_YES ==
+          GNUNET_CONTAINER_bloomfilter_test (bloom, &chosen->phash)) )
     {
-      pos = k_buckets[bc].head;
-      count = 0;
-      while ((pos != NULL) && (count < bucket_size))
-      {
-	GNUNET_CRYPTO_hash (&pos->id,
-			    sizeof (struct GNUNET_PeerIdentity),
-			    &phash);
-        if ((bloom == NULL) ||
-            (GNUNET_NO ==
-             GNUNET_CONTAINER_bloomfilter_test (bloom, &phash)))
-        {
-          dist = get_distance (key, &phash);
-          if (dist < smallest_distance)
-          {
-            chosen = pos;
-            smallest_distance = dist;
-          }
-        }
-        else
-        {
-          GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
-                      "Excluded peer `%s' due to BF match in greedy routing for %s\n",
-                      GNUNET_i2s (&pos->id), GNUNET_h2s (key));
-          GNUNET_STATISTICS_update (GDS_stats,
-                                    gettext_noop
-                                    ("# Peers excluded from routing due to Bloomfilter"),
-                                    1, GNUNET_NO);
-          dist = get_distance (key, &phash);
-          if (dist < smallest_distance)
-          {
-            chosen = NULL;
-            smallest_distance = dist;
-          }
-        }
-        count++;
-        pos = pos->next;
-      }
+      GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
+                  "Excluded peer `%s' due to BF match in greedy routing for %s\n",
+                  GNUNET_i2s (&chosen->id), GNUNET_h2s (key));
+      GNUNET_STATISTICS_update (GDS_stats,
+                                gettext_noop
+                                ("# Peers excluded from routing due to Bloomfilter"),
+                                1, GNUNET_NO);
+      chosen = NULL;
     }
     if (NULL == chosen)
       GNUNET_STATISTICS_update (GDS_stats,
@@ -1118,12 +1148,9 @@ select_peer (const struct GNUNET_HashCode * key,
     pos = k_buckets[bc].head;
     while ((pos != NULL) && (count < bucket_size))
     {
-      GNUNET_CRYPTO_hash (&pos->id,
-			  sizeof (struct GNUNET_PeerIdentity),
-			  &phash);
       if ((bloom != NULL) &&
           (GNUNET_YES ==
-           GNUNET_CONTAINER_bloomfilter_test (bloom, &phash)))
+           GNUNET_CONTAINER_bloomfilter_test (bloom, &pos->phash)))
       {
         GNUNET_STATISTICS_update (GDS_stats,
                                   gettext_noop
@@ -1153,12 +1180,9 @@ select_peer (const struct GNUNET_HashCode * key,
   {
     for (pos = k_buckets[bc].head; ((pos != NULL) && (count < bucket_size)); pos = pos->next)
     {
-      GNUNET_CRYPTO_hash (&pos->id,
-			  sizeof (struct GNUNET_PeerIdentity),
-			  &phash);
       if ((bloom != NULL) &&
           (GNUNET_YES ==
-           GNUNET_CONTAINER_bloomfilter_test (bloom, &phash)))
+           GNUNET_CONTAINER_bloomfilter_test (bloom, &pos->phash)))
       {
         continue;               /* Ignore bloomfiltered peers */
       }
@@ -1194,7 +1218,6 @@ get_target_peers (const struct GNUNET_HashCode *key,
   unsigned int off;
   struct PeerInfo **rtargets;
   struct PeerInfo *nxt;
-  struct GNUNET_HashCode nhash;
 
   GNUNET_assert (NULL != bloom);
   ret = get_forward_count (hop_count, target_replication);
@@ -1210,13 +1233,10 @@ get_target_peers (const struct GNUNET_HashCode *key,
     if (NULL == nxt)
       break;
     rtargets[off] = nxt;
-    GNUNET_CRYPTO_hash (&nxt->id,
-			sizeof (struct GNUNET_PeerIdentity),
-			&nhash);
     GNUNET_break (GNUNET_NO ==
                   GNUNET_CONTAINER_bloomfilter_test (bloom,
-                                                     &nhash));
-    GNUNET_CONTAINER_bloomfilter_add (bloom, &nhash);
+                                                     &nxt->phash));
+    GNUNET_CONTAINER_bloomfilter_add (bloom, &nxt->phash);
   }
   GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
               "Selected %u/%u peers at hop %u for %s (target was %u)\n", off,
@@ -1278,7 +1298,6 @@ GDS_NEIGHBOURS_handle_put (enum GNUNET_BLOCK_Type type,
   size_t msize;
   struct PeerPutMessage *ppm;
   struct GNUNET_PeerIdentity *pp;
-  struct GNUNET_HashCode thash;
   unsigned int skip_count;
 
   GNUNET_assert (NULL != bf);
@@ -1346,12 +1365,9 @@ GDS_NEIGHBOURS_handle_put (enum GNUNET_BLOCK_Type type,
     ppm->desired_replication_level = htonl (desired_replication_level);
     ppm->put_path_length = htonl (put_path_length);
     ppm->expiration_time = GNUNET_TIME_absolute_hton (expiration_time);
-    GNUNET_CRYPTO_hash (&target->id,
-			sizeof (struct GNUNET_PeerIdentity),
-			&thash);
     GNUNET_break (GNUNET_YES ==
                   GNUNET_CONTAINER_bloomfilter_test (bf,
-                                                     &thash));
+                                                     &target->phash));
     GNUNET_assert (GNUNET_OK ==
                    GNUNET_CONTAINER_bloomfilter_get_raw_data (bf,
                                                               ppm->bloomfilter,
@@ -1407,7 +1423,6 @@ GDS_NEIGHBOURS_handle_get (enum GNUNET_BLOCK_Type type,
   struct PeerGetMessage *pgm;
   char *xq;
   size_t reply_bf_size;
-  struct GNUNET_HashCode thash;
   unsigned int skip_count;
 
   GNUNET_assert (NULL != peer_bf);
@@ -1470,12 +1485,9 @@ GDS_NEIGHBOURS_handle_get (enum GNUNET_BLOCK_Type type,
     pgm->desired_replication_level = htonl (desired_replication_level);
     pgm->xquery_size = htonl (xquery_size);
     pgm->bf_mutator = reply_bf_mutator;
-    GNUNET_CRYPTO_hash (&target->id,
-			sizeof (struct GNUNET_PeerIdentity),
-			&thash);
     GNUNET_break (GNUNET_YES ==
                   GNUNET_CONTAINER_bloomfilter_test (peer_bf,
-                                                     &thash));
+                                                     &target->phash));
     GNUNET_assert (GNUNET_OK ==
                    GNUNET_CONTAINER_bloomfilter_get_raw_data (peer_bf,
                                                               pgm->bloomfilter,
@@ -1795,7 +1807,6 @@ handle_find_peer (const struct GNUNET_PeerIdentity *sender,
   struct PeerBucket *bucket;
   struct PeerInfo *peer;
   unsigned int choice;
-  struct GNUNET_HashCode phash;
   struct GNUNET_HashCode mhash;
   const struct GNUNET_HELLO_Message *hello;
 
@@ -1857,8 +1868,7 @@ handle_find_peer (const struct GNUNET_PeerIdentity *sender,
       return;                   /* no non-masked peer available */
     if (peer == NULL)
       peer = bucket->head;
-    GNUNET_CRYPTO_hash (&peer->id, sizeof (struct GNUNET_PeerIdentity), &phash);
-    GNUNET_BLOCK_mingle_hash (&phash, bf_mutator, &mhash);
+    GNUNET_BLOCK_mingle_hash (&peer->phash, bf_mutator, &mhash);
     hello = GDS_HELLO_get (&peer->id);
   }
   while ((hello == NULL) ||
@@ -2217,6 +2227,7 @@ GDS_NEIGHBOURS_init ()
   if (core_api == NULL)
     return GNUNET_SYSERR;
   all_known_peers = GNUNET_CONTAINER_multipeermap_create (256, GNUNET_NO);
+  distance_index = GDS_DISTANCE_index_create ();
   return GNUNET_OK;
 }
 
@@ -2236,6 +2247,8 @@ GDS_NEIGHBOURS_done ()
   GNUNET_assert (0 == GNUNET_CONTAINER_multipeermap_size (all_known_peers));
   GNUNET_CONTAINER_multipeermap_destroy (all_known_peers);
   all_known_peers = NULL;
+  GDS_DISTANCE_index_destroy (distance_index);
+  distance_index = NULL;
   if (GNUNET_SCHEDULER_NO_TASK != find_peer_task)
   {
     GNUNET_SCHEDULER_cancel (find_peer_task);
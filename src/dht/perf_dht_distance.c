@@ -0,0 +1,205 @@
+/*
+     This file is part of GNUnet.
+     (C) 2014 Christian Grothoff (and other contributing authors)
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+     Boston, MA 02111-1307, USA.
+*/
+
+/**
+ * @file dht/perf_dht_distance.c
+ * @brief measure how fast the closest peer to a key can be found,
+ *        hashing peer identities on every lookup, using cached
+ *        hashes and using the distance index
+ */
+#include "platform.h"
+#include "gnunet_util_lib.h"
+#include "gnunet-service-dht_distance.h"
+#include <gauger.h>
+
+/**
+ * Default number of peers in the routing table.
+ */
+#define DEFAULT_PEERS 1024
+
+/**
+ * Number of keys we look up.
+ */
+#define LOOKUPS 10000
+
+
+/**
+ * Find the peer closest to @a key by hashing all identities.
+ *
+ * @param ids peer identities
+ * @param n number of peers
+ * @param key key to look up
+ * @return number of bits the closest peer matches
+ */
+static unsigned int
+scan_hashing (const struct GNUNET_PeerIdentity *ids,
+              unsigned int n,
+              const struct GNUNET_HashCode *key)
+{
+  struct GNUNET_HashCode phash;
+  unsigned int best;
+  unsigned int bits;
+  unsigned int i;
+
+  best = 0;
+  for (i = 0; i < n; i++)
+  {
+    GNUNET_CRYPTO_hash (&ids[i], sizeof (struct GNUNET_PeerIdentity), &phash);
+    bits = GNUNET_CRYPTO_hash_matching_bits (&phash, key);
+    if (bits > best)
+      best = bits;
+  }
+  return best;
+}
+
+
+/**
+ * Find the peer closest to @a key using the cached hashes.
+ *
+ * @param hashes hashes of the peer identities
+ * @param n number of peers
+ * @param key key to look up
+ * @return number of bits the closest peer matches
+ */
+static unsigned int
+scan_cached (const struct GNUNET_HashCode *hashes,
+             unsigned int n,
+             const struct GNUNET_HashCode *key)
+{
+  unsigned int best;
+  unsigned int bits;
+  unsigned int i;
+
+  best = 0;
+  for (i = 0; i < n; i++)
+  {
+    bits = GNUNET_CRYPTO_hash_matching_bits (&hashes[i], key);
+    if (bits > best)
+      best = bits;
+  }
+  return best;
+}
+
+
+/**
+ * Report the time taken for #LOOKUPS lookups.
+ *
+ * @param what name of the strategy
+ * @param start when we started
+ */
+static void
+report (const char *what,
+        struct GNUNET_TIME_Absolute start)
+{
+  struct GNUNET_TIME_Relative duration;
+  char name[64];
+
+  duration = GNUNET_TIME_absolute_get_duration (start);
+  printf ("%s: %u lookups took %s (%llu lookups/ms)\n",
+          what,
+          LOOKUPS,
+          GNUNET_STRINGS_relative_time_to_string (duration, GNUNET_YES),
+          (unsigned long long) (LOOKUPS * 1000LL / (1 + duration.rel_value_us)));
+  GNUNET_snprintf (name, sizeof (name),
+                   "Closest peer (%s)",
+                   what);
+  GAUGER ("DHT", name,
+          LOOKUPS * 1000LL / (1 + duration.rel_value_us),
+          "lookups/ms");
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  struct GDS_DistanceIndex *idx;
+  struct GNUNET_PeerIdentity *ids;
+  struct GNUNET_HashCode *hashes;
+  struct GNUNET_HashCode *keys;
+  const struct GNUNET_HashCode *found;
+  struct GNUNET_TIME_Absolute start;
+  unsigned int *expected;
+  unsigned int n;
+  unsigned int i;
+  int ret;
+
+  GNUNET_log_setup ("perf-dht-distance", "WARNING", NULL);
+  n = DEFAULT_PEERS;
+  if ( (argc > 1) &&
+       ( (1 != sscanf (argv[1], "%u", &n)) ||
+         (0 == n) ) )
+  {
+    fprintf (stderr, "Usage: %s [PEERS]\n", argv[0]);
+    return 1;
+  }
+  ids = GNUNET_malloc (n * sizeof (struct GNUNET_PeerIdentity));
+  hashes = GNUNET_malloc (n * sizeof (struct GNUNET_HashCode));
+  keys = GNUNET_malloc (LOOKUPS * sizeof (struct GNUNET_HashCode));
+  expected = GNUNET_malloc (LOOKUPS * sizeof (unsigned int));
+  idx = GDS_DISTANCE_index_create ();
+  for (i = 0; i < n; i++)
+  {
+    GNUNET_CRYPTO_random_block (GNUNET_CRYPTO_QUALITY_WEAK,
+                                &ids[i], sizeof (struct GNUNET_PeerIdentity));
+    GNUNET_CRYPTO_hash (&ids[i], sizeof (struct GNUNET_PeerIdentity),
+                        &hashes[i]);
+    GNUNET_assert (GNUNET_OK ==
+                   GDS_DISTANCE_index_insert (idx, &hashes[i], &ids[i]));
+  }
+  for (i = 0; i < LOOKUPS; i++)
+    GNUNET_CRYPTO_hash_create_random (GNUNET_CRYPTO_QUALITY_WEAK, &keys[i]);
+  printf ("Routing table with %u peers\n", n);
+
+  start = GNUNET_TIME_absolute_get ();
+  for (i = 0; i < LOOKUPS; i++)
+    expected[i] = scan_hashing (ids, n, &keys[i]);
+  report ("hashing scan", start);
+
+  ret = 0;
+  start = GNUNET_TIME_absolute_get ();
+  for (i = 0; i < LOOKUPS; i++)
+    if (expected[i] != scan_cached (hashes, n, &keys[i]))
+      ret = 1;
+  report ("cached scan", start);
+
+  start = GNUNET_TIME_absolute_get ();
+  for (i = 0; i < LOOKUPS; i++)
+  {
+    found = NULL;
+    if ( (NULL == GDS_DISTANCE_index_closest (idx, &keys[i], &found)) ||
+         (expected[i] != GNUNET_CRYPTO_hash_matching_bits (found, &keys[i])) )
+      ret = 1;
+  }
+  report ("distance index", start);
+  if (0 != ret)
+    fprintf (stderr, "Lookup strategies disagree on the closest peer!\n");
+
+  for (i = 0; i < n; i++)
+    GNUNET_assert (&ids[i] == GDS_DISTANCE_index_remove (idx, &hashes[i]));
+  GNUNET_assert (0 == GDS_DISTANCE_index_size (idx));
+  GDS_DISTANCE_index_destroy (idx);
+  GNUNET_free (expected);
+  GNUNET_free (keys);
+  GNUNET_free (hashes);
+  GNUNET_free (ids);
+  return ret;
+}
+
+/* end of perf_dht_distance.c */
@@ -26,6 +26,117 @@
  */
 #include "platform.h"
 #include "fs_tree.h"
+#if HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+/**
+ * Upper bound on the number of threads used to encode DBLOCKs.
+ */
+#define MAX_ENCODER_THREADS 16
+
+#if HAVE_PTHREAD_H
+#define LOCK(b) GNUNET_assert (0 == pthread_mutex_lock (&(b)->lock))
+#define UNLOCK(b) GNUNET_assert (0 == pthread_mutex_unlock (&(b)->lock))
+#else
+#define LOCK(b)
+#define UNLOCK(b)
+#endif
+
+
+/**
+ * DBLOCKs that were read ahead and encoded in parallel, covering
+ * (at most) the children of one IBLOCK at depth 1, together with
+ * the worker threads that encode them.  The threads live as long
+ * as the tree encoder and start on each block as soon as it has
+ * been read.
+ */
+struct DBlockBatch
+{
+
+  /**
+   * Plaintext of the blocks, #CHK_PER_INODE * #DBLOCK_SIZE bytes
+   * or the size of the file, whichever is smaller.
+   */
+  char *plaintext;
+
+  /**
+   * Ciphertext of the blocks, as large as @e plaintext.
+   */
+  char *ciphertext;
+
+  /**
+   * CHKs of the blocks, #CHK_PER_INODE entries.
+   */
+  struct ContentHashKey *chks;
+
+  /**
+   * File offset of the first block in the batch.
+   */
+  uint64_t offset;
+
+  /**
+   * Total number of bytes that were read into @e plaintext.
+   */
+  size_t size;
+
+  /**
+   * Number of blocks in the batch (read so far, while filling).
+   */
+  unsigned int blocks;
+
+  /**
+   * Index of the next block that needs to be encoded.
+   */
+  unsigned int next;
+
+  /**
+   * Number of blocks that have been encoded.
+   */
+  unsigned int encoded;
+
+  /**
+   * #GNUNET_YES while the batch is still being read.
+   */
+  int filling;
+
+  /**
+   * #GNUNET_YES if reading the block following the batch failed.
+   */
+  int read_error;
+
+#if HAVE_PTHREAD_H
+  /**
+   * Worker threads.
+   */
+  pthread_t workers[MAX_ENCODER_THREADS];
+
+  /**
+   * Number of entries in @e workers.
+   */
+  unsigned int num_workers;
+
+  /**
+   * #GNUNET_YES if the workers should terminate.
+   */
+  int stop;
+
+  /**
+   * Protects the counters and flags above.
+   */
+  pthread_mutex_t lock;
+
+  /**
+   * Signalled when a block was read (or the workers should stop).
+   */
+  pthread_cond_t work_cond;
+
+  /**
+   * Signalled when the last block of a batch was encoded.
+   */
+  pthread_cond_t done_cond;
+#endif
+};
 
 
 /**
@@ -108,6 +219,17 @@ struct GNUNET_FS_TreeEncoder
    */
   struct ContentHashKey *chk_tree;
 
+  /**
+   * DBLOCKs encoded ahead of time, NULL if we encode
+   * one block at a time.
+   */
+  struct DBlockBatch *batch;
+
+  /**
+   * Number of threads to use for encoding DBLOCKs.
+   */
+  unsigned int threads;
+
   /**
    * Are we currently in 'GNUNET_FS_tree_encoder_next'?
    * Flag used to prevent recursion.
@@ -249,6 +371,203 @@ GNUNET_FS_tree_calculate_block_size (uint64_t fsize, uint64_t offset,
 }
 
 
+/**
+ * Determine how many threads the tree encoder should use, based
+ * on the "ENCODER_THREADS" option in the "fs" section (0 or
+ * missing means to use one thread per CPU).
+ *
+ * @param h the global FS context
+ * @return number of threads to use, at least 1
+ */
+static unsigned int
+get_encoder_threads (struct GNUNET_FS_Handle *h)
+{
+  unsigned long long threads;
+
+#if HAVE_PTHREAD_H
+  if ( (NULL == h) ||
+       (GNUNET_OK !=
+        GNUNET_CONFIGURATION_get_value_number (h->cfg,
+                                               "fs",
+                                               "ENCODER_THREADS",
+                                               &threads)) )
+    threads = 0;
+#if HAVE_SYSCONF && defined(_SC_NPROCESSORS_ONLN)
+  if (0 == threads)
+  {
+    long cpus;
+
+    cpus = sysconf (_SC_NPROCESSORS_ONLN);
+    threads = (cpus > 0) ? cpus : 1;
+  }
+#endif
+  if (0 == threads)
+    threads = 1;
+  if (threads > MAX_ENCODER_THREADS)
+    threads = MAX_ENCODER_THREADS;
+#else
+  threads = 1;
+#endif
+  return (unsigned int) threads;
+}
+
+
+/**
+ * Compute the CHK of a block and encrypt it.
+ *
+ * @param pt_block plaintext of the block
+ * @param pt_size number of bytes in @a pt_block
+ * @param chk set to the CHK of the block
+ * @param enc where to write the encrypted block
+ */
+static void
+encode_block (const void *pt_block,
+              uint16_t pt_size,
+              struct ContentHashKey *chk,
+              void *enc)
+{
+  struct GNUNET_CRYPTO_SymmetricSessionKey sk;
+  struct GNUNET_CRYPTO_SymmetricInitializationVector iv;
+
+  GNUNET_CRYPTO_hash (pt_block, pt_size, &chk->key);
+  GNUNET_CRYPTO_hash_to_aes_key (&chk->key, &sk, &iv);
+  GNUNET_CRYPTO_symmetric_encrypt (pt_block, pt_size, &sk, &iv, enc);
+  GNUNET_CRYPTO_hash (enc, pt_size, &chk->query);
+}
+
+
+/**
+ * Encode the next block of the batch that was read but not yet
+ * claimed by another thread.  Must be called with the lock of the
+ * batch held; the lock is released while encoding.
+ *
+ * @param batch the batch
+ */
+static void
+encode_next_block (struct DBlockBatch *batch)
+{
+  unsigned int i;
+  size_t off;
+  uint16_t pt_size;
+
+  i = batch->next++;
+  off = i * (size_t) DBLOCK_SIZE;
+  pt_size = GNUNET_MIN (DBLOCK_SIZE, batch->size - off);
+  UNLOCK (batch);
+  encode_block (&batch->plaintext[off],
+                pt_size,
+                &batch->chks[i],
+                &batch->ciphertext[off]);
+  LOCK (batch);
+  batch->encoded++;
+#if HAVE_PTHREAD_H
+  if ( (GNUNET_NO == batch->filling) &&
+       (batch->encoded == batch->blocks) )
+    GNUNET_assert (0 == pthread_cond_signal (&batch->done_cond));
+#endif
+}
+
+
+#if HAVE_PTHREAD_H
+/**
+ * Main function of an encoder thread: encode blocks of the batch
+ * as they are read until the encoder is destroyed.
+ *
+ * @param cls the `struct DBlockBatch`
+ * @return NULL
+ */
+static void *
+encoder_main (void *cls)
+{
+  struct DBlockBatch *batch = cls;
+
+  LOCK (batch);
+  while (GNUNET_NO == batch->stop)
+  {
+    if (batch->next == batch->blocks)
+    {
+      GNUNET_assert (0 == pthread_cond_wait (&batch->work_cond, &batch->lock));
+      continue;
+    }
+    encode_next_block (batch);
+  }
+  UNLOCK (batch);
+  return NULL;
+}
+#endif
+
+
+/**
+ * Create a batch and start the encoder threads for it.
+ *
+ * @param batch_size number of bytes the batch must hold
+ * @param threads number of threads to use for encoding, including
+ *        the thread that reads the blocks
+ * @return NULL if we could not allocate the buffers
+ */
+static struct DBlockBatch *
+batch_create (size_t batch_size,
+              unsigned int threads)
+{
+  struct DBlockBatch *batch;
+
+  batch = GNUNET_new (struct DBlockBatch);
+  batch->plaintext = GNUNET_malloc_large (batch_size);
+  batch->ciphertext = GNUNET_malloc_large (batch_size);
+  if ( (NULL == batch->plaintext) ||
+       (NULL == batch->ciphertext) )
+  {
+    GNUNET_free_non_null (batch->plaintext);
+    GNUNET_free_non_null (batch->ciphertext);
+    GNUNET_free (batch);
+    return NULL;
+  }
+  batch->chks = GNUNET_malloc (CHK_PER_INODE *
+                               sizeof (struct ContentHashKey));
+#if HAVE_PTHREAD_H
+  GNUNET_assert (0 == pthread_mutex_init (&batch->lock, NULL));
+  GNUNET_assert (0 == pthread_cond_init (&batch->work_cond, NULL));
+  GNUNET_assert (0 == pthread_cond_init (&batch->done_cond, NULL));
+  while (batch->num_workers + 1 < threads)
+  {
+    if (0 != pthread_create (&batch->workers[batch->num_workers], NULL,
+                             &encoder_main, batch))
+      break; /* the reading thread encodes what the workers do not */
+    batch->num_workers++;
+  }
+#endif
+  return batch;
+}
+
+
+/**
+ * Stop the encoder threads of a batch and free it.
+ *
+ * @param batch batch to destroy
+ */
+static void
+batch_destroy (struct DBlockBatch *batch)
+{
+#if HAVE_PTHREAD_H
+  unsigned int i;
+
+  LOCK (batch);
+  batch->stop = GNUNET_YES;
+  GNUNET_assert (0 == pthread_cond_broadcast (&batch->work_cond));
+  UNLOCK (batch);
+  for (i = 0; i < batch->num_workers; i++)
+    GNUNET_assert (0 == pthread_join (batch->workers[i], NULL));
+  GNUNET_assert (0 == pthread_cond_destroy (&batch->work_cond));
+  GNUNET_assert (0 == pthread_cond_destroy (&batch->done_cond));
+  GNUNET_assert (0 == pthread_mutex_destroy (&batch->lock));
+#endif
+  GNUNET_free (batch->plaintext);
+  GNUNET_free (batch->ciphertext);
+  GNUNET_free (batch->chks);
+  GNUNET_free (batch);
+}
+
+
 /**
  * Initialize a tree encoder.  This function will call @a proc and
  * "progress" on each block in the tree.  Once all blocks have been
@@ -275,6 +594,7 @@ GNUNET_FS_tree_encoder_create (struct GNUNET_FS_Handle *h, uint64_t size,
                                GNUNET_SCHEDULER_Task cont)
 {
   struct GNUNET_FS_TreeEncoder *te;
+  size_t batch_size;
 
   te = GNUNET_new (struct GNUNET_FS_TreeEncoder);
   te->h = h;
@@ -288,6 +608,16 @@ GNUNET_FS_tree_encoder_create (struct GNUNET_FS_Handle *h, uint64_t size,
   te->chk_tree =
       GNUNET_malloc (te->chk_tree_depth * CHK_PER_INODE *
                      sizeof (struct ContentHashKey));
+  te->threads = get_encoder_threads (h);
+  if ( (te->threads > 1) &&
+       (size > DBLOCK_SIZE) )
+  {
+    /* a batch never extends beyond the end of the file */
+    batch_size = (size_t) GNUNET_MIN ((uint64_t) CHK_PER_INODE * DBLOCK_SIZE,
+                                      size);
+    /* if this fails, we fall back to encoding one block at a time */
+    te->batch = batch_create (batch_size, te->threads);
+  }
   GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
 	      "Created tree encoder for file with %llu bytes and depth %u\n",
 	      (unsigned long long) size,
@@ -321,6 +651,71 @@ compute_chk_offset (unsigned int depth, uint64_t end_offset)
 }
 
 
+/**
+ * Read the DBLOCKs up to the end of the current IBLOCK (or file)
+ * into the batch and encode them.  Reading happens in the calling
+ * thread, as readers are not required to be thread-safe; the
+ * encoder threads start on each block as soon as it has been read.
+ * Once everything is read, the calling thread helps encoding.
+ *
+ * @param te tree encoder to fill the batch for
+ */
+static void
+fill_batch (struct GNUNET_FS_TreeEncoder *te)
+{
+  struct DBlockBatch *batch = te->batch;
+  unsigned int want;
+  size_t pt_size;
+  size_t size;
+
+  LOCK (batch);
+  batch->offset = te->publish_offset;
+  batch->size = 0;
+  batch->blocks = 0;
+  batch->next = 0;
+  batch->encoded = 0;
+  batch->filling = GNUNET_YES;
+  batch->read_error = GNUNET_NO;
+  UNLOCK (batch);
+  want = CHK_PER_INODE -
+      (unsigned int) ((te->publish_offset / DBLOCK_SIZE) % CHK_PER_INODE);
+  /* only this thread changes 'size' and 'blocks', so we can read
+     them without the lock; the workers only touch blocks that
+     were fully read */
+  size = 0;
+  while ( (batch->blocks < want) &&
+          (batch->offset + size < te->size) )
+  {
+    pt_size = GNUNET_MIN (DBLOCK_SIZE,
+                          te->size - (batch->offset + size));
+    if (pt_size !=
+        te->reader (te->cls, batch->offset + size, pt_size,
+                    &batch->plaintext[size], &te->emsg))
+    {
+      batch->read_error = GNUNET_YES;
+      break;
+    }
+    size += pt_size;
+    LOCK (batch);
+    batch->size = size;
+    batch->blocks++;
+#if HAVE_PTHREAD_H
+    GNUNET_assert (0 == pthread_cond_signal (&batch->work_cond));
+#endif
+    UNLOCK (batch);
+  }
+  LOCK (batch);
+  batch->filling = GNUNET_NO;
+  while (batch->next < batch->blocks)
+    encode_next_block (batch);
+#if HAVE_PTHREAD_H
+  while (batch->encoded < batch->blocks)
+    GNUNET_assert (0 == pthread_cond_wait (&batch->done_cond, &batch->lock));
+#endif
+  UNLOCK (batch);
+}
+
+
 /**
  * Encrypt the next block of the file (and call proc and progress
  * accordingly; or of course "cont" if we have already completed
@@ -333,15 +728,18 @@ GNUNET_FS_tree_encoder_next (struct GNUNET_FS_TreeEncoder *te)
 {
   struct ContentHashKey *mychk;
   const void *pt_block;
+  const void *enc_block;
   uint16_t pt_size;
   char iob[DBLOCK_SIZE];
   char enc[DBLOCK_SIZE];
-  struct GNUNET_CRYPTO_SymmetricSessionKey sk;
-  struct GNUNET_CRYPTO_SymmetricInitializationVector iv;
+  struct DBlockBatch *batch;
+  size_t boff;
   unsigned int off;
 
   GNUNET_assert (GNUNET_NO == te->in_next);
   te->in_next = GNUNET_YES;
+  enc_block = enc;
+  boff = 0;
   if (te->chk_tree_depth == te->current_depth)
   {
     off = CHK_PER_INODE * (te->chk_tree_depth - 1);
@@ -355,7 +753,29 @@ GNUNET_FS_tree_encoder_next (struct GNUNET_FS_TreeEncoder *te)
     te->cont (te->cls, NULL);
     return;
   }
-  if (0 == te->current_depth)
+  batch = te->batch;
+  if ( (0 == te->current_depth) &&
+       (NULL != batch) )
+  {
+    /* take DBLOCK from the batch, refilling it if needed */
+    if ( (te->publish_offset < batch->offset) ||
+         (te->publish_offset > batch->offset + batch->size) ||
+         ( (te->publish_offset == batch->offset + batch->size) &&
+           (GNUNET_NO == batch->read_error) ) )
+      fill_batch (te);
+    boff = te->publish_offset - batch->offset;
+    if (boff == batch->size)
+    {
+      /* reading this block failed */
+      te->in_next = GNUNET_NO;
+      te->cont (te->cls, NULL);
+      return;
+    }
+    pt_size = GNUNET_MIN (DBLOCK_SIZE, te->size - te->publish_offset);
+    pt_block = &batch->plaintext[boff];
+    enc_block = &batch->ciphertext[boff];
+  }
+  else if (0 == te->current_depth)
   {
     /* read DBLOCK */
     pt_size = GNUNET_MIN (DBLOCK_SIZE, te->size - te->publish_offset);
@@ -381,10 +801,15 @@ GNUNET_FS_tree_encoder_next (struct GNUNET_FS_TreeEncoder *te)
               (unsigned long long) te->publish_offset, te->current_depth,
               (unsigned int) pt_size, (unsigned int) off);
   mychk = &te->chk_tree[te->current_depth * CHK_PER_INODE + off];
-  GNUNET_CRYPTO_hash (pt_block, pt_size, &mychk->key);
-  GNUNET_CRYPTO_hash_to_aes_key (&mychk->key, &sk, &iv);
-  GNUNET_CRYPTO_symmetric_encrypt (pt_block, pt_size, &sk, &iv, enc);
-  GNUNET_CRYPTO_hash (enc, pt_size, &mychk->query);
+  if ( (0 == te->current_depth) &&
+       (NULL != batch) )
+  {
+    *mychk = batch->chks[boff / DBLOCK_SIZE];
+  }
+  else
+  {
+    encode_block (pt_block, pt_size, mychk, enc);
+  }
   GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
               "TE calculates query to be `%s', stored at %u\n",
               GNUNET_h2s (&mychk->query),
@@ -393,7 +818,7 @@ GNUNET_FS_tree_encoder_next (struct GNUNET_FS_TreeEncoder *te)
     te->proc (te->cls, mychk, te->publish_offset, te->current_depth,
               (0 ==
                te->current_depth) ? GNUNET_BLOCK_TYPE_FS_DBLOCK :
-              GNUNET_BLOCK_TYPE_FS_IBLOCK, enc, pt_size);
+              GNUNET_BLOCK_TYPE_FS_IBLOCK, enc_block, pt_size);
   if (NULL != te->progress)
     te->progress (te->cls, te->publish_offset, pt_block, pt_size,
                   te->current_depth);
@@ -456,6 +881,8 @@ GNUNET_FS_tree_encoder_finish (struct GNUNET_FS_TreeEncoder *te,
     *emsg = te->emsg;
   else
     GNUNET_free_non_null (te->emsg);
+  if (NULL != te->batch)
+    batch_destroy (te->batch);
   GNUNET_free (te->chk_tree);
   GNUNET_free (te);
 }
@@ -35,6 +35,70 @@
 #include "gnunet-service-fs_indexing.h"
 #include "fs.h"
 
+/**
+ * Default number of indexed files we keep open.
+ */
+#define DEFAULT_FD_CACHE_SIZE 32
+
+/**
+ * Default number of on-demand encoded blocks we keep in memory.
+ */
+#define DEFAULT_BLOCK_CACHE_SIZE 128
+
+
+struct IndexInfo;
+
+
+/**
+ * An on-demand encoded block kept in memory in case it is
+ * requested again soon.
+ */
+struct CachedBlock
+{
+
+  /**
+   * This is a doubly linked list (LRU, most recently used first).
+   */
+  struct CachedBlock *next;
+
+  /**
+   * This is a doubly linked list (LRU, most recently used first).
+   */
+  struct CachedBlock *prev;
+
+  /**
+   * This is a doubly linked list of the blocks of the same file.
+   */
+  struct CachedBlock *next_file;
+
+  /**
+   * This is a doubly linked list of the blocks of the same file.
+   */
+  struct CachedBlock *prev_file;
+
+  /**
+   * File the block was read from.
+   */
+  struct IndexInfo *ii;
+
+  /**
+   * Query for the (encrypted) block.
+   */
+  struct GNUNET_HashCode query;
+
+  /**
+   * Offset of the block in the file.
+   */
+  uint64_t offset;
+
+  /**
+   * Number of bytes in the block, which follows this struct.
+   */
+  size_t size;
+
+};
+
+
 /**
  * In-memory information about indexed files (also available
  * on-disk).
@@ -74,6 +138,49 @@ struct IndexInfo
    */
   struct GNUNET_HashCode file_id;
 
+  /**
+   * This is a doubly linked list of files with an open
+   * handle (LRU, most recently used first).
+   */
+  struct IndexInfo *next_open;
+
+  /**
+   * This is a doubly linked list of files with an open
+   * handle (LRU, most recently used first).
+   */
+  struct IndexInfo *prev_open;
+
+  /**
+   * Open handle for the file, NULL if not open.
+   */
+  struct GNUNET_DISK_FileHandle *fh;
+
+  /**
+   * Head of the blocks of this file in the block cache.
+   */
+  struct CachedBlock *blocks_head;
+
+  /**
+   * Tail of the blocks of this file in the block cache.
+   */
+  struct CachedBlock *blocks_tail;
+
+  /**
+   * Modification time of the file when we last looked.
+   */
+  time_t mtime;
+
+  /**
+   * Size of the file when we last looked.
+   */
+  off_t fsize;
+
+  /**
+   * Inode of the file when we last looked, so that we notice
+   * if it was replaced.
+   */
+  ino_t ino;
+
 };
 
 
@@ -105,6 +212,46 @@ static const struct GNUNET_CONFIGURATION_Handle *cfg;
  */
 static struct GNUNET_DATASTORE_Handle *dsh;
 
+/**
+ * Head of the LRU list of indexed files with an open handle.
+ */
+static struct IndexInfo *open_files_head;
+
+/**
+ * Tail of the LRU list of indexed files with an open handle.
+ */
+static struct IndexInfo *open_files_tail;
+
+/**
+ * Number of entries in the open files list.
+ */
+static unsigned int open_files_count;
+
+/**
+ * Maximum number of indexed files we keep open.
+ */
+static unsigned long long open_files_max;
+
+/**
+ * Head of the LRU list of cached on-demand encoded blocks.
+ */
+static struct CachedBlock *blocks_head;
+
+/**
+ * Tail of the LRU list of cached on-demand encoded blocks.
+ */
+static struct CachedBlock *blocks_tail;
+
+/**
+ * Maps queries to `struct CachedBlock`s.
+ */
+static struct GNUNET_CONTAINER_MultiHashMap *block_map;
+
+/**
+ * Maximum number of blocks in the block cache, 0 to disable it.
+ */
+static unsigned long long blocks_max;
+
 
 /**
  * Write the current index information list to disk.
@@ -214,6 +361,216 @@ read_index_list ()
 }
 
 
+/**
+ * Remove a block from the block cache.
+ *
+ * @param cb block to remove
+ */
+static void
+drop_cached_block (struct CachedBlock *cb)
+{
+  GNUNET_CONTAINER_DLL_remove (blocks_head,
+                               blocks_tail,
+                               cb);
+  GNUNET_CONTAINER_MDLL_remove (file,
+                                cb->ii->blocks_head,
+                                cb->ii->blocks_tail,
+                                cb);
+  GNUNET_assert (GNUNET_YES ==
+                 GNUNET_CONTAINER_multihashmap_remove (block_map,
+                                                       &cb->query,
+                                                       cb));
+  GNUNET_free (cb);
+}
+
+
+/**
+ * Add an encoded block to the block cache, evicting the least
+ * recently used block if the cache is full.
+ *
+ * @param ii file the block was read from
+ * @param query query for the block
+ * @param offset offset of the block in the file
+ * @param data encoded block
+ * @param size number of bytes in @a data
+ */
+static void
+cache_block (struct IndexInfo *ii,
+             const struct GNUNET_HashCode *query,
+             uint64_t offset,
+             const void *data,
+             size_t size)
+{
+  struct CachedBlock *cb;
+
+  if (0 == blocks_max)
+    return;
+  cb = GNUNET_CONTAINER_multihashmap_get (block_map, query);
+  if (NULL != cb)
+    drop_cached_block (cb);
+  else if (GNUNET_CONTAINER_multihashmap_size (block_map) >= blocks_max)
+    drop_cached_block (blocks_tail);
+  cb = GNUNET_malloc (sizeof (struct CachedBlock) + size);
+  cb->ii = ii;
+  cb->query = *query;
+  cb->offset = offset;
+  cb->size = size;
+  memcpy (&cb[1], data, size);
+  GNUNET_assert (GNUNET_OK ==
+                 GNUNET_CONTAINER_multihashmap_put (block_map,
+                                                    &cb->query,
+                                                    cb,
+                                                    GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_FAST));
+  GNUNET_CONTAINER_DLL_insert (blocks_head,
+                               blocks_tail,
+                               cb);
+  GNUNET_CONTAINER_MDLL_insert (file,
+                                ii->blocks_head,
+                                ii->blocks_tail,
+                                cb);
+}
+
+
+/**
+ * Close the cached handle of an indexed file (if open).
+ *
+ * @param ii file to close
+ */
+static void
+close_index_file (struct IndexInfo *ii)
+{
+  if (NULL == ii->fh)
+    return;
+  GNUNET_break (GNUNET_OK == GNUNET_DISK_file_close (ii->fh));
+  ii->fh = NULL;
+  GNUNET_CONTAINER_MDLL_remove (open,
+                                open_files_head,
+                                open_files_tail,
+                                ii);
+  open_files_count--;
+}
+
+
+/**
+ * Forget all cached state for an indexed file: close its
+ * handle and drop its blocks from the block cache.
+ *
+ * @param ii file to forget the state of
+ */
+static void
+flush_index_file (struct IndexInfo *ii)
+{
+  close_index_file (ii);
+  while (NULL != ii->blocks_head)
+    drop_cached_block (ii->blocks_head);
+}
+
+
+/**
+ * Check that an indexed file still exists.  If it was modified
+ * or replaced since we last looked, flush our cached state for it.
+ *
+ * @param ii file to check
+ * @return #GNUNET_OK if the file exists
+ */
+static int
+check_index_file (struct IndexInfo *ii)
+{
+  struct stat sbuf;
+
+  if (0 != STAT (ii->filename, &sbuf))
+  {
+    flush_index_file (ii);
+    return GNUNET_SYSERR;
+  }
+  if ( (sbuf.st_mtime != ii->mtime) ||
+       (sbuf.st_size != ii->fsize) ||
+       (sbuf.st_ino != ii->ino) )
+  {
+    if ( (NULL != ii->fh) ||
+         (NULL != ii->blocks_head) )
+      GNUNET_STATISTICS_update (GSF_stats,
+                                gettext_noop
+                                ("# indexed files found modified"),
+                                1, GNUNET_NO);
+    flush_index_file (ii);
+    ii->mtime = sbuf.st_mtime;
+    ii->fsize = sbuf.st_size;
+    ii->ino = sbuf.st_ino;
+  }
+  return GNUNET_OK;
+}
+
+
+/**
+ * Get an open handle for an indexed file, using the cached
+ * handle if we have one.
+ *
+ * @param ii file to open
+ * @return handle for the file, NULL on error
+ */
+static struct GNUNET_DISK_FileHandle *
+open_index_file (struct IndexInfo *ii)
+{
+  if (NULL != ii->fh)
+  {
+    GNUNET_STATISTICS_update (GSF_stats,
+                              gettext_noop ("# indexed file handle cache hits"),
+                              1, GNUNET_NO);
+    GNUNET_CONTAINER_MDLL_remove (open,
+                                  open_files_head,
+                                  open_files_tail,
+                                  ii);
+    GNUNET_CONTAINER_MDLL_insert (open,
+                                  open_files_head,
+                                  open_files_tail,
+                                  ii);
+    return ii->fh;
+  }
+  GNUNET_STATISTICS_update (GSF_stats,
+                            gettext_noop ("# indexed file handle cache misses"),
+                            1, GNUNET_NO);
+  ii->fh = GNUNET_DISK_file_open (ii->filename, GNUNET_DISK_OPEN_READ,
+                                  GNUNET_DISK_PERM_NONE);
+  if (NULL == ii->fh)
+    return NULL;
+  GNUNET_CONTAINER_MDLL_insert (open,
+                                open_files_head,
+                                open_files_tail,
+                                ii);
+  open_files_count++;
+  if (open_files_count > open_files_max)
+    close_index_file (open_files_tail);
+  return ii->fh;
+}
+
+
+/**
+ * Read (up to) a block from an indexed file at the given offset,
+ * without changing the file position where possible.
+ *
+ * @param fh file to read from
+ * @param off offset to read at
+ * @param buf where to store the data
+ * @param size number of bytes to read at most
+ * @return number of bytes read, -1 on error
+ */
+static ssize_t
+read_index_block (struct GNUNET_DISK_FileHandle *fh,
+                  uint64_t off,
+                  void *buf,
+                  size_t size)
+{
+#if WINDOWS
+  if (off != GNUNET_DISK_file_seek (fh, off, GNUNET_DISK_SEEK_SET))
+    return -1;
+  return GNUNET_DISK_file_read (fh, buf, size);
+#else
+  return pread (fh->fd, buf, size, (off_t) off);
+#endif
+}
+
+
 /**
  * We've validated the hash of the file we're about to index.  Signal
  * success to the client and update our internal data structures.
@@ -441,6 +798,7 @@ GNUNET_FS_handle_unindex (void *cls, struct GNUNET_SERVER_Client *client,
       GNUNET_break (GNUNET_OK ==
                     GNUNET_CONTAINER_multihashmap_remove (ifm, &pos->file_id,
 							  pos));
+      flush_index_file (pos);
       GNUNET_free (pos);
       found = GNUNET_YES;
       break;
@@ -518,6 +876,7 @@ GNUNET_FS_handle_on_demand_block (const struct GNUNET_HashCode * key, uint32_t s
   struct GNUNET_DISK_FileHandle *fh;
   uint64_t off;
   struct IndexInfo *ii;
+  struct CachedBlock *cb;
 
   if (size != sizeof (struct OnDemandBlock))
   {
@@ -535,7 +894,7 @@ GNUNET_FS_handle_on_demand_block (const struct GNUNET_HashCode * key, uint32_t s
     return GNUNET_SYSERR;
   }
   fn = ii->filename;
-  if ((NULL == fn) || (0 != ACCESS (fn, R_OK)))
+  if ((NULL == fn) || (GNUNET_OK != check_index_file (ii)))
   {
     GNUNET_STATISTICS_update (GSF_stats,
                               gettext_noop
@@ -545,25 +904,44 @@ GNUNET_FS_handle_on_demand_block (const struct GNUNET_HashCode * key, uint32_t s
                              GNUNET_TIME_UNIT_FOREVER_REL, &remove_cont, NULL);
     return GNUNET_SYSERR;
   }
-  if ((NULL ==
-       (fh =
-        GNUNET_DISK_file_open (fn, GNUNET_DISK_OPEN_READ,
-                               GNUNET_DISK_PERM_NONE))) ||
-      (off != GNUNET_DISK_file_seek (fh, off, GNUNET_DISK_SEEK_SET)) ||
-      (-1 == (nsize = GNUNET_DISK_file_read (fh, ndata, sizeof (ndata)))))
+  cb = GNUNET_CONTAINER_multihashmap_get (block_map, key);
+  if ( (NULL != cb) &&
+       (cb->ii == ii) &&
+       (cb->offset == off) )
+  {
+    GNUNET_STATISTICS_update (GSF_stats,
+                              gettext_noop ("# on-demand block cache hits"),
+                              1, GNUNET_NO);
+    GNUNET_CONTAINER_DLL_remove (blocks_head,
+                                 blocks_tail,
+                                 cb);
+    GNUNET_CONTAINER_DLL_insert (blocks_head,
+                                 blocks_tail,
+                                 cb);
+    /* copy, as 'cont' may cause the block to be evicted */
+    nsize = cb->size;
+    memcpy (edata, &cb[1], nsize);
+    cont (cont_cls, key, nsize, edata, GNUNET_BLOCK_TYPE_FS_DBLOCK, priority,
+          anonymity, expiration, uid);
+    return GNUNET_OK;
+  }
+  if (0 != blocks_max)
+    GNUNET_STATISTICS_update (GSF_stats,
+                              gettext_noop ("# on-demand block cache misses"),
+                              1, GNUNET_NO);
+  if ((NULL == (fh = open_index_file (ii))) ||
+      (-1 == (nsize = read_index_block (fh, off, ndata, sizeof (ndata)))))
   {
     GNUNET_log (GNUNET_ERROR_TYPE_WARNING,
                 _
                 ("Could not access indexed file `%s' (%s) at offset %llu: %s\n"),
                 GNUNET_h2s (&odb->file_id), fn, (unsigned long long) off,
                 (fn == NULL) ? _("not indexed") : STRERROR (errno));
-    if (fh != NULL)
-      GNUNET_DISK_file_close (fh);
+    close_index_file (ii);
     GNUNET_DATASTORE_remove (dsh, key, size, data, -1, -1,
                              GNUNET_TIME_UNIT_FOREVER_REL, &remove_cont, NULL);
     return GNUNET_SYSERR;
   }
-  GNUNET_DISK_file_close (fh);
   GNUNET_CRYPTO_hash (ndata, nsize, &nkey);
   GNUNET_CRYPTO_hash_to_aes_key (&nkey, &skey, &iv);
   GNUNET_CRYPTO_symmetric_encrypt (ndata, nsize, &skey, &iv, edata);
@@ -579,6 +957,7 @@ GNUNET_FS_handle_on_demand_block (const struct GNUNET_HashCode * key, uint32_t s
   }
   GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
               "On-demand encoded block for query `%s'\n", GNUNET_h2s (key));
+  cache_block (ii, key, off, edata, nsize);
   cont (cont_cls, key, nsize, edata, GNUNET_BLOCK_TYPE_FS_DBLOCK, priority,
         anonymity, expiration, uid);
   return GNUNET_OK;
@@ -603,10 +982,13 @@ GNUNET_FS_indexing_done ()
     GNUNET_break (GNUNET_OK ==
 		  GNUNET_CONTAINER_multihashmap_remove (ifm,
 							&pos->file_id, pos));
+    flush_index_file (pos);
     GNUNET_free (pos);
   }
   GNUNET_CONTAINER_multihashmap_destroy (ifm);
   ifm = NULL;
+  GNUNET_CONTAINER_multihashmap_destroy (block_map);
+  block_map = NULL;
   cfg = NULL;
 }
 
@@ -623,7 +1005,19 @@ GNUNET_FS_indexing_init (const struct GNUNET_CONFIGURATION_Handle *c,
 {
   cfg = c;
   dsh = d;
+  if (GNUNET_OK !=
+      GNUNET_CONFIGURATION_get_value_number (cfg, "fs", "INDEX_FD_CACHE_SIZE",
+                                             &open_files_max))
+    open_files_max = DEFAULT_FD_CACHE_SIZE;
+  if (GNUNET_OK !=
+      GNUNET_CONFIGURATION_get_value_number (cfg, "fs", "INDEX_BLOCK_CACHE_SIZE",
+                                             &blocks_max))
+    blocks_max = DEFAULT_BLOCK_CACHE_SIZE;
+  if (0 == open_files_max)
+    open_files_max = 1; /* we need the handle while reading */
   ifm = GNUNET_CONTAINER_multihashmap_create (128, GNUNET_YES);
+  block_map = GNUNET_CONTAINER_multihashmap_create (GNUNET_MAX (blocks_max, 16),
+                                                    GNUNET_YES);
   read_index_list ();
   return GNUNET_OK;
 }
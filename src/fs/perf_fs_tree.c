@@ -0,0 +1,191 @@
+/*
+     This file is part of GNUnet.
+     (C) 2014 Christian Grothoff (and other contributing authors)
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+     Boston, MA 02111-1307, USA.
+*/
+
+/**
+ * @file fs/perf_fs_tree.c
+ * @brief measure how fast the tree encoder computes the CHK tree
+ *        (as done when publishing) of a large synthetic file,
+ *        with and without parallel encoding of DBLOCKs
+ */
+#include "platform.h"
+#include "fs_tree.h"
+#include <gauger.h>
+
+/**
+ * Default size of the synthetic file in MiB (4 GiB).
+ */
+#define DEFAULT_FILE_SIZE_MB 4096
+
+/**
+ * Size of the file we encode.
+ */
+static uint64_t file_size;
+
+/**
+ * Set once the encoder called its continuation.
+ */
+static int done;
+
+/**
+ * Number of blocks the encoder passed to #block_proc.
+ */
+static unsigned long long blocks;
+
+
+/**
+ * Produce the synthetic file contents; every DBLOCK is distinct.
+ *
+ * @param cls NULL
+ * @param offset offset to read from
+ * @param max number of bytes to read
+ * @param buf where to write the data
+ * @param emsg location for an error message
+ * @return @a max
+ */
+static size_t
+data_reader (void *cls, uint64_t offset, size_t max, void *buf, char **emsg)
+{
+  uint64_t nbo;
+
+  if (UINT64_MAX == offset)
+    return 0;
+  memset (buf, (int) (offset / DBLOCK_SIZE), max);
+  nbo = GNUNET_htonll (offset);
+  memcpy (buf, &nbo, GNUNET_MIN (max, sizeof (nbo)));
+  return max;
+}
+
+
+static void
+block_proc (void *cls,
+            const struct ContentHashKey *chk,
+            uint64_t offset,
+            unsigned int depth,
+            enum GNUNET_BLOCK_Type type,
+            const void *block,
+            uint16_t block_size)
+{
+  blocks++;
+}
+
+
+static void
+encoder_done (void *cls,
+              const struct GNUNET_SCHEDULER_TaskContext *tc)
+{
+  done = GNUNET_YES;
+}
+
+
+/**
+ * Encode the synthetic file and report the throughput.
+ *
+ * @param cfg configuration to use
+ * @param threads value for the ENCODER_THREADS option
+ * @return URI of the file, NULL on error
+ */
+static struct GNUNET_FS_Uri *
+measure (struct GNUNET_CONFIGURATION_Handle *cfg,
+         unsigned long long threads)
+{
+  struct GNUNET_FS_Handle *fs;
+  struct GNUNET_FS_TreeEncoder *te;
+  struct GNUNET_FS_Uri *uri;
+  struct GNUNET_TIME_Absolute start;
+  struct GNUNET_TIME_Relative duration;
+  char name[64];
+  char *emsg;
+
+  GNUNET_CONFIGURATION_set_value_number (cfg, "fs", "ENCODER_THREADS",
+                                         threads);
+  fs = GNUNET_FS_start (cfg, "perf-fs-tree", NULL, NULL,
+                        GNUNET_FS_FLAGS_NONE, GNUNET_FS_OPTIONS_END);
+  done = GNUNET_NO;
+  blocks = 0;
+  start = GNUNET_TIME_absolute_get ();
+  te = GNUNET_FS_tree_encoder_create (fs, file_size, NULL,
+                                      &data_reader, &block_proc, NULL,
+                                      &encoder_done);
+  while (GNUNET_NO == done)
+    GNUNET_FS_tree_encoder_next (te);
+  duration = GNUNET_TIME_absolute_get_duration (start);
+  uri = GNUNET_FS_tree_encoder_get_uri (te);
+  GNUNET_FS_tree_encoder_finish (te, &emsg);
+  GNUNET_FS_stop (fs);
+  if (NULL != emsg)
+  {
+    fprintf (stderr, "Encoding failed: %s\n", emsg);
+    GNUNET_free (emsg);
+  }
+  printf ("%s: %llu MiB (%llu blocks) took %s (%llu MB/s)\n",
+          (0 == threads) ? "parallel encoder" : "single thread",
+          (unsigned long long) (file_size / 1024 / 1024),
+          blocks,
+          GNUNET_STRINGS_relative_time_to_string (duration, GNUNET_YES),
+          (unsigned long long) (file_size / (1 + duration.rel_value_us)));
+  GNUNET_snprintf (name, sizeof (name),
+                   "Tree encoder (%s)",
+                   (0 == threads) ? "parallel" : "single thread");
+  GAUGER ("FS", name,
+          file_size / (1 + duration.rel_value_us),
+          "MB/s");
+  return uri;
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  struct GNUNET_CONFIGURATION_Handle *cfg;
+  struct GNUNET_FS_Uri *uri1;
+  struct GNUNET_FS_Uri *uri2;
+  unsigned long long mb;
+  int ret;
+
+  GNUNET_log_setup ("perf-fs-tree", "WARNING", NULL);
+  mb = DEFAULT_FILE_SIZE_MB;
+  if ( (argc > 1) &&
+       (1 != sscanf (argv[1], "%llu", &mb)) )
+  {
+    fprintf (stderr, "Usage: %s [FILE_SIZE_MB]\n", argv[0]);
+    return 1;
+  }
+  /* not a multiple of the block size, to cover partial blocks */
+  file_size = mb * 1024 * 1024 + 12345;
+  cfg = GNUNET_CONFIGURATION_create ();
+  uri1 = measure (cfg, 1);
+  uri2 = measure (cfg, 0);
+  ret = 0;
+  if ( (NULL == uri1) ||
+       (NULL == uri2) ||
+       (GNUNET_YES != GNUNET_FS_uri_test_equal (uri1, uri2)) )
+  {
+    fprintf (stderr, "Parallel encoder produced a different URI!\n");
+    ret = 1;
+  }
+  if (NULL != uri1)
+    GNUNET_FS_uri_destroy (uri1);
+  if (NULL != uri2)
+    GNUNET_FS_uri_destroy (uri2);
+  GNUNET_CONFIGURATION_destroy (cfg);
+  return ret;
+}
+
+/* end of perf_fs_tree.c */
@@ -262,7 +262,7 @@ zone_iterator (void *cls,
     GNUNET_SCHEDULER_shutdown ();
     return;
   }
-  GNUNET_NAMESTORE_zone_iterator_next (list_it);
+  GNUNET_NAMESTORE_zone_iterator_next (list_it, 1);
 }
 
 /**
@@ -330,7 +330,7 @@ publish_zone_dht_next (void *cls,
                        const struct GNUNET_SCHEDULER_TaskContext *tc)
 {
   zone_publish_task = GNUNET_SCHEDULER_NO_TASK;
-  GNUNET_NAMESTORE_zone_iterator_next (namestore_iter);
+  GNUNET_NAMESTORE_zone_iterator_next (namestore_iter, 1);
 }
 
 
@@ -72,6 +72,19 @@ void
 GNUNET_CLIENT_disconnect (struct GNUNET_CLIENT_Connection *client);
 
 
+/**
+ * Check if messages to the service may be passed through a
+ * shared-memory ring: the connection must run over a UNIX domain
+ * socket and the service's configuration must set the option
+ * "SHM_RING" to YES.
+ *
+ * @param client handle to the service connection
+ * @return #GNUNET_YES if a ring may be offered, #GNUNET_NO if not
+ */
+int
+GNUNET_CLIENT_test_shm_ring_ (struct GNUNET_CLIENT_Connection *client);
+
+
 /**
  * Type of a function to call when we receive a message
  * from the service.
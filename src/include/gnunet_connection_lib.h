@@ -229,6 +229,20 @@ GNUNET_CONNECTION_get_address (struct GNUNET_CONNECTION_Handle *connection,
                                void **addr, size_t * addrlen);
 
 
+/**
+ * Obtain the credentials of the other party, which must be
+ * connected to us over a UNIX domain socket.
+ *
+ * @param connection the connection
+ * @param gc where to store the credentials
+ * @return #GNUNET_OK on success, #GNUNET_SYSERR if the connection
+ *         is not over a UNIX domain socket or the platform cannot tell
+ */
+int
+GNUNET_CONNECTION_get_credentials (struct GNUNET_CONNECTION_Handle *connection,
+                                   struct GNUNET_CONNECTION_Credentials *gc);
+
+
 /**
  * Close the connection and free associated resources.  There must
  * not be any pending requests for reading or writing to the
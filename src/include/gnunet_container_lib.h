@@ -632,6 +632,20 @@ GNUNET_CONTAINER_multihashmap_create (unsigned int len,
 				      int do_not_copy_keys);
 
 
+/**
+ * @ingroup hashmap
+ * Create a multi hash map that uses open addressing instead of
+ * chaining.  Keys are always copied.  Removing entries while
+ * iterating is safe, but adding entries during an iteration may
+ * result in entries being skipped or visited again.
+ *
+ * @param len initial size (map will grow as needed)
+ * @return NULL on error
+ */
+struct GNUNET_CONTAINER_MultiHashMap *
+GNUNET_CONTAINER_multihashmap_create_flat (unsigned int len);
+
+
 /**
  * @ingroup hashmap
  * Destroy a hash map.  Will not free any values
@@ -1736,7 +1750,10 @@ typedef int (*GNUNET_CONTAINER_HeapIterator) (void *cls,
 
 /**
  * @ingroup heap
- * Iterate over all entries in the heap.
+ * Iterate over all entries in the heap.  The iterator may remove
+ * nodes from the heap (removed nodes are not visited anymore);
+ * nodes inserted during the iteration may or may not be visited.
+ * The iterator must not iterate over the same heap again.
  *
  * @param heap the heap
  * @param iterator function to call on each entry
@@ -536,6 +536,74 @@ GNUNET_CRYPTO_symmetric_decrypt (const void *block, size_t size,
                                  void *result);
 
 
+/**
+ * @ingroup crypto
+ * Handle to a symmetric session key with the cipher state already
+ * set up, for repeated encryption or decryption with the same key.
+ */
+struct GNUNET_CRYPTO_SymmetricContext;
+
+
+/**
+ * @ingroup crypto
+ * Set up the ciphers for a session key so that many blocks can be
+ * processed without re-initializing the key schedule each time.
+ *
+ * @param sessionkey the key to use
+ * @return the context, NULL on error
+ */
+struct GNUNET_CRYPTO_SymmetricContext *
+GNUNET_CRYPTO_symmetric_context_create (const struct GNUNET_CRYPTO_SymmetricSessionKey *sessionkey);
+
+
+/**
+ * @ingroup crypto
+ * Destroy a symmetric context, wiping the key material.
+ *
+ * @param ctx context to destroy
+ */
+void
+GNUNET_CRYPTO_symmetric_context_destroy (struct GNUNET_CRYPTO_SymmetricContext *ctx);
+
+
+/**
+ * @ingroup crypto
+ * Encrypt a block using a prepared symmetric context.  Produces the
+ * same output as #GNUNET_CRYPTO_symmetric_encrypt() with the key the
+ * context was created with.
+ *
+ * @param ctx the context to use
+ * @param block the block to encrypt
+ * @param size the size of the @a block
+ * @param iv the initialization vector to use
+ * @param result where to store the result, can be the same as @a block
+ * @return the size of the encrypted block, -1 for errors
+ */
+ssize_t
+GNUNET_CRYPTO_symmetric_context_encrypt (struct GNUNET_CRYPTO_SymmetricContext *ctx,
+                                         const void *block, size_t size,
+                                         const struct GNUNET_CRYPTO_SymmetricInitializationVector *iv,
+                                         void *result);
+
+
+/**
+ * @ingroup crypto
+ * Decrypt a block using a prepared symmetric context.
+ *
+ * @param ctx the context to use
+ * @param block the data to decrypt
+ * @param size the size of the @a block
+ * @param iv the initialization vector to use
+ * @param result where to store the result, can be the same as @a block
+ * @return -1 on failure, size of decrypted block on success
+ */
+ssize_t
+GNUNET_CRYPTO_symmetric_context_decrypt (struct GNUNET_CRYPTO_SymmetricContext *ctx,
+                                         const void *block, size_t size,
+                                         const struct GNUNET_CRYPTO_SymmetricInitializationVector *iv,
+                                         void *result);
+
+
 /**
  * @ingroup crypto
  * @brief Derive an IV
@@ -926,6 +994,203 @@ GNUNET_CRYPTO_kdf (void *result, size_t out_len, const void *xts,
                    size_t xts_len, const void *skm, size_t skm_len, ...);
 
 
+/**
+ * @ingroup hash
+ * Calculate a proof-of-work hash (SCRYPT with a small cost).
+ *
+ * @param salt salt to use, specific to the type of the proof
+ * @param buf data to hash
+ * @param buf_len number of bytes in @a buf
+ * @param result where to write the resulting hash
+ */
+void
+GNUNET_CRYPTO_pow_hash (const char *salt,
+                        const void *buf,
+                        size_t buf_len,
+                        struct GNUNET_HashCode *result);
+
+
+/**
+ * @ingroup hash
+ * Count the number of leading zero bits in a hash.
+ *
+ * @param hash hash to count the leading zero bits of
+ * @return the number of leading zero bits
+ */
+unsigned int
+GNUNET_CRYPTO_hash_count_leading_zeros (const struct GNUNET_HashCode *hash);
+
+
+/**
+ * Handle for a search for a proof of work.
+ */
+struct GNUNET_CRYPTO_PowSearch;
+
+
+/**
+ * Function called with the progress or the result of a search
+ * for a proof of work.
+ *
+ * @param cls closure
+ * @param pow if @a found is #GNUNET_YES, the proof of work;
+ *        otherwise, all values below @a pow have been tested and
+ *        a later search can resume at @a pow
+ * @param hash_rate number of hashes per second calculated since
+ *        the last call
+ * @param found #GNUNET_YES if @a pow is a proof of work; the search
+ *        is then over and its handle must no longer be used
+ */
+typedef void
+(*GNUNET_CRYPTO_PowSearchCallback) (void *cls,
+                                    uint64_t pow,
+                                    uint64_t hash_rate,
+                                    int found);
+
+
+/**
+ * @ingroup hash
+ * Search for a proof of work, that is a value @e pow such that the
+ * #GNUNET_CRYPTO_pow_hash() of @e pow (in host byte order) followed
+ * by @a data has at least @a matching_bits leading zero bits.  Values
+ * are tested in worker threads running at the lowest priority; if
+ * threads are not available, the search runs in the scheduler at
+ * idle priority.
+ *
+ * @param salt salt for #GNUNET_CRYPTO_pow_hash()
+ * @param data data to prove work for
+ * @param data_size number of bytes in @a data
+ * @param start first value to test
+ * @param matching_bits number of leading zero bits required
+ * @param threads number of worker threads, 0 for one per CPU
+ * @param delay pause between rounds when searching in the scheduler
+ * @param progress_freq how often to report progress
+ * @param cb function to call with the progress and the result
+ * @param cb_cls closure for @a cb
+ * @return handle to stop the search
+ */
+struct GNUNET_CRYPTO_PowSearch *
+GNUNET_CRYPTO_pow_search_start (const char *salt,
+                                const void *data,
+                                size_t data_size,
+                                uint64_t start,
+                                unsigned int matching_bits,
+                                unsigned int threads,
+                                struct GNUNET_TIME_Relative delay,
+                                struct GNUNET_TIME_Relative progress_freq,
+                                GNUNET_CRYPTO_PowSearchCallback cb,
+                                void *cb_cls);
+
+
+/**
+ * @ingroup hash
+ * Stop a search for a proof of work.
+ *
+ * @param ps search to stop
+ * @return value at which a later search can resume
+ */
+uint64_t
+GNUNET_CRYPTO_pow_search_stop (struct GNUNET_CRYPTO_PowSearch *ps);
+
+
+/**
+ * @ingroup crypto
+ * Handle for a pool of threads performing cryptographic work (such
+ * as signature verification) outside of the scheduler thread.
+ */
+struct GNUNET_CRYPTO_WorkerPool;
+
+
+/**
+ * @ingroup crypto
+ * Handle for a job submitted to a worker pool.
+ */
+struct GNUNET_CRYPTO_WorkerJob;
+
+
+/**
+ * @ingroup crypto
+ * Function run by a worker thread.  It must only access its
+ * closure and otherwise use thread-safe functions, such as hashing
+ * or signature verification.
+ *
+ * @param cls closure
+ * @return result to pass to the continuation, i.e. #GNUNET_OK
+ */
+typedef int
+(*GNUNET_CRYPTO_WorkerFunction) (void *cls);
+
+
+/**
+ * @ingroup crypto
+ * Function called from the scheduler with the result of a job.
+ *
+ * @param cls closure
+ * @param result value returned by the #GNUNET_CRYPTO_WorkerFunction
+ */
+typedef void
+(*GNUNET_CRYPTO_WorkerContinuation) (void *cls,
+                                     int result);
+
+
+/**
+ * @ingroup crypto
+ * Create a pool of threads for cryptographic work.  The threads
+ * are started when jobs are submitted.  If threads are not
+ * available, jobs are run (in batches) by the scheduler.
+ *
+ * @param threads maximum number of threads, 0 for one per CPU
+ * @return the pool
+ */
+struct GNUNET_CRYPTO_WorkerPool *
+GNUNET_CRYPTO_worker_pool_create (unsigned int threads);
+
+
+/**
+ * @ingroup crypto
+ * Destroy a worker pool.  Continuations of jobs that are still
+ * pending are not called; jobs being run are completed first.
+ *
+ * @param pool pool to destroy
+ */
+void
+GNUNET_CRYPTO_worker_pool_destroy (struct GNUNET_CRYPTO_WorkerPool *pool);
+
+
+/**
+ * @ingroup crypto
+ * Submit a job to a worker pool.  Jobs submitted together are
+ * handed to the workers and passed back to the scheduler in
+ * batches.
+ *
+ * @param pool pool to use
+ * @param work function to run in a worker thread
+ * @param work_cls closure for @a work, must remain valid until
+ *        @a cont was called or the job was cancelled
+ * @param cont function to call (from the scheduler) with the result
+ * @param cont_cls closure for @a cont
+ * @return handle to cancel the job
+ */
+struct GNUNET_CRYPTO_WorkerJob *
+GNUNET_CRYPTO_worker_pool_submit (struct GNUNET_CRYPTO_WorkerPool *pool,
+                                  GNUNET_CRYPTO_WorkerFunction work,
+                                  void *work_cls,
+                                  GNUNET_CRYPTO_WorkerContinuation cont,
+                                  void *cont_cls);
+
+
+/**
+ * @ingroup crypto
+ * Cancel a job.  If a worker is currently running the job, this
+ * waits for it to finish.  The continuation is not called.  Must
+ * not be used once the continuation returned; calling it from the
+ * continuation of the job itself has no effect.
+ *
+ * @param job job to cancel
+ */
+void
+GNUNET_CRYPTO_worker_job_cancel (struct GNUNET_CRYPTO_WorkerJob *job);
+
+
 /**
  * @ingroup crypto
  * Extract the public key for the given private key.
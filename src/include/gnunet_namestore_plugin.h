@@ -42,12 +42,15 @@ extern "C"
  * Function called by for each matching record.
  *
  * @param cls closure
+ * @param serial unique serial number of the record, increases
+ *        with every store; used to continue zone iterations
  * @param zone_key private key of the zone
  * @param label name that is being mapped (at most 255 characters long)
  * @param rd_count number of entries in @a rd array
  * @param rd array of records with data to store
  */
 typedef void (*GNUNET_NAMESTORE_RecordIterator) (void *cls,
+						 uint64_t serial,
 						 const struct GNUNET_CRYPTO_EcdsaPrivateKey *private_key,
 						 const char *label,
 						 unsigned int rd_count,
@@ -101,18 +104,22 @@ struct GNUNET_NAMESTORE_PluginFunctions
 
   /**
    * Iterate over the results for a particular zone in the
-   * datastore.  Will return at most one result to the iterator.
+   * datastore, in the order of their serial numbers.  Will return
+   * at most @a limit results to the iterator.
    *
    * @param cls closure (internal context for the plugin)
    * @param zone private key of the zone, NULL for all zones
-   * @param offset offset in the list of all matching records
+   * @param serial only return records with a serial number larger
+   *        than this; 0 to start at the beginning
+   * @param limit maximum number of results to return
    * @param iter function to call with the result
    * @param iter_cls closure for @a iter
    * @return #GNUNET_OK on success, #GNUNET_NO if there were no results, #GNUNET_SYSERR on error
    */
   int (*iterate_records) (void *cls,
 			  const struct GNUNET_CRYPTO_EcdsaPrivateKey *zone,
-			  uint64_t offset,
+			  uint64_t serial,
+			  uint64_t limit,
 			  GNUNET_NAMESTORE_RecordIterator iter, void *iter_cls);
 
 
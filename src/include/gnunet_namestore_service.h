@@ -230,12 +230,20 @@ GNUNET_NAMESTORE_zone_iteration_start (struct GNUNET_NAMESTORE_Handle *h,
 
 /**
  * Calls the record processor specified in #GNUNET_NAMESTORE_zone_iteration_start
- * for the next record.
+ * for the next record(s).  The processor will be called up to @a limit
+ * times; if fewer records remain, it is then called once more with a
+ * label of NULL to signal the end of the iteration.  The next call to
+ * this function should only be made once @a limit results have been
+ * received.
  *
  * @param it the iterator
+ * @param limit number of records to return to the iterator in one shot
+ *        (before #GNUNET_NAMESTORE_zone_iterator_next is to be called again),
+ *        must be larger than zero
  */
 void
-GNUNET_NAMESTORE_zone_iterator_next (struct GNUNET_NAMESTORE_ZoneIterator *it);
+GNUNET_NAMESTORE_zone_iterator_next (struct GNUNET_NAMESTORE_ZoneIterator *it,
+                                     uint64_t limit);
 
 
 /**
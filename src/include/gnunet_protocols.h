@@ -72,6 +72,21 @@ extern "C"
  */
 #define GNUNET_MESSAGE_TYPE_RESOLVER_RESPONSE 5
 
+/*******************************************************************************
+ * UTIL shared-memory ring message types
+ ******************************************************************************/
+
+/**
+ * Client asks the service to read further messages from a
+ * shared-memory ring.
+ */
+#define GNUNET_MESSAGE_TYPE_SHM_RING_OFFER 6
+
+/**
+ * Client wakes up the service to read from the shared-memory ring.
+ */
+#define GNUNET_MESSAGE_TYPE_SHM_RING_DOORBELL 7
+
 /*******************************************************************************
  * ARM message types
  ******************************************************************************/
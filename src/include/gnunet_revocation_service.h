@@ -139,6 +139,26 @@ GNUNET_REVOCATION_check_pow (const struct GNUNET_CRYPTO_EcdsaPublicKey *key,
 			     unsigned int matching_bits);
 
 
+/**
+ * Search for a proof of work for revoking the given key.
+ *
+ * @param key key to revoke
+ * @param start first proof-of-work value to test
+ * @param matching_bits how many bits must match (configuration)
+ * @param threads number of worker threads, 0 for one per CPU
+ * @param cb function to call with the progress and the result
+ * @param cb_cls closure for @a cb
+ * @return handle to stop the search with #GNUNET_CRYPTO_pow_search_stop()
+ */
+struct GNUNET_CRYPTO_PowSearch *
+GNUNET_REVOCATION_pow_search_start (const struct GNUNET_CRYPTO_EcdsaPublicKey *key,
+                                    uint64_t start,
+                                    unsigned int matching_bits,
+                                    unsigned int threads,
+                                    GNUNET_CRYPTO_PowSearchCallback cb,
+                                    void *cb_cls);
+
+
 /**
  * Create a revocation signature.
  *
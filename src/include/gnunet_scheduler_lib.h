@@ -37,6 +37,11 @@ extern "C"
 #endif
 #endif
 
+/**
+ * Configuration handle (see gnunet_configuration_lib.h).
+ */
+struct GNUNET_CONFIGURATION_Handle;
+
 /**
  * Opaque reference to a task.
  */
@@ -604,6 +609,21 @@ GNUNET_SCHEDULER_set_select (GNUNET_SCHEDULER_select new_select,
                              void *new_select_cls);
 
 
+/**
+ * Configure the scheduler based on the given configuration.  The
+ * "BACKEND" option in section "[scheduler]" selects the event
+ * notification mechanism ("select" or "epoll") used by the next call
+ * to #GNUNET_SCHEDULER_run().  The epoll backend is only used if no
+ * custom select function was set with #GNUNET_SCHEDULER_set_select().
+ *
+ * @param cfg configuration to use
+ * @return #GNUNET_OK on success, #GNUNET_NO if the requested
+ *         backend is not available and we fall back to select()
+ */
+int
+GNUNET_SCHEDULER_configure (const struct GNUNET_CONFIGURATION_Handle *cfg);
+
+
 /** @} */ /* end of group scheduler */
 
 #if 0                           /* keep Emacsens' auto-indent happy */
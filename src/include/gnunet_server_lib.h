@@ -834,6 +834,19 @@ GNUNET_SERVER_set_callbacks (struct GNUNET_SERVER_Handle *server,
                              void *cls);
 
 
+/**
+ * Allow clients connected over a UNIX domain socket and running as
+ * our own user to pass their messages through a shared-memory ring
+ * (see the "SHM_RING" option).  Rings are refused by default.
+ *
+ * @param server server to modify
+ * @param enable #GNUNET_YES to accept rings, #GNUNET_NO to refuse them
+ */
+void
+GNUNET_SERVER_enable_shm_ring (struct GNUNET_SERVER_Handle *server,
+                               int enable);
+
+
 #if 0                           /* keep Emacsens' auto-indent happy */
 {
 #endif
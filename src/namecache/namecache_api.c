@@ -39,6 +39,13 @@
 
 #define LOG(kind,...) GNUNET_log_from (kind, "namecache-api",__VA_ARGS__)
 
+/**
+ * How many threads verify blocks if the configuration does not say?
+ * Every process using the namecache gets its own pool, so keep this
+ * small.
+ */
+#define DEFAULT_VERIFY_THREADS 1
+
 
 /**
  * An QueueEntry used to store information for a pending
@@ -82,6 +89,16 @@ struct GNUNET_NAMECACHE_QueueEntry
    */
   void *block_proc_cls;
 
+  /**
+   * Block we received and are verifying; or NULL.
+   */
+  struct GNUNET_GNSRECORD_Block *block;
+
+  /**
+   * Job verifying @e block; or NULL.
+   */
+  struct GNUNET_CRYPTO_WorkerJob *job;
+
   /**
    * The operation id this zone iteration operation has
    */
@@ -156,6 +173,11 @@ struct GNUNET_NAMECACHE_Handle
    */
   struct GNUNET_NAMECACHE_QueueEntry *op_tail;
 
+  /**
+   * Threads verifying the blocks we receive.
+   */
+  struct GNUNET_CRYPTO_WorkerPool *verify_pool;
+
   /**
    * Reconnect task
    */
@@ -193,6 +215,55 @@ static void
 force_reconnect (struct GNUNET_NAMECACHE_Handle *h);
 
 
+/**
+ * Verify the signature of a block.  Runs in a thread of the
+ * verification pool.
+ *
+ * @param cls the `struct GNUNET_GNSRECORD_Block` to verify
+ * @return #GNUNET_OK if the signature is valid
+ */
+static int
+verify_block (void *cls)
+{
+  const struct GNUNET_GNSRECORD_Block *block = cls;
+
+  return GNUNET_GNSRECORD_block_verify (block);
+}
+
+
+/**
+ * A block we received was verified; pass it on and clean up.
+ *
+ * @param cls the `struct GNUNET_NAMECACHE_QueueEntry`
+ * @param result #GNUNET_OK if the block is valid
+ */
+static void
+block_verified (void *cls,
+                int result)
+{
+  struct GNUNET_NAMECACHE_QueueEntry *qe = cls;
+  struct GNUNET_NAMECACHE_Handle *h = qe->nsh;
+
+  qe->job = NULL;
+  GNUNET_CONTAINER_DLL_remove (h->op_head,
+                               h->op_tail,
+                               qe);
+  if (GNUNET_OK != result)
+  {
+    /* the service gave us a bad block, treat as no match */
+    GNUNET_break (0);
+    if (NULL != qe->block_proc)
+      qe->block_proc (qe->block_proc_cls, NULL);
+  }
+  else if (NULL != qe->block_proc)
+    qe->block_proc (qe->block_proc_cls, qe->block);
+  else
+    GNUNET_break (0);
+  GNUNET_free (qe->block);
+  GNUNET_free (qe);
+}
+
+
 /**
  * Handle an incoming message of type
  * #GNUNET_MESSAGE_TYPE_NAMECACHE_LOOKUP_BLOCK_RESPONSE.
@@ -200,7 +271,9 @@ force_reconnect (struct GNUNET_NAMECACHE_Handle *h);
  * @param qe the respective entry in the message queue
  * @param msg the message we received
  * @param size the message size
- * @return #GNUNET_OK on success, #GNUNET_SYSERR on error and we did NOT notify the client
+ * @return #GNUNET_OK on success (if @a qe has a job now, the client
+ *         will be notified once the block was verified),
+ *         #GNUNET_SYSERR on error and we did NOT notify the client
  */
 static int
 handle_lookup_block_response (struct GNUNET_NAMECACHE_QueueEntry *qe,
@@ -208,8 +281,6 @@ handle_lookup_block_response (struct GNUNET_NAMECACHE_QueueEntry *qe,
 			      size_t size)
 {
   struct GNUNET_GNSRECORD_Block *block;
-  char buf[size + sizeof (struct GNUNET_GNSRECORD_Block)
-	   - sizeof (struct LookupBlockResponseMessage)];
 
   LOG (GNUNET_ERROR_TYPE_DEBUG,
        "Received `%s'\n",
@@ -222,7 +293,8 @@ handle_lookup_block_response (struct GNUNET_NAMECACHE_QueueEntry *qe,
     return GNUNET_OK;
   }
 
-  block = (struct GNUNET_GNSRECORD_Block *) buf;
+  block = GNUNET_malloc (size + sizeof (struct GNUNET_GNSRECORD_Block)
+                         - sizeof (struct LookupBlockResponseMessage));
   block->signature = msg->signature;
   block->derived_key = msg->derived_key;
   block->purpose.purpose = htonl (GNUNET_SIGNATURE_PURPOSE_GNS_RECORD_SIGN);
@@ -233,16 +305,10 @@ handle_lookup_block_response (struct GNUNET_NAMECACHE_QueueEntry *qe,
   memcpy (&block[1],
 	  &msg[1],
 	  size - sizeof (struct LookupBlockResponseMessage));
-  if (GNUNET_OK !=
-      GNUNET_GNSRECORD_block_verify (block))
-  {
-    GNUNET_break (0);
-    return GNUNET_SYSERR;
-  }
-  if (NULL != qe->block_proc)
-    qe->block_proc (qe->block_proc_cls, block);
-  else
-    GNUNET_break (0);
+  qe->block = block;
+  qe->job = GNUNET_CRYPTO_worker_pool_submit (qe->nsh->verify_pool,
+                                              &verify_block, block,
+                                              &block_verified, qe);
   return GNUNET_OK;
 }
 
@@ -373,7 +439,7 @@ process_namecache_message (void *cls,
       /* protocol error, need to reconnect */
       h->reconnect = GNUNET_YES;
     }
-    else
+    else if (NULL == qe->job)
     {
       /* client was notified about success or failure, clean up 'qe' */
       GNUNET_CONTAINER_DLL_remove (h->op_head,
@@ -557,9 +623,16 @@ struct GNUNET_NAMECACHE_Handle *
 GNUNET_NAMECACHE_connect (const struct GNUNET_CONFIGURATION_Handle *cfg)
 {
   struct GNUNET_NAMECACHE_Handle *h;
+  unsigned long long verify_threads;
 
   h = GNUNET_new (struct GNUNET_NAMECACHE_Handle);
   h->cfg = cfg;
+  if ( (GNUNET_OK !=
+        GNUNET_CONFIGURATION_get_value_number (cfg, "namecache", "VERIFYTHREADS",
+                                               &verify_threads)) ||
+       (0 == verify_threads) )
+    verify_threads = DEFAULT_VERIFY_THREADS;
+  h->verify_pool = GNUNET_CRYPTO_worker_pool_create ((unsigned int) verify_threads);
   h->reconnect_task = GNUNET_SCHEDULER_add_now (&reconnect_task, h);
   h->last_op_id_used = 0;
   return h;
@@ -594,8 +667,12 @@ GNUNET_NAMECACHE_disconnect (struct GNUNET_NAMECACHE_Handle *h)
   while (NULL != (q = h->op_head))
   {
     GNUNET_CONTAINER_DLL_remove (h->op_head, h->op_tail, q);
+    if (NULL != q->job)
+      GNUNET_CRYPTO_worker_job_cancel (q->job);
+    GNUNET_free_non_null (q->block);
     GNUNET_free (q);
   }
+  GNUNET_CRYPTO_worker_pool_destroy (h->verify_pool);
   if (NULL != h->client)
   {
     GNUNET_CLIENT_disconnect (h->client);
@@ -728,6 +805,9 @@ GNUNET_NAMECACHE_cancel (struct GNUNET_NAMECACHE_QueueEntry *qe)
 
   GNUNET_assert (NULL != qe);
   GNUNET_CONTAINER_DLL_remove (h->op_head, h->op_tail, qe);
+  if (NULL != qe->job)
+    GNUNET_CRYPTO_worker_job_cancel (qe->job);
+  GNUNET_free_non_null (qe->block);
   GNUNET_free(qe);
 }
 
@@ -79,13 +79,13 @@ struct ZoneIteration
   uint32_t request_id;
 
   /**
-   * Offset of the zone iteration used to address next result of the zone
-   * iteration in the store
+   * Serial number of the last record returned by the zone iteration;
+   * the next round continues with the records stored after it.
    *
-   * Initialy set to 0 in handle_iteration_start
-   * Incremented with by every call to handle_iteration_next
+   * Initialy set to 0 in #handle_iteration_start.
+   * Updated by #zone_iterate_proc for every result.
    */
-  uint32_t offset;
+  uint64_t seq;
 
 };
 
@@ -155,13 +155,13 @@ struct ZoneMonitor
   GNUNET_SCHEDULER_TaskIdentifier task;
 
   /**
-   * Offset of the zone iteration used to address next result of the zone
-   * iteration in the store
+   * Serial number of the last record returned during the initial
+   * iteration of the monitor.
    *
    * Initialy set to 0.
-   * Incremented with by every call to #handle_iteration_next
+   * Updated by #monitor_iterate_cb for every result.
    */
-  uint32_t offset;
+  uint64_t seq;
 
 };
 
@@ -403,6 +403,7 @@ client_lookup (struct GNUNET_SERVER_Client *client)
  * record, which (if found) is then copied to @a cls for future use.
  *
  * @param cls a `struct GNUNET_GNSRECORD_Data **` for storing the nick (if found)
+ * @param serial serial number of the record (unused)
  * @param private_key the private key of the zone (unused)
  * @param label should be #GNUNET_GNS_MASTERZONE_STR
  * @param rd_count number of records in @a rd
@@ -410,6 +411,7 @@ client_lookup (struct GNUNET_SERVER_Client *client)
  */
 static void
 lookup_nick_it (void *cls,
+                uint64_t serial,
                 const struct GNUNET_CRYPTO_EcdsaPrivateKey *private_key,
                 const char *label,
                 unsigned int rd_count,
@@ -758,6 +760,7 @@ struct RecordLookupContext
 
 static void
 lookup_it (void *cls,
+           uint64_t serial,
            const struct GNUNET_CRYPTO_EcdsaPrivateKey *private_key,
            const char *label,
            unsigned int rd_count,
@@ -999,7 +1002,7 @@ handle_record_store (void *cls,
     if ( (0 == rd_count) &&
          (GNUNET_NO ==
           GSN_database->iterate_records (GSN_database->cls,
-                                         &rp_msg->private_key, 0, NULL, 0)) )
+                                         &rp_msg->private_key, 0, 1, NULL, NULL)) )
     {
       /* This name does not exist, so cannot be removed */
       GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
@@ -1108,6 +1111,7 @@ struct ZoneToNameCtx
  * Zone to name iterator
  *
  * @param cls struct ZoneToNameCtx *
+ * @param serial serial number of the record (unused)
  * @param zone_key the zone key
  * @param name name
  * @param rd_count number of records in @a rd
@@ -1115,6 +1119,7 @@ struct ZoneToNameCtx
  */
 static void
 handle_zone_to_name_it (void *cls,
+			uint64_t serial,
 			const struct GNUNET_CRYPTO_EcdsaPrivateKey *zone_key,
 			const char *name,
 			unsigned int rd_count,
@@ -1220,29 +1225,6 @@ handle_zone_to_name (void *cls,
 }
 
 
-/**
- * Zone iteration processor result
- */
-enum ZoneIterationResult
-{
-  /**
-   * Iteration start.
-   */
-  IT_START = 0,
-
-  /**
-   * Found records,
-   * Continue to iterate with next iteration_next call
-   */
-  IT_SUCCESS_MORE_AVAILABLE = 1,
-
-  /**
-   * Iteration complete
-   */
-  IT_SUCCESS_NOT_MORE_RESULTS_AVAILABLE = 2
-};
-
-
 /**
  * Context for record remove operations passed from
  * #run_zone_iteration_round to #zone_iterate_proc as closure
@@ -1255,13 +1237,9 @@ struct ZoneIterationProcResult
   struct ZoneIteration *zi;
 
   /**
-   * Iteration result: iteration done?
-   * #IT_SUCCESS_MORE_AVAILABLE:  if there may be more results overall but
-   * we got one for now and have sent it to the client
-   * #IT_SUCCESS_NOT_MORE_RESULTS_AVAILABLE: if there are no further results,
-   * #IT_START: if we are still trying to find a result.
+   * Number of results we have sent to the client in this round.
    */
-  int res_iteration_finished;
+  uint64_t count;
 
 };
 
@@ -1270,6 +1248,7 @@ struct ZoneIterationProcResult
  * Process results for zone iteration from database
  *
  * @param cls struct ZoneIterationProcResult *proc
+ * @param serial serial number of the record
  * @param zone_key the zone key
  * @param name name
  * @param rd_count number of records for this name
@@ -1277,30 +1256,25 @@ struct ZoneIterationProcResult
  */
 static void
 zone_iterate_proc (void *cls,
-                       const struct GNUNET_CRYPTO_EcdsaPrivateKey *zone_key,
-                       const char *name,
-                       unsigned int rd_count,
-                       const struct GNUNET_GNSRECORD_Data *rd)
+                   uint64_t serial,
+                   const struct GNUNET_CRYPTO_EcdsaPrivateKey *zone_key,
+                   const char *name,
+                   unsigned int rd_count,
+                   const struct GNUNET_GNSRECORD_Data *rd)
 {
   struct ZoneIterationProcResult *proc = cls;
   unsigned int i;
   int do_refresh_block;
 
-  if ((NULL == zone_key) && (NULL == name))
-  {
-    GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
-		"Iteration done\n");
-    proc->res_iteration_finished = IT_SUCCESS_NOT_MORE_RESULTS_AVAILABLE;
-    return;
-  }
+  /* always advance, so that a bogus record cannot stall the iteration */
+  proc->zi->seq = serial;
+  proc->count++;
   if ((NULL == zone_key) || (NULL == name))
   {
     /* what is this!? should never happen */
-    proc->res_iteration_finished = IT_START;
     GNUNET_break (0);
     return;
   }
-  proc->res_iteration_finished = IT_SUCCESS_MORE_AVAILABLE;
   send_lookup_response (snc,
 			proc->zi->client->client,
 			proc->zi->request_id,
@@ -1327,38 +1301,34 @@ zone_iterate_proc (void *cls,
 
 
 /**
- * Perform the next round of the zone iteration.
+ * Perform the next round of the zone iteration, sending up to
+ * @a limit results to the client.  If fewer results are available,
+ * the end of the iteration is signalled as well.
  *
  * @param zi zone iterator to process
+ * @param limit maximum number of results to return
  */
 static void
-run_zone_iteration_round (struct ZoneIteration *zi)
+run_zone_iteration_round (struct ZoneIteration *zi,
+                          uint64_t limit)
 {
   struct ZoneIterationProcResult proc;
   struct RecordResultMessage rrm;
-  int ret;
 
   memset (&proc, 0, sizeof (proc));
   proc.zi = zi;
-  proc.res_iteration_finished = IT_START;
-  while (IT_START == proc.res_iteration_finished)
+  if (GNUNET_SYSERR ==
+      GSN_database->iterate_records (GSN_database->cls,
+                                     (0 == memcmp (&zi->zone, &zero, sizeof (zero)))
+                                     ? NULL
+                                     : &zi->zone,
+                                     zi->seq,
+                                     limit,
+                                     &zone_iterate_proc, &proc))
   {
-    if (GNUNET_SYSERR ==
-	(ret = GSN_database->iterate_records (GSN_database->cls,
-					      (0 == memcmp (&zi->zone, &zero, sizeof (zero)))
-					      ? NULL
-					      : &zi->zone,
-					      zi->offset,
-					      &zone_iterate_proc, &proc)))
-    {
-      GNUNET_break (0);
-      break;
-    }
-    if (GNUNET_NO == ret)
-      proc.res_iteration_finished = IT_SUCCESS_NOT_MORE_RESULTS_AVAILABLE;
-    zi->offset++;
+    GNUNET_break (0);
   }
-  if (IT_SUCCESS_MORE_AVAILABLE == proc.res_iteration_finished)
+  else if (proc.count == limit)
   {
     GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
                 "More results available\n");
@@ -1406,13 +1376,13 @@ handle_iteration_start (void *cls,
   zis_msg = (const struct ZoneIterationStartMessage *) message;
   zi = GNUNET_new (struct ZoneIteration);
   zi->request_id = ntohl (zis_msg->gns_header.r_id);
-  zi->offset = 0;
+  zi->seq = 0;
   zi->client = nc;
   zi->zone = zis_msg->zone;
 
 
   GNUNET_CONTAINER_DLL_insert (nc->op_head, nc->op_tail, zi);
-  run_zone_iteration_round (zi);
+  run_zone_iteration_round (zi, 1);
   GNUNET_SERVER_receive_done (client, GNUNET_OK);
 }
 
@@ -1476,6 +1446,7 @@ handle_iteration_next (void *cls,
   struct ZoneIteration *zi;
   const struct ZoneIterationNextMessage *zis_msg;
   uint32_t rid;
+  uint64_t limit;
 
   GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
               "Received `%s' message\n",
@@ -1488,6 +1459,13 @@ handle_iteration_next (void *cls,
   }
   zis_msg = (const struct ZoneIterationNextMessage *) message;
   rid = ntohl (zis_msg->gns_header.r_id);
+  limit = GNUNET_ntohll (zis_msg->limit);
+  if (0 == limit)
+  {
+    GNUNET_break (0);
+    GNUNET_SERVER_receive_done (client, GNUNET_SYSERR);
+    return;
+  }
   for (zi = nc->op_head; NULL != zi; zi = zi->next)
     if (zi->request_id == rid)
       break;
@@ -1497,7 +1475,7 @@ handle_iteration_next (void *cls,
     GNUNET_SERVER_receive_done (client, GNUNET_SYSERR);
     return;
   }
-  run_zone_iteration_round (zi);
+  run_zone_iteration_round (zi, limit);
   GNUNET_SERVER_receive_done (client, GNUNET_OK);
 }
 
@@ -1536,6 +1514,7 @@ monitor_next (void *cls,
  * A #GNUNET_NAMESTORE_RecordIterator for monitors.
  *
  * @param cls a 'struct ZoneMonitor *' with information about the monitor
+ * @param serial serial number of the record
  * @param zone_key zone key of the zone
  * @param name name
  * @param rd_count number of records in @a rd
@@ -1543,6 +1522,7 @@ monitor_next (void *cls,
  */
 static void
 monitor_iterate_cb (void *cls,
+		    uint64_t serial,
 		    const struct GNUNET_CRYPTO_EcdsaPrivateKey *zone_key,
 		    const char *name,
 		    unsigned int rd_count,
@@ -1550,6 +1530,7 @@ monitor_iterate_cb (void *cls,
 {
   struct ZoneMonitor *zm = cls;
 
+  zm->seq = serial;
   if (NULL == name)
   {
     /* finished with iteration */
@@ -1587,7 +1568,7 @@ handle_monitor_start (void *cls,
 	      "ZONE_MONITOR_START");
   zis_msg = (const struct ZoneMonitorStartMessage *) message;
   zm = GNUNET_new (struct ZoneMonitor);
-  zm->offset = 0;
+  zm->seq = 0;
   zm->nc = client_lookup (client);
   zm->zone = zis_msg->zone;
   GNUNET_CONTAINER_DLL_insert (monitor_head, monitor_tail, zm);
@@ -1620,7 +1601,8 @@ monitor_next (void *cls,
                                        (0 == memcmp (&zm->zone, &zero, sizeof (zero)))
                                        ? NULL
                                        : &zm->zone,
-				       zm->offset++,
+				       zm->seq,
+                                       1,
 				       &monitor_iterate_cb, zm);
   if (GNUNET_SYSERR == ret)
   {
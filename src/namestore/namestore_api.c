@@ -1262,12 +1262,20 @@ GNUNET_NAMESTORE_zone_iteration_start (struct GNUNET_NAMESTORE_Handle *h,
 
 /**
  * Calls the record processor specified in #GNUNET_NAMESTORE_zone_iteration_start
- * for the next record.
+ * for the next record(s).  The processor will be called up to @a limit
+ * times; if fewer records remain, it is then called once more with a
+ * label of NULL to signal the end of the iteration.  The next call to
+ * this function should only be made once @a limit results have been
+ * received.
  *
  * @param it the iterator
+ * @param limit number of records to return to the iterator in one shot
+ *        (before #GNUNET_NAMESTORE_zone_iterator_next is to be called again),
+ *        must be larger than zero
  */
 void
-GNUNET_NAMESTORE_zone_iterator_next (struct GNUNET_NAMESTORE_ZoneIterator *it)
+GNUNET_NAMESTORE_zone_iterator_next (struct GNUNET_NAMESTORE_ZoneIterator *it,
+                                     uint64_t limit)
 {
   struct GNUNET_NAMESTORE_Handle *h;
   struct ZoneIterationNextMessage * msg;
@@ -1275,6 +1283,7 @@ GNUNET_NAMESTORE_zone_iterator_next (struct GNUNET_NAMESTORE_ZoneIterator *it)
   size_t msg_size;
 
   GNUNET_assert (NULL != it);
+  GNUNET_assert (0 < limit);
   h = it->h;
   msg_size = sizeof (struct ZoneIterationNextMessage);
   pe = GNUNET_malloc (sizeof (struct PendingMessage) + msg_size);
@@ -1283,6 +1292,7 @@ GNUNET_NAMESTORE_zone_iterator_next (struct GNUNET_NAMESTORE_ZoneIterator *it)
   msg->gns_header.header.type = htons (GNUNET_MESSAGE_TYPE_NAMESTORE_ZONE_ITERATION_NEXT);
   msg->gns_header.header.size = htons (msg_size);
   msg->gns_header.r_id = htonl (it->op_id);
+  msg->limit = GNUNET_htonll (limit);
   LOG (GNUNET_ERROR_TYPE_DEBUG,
        "Sending `%s' message\n",
        "ZONE_ITERATION_NEXT");
@@ -0,0 +1,297 @@
+/*
+     This file is part of GNUnet.
+     (C) 2014 Christian Grothoff (and other contributing authors)
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+     Boston, MA 02111-1307, USA.
+*/
+/*
+ * @file namestore/perf_plugin_namestore.c
+ * @brief measure how fast a large zone can be iterated using
+ *        the namestore plugins, one record and many records per call
+ */
+#include "platform.h"
+#include "gnunet_util_lib.h"
+#include "gnunet_namestore_plugin.h"
+#include "gnunet_testing_lib.h"
+#include <gauger.h>
+
+/**
+ * Default number of records we store in the zone.
+ */
+#define DEFAULT_RECORDS 10000
+
+/**
+ * Number of records we fetch per call in batched mode.
+ */
+#define BATCH_SIZE 100
+
+
+static int ok;
+
+/**
+ * Number of records to store.
+ */
+static unsigned int num_records;
+
+/**
+ * Name of plugin under test.
+ */
+static const char *plugin_name;
+
+/**
+ * Zone all records are stored in.
+ */
+static struct GNUNET_CRYPTO_EcdsaPrivateKey zone_private_key;
+
+
+/**
+ * Closure for #count_record.
+ */
+struct IterationContext
+{
+  /**
+   * Serial number of the last record we got.
+   */
+  uint64_t serial;
+
+  /**
+   * Number of records we got.
+   */
+  unsigned int count;
+};
+
+
+/**
+ * Function called when the service shuts down.  Unloads our namestore
+ * plugin.
+ *
+ * @param api api to unload
+ */
+static void
+unload_plugin (struct GNUNET_NAMESTORE_PluginFunctions *api)
+{
+  char *libname;
+
+  GNUNET_asprintf (&libname, "libgnunet_plugin_namestore_%s", plugin_name);
+  GNUNET_break (NULL == GNUNET_PLUGIN_unload (libname, api));
+  GNUNET_free (libname);
+}
+
+
+/**
+ * Load the namestore plugin.
+ *
+ * @param cfg configuration to pass
+ * @return NULL on error
+ */
+static struct GNUNET_NAMESTORE_PluginFunctions *
+load_plugin (const struct GNUNET_CONFIGURATION_Handle *cfg)
+{
+  struct GNUNET_NAMESTORE_PluginFunctions *ret;
+  char *libname;
+
+  GNUNET_asprintf (&libname, "libgnunet_plugin_namestore_%s", plugin_name);
+  if (NULL == (ret = GNUNET_PLUGIN_load (libname, (void*) cfg)))
+  {
+    FPRINTF (stderr, "Failed to load plugin `%s'!\n", plugin_name);
+    GNUNET_free (libname);
+    return NULL;
+  }
+  GNUNET_free (libname);
+  return ret;
+}
+
+
+/**
+ * Store the record set @a id in our zone.
+ *
+ * @param nsp plugin to use
+ * @param id number of the record set
+ */
+static void
+put_record (struct GNUNET_NAMESTORE_PluginFunctions *nsp,
+            unsigned int id)
+{
+  struct GNUNET_GNSRECORD_Data rd;
+  char label[64];
+
+  GNUNET_snprintf (label, sizeof (label),
+		   "l%u", id);
+  rd.data = &id;
+  rd.data_size = sizeof (id);
+  rd.expiration_time = GNUNET_TIME_relative_to_absolute (GNUNET_TIME_UNIT_HOURS).abs_value_us;
+  rd.record_type = 1 + (id % 13);
+  rd.flags = 0;
+  GNUNET_assert (GNUNET_OK == nsp->store_records (nsp->cls,
+						  &zone_private_key,
+						  label,
+						  1,
+						  &rd));
+}
+
+
+/**
+ * Count the records returned by the iteration.
+ *
+ * @param cls our `struct IterationContext`
+ * @param serial serial number of the record
+ * @param private_key private key of the zone
+ * @param label name that is being mapped (at most 255 characters long)
+ * @param rd_count number of entries in @a rd array
+ * @param rd array of records with data to store
+ */
+static void
+count_record (void *cls,
+              uint64_t serial,
+              const struct GNUNET_CRYPTO_EcdsaPrivateKey *private_key,
+              const char *label,
+              unsigned int rd_count,
+              const struct GNUNET_GNSRECORD_Data *rd)
+{
+  struct IterationContext *ic = cls;
+
+  GNUNET_assert (serial > ic->serial);
+  ic->serial = serial;
+  ic->count++;
+}
+
+
+/**
+ * Iterate over the entire zone, fetching @a limit records per call
+ * to the plugin, and report the rate.
+ *
+ * @param nsp plugin to use
+ * @param limit number of records to fetch per call
+ */
+static void
+iterate_zone (struct GNUNET_NAMESTORE_PluginFunctions *nsp,
+              uint64_t limit)
+{
+  struct IterationContext ic;
+  struct GNUNET_TIME_Absolute start;
+  struct GNUNET_TIME_Relative duration;
+  unsigned int before;
+  unsigned long long rate;
+  char name[64];
+
+  memset (&ic, 0, sizeof (ic));
+  start = GNUNET_TIME_absolute_get ();
+  do
+  {
+    before = ic.count;
+    if (GNUNET_SYSERR ==
+        nsp->iterate_records (nsp->cls,
+                              &zone_private_key,
+                              ic.serial,
+                              limit,
+                              &count_record, &ic))
+    {
+      GNUNET_break (0);
+      ok = 1;
+      return;
+    }
+  }
+  while (ic.count == before + limit);
+  duration = GNUNET_TIME_absolute_get_duration (start);
+  if (ic.count != num_records)
+  {
+    FPRINTF (stderr,
+             "Iteration returned %u records, expected %u\n",
+             ic.count,
+             num_records);
+    ok = 1;
+  }
+  rate = ic.count * 1000LL * 1000LL / (1 + duration.rel_value_us);
+  printf ("Iterating over %u records, %llu per call, took %s (%llu records/s)\n",
+          ic.count,
+          (unsigned long long) limit,
+          GNUNET_STRINGS_relative_time_to_string (duration, GNUNET_YES),
+          rate);
+  GNUNET_snprintf (name, sizeof (name),
+                   "Zone iteration (%s, %llu per call)",
+                   plugin_name,
+                   (unsigned long long) limit);
+  GAUGER ("NAMESTORE", name, rate, "records/s");
+}
+
+
+static void
+run (void *cls, char *const *args, const char *cfgfile,
+     const struct GNUNET_CONFIGURATION_Handle *cfg)
+{
+  struct GNUNET_NAMESTORE_PluginFunctions *nsp;
+  struct GNUNET_TIME_Absolute start;
+  unsigned int i;
+
+  ok = 0;
+  nsp = load_plugin (cfg);
+  if (NULL == nsp)
+  {
+    FPRINTF (stderr,
+             "%s",
+	     "Failed to initialize namestore.  Database likely not setup, skipping test.\n");
+    return;
+  }
+  memset (&zone_private_key, 42, sizeof (zone_private_key));
+  start = GNUNET_TIME_absolute_get ();
+  for (i = 0; i < num_records; i++)
+    put_record (nsp, i);
+  printf ("Storing %u records took %s\n",
+          num_records,
+          GNUNET_STRINGS_relative_time_to_string (GNUNET_TIME_absolute_get_duration (start),
+                                                  GNUNET_YES));
+  iterate_zone (nsp, 1);
+  iterate_zone (nsp, BATCH_SIZE);
+  unload_plugin (nsp);
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  char cfg_name[128];
+  char *const xargv[] = {
+    "perf-plugin-namestore",
+    "-c",
+    cfg_name,
+    NULL
+  };
+  struct GNUNET_GETOPT_CommandLineOption options[] = {
+    GNUNET_GETOPT_OPTION_END
+  };
+
+  num_records = DEFAULT_RECORDS;
+  if ( (argc > 1) &&
+       ( (1 != sscanf (argv[1], "%u", &num_records)) ||
+         (0 == num_records) ) )
+  {
+    FPRINTF (stderr, "Usage: %s [RECORDS]\n", argv[0]);
+    return 1;
+  }
+  GNUNET_DISK_directory_remove ("/tmp/gnunet-test-plugin-namestore-sqlite");
+  GNUNET_log_setup ("perf-plugin-namestore",
+                    "WARNING",
+                    NULL);
+  plugin_name = GNUNET_TESTING_get_testname_from_underscore (argv[0]);
+  GNUNET_snprintf (cfg_name, sizeof (cfg_name), "test_plugin_namestore_%s.conf",
+                   plugin_name);
+  GNUNET_PROGRAM_run ((sizeof (xargv) / sizeof (char *)) - 1, xargv,
+                      "perf-plugin-namestore", "nohelp", options, &run, NULL);
+  GNUNET_DISK_directory_remove ("/tmp/gnunet-test-plugin-namestore-sqlite");
+  return ok;
+}
+
+/* end of perf_plugin_namestore.c */
@@ -73,6 +73,70 @@ struct Plugin
 };
 
 
+/**
+ * Create an index unless it exists already.
+ *
+ * @param dbh handle to the database
+ * @param sql statement creating the index
+ * @return #GNUNET_OK on success
+ */
+static int
+create_index (PGconn *dbh,
+              const char *sql)
+{
+  PGresult *res;
+
+  res = PQexec (dbh, sql);
+  if ( (NULL != res) &&
+       (PGRES_COMMAND_OK != PQresultStatus (res)) &&
+       (0 == strcmp ("42P07",    /* duplicate relation */
+                     PQresultErrorField (res,
+                                         PG_DIAG_SQLSTATE))) )
+  {
+    PQclear (res);
+    return GNUNET_OK;
+  }
+  if (GNUNET_OK !=
+      GNUNET_POSTGRES_check_result (dbh, res, PGRES_COMMAND_OK,
+                                    "CREATE INDEX", sql))
+    return GNUNET_SYSERR;
+  PQclear (res);
+  return GNUNET_OK;
+}
+
+
+/**
+ * Tables created before iteration by serial number have no seq
+ * column and were iterated by oid, which wraps around.  Add the
+ * column; postgres fills it in for the existing records.
+ *
+ * @param dbh handle to the database
+ * @return #GNUNET_OK on success
+ */
+static int
+add_seq_column (PGconn *dbh)
+{
+  PGresult *res;
+
+  res = PQexec (dbh, "ALTER TABLE ns097records ADD COLUMN seq BIGSERIAL");
+  if ( (NULL != res) &&
+       (PGRES_COMMAND_OK != PQresultStatus (res)) &&
+       (0 == strcmp ("42701",    /* duplicate column */
+                     PQresultErrorField (res,
+                                         PG_DIAG_SQLSTATE))) )
+  {
+    PQclear (res);
+    return GNUNET_OK;
+  }
+  if (GNUNET_OK !=
+      GNUNET_POSTGRES_check_result (dbh, res, PGRES_COMMAND_OK,
+                                    "ALTER TABLE", "ns097records"))
+    return GNUNET_SYSERR;
+  PQclear (res);
+  return GNUNET_OK;
+}
+
+
 /**
  * Create our database indices.
  *
@@ -81,17 +145,28 @@ struct Plugin
 static void
 create_indices (PGconn * dbh)
 {
+  /* drop the indices for the old iterations by rvalue and oid */
+  if ( (GNUNET_OK !=
+        GNUNET_POSTGRES_exec (dbh, "DROP INDEX IF EXISTS ir_pkey_iter")) ||
+       (GNUNET_OK !=
+        GNUNET_POSTGRES_exec (dbh, "DROP INDEX IF EXISTS it_iter")) ||
+       (GNUNET_OK !=
+        GNUNET_POSTGRES_exec (dbh, "DROP INDEX IF EXISTS ir_zone_iter")) ||
+       (GNUNET_OK !=
+        GNUNET_POSTGRES_exec (dbh, "DROP INDEX IF EXISTS ir_all_iter")) )
+    LOG (GNUNET_ERROR_TYPE_WARNING,
+	 _("Failed to drop old indices\n"));
   /* create indices */
   if ( (GNUNET_OK !=
-	GNUNET_POSTGRES_exec (dbh,
-                              "CREATE INDEX ir_pkey_reverse ON ns097records (zone_private_key,pkey)")) ||
+	create_index (dbh,
+                      "CREATE INDEX ir_pkey_reverse ON ns097records (zone_private_key,pkey)")) ||
        (GNUNET_OK !=
-	GNUNET_POSTGRES_exec (dbh,
-                              "CREATE INDEX ir_pkey_iter ON ns097records (zone_private_key,rvalue)")) ||
+	create_index (dbh,
+                      "CREATE INDEX ir_zone_seq ON ns097records (zone_private_key,seq)")) ||
        (GNUNET_OK !=
-	GNUNET_POSTGRES_exec (dbh, "CREATE INDEX it_iter ON ns097records (rvalue)")) ||
+	create_index (dbh, "CREATE UNIQUE INDEX ir_seq ON ns097records (seq)")) ||
        (GNUNET_OK !=
-        GNUNET_POSTGRES_exec (dbh, "CREATE INDEX ir_label ON ns097records (label)")) )
+        create_index (dbh, "CREATE INDEX ir_label ON ns097records (label)")) )
     LOG (GNUNET_ERROR_TYPE_ERROR,
 	 _("Failed to create indices\n"));
 }
@@ -122,26 +197,28 @@ database_setup (struct Plugin *plugin)
     res =
       PQexec (plugin->dbh,
               "CREATE TEMPORARY TABLE ns097records ("
+	      " seq BIGSERIAL,"
 	      " zone_private_key BYTEA NOT NULL DEFAULT '',"
 	      " pkey BYTEA DEFAULT '',"
 	      " rvalue BYTEA NOT NULL DEFAULT '',"
 	      " record_count INTEGER NOT NULL DEFAULT 0,"
 	      " record_data BYTEA NOT NULL DEFAULT '',"
 	      " label TEXT NOT NULL DEFAULT ''"
-	      ")" "WITH OIDS");
+	      ")");
   }
   else
   {
     res =
       PQexec (plugin->dbh,
               "CREATE TABLE ns097records ("
+	      " seq BIGSERIAL,"
 	      " zone_private_key BYTEA NOT NULL DEFAULT '',"
 	      " pkey BYTEA DEFAULT '',"
 	      " rvalue BYTEA NOT NULL DEFAULT '',"
 	      " record_count INTEGER NOT NULL DEFAULT 0,"
 	      " record_data BYTEA NOT NULL DEFAULT '',"
 	      " label TEXT NOT NULL DEFAULT ''"
-	      ")" "WITH OIDS");
+	      ")");
   }
   if ( (NULL == res) ||
        ((PQresultStatus (res) != PGRES_COMMAND_OK) &&
@@ -157,6 +234,13 @@ database_setup (struct Plugin *plugin)
     plugin->dbh = NULL;
     return GNUNET_SYSERR;
   }
+  PQclear (res);
+  if (GNUNET_OK != add_seq_column (plugin->dbh))
+  {
+    PQfinish (plugin->dbh);
+    plugin->dbh = NULL;
+    return GNUNET_SYSERR;
+  }
   create_indices (plugin->dbh);
 
   if ((GNUNET_OK !=
@@ -171,22 +255,24 @@ database_setup (struct Plugin *plugin)
       (GNUNET_OK !=
        GNUNET_POSTGRES_prepare (plugin->dbh,
 				"zone_to_name",
-				"SELECT record_count,record_data,label FROM ns097records"
+				"SELECT seq,record_count,record_data,label FROM ns097records"
                                 " WHERE zone_private_key=$1 AND pkey=$2", 2)) ||
       (GNUNET_OK !=
        GNUNET_POSTGRES_prepare (plugin->dbh,
 				"iterate_zone",
-				"SELECT record_count,record_data,label FROM ns097records"
-                                " WHERE zone_private_key=$1 ORDER BY rvalue LIMIT 1 OFFSET $2", 2)) ||
+				"SELECT seq,record_count,record_data,label FROM ns097records"
+                                " WHERE zone_private_key=$1 AND seq>$2"
+                                " ORDER BY seq ASC LIMIT $3", 3)) ||
       (GNUNET_OK !=
        GNUNET_POSTGRES_prepare (plugin->dbh,
 				"iterate_all_zones",
-				"SELECT record_count,record_data,label,zone_private_key"
-				" FROM ns097records ORDER BY rvalue LIMIT 1 OFFSET $1", 1)) ||
+				"SELECT seq,record_count,record_data,label,zone_private_key"
+				" FROM ns097records WHERE seq>$1"
+                                " ORDER BY seq ASC LIMIT $2", 2)) ||
       (GNUNET_OK !=
        GNUNET_POSTGRES_prepare (plugin->dbh,
                                 "lookup_label",
-                                "SELECT record_count,record_data,label"
+                                "SELECT seq,record_count,record_data,label"
                                 " FROM ns097records WHERE zone_private_key=$1 AND label=$2", 2)))
   {
     PQfinish (plugin->dbh);
@@ -301,12 +387,15 @@ get_record_and_call_iterator (struct Plugin *plugin,
 			      const struct GNUNET_CRYPTO_EcdsaPrivateKey *zone_key,
 			      GNUNET_NAMESTORE_RecordIterator iter, void *iter_cls)
 {
+  const struct GNUNET_CRYPTO_EcdsaPrivateKey *row_zone_key;
   const char *data;
   size_t data_size;
+  uint64_t serial;
   uint32_t record_count;
   const char *label;
   size_t label_len;
   unsigned int cnt;
+  unsigned int row;
 
   if (GNUNET_OK !=
       GNUNET_POSTGRES_check_result (plugin->dbh, res, PGRES_TUPLES_OK,
@@ -325,53 +414,58 @@ get_record_and_call_iterator (struct Plugin *plugin,
     PQclear (res);
     return GNUNET_NO;
   }
-  GNUNET_assert (1 == cnt);
-  GNUNET_assert (3 + ((NULL == zone_key) ? 1 : 0) == PQnfields (res));
-  if (NULL == zone_key)
-  {
-    if (sizeof (struct GNUNET_CRYPTO_EcdsaPrivateKey) != PQgetlength (res, 0, 3))
-    {
-      GNUNET_break (0);
-      PQclear (res);
-      return GNUNET_SYSERR;
-    }
-    zone_key = (const struct GNUNET_CRYPTO_EcdsaPrivateKey *) PQgetvalue (res, 0, 3);
-  }
-  if (sizeof (uint32_t) != PQfsize (res, 0))
-  {
-    GNUNET_break (0);
-    PQclear (res);
-    return GNUNET_SYSERR;
-  }
-
-  record_count = ntohl (*(uint32_t *) PQgetvalue (res, 0, 0));
-  data = PQgetvalue (res, 0, 1);
-  data_size = PQgetlength (res, 0, 1);
-  label = PQgetvalue (res, 0, 2);
-  label_len = PQgetlength (res, 0, 1);
-  if (record_count > 64 * 1024)
+  GNUNET_assert (4 + ((NULL == zone_key) ? 1 : 0) == PQnfields (res));
+  if ( (sizeof (uint64_t) != PQfsize (res, 0)) ||
+       (sizeof (uint32_t) != PQfsize (res, 1)) )
   {
-    /* sanity check, don't stack allocate far too much just
-       because database might contain a large value here */
     GNUNET_break (0);
     PQclear (res);
     return GNUNET_SYSERR;
   }
+  for (row = 0; row < cnt; row++)
   {
-    struct GNUNET_GNSRECORD_Data rd[record_count];
-    char buf[label_len + 1];
-
-    memcpy (buf, label, label_len);
-    buf[label_len] = '\0';
-    if (GNUNET_OK !=
-	GNUNET_GNSRECORD_records_deserialize (data_size, data,
-					      record_count, rd))
+    row_zone_key = zone_key;
+    if (NULL == zone_key)
     {
+      if (sizeof (struct GNUNET_CRYPTO_EcdsaPrivateKey) != PQgetlength (res, row, 4))
+      {
+        GNUNET_break (0);
+        PQclear (res);
+        return GNUNET_SYSERR;
+      }
+      row_zone_key = (const struct GNUNET_CRYPTO_EcdsaPrivateKey *) PQgetvalue (res, row, 4);
+    }
+    serial = GNUNET_ntohll (*(uint64_t *) PQgetvalue (res, row, 0));
+    record_count = ntohl (*(uint32_t *) PQgetvalue (res, row, 1));
+    data = PQgetvalue (res, row, 2);
+    data_size = PQgetlength (res, row, 2);
+    label = PQgetvalue (res, row, 3);
+    label_len = PQgetlength (res, row, 3);
+    if (record_count > 64 * 1024)
+    {
+      /* sanity check, don't stack allocate far too much just
+         because database might contain a large value here */
       GNUNET_break (0);
       PQclear (res);
       return GNUNET_SYSERR;
     }
-    iter (iter_cls, zone_key, buf, record_count, rd);
+    {
+      struct GNUNET_GNSRECORD_Data rd[record_count];
+      char buf[label_len + 1];
+
+      memcpy (buf, label, label_len);
+      buf[label_len] = '\0';
+      if (GNUNET_OK !=
+          GNUNET_GNSRECORD_records_deserialize (data_size, data,
+                                                record_count, rd))
+      {
+        GNUNET_break (0);
+        PQclear (res);
+        return GNUNET_SYSERR;
+      }
+      if (NULL != iter)
+        iter (iter_cls, serial, row_zone_key, buf, record_count, rd);
+    }
   }
   PQclear (res);
   return GNUNET_OK;
@@ -419,12 +513,15 @@ namestore_postgres_lookup_records (void *cls,
 
 
 /**
- * Iterate over the results for a particular key and zone in the
- * datastore.  Will return at most one result to the iterator.
+ * Iterate over the results for a particular zone in the
+ * datastore, in the order of their serial numbers.  Will return
+ * at most @a limit results to the iterator.
  *
  * @param cls closure (internal context for the plugin)
  * @param zone hash of public key of the zone, NULL to iterate over all zones
- * @param offset offset in the list of all matching records
+ * @param serial only return records with a serial number larger
+ *        than this; 0 to start at the beginning
+ * @param limit maximum number of results to return
  * @param iter function to call with the result
  * @param iter_cls closure for @a iter
  * @return #GNUNET_OK on success, #GNUNET_NO if there were no results, #GNUNET_SYSERR on error
@@ -432,25 +529,38 @@ namestore_postgres_lookup_records (void *cls,
 static int
 namestore_postgres_iterate_records (void *cls,
                                     const struct GNUNET_CRYPTO_EcdsaPrivateKey *zone,
-                                    uint64_t offset,
+                                    uint64_t serial,
+                                    uint64_t limit,
                                     GNUNET_NAMESTORE_RecordIterator iter, void *iter_cls)
 {
   struct Plugin *plugin = cls;
-  uint64_t offset_be = GNUNET_htonll (offset);
+  uint64_t serial_be;
+  uint64_t limit_be;
 
+  if (0 == limit)
+    return GNUNET_NO;
+  /* serial numbers are from a BIGSERIAL, which is never negative */
+  if (serial > INT64_MAX)
+    serial = INT64_MAX;
+  if (limit > INT64_MAX)
+    limit = INT64_MAX;
+  serial_be = GNUNET_htonll (serial);
+  limit_be = GNUNET_htonll (limit);
   if (NULL == zone)
   {
     const char *paramValues[] = {
-      (const char *) &offset_be
+      (const char *) &serial_be,
+      (const char *) &limit_be
     };
     int paramLengths[] = {
-      sizeof (offset_be)
+      sizeof (serial_be),
+      sizeof (limit_be)
     };
-    const int paramFormats[] = { 1 };
+    const int paramFormats[] = { 1, 1 };
     PGresult *res;
 
     res = PQexecPrepared (plugin->dbh,
-                          "iterate_all_zones", 1,
+                          "iterate_all_zones", 2,
                           paramValues, paramLengths, paramFormats,
                           1);
     return get_record_and_call_iterator (plugin,
@@ -462,17 +572,19 @@ namestore_postgres_iterate_records (void *cls,
   {
     const char *paramValues[] = {
       (const char *) zone,
-      (const char *) &offset_be
+      (const char *) &serial_be,
+      (const char *) &limit_be
     };
     int paramLengths[] = {
       sizeof (*zone),
-      sizeof (offset_be)
+      sizeof (serial_be),
+      sizeof (limit_be)
     };
-    const int paramFormats[] = { 1, 1 };
+    const int paramFormats[] = { 1, 1, 1 };
     PGresult *res;
 
     res = PQexecPrepared (plugin->dbh,
-                          "iterate_zone", 2,
+                          "iterate_zone", 3,
                           paramValues, paramLengths, paramFormats,
                           1);
     return get_record_and_call_iterator (plugin,
@@ -135,21 +135,82 @@ sq_prepare (sqlite3 * dbh, const char *zSql, sqlite3_stmt ** ppStmt)
 static void
 create_indices (sqlite3 * dbh)
 {
-  /* create indices */
+  /* drop the indices for the old iteration by rvalue */
   if ( (SQLITE_OK !=
-	sqlite3_exec (dbh, "CREATE INDEX IF NOT EXISTS ir_pkey_reverse ON ns097records (zone_private_key,pkey)",
+	sqlite3_exec (dbh, "DROP INDEX IF EXISTS ir_pkey_iter",
 		      NULL, NULL, NULL)) ||
        (SQLITE_OK !=
-	sqlite3_exec (dbh, "CREATE INDEX IF NOT EXISTS ir_pkey_iter ON ns097records (zone_private_key,rvalue)",
+	sqlite3_exec (dbh, "DROP INDEX IF EXISTS it_iter",
+		      NULL, NULL, NULL)) )
+    LOG (GNUNET_ERROR_TYPE_WARNING,
+	 "Failed to drop old indices: %s\n", sqlite3_errmsg (dbh));
+  /* create indices */
+  if ( (SQLITE_OK !=
+	sqlite3_exec (dbh, "CREATE INDEX IF NOT EXISTS ir_pkey_reverse ON ns097records (zone_private_key,pkey)",
 		      NULL, NULL, NULL)) ||
        (SQLITE_OK !=
-	sqlite3_exec (dbh, "CREATE INDEX IF NOT EXISTS it_iter ON ns097records (rvalue)",
+	sqlite3_exec (dbh, "CREATE INDEX IF NOT EXISTS ir_zone_iter ON ns097records (zone_private_key)",
 		      NULL, NULL, NULL)) )
     LOG (GNUNET_ERROR_TYPE_ERROR,
 	 "Failed to create indices: %s\n", sqlite3_errmsg (dbh));
 }
 
 
+/**
+ * Tables created before iteration by serial number have no uid
+ * column and use the implicit rowid, which VACUUM may renumber.
+ * Copy such a table into one with an INTEGER PRIMARY KEY, keeping
+ * the rowids.  AUTOINCREMENT makes sure that a uid is never used
+ * again, so a record stored during an iteration is never skipped.
+ *
+ * @param plugin the plugin context (state for this module)
+ * @return #GNUNET_OK on success
+ */
+static int
+add_uid_column (struct Plugin *plugin)
+{
+  sqlite3_stmt *stmt;
+
+  if (SQLITE_OK ==
+      sq_prepare (plugin->dbh,
+                  "SELECT uid FROM ns097records LIMIT 0",
+                  &stmt))
+  {
+    /* uid column exists */
+    sqlite3_finalize (stmt);
+    return GNUNET_OK;
+  }
+  LOG (GNUNET_ERROR_TYPE_INFO,
+       _("Adding uid column to namestore database\n"));
+  if (SQLITE_OK !=
+      sqlite3_exec (plugin->dbh,
+                    "BEGIN;"
+                    "CREATE TABLE ns097records_uid ("
+                    " uid INTEGER PRIMARY KEY AUTOINCREMENT,"
+                    " zone_private_key BLOB NOT NULL DEFAULT '',"
+                    " pkey BLOB,"
+                    " rvalue INT8 NOT NULL DEFAULT '',"
+                    " record_count INT NOT NULL DEFAULT 0,"
+                    " record_data BLOB NOT NULL DEFAULT '',"
+                    " label TEXT NOT NULL DEFAULT ''"
+                    ");"
+                    "INSERT INTO ns097records_uid"
+                    " (uid, zone_private_key, pkey, rvalue, record_count, record_data, label)"
+                    " SELECT _ROWID_, zone_private_key, pkey, rvalue, record_count, record_data, label"
+                    " FROM ns097records;"
+                    "DROP TABLE ns097records;"
+                    "ALTER TABLE ns097records_uid RENAME TO ns097records;"
+                    "COMMIT",
+                    NULL, NULL, NULL))
+  {
+    LOG_SQLITE (plugin, GNUNET_ERROR_TYPE_ERROR, "sqlite3_exec");
+    (void) sqlite3_exec (plugin->dbh, "ROLLBACK", NULL, NULL, NULL);
+    return GNUNET_SYSERR;
+  }
+  return GNUNET_OK;
+}
+
+
 #if 0
 #define CHECK(a) GNUNET_break(a)
 #define ENULL NULL
@@ -242,6 +303,7 @@ database_setup (struct Plugin *plugin)
       (sqlite3_exec
        (plugin->dbh,
         "CREATE TABLE ns097records ("
+        " uid INTEGER PRIMARY KEY AUTOINCREMENT,"
         " zone_private_key BLOB NOT NULL DEFAULT '',"
         " pkey BLOB,"
 	" rvalue INT8 NOT NULL DEFAULT '',"
@@ -256,6 +318,8 @@ database_setup (struct Plugin *plugin)
     return GNUNET_SYSERR;
   }
   sqlite3_finalize (stmt);
+  if (GNUNET_OK != add_uid_column (plugin))
+    return GNUNET_SYSERR;
 
   create_indices (plugin->dbh);
 
@@ -270,22 +334,24 @@ database_setup (struct Plugin *plugin)
         &plugin->delete_records) != SQLITE_OK) ||
       (sq_prepare
        (plugin->dbh,
-        "SELECT record_count,record_data,label"
+        "SELECT uid,record_count,record_data,label"
 	" FROM ns097records WHERE zone_private_key=? AND pkey=?",
         &plugin->zone_to_name) != SQLITE_OK) ||
       (sq_prepare
        (plugin->dbh,
-	"SELECT record_count,record_data,label"
-	" FROM ns097records WHERE zone_private_key=? ORDER BY rvalue LIMIT 1 OFFSET ?",
+	"SELECT uid,record_count,record_data,label"
+	" FROM ns097records WHERE zone_private_key=? AND uid>?"
+	" ORDER BY uid ASC LIMIT ?",
 	&plugin->iterate_zone) != SQLITE_OK) ||
       (sq_prepare
        (plugin->dbh,
-	"SELECT record_count,record_data,label,zone_private_key"
-	" FROM ns097records ORDER BY rvalue LIMIT 1 OFFSET ?",
+	"SELECT uid,record_count,record_data,label,zone_private_key"
+	" FROM ns097records WHERE uid>?"
+	" ORDER BY uid ASC LIMIT ?",
 	&plugin->iterate_all_zones) != SQLITE_OK)  ||
       (sq_prepare
        (plugin->dbh,
-        "SELECT record_count,record_data,label,zone_private_key"
+        "SELECT uid,record_count,record_data,label,zone_private_key"
         " FROM ns097records WHERE zone_private_key=? AND label=?",
         &plugin->lookup_label) != SQLITE_OK)
       )
@@ -465,12 +531,13 @@ namestore_sqlite_store_records (void *cls,
 
 /**
  * The given 'sqlite' statement has been prepared to be run.
- * It will return a record which should be given to the iterator.
- * Runs the statement and parses the returned record.
+ * It will return records which should be given to the iterator.
+ * Runs the statement and parses the returned records.
  *
  * @param plugin plugin context
  * @param stmt to run (and then clean up)
  * @param zone_key private key of the zone
+ * @param limit maximum number of records to return
  * @param iter iterator to call with the result
  * @param iter_cls closure for @a iter
  * @return #GNUNET_OK on success, #GNUNET_NO if there were no results, #GNUNET_SYSERR on error
@@ -479,8 +546,11 @@ static int
 get_record_and_call_iterator (struct Plugin *plugin,
 			      sqlite3_stmt *stmt,
 			      const struct GNUNET_CRYPTO_EcdsaPrivateKey *zone_key,
+			      uint64_t limit,
 			      GNUNET_NAMESTORE_RecordIterator iter, void *iter_cls)
 {
+  const struct GNUNET_CRYPTO_EcdsaPrivateKey *row_zone_key;
+  uint64_t serial;
   unsigned int record_count;
   size_t data_size;
   const char *data;
@@ -489,25 +559,29 @@ get_record_and_call_iterator (struct Plugin *plugin,
   int sret;
 
   ret = GNUNET_NO;
-  if (SQLITE_ROW == (sret = sqlite3_step (stmt)))
+  sret = SQLITE_DONE;
+  while ( (limit > 0) &&
+          (GNUNET_SYSERR != ret) &&
+          (SQLITE_ROW == (sret = sqlite3_step (stmt))) )
   {
-    record_count = sqlite3_column_int (stmt, 0);
-    data_size = sqlite3_column_bytes (stmt, 1);
-    data = sqlite3_column_blob (stmt, 1);
-    label = (const char*) sqlite3_column_text (stmt, 2);
+    limit--;
+    serial = (uint64_t) sqlite3_column_int64 (stmt, 0);
+    record_count = sqlite3_column_int (stmt, 1);
+    data_size = sqlite3_column_bytes (stmt, 2);
+    data = sqlite3_column_blob (stmt, 2);
+    label = (const char*) sqlite3_column_text (stmt, 3);
+    row_zone_key = zone_key;
     if (NULL == zone_key)
     {
       /* must be "iterate_all_zones", got one extra return value */
       if (sizeof (struct GNUNET_CRYPTO_EcdsaPrivateKey) !=
-	  sqlite3_column_bytes (stmt, 3))
+	  sqlite3_column_bytes (stmt, 4))
       {
 	GNUNET_break (0);
 	ret = GNUNET_SYSERR;
+	break;
       }
-      else
-      {
-	zone_key = sqlite3_column_blob (stmt, 3);
-      }
+      row_zone_key = sqlite3_column_blob (stmt, 4);
     }
     if (record_count > 64 * 1024)
     {
@@ -527,19 +601,17 @@ get_record_and_call_iterator (struct Plugin *plugin,
 	GNUNET_break (0);
 	ret = GNUNET_SYSERR;
       }
-      else if (NULL != zone_key)
+      else
       {
-      	if (NULL != iter)
-      		iter (iter_cls, zone_key, label, record_count, rd);
+	if (NULL != iter)
+	  iter (iter_cls, serial, row_zone_key, label, record_count, rd);
 	ret = GNUNET_YES;
       }
     }
   }
-  else
-  {
-    if (SQLITE_DONE != sret)
-      LOG_SQLITE (plugin, GNUNET_ERROR_TYPE_ERROR, "sqlite_step");
-  }
+  if ( (GNUNET_NO == ret) &&
+       (SQLITE_DONE != sret) )
+    LOG_SQLITE (plugin, GNUNET_ERROR_TYPE_ERROR, "sqlite_step");
   if (SQLITE_OK != sqlite3_reset (stmt))
     LOG_SQLITE (plugin,
 		GNUNET_ERROR_TYPE_ERROR | GNUNET_ERROR_TYPE_BULK,
@@ -589,17 +661,20 @@ namestore_sqlite_lookup_records (void *cls,
                   "sqlite3_reset");
     return GNUNET_SYSERR;
   }
-  return get_record_and_call_iterator (plugin, stmt, zone, iter, iter_cls);
+  return get_record_and_call_iterator (plugin, stmt, zone, 1, iter, iter_cls);
 }
 
 
 /**
- * Iterate over the results for a particular key and zone in the
- * datastore.  Will return at most one result to the iterator.
+ * Iterate over the results for a particular zone in the
+ * datastore, in the order of their serial numbers.  Will return
+ * at most @a limit results to the iterator.
  *
  * @param cls closure (internal context for the plugin)
  * @param zone hash of public key of the zone, NULL to iterate over all zones
- * @param offset offset in the list of all matching records
+ * @param serial only return records with a serial number larger
+ *        than this; 0 to start at the beginning
+ * @param limit maximum number of results to return
  * @param iter function to call with the result
  * @param iter_cls closure for @a iter
  * @return #GNUNET_OK on success, #GNUNET_NO if there were no results, #GNUNET_SYSERR on error
@@ -607,18 +682,28 @@ namestore_sqlite_lookup_records (void *cls,
 static int
 namestore_sqlite_iterate_records (void *cls,
 				  const struct GNUNET_CRYPTO_EcdsaPrivateKey *zone,
-				  uint64_t offset,
+				  uint64_t serial,
+				  uint64_t limit,
 				  GNUNET_NAMESTORE_RecordIterator iter, void *iter_cls)
 {
   struct Plugin *plugin = cls;
   sqlite3_stmt *stmt;
   int err;
 
+  if (0 == limit)
+    return GNUNET_NO;
+  /* serial numbers are uids, which are never negative */
+  if (serial > INT64_MAX)
+    serial = INT64_MAX;
+  if (limit > INT64_MAX)
+    limit = INT64_MAX;
   if (NULL == zone)
   {
     stmt = plugin->iterate_all_zones;
-    err = (SQLITE_OK != sqlite3_bind_int64 (stmt, 1,
-					    offset));
+    err = ( (SQLITE_OK != sqlite3_bind_int64 (stmt, 1,
+					      serial)) ||
+	    (SQLITE_OK != sqlite3_bind_int64 (stmt, 2,
+					      limit)) );
   }
   else
   {
@@ -627,7 +712,9 @@ namestore_sqlite_iterate_records (void *cls,
 					     zone, sizeof (struct GNUNET_CRYPTO_EcdsaPrivateKey),
 					     SQLITE_STATIC)) ||
 	    (SQLITE_OK != sqlite3_bind_int64 (stmt, 2,
-					      offset)) );
+					      serial)) ||
+	    (SQLITE_OK != sqlite3_bind_int64 (stmt, 3,
+					      limit)) );
   }
   if (err)
   {
@@ -639,7 +726,7 @@ namestore_sqlite_iterate_records (void *cls,
 		  "sqlite3_reset");
     return GNUNET_SYSERR;
   }
-  return get_record_and_call_iterator (plugin, stmt, zone, iter, iter_cls);
+  return get_record_and_call_iterator (plugin, stmt, zone, limit, iter, iter_cls);
 }
 
 
@@ -683,7 +770,7 @@ namestore_sqlite_zone_to_name (void *cls,
        "Performing reverse lookup for `%s'\n",
        GNUNET_GNSRECORD_z2s (value_zone));
 
-  return get_record_and_call_iterator (plugin, stmt, zone, iter, iter_cls);
+  return get_record_and_call_iterator (plugin, stmt, zone, 1, iter, iter_cls);
 }
 
 
@@ -81,6 +81,7 @@ load_plugin (const struct GNUNET_CONFIGURATION_Handle *cfg)
 
 static void
 test_record (void *cls,
+             uint64_t serial,
 						 const struct GNUNET_CRYPTO_EcdsaPrivateKey *private_key,
 						 const char *label,
 						 unsigned int rd_count,
@@ -112,7 +113,68 @@ static void
 get_record (struct GNUNET_NAMESTORE_PluginFunctions *nsp, int id)
 {
   GNUNET_assert (GNUNET_OK == nsp->iterate_records (nsp->cls,
-					    NULL, 0, &test_record, &id));
+					    NULL, 0, 1, &test_record, &id));
+}
+
+
+/**
+ * Closure for #page_record.
+ */
+struct PageContext
+{
+  /**
+   * Serial number of the last record we got.
+   */
+  uint64_t serial;
+
+  /**
+   * Number of records we got.
+   */
+  unsigned int count;
+};
+
+
+static void
+page_record (void *cls,
+             uint64_t serial,
+             const struct GNUNET_CRYPTO_EcdsaPrivateKey *private_key,
+             const char *label,
+             unsigned int rd_count,
+             const struct GNUNET_GNSRECORD_Data *rd)
+{
+  struct PageContext *pc = cls;
+  int id = pc->count + 1;
+
+  GNUNET_assert (serial > pc->serial);
+  pc->serial = serial;
+  pc->count++;
+  test_record (&id, serial, private_key, label, rd_count, rd);
+}
+
+
+/**
+ * Iterate over all records in pages of two, the records
+ * must be returned in the order in which they were stored.
+ *
+ * @param nsp plugin to use
+ * @param n number of records in the database
+ */
+static void
+page_records (struct GNUNET_NAMESTORE_PluginFunctions *nsp, unsigned int n)
+{
+  struct PageContext pc;
+  unsigned int before;
+
+  memset (&pc, 0, sizeof (pc));
+  do
+  {
+    before = pc.count;
+    GNUNET_assert (GNUNET_SYSERR != nsp->iterate_records (nsp->cls,
+                                                          NULL, pc.serial, 2,
+                                                          &page_record, &pc));
+  }
+  while (pc.count == before + 2);
+  GNUNET_assert (n == pc.count);
 }
 
 
@@ -163,6 +225,9 @@ run (void *cls, char *const *args, const char *cfgfile,
   }
   put_record (nsp, 1);
   get_record (nsp, 1);
+  put_record (nsp, 2);
+  put_record (nsp, 3);
+  page_records (nsp, 3);
 
   unload_plugin (nsp);
 }
@@ -48,7 +48,6 @@
 #include "gnunet_testbed_logger_service.h"
 #endif
 #include "nse.h"
-#include <gcrypt.h>
 
 
 /**
@@ -72,6 +71,19 @@
  */
 #define NSE_PRIORITY GNUNET_CORE_PRIO_CRITICAL_CONTROL
 
+/**
+ * How often do we save the progress of the search for our proof
+ * of work?
+ */
+#define PROOF_PROGRESS_FREQ GNUNET_TIME_relative_multiply (GNUNET_TIME_UNIT_SECONDS, 30)
+
+/**
+ * How many flood messages may be waiting for verification at most?
+ * Further messages are dropped, so that peers cannot make us queue
+ * an unbounded number of unverified messages.
+ */
+#define MAX_PENDING_VERIFICATIONS 64
+
 #if FREEBSD
 #define log2(a) (log(a)/log(2))
 #endif
@@ -87,10 +99,20 @@ static unsigned long long nse_work_required;
 static struct GNUNET_TIME_Relative gnunet_nse_interval;
 
 /**
- * Interval between proof find runs.
+ * Interval between proof find runs (if we search without threads).
  */
 static struct GNUNET_TIME_Relative proof_find_delay;
 
+/**
+ * Number of threads searching for our proof of work.
+ */
+static unsigned long long proof_find_threads;
+
+/**
+ * Maximum number of threads verifying flood messages.
+ */
+static unsigned long long verify_threads;
+
 #if ENABLE_NSE_HISTOGRAM
 
 /**
@@ -215,6 +237,40 @@ struct GNUNET_NSE_FloodMessage
 };
 GNUNET_NETWORK_STRUCT_END
 
+
+/**
+ * A flood message whose proof of work and signature are being
+ * verified by the #verify_pool.
+ */
+struct PendingVerification
+{
+  /**
+   * Kept in a DLL.
+   */
+  struct PendingVerification *next;
+
+  /**
+   * Kept in a DLL.
+   */
+  struct PendingVerification *prev;
+
+  /**
+   * Job verifying the message.
+   */
+  struct GNUNET_CRYPTO_WorkerJob *job;
+
+  /**
+   * Peer we received the message from.
+   */
+  struct GNUNET_PeerIdentity peer;
+
+  /**
+   * The message.
+   */
+  struct GNUNET_NSE_FloodMessage msg;
+};
+
+
 /**
  * Handle to our current configuration.
  */
@@ -278,9 +334,29 @@ static unsigned int estimate_count;
 static GNUNET_SCHEDULER_TaskIdentifier flood_task;
 
 /**
- * Task scheduled to compute our proof.
+ * Search for our proof of work, NULL once it was found.
  */
-static GNUNET_SCHEDULER_TaskIdentifier proof_task;
+static struct GNUNET_CRYPTO_PowSearch *proof_search;
+
+/**
+ * Threads verifying incoming flood messages.
+ */
+static struct GNUNET_CRYPTO_WorkerPool *verify_pool;
+
+/**
+ * Head of flood messages being verified.
+ */
+static struct PendingVerification *pv_head;
+
+/**
+ * Tail of flood messages being verified.
+ */
+static struct PendingVerification *pv_tail;
+
+/**
+ * Number of flood messages being verified.
+ */
+static unsigned int pv_count;
 
 /**
  * Notification context, simplifies client broadcasts.
@@ -483,28 +559,6 @@ get_delay_randomization (uint32_t matching_bits)
 }
 
 
-/**
- * Calculate the 'proof-of-work' hash (an expensive hash).
- *
- * @param buf data to hash
- * @param buf_len number of bytes in @a buf
- * @param result where to write the resulting hash
- */
-static void
-pow_hash (const void *buf,
-	  size_t buf_len,
-	  struct GNUNET_HashCode *result)
-{
-  GNUNET_break (0 ==
-		gcry_kdf_derive (buf, buf_len,
-				 GCRY_KDF_SCRYPT,
-				 1 /* subalgo */,
-				 "gnunet-proof-of-work", strlen ("gnunet-proof-of-work"),
-				 2 /* iterations; keep cost of individual op small */,
-				 sizeof (struct GNUNET_HashCode), result));
-}
-
-
 /**
  * Get the number of matching bits that the given timestamp has to the given peer ID.
  *
@@ -622,7 +676,7 @@ transmit_ready (void *cls,
                                       peer_entry);
   }
   if ((0 == ntohl (size_estimate_messages[idx].hop_count)) &&
-      (GNUNET_SCHEDULER_NO_TASK != proof_task))
+      (NULL != proof_search))
   {
     GNUNET_STATISTICS_update (stats,
                               "# flood messages not generated (no proof yet)",
@@ -835,24 +889,6 @@ update_flood_message (void *cls,
 }
 
 
-/**
- * Count the leading zeroes in hash.
- *
- * @param hash to count leading zeros in
- * @return the number of leading zero bits.
- */
-static unsigned int
-count_leading_zeroes (const struct GNUNET_HashCode *hash)
-{
-  unsigned int hash_count;
-
-  hash_count = 0;
-  while (0 == GNUNET_CRYPTO_hash_get_bit (hash, hash_count))
-    hash_count++;
-  return hash_count;
-}
-
-
 /**
  * Check whether the given public key and integer are a valid proof of
  * work.
@@ -872,8 +908,9 @@ check_proof_of_work (const struct GNUNET_CRYPTO_EddsaPublicKey *pkey,
   memcpy (buf, &val, sizeof (val));
   memcpy (&buf[sizeof (val)], pkey,
           sizeof (struct GNUNET_CRYPTO_EddsaPublicKey));
-  pow_hash (buf, sizeof (buf), &result);
-  return (count_leading_zeroes (&result) >=
+  GNUNET_CRYPTO_pow_hash ("gnunet-proof-of-work",
+                          buf, sizeof (buf), &result);
+  return (GNUNET_CRYPTO_hash_count_leading_zeros (&result) >=
           nse_work_required) ? GNUNET_YES : GNUNET_NO;
 }
 
@@ -900,95 +937,69 @@ write_proof ()
 
 
 /**
- * Find our proof of work.
+ * Called with the progress of the search for our proof of work,
+ * or with the proof once it was found.
  *
  * @param cls closure (unused)
- * @param tc task context
+ * @param pow the proof, or the value to resume the search at
+ * @param hash_rate hashes per second calculated recently
+ * @param found #GNUNET_YES if @a pow is our proof of work
  */
 static void
-find_proof (void *cls,
-	    const struct GNUNET_SCHEDULER_TaskContext *tc)
+proof_search_cb (void *cls,
+                 uint64_t pow,
+                 uint64_t hash_rate,
+                 int found)
 {
-#define ROUND_SIZE 10
-  uint64_t counter;
-  char buf[sizeof (struct GNUNET_CRYPTO_EddsaPublicKey) +
-           sizeof (uint64_t)] GNUNET_ALIGN;
-  struct GNUNET_HashCode result;
-  unsigned int i;
-
-  proof_task = GNUNET_SCHEDULER_NO_TASK;
-  memcpy (&buf[sizeof (uint64_t)], &my_identity,
-          sizeof (struct GNUNET_PeerIdentity));
-  i = 0;
-  counter = my_proof;
-  while ((counter != UINT64_MAX) && (i < ROUND_SIZE))
-  {
-    memcpy (buf, &counter, sizeof (uint64_t));
-    pow_hash (buf, sizeof (buf), &result);
-    if (nse_work_required <= count_leading_zeroes (&result))
-    {
-      my_proof = counter;
-      GNUNET_log (GNUNET_ERROR_TYPE_DEBUG, "Proof of work found: %llu!\n",
-                  (unsigned long long) GNUNET_ntohll (counter));
-      write_proof ();
-      setup_flood_message (estimate_index, current_timestamp);
-      return;
-    }
-    counter++;
-    i++;
-  }
-  if (my_proof / (100 * ROUND_SIZE) < counter / (100 * ROUND_SIZE))
+  my_proof = pow;
+  GNUNET_STATISTICS_set (stats,
+                         "# proof-of-work hashes per second",
+                         hash_rate, GNUNET_NO);
+  if (GNUNET_YES != found)
   {
-    GNUNET_log (GNUNET_ERROR_TYPE_DEBUG, "Testing proofs currently at %llu\n",
-                (unsigned long long) counter);
-    /* remember progress every 100 rounds */
-    my_proof = counter;
+    GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
+                "Testing proofs currently at %llu (%llu hashes/s)\n",
+                (unsigned long long) pow,
+                (unsigned long long) hash_rate);
+    /* remember progress */
     write_proof ();
+    return;
   }
-  else
-  {
-    my_proof = counter;
-  }
-  proof_task =
-      GNUNET_SCHEDULER_add_delayed_with_priority (proof_find_delay,
-						  GNUNET_SCHEDULER_PRIORITY_IDLE,
-						  &find_proof, NULL);
+  proof_search = NULL;
+  GNUNET_log (GNUNET_ERROR_TYPE_DEBUG, "Proof of work found: %llu!\n",
+              (unsigned long long) GNUNET_ntohll (pow));
+  write_proof ();
+  setup_flood_message (estimate_index, current_timestamp);
 }
 
 
 /**
  * An incoming flood message has been received which claims
  * to have more bits matching than any we know in this time
- * period.  Verify the signature and/or proof of work.
+ * period.  Verify the signature and/or proof of work.  Runs
+ * in a thread of the #verify_pool.
  *
- * @param incoming_flood the message to verify
+ * @param cls the `struct PendingVerification` with the message to verify
  * @return #GNUNET_YES if the message is verified
  *         #GNUNET_NO if the key/signature don't verify
  */
 static int
-verify_message_crypto (const struct GNUNET_NSE_FloodMessage *incoming_flood)
+verify_message_crypto (void *cls)
 {
+  const struct PendingVerification *pv = cls;
+  const struct GNUNET_NSE_FloodMessage *incoming_flood = &pv->msg;
+
   if (GNUNET_YES !=
       check_proof_of_work (&incoming_flood->origin.public_key,
                            incoming_flood->proof_of_work))
-  {
-    GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
-                "Proof of work invalid: %llu!\n",
-                (unsigned long long)
-                GNUNET_ntohll (incoming_flood->proof_of_work));
-    GNUNET_break_op (0);
     return GNUNET_NO;
-  }
   if ((nse_work_required > 0) &&
       (GNUNET_OK !=
        GNUNET_CRYPTO_eddsa_verify (GNUNET_SIGNATURE_PURPOSE_NSE_SEND,
                                  &incoming_flood->purpose,
                                  &incoming_flood->signature,
                                  &incoming_flood->origin.public_key)))
-  {
-    GNUNET_break_op (0);
     return GNUNET_NO;
-  }
   return GNUNET_YES;
 }
 
@@ -1038,73 +1049,31 @@ update_flood_times (void *cls,
 }
 
 
+static void
+verify_flood (struct NSEPeerEntry *peer_entry,
+              const struct GNUNET_NSE_FloodMessage *incoming_flood);
+
+
 /**
- * Core handler for size estimate flooding messages.
+ * Process a size estimate flooding message.  If the message would
+ * improve our estimate, it is only used once its proof of work and
+ * signature were verified.
  *
- * @param cls closure unused
- * @param message message
- * @param peer peer identity this message is from (ignored)
+ * @param peer_entry peer we received the message from
+ * @param incoming_flood the message
+ * @param verified #GNUNET_YES if the crypto of the message was verified
  */
-static int
-handle_p2p_size_estimate (void *cls,
-			  const struct GNUNET_PeerIdentity *peer,
-                          const struct GNUNET_MessageHeader *message)
+static void
+process_flood (struct NSEPeerEntry *peer_entry,
+               const struct GNUNET_NSE_FloodMessage *incoming_flood,
+               int verified)
 {
-  const struct GNUNET_NSE_FloodMessage *incoming_flood;
+  const struct GNUNET_PeerIdentity *peer = &peer_entry->id;
   struct GNUNET_TIME_Absolute ts;
-  struct NSEPeerEntry *peer_entry;
   uint32_t matching_bits;
   unsigned int idx;
 
-#if ENABLE_NSE_HISTOGRAM
-  {
-    uint64_t t;
-
-    t = GNUNET_TIME_absolute_get().abs_value_us;
-    if (NULL != lh)
-      GNUNET_TESTBED_LOGGER_write (lh, &t, sizeof (uint64_t));
-    if (NULL != histogram)
-      GNUNET_BIO_write_int64 (histogram, t);
-  }
-#endif
-  incoming_flood = (const struct GNUNET_NSE_FloodMessage *) message;
-  GNUNET_STATISTICS_update (stats, "# flood messages received", 1, GNUNET_NO);
   matching_bits = ntohl (incoming_flood->matching_bits);
-#if DEBUG_NSE
-  {
-    char origin[5];
-    char pred[5];
-    struct GNUNET_PeerIdentity os;
-
-    GNUNET_snprintf (origin,
-		     sizeof (origin),
-		     "%4s",
-		     GNUNET_i2s (&incoming_flood->origin));
-    GNUNET_snprintf (pred,
-		     sizeof (pred),
-		     "%4s",
-		     GNUNET_i2s (peer));
-    GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
-                "Flood at %s from `%s' via `%s' at `%s' with bits %u\n",
-                GNUNET_STRINGS_absolute_time_to_string (GNUNET_TIME_absolute_ntoh (incoming_flood->timestamp)),
-                origin, pred, GNUNET_i2s (&my_identity),
-                (unsigned int) matching_bits);
-  }
-#endif
-
-  peer_entry = GNUNET_CONTAINER_multipeermap_get (peers, peer);
-  if (NULL == peer_entry)
-  {
-    GNUNET_break (0);
-    return GNUNET_OK;
-  }
-#if ENABLE_NSE_HISTOGRAM
-  peer_entry->received_messages++;
-  if (peer_entry->transmitted_messages > 0 &&
-      peer_entry->last_transmitted_size >= matching_bits)
-    GNUNET_STATISTICS_update(stats, "# cross messages", 1, GNUNET_NO);
-#endif
-
   ts = GNUNET_TIME_absolute_ntoh (incoming_flood->timestamp);
   if (ts.abs_value_us == current_timestamp.abs_value_us)
     idx = estimate_index;
@@ -1114,21 +1083,21 @@ handle_p2p_size_estimate (void *cls,
   else if (ts.abs_value_us == next_timestamp.abs_value_us)
   {
     if (matching_bits <= ntohl (next_message.matching_bits))
-      return GNUNET_OK;         /* ignore, simply too early/late */
-    if (GNUNET_YES != verify_message_crypto (incoming_flood))
+      return;         /* ignore, simply too early/late */
+    if (GNUNET_YES != verified)
     {
-      GNUNET_break_op (0);
-      return GNUNET_OK;
+      verify_flood (peer_entry, incoming_flood);
+      return;
     }
     next_message = *incoming_flood;
-    return GNUNET_OK;
+    return;
   }
   else
   {
     GNUNET_STATISTICS_update (stats,
                               "# flood messages discarded (clock skew too large)",
                               1, GNUNET_NO);
-    return GNUNET_OK;
+    return;
   }
   if (0 == (memcmp (peer, &my_identity, sizeof (struct GNUNET_PeerIdentity))))
   {
@@ -1137,7 +1106,7 @@ handle_p2p_size_estimate (void *cls,
         memcmp (&incoming_flood->origin,
 		&my_identity, sizeof (my_identity)))
       update_network_size_estimate ();
-    return GNUNET_OK;
+    return;
   }
   if (matching_bits == ntohl (size_estimate_messages[idx].matching_bits))
   {
@@ -1150,7 +1119,7 @@ handle_p2p_size_estimate (void *cls,
     {
       /* do not transmit information for the previous round to this peer
          anymore (but allow current round) */
-      return GNUNET_OK;
+      return;
     }
     /* got up-to-date information for current round, cancel transmission to
      * this peer altogether */
@@ -1164,7 +1133,7 @@ handle_p2p_size_estimate (void *cls,
       GNUNET_CORE_notify_transmit_ready_cancel (peer_entry->th);
       peer_entry->th = NULL;
     }
-    return GNUNET_OK;
+    return;
   }
   if (matching_bits < ntohl (size_estimate_messages[idx].matching_bits))
   {
@@ -1183,12 +1152,12 @@ handle_p2p_size_estimate (void *cls,
     GNUNET_STATISTICS_update (stats,
                               "# flood messages ignored (had closer already)",
                               1, GNUNET_NO);
-    return GNUNET_OK;
+    return;
   }
-  if (GNUNET_YES != verify_message_crypto (incoming_flood))
+  if (GNUNET_YES != verified)
   {
-    GNUNET_break_op (0);
-    return GNUNET_OK;
+    verify_flood (peer_entry, incoming_flood);
+    return;
   }
   GNUNET_assert (matching_bits >
                  ntohl (size_estimate_messages[idx].matching_bits));
@@ -1225,6 +1194,153 @@ handle_p2p_size_estimate (void *cls,
   /* flood to rest */
   GNUNET_CONTAINER_multipeermap_iterate (peers, &update_flood_times,
                                          peer_entry);
+}
+
+
+/**
+ * The #verify_pool is done verifying a flood message.  If the
+ * message is valid and the peer still connected, process it.
+ *
+ * @param cls the `struct PendingVerification`
+ * @param result #GNUNET_YES if the message is valid
+ */
+static void
+flood_verified (void *cls,
+                int result)
+{
+  struct PendingVerification *pv = cls;
+  struct NSEPeerEntry *peer_entry;
+
+  GNUNET_CONTAINER_DLL_remove (pv_head, pv_tail, pv);
+  pv_count--;
+  if (GNUNET_YES != result)
+  {
+    GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
+                "Proof of work %llu or signature invalid!\n",
+                (unsigned long long)
+                GNUNET_ntohll (pv->msg.proof_of_work));
+    GNUNET_break_op (0);
+    GNUNET_STATISTICS_update (stats,
+                              "# flood messages discarded (invalid proof or signature)",
+                              1, GNUNET_NO);
+    GNUNET_free (pv);
+    return;
+  }
+  /* the peer may have disconnected in the meantime */
+  peer_entry = GNUNET_CONTAINER_multipeermap_get (peers, &pv->peer);
+  if (NULL != peer_entry)
+    process_flood (peer_entry, &pv->msg, GNUNET_YES);
+  GNUNET_free (pv);
+}
+
+
+/**
+ * Have the #verify_pool check the proof of work and signature of
+ * a flood message; it is processed again once it was verified.
+ * Messages that are already being verified and messages beyond
+ * #MAX_PENDING_VERIFICATIONS are dropped.
+ *
+ * @param peer_entry peer we received the message from
+ * @param incoming_flood the message to verify
+ */
+static void
+verify_flood (struct NSEPeerEntry *peer_entry,
+              const struct GNUNET_NSE_FloodMessage *incoming_flood)
+{
+  struct PendingVerification *pv;
+
+  for (pv = pv_head; NULL != pv; pv = pv->next)
+    if (0 == memcmp (&pv->msg,
+                     incoming_flood,
+                     sizeof (struct GNUNET_NSE_FloodMessage)))
+    {
+      GNUNET_STATISTICS_update (stats,
+                                "# flood messages ignored (already being verified)",
+                                1, GNUNET_NO);
+      return;
+    }
+  if (pv_count >= MAX_PENDING_VERIFICATIONS)
+  {
+    GNUNET_STATISTICS_update (stats,
+                              "# flood messages dropped (too many being verified)",
+                              1, GNUNET_NO);
+    return;
+  }
+  pv_count++;
+  pv = GNUNET_new (struct PendingVerification);
+  pv->peer = peer_entry->id;
+  pv->msg = *incoming_flood;
+  GNUNET_CONTAINER_DLL_insert_tail (pv_head, pv_tail, pv);
+  pv->job = GNUNET_CRYPTO_worker_pool_submit (verify_pool,
+                                              &verify_message_crypto, pv,
+                                              &flood_verified, pv);
+}
+
+
+/**
+ * Core handler for size estimate flooding messages.
+ *
+ * @param cls closure unused
+ * @param message message
+ * @param peer peer identity this message is from (ignored)
+ */
+static int
+handle_p2p_size_estimate (void *cls,
+			  const struct GNUNET_PeerIdentity *peer,
+                          const struct GNUNET_MessageHeader *message)
+{
+  const struct GNUNET_NSE_FloodMessage *incoming_flood;
+  struct NSEPeerEntry *peer_entry;
+
+#if ENABLE_NSE_HISTOGRAM
+  {
+    uint64_t t;
+
+    t = GNUNET_TIME_absolute_get().abs_value_us;
+    if (NULL != lh)
+      GNUNET_TESTBED_LOGGER_write (lh, &t, sizeof (uint64_t));
+    if (NULL != histogram)
+      GNUNET_BIO_write_int64 (histogram, t);
+  }
+#endif
+  incoming_flood = (const struct GNUNET_NSE_FloodMessage *) message;
+  GNUNET_STATISTICS_update (stats, "# flood messages received", 1, GNUNET_NO);
+#if DEBUG_NSE
+  {
+    char origin[5];
+    char pred[5];
+    struct GNUNET_PeerIdentity os;
+
+    GNUNET_snprintf (origin,
+		     sizeof (origin),
+		     "%4s",
+		     GNUNET_i2s (&incoming_flood->origin));
+    GNUNET_snprintf (pred,
+		     sizeof (pred),
+		     "%4s",
+		     GNUNET_i2s (peer));
+    GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
+                "Flood at %s from `%s' via `%s' at `%s' with bits %u\n",
+                GNUNET_STRINGS_absolute_time_to_string (GNUNET_TIME_absolute_ntoh (incoming_flood->timestamp)),
+                origin, pred, GNUNET_i2s (&my_identity),
+                (unsigned int) ntohl (incoming_flood->matching_bits));
+  }
+#endif
+
+  peer_entry = GNUNET_CONTAINER_multipeermap_get (peers, peer);
+  if (NULL == peer_entry)
+  {
+    GNUNET_break (0);
+    return GNUNET_OK;
+  }
+#if ENABLE_NSE_HISTOGRAM
+  peer_entry->received_messages++;
+  if (peer_entry->transmitted_messages > 0 &&
+      peer_entry->last_transmitted_size >=
+      ntohl (incoming_flood->matching_bits))
+    GNUNET_STATISTICS_update(stats, "# cross messages", 1, GNUNET_NO);
+#endif
+  process_flood (peer_entry, incoming_flood, GNUNET_NO);
   return GNUNET_OK;
 }
 
@@ -1325,15 +1441,29 @@ static void
 shutdown_task (void *cls,
 	       const struct GNUNET_SCHEDULER_TaskContext *tc)
 {
+  struct PendingVerification *pv;
+
   if (GNUNET_SCHEDULER_NO_TASK != flood_task)
   {
     GNUNET_SCHEDULER_cancel (flood_task);
     flood_task = GNUNET_SCHEDULER_NO_TASK;
   }
-  if (GNUNET_SCHEDULER_NO_TASK != proof_task)
+  while (NULL != (pv = pv_head))
+  {
+    GNUNET_CONTAINER_DLL_remove (pv_head, pv_tail, pv);
+    pv_count--;
+    GNUNET_CRYPTO_worker_job_cancel (pv->job);
+    GNUNET_free (pv);
+  }
+  if (NULL != verify_pool)
+  {
+    GNUNET_CRYPTO_worker_pool_destroy (verify_pool);
+    verify_pool = NULL;
+  }
+  if (NULL != proof_search)
   {
-    GNUNET_SCHEDULER_cancel (proof_task);
-    proof_task = GNUNET_SCHEDULER_NO_TASK;
+    my_proof = GNUNET_CRYPTO_pow_search_stop (proof_search);
+    proof_search = NULL;
     write_proof ();             /* remember progress */
   }
   if (NULL != nc)
@@ -1500,6 +1630,14 @@ run (void *cls,
     GNUNET_SCHEDULER_shutdown ();
     return;
   }
+  if (GNUNET_OK !=
+      GNUNET_CONFIGURATION_get_value_number (cfg, "NSE", "WORKTHREADS",
+					     &proof_find_threads))
+    proof_find_threads = 1;
+  if (GNUNET_OK !=
+      GNUNET_CONFIGURATION_get_value_number (cfg, "NSE", "VERIFYTHREADS",
+					     &verify_threads))
+    verify_threads = 0;
   if (GNUNET_OK !=
       GNUNET_CONFIGURATION_get_value_number (cfg, "NSE", "WORKBITS",
 					     &nse_work_required))
@@ -1565,10 +1703,18 @@ run (void *cls,
        GNUNET_DISK_fn_read (proof, &my_proof, sizeof (my_proof))))
     my_proof = 0;
   GNUNET_free (proof);
-  proof_task =
-      GNUNET_SCHEDULER_add_with_priority (GNUNET_SCHEDULER_PRIORITY_IDLE,
-                                          &find_proof, NULL);
-
+  proof_search =
+      GNUNET_CRYPTO_pow_search_start ("gnunet-proof-of-work",
+                                      &my_identity,
+                                      sizeof (struct GNUNET_PeerIdentity),
+                                      my_proof,
+                                      (unsigned int) nse_work_required,
+                                      (unsigned int) proof_find_threads,
+                                      proof_find_delay,
+                                      PROOF_PROGRESS_FREQ,
+                                      &proof_search_cb, NULL);
+
+  verify_pool = GNUNET_CRYPTO_worker_pool_create ((unsigned int) verify_threads);
   peers = GNUNET_CONTAINER_multipeermap_create (128, GNUNET_NO);
   GNUNET_SERVER_add_handlers (srv, handlers);
   nc = GNUNET_SERVER_notification_context_create (srv, 1);
@@ -25,31 +25,18 @@
  */
 #include "platform.h"
 #include "gnunet_util_lib.h"
-#include <gcrypt.h>
 #include <gauger.h>
 
 
 
 /**
- * Calculate the 'proof-of-work' hash (an expensive hash).
- *
- * @param buf data to hash
- * @param buf_len number of bytes in 'buf'
- * @param result where to write the resulting hash
+ * For how long do we run the proof-of-work search?
  */
-static void
-pow_hash (const void *buf,
-	  size_t buf_len,
-	  struct GNUNET_HashCode *result)
-{
-  GNUNET_break (0 ==
-		gcry_kdf_derive (buf, buf_len,
-				 GCRY_KDF_SCRYPT,
-				 1 /* subalgo */,
-				 "gnunet-proof-of-work", strlen ("gnunet-proof-of-work"),
-				 2 /* iterations; keep cost of individual op small */,
-				 sizeof (struct GNUNET_HashCode), result));
-}
+#define SEARCH_TIME GNUNET_TIME_relative_multiply (GNUNET_TIME_UNIT_SECONDS, 5)
+
+static struct GNUNET_CRYPTO_PowSearch *ps;
+
+static uint64_t search_rate;
 
 
 static void
@@ -61,7 +48,46 @@ perfHash ()
 
   memset (buf, 1,  sizeof (buf));
   for (i = 0; i < 1024; i++)
-    pow_hash (buf, sizeof (buf), &hc);
+    GNUNET_CRYPTO_pow_hash ("gnunet-proof-of-work",
+                            buf, sizeof (buf), &hc);
+}
+
+
+/**
+ * Remember the hash rate of the search and stop it.
+ */
+static void
+search_cb (void *cls,
+           uint64_t pow,
+           uint64_t hash_rate,
+           int found)
+{
+  GNUNET_break (GNUNET_NO == found);
+  search_rate = hash_rate;
+  (void) GNUNET_CRYPTO_pow_search_stop (ps);
+  ps = NULL;
+}
+
+
+/**
+ * Search for a proof of work that does not exist, using one
+ * thread per CPU, to measure the hash rate of the search.
+ */
+static void
+perfSearch (void *cls,
+            const struct GNUNET_SCHEDULER_TaskContext *tc)
+{
+  char buf[32];
+
+  memset (buf, 1,  sizeof (buf));
+  ps = GNUNET_CRYPTO_pow_search_start ("gnunet-proof-of-work",
+                                       buf, sizeof (buf),
+                                       0,
+                                       8 * sizeof (struct GNUNET_HashCode),
+                                       0,
+                                       GNUNET_TIME_UNIT_ZERO,
+                                       SEARCH_TIME,
+                                       &search_cb, NULL);
 }
 
 
@@ -79,6 +105,11 @@ main (int argc, char *argv[])
           1024 / (1 +
 		  GNUNET_TIME_absolute_get_duration
 		  (start).rel_value_us / 1000LL), "hashes/ms");
+  GNUNET_SCHEDULER_run (&perfSearch, NULL);
+  printf ("Proof-of-work search: %llu hashes/s\n",
+          (unsigned long long) search_rate);
+  GAUGER ("NSE", "Proof-of-work search",
+          search_rate, "hashes/s");
   return 0;
 }
 
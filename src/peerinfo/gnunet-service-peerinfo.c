@@ -45,6 +45,63 @@
  */
 #define DATA_HOST_CLEAN_FREQ GNUNET_TIME_relative_multiply (GNUNET_TIME_UNIT_MINUTES, 60)
 
+/**
+ * Magic number at the beginning of each record in the HELLO database.
+ */
+#define DB_RECORD_MAGIC 0x50494442
+
+/**
+ * Only compact the HELLO database once it is at least this large.
+ */
+#define DB_COMPACT_MIN_SIZE (256 * 1024)
+
+/**
+ * How long do we wait after appending to the HELLO database before
+ * we sync it to disk (so that updates in a burst share one sync)?
+ */
+#define DB_SYNC_DELAY GNUNET_TIME_relative_multiply (GNUNET_TIME_UNIT_SECONDS, 5)
+
+
+GNUNET_NETWORK_STRUCT_BEGIN
+
+/**
+ * Header of a record in the HELLO database.  The database is an
+ * append-only sequence of records, the last record for a peer is
+ * the current one.  The header is followed by @e size bytes with
+ * the public and/or friend-only HELLO of the peer, in the same
+ * format as the files in the hosts directory.
+ */
+struct DatabaseRecord
+{
+  /**
+   * Always #DB_RECORD_MAGIC, in network byte order.
+   */
+  uint32_t magic GNUNET_PACKED;
+
+  /**
+   * Number of bytes of HELLOs following the header, zero if
+   * the peer was removed, in network byte order.
+   */
+  uint32_t size GNUNET_PACKED;
+
+  /**
+   * CRC32 of the HELLOs following the header, in network byte order.
+   */
+  uint32_t crc GNUNET_PACKED;
+
+  /**
+   * Always zero.
+   */
+  uint32_t reserved GNUNET_PACKED;
+
+  /**
+   * Identity of the peer.
+   */
+  struct GNUNET_PeerIdentity peer;
+};
+
+GNUNET_NETWORK_STRUCT_END
+
 
 /**
  * In-memory cache of known hosts.
@@ -67,6 +124,12 @@ struct HostEntry
    */
   struct GNUNET_HELLO_Message *friend_only_hello;
 
+  /**
+   * Number of bytes (including the header) of the current record
+   * of this peer in the HELLO database, 0 for none.
+   */
+  uint32_t db_size;
+
 };
 
 /**
@@ -146,6 +209,34 @@ static struct GNUNET_SERVER_NotificationContext *notify_list;
  */
 static char *networkIdDirectory;
 
+/**
+ * Name of the HELLO database, NULL if we store one file per peer
+ * in #networkIdDirectory instead (or do no IO at all).  If set,
+ * files in #networkIdDirectory are only imported into the database.
+ */
+static char *db_filename;
+
+/**
+ * Handle of the HELLO database, records are appended to it.
+ */
+static struct GNUNET_DISK_FileHandle *db_fh;
+
+/**
+ * Current size of the HELLO database.
+ */
+static uint64_t db_size;
+
+/**
+ * Number of bytes in the HELLO database used by current records,
+ * the rest is garbage to be removed by compaction.
+ */
+static uint64_t db_live;
+
+/**
+ * Task that syncs appended records of the HELLO database to disk.
+ */
+static GNUNET_SCHEDULER_TaskIdentifier db_sync_task;
+
 /**
  * Handle for reporting statistics.
  */
@@ -312,72 +403,57 @@ update_hello (const struct GNUNET_PeerIdentity *peer,
 
 
 /**
- * Try to read the HELLOs in the given filename and discard expired
- * addresses.  Removes the file if one the HELLO is malformed.  If all
- * addresses are expired, the HELLO is also removed (but the HELLO
- * with the public key is still returned if it was found and valid).
- * The file can contain multiple HELLO messages.
+ * Parse the HELLOs in the given buffer and discard expired
+ * addresses.  The buffer can contain multiple HELLO messages.
  *
- * @param fn name of the file
- * @param unlink_garbage if #GNUNET_YES, try to remove useless files
- * @param r ReadHostFileContext to store the resutl
+ * @param buffer HELLOs, in the format of the files in the hosts directory
+ * @param size number of bytes in @a buffer
+ * @param source where the HELLOs are from, for logging
+ * @param r ReadHostFileContext to store the result
+ * @return #GNUNET_OK if a HELLO with addresses was found,
+ *         #GNUNET_NO if all addresses are expired,
+ *         #GNUNET_SYSERR if the data is malformed
  */
-static void
-read_host_file (const char *fn,
-                int unlink_garbage,
-                struct ReadHostFileContext *r)
+static int
+parse_hellos (const char *buffer,
+              size_t size,
+              const char *source,
+              struct ReadHostFileContext *r)
 {
-  char buffer[GNUNET_SERVER_MAX_MESSAGE_SIZE - 1] GNUNET_ALIGN;
-  unsigned int size_total;
   struct GNUNET_TIME_Absolute now;
   unsigned int left;
   const struct GNUNET_HELLO_Message *hello;
   struct GNUNET_HELLO_Message *hello_clean;
-  unsigned read_pos;
-  int size_hello;
+  size_t read_pos;
+  uint16_t size_hello;
 
   r->friend_only_hello = NULL;
   r->hello = NULL;
-
-  if (GNUNET_YES != GNUNET_DISK_file_test (fn))
-    return;
-  size_total = GNUNET_DISK_fn_read (fn, buffer, sizeof (buffer));
-  GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
-              "Read %u bytes from `%s'\n",
-              size_total,
-              fn);
-  if (size_total < sizeof (struct GNUNET_MessageHeader))
+  if (size < sizeof (struct GNUNET_MessageHeader))
   {
     GNUNET_log (GNUNET_ERROR_TYPE_ERROR,
 		_("Failed to parse HELLO in file `%s': %s\n"),
-		fn, "Fail has invalid size");
-    if ( (GNUNET_YES == unlink_garbage) &&
-	 (0 != UNLINK (fn)) &&
-	 (ENOENT != errno) )
-      GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_WARNING,
-                                "unlink",
-                                fn);
-    return;
+		source, "Fail has invalid size");
+    return GNUNET_SYSERR;
   }
 
+  left = 0;
   read_pos = 0;
-  while (read_pos < size_total)
+  while (read_pos < size)
   {
     hello = (const struct GNUNET_HELLO_Message *) &buffer[read_pos];
-    size_hello = GNUNET_HELLO_size (hello);
-    if (0 == size_hello)
-      {
-	GNUNET_log (GNUNET_ERROR_TYPE_ERROR,
-		    _("Failed to parse HELLO in file `%s'\n"),
-		    fn);
-	if ((GNUNET_YES == unlink_garbage) &&
-	    (0 != UNLINK (fn)) &&
-	    (ENOENT != errno) )
-	  GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_WARNING,
-                                    "unlink",
-                                    fn);
-	return;
-      }
+    if (size - read_pos < sizeof (struct GNUNET_MessageHeader))
+      size_hello = 0;
+    else
+      size_hello = GNUNET_HELLO_size (hello);
+    if ( (0 == size_hello) ||
+         (size_hello > size - read_pos) )
+    {
+      GNUNET_log (GNUNET_ERROR_TYPE_ERROR,
+                  _("Failed to parse HELLO in file `%s'\n"),
+                  source);
+      return GNUNET_SYSERR;
+    }
 
     now = GNUNET_TIME_absolute_get ();
     hello_clean = GNUNET_HELLO_iterate_addresses (hello, GNUNET_YES,
@@ -386,14 +462,8 @@ read_host_file (const char *fn,
     {
       GNUNET_log (GNUNET_ERROR_TYPE_ERROR,
                   _("Failed to parse HELLO in file `%s'\n"),
-                  fn);
-      if ((GNUNET_YES == unlink_garbage) &&
-          (0 != UNLINK (fn)) &&
-          (ENOENT != errno) )
-        GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_WARNING,
-                                  "unlink",
-                                  fn);
-      return;
+                  source);
+      return GNUNET_SYSERR;
     }
     left = 0;
     (void) GNUNET_HELLO_iterate_addresses (hello_clean, GNUNET_NO,
@@ -429,20 +499,52 @@ read_host_file (const char *fn,
     }
     read_pos += size_hello;
   }
-
-  if (0 == left)
-  {
-    /* no addresses left, remove from disk */
-    if ( (GNUNET_YES == unlink_garbage) &&
-         (0 != UNLINK (fn)) )
-      GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_WARNING,
-                                "unlink",
-                                fn);
-  }
   GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
 	      "Found `%s' and `%s' HELLO message in file\n",
 	      (NULL != r->hello) ? "public" : "NON-public",
 	      (NULL != r->friend_only_hello) ? "friend only" : "NO friend only");
+  return (0 == left) ? GNUNET_NO : GNUNET_OK;
+}
+
+
+/**
+ * Try to read the HELLOs in the given filename and discard expired
+ * addresses.  Removes the file if one the HELLO is malformed.  If all
+ * addresses are expired, the HELLO is also removed (but the HELLO
+ * with the public key is still returned if it was found and valid).
+ * The file can contain multiple HELLO messages.
+ *
+ * @param fn name of the file
+ * @param unlink_garbage if #GNUNET_YES, try to remove useless files
+ * @param r ReadHostFileContext to store the resutl
+ */
+static void
+read_host_file (const char *fn,
+                int unlink_garbage,
+                struct ReadHostFileContext *r)
+{
+  char buffer[GNUNET_SERVER_MAX_MESSAGE_SIZE - 1] GNUNET_ALIGN;
+  ssize_t size_total;
+
+  r->friend_only_hello = NULL;
+  r->hello = NULL;
+
+  if (GNUNET_YES != GNUNET_DISK_file_test (fn))
+    return;
+  size_total = GNUNET_DISK_fn_read (fn, buffer, sizeof (buffer));
+  GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
+              "Read %d bytes from `%s'\n",
+              (int) size_total,
+              fn);
+  if (size_total < 0)
+    size_total = 0;
+  if ( (GNUNET_OK != parse_hellos (buffer, size_total, fn, r)) &&
+       (GNUNET_YES == unlink_garbage) &&
+       (0 != UNLINK (fn)) &&
+       (ENOENT != errno) )
+    GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_WARNING,
+                              "unlink",
+                              fn);
 }
 
 
@@ -475,6 +577,8 @@ add_host_to_known_hosts (const struct GNUNET_PeerIdentity *identity)
                                                       entry,
                                                       GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_ONLY));
     notify_all (entry);
+    if (NULL != db_filename)
+      return entry; /* database was loaded at startup */
     fn = get_host_filename (identity);
     if (NULL != fn)
     {
@@ -629,6 +733,19 @@ hosts_directory_scan_callback (void *cls,
     update_hello (&id, r.friend_only_hello);
     GNUNET_free (r.friend_only_hello);
   }
+  if ( (NULL != db_filename) &&
+       (GNUNET_YES == dsc->remove_files) )
+  {
+    /* HELLOs are now in the database, the file is no longer needed */
+    if (0 != UNLINK (fullname))
+      GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_WARNING,
+                                "unlink",
+                                fullname);
+    else
+      GNUNET_STATISTICS_update (stats,
+                                gettext_noop ("# HELLO files imported into database"),
+                                1, GNUNET_NO);
+  }
   dsc->matched++;
   return GNUNET_OK;
 }
@@ -710,6 +827,435 @@ update_friend_hello (const struct GNUNET_HELLO_Message *hello,
 }
 
 
+/**
+ * Serialize the HELLOs of a host that still have addresses, in the
+ * format of the files in the hosts directory.
+ *
+ * @param host the host
+ * @param size set to the number of bytes in the result
+ * @return NULL if none of the HELLOs of @a host has addresses
+ */
+static char *
+serialize_host (const struct HostEntry *host,
+                size_t *size)
+{
+  unsigned int cnt;
+  int store_hello;
+  int store_friend_hello;
+  size_t pos;
+  char *buffer;
+
+  store_hello = GNUNET_NO;
+  *size = 0;
+  cnt = 0;
+  if (NULL != host->hello)
+    (void) GNUNET_HELLO_iterate_addresses (host->hello,
+                                           GNUNET_NO,
+                                           &count_addresses,
+                                           &cnt);
+  if (cnt > 0)
+  {
+    store_hello = GNUNET_YES;
+    *size += GNUNET_HELLO_size (host->hello);
+  }
+  cnt = 0;
+  if (NULL != host->friend_only_hello)
+    (void) GNUNET_HELLO_iterate_addresses (host->friend_only_hello,
+                                           GNUNET_NO,
+                                           &count_addresses,
+                                           &cnt);
+  store_friend_hello = GNUNET_NO;
+  if (0 < cnt)
+  {
+    store_friend_hello = GNUNET_YES;
+    *size += GNUNET_HELLO_size (host->friend_only_hello);
+  }
+  if ( (GNUNET_NO == store_hello) &&
+       (GNUNET_NO == store_friend_hello) )
+    return NULL;
+  buffer = GNUNET_malloc (*size);
+  pos = 0;
+  if (GNUNET_YES == store_hello)
+  {
+    memcpy (buffer, host->hello,
+            GNUNET_HELLO_size (host->hello));
+    pos += GNUNET_HELLO_size (host->hello);
+  }
+  if (GNUNET_YES == store_friend_hello)
+  {
+    memcpy (&buffer[pos], host->friend_only_hello,
+            GNUNET_HELLO_size (host->friend_only_hello));
+    pos += GNUNET_HELLO_size (host->friend_only_hello);
+  }
+  GNUNET_assert (pos == *size);
+  return buffer;
+}
+
+
+/**
+ * Sync the records appended to the HELLO database to disk.  Records
+ * torn by a crash before this are dropped (and the tail rewritten)
+ * by #db_load().
+ *
+ * @param cls NULL
+ * @param tc scheduler context
+ */
+static void
+db_sync (void *cls,
+         const struct GNUNET_SCHEDULER_TaskContext *tc)
+{
+  db_sync_task = GNUNET_SCHEDULER_NO_TASK;
+  if ( (NULL != db_fh) &&
+       (GNUNET_OK != GNUNET_DISK_file_sync (db_fh)) )
+    GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_WARNING,
+                              "fsync",
+                              db_filename);
+}
+
+
+/**
+ * Append a record to the HELLO database.
+ *
+ * @param peer peer the record is about
+ * @param data HELLOs of the peer, NULL to mark the peer as removed
+ * @param size number of bytes in @a data
+ * @return number of bytes appended, 0 on error
+ */
+static uint32_t
+db_append_record (const struct GNUNET_PeerIdentity *peer,
+                  const char *data,
+                  size_t size)
+{
+  struct DatabaseRecord *rec;
+  size_t rsize;
+
+  rsize = sizeof (struct DatabaseRecord) + size;
+  rec = GNUNET_malloc (rsize);
+  rec->magic = htonl (DB_RECORD_MAGIC);
+  rec->size = htonl ((uint32_t) size);
+  rec->crc = htonl ((uint32_t) GNUNET_CRYPTO_crc32_n (data, size));
+  rec->reserved = htonl (0);
+  rec->peer = *peer;
+  if (0 != size)
+    memcpy (&rec[1], data, size);
+  if (rsize != GNUNET_DISK_file_write (db_fh, rec, rsize))
+  {
+    GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_WARNING,
+                              "write",
+                              db_filename);
+    GNUNET_free (rec);
+    return 0;
+  }
+  GNUNET_free (rec);
+  db_size += rsize;
+  if (GNUNET_SCHEDULER_NO_TASK == db_sync_task)
+    db_sync_task = GNUNET_SCHEDULER_add_delayed (DB_SYNC_DELAY,
+                                                 &db_sync, NULL);
+  return (uint32_t) rsize;
+}
+
+
+/**
+ * Write the current record of a host to the (new) HELLO database
+ * during compaction.
+ *
+ * @param cls NULL
+ * @param key identity of the host
+ * @param value the `struct HostEntry`
+ * @return #GNUNET_YES (continue to iterate)
+ */
+static int
+db_compact_host (void *cls,
+                 const struct GNUNET_PeerIdentity *key,
+                 void *value)
+{
+  struct HostEntry *he = value;
+  char *buffer;
+  size_t size;
+
+  he->db_size = 0;
+  buffer = serialize_host (he, &size);
+  if (NULL == buffer)
+    return GNUNET_YES;
+  he->db_size = db_append_record (&he->identity, buffer, size);
+  db_live += he->db_size;
+  GNUNET_free (buffer);
+  return GNUNET_YES;
+}
+
+
+/**
+ * Compact the HELLO database by writing the current records of all
+ * hosts to a new file, which then replaces the database.  On failure,
+ * we keep appending to the old database.
+ *
+ * @return #GNUNET_OK on success, #GNUNET_SYSERR if the database
+ *         could not be replaced
+ */
+static int
+db_compact ()
+{
+  struct GNUNET_DISK_FileHandle *old_fh;
+  uint64_t old_size;
+  char *tmp_fn;
+  off_t fsize;
+
+  GNUNET_log (GNUNET_ERROR_TYPE_INFO | GNUNET_ERROR_TYPE_BULK,
+              _("Compacting HELLO database `%s' (%llu of %llu bytes used)\n"),
+              db_filename,
+              (unsigned long long) db_live,
+              (unsigned long long) db_size);
+  GNUNET_asprintf (&tmp_fn, "%s.tmp", db_filename);
+  old_fh = db_fh;
+  old_size = db_size;
+  db_fh = GNUNET_DISK_file_open (tmp_fn,
+                                 GNUNET_DISK_OPEN_WRITE |
+                                 GNUNET_DISK_OPEN_CREATE |
+                                 GNUNET_DISK_OPEN_TRUNCATE,
+                                 GNUNET_DISK_PERM_USER_READ |
+                                 GNUNET_DISK_PERM_USER_WRITE |
+                                 GNUNET_DISK_PERM_GROUP_READ |
+                                 GNUNET_DISK_PERM_OTHER_READ);
+  if (NULL == db_fh)
+  {
+    GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_WARNING, "open", tmp_fn);
+    db_fh = old_fh;
+    GNUNET_free (tmp_fn);
+    return GNUNET_SYSERR;
+  }
+  db_size = 0;
+  db_live = 0;
+  GNUNET_CONTAINER_multipeermap_iterate (hostmap,
+                                         &db_compact_host,
+                                         NULL);
+  if ( (GNUNET_OK != GNUNET_DISK_file_sync (db_fh)) ||
+       (0 != RENAME (tmp_fn, db_filename)) )
+  {
+    /* keep using the old database; our accounting of what is
+       used in it is off now, but it is only used as a heuristic */
+    GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_WARNING, "rename", tmp_fn);
+    GNUNET_break (GNUNET_OK == GNUNET_DISK_file_close (db_fh));
+    (void) UNLINK (tmp_fn);
+    db_fh = old_fh;
+    db_size = old_size;
+    if (GNUNET_OK == GNUNET_DISK_file_handle_size (db_fh, &fsize))
+      db_size = fsize;
+    GNUNET_free (tmp_fn);
+    return GNUNET_SYSERR;
+  }
+  GNUNET_break (GNUNET_OK == GNUNET_DISK_file_close (old_fh));
+  GNUNET_free (tmp_fn);
+  GNUNET_STATISTICS_update (stats,
+                            gettext_noop ("# HELLO database compactions"),
+                            1, GNUNET_NO);
+  return GNUNET_OK;
+}
+
+
+/**
+ * Store the current HELLOs of a host in the HELLO database.
+ * Compacts the database if it consists mostly of garbage.
+ *
+ * @param host the host
+ * @param buffer HELLOs of the host, as returned by #serialize_host(),
+ *        NULL if the host has no HELLOs with addresses
+ * @param size number of bytes in @a buffer
+ */
+static void
+db_store_host (struct HostEntry *host,
+               const char *buffer,
+               size_t size)
+{
+  uint32_t rsize;
+
+  if ( (NULL == buffer) &&
+       (0 == host->db_size) )
+    return; /* nothing on disk, nothing to remove */
+  rsize = db_append_record (&host->identity, buffer, size);
+  if (0 == rsize)
+    return;
+  db_live -= host->db_size;
+  host->db_size = 0;
+  if (NULL != buffer)
+  {
+    host->db_size = rsize;
+    db_live += rsize;
+  }
+  if ( (db_size >= DB_COMPACT_MIN_SIZE) &&
+       (db_size - db_live > db_live) )
+    (void) db_compact ();
+}
+
+
+/**
+ * Add the host from the current record of a peer in the HELLO
+ * database to our in-memory list.
+ *
+ * @param cls NULL
+ * @param key identity of the peer
+ * @param value the `struct DatabaseRecord` in the mapped database
+ * @return #GNUNET_YES (continue to iterate)
+ */
+static int
+db_load_record (void *cls,
+                const struct GNUNET_PeerIdentity *key,
+                void *value)
+{
+  const struct DatabaseRecord *rec = value;
+  struct ReadHostFileContext r;
+  struct HostEntry *he;
+  struct GNUNET_PeerIdentity pid;
+  uint32_t size;
+  char *buffer;
+
+  size = ntohl (rec->size);
+  if (0 == size)
+    return GNUNET_YES; /* peer was removed */
+  /* copy, as the HELLOs in the mapping might not be aligned */
+  buffer = GNUNET_malloc (size);
+  memcpy (buffer, &rec[1], size);
+  (void) parse_hellos (buffer, size, db_filename, &r);
+  GNUNET_free (buffer);
+  if ( ( (NULL != r.hello) &&
+         ( (GNUNET_OK != GNUNET_HELLO_get_id (r.hello, &pid)) ||
+           (0 != memcmp (&pid, key, sizeof (pid))) ) ) ||
+       ( (NULL != r.friend_only_hello) &&
+         ( (GNUNET_OK != GNUNET_HELLO_get_id (r.friend_only_hello, &pid)) ||
+           (0 != memcmp (&pid, key, sizeof (pid))) ) ) )
+  {
+    GNUNET_break_op (0);
+    GNUNET_free_non_null (r.hello);
+    GNUNET_free_non_null (r.friend_only_hello);
+    return GNUNET_YES;
+  }
+  if ( (NULL == r.hello) &&
+       (NULL == r.friend_only_hello) )
+    return GNUNET_YES; /* all addresses expired */
+  he = add_host_to_known_hosts (key);
+  he->hello = r.hello;
+  he->friend_only_hello = r.friend_only_hello;
+  he->db_size = sizeof (struct DatabaseRecord) + size;
+  db_live += he->db_size;
+  return GNUNET_YES;
+}
+
+
+/**
+ * Load all hosts from the HELLO database and open it for appending.
+ * The database is mapped into memory and indexed by peer, so that
+ * only the current record of each peer needs to be parsed.
+ *
+ * @return #GNUNET_OK on success, #GNUNET_SYSERR if the database
+ *         cannot be read or opened for writing (it is left alone then)
+ */
+static int
+db_load ()
+{
+  struct GNUNET_DISK_FileHandle *fh;
+  struct GNUNET_DISK_MapHandle *mh;
+  struct GNUNET_CONTAINER_MultiPeerMap *latest;
+  const struct DatabaseRecord *rec;
+  const char *data;
+  off_t fsize;
+  size_t off;
+  uint32_t size;
+
+  db_size = 0;
+  db_live = 0;
+  off = 0;
+  fsize = 0;
+  fh = NULL;
+  if (GNUNET_YES == GNUNET_DISK_file_test (db_filename))
+  {
+    fh = GNUNET_DISK_file_open (db_filename,
+                                GNUNET_DISK_OPEN_READ,
+                                GNUNET_DISK_PERM_NONE);
+    if ( (NULL == fh) ||
+         (GNUNET_OK != GNUNET_DISK_file_handle_size (fh, &fsize)) )
+    {
+      GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_ERROR, "open", db_filename);
+      if (NULL != fh)
+        GNUNET_break (GNUNET_OK == GNUNET_DISK_file_close (fh));
+      return GNUNET_SYSERR;
+    }
+  }
+  if (0 < fsize)
+  {
+    data = GNUNET_DISK_file_map (fh, &mh,
+                                 GNUNET_DISK_MAP_TYPE_READ,
+                                 fsize);
+    if (NULL == data)
+    {
+      GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_ERROR, "mmap", db_filename);
+      GNUNET_break (GNUNET_OK == GNUNET_DISK_file_close (fh));
+      return GNUNET_SYSERR;
+    }
+    latest = GNUNET_CONTAINER_multipeermap_create (1 + fsize / 1024,
+                                                   GNUNET_NO);
+    while (fsize - off >= sizeof (struct DatabaseRecord))
+    {
+      rec = (const struct DatabaseRecord *) &data[off];
+      size = ntohl (rec->size);
+      if ( (DB_RECORD_MAGIC != ntohl (rec->magic)) ||
+           (size > fsize - off - sizeof (struct DatabaseRecord)) ||
+           (ntohl (rec->crc) !=
+            (uint32_t) GNUNET_CRYPTO_crc32_n (&rec[1], size)) )
+        break;
+      (void) GNUNET_CONTAINER_multipeermap_put (latest,
+                                                &rec->peer,
+                                                (void *) rec,
+                                                GNUNET_CONTAINER_MULTIHASHMAPOPTION_REPLACE);
+      off += sizeof (struct DatabaseRecord) + size;
+    }
+    GNUNET_CONTAINER_multipeermap_iterate (latest,
+                                           &db_load_record,
+                                           NULL);
+    GNUNET_CONTAINER_multipeermap_destroy (latest);
+    GNUNET_break (GNUNET_OK == GNUNET_DISK_file_unmap (mh));
+  }
+  if (NULL != fh)
+    GNUNET_break (GNUNET_OK == GNUNET_DISK_file_close (fh));
+  GNUNET_log (GNUNET_ERROR_TYPE_INFO,
+              _("Loaded %u peers from HELLO database `%s'\n"),
+              GNUNET_CONTAINER_multipeermap_size (hostmap),
+              db_filename);
+  db_fh = GNUNET_DISK_file_open (db_filename,
+                                 GNUNET_DISK_OPEN_WRITE |
+                                 GNUNET_DISK_OPEN_CREATE |
+                                 GNUNET_DISK_OPEN_APPEND,
+                                 GNUNET_DISK_PERM_USER_READ |
+                                 GNUNET_DISK_PERM_USER_WRITE |
+                                 GNUNET_DISK_PERM_GROUP_READ |
+                                 GNUNET_DISK_PERM_OTHER_READ);
+  if (NULL == db_fh)
+  {
+    GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_ERROR, "open", db_filename);
+    return GNUNET_SYSERR;
+  }
+  db_size = fsize;
+  if (off != fsize)
+  {
+    /* truncated or corrupt record, for example due to a crash
+       while writing; we must not append after it */
+    GNUNET_log (GNUNET_ERROR_TYPE_WARNING,
+                _("HELLO database `%s' is corrupt after %llu bytes, rewriting it\n"),
+                db_filename,
+                (unsigned long long) off);
+    if (GNUNET_OK != db_compact ())
+    {
+      GNUNET_break (GNUNET_OK == GNUNET_DISK_file_close (db_fh));
+      db_fh = NULL;
+      return GNUNET_SYSERR;
+    }
+    return GNUNET_OK;
+  }
+  if ( (db_size >= DB_COMPACT_MIN_SIZE) &&
+       (db_size - db_live > db_live) )
+    (void) db_compact ();
+  return GNUNET_OK;
+}
+
+
 /**
  * Bind a host address (hello) to a hostId.
  *
@@ -725,12 +1271,8 @@ update_hello (const struct GNUNET_PeerIdentity *peer,
   struct GNUNET_HELLO_Message *mrg;
   struct GNUNET_HELLO_Message **dest;
   struct GNUNET_TIME_Absolute delta;
-  unsigned int cnt;
-  unsigned int size;
+  size_t size;
   int friend_hello_type;
-  int store_hello;
-  int store_friend_hello;
-  int pos;
   char *buffer;
 
   host = GNUNET_CONTAINER_multipeermap_get (hostmap, peer);
@@ -792,39 +1334,21 @@ update_hello (const struct GNUNET_PeerIdentity *peer,
     GNUNET_assert ((GNUNET_YES ==
                     GNUNET_HELLO_is_friend_only (host->friend_only_hello)));
 
+  if (NULL != db_fh)
+  {
+    buffer = serialize_host (host, &size);
+    db_store_host (host, buffer, size);
+    GNUNET_free_non_null (buffer);
+    notify_all (host);
+    return;
+  }
   fn = get_host_filename (peer);
   if ( (NULL != fn) &&
        (GNUNET_OK ==
         GNUNET_DISK_directory_create_for_file (fn)) )
   {
-    store_hello = GNUNET_NO;
-    size = 0;
-    cnt = 0;
-    if (NULL != host->hello)
-      (void) GNUNET_HELLO_iterate_addresses (host->hello,
-					     GNUNET_NO,
-                                             &count_addresses,
-                                             &cnt);
-    if (cnt > 0)
-    {
-      store_hello = GNUNET_YES;
-      size += GNUNET_HELLO_size (host->hello);
-    }
-    cnt = 0;
-    if (NULL != host->friend_only_hello)
-      (void) GNUNET_HELLO_iterate_addresses (host->friend_only_hello,
-                                             GNUNET_NO,
-					     &count_addresses,
-                                             &cnt);
-    store_friend_hello = GNUNET_NO;
-    if (0 < cnt)
-    {
-      store_friend_hello = GNUNET_YES;
-      size += GNUNET_HELLO_size (host->friend_only_hello);
-    }
-
-    if ( (GNUNET_NO == store_hello) &&
-         (GNUNET_NO == store_friend_hello) )
+    buffer = serialize_host (host, &size);
+    if (NULL == buffer)
     {
       /* no valid addresses, don't put HELLO on disk; in fact,
 	 if one exists on disk, remove it */
@@ -832,22 +1356,6 @@ update_hello (const struct GNUNET_PeerIdentity *peer,
     }
     else
     {
-      buffer = GNUNET_malloc (size);
-      pos = 0;
-
-      if (GNUNET_YES == store_hello)
-      {
-	memcpy (buffer, host->hello,
-                GNUNET_HELLO_size (host->hello));
-	pos += GNUNET_HELLO_size (host->hello);
-      }
-      if (GNUNET_YES == store_friend_hello)
-      {
-	memcpy (&buffer[pos], host->friend_only_hello, GNUNET_HELLO_size (host->friend_only_hello));
-	pos += GNUNET_HELLO_size (host->friend_only_hello);
-      }
-      GNUNET_assert (pos == size);
-
       if (GNUNET_SYSERR == GNUNET_DISK_fn_write (fn, buffer, size,
 						 GNUNET_DISK_PERM_USER_READ |
 						 GNUNET_DISK_PERM_USER_WRITE |
@@ -856,10 +1364,8 @@ update_hello (const struct GNUNET_PeerIdentity *peer,
 	GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_WARNING, "write", fn);
       else
 	GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
-                    "Stored %s %s HELLO in %s  with total size %u\n",
-		    (GNUNET_YES == store_friend_hello) ? "friend-only": "",
-		    (GNUNET_YES == store_hello) ? "public": "",
-		    fn, size);
+                    "Stored HELLOs in %s with total size %u\n",
+		    fn, (unsigned int) size);
       GNUNET_free (buffer);
     }
   }
@@ -1017,6 +1523,67 @@ discard_hosts_helper (void *cls,
 }
 
 
+/**
+ * Remove expired addresses from the HELLOs of a host and record
+ * the change in the HELLO database.
+ *
+ * @param cls pointer to the current time
+ * @param key identity of the host
+ * @param value the `struct HostEntry`
+ * @return #GNUNET_YES (continue to iterate)
+ */
+static int
+discard_expired_host (void *cls,
+                      const struct GNUNET_PeerIdentity *key,
+                      void *value)
+{
+  const struct GNUNET_TIME_Absolute *now = cls;
+  struct HostEntry *he = value;
+  struct GNUNET_HELLO_Message **hellos[2];
+  struct GNUNET_HELLO_Message *new_hello;
+  unsigned int cnt;
+  unsigned int i;
+  int changed;
+  char *buffer;
+  size_t size;
+
+  hellos[0] = &he->hello;
+  hellos[1] = &he->friend_only_hello;
+  changed = GNUNET_NO;
+  for (i = 0; i < 2; i++)
+  {
+    if (NULL == *hellos[i])
+      continue;
+    new_hello = GNUNET_HELLO_iterate_addresses (*hellos[i],
+                                                GNUNET_YES,
+                                                &discard_expired,
+                                                (void *) now);
+    cnt = 0;
+    if (NULL != new_hello)
+      (void) GNUNET_HELLO_iterate_addresses (new_hello,
+                                             GNUNET_NO,
+                                             &count_addresses, &cnt);
+    if ( (NULL != new_hello) &&
+         (0 == cnt) )
+    {
+      GNUNET_free (new_hello);
+      new_hello = NULL;
+    }
+    if ( (NULL == new_hello) ||
+         (GNUNET_HELLO_size (new_hello) != GNUNET_HELLO_size (*hellos[i])) )
+      changed = GNUNET_YES;
+    GNUNET_free (*hellos[i]);
+    *hellos[i] = new_hello;
+  }
+  if (GNUNET_NO == changed)
+    return GNUNET_YES;
+  buffer = serialize_host (he, &size);
+  db_store_host (he, buffer, size);
+  GNUNET_free_non_null (buffer);
+  return GNUNET_YES;
+}
+
+
 /**
  * Call this method periodically to scan peerinfo/ for ancient
  * HELLOs to expire.
@@ -1033,6 +1600,16 @@ cron_clean_data_hosts (void *cls,
   if (0 != (tc->reason & GNUNET_SCHEDULER_REASON_SHUTDOWN))
     return;
   now = GNUNET_TIME_absolute_get ();
+  if (NULL != db_fh)
+  {
+    GNUNET_CONTAINER_multipeermap_iterate (hostmap,
+                                           &discard_expired_host,
+                                           &now);
+    GNUNET_SCHEDULER_add_delayed (DATA_HOST_CLEAN_FREQ,
+                                  &cron_clean_data_hosts,
+                                  NULL);
+    return;
+  }
   GNUNET_log (GNUNET_ERROR_TYPE_INFO | GNUNET_ERROR_TYPE_BULK,
               _("Cleaning up directory `%s'\n"),
               networkIdDirectory);
@@ -1280,6 +1857,19 @@ shutdown_task (void *cls,
                                          &free_host_entry,
                                          NULL);
   GNUNET_CONTAINER_multipeermap_destroy (hostmap);
+  if (GNUNET_SCHEDULER_NO_TASK != db_sync_task)
+  {
+    GNUNET_SCHEDULER_cancel (db_sync_task);
+    db_sync_task = GNUNET_SCHEDULER_NO_TASK;
+    db_sync (NULL, NULL);
+  }
+  if (NULL != db_fh)
+  {
+    GNUNET_break (GNUNET_OK == GNUNET_DISK_file_close (db_fh));
+    db_fh = NULL;
+  }
+  GNUNET_free_non_null (db_filename);
+  db_filename = NULL;
   if (NULL != stats)
   {
     GNUNET_STATISTICS_destroy (stats, GNUNET_NO);
@@ -1340,6 +1930,24 @@ run (void *cls,
       GNUNET_SCHEDULER_shutdown ();
       return;
     }
+    /* without a database, HELLOs are stored as individual files
+       in the hosts directory; otherwise, the hosts directory is
+       only scanned to import HELLOs into the database */
+    if ( (GNUNET_OK ==
+          GNUNET_CONFIGURATION_get_value_filename (cfg, "peerinfo",
+                                                   "DATABASE",
+                                                   &db_filename)) &&
+         ( (GNUNET_OK !=
+            GNUNET_DISK_directory_create_for_file (db_filename)) ||
+           (GNUNET_OK != db_load ()) ) )
+    {
+      GNUNET_log (GNUNET_ERROR_TYPE_WARNING,
+                  _("Failed to open HELLO database `%s', storing HELLOs in `%s'\n"),
+                  db_filename,
+                  networkIdDirectory);
+      GNUNET_free (db_filename);
+      db_filename = NULL;
+    }
 
     GNUNET_SCHEDULER_add_with_priority (GNUNET_SCHEDULER_PRIORITY_IDLE,
 					&cron_scan_directory_data_hosts, NULL);
@@ -36,14 +36,39 @@
 
 #define NUM_REQUESTS 5000
 
+/**
+ * Number of distinct peers we add to measure startup and lookup
+ * latency of a service that knows many peers.
+ */
+#define NUM_PEERS 100000
+
+/**
+ * Number of lookups of individual peers we time.
+ */
+#define NUM_LOOKUPS 1000
+
 static struct GNUNET_PEERINFO_IteratorContext *ic[NUM_REQUESTS];
 
 static struct GNUNET_PEERINFO_Handle *h;
 
+static const struct GNUNET_CONFIGURATION_Handle *cfg;
+
+static struct GNUNET_TESTING_Peer *tpeer;
+
 static unsigned int numpeers;
 
+static unsigned int num_done;
+
+static unsigned int num_added;
+
+static unsigned int num_lookups;
+
+static struct GNUNET_TIME_Absolute start_time;
+
 static struct GNUNET_PeerIdentity pid;
 
+static int ok = 1;
+
 
 static int
 check_it (void *cls, const struct GNUNET_HELLO_Address *address,
@@ -91,29 +116,293 @@ add_peer (size_t i)
 }
 
 
+/**
+ * Compute the identity of the i-th peer of the scale test.  Like
+ * real peer identities (and unlike those used by #add_peer()),
+ * these are uniformly distributed.
+ *
+ * @param i index of the peer
+ * @param id set to the identity
+ */
+static void
+make_scale_id (uint32_t i,
+               struct GNUNET_PeerIdentity *id)
+{
+  struct GNUNET_HashCode hc;
+
+  GNUNET_CRYPTO_hash (&i, sizeof (i), &hc);
+  memcpy (id, &hc, sizeof (struct GNUNET_PeerIdentity));
+}
+
+
+static void
+do_lookup (void);
+
+
+/**
+ * Full iteration after the restart is done; report and terminate.
+ */
+static void
+restart_iteration_done (void *cls, const struct GNUNET_PeerIdentity *peer,
+                        const struct GNUNET_HELLO_Message *hello,
+                        const char *err_msg)
+{
+  struct GNUNET_TIME_Relative duration;
+
+  if (NULL != peer)
+  {
+    numpeers++;
+    return;
+  }
+  duration = GNUNET_TIME_absolute_get_duration (start_time);
+  FPRINTF (stderr,
+           "Restart until iteration over %u peers completed took %s\n",
+           numpeers,
+           GNUNET_STRINGS_relative_time_to_string (duration, GNUNET_YES));
+  GAUGER ("PEERINFO", "Startup and iteration with many peers",
+          duration.rel_value_us / 1000LL, "ms");
+  if ( (NULL == err_msg) &&
+       (numpeers >= NUM_PEERS) )
+    ok = 0;
+  else
+    FPRINTF (stderr,
+             "Only %u of %u peers known after restart: %s\n",
+             numpeers, NUM_PEERS,
+             (NULL != err_msg) ? err_msg : "");
+  GNUNET_PEERINFO_disconnect (h);
+  h = NULL;
+}
+
+
+/**
+ * The first lookup after the restart is done, then iterate
+ * over all peers the restarted service knows.
+ */
+static void
+restart_lookup_done (void *cls, const struct GNUNET_PeerIdentity *peer,
+                     const struct GNUNET_HELLO_Message *hello,
+                     const char *err_msg)
+{
+  struct GNUNET_TIME_Relative duration;
+
+  if (NULL != peer)
+  {
+    numpeers++;
+    return;
+  }
+  duration = GNUNET_TIME_absolute_get_duration (start_time);
+  FPRINTF (stderr,
+           "Restart until first lookup was answered took %s\n",
+           GNUNET_STRINGS_relative_time_to_string (duration, GNUNET_YES));
+  GAUGER ("PEERINFO", "Startup latency with many peers",
+          duration.rel_value_us / 1000LL, "ms");
+  if (1 != numpeers)
+  {
+    FPRINTF (stderr,
+             "Peer not found after restart: %s\n",
+             (NULL != err_msg) ? err_msg : "");
+    GNUNET_PEERINFO_disconnect (h);
+    h = NULL;
+    return;
+  }
+  numpeers = 0;
+  GNUNET_PEERINFO_iterate (h, GNUNET_YES, NULL,
+                           GNUNET_TIME_UNIT_MINUTES,
+                           &restart_iteration_done, NULL);
+}
+
+
+/**
+ * Restart the service and measure how long it takes until it
+ * answers requests again.
+ */
+static void
+do_restart ()
+{
+  struct GNUNET_PeerIdentity id;
+
+  GNUNET_PEERINFO_disconnect (h);
+  GNUNET_assert (GNUNET_OK == GNUNET_TESTING_peer_stop (tpeer));
+  start_time = GNUNET_TIME_absolute_get ();
+  GNUNET_assert (GNUNET_OK == GNUNET_TESTING_peer_start (tpeer));
+  h = GNUNET_PEERINFO_connect (cfg);
+  GNUNET_assert (NULL != h);
+  numpeers = 0;
+  make_scale_id (NUM_PEERS - 1, &id);
+  GNUNET_PEERINFO_iterate (h, GNUNET_YES, &id,
+                           GNUNET_TIME_UNIT_MINUTES,
+                           &restart_lookup_done, NULL);
+}
+
+
+/**
+ * A lookup of an individual peer is done, start the next one.
+ */
+static void
+lookup_done (void *cls, const struct GNUNET_PeerIdentity *peer,
+             const struct GNUNET_HELLO_Message *hello, const char *err_msg)
+{
+  struct GNUNET_TIME_Relative duration;
+
+  if (NULL != peer)
+  {
+    numpeers++;
+    return;
+  }
+  if (NULL != err_msg)
+  {
+    FPRINTF (stderr, "Lookup failed: %s\n", err_msg);
+    GNUNET_PEERINFO_disconnect (h);
+    h = NULL;
+    return;
+  }
+  if (++num_lookups < NUM_LOOKUPS)
+  {
+    do_lookup ();
+    return;
+  }
+  duration = GNUNET_TIME_absolute_get_duration (start_time);
+  FPRINTF (stderr,
+           "%u lookups among %u peers took %s (%u found)\n",
+           NUM_LOOKUPS, NUM_PEERS,
+           GNUNET_STRINGS_relative_time_to_string (duration, GNUNET_YES),
+           numpeers);
+  GAUGER ("PEERINFO", "Lookup latency with many peers",
+          duration.rel_value_us / NUM_LOOKUPS, "us");
+  if (NUM_LOOKUPS != numpeers)
+  {
+    GNUNET_PEERINFO_disconnect (h);
+    h = NULL;
+    return;
+  }
+  do_restart ();
+}
+
+
+/**
+ * Look up a random peer of the scale test.
+ */
+static void
+do_lookup ()
+{
+  struct GNUNET_PeerIdentity id;
+
+  make_scale_id (GNUNET_CRYPTO_random_u32 (GNUNET_CRYPTO_QUALITY_WEAK,
+                                           NUM_PEERS),
+                 &id);
+  GNUNET_PEERINFO_iterate (h, GNUNET_YES, &id,
+                           GNUNET_TIME_UNIT_MINUTES,
+                           &lookup_done, NULL);
+}
+
+
+/**
+ * All peers of the scale test were added, start timing lookups.
+ */
+static void
+scale_sync_done (void *cls, const struct GNUNET_PeerIdentity *peer,
+                 const struct GNUNET_HELLO_Message *hello,
+                 const char *err_msg)
+{
+  struct GNUNET_TIME_Relative duration;
+
+  if (NULL != peer)
+    return;
+  duration = GNUNET_TIME_absolute_get_duration (start_time);
+  FPRINTF (stderr,
+           "Adding %u peers took %s\n",
+           NUM_PEERS,
+           GNUNET_STRINGS_relative_time_to_string (duration, GNUNET_YES));
+  GAUGER ("PEERINFO", "Adding peers",
+          NUM_PEERS * 1000LL * 1000LL / (1 + duration.rel_value_us),
+          "peers/s");
+  numpeers = 0;
+  start_time = GNUNET_TIME_absolute_get ();
+  do_lookup ();
+}
+
+
+/**
+ * A peer of the scale test was transmitted to the service.
+ */
+static void
+scale_peer_added (void *cls, const char *emsg)
+{
+  struct GNUNET_PeerIdentity id;
+
+  GNUNET_break (NULL == emsg);
+  if (++num_added < NUM_PEERS)
+    return;
+  /* the service processes our requests in order, so once this
+     lookup is answered, all peers have been added */
+  make_scale_id (0, &id);
+  GNUNET_PEERINFO_iterate (h, GNUNET_YES, &id,
+                           GNUNET_TIME_UNIT_MINUTES,
+                           &scale_sync_done, NULL);
+}
+
+
+/**
+ * Add #NUM_PEERS distinct peers.
+ */
+static void
+do_scale ()
+{
+  struct GNUNET_HELLO_Message *h2;
+  uint32_t i;
+  size_t agc;
+
+  start_time = GNUNET_TIME_absolute_get ();
+  for (i = 0; i < NUM_PEERS; i++)
+  {
+    make_scale_id (i, &pid);
+    agc = 1 + i;
+    h2 = GNUNET_HELLO_create (&pid.public_key, &address_generator, &agc,
+                              GNUNET_NO);
+    GNUNET_PEERINFO_add_peer (h, h2, &scale_peer_added, NULL);
+    GNUNET_free (h2);
+  }
+}
+
+
 static void
 process (void *cls, const struct GNUNET_PeerIdentity *peer,
          const struct GNUNET_HELLO_Message *hello, const char *err_msg)
 {
+  struct GNUNET_TIME_Relative duration;
+
   if (NULL != peer)
   {
     numpeers++;
     if (0 && (hello != NULL))
       GNUNET_HELLO_iterate_addresses (hello, GNUNET_NO, &check_it, NULL);
-
+    return;
   }
+  if (++num_done < NUM_REQUESTS)
+    return;
+  duration = GNUNET_TIME_absolute_get_duration (start_time);
+  FPRINTF (stderr, "Received %u/%u calls in %s\n", numpeers,
+	   NUM_REQUESTS * NUM_REQUESTS / 2,
+           GNUNET_STRINGS_relative_time_to_string (duration, GNUNET_YES));
+  GAUGER ("PEERINFO", "Peerinfo lookups",
+          numpeers * 1000LL * 1000LL / (1 + duration.rel_value_us),
+          "peers/s");
+  do_scale ();
 }
 
 
 static void
 run (void *cls,
-     const struct GNUNET_CONFIGURATION_Handle *cfg,
+     const struct GNUNET_CONFIGURATION_Handle *c,
      struct GNUNET_TESTING_Peer *peer)
 {
   size_t i;
 
+  cfg = c;
+  tpeer = peer;
   h = GNUNET_PEERINFO_connect (cfg);
   GNUNET_assert (h != NULL);
+  start_time = GNUNET_TIME_absolute_get ();
   for (i = 0; i < NUM_REQUESTS; i++)
   {
     add_peer (i);
@@ -130,13 +419,10 @@ main (int argc, char *argv[])
 {
   if (0 != GNUNET_TESTING_service_run ("perf-gnunet-peerinfo",
 				       "peerinfo",
-				       "test_peerinfo_api_data.conf",
+				       "perf_peerinfo_api_data.conf",
 				       &run, NULL))
     return 1;
-  FPRINTF (stderr, "Received %u/%u calls before timeout\n", numpeers,
-	   NUM_REQUESTS * NUM_REQUESTS / 2);
-  GAUGER ("PEERINFO", "Peerinfo lookups", numpeers / 30, "peers/s");
-  return 0;
+  return ok;
 }
 
 /* end of perf_peerinfo_api.c */
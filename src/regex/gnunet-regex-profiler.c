@@ -288,6 +288,16 @@ static unsigned int parallel_searches;
  */
 static unsigned int strings_found;
 
+/**
+ * Durations of the successful searches.
+ */
+static struct GNUNET_TIME_Relative *search_latencies;
+
+/**
+ * Number of entries in #search_latencies.
+ */
+static unsigned int num_search_latencies;
+
 /**
  * Index of peer to start next announce/search.
  */
@@ -452,6 +462,7 @@ do_shutdown (void *cls, const struct GNUNET_SCHEDULER_TaskContext *tc)
     GNUNET_free_non_null (search_strings[search_str_cnt]);
   }
   GNUNET_free_non_null (search_strings);
+  GNUNET_array_grow (search_latencies, num_search_latencies, 0);
 
   if (NULL != reg_handle)
     GNUNET_TESTBED_cancel_registration (reg_handle);
@@ -700,6 +711,63 @@ static void
 find_string (void *cls, const struct GNUNET_SCHEDULER_TaskContext *tc);
 
 
+/**
+ * Order search durations, shortest first.
+ *
+ * @param a first `struct GNUNET_TIME_Relative`
+ * @param b second `struct GNUNET_TIME_Relative`
+ * @return -1, 0 or 1 as for qsort
+ */
+static int
+latency_compare (const void *a, const void *b)
+{
+  const struct GNUNET_TIME_Relative *la = a;
+  const struct GNUNET_TIME_Relative *lb = b;
+
+  if (la->rel_value_us < lb->rel_value_us)
+    return -1;
+  if (la->rel_value_us > lb->rel_value_us)
+    return 1;
+  return 0;
+}
+
+
+/**
+ * Print the distribution of the durations of the successful searches,
+ * and write it to the data file, if any.
+ */
+static void
+report_search_latencies ()
+{
+  static const unsigned int percentiles[] = { 0, 50, 90, 99, 100 };
+  char output_buffer[512];
+  size_t size;
+  unsigned int i;
+  unsigned int idx;
+
+  if (0 == num_search_latencies)
+    return;
+  qsort (search_latencies, num_search_latencies,
+         sizeof (struct GNUNET_TIME_Relative), &latency_compare);
+  for (i = 0; i < sizeof (percentiles) / sizeof (percentiles[0]); i++)
+  {
+    idx = (num_search_latencies - 1) * percentiles[i] / 100;
+    size =
+      GNUNET_snprintf (output_buffer,
+                       sizeof (output_buffer),
+                       "Search latency %3u%%: %s (%u searches)\n",
+                       percentiles[i],
+                       GNUNET_STRINGS_relative_time_to_string (search_latencies[idx],
+                                                               GNUNET_NO),
+                       num_search_latencies);
+    GNUNET_log (GNUNET_ERROR_TYPE_INFO, "%s", output_buffer);
+    if ( (NULL != data_file) &&
+         (size != GNUNET_DISK_file_write (data_file, output_buffer, size)) )
+      GNUNET_log (GNUNET_ERROR_TYPE_WARNING, "Unable to write to file!\n");
+  }
+}
+
+
 /**
  * Method called when we've found a peer that announced a regex
  * that matches our search string. Now get the statistics.
@@ -761,6 +829,7 @@ regex_found_handler (void *cls,
                 strings_found, num_peers, parallel_searches);
 
     peer->search_str_matched = GNUNET_YES;
+    GNUNET_array_append (search_latencies, num_search_latencies, prof_time);
 
     if (NULL != data_file)
     {
@@ -790,6 +859,7 @@ regex_found_handler (void *cls,
     GNUNET_log (GNUNET_ERROR_TYPE_INFO,
                 "All strings successfully matched in %s\n",
                 GNUNET_STRINGS_relative_time_to_string (prof_time, GNUNET_NO));
+    report_search_latencies ();
 
     if (GNUNET_SCHEDULER_NO_TASK != search_timeout_task)
     {
@@ -821,6 +891,7 @@ search_timed_out (void *cls, const struct GNUNET_SCHEDULER_TaskContext * tc)
                                                       GNUNET_NO));
   GNUNET_log (GNUNET_ERROR_TYPE_INFO,
               "Found %i of %i strings\n", strings_found, num_peers);
+  report_search_latencies ();
 
   GNUNET_log (GNUNET_ERROR_TYPE_INFO,
               "Search timed out after %s."
@@ -1049,7 +1120,7 @@ dht_connect_cb (void *cls, struct GNUNET_TESTBED_Operation *op,
   peer->search_handle = REGEX_INTERNAL_search (peer->dht_handle,
                                              peer->search_str,
                                              &regex_found_handler, peer,
-                                             NULL);
+                                             NULL, NULL);
   peer->prof_start_time = GNUNET_TIME_absolute_get ();
 }
 
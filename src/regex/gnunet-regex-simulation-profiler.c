@@ -29,6 +29,7 @@
 #include "platform.h"
 #include "gnunet_util_lib.h"
 #include "regex_internal_lib.h"
+#include "regex_internal.h"
 #include "gnunet_mysql_lib.h"
 #include <mysql/mysql.h>
 
@@ -158,6 +159,16 @@ static unsigned long long num_merged_transitions;
  */
 static unsigned long long num_merged_states;
 
+/**
+ * Total time spent constructing DFAs.
+ */
+static struct GNUNET_TIME_Relative dfa_construction_time;
+
+/**
+ * Largest DFA constructed (number of states).
+ */
+static unsigned int max_dfa_states;
+
 /**
  * Prefix to add before every regex we're announcing.
  */
@@ -461,9 +472,14 @@ static int
 announce_regex (const char *regex)
 {
   struct REGEX_INTERNAL_Automaton *dfa;
+  struct GNUNET_TIME_Absolute start_time;
 
+  start_time = GNUNET_TIME_absolute_get ();
   dfa =
       REGEX_INTERNAL_construct_dfa (regex, strlen (regex), max_path_compression);
+  dfa_construction_time =
+      GNUNET_TIME_relative_add (dfa_construction_time,
+                                GNUNET_TIME_absolute_get_duration (start_time));
 
   if (NULL == dfa)
   {
@@ -472,6 +488,8 @@ announce_regex (const char *regex)
     abort_task = GNUNET_SCHEDULER_add_now (&do_abort, NULL);
     return GNUNET_SYSERR;
   }
+  if (dfa->state_count > max_dfa_states)
+    max_dfa_states = dfa->state_count;
 
   REGEX_INTERNAL_iterate_all_edges (dfa, &regex_iterator, NULL);
 
@@ -571,6 +589,7 @@ do_directory_scan (void *cls, const struct GNUNET_SCHEDULER_TaskContext *tc)
 {
   struct GNUNET_TIME_Absolute start_time;
   struct GNUNET_TIME_Relative duration;
+  unsigned long long peak_rss;
   char *stmt;
 
   /* Create an MySQL prepared statement for the inserts */
@@ -598,6 +617,19 @@ do_directory_scan (void *cls, const struct GNUNET_SCHEDULER_TaskContext *tc)
           num_policy_files, num_policies,
           GNUNET_STRINGS_relative_time_to_string (duration, GNUNET_NO),
           num_merged_transitions, num_merged_states);
+  peak_rss = 0;
+#if HAVE_GETRUSAGE
+  {
+    struct rusage ru;
+
+    if (0 == getrusage (RUSAGE_SELF, &ru))
+      peak_rss = ru.ru_maxrss;
+  }
+#endif
+  printf ("DFA construction: %s\nLargest DFA: %u states\nPeak RSS: %llu KiB\n",
+          GNUNET_STRINGS_relative_time_to_string (dfa_construction_time,
+                                                  GNUNET_NO),
+          max_dfa_states, peak_rss);
 
   result = GNUNET_OK;
   shutdown_task = GNUNET_SCHEDULER_add_now (&do_shutdown, NULL);
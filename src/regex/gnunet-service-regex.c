@@ -29,6 +29,11 @@
 #include "regex_internal_lib.h"
 #include "regex_ipc.h"
 
+/**
+ * How many regex blocks do we cache for searches?
+ */
+#define BLOCK_CACHE_SIZE 4096
+
 
 /**
  * Information about one of our clients.
@@ -84,6 +89,11 @@ static struct GNUNET_DHT_Handle *dht;
  */
 static struct GNUNET_STATISTICS_Handle *stats;
 
+/**
+ * Regex blocks found by the searches of all clients.
+ */
+static struct REGEX_INTERNAL_BlockCache *block_cache;
+
 /**
  * Head of list of clients.
  */
@@ -116,6 +126,8 @@ cleanup_task (void *cls, const struct GNUNET_SCHEDULER_TaskContext *tc)
 {
   GNUNET_DHT_disconnect (dht);
   dht = NULL;
+  REGEX_INTERNAL_block_cache_destroy (block_cache);
+  block_cache = NULL;
   GNUNET_STATISTICS_destroy (stats, GNUNET_NO);
   stats = NULL;
   GNUNET_SERVER_notification_context_destroy (nc);
@@ -329,7 +341,8 @@ handle_search (void *cls,
 				string,
 				&handle_search_result,
 				ce,
-				stats);
+				stats,
+				block_cache);
   if (NULL == ce->sh)
   {
     GNUNET_break (0);
@@ -376,6 +389,7 @@ run (void *cls, struct GNUNET_SERVER_Handle *server,
     GNUNET_SCHEDULER_shutdown ();
     return;
   }
+  block_cache = REGEX_INTERNAL_block_cache_create (BLOCK_CACHE_SIZE);
   GNUNET_SCHEDULER_add_delayed (GNUNET_TIME_UNIT_FOREVER_REL, &cleanup_task,
                                 NULL);
   nc = GNUNET_SERVER_notification_context_create (server, 1);
@@ -27,8 +27,24 @@
 #include <time.h>
 #include "platform.h"
 #include "regex_internal_lib.h"
+#include "regex_internal.h"
 #include "regex_test_lib.h"
 
+/**
+ * Prefix of the regex built from the policies, and of the strings we match.
+ */
+#define EVAL_PREFIX "GNUNET_REGEX_PROFILER_"
+
+/**
+ * Number of random bits after the prefix in the strings we match.
+ */
+#define EVAL_BITS 64
+
+/**
+ * Number of strings we match.
+ */
+#define EVAL_STRINGS 100000
+
 
 /**
  * Print information about the given node and its edges
@@ -62,6 +78,104 @@ print_edge (void *cls,
 }
 
 
+/**
+ * Get the peak resident set size of this process.
+ *
+ * @return peak RSS in kilobytes, 0 if unknown
+ */
+static unsigned long long
+get_peak_rss ()
+{
+#if HAVE_GETRUSAGE
+  struct rusage ru;
+
+  if (0 == getrusage (RUSAGE_SELF, &ru))
+    return ru.ru_maxrss;
+#endif
+  return 0;
+}
+
+
+/**
+ * Match random strings against 'dfa', using REGEX_INTERNAL_eval and the
+ * compiled form of 'dfa', and print how long both take.
+ *
+ * @param dfa automaton to match against
+ * @return 0 if both matchers agree on all strings, 1 otherwise
+ */
+static int
+compare_eval (struct REGEX_INTERNAL_Automaton *dfa)
+{
+  struct REGEX_INTERNAL_CompiledDfa *c;
+  struct GNUNET_TIME_Absolute start;
+  struct GNUNET_TIME_Relative duration;
+  char **strings;
+  int *results;
+  unsigned int matches;
+  unsigned int i;
+  unsigned int j;
+  int ret;
+
+  strings = GNUNET_malloc (EVAL_STRINGS * sizeof (char *));
+  results = GNUNET_malloc (EVAL_STRINGS * sizeof (int));
+  for (i = 0; i < EVAL_STRINGS; i++)
+  {
+    strings[i] = GNUNET_malloc (sizeof (EVAL_PREFIX) + EVAL_BITS);
+    memcpy (strings[i], EVAL_PREFIX, sizeof (EVAL_PREFIX) - 1);
+    for (j = 0; j < EVAL_BITS; j++)
+      strings[i][sizeof (EVAL_PREFIX) - 1 + j] =
+          '0' + GNUNET_CRYPTO_random_u32 (GNUNET_CRYPTO_QUALITY_WEAK, 2);
+  }
+  matches = 0;
+  start = GNUNET_TIME_absolute_get ();
+  for (i = 0; i < EVAL_STRINGS; i++)
+  {
+    results[i] = REGEX_INTERNAL_eval (dfa, strings[i]);
+    if (0 == results[i])
+      matches++;
+  }
+  duration = GNUNET_TIME_absolute_get_duration (start);
+  fprintf (stderr,
+	   "REGEX_INTERNAL_eval: %u strings (%u matching) in %s\n",
+	   EVAL_STRINGS, matches,
+	   GNUNET_STRINGS_relative_time_to_string (duration, GNUNET_NO));
+  ret = 0;
+  start = GNUNET_TIME_absolute_get ();
+  c = REGEX_INTERNAL_dfa_compile (dfa);
+  duration = GNUNET_TIME_absolute_get_duration (start);
+  if (NULL == c)
+  {
+    fprintf (stderr,
+	     "Failed to compile DFA\n");
+    ret = 1;
+  }
+  else
+  {
+    fprintf (stderr,
+	     "REGEX_INTERNAL_dfa_compile: %s\n",
+	     GNUNET_STRINGS_relative_time_to_string (duration, GNUNET_NO));
+    start = GNUNET_TIME_absolute_get ();
+    for (i = 0; i < EVAL_STRINGS; i++)
+      if (results[i] != REGEX_INTERNAL_compiled_eval (c, strings[i]))
+        ret = 1;
+    duration = GNUNET_TIME_absolute_get_duration (start);
+    fprintf (stderr,
+	     "REGEX_INTERNAL_compiled_eval: %u strings in %s\n",
+	     EVAL_STRINGS,
+	     GNUNET_STRINGS_relative_time_to_string (duration, GNUNET_NO));
+    REGEX_INTERNAL_compiled_dfa_destroy (c);
+  }
+  if (0 != ret)
+    fprintf (stderr,
+	     "Compiled DFA gave different results!\n");
+  for (i = 0; i < EVAL_STRINGS; i++)
+    GNUNET_free (strings[i]);
+  GNUNET_free (strings);
+  GNUNET_free (results);
+  return ret;
+}
+
+
 /**
  * The main function of the regex performace test.
  *
@@ -81,6 +195,9 @@ main (int argc, char *const *argv)
   char *regex;
   int compression;
   long size;
+  struct GNUNET_TIME_Absolute start;
+  struct GNUNET_TIME_Relative duration;
+  int ret;
 
   GNUNET_log_setup ("perf-regex", "DEBUG", NULL);
   if (3 != argc)
@@ -101,14 +218,32 @@ main (int argc, char *const *argv)
   compression = atoi (argv[2]);
 
   buffer = REGEX_TEST_combine (regexes);
-  GNUNET_asprintf (&regex, "GNUNET_REGEX_PROFILER_(%s)(0|1)*", buffer);
+  GNUNET_asprintf (&regex, EVAL_PREFIX "(%s)(0|1)*", buffer);
   size = strlen (regex);
 
   fprintf (stderr,
 	   "Combined regex (%ld bytes):\n%s\n",
 	   size,
 	   regex);
+  start = GNUNET_TIME_absolute_get ();
   dfa = REGEX_INTERNAL_construct_dfa (regex, size, compression);
+  duration = GNUNET_TIME_absolute_get_duration (start);
+  if (NULL == dfa)
+  {
+    fprintf (stderr,
+	     "Failed to construct DFA\n");
+    GNUNET_free (buffer);
+    REGEX_TEST_free_from_file (regexes);
+    GNUNET_free (regex);
+    return 3;
+  }
+  fprintf (stderr,
+	   "Constructed DFA with %u states and %u transitions in %s, peak RSS %llu KiB\n",
+	   dfa->state_count,
+	   REGEX_INTERNAL_get_transition_count (dfa),
+	   GNUNET_STRINGS_relative_time_to_string (duration, GNUNET_NO),
+	   get_peak_rss ());
+  ret = compare_eval (dfa);
   printf ("********* ALL EDGES *********'\n");
   REGEX_INTERNAL_iterate_all_edges (dfa, &print_edge, NULL);
   printf ("\n\n********* REACHABLE EDGES *********'\n");
@@ -117,7 +252,7 @@ main (int argc, char *const *argv)
   GNUNET_free (buffer);
   REGEX_TEST_free_from_file (regexes);
   GNUNET_free (regex);
-  return 0;
+  return ret;
 }
 
 /* end of prof-regex.c */
@@ -28,6 +28,9 @@
 #include "gnunet_regex_service.h"
 #include "regex_internal_lib.h"
 #include "regex_internal.h"
+#if HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
 
 
 /**
@@ -36,6 +39,17 @@
  */
 #define REGEX_DEBUG_DFA GNUNET_NO
 
+/**
+ * Upper bound on the number of threads used for creating proofs.
+ */
+#define MAX_PROOF_THREADS 16
+
+/**
+ * Minimum number of states (rows of the proof matrix) each thread
+ * should work on; smaller automata are handled by a single thread.
+ */
+#define MIN_PROOF_ROWS_PER_THREAD 64
+
 /**
  * Set of states using MDLL API.
  */
@@ -320,112 +334,45 @@ automaton_destroy_state (struct REGEX_INTERNAL_State *s)
 
 
 /**
- * Remove a state from the given automaton 'a'. Always use this function when
- * altering the states of an automaton. Will also remove all transitions leading
- * to this state, before destroying it.
+ * Remove all states that have their 'contained' flag set from the given
+ * automaton 'a', including all transitions leading to them. Always use this
+ * function when removing states from an automaton, it runs in O(n+m) no matter
+ * how many states are removed.
  *
  * @param a automaton
- * @param s state to remove
  */
 static void
-automaton_remove_state (struct REGEX_INTERNAL_Automaton *a,
-                        struct REGEX_INTERNAL_State *s)
+automaton_remove_contained_states (struct REGEX_INTERNAL_Automaton *a)
 {
-  struct REGEX_INTERNAL_State *s_check;
-  struct REGEX_INTERNAL_Transition *t_check;
-  struct REGEX_INTERNAL_Transition *t_check_next;
-
-  if (NULL == a || NULL == s)
-    return;
-
-  /* remove all transitions leading to this state */
-  for (s_check = a->states_head; NULL != s_check; s_check = s_check->next)
-  {
-    for (t_check = s_check->transitions_head; NULL != t_check;
-         t_check = t_check_next)
-    {
-      t_check_next = t_check->next;
-      if (t_check->to_state == s)
-        state_remove_transition (s_check, t_check);
-    }
-  }
-
-  /* remove state */
-  GNUNET_CONTAINER_DLL_remove (a->states_head, a->states_tail, s);
-  a->state_count--;
-
-  automaton_destroy_state (s);
-}
-
-
-/**
- * Merge two states into one. Will merge 's1' and 's2' into 's1' and destroy
- * 's2'. 's1' will contain all (non-duplicate) outgoing transitions of 's2'.
- *
- * @param ctx context
- * @param a automaton
- * @param s1 first state
- * @param s2 second state, will be destroyed
- */
-static void
-automaton_merge_states (struct REGEX_INTERNAL_Context *ctx,
-                        struct REGEX_INTERNAL_Automaton *a,
-                        struct REGEX_INTERNAL_State *s1,
-                        struct REGEX_INTERNAL_State *s2)
-{
-  struct REGEX_INTERNAL_State *s_check;
-  struct REGEX_INTERNAL_Transition *t_check;
+  struct REGEX_INTERNAL_State *s;
+  struct REGEX_INTERNAL_State *s_next;
   struct REGEX_INTERNAL_Transition *t;
   struct REGEX_INTERNAL_Transition *t_next;
-  int is_dup;
 
-  if (s1 == s2)
-    return;
-
-  /* 1. Make all transitions pointing to s2 point to s1, unless this transition
-   * does not already exists, if it already exists remove transition. */
-  for (s_check = a->states_head; NULL != s_check; s_check = s_check->next)
+  /* remove all transitions leading to the states to be removed */
+  for (s = a->states_head; NULL != s; s = s->next)
   {
-    for (t_check = s_check->transitions_head; NULL != t_check; t_check = t_next)
+    if (GNUNET_YES == s->contained)
+      continue;
+    for (t = s->transitions_head; NULL != t; t = t_next)
     {
-      t_next = t_check->next;
-
-      if (s2 == t_check->to_state)
-      {
-        is_dup = GNUNET_NO;
-        for (t = t_check->from_state->transitions_head; NULL != t; t = t->next)
-        {
-          if (t->to_state == s1 && 0 == strcmp (t_check->label, t->label))
-            is_dup = GNUNET_YES;
-        }
-        if (GNUNET_NO == is_dup)
-          t_check->to_state = s1;
-        else
-          state_remove_transition (t_check->from_state, t_check);
-      }
+      t_next = t->next;
+      if ( (NULL != t->to_state) &&
+           (GNUNET_YES == t->to_state->contained) )
+        state_remove_transition (s, t);
     }
   }
 
-  /* 2. Add all transitions from s2 to sX to s1 */
-  for (t_check = s2->transitions_head; NULL != t_check; t_check = t_check->next)
+  /* remove states */
+  for (s = a->states_head; NULL != s; s = s_next)
   {
-    if (t_check->to_state != s1)
-      state_add_transition (ctx, s1, t_check->label, t_check->to_state);
+    s_next = s->next;
+    if (GNUNET_YES != s->contained)
+      continue;
+    GNUNET_CONTAINER_DLL_remove (a->states_head, a->states_tail, s);
+    a->state_count--;
+    automaton_destroy_state (s);
   }
-
-  /* 3. Rename s1 to {s1,s2} */
-#if REGEX_DEBUG_DFA
-  char *new_name;
-
-  new_name = s1->name;
-  GNUNET_asprintf (&s1->name, "{%s,%s}", new_name, s2->name);
-  GNUNET_free (new_name);
-#endif
-
-  /* remove state */
-  GNUNET_CONTAINER_DLL_remove (a->states_head, a->states_tail, s2);
-  a->state_count--;
-  automaton_destroy_state (s2);
 }
 
 
@@ -1592,6 +1539,265 @@ automaton_create_proofs_simplify (const struct StringBuffer *R_last_ij,
 }
 
 
+/**
+ * Barrier for the threads computing the proofs of an automaton.
+ */
+struct ProofBarrier
+{
+#if HAVE_PTHREAD_H
+  /**
+   * Lock for the barrier.
+   */
+  pthread_mutex_t lock;
+
+  /**
+   * Signalled when all threads reached the barrier.
+   */
+  pthread_cond_t cond;
+#endif
+
+  /**
+   * Number of threads using the barrier.
+   */
+  unsigned int threads;
+
+  /**
+   * Number of threads waiting at the barrier.
+   */
+  unsigned int waiting;
+
+  /**
+   * Incremented each time all threads reached the barrier.
+   */
+  unsigned int generation;
+};
+
+
+/**
+ * State of one thread computing the proofs of an automaton.  Each thread
+ * computes the rows 'row_start' to 'row_end' (exclusive) of R^{(k)} for all
+ * k, synchronizing with the other threads after each k.
+ */
+struct ProofWorker
+{
+#if HAVE_PTHREAD_H
+  /**
+   * Handle of the thread, unused for the first worker (which runs in the
+   * calling thread).
+   */
+  pthread_t tid;
+#endif
+
+  /**
+   * Barrier shared by all workers.
+   */
+  struct ProofBarrier *barrier;
+
+  /**
+   * R^{(k-1)}, swapped with 'R_cur' after each k.
+   */
+  struct StringBuffer *R_last;
+
+  /**
+   * R^{(k)}, swapped with 'R_last' after each k.
+   */
+  struct StringBuffer *R_cur;
+
+  /**
+   * Number of states.
+   */
+  unsigned int n;
+
+  /**
+   * First row computed by this worker.
+   */
+  unsigned int row_start;
+
+  /**
+   * Row after the last row computed by this worker.
+   */
+  unsigned int row_end;
+};
+
+
+/**
+ * Wait until all threads using the barrier 'b' reached it.
+ *
+ * @param b barrier
+ */
+static void
+proof_barrier_wait (struct ProofBarrier *b)
+{
+#if HAVE_PTHREAD_H
+  unsigned int generation;
+
+  if (1 == b->threads)
+    return;
+  GNUNET_assert (0 == pthread_mutex_lock (&b->lock));
+  generation = b->generation;
+  if (++b->waiting == b->threads)
+  {
+    b->waiting = 0;
+    b->generation++;
+    GNUNET_assert (0 == pthread_cond_broadcast (&b->cond));
+  }
+  else
+  {
+    while (generation == b->generation)
+      GNUNET_assert (0 == pthread_cond_wait (&b->cond, &b->lock));
+  }
+  GNUNET_assert (0 == pthread_mutex_unlock (&b->lock));
+#endif
+}
+
+
+/**
+ * Compute rows 'row_start' to 'row_end' of R^{(k)} for k = 0..n-1.  All
+ * workers swap their 'R_last' and 'R_cur' in lockstep, so after the last
+ * iteration 'R_last' of each worker is R^{(n-1)}.
+ *
+ * @param cls the 'struct ProofWorker'
+ * @return NULL
+ */
+static void *
+proof_worker (void *cls)
+{
+  struct ProofWorker *w = cls;
+  unsigned int n;
+  struct StringBuffer R_cur_r;
+  struct StringBuffer R_cur_l;
+  struct StringBuffer *R_swap;
+  unsigned int i;
+  unsigned int j;
+  unsigned int k;
+
+#if HAVE_PTHREAD_H
+  /* wait until our rows were assigned */
+  GNUNET_assert (0 == pthread_mutex_lock (&w->barrier->lock));
+  GNUNET_assert (0 == pthread_mutex_unlock (&w->barrier->lock));
+#endif
+  n = w->n;
+  memset (&R_cur_l, 0, sizeof (struct StringBuffer));
+  memset (&R_cur_r, 0, sizeof (struct StringBuffer));
+  for (k = 0; k < n; k++)
+  {
+    for (i = w->row_start; i < w->row_end; i++)
+    {
+      for (j = 0; j < n; j++)
+      {
+        /* Basis for the recursion:
+         * $R^{(k)}_{ij} = R^{(k-1)}_{ij} | R^{(k-1)}_{ik} ( R^{(k-1)}_{kk} )^* R^{(k-1)}_{kj}
+         * R_last == R^{(k-1)}, R_cur == R^{(k)}
+         */
+
+        /* Create R_cur[i][j] and simplify the expression */
+        automaton_create_proofs_simplify (&w->R_last[i * n + j],
+                                          &w->R_last[i * n + k],
+                                          &w->R_last[k * n + k],
+                                          &w->R_last[k * n + j],
+                                          &w->R_cur[i * n + j],
+                                          &R_cur_l, &R_cur_r);
+      }
+    }
+    /* all rows of R_cur must be complete before anyone uses them */
+    proof_barrier_wait (w->barrier);
+    /* set R_last = R_cur */
+    R_swap = w->R_last;
+    w->R_last = w->R_cur;
+    w->R_cur = R_swap;
+    /* clear our rows of 'R_cur' for next iteration; nobody else reads
+     * them any more, as the other workers only read 'R_last' now */
+    for (i = w->row_start; i < w->row_end; i++)
+      for (j = 0; j < n; j++)
+        w->R_cur[i * n + j].null_flag = GNUNET_YES;
+  }
+  sb_free (&R_cur_l);
+  sb_free (&R_cur_r);
+  return NULL;
+}
+
+
+/**
+ * Compute R^{(n-1)} from R^{(-1)} given in 'R_last', using several threads
+ * for large automata.
+ *
+ * @param n number of states
+ * @param R_last R^{(-1)}, set to R^{(n-1)} on return
+ * @param R_cur scratch space, set to the other array on return
+ */
+static void
+automaton_create_proofs_run (unsigned int n,
+                             struct StringBuffer **R_last,
+                             struct StringBuffer **R_cur)
+{
+  struct ProofBarrier barrier;
+  unsigned int threads;
+  unsigned int i;
+
+  threads = 1;
+#if HAVE_PTHREAD_H && HAVE_SYSCONF && defined(_SC_NPROCESSORS_ONLN)
+  {
+    long cpus;
+
+    cpus = sysconf (_SC_NPROCESSORS_ONLN);
+    if (cpus > 1)
+      threads = cpus;
+  }
+  if (threads > MAX_PROOF_THREADS)
+    threads = MAX_PROOF_THREADS;
+  if (threads > n / MIN_PROOF_ROWS_PER_THREAD)
+    threads = n / MIN_PROOF_ROWS_PER_THREAD;
+  if (0 == threads)
+    threads = 1;
+#endif
+  {
+    struct ProofWorker workers[threads];
+
+    memset (&barrier, 0, sizeof (barrier));
+    barrier.threads = 1;
+#if HAVE_PTHREAD_H
+    GNUNET_assert (0 == pthread_mutex_init (&barrier.lock, NULL));
+    GNUNET_assert (0 == pthread_cond_init (&barrier.cond, NULL));
+    GNUNET_assert (0 == pthread_mutex_lock (&barrier.lock));
+    for (i = 1; i < threads; i++)
+    {
+      workers[i].barrier = &barrier;
+      if (0 != pthread_create (&workers[i].tid, NULL, &proof_worker, &workers[i]))
+      {
+        GNUNET_log_strerror (GNUNET_ERROR_TYPE_WARNING, "pthread_create");
+        break;
+      }
+      barrier.threads++;
+    }
+#endif
+    /* split the rows among the workers that are actually running */
+    for (i = 0; i < barrier.threads; i++)
+    {
+      workers[i].barrier = &barrier;
+      workers[i].R_last = *R_last;
+      workers[i].R_cur = *R_cur;
+      workers[i].n = n;
+      workers[i].row_start =
+          (unsigned int) ((unsigned long long) n * i / barrier.threads);
+      workers[i].row_end =
+          (unsigned int) ((unsigned long long) n * (i + 1) / barrier.threads);
+    }
+#if HAVE_PTHREAD_H
+    GNUNET_assert (0 == pthread_mutex_unlock (&barrier.lock));
+#endif
+    (void) proof_worker (&workers[0]);
+#if HAVE_PTHREAD_H
+    for (i = 1; i < barrier.threads; i++)
+      GNUNET_assert (0 == pthread_join (workers[i].tid, NULL));
+    GNUNET_assert (0 == pthread_cond_destroy (&barrier.cond));
+    GNUNET_assert (0 == pthread_mutex_destroy (&barrier.lock));
+#endif
+    *R_last = workers[0].R_last;
+    *R_cur = workers[0].R_cur;
+  }
+}
+
+
 /**
  * Create proofs for all states in the given automaton. Implementation of the
  * algorithm descriped in chapter 3.2.1 of "Automata Theory, Languages, and
@@ -1610,14 +1816,10 @@ automaton_create_proofs (struct REGEX_INTERNAL_Automaton *a)
   struct REGEX_INTERNAL_State *states[n];
   struct StringBuffer *R_last;
   struct StringBuffer *R_cur;
-  struct StringBuffer R_cur_r;
-  struct StringBuffer R_cur_l;
-  struct StringBuffer *R_swap;
   struct REGEX_INTERNAL_Transition *t;
   struct StringBuffer complete_regex;
   unsigned int i;
   unsigned int j;
-  unsigned int k;
 
   R_last = GNUNET_malloc_large (sizeof (struct StringBuffer) * n * n);
   R_cur = GNUNET_malloc_large (sizeof (struct StringBuffer) * n * n);
@@ -1673,37 +1875,7 @@ automaton_create_proofs (struct REGEX_INTERNAL_Automaton *a)
         sb_wrap (&R_last[i * n + j], "(%.*s)", 2);
   /* Compute regular expressions of length "k" between each pair of states per
    * induction */
-  memset (&R_cur_l, 0, sizeof (struct StringBuffer));
-  memset (&R_cur_r, 0, sizeof (struct StringBuffer));
-  for (k = 0; k < n; k++)
-  {
-    for (i = 0; i < n; i++)
-    {
-      for (j = 0; j < n; j++)
-      {
-        /* Basis for the recursion:
-         * $R^{(k)}_{ij} = R^{(k-1)}_{ij} | R^{(k-1)}_{ik} ( R^{(k-1)}_{kk} )^* R^{(k-1)}_{kj}
-         * R_last == R^{(k-1)}, R_cur == R^{(k)}
-         */
-
-        /* Create R_cur[i][j] and simplify the expression */
-        automaton_create_proofs_simplify (&R_last[i * n + j], &R_last[i * n + k],
-                                          &R_last[k * n + k], &R_last[k * n + j],
-                                          &R_cur[i * n + j],
-					  &R_cur_l, &R_cur_r);
-      }
-    }
-    /* set R_last = R_cur */
-    R_swap = R_last;
-    R_last = R_cur;
-    R_cur = R_swap;
-    /* clear 'R_cur' for next iteration */
-    for (i = 0; i < n; i++)
-      for (j = 0; j < n; j++)
-        R_cur[i * n + j].null_flag = GNUNET_YES;
-  }
-  sb_free (&R_cur_l);
-  sb_free (&R_cur_r);
+  automaton_create_proofs_run (n, &R_last, &R_cur);
   /* assign proofs and hashes */
   for (i = 0; i < n; i++)
   {
@@ -1892,7 +2064,6 @@ static void
 dfa_remove_unreachable_states (struct REGEX_INTERNAL_Automaton *a)
 {
   struct REGEX_INTERNAL_State *s;
-  struct REGEX_INTERNAL_State *s_next;
 
   /* 1. unmark all states */
   for (s = a->states_head; NULL != s; s = s->next)
@@ -1902,18 +2073,17 @@ dfa_remove_unreachable_states (struct REGEX_INTERNAL_Automaton *a)
   REGEX_INTERNAL_automaton_traverse (a, a->start, NULL, NULL, &mark_states, NULL);
 
   /* 3. delete all states that were not visited */
-  for (s = a->states_head; NULL != s; s = s_next)
-  {
-    s_next = s->next;
-    if (GNUNET_NO == s->marked)
-      automaton_remove_state (a, s);
-  }
+  for (s = a->states_head; NULL != s; s = s->next)
+    s->contained = (GNUNET_NO == s->marked) ? GNUNET_YES : GNUNET_NO;
+  automaton_remove_contained_states (a);
 }
 
 
 /**
  * Remove all dead states from the DFA 'a'. Dead states are those states that do
- * not transition to any other state but themselves.
+ * not transition to any other state but themselves.  States are checked in
+ * the order of the states DLL, transitions to states found dead before are
+ * ignored.
  *
  * @param a DFA automaton
  */
@@ -1921,40 +2091,181 @@ static void
 dfa_remove_dead_states (struct REGEX_INTERNAL_Automaton *a)
 {
   struct REGEX_INTERNAL_State *s;
-  struct REGEX_INTERNAL_State *s_next;
   struct REGEX_INTERNAL_Transition *t;
   int dead;
 
   GNUNET_assert (DFA == a->type);
 
-  for (s = a->states_head; NULL != s; s = s_next)
-  {
-    s_next = s->next;
+  for (s = a->states_head; NULL != s; s = s->next)
+    s->contained = GNUNET_NO;
 
+  for (s = a->states_head; NULL != s; s = s->next)
+  {
     if (s->accepting)
       continue;
 
     dead = 1;
     for (t = s->transitions_head; NULL != t; t = t->next)
     {
-      if (NULL != t->to_state && t->to_state != s)
+      if (NULL != t->to_state && t->to_state != s &&
+          GNUNET_YES != t->to_state->contained)
       {
         dead = 0;
         break;
       }
     }
 
-    if (0 == dead)
-      continue;
-
     /* state s is dead, remove it */
-    automaton_remove_state (a, s);
+    if (1 == dead)
+      s->contained = GNUNET_YES;
   }
+  automaton_remove_contained_states (a);
 }
 
 
 /**
- * Merge all non distinguishable states in the DFA 'a'
+ * Partition of the states of a DFA into blocks of (so far)
+ * non-distinguishable states, used by Hopcroft's algorithm.
+ * States are identified by their position in the states DLL.
+ */
+struct Partition
+{
+  /**
+   * All states, grouped by block.
+   */
+  unsigned int *elems;
+
+  /**
+   * Position of each state in 'elems'.
+   */
+  unsigned int *pos;
+
+  /**
+   * Block of each state.
+   */
+  unsigned int *block;
+
+  /**
+   * Index of the first state of each block in 'elems'.
+   */
+  unsigned int *first;
+
+  /**
+   * Index after the last state of each block in 'elems'.
+   */
+  unsigned int *end;
+
+  /**
+   * Marked states of a block are kept in 'elems' from 'first' to 'mid'.
+   */
+  unsigned int *mid;
+
+  /**
+   * Number of blocks.
+   */
+  unsigned int count;
+};
+
+
+/**
+ * Mark state 's' in its block, to be split off later.
+ *
+ * @param p partition
+ * @param s state to mark
+ * @param touched array of blocks with marked states, 'b' is appended on
+ *        the first mark in block 'b'
+ * @param touched_len length of 'touched'
+ */
+static void
+partition_mark (struct Partition *p, unsigned int s,
+                unsigned int *touched, unsigned int *touched_len)
+{
+  unsigned int b = p->block[s];
+  unsigned int i = p->pos[s];
+  unsigned int j = p->mid[b];
+
+  if (i < j)
+    return; /* already marked */
+  if (p->mid[b] == p->first[b])
+    touched[(*touched_len)++] = b;
+  p->elems[i] = p->elems[j];
+  p->pos[p->elems[i]] = i;
+  p->elems[j] = s;
+  p->pos[s] = j;
+  p->mid[b]++;
+}
+
+
+/**
+ * Split the marked states off block 'b'.  The smaller one of the marked
+ * and the unmarked part becomes a new block.
+ *
+ * @param p partition
+ * @param b block to split
+ * @return index of the new block, or 'b' if all states of 'b' were marked
+ *         and no split was necessary
+ */
+static unsigned int
+partition_split (struct Partition *p, unsigned int b)
+{
+  unsigned int nb;
+  unsigned int i;
+
+  if (p->mid[b] == p->end[b])
+  {
+    p->mid[b] = p->first[b];
+    return b;
+  }
+  nb = p->count++;
+  if (p->mid[b] - p->first[b] <= p->end[b] - p->mid[b])
+  {
+    p->first[nb] = p->first[b];
+    p->end[nb] = p->mid[b];
+    p->first[b] = p->mid[b];
+  }
+  else
+  {
+    p->first[nb] = p->mid[b];
+    p->end[nb] = p->end[b];
+    p->end[b] = p->mid[b];
+  }
+  p->mid[b] = p->first[b];
+  p->mid[nb] = p->first[nb];
+  for (i = p->first[nb]; i < p->end[nb]; i++)
+    p->block[p->elems[i]] = nb;
+  return nb;
+}
+
+
+/**
+ * Compare two transitions by label. Used for sorting.
+ *
+ * @param a first transition
+ * @param b second transition
+ * @return result of strcmp on the labels
+ */
+static int
+transition_label_compare (const void *a, const void *b)
+{
+  const struct REGEX_INTERNAL_Transition *t1 =
+      *(struct REGEX_INTERNAL_Transition * const *) a;
+  const struct REGEX_INTERNAL_Transition *t2 =
+      *(struct REGEX_INTERNAL_Transition * const *) b;
+
+  return strcmp (t1->label, t2->label);
+}
+
+
+/**
+ * Merge all non distinguishable states in the DFA 'a'.
+ *
+ * Uses Hopcroft's partition refinement on a transition table indexed by state
+ * and label, which runs in O(k n log n) for 'n' states and 'k' distinct labels
+ * instead of the O(n^2) space and time (per round) of the table filling
+ * algorithm.  Missing transitions lead to an implicit sink state that starts
+ * out in a block of its own, so two states are only merged if they have
+ * transitions with the same labels to non distinguishable states.  Of each
+ * set of non distinguishable states the last one in the states DLL is kept.
  *
  * @param ctx context
  * @param a DFA automaton
@@ -1964,19 +2275,32 @@ static int
 dfa_merge_nondistinguishable_states (struct REGEX_INTERNAL_Context *ctx,
                                      struct REGEX_INTERNAL_Automaton *a)
 {
-  uint32_t *table;
-  struct REGEX_INTERNAL_State *s1;
-  struct REGEX_INTERNAL_State *s2;
-  struct REGEX_INTERNAL_Transition *t1;
-  struct REGEX_INTERNAL_Transition *t2;
-  struct REGEX_INTERNAL_State *s1_next;
-  struct REGEX_INTERNAL_State *s2_next;
-  int change;
-  unsigned int num_equal_edges;
+  struct REGEX_INTERNAL_State **states;
+  struct REGEX_INTERNAL_Transition **trans;
+  struct REGEX_INTERNAL_State *s;
+  struct REGEX_INTERNAL_Transition *t;
+  struct Partition p;
+  unsigned int *delta;
+  unsigned int *inv_off;
+  unsigned int *inv;
+  unsigned int *work;
+  unsigned int *touched;
+  unsigned int *pred;
+  unsigned int *rep;
+  char *in_work;
+  unsigned int n;
+  unsigned int num_states;
+  unsigned int num_trans;
+  unsigned int num_labels;
+  unsigned int work_len;
+  unsigned int touched_len;
+  unsigned int pred_len;
+  unsigned int b;
+  unsigned int nb;
+  unsigned int l;
   unsigned int i;
-  unsigned int state_cnt;
-  unsigned long long idx;
-  unsigned long long idx1;
+  unsigned int j;
+  unsigned int k;
 
   if ( (NULL == a) || (0 == a->state_count) )
   {
@@ -1985,86 +2309,206 @@ dfa_merge_nondistinguishable_states (struct REGEX_INTERNAL_Context *ctx,
     return GNUNET_SYSERR;
   }
 
-  state_cnt = a->state_count;
-  table = GNUNET_malloc_large ((sizeof (uint32_t) * state_cnt * state_cnt / 32)  + sizeof (uint32_t));
-  if (NULL == table)
+  /* number the states, state 'n' is the sink */
+  n = a->state_count;
+  num_states = n + 1;
+  states = GNUNET_malloc_large (sizeof (struct REGEX_INTERNAL_State *) * n);
+  if (NULL == states)
   {
     GNUNET_log_strerror (GNUNET_ERROR_TYPE_ERROR, "malloc");
     return GNUNET_SYSERR;
   }
+  num_trans = 0;
+  for (i = 0, s = a->states_head; NULL != s; s = s->next)
+  {
+    s->marked = i;
+    states[i++] = s;
+    num_trans += s->transition_count;
+  }
 
-  for (i = 0, s1 = a->states_head; NULL != s1; s1 = s1->next)
-    s1->marked = i++;
-
-  /* Mark all pairs of accepting/!accepting states */
-  for (s1 = a->states_head; NULL != s1; s1 = s1->next)
-    for (s2 = a->states_head; NULL != s2; s2 = s2->next)
-      if ( (s1->accepting && !s2->accepting) ||
-	   (!s1->accepting && s2->accepting) )
-      {
-	idx = s1->marked * state_cnt + s2->marked;
-        table[idx / 32] |= (1 << (idx % 32));
-      }
+  /* map the labels to 0..num_labels-1 */
+  trans = GNUNET_malloc_large (sizeof (struct REGEX_INTERNAL_Transition *) *
+                               num_trans + 1);
+  if (NULL == trans)
+  {
+    GNUNET_log_strerror (GNUNET_ERROR_TYPE_ERROR, "malloc");
+    GNUNET_free (states);
+    return GNUNET_SYSERR;
+  }
+  for (j = 0, i = 0; i < n; i++)
+    for (t = states[i]->transitions_head; NULL != t; t = t->next)
+      trans[j++] = t;
+  qsort (trans, num_trans, sizeof (struct REGEX_INTERNAL_Transition *),
+         &transition_label_compare);
+  num_labels = 0;
+  for (j = 0; j < num_trans; j++)
+    if ( (0 == j) ||
+         (0 != strcmp (trans[j - 1]->label, trans[j]->label)) )
+      num_labels++;
+
+  delta = GNUNET_malloc_large (sizeof (unsigned int) * num_states * num_labels + 1);
+  inv_off = GNUNET_malloc_large (sizeof (unsigned int) * (num_states * num_labels + 1));
+  inv = GNUNET_malloc_large (sizeof (unsigned int) * num_states * num_labels + 1);
+  work = GNUNET_malloc_large (2 * sizeof (unsigned int) * num_states * num_labels + 1);
+  in_work = GNUNET_malloc_large (num_states * num_labels + 1);
+  p.elems = GNUNET_malloc_large (6 * sizeof (unsigned int) * num_states);
+  touched = GNUNET_malloc_large (3 * sizeof (unsigned int) * num_states);
+  if ( (NULL == delta) || (NULL == inv_off) || (NULL == inv) ||
+       (NULL == work) || (NULL == in_work) || (NULL == p.elems) ||
+       (NULL == touched) )
+  {
+    GNUNET_log_strerror (GNUNET_ERROR_TYPE_ERROR, "malloc");
+    GNUNET_free_non_null (delta);
+    GNUNET_free_non_null (inv_off);
+    GNUNET_free_non_null (inv);
+    GNUNET_free_non_null (work);
+    GNUNET_free_non_null (in_work);
+    GNUNET_free_non_null (p.elems);
+    GNUNET_free_non_null (touched);
+    GNUNET_free (trans);
+    GNUNET_free (states);
+    return GNUNET_SYSERR;
+  }
+  p.pos = &p.elems[num_states];
+  p.block = &p.elems[2 * num_states];
+  p.first = &p.elems[3 * num_states];
+  p.end = &p.elems[4 * num_states];
+  p.mid = &p.elems[5 * num_states];
+  pred = &touched[num_states];
+  rep = &touched[2 * num_states];
+
+  /* transition table: delta[s * num_labels + l] */
+  for (i = 0; i < num_states * num_labels; i++)
+    delta[i] = n;
+  for (l = 0, j = 0; j < num_trans; j++)
+  {
+    if ( (0 < j) &&
+         (0 != strcmp (trans[j - 1]->label, trans[j]->label)) )
+      l++;
+    delta[trans[j]->from_state->marked * num_labels + l] =
+        trans[j]->to_state->marked;
+  }
+  GNUNET_free (trans);
+
+  /* inverse transitions: sources of transitions with label 'l' leading to
+   * state 's' are inv[inv_off[l * num_states + s]] up to (excluding)
+   * inv[inv_off[l * num_states + s + 1]] */
+  memset (inv_off, 0, sizeof (unsigned int) * (num_states * num_labels + 1));
+  for (i = 0; i < num_states; i++)
+    for (l = 0; l < num_labels; l++)
+      inv_off[l * num_states + delta[i * num_labels + l] + 1]++;
+  for (i = 0; i < num_states * num_labels; i++)
+    inv_off[i + 1] += inv_off[i];
+  for (i = 0; i < num_states; i++)
+    for (l = 0; l < num_labels; l++)
+      inv[inv_off[l * num_states + delta[i * num_labels + l]]++] = i;
+  /* the offsets were advanced to the end of each list, shift them back */
+  for (i = num_states * num_labels; i > 0; i--)
+    inv_off[i] = inv_off[i - 1];
+  inv_off[0] = 0;
+  GNUNET_free (delta);
+
+  /* initial partition: accepting states, other states, sink */
+  p.count = 0;
+  j = 0;
+  for (k = 0; k < 3; k++)
+  {
+    p.first[p.count] = j;
+    for (i = 0; i < num_states; i++)
+    {
+      if ( (i == n) != (2 == k) )
+        continue;
+      if ( (i < n) && ((0 == k) != (0 != states[i]->accepting)) )
+        continue;
+      p.elems[j] = i;
+      p.pos[i] = j;
+      p.block[i] = p.count;
+      j++;
+    }
+    if (j == p.first[p.count])
+      continue;
+    p.end[p.count] = j;
+    p.mid[p.count] = p.first[p.count];
+    p.count++;
+  }
+  work_len = 0;
+  memset (in_work, 0, num_states * num_labels);
+  for (b = 0; b < p.count; b++)
+    for (l = 0; l < num_labels; l++)
+    {
+      work[work_len++] = b;
+      work[work_len++] = l;
+      in_work[b * num_labels + l] = 1;
+    }
 
-  /* Find all equal states */
-  change = 1;
-  while (0 != change)
+  /* refine */
+  while (0 < work_len)
   {
-    change = 0;
-    for (s1 = a->states_head; NULL != s1; s1 = s1->next)
+    l = work[--work_len];
+    b = work[--work_len];
+    in_work[b * num_labels + l] = 0;
+    pred_len = 0;
+    for (i = p.first[b]; i < p.end[b]; i++)
+    {
+      k = l * num_states + p.elems[i];
+      for (j = inv_off[k]; j < inv_off[k + 1]; j++)
+        pred[pred_len++] = inv[j];
+    }
+    touched_len = 0;
+    for (i = 0; i < pred_len; i++)
+      partition_mark (&p, pred[i], touched, &touched_len);
+    for (i = 0; i < touched_len; i++)
     {
-      for (s2 = a->states_head; NULL != s2 && s1 != s2; s2 = s2->next)
+      nb = partition_split (&p, touched[i]);
+      if (nb == touched[i])
+        continue;
+      /* the new block is the smaller part, so it is always enough to add
+       * it to the work list */
+      for (k = 0; k < num_labels; k++)
       {
-	idx = s1->marked * state_cnt + s2->marked;
-        if (0 != (table[idx / 32] & (1 << (idx % 32))))
+        if (0 != in_work[nb * num_labels + k])
           continue;
-        num_equal_edges = 0;
-        for (t1 = s1->transitions_head; NULL != t1; t1 = t1->next)
-        {
-          for (t2 = s2->transitions_head; NULL != t2; t2 = t2->next)
-          {
-            if (0 == strcmp (t1->label, t2->label))
-	    {
-	      num_equal_edges++;
-	      /* same edge, but targets definitively different, so we're different
-		 as well */
-	      if (t1->to_state->marked > t2->to_state->marked)
-		idx1 = t1->to_state->marked * state_cnt + t2->to_state->marked;
-	      else
-		idx1 = t2->to_state->marked * state_cnt + t1->to_state->marked;
-	      if (0 != (table[idx1 / 32] & (1 << (idx1 % 32))))
-	      {
-		table[idx / 32] |= (1 << (idx % 32));
-		change = 1; /* changed a marker, need to run again */
-	      }
-	    }
-	  }
-        }
-        if ( (num_equal_edges != s1->transition_count) ||
-	     (num_equal_edges != s2->transition_count) )
-        {
-          /* Make sure ALL edges of possible equal states are the same */
-	  table[idx / 32] |= (1 << (idx % 32));
-	  change = 1;  /* changed a marker, need to run again */
-        }
+        work[work_len++] = nb;
+        work[work_len++] = k;
+        in_work[nb * num_labels + k] = 1;
       }
     }
   }
+  GNUNET_free (inv_off);
+  GNUNET_free (inv);
+  GNUNET_free (work);
+  GNUNET_free (in_work);
 
-  /* Merge states that are equal */
-  for (s1 = a->states_head; NULL != s1; s1 = s1_next)
+  /* keep the last state of each block, redirect all transitions to it */
+  for (i = 0; i < n; i++)
+    rep[p.block[i]] = i;
+  for (i = 0; i < n; i++)
   {
-    s1_next = s1->next;
-    for (s2 = a->states_head; NULL != s2 && s1 != s2; s2 = s2_next)
+    s = states[i];
+    if (rep[p.block[i]] != i)
     {
-      s2_next = s2->next;
-      idx = s1->marked * state_cnt + s2->marked;
-      if (0 == (table[idx / 32] & (1 << (idx % 32))))
-        automaton_merge_states (ctx, a, s1, s2);
+#if REGEX_DEBUG_DFA
+      char *new_name;
+
+      new_name = states[rep[p.block[i]]]->name;
+      GNUNET_asprintf (&states[rep[p.block[i]]]->name, "{%s,%s}", new_name,
+                       s->name);
+      GNUNET_free (new_name);
+#endif
+      s->contained = GNUNET_YES;
+      continue;
     }
+    s->contained = GNUNET_NO;
+    for (t = s->transitions_head; NULL != t; t = t->next)
+      t->to_state = states[rep[p.block[t->to_state->marked]]];
   }
+  a->start = states[rep[p.block[a->start->marked]]];
+  GNUNET_free (p.elems);
+  GNUNET_free (touched);
+  GNUNET_free (states);
 
-  GNUNET_free (table);
+  /* transitions only lead to kept states now, so this just frees the rest */
+  automaton_remove_contained_states (a);
   return GNUNET_OK;
 }
 
@@ -2310,7 +2754,6 @@ dfa_compress_paths (struct REGEX_INTERNAL_Context *regex_ctx,
                     struct REGEX_INTERNAL_Automaton *dfa, unsigned int max_len)
 {
   struct REGEX_INTERNAL_State *s;
-  struct REGEX_INTERNAL_State *s_next;
   struct REGEX_INTERNAL_Transition *t;
   struct REGEX_INTERNAL_Transition *t_next;
   struct REGEX_INTERNAL_Transition *transitions_head = NULL;
@@ -2351,12 +2794,7 @@ dfa_compress_paths (struct REGEX_INTERNAL_Context *regex_ctx,
   }
 
   /* Remove marked states (including their incoming and outgoing transitions). */
-  for (s = dfa->states_head; NULL != s; s = s_next)
-  {
-    s_next = s->next;
-    if (GNUNET_YES == s->contained)
-      automaton_remove_state (dfa, s);
-  }
+  automaton_remove_contained_states (dfa);
 }
 
 
@@ -2947,12 +3385,77 @@ error:
 }
 
 
+/**
+ * Compute the key under which a DFA state based on the given set of NFA
+ * states is stored in the map of DFA states.
+ *
+ * @param set (sorted) set of NFA states
+ * @param key set to the hash of the ids of the states in 'set'
+ */
+static void
+state_set_hash (const struct REGEX_INTERNAL_StateSet *set,
+                struct GNUNET_HashCode *key)
+{
+  unsigned int *ids;
+  unsigned int i;
+
+  ids = GNUNET_malloc (sizeof (unsigned int) * set->off + 1);
+  for (i = 0; i < set->off; i++)
+    ids[i] = set->states[i]->id;
+  GNUNET_CRYPTO_hash (ids, sizeof (unsigned int) * set->off, key);
+  GNUNET_free (ids);
+}
+
+
+/**
+ * Closure for 'find_dfa_state'.
+ */
+struct FindDfaStateContext
+{
+  /**
+   * Set of NFA states we are looking for.
+   */
+  struct REGEX_INTERNAL_StateSet *nfa_set;
+
+  /**
+   * DFA state based on 'nfa_set', NULL if not found (yet).
+   */
+  struct REGEX_INTERNAL_State *result;
+};
+
+
+/**
+ * Check if the given DFA state is based on the set of NFA states we are
+ * looking for.
+ *
+ * @param cls the 'struct FindDfaStateContext'
+ * @param key hash of the set of NFA states
+ * @param value a 'struct REGEX_INTERNAL_State'
+ * @return GNUNET_NO if we found the state, GNUNET_YES to continue
+ */
+static int
+find_dfa_state (void *cls,
+                const struct GNUNET_HashCode *key,
+                void *value)
+{
+  struct FindDfaStateContext *ctx = cls;
+  struct REGEX_INTERNAL_State *state = value;
+
+  if (0 != state_set_compare (&state->nfa_set, ctx->nfa_set))
+    return GNUNET_YES;
+  ctx->result = state;
+  return GNUNET_NO;
+}
+
+
 /**
  * Create DFA states based on given 'nfa' and starting with 'dfa_state'.
  *
  * @param ctx context.
  * @param nfa NFA automaton.
  * @param dfa DFA automaton.
+ * @param dfa_states map from the hashes of their sets of NFA states (see
+ *                   'state_set_hash') to all states of 'dfa'.
  * @param dfa_state current dfa state, pass epsilon closure of first nfa state
  *                  for starting.
  */
@@ -2960,14 +3463,15 @@ static void
 construct_dfa_states (struct REGEX_INTERNAL_Context *ctx,
                       struct REGEX_INTERNAL_Automaton *nfa,
                       struct REGEX_INTERNAL_Automaton *dfa,
+                      struct GNUNET_CONTAINER_MultiHashMap *dfa_states,
                       struct REGEX_INTERNAL_State *dfa_state)
 {
   struct REGEX_INTERNAL_Transition *ctran;
   struct REGEX_INTERNAL_State *new_dfa_state;
-  struct REGEX_INTERNAL_State *state_contains;
-  struct REGEX_INTERNAL_State *state_iter;
   struct REGEX_INTERNAL_StateSet tmp;
   struct REGEX_INTERNAL_StateSet nfa_set;
+  struct FindDfaStateContext fctx;
+  struct GNUNET_HashCode key;
 
   for (ctran = dfa_state->transitions_head; NULL != ctran; ctran = ctran->next)
   {
@@ -2978,26 +3482,25 @@ construct_dfa_states (struct REGEX_INTERNAL_Context *ctx,
     nfa_closure_set_create (&nfa_set, nfa, &tmp, NULL);
     state_set_clear (&tmp);
 
-    state_contains = NULL;
-    for (state_iter = dfa->states_head; NULL != state_iter;
-         state_iter = state_iter->next)
-    {
-      if (0 == state_set_compare (&state_iter->nfa_set, &nfa_set))
-      {
-        state_contains = state_iter;
-	break;
-      }
-    }
-    if (NULL == state_contains)
+    state_set_hash (&nfa_set, &key);
+    fctx.nfa_set = &nfa_set;
+    fctx.result = NULL;
+    GNUNET_CONTAINER_multihashmap_get_multiple (dfa_states, &key,
+                                                &find_dfa_state, &fctx);
+    if (NULL == fctx.result)
     {
       new_dfa_state = dfa_state_create (ctx, &nfa_set);
       automaton_add_state (dfa, new_dfa_state);
+      GNUNET_assert (GNUNET_OK ==
+                     GNUNET_CONTAINER_multihashmap_put (dfa_states, &key,
+                                                        new_dfa_state,
+                                                        GNUNET_CONTAINER_MULTIHASHMAPOPTION_MULTIPLE));
       ctran->to_state = new_dfa_state;
-      construct_dfa_states (ctx, nfa, dfa, new_dfa_state);
+      construct_dfa_states (ctx, nfa, dfa, dfa_states, new_dfa_state);
     }
     else
     {
-      ctran->to_state = state_contains;
+      ctran->to_state = fctx.result;
       state_set_clear (&nfa_set);
     }
   }
@@ -3030,6 +3533,8 @@ REGEX_INTERNAL_construct_dfa (const char *regex, const size_t len,
   struct REGEX_INTERNAL_Automaton *nfa;
   struct REGEX_INTERNAL_StateSet nfa_start_eps_cls;
   struct REGEX_INTERNAL_StateSet singleton_set;
+  struct GNUNET_CONTAINER_MultiHashMap *dfa_states;
+  struct GNUNET_HashCode key;
 
   REGEX_INTERNAL_context_init (&ctx);
 
@@ -3052,10 +3557,16 @@ REGEX_INTERNAL_construct_dfa (const char *regex, const size_t len,
   state_set_append (&singleton_set, nfa->start);
   nfa_closure_set_create (&nfa_start_eps_cls, nfa, &singleton_set, NULL);
   state_set_clear (&singleton_set);
+  state_set_hash (&nfa_start_eps_cls, &key);
   dfa->start = dfa_state_create (&ctx, &nfa_start_eps_cls);
   automaton_add_state (dfa, dfa->start);
+  dfa_states = GNUNET_CONTAINER_multihashmap_create (nfa->state_count, GNUNET_NO);
+  GNUNET_assert (GNUNET_OK ==
+                 GNUNET_CONTAINER_multihashmap_put (dfa_states, &key, dfa->start,
+                                                    GNUNET_CONTAINER_MULTIHASHMAPOPTION_MULTIPLE));
 
-  construct_dfa_states (&ctx, nfa, dfa, dfa->start);
+  construct_dfa_states (&ctx, nfa, dfa, dfa_states, dfa->start);
+  GNUNET_CONTAINER_multihashmap_destroy (dfa_states);
   REGEX_INTERNAL_automaton_destroy (nfa);
 
   /* Minimize DFA */
@@ -3246,6 +3757,296 @@ REGEX_INTERNAL_eval (struct REGEX_INTERNAL_Automaton *a, const char *string)
 }
 
 
+/**
+ * Value in the transition table of a compiled DFA if there is no transition.
+ */
+#define NO_STATE UINT32_MAX
+
+
+/**
+ * Table-driven representation of a DFA, see REGEX_INTERNAL_dfa_compile.
+ *
+ * Input characters are mapped to character classes, class 0 being all
+ * characters that do not start any label.  If all labels consist of a single
+ * character, the next state is looked up in a dense table indexed by state
+ * and class.  Otherwise the edges leaving each state are stored in compressed
+ * rows, grouped by the class of the first character of their label.
+ */
+struct REGEX_INTERNAL_CompiledDfa
+{
+  /**
+   * Class of each input character.
+   */
+  uint16_t classes[256];
+
+  /**
+   * Number of character classes.
+   */
+  unsigned int num_classes;
+
+  /**
+   * Number of states.
+   */
+  unsigned int num_states;
+
+  /**
+   * Start state.
+   */
+  uint32_t start;
+
+  /**
+   * GNUNET_YES if all labels are single characters, so 'next' is used instead
+   * of the edge arrays.
+   */
+  int single_char;
+
+  /**
+   * Array of length 'num_states', non-zero for accepting states.
+   */
+  uint8_t *accepting;
+
+  /**
+   * Next state for state 's' on an input character of class 'c' is
+   * next[s * num_classes + c], NO_STATE if there is no such transition.
+   */
+  uint32_t *next;
+
+  /**
+   * Edges leaving state 's' with a label starting with a character of class
+   * 'c' are edge_off[s * num_classes + c] up to (excluding)
+   * edge_off[s * num_classes + c + 1].
+   */
+  uint32_t *edge_off;
+
+  /**
+   * Target state of each edge.
+   */
+  uint32_t *edge_target;
+
+  /**
+   * Offset of the label of each edge in 'labels'.
+   */
+  uint32_t *edge_label;
+
+  /**
+   * Length of the label of each edge.
+   */
+  uint32_t *edge_label_len;
+
+  /**
+   * All labels, not 0-terminated.
+   */
+  char *labels;
+};
+
+
+/**
+ * Compile the given DFA into a table-driven matcher.
+ *
+ * @param a automaton, type must be DFA
+ * @return compiled DFA, NULL on error
+ */
+struct REGEX_INTERNAL_CompiledDfa *
+REGEX_INTERNAL_dfa_compile (struct REGEX_INTERNAL_Automaton *a)
+{
+  struct REGEX_INTERNAL_CompiledDfa *c;
+  struct REGEX_INTERNAL_State *s;
+  struct REGEX_INTERNAL_Transition *t;
+  unsigned int num_edges;
+  size_t labels_len;
+  size_t len;
+  uint32_t *pos;
+  unsigned int cls;
+  unsigned int i;
+  unsigned int j;
+
+  if ( (NULL == a) || (DFA != a->type) || (NULL == a->start) )
+  {
+    GNUNET_log (GNUNET_ERROR_TYPE_ERROR,
+                "Tried to compile DFA, but no DFA given\n");
+    return NULL;
+  }
+  c = GNUNET_new (struct REGEX_INTERNAL_CompiledDfa);
+  c->num_classes = 1;
+  c->single_char = GNUNET_YES;
+  num_edges = 0;
+  labels_len = 0;
+  i = 0;
+  for (s = a->states_head; NULL != s; s = s->next)
+  {
+    s->traversal_id = i++;
+    for (t = s->transitions_head; NULL != t; t = t->next)
+    {
+      len = strlen (t->label);
+      GNUNET_assert (0 < len);
+      if (0 == c->classes[(unsigned char) t->label[0]])
+        c->classes[(unsigned char) t->label[0]] = c->num_classes++;
+      if (1 != len)
+        c->single_char = GNUNET_NO;
+      labels_len += len;
+      num_edges++;
+    }
+  }
+  c->num_states = i;
+  c->start = a->start->traversal_id;
+  c->accepting = GNUNET_malloc (c->num_states);
+  for (s = a->states_head; NULL != s; s = s->next)
+    c->accepting[s->traversal_id] = (0 != s->accepting);
+
+  if (GNUNET_YES == c->single_char)
+  {
+    c->next = GNUNET_malloc_large (sizeof (uint32_t) * c->num_states *
+                                   c->num_classes);
+    if (NULL == c->next)
+    {
+      GNUNET_log_strerror (GNUNET_ERROR_TYPE_ERROR, "malloc");
+      REGEX_INTERNAL_compiled_dfa_destroy (c);
+      return NULL;
+    }
+    for (i = 0; i < c->num_states * c->num_classes; i++)
+      c->next[i] = NO_STATE;
+    for (s = a->states_head; NULL != s; s = s->next)
+      for (t = s->transitions_head; NULL != t; t = t->next)
+        c->next[s->traversal_id * c->num_classes +
+                c->classes[(unsigned char) t->label[0]]] =
+            t->to_state->traversal_id;
+    return c;
+  }
+
+  c->edge_off = GNUNET_malloc_large (sizeof (uint32_t) *
+                                     (c->num_states * c->num_classes + 1));
+  c->edge_target = GNUNET_malloc_large (sizeof (uint32_t) * num_edges + 1);
+  c->edge_label = GNUNET_malloc_large (sizeof (uint32_t) * num_edges + 1);
+  c->edge_label_len = GNUNET_malloc_large (sizeof (uint32_t) * num_edges + 1);
+  c->labels = GNUNET_malloc_large (labels_len + 1);
+  if ( (NULL == c->edge_off) || (NULL == c->edge_target) ||
+       (NULL == c->edge_label) || (NULL == c->edge_label_len) ||
+       (NULL == c->labels) )
+  {
+    GNUNET_log_strerror (GNUNET_ERROR_TYPE_ERROR, "malloc");
+    REGEX_INTERNAL_compiled_dfa_destroy (c);
+    return NULL;
+  }
+  /* count the edges per row, then turn the counts into offsets */
+  memset (c->edge_off, 0,
+          sizeof (uint32_t) * (c->num_states * c->num_classes + 1));
+  for (s = a->states_head; NULL != s; s = s->next)
+    for (t = s->transitions_head; NULL != t; t = t->next)
+      c->edge_off[s->traversal_id * c->num_classes +
+                  c->classes[(unsigned char) t->label[0]] + 1]++;
+  for (i = 0; i < c->num_states * c->num_classes; i++)
+    c->edge_off[i + 1] += c->edge_off[i];
+  pos = GNUNET_malloc_large (sizeof (uint32_t) * c->num_states *
+                             c->num_classes);
+  if (NULL == pos)
+  {
+    GNUNET_log_strerror (GNUNET_ERROR_TYPE_ERROR, "malloc");
+    REGEX_INTERNAL_compiled_dfa_destroy (c);
+    return NULL;
+  }
+  memcpy (pos, c->edge_off,
+          sizeof (uint32_t) * c->num_states * c->num_classes);
+  labels_len = 0;
+  for (s = a->states_head; NULL != s; s = s->next)
+    for (t = s->transitions_head; NULL != t; t = t->next)
+    {
+      cls = c->classes[(unsigned char) t->label[0]];
+      j = pos[s->traversal_id * c->num_classes + cls]++;
+      len = strlen (t->label);
+      c->edge_target[j] = t->to_state->traversal_id;
+      c->edge_label[j] = labels_len;
+      c->edge_label_len[j] = len;
+      memcpy (&c->labels[labels_len], t->label, len);
+      labels_len += len;
+    }
+  GNUNET_free (pos);
+  return c;
+}
+
+
+/**
+ * Evaluate the given 'string' against the given compiled DFA.  Gives the same
+ * result as REGEX_INTERNAL_eval on the DFA 'c' was compiled from.
+ *
+ * @param c compiled DFA
+ * @param string string to check
+ * @return 0 if string matches, non 0 otherwise
+ */
+int
+REGEX_INTERNAL_compiled_eval (const struct REGEX_INTERNAL_CompiledDfa *c,
+                              const char *string)
+{
+  const unsigned char *strp;
+  const uint32_t *row;
+  uint32_t s;
+  size_t left;
+  uint32_t max_len;
+  uint32_t next;
+  uint32_t i;
+
+  s = c->start;
+  if (NULL == string)
+    return c->accepting[s] ? 0 : 1;
+  strp = (const unsigned char *) string;
+  if (GNUNET_YES == c->single_char)
+  {
+    for (; '\0' != *strp; strp++)
+    {
+      s = c->next[s * c->num_classes + c->classes[*strp]];
+      if (NO_STATE == s)
+        return 1;
+    }
+    return c->accepting[s] ? 0 : 1;
+  }
+  /* labels may be longer than one character, follow the edge with the
+   * longest label that is a prefix of the remaining input */
+  left = strlen (string);
+  while (0 < left)
+  {
+    row = &c->edge_off[s * c->num_classes + c->classes[*strp]];
+    max_len = 0;
+    next = NO_STATE;
+    for (i = row[0]; i < row[1]; i++)
+    {
+      if ( (c->edge_label_len[i] < max_len) ||
+           (c->edge_label_len[i] > left) ||
+           (0 != memcmp (&c->labels[c->edge_label[i]], strp,
+                         c->edge_label_len[i])) )
+        continue;
+      max_len = c->edge_label_len[i];
+      next = c->edge_target[i];
+    }
+    if (NO_STATE == next)
+      return 1;
+    s = next;
+    strp += max_len;
+    left -= max_len;
+  }
+  return c->accepting[s] ? 0 : 1;
+}
+
+
+/**
+ * Free the memory used by a compiled DFA.
+ *
+ * @param c compiled DFA to destroy
+ */
+void
+REGEX_INTERNAL_compiled_dfa_destroy (struct REGEX_INTERNAL_CompiledDfa *c)
+{
+  if (NULL == c)
+    return;
+  GNUNET_free_non_null (c->accepting);
+  GNUNET_free_non_null (c->next);
+  GNUNET_free_non_null (c->edge_off);
+  GNUNET_free_non_null (c->edge_target);
+  GNUNET_free_non_null (c->edge_label);
+  GNUNET_free_non_null (c->edge_label_len);
+  GNUNET_free_non_null (c->labels);
+  GNUNET_free (c);
+}
+
+
 /**
  * Get the canonical regex of the given automaton.
  * When constructing the automaton a proof is computed for each state,
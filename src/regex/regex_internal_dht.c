@@ -232,9 +232,18 @@ REGEX_INTERNAL_announce_cancel (struct REGEX_INTERNAL_Announcement *h)
 /******************************************************************************/
 
 
+/**
+ * How many search branches do we follow at most?  Once this many
+ * branches exist, each block only continues along its longest
+ * matching edge, as a plain (non-speculative) search would.
+ */
+#define MAX_SEARCH_BRANCHES 64
+
+
 /**
  * Struct to keep state of running searches that have consumed a part of
- * the inital string.
+ * the inital string.  Each context is one branch of the search: a state
+ * (identified by its key) reached after consuming a given prefix.
  */
 struct RegexSearchContext
 {
@@ -250,15 +259,43 @@ struct RegexSearchContext
   struct REGEX_INTERNAL_Search *info;
 
   /**
-   * We just want to look for one edge, the longer the better.
-   * Keep its length.
+   * Key of the state this branch is looking for.
+   */
+  struct GNUNET_HashCode key;
+
+  /**
+   * DHT GET for the block of the state, NULL once the branch
+   * was cancelled.
+   */
+  struct GNUNET_DHT_GetHandle *get_h;
+
+  /**
+   * Branch whose block had the edge to this state, NULL for the
+   * initial state.
+   */
+  struct RegexSearchContext *parent;
+
+  /**
+   * The block of @e parent that had the edge to this state.
+   */
+  const struct Result *parent_block;
+
+  /**
+   * Block of this state through which an accepting state was
+   * reached, NULL if none.
+   */
+  const struct Result *found_via;
+
+  /**
+   * #GNUNET_YES if this branch is on a path to an accepting state.
    */
-  unsigned int longest_match;
+  int found;
 
   /**
-   * Destination hash of the longest match.
+   * #GNUNET_YES if a path to an accepting state made this branch
+   * redundant.
    */
-  struct GNUNET_HashCode hash;
+  int cancelled;
 };
 
 
@@ -279,6 +316,137 @@ struct Result
 };
 
 
+/**
+ * Edge of a block that matches the rest of the search string.
+ */
+struct SearchEdge
+{
+  /**
+   * Destination of the edge.
+   */
+  struct GNUNET_HashCode key;
+
+  /**
+   * Length of the edge's token.
+   */
+  size_t len;
+};
+
+
+/**
+ * Closure for #regex_edge_iterator.
+ */
+struct EdgeCollector
+{
+  /**
+   * Information about the search.
+   */
+  struct REGEX_INTERNAL_Search *info;
+
+  /**
+   * Position in the description the edges must match at.
+   */
+  size_t position;
+
+  /**
+   * Matching edges found so far.
+   */
+  struct SearchEdge *edges;
+
+  /**
+   * Number of entries in @e edges.
+   */
+  unsigned int n_edges;
+};
+
+
+/**
+ * Closure for #collect_value, a snapshot of the values stored
+ * under one key of a multihashmap.
+ */
+struct ValueCollector
+{
+  /**
+   * The values.
+   */
+  void **values;
+
+  /**
+   * Number of entries in @e values.
+   */
+  unsigned int n_values;
+};
+
+
+/**
+ * Block in a `struct REGEX_INTERNAL_BlockCache`.
+ */
+struct CacheEntry
+{
+  /**
+   * Kept in a DLL, most recently used first.
+   */
+  struct CacheEntry *next;
+
+  /**
+   * Kept in a DLL, most recently used first.
+   */
+  struct CacheEntry *prev;
+
+  /**
+   * Key of the block.
+   */
+  struct GNUNET_HashCode key;
+
+  /**
+   * When does the block expire?
+   */
+  struct GNUNET_TIME_Absolute expiration;
+
+  /**
+   * Number of bytes in data.
+   */
+  size_t size;
+
+  /**
+   * The block, allocated at the end of this struct.
+   */
+  const void *data;
+};
+
+
+/**
+ * Cache of regex blocks found in the DHT.
+ */
+struct REGEX_INTERNAL_BlockCache
+{
+  /**
+   * Map from keys to `struct CacheEntry`s.
+   */
+  struct GNUNET_CONTAINER_MultiHashMap *entries;
+
+  /**
+   * Head of the LRU list.
+   */
+  struct CacheEntry *lru_head;
+
+  /**
+   * Tail of the LRU list, dropped first.
+   */
+  struct CacheEntry *lru_tail;
+
+  /**
+   * Maximum number of blocks to keep.
+   */
+  unsigned int max_blocks;
+
+  /**
+   * Number of blocks in the cache.
+   */
+  unsigned int n_blocks;
+};
+
+
 /**
  * Struct to keep information of searches of services described by a regex
  * using a user-provided string service description.
@@ -295,15 +463,20 @@ struct REGEX_INTERNAL_Search
    */
   struct GNUNET_STATISTICS_Handle *stats;
 
+  /**
+   * Optional block cache. Can be NULL.
+   */
+  struct REGEX_INTERNAL_BlockCache *cache;
+
   /**
    * User provided description of the searched service.
    */
   char *description;
 
   /**
-   * Running DHT GETs.
+   * Running DHT GETs for accepting states.
    */
-  struct GNUNET_CONTAINER_MultiHashMap *dht_get_handles;
+  struct GNUNET_CONTAINER_MultiHashMap *accept_get_handles;
 
   /**
    * Results from running DHT GETs, values are of type
@@ -311,6 +484,11 @@ struct REGEX_INTERNAL_Search
    */
   struct GNUNET_CONTAINER_MultiHashMap *dht_get_results;
 
+  /**
+   * Map from state keys to the contexts looking for them.
+   */
+  struct GNUNET_CONTAINER_MultiHashMap *branches;
+
   /**
    * Contexts, for each running DHT GET. Free all on end of search.
    */
@@ -334,23 +512,277 @@ struct REGEX_INTERNAL_Search
 
 
 /**
- * Jump to the next edge, with the longest matching token.
+ * Start a search branch for a state, unless there is one already.
+ *
+ * @param info the search
+ * @param parent branch whose block had the edge to the state,
+ *        NULL for the initial state
+ * @param parent_block the block of @a parent with the edge
+ * @param key key of the state
+ * @param position part of the description consumed when reaching the state
+ */
+static void
+regex_branch_start (struct REGEX_INTERNAL_Search *info,
+                    struct RegexSearchContext *parent,
+                    const struct Result *parent_block,
+                    const struct GNUNET_HashCode *key,
+                    size_t position);
+
+
+/**
+ * Iterator adding all values under a key to a `struct ValueCollector`.
+ *
+ * @param cls the `struct ValueCollector`
+ * @param key current key (unused)
+ * @param value value to add
+ * @return #GNUNET_YES to continue iterating
+ */
+static int
+collect_value (void *cls,
+               const struct GNUNET_HashCode *key,
+               void *value)
+{
+  struct ValueCollector *vc = cls;
+
+  GNUNET_array_append (vc->values, vc->n_values, value);
+  return GNUNET_YES;
+}
+
+
+/**
+ * Take a snapshot of the values stored under a key, so that the map
+ * may be modified while they are processed.
+ *
+ * @param map map to look into
+ * @param key key to look for
+ * @param vc where to store the values, must be zero-initialized;
+ *        the caller must free `vc->values`
+ */
+static void
+collect_values (struct GNUNET_CONTAINER_MultiHashMap *map,
+                const struct GNUNET_HashCode *key,
+                struct ValueCollector *vc)
+{
+  GNUNET_CONTAINER_multihashmap_get_multiple (map, key,
+                                              &collect_value, vc);
+}
+
+
+/**
+ * Remove an entry from a block cache.
  *
- * @param block Block found in the DHT.
- * @param size Size of the block.
- * @param ctx Context of the search.
+ * @param cache the cache
+ * @param entry entry to remove and free
  */
 static void
-regex_next_edge (const struct RegexBlock *block,
-                 size_t size,
-                 struct RegexSearchContext *ctx);
+cache_entry_remove (struct REGEX_INTERNAL_BlockCache *cache,
+                    struct CacheEntry *entry)
+{
+  GNUNET_CONTAINER_DLL_remove (cache->lru_head, cache->lru_tail, entry);
+  GNUNET_assert (GNUNET_YES ==
+                 GNUNET_CONTAINER_multihashmap_remove (cache->entries,
+                                                       &entry->key,
+                                                       entry));
+  cache->n_blocks--;
+  GNUNET_free (entry);
+}
+
+
+/**
+ * Create a cache for regex blocks found in the DHT.  Searches using
+ * the cache start from the blocks other searches already fetched
+ * instead of waiting for the DHT.
+ *
+ * @param max_blocks maximum number of blocks to keep, the least
+ *        recently used ones are dropped first
+ * @return the cache, free with REGEX_INTERNAL_block_cache_destroy
+ */
+struct REGEX_INTERNAL_BlockCache *
+REGEX_INTERNAL_block_cache_create (unsigned int max_blocks)
+{
+  struct REGEX_INTERNAL_BlockCache *cache;
+
+  cache = GNUNET_new (struct REGEX_INTERNAL_BlockCache);
+  cache->max_blocks = max_blocks;
+  cache->entries =
+      GNUNET_CONTAINER_multihashmap_create (GNUNET_MIN (max_blocks, 1024) + 1,
+                                            GNUNET_NO);
+  return cache;
+}
+
+
+/**
+ * Destroy a block cache.  All searches using it must have been
+ * cancelled before.
+ *
+ * @param cache cache to destroy
+ */
+void
+REGEX_INTERNAL_block_cache_destroy (struct REGEX_INTERNAL_BlockCache *cache)
+{
+  while (NULL != cache->lru_head)
+    cache_entry_remove (cache, cache->lru_head);
+  GNUNET_CONTAINER_multihashmap_destroy (cache->entries);
+  GNUNET_free (cache);
+}
+
+
+/**
+ * Add a block found in the DHT to a cache.  Blocks already in the
+ * cache only get their expiration time updated.
+ *
+ * @param cache the cache
+ * @param key key of the block
+ * @param expiration when does the block expire
+ * @param data the block
+ * @param size number of bytes in @a data
+ */
+void
+REGEX_INTERNAL_block_cache_put (struct REGEX_INTERNAL_BlockCache *cache,
+                                const struct GNUNET_HashCode *key,
+                                struct GNUNET_TIME_Absolute expiration,
+                                const void *data,
+                                size_t size)
+{
+  struct ValueCollector vc;
+  struct CacheEntry *entry;
+  unsigned int i;
+
+  if (0 == cache->max_blocks)
+    return;
+  memset (&vc, 0, sizeof (vc));
+  collect_values (cache->entries, key, &vc);
+  entry = NULL;
+  for (i = 0; i < vc.n_values; i++)
+  {
+    struct CacheEntry *e = vc.values[i];
+
+    if ( (e->size == size) &&
+         (0 == memcmp (e->data, data, size)) )
+    {
+      entry = e;
+      break;
+    }
+  }
+  GNUNET_free_non_null (vc.values);
+  if (NULL != entry)
+  {
+    entry->expiration = GNUNET_TIME_absolute_max (entry->expiration,
+                                                  expiration);
+    GNUNET_CONTAINER_DLL_remove (cache->lru_head, cache->lru_tail, entry);
+    GNUNET_CONTAINER_DLL_insert (cache->lru_head, cache->lru_tail, entry);
+    return;
+  }
+  entry = GNUNET_malloc (sizeof (struct CacheEntry) + size);
+  entry->key = *key;
+  entry->expiration = expiration;
+  entry->size = size;
+  entry->data = &entry[1];
+  memcpy (&entry[1], data, size);
+  GNUNET_CONTAINER_DLL_insert (cache->lru_head, cache->lru_tail, entry);
+  GNUNET_break (GNUNET_OK ==
+                GNUNET_CONTAINER_multihashmap_put (cache->entries,
+                                                   key, entry,
+                                                   GNUNET_CONTAINER_MULTIHASHMAPOPTION_MULTIPLE));
+  cache->n_blocks++;
+  while (cache->n_blocks > cache->max_blocks)
+    cache_entry_remove (cache, cache->lru_tail);
+}
+
+
+/**
+ * Get the blocks stored in a cache under a key.  Expired blocks are
+ * dropped, the others become the most recently used ones.
+ *
+ * @param cache the cache
+ * @param key key to look for
+ * @param it function to call on each block, must not modify the cache
+ * @param it_cls closure for @a it
+ * @return number of blocks passed to @a it
+ */
+unsigned int
+REGEX_INTERNAL_block_cache_get (struct REGEX_INTERNAL_BlockCache *cache,
+                                const struct GNUNET_HashCode *key,
+                                REGEX_INTERNAL_BlockCacheIterator it,
+                                void *it_cls)
+{
+  struct GNUNET_TIME_Absolute now;
+  struct ValueCollector vc;
+  struct CacheEntry *entry;
+  unsigned int count;
+  unsigned int i;
+
+  memset (&vc, 0, sizeof (vc));
+  collect_values (cache->entries, key, &vc);
+  now = GNUNET_TIME_absolute_get ();
+  count = 0;
+  for (i = 0; i < vc.n_values; i++)
+  {
+    entry = vc.values[i];
+    if (entry->expiration.abs_value_us < now.abs_value_us)
+    {
+      cache_entry_remove (cache, entry);
+      continue;
+    }
+    GNUNET_CONTAINER_DLL_remove (cache->lru_head, cache->lru_tail, entry);
+    GNUNET_CONTAINER_DLL_insert (cache->lru_head, cache->lru_tail, entry);
+    it (it_cls, key, entry->data, entry->size);
+    count++;
+  }
+  GNUNET_free_non_null (vc.values);
+  return count;
+}
+
+
+/**
+ * Store a block in the results of a search.
+ *
+ * @param info the search
+ * @param key key of the block
+ * @param data the block
+ * @param size number of bytes in @a data
+ * @return the stored result, NULL if the search already had this block
+ */
+static struct Result *
+result_store (struct REGEX_INTERNAL_Search *info,
+              const struct GNUNET_HashCode *key,
+              const void *data,
+              size_t size)
+{
+  struct ValueCollector vc;
+  struct Result *copy;
+  unsigned int i;
+
+  memset (&vc, 0, sizeof (vc));
+  collect_values (info->dht_get_results, key, &vc);
+  for (i = 0; i < vc.n_values; i++)
+  {
+    copy = vc.values[i];
+    if ( (copy->size == size) &&
+         (0 == memcmp (copy->data, data, size)) )
+    {
+      GNUNET_free (vc.values);
+      return NULL;
+    }
+  }
+  GNUNET_free_non_null (vc.values);
+  copy = GNUNET_malloc (sizeof (struct Result) + size);
+  copy->size = size;
+  copy->data = &copy[1];
+  memcpy (&copy[1], data, size);
+  GNUNET_break (GNUNET_OK ==
+		GNUNET_CONTAINER_multihashmap_put (info->dht_get_results,
+						   key, copy,
+						   GNUNET_CONTAINER_MULTIHASHMAPOPTION_MULTIPLE));
+  return copy;
+}
 
 
 /**
  * Function to process DHT string to regex matching.
  * Called on each result obtained for the DHT search.
  *
- * @param cls Closure (search context).
+ * @param cls Closure (search handle).
  * @param exp When will this value expire.
  * @param key Key of the result.
  * @param get_path Path of the get request.
@@ -372,8 +804,7 @@ dht_get_string_accept_handler (void *cls, struct GNUNET_TIME_Absolute exp,
                                size_t size, const void *data)
 {
   const struct RegexAcceptBlock *block = data;
-  struct RegexSearchContext *ctx = cls;
-  struct REGEX_INTERNAL_Search *info = ctx->info;
+  struct REGEX_INTERNAL_Search *info = cls;
 
   LOG (GNUNET_ERROR_TYPE_DEBUG,
        "Regex result accept for %s (key %s)\n",
@@ -392,35 +823,259 @@ dht_get_string_accept_handler (void *cls, struct GNUNET_TIME_Absolute exp,
 }
 
 
+/**
+ * Stop a search branch: its DHT GET and its further processing.
+ *
+ * @param ctx the branch
+ */
+static void
+regex_branch_cancel (struct RegexSearchContext *ctx)
+{
+  if ( (GNUNET_YES == ctx->cancelled) ||
+       (GNUNET_YES == ctx->found) )
+    return;
+  ctx->cancelled = GNUNET_YES;
+  if (NULL != ctx->get_h)
+  {
+    GNUNET_DHT_get_stop (ctx->get_h);
+    ctx->get_h = NULL;
+  }
+  GNUNET_STATISTICS_update (ctx->info->stats, "# regex branches cancelled",
+                            1, GNUNET_NO);
+}
+
+
+/**
+ * A branch reached an accepting state.  Stop the branches this path
+ * makes redundant: those that left a block on the path along another
+ * edge, i.e. that follow the same automaton with a different
+ * compression stride, and everything started from them.  Branches
+ * that came from other blocks keep looking for other peers.
+ *
+ * @param info the search
+ * @param found branch that reached the accepting state
+ */
+static void
+regex_cancel_branches (struct REGEX_INTERNAL_Search *info,
+                       struct RegexSearchContext *found)
+{
+  struct RegexSearchContext *path;
+  struct RegexSearchContext *ctx;
+  unsigned int i;
+
+  for (path = found; NULL != path; path = path->parent)
+  {
+    path->found = GNUNET_YES;
+    if (NULL != path->parent)
+      path->parent->found_via = path->parent_block;
+  }
+  for (path = found; NULL != path->parent; path = path->parent)
+  {
+    for (i = 0; i < info->n_contexts; i++)
+    {
+      ctx = info->contexts[i];
+      if ( (ctx->parent == path->parent) &&
+           (ctx->parent_block == path->parent_block) )
+        regex_branch_cancel (ctx);
+    }
+  }
+  /* branches are stored after their parents */
+  for (i = 0; i < info->n_contexts; i++)
+  {
+    ctx = info->contexts[i];
+    if ( (NULL != ctx->parent) &&
+         (GNUNET_YES == ctx->parent->cancelled) )
+      regex_branch_cancel (ctx);
+  }
+}
+
+
 /**
  * Find a path to a peer that offers a regex servcie compatible
  * with a given string.
  *
- * @param key The key of the accepting state.
- * @param ctx Context containing info about the string, tunnel, etc.
+ * @param ctx The branch that reached the accepting state.
  */
 static void
-regex_find_path (const struct GNUNET_HashCode *key,
-                 struct RegexSearchContext *ctx)
+regex_find_path (struct RegexSearchContext *ctx)
 {
+  struct REGEX_INTERNAL_Search *info = ctx->info;
+  const struct GNUNET_HashCode *key = &ctx->key;
   struct GNUNET_DHT_GetHandle *get_h;
 
+  regex_cancel_branches (info, ctx);
+  if (GNUNET_YES ==
+      GNUNET_CONTAINER_multihashmap_contains (info->accept_get_handles, key))
+    return;
   LOG (GNUNET_ERROR_TYPE_DEBUG,
        "regex finds path for %s\n",
        GNUNET_h2s (key));
-  get_h = GNUNET_DHT_get_start (ctx->info->dht,    /* handle */
+  get_h = GNUNET_DHT_get_start (info->dht,    /* handle */
                                 GNUNET_BLOCK_TYPE_REGEX_ACCEPT, /* type */
                                 key,     /* key to search */
                                 DHT_REPLICATION, /* replication level */
                                 DHT_OPT | GNUNET_DHT_RO_RECORD_ROUTE,
                                 NULL,       /* xquery */ // FIXME BLOOMFILTER
                                 0,     /* xquery bits */ // FIXME BLOOMFILTER SIZE
-                                &dht_get_string_accept_handler, ctx);
+                                &dht_get_string_accept_handler, info);
   GNUNET_break (GNUNET_OK ==
-                GNUNET_CONTAINER_multihashmap_put(ctx->info->dht_get_handles,
+                GNUNET_CONTAINER_multihashmap_put(info->accept_get_handles,
                                                   key,
                                                   get_h,
-                                                  GNUNET_CONTAINER_MULTIHASHMAPOPTION_MULTIPLE));
+                                                  GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_FAST));
+}
+
+
+/**
+ * Iterator over edges in a regex block retrieved from the DHT.
+ *
+ * @param cls Closure (`struct EdgeCollector`).
+ * @param token Token that follows to next state.
+ * @param len Lenght of token.
+ * @param key Hash of next state.
+ *
+ * @return GNUNET_YES if should keep iterating, GNUNET_NO otherwise.
+ */
+static int
+regex_edge_iterator (void *cls,
+                     const char *token,
+                     size_t len,
+                     const struct GNUNET_HashCode *key)
+{
+  struct EdgeCollector *ec = cls;
+  struct REGEX_INTERNAL_Search *info = ec->info;
+  struct SearchEdge edge;
+  const char *current;
+  size_t current_len;
+
+  GNUNET_STATISTICS_update (info->stats, "# regex edges iterated",
+                            1, GNUNET_NO);
+  current = &info->description[ec->position];
+  current_len = strlen (info->description) - ec->position;
+  if ( (0 == len) || (len > current_len) )
+  {
+    LOG (GNUNET_ERROR_TYPE_DEBUG, "Token too long, END\n");
+    return GNUNET_YES;
+  }
+  if (0 != strncmp (current, token, len))
+  {
+    LOG (GNUNET_ERROR_TYPE_DEBUG, "Token doesn't match, END\n");
+    return GNUNET_YES;
+  }
+  LOG (GNUNET_ERROR_TYPE_DEBUG, "Token matches, KEEP\n");
+  edge.key = *key;
+  edge.len = len;
+  GNUNET_array_append (ec->edges, ec->n_edges, edge);
+  return GNUNET_YES;
+}
+
+
+/**
+ * Order edges by decreasing token length.
+ *
+ * @param a first `struct SearchEdge`
+ * @param b second `struct SearchEdge`
+ * @return -1, 0 or 1 as for qsort
+ */
+static int
+edge_compare (const void *a,
+              const void *b)
+{
+  const struct SearchEdge *ea = a;
+  const struct SearchEdge *eb = b;
+
+  if (ea->len > eb->len)
+    return -1;
+  if (ea->len < eb->len)
+    return 1;
+  return 0;
+}
+
+
+/**
+ * Continue a search branch with a block of its state: look for the
+ * accepting state if the string is consumed, otherwise follow all
+ * edges matching the rest of the string, the longest first.
+ *
+ * @param ctx the branch
+ * @param result block of the state the branch was looking for
+ */
+static void
+regex_process_block (struct RegexSearchContext *ctx,
+                     const struct Result *result)
+{
+  struct REGEX_INTERNAL_Search *info = ctx->info;
+  const struct RegexBlock *block = result->data;
+  struct EdgeCollector ec;
+  unsigned int i;
+
+  if (GNUNET_YES == ctx->cancelled)
+    return;
+  GNUNET_STATISTICS_update (info->stats, "# regex blocks processed",
+                            1, GNUNET_NO);
+  if (strlen (info->description) == ctx->position) // String processed
+  {
+    if (GNUNET_YES == GNUNET_BLOCK_is_accepting (block, result->size))
+    {
+      regex_find_path (ctx);
+    }
+    else
+    {
+      LOG (GNUNET_ERROR_TYPE_INFO, "block not accepting!\n");
+      /* FIXME REGEX this block not successful, wait for more? start timeout? */
+    }
+    return;
+  }
+  memset (&ec, 0, sizeof (ec));
+  ec.info = info;
+  ec.position = ctx->position;
+  GNUNET_break (GNUNET_OK ==
+                REGEX_BLOCK_iterate (block, result->size,
+                                     &regex_edge_iterator, &ec));
+  if (0 == ec.n_edges)
+  {
+    LOG (GNUNET_ERROR_TYPE_DEBUG,
+	 "no match in block\n");
+    return;
+  }
+  qsort (ec.edges, ec.n_edges, sizeof (struct SearchEdge), &edge_compare);
+  for (i = 0; i < ec.n_edges; i++)
+  {
+    if ( (0 < i) &&
+         (MAX_SEARCH_BRANCHES <= info->n_contexts) )
+      break;
+    /* the other edges are redundant once one of them led to an
+       accepting state */
+    if ( (result == ctx->found_via) ||
+         (GNUNET_YES == ctx->cancelled) )
+      break;
+    regex_branch_start (info, ctx, result, &ec.edges[i].key,
+                        ctx->position + ec.edges[i].len);
+  }
+  GNUNET_free (ec.edges);
+}
+
+
+/**
+ * Process a new block for all branches looking for its key.
+ *
+ * @param info the search
+ * @param key key of the block
+ * @param result the block
+ */
+static void
+regex_process_result (struct REGEX_INTERNAL_Search *info,
+                      const struct GNUNET_HashCode *key,
+                      const struct Result *result)
+{
+  struct ValueCollector vc;
+  unsigned int i;
+
+  memset (&vc, 0, sizeof (vc));
+  collect_values (info->branches, key, &vc);
+  for (i = 0; i < vc.n_values; i++)
+    regex_process_block (vc.values[i], result);
+  GNUNET_free_non_null (vc.values);
 }
 
 
@@ -451,213 +1106,173 @@ dht_get_string_handler (void *cls, struct GNUNET_TIME_Absolute exp,
                         enum GNUNET_BLOCK_Type type,
                         size_t size, const void *data)
 {
-  const struct RegexBlock *block = data;
   struct RegexSearchContext *ctx = cls;
   struct REGEX_INTERNAL_Search *info = ctx->info;
-  size_t len;
-  struct Result *copy;
+  struct Result *result;
 
   LOG (GNUNET_ERROR_TYPE_INFO,
        "DHT GET result for %s (%s)\n",
        GNUNET_h2s (key), ctx->info->description);
-  copy = GNUNET_malloc (sizeof (struct Result) + size);
-  copy->size = size;
-  copy->data = &copy[1];
-  memcpy (&copy[1], block, size);
-  GNUNET_break (GNUNET_OK ==
-		GNUNET_CONTAINER_multihashmap_put (info->dht_get_results,
-						   key, copy,
-						   GNUNET_CONTAINER_MULTIHASHMAPOPTION_MULTIPLE));
-  len = strlen (info->description);
-  if (len == ctx->position) // String processed
-  {
-    if (GNUNET_YES == GNUNET_BLOCK_is_accepting (block, size))
-    {
-      regex_find_path (key, ctx);
-    }
-    else
-    {
-      LOG (GNUNET_ERROR_TYPE_INFO, "block not accepting!\n");
-      /* FIXME REGEX this block not successful, wait for more? start timeout? */
-    }
-    return;
-  }
-  regex_next_edge (block, size, ctx);
+  if (NULL != info->cache)
+    REGEX_INTERNAL_block_cache_put (info->cache, key, exp, data, size);
+  result = result_store (info, key, data, size);
+  if (NULL == result)
+    return; /* another branch already got this block */
+  regex_process_result (info, key, result);
 }
 
 
 /**
- * Iterator over found existing cadet regex blocks that match an ongoing search.
- *
- * @param cls Closure (current context)-
- * @param key Current key code (key for cached block).
- * @param value Value in the hash map (cached RegexBlock).
- * @return GNUNET_YES: we should always continue to iterate.
+ * Closure for #cache_block_store.
  */
-static int
-regex_result_iterator (void *cls,
-                       const struct GNUNET_HashCode * key,
-                       void *value)
+struct CacheSeed
 {
-  struct Result *result = value;
-  const struct RegexBlock *block = result->data;
-  struct RegexSearchContext *ctx = cls;
-
-  if ( (GNUNET_YES ==
-	GNUNET_BLOCK_is_accepting (block, result->size)) &&
-       (ctx->position == strlen (ctx->info->description)) )
-  {
-    LOG (GNUNET_ERROR_TYPE_INFO,
-	 "Found accepting known block\n");
-    regex_find_path (key, ctx);
-    return GNUNET_YES; // We found an accept state!
-  }
-  LOG (GNUNET_ERROR_TYPE_DEBUG,
-       "* %u, %u, [%u]\n",
-       ctx->position,
-       strlen (ctx->info->description),
-       GNUNET_BLOCK_is_accepting (block, result->size));
-  regex_next_edge (block, result->size, ctx);
+  /**
+   * The search.
+   */
+  struct REGEX_INTERNAL_Search *info;
 
-  GNUNET_STATISTICS_update (ctx->info->stats, "# regex cadet blocks iterated",
-                            1, GNUNET_NO);
+  /**
+   * Blocks from the cache the search did not have yet.
+   */
+  struct Result **fresh;
 
-  return GNUNET_YES;
-}
+  /**
+   * Number of entries in @e fresh.
+   */
+  unsigned int n_fresh;
+};
 
 
 /**
- * Iterator over edges in a regex block retrieved from the DHT.
+ * Add a block from the cache to the results of a search.
  *
- * @param cls Closure (context of the search).
- * @param token Token that follows to next state.
- * @param len Lenght of token.
- * @param key Hash of next state.
- *
- * @return GNUNET_YES if should keep iterating, GNUNET_NO otherwise.
+ * @param cls the `struct CacheSeed`
+ * @param key key of the block
+ * @param data the block
+ * @param size number of bytes in @a data
  */
-static int
-regex_edge_iterator (void *cls,
-                     const char *token,
-                     size_t len,
-                     const struct GNUNET_HashCode *key)
+static void
+cache_block_store (void *cls,
+                   const struct GNUNET_HashCode *key,
+                   const void *data,
+                   size_t size)
 {
-  struct RegexSearchContext *ctx = cls;
-  struct REGEX_INTERNAL_Search *info = ctx->info;
-  const char *current;
-  size_t current_len;
+  struct CacheSeed *seed = cls;
+  struct Result *result;
 
-  GNUNET_STATISTICS_update (info->stats, "# regex edges iterated",
+  result = result_store (seed->info, key, data, size);
+  if (NULL == result)
+    return;
+  GNUNET_STATISTICS_update (seed->info->stats, "# regex blocks from cache",
                             1, GNUNET_NO);
-  current = &info->description[ctx->position];
-  current_len = strlen (info->description) - ctx->position;
-  if (len > current_len)
-  {
-    LOG (GNUNET_ERROR_TYPE_DEBUG, "Token too long, END\n");
-    return GNUNET_YES;
-  }
-  if (0 != strncmp (current, token, len))
-  {
-    LOG (GNUNET_ERROR_TYPE_DEBUG, "Token doesn't match, END\n");
-    return GNUNET_YES;
-  }
+  GNUNET_array_append (seed->fresh, seed->n_fresh, result);
+}
 
-  if (len > ctx->longest_match)
-  {
-    LOG (GNUNET_ERROR_TYPE_DEBUG, "Token is longer, KEEP\n");
-    ctx->longest_match = len;
-    ctx->hash = *key;
-  }
-  else
-  {
-    LOG (GNUNET_ERROR_TYPE_DEBUG, "Token is not longer, IGNORE\n");
-  }
 
-  LOG (GNUNET_ERROR_TYPE_DEBUG, "*    End of regex edge iterator\n");
-  return GNUNET_YES;
+/**
+ * Add the blocks of a state found in the cache to the results of a
+ * search and process them.
+ *
+ * @param info the search
+ * @param key key of the state
+ */
+static void
+regex_seed_from_cache (struct REGEX_INTERNAL_Search *info,
+                       const struct GNUNET_HashCode *key)
+{
+  struct CacheSeed seed;
+  unsigned int i;
+
+  memset (&seed, 0, sizeof (seed));
+  seed.info = info;
+  (void) REGEX_INTERNAL_block_cache_get (info->cache, key,
+                                         &cache_block_store, &seed);
+  /* only process once the cache is no longer used, processing
+     may start branches that look into the cache again */
+  for (i = 0; i < seed.n_fresh; i++)
+    regex_process_result (info, key, seed.fresh[i]);
+  GNUNET_free_non_null (seed.fresh);
 }
 
 
 /**
- * Jump to the next edge, with the longest matching token.
+ * Start a search branch for a state, unless there is one already.
  *
- * @param block Block found in the DHT.
- * @param size Size of the block.
- * @param ctx Context of the search.
+ * @param info the search
+ * @param parent branch whose block had the edge to the state,
+ *        NULL for the initial state
+ * @param parent_block the block of @a parent with the edge
+ * @param key key of the state
+ * @param position part of the description consumed when reaching the state
  */
 static void
-regex_next_edge (const struct RegexBlock *block,
-                 size_t size,
-                 struct RegexSearchContext *ctx)
+regex_branch_start (struct REGEX_INTERNAL_Search *info,
+                    struct RegexSearchContext *parent,
+                    const struct Result *parent_block,
+                    const struct GNUNET_HashCode *key,
+                    size_t position)
 {
-  struct RegexSearchContext *new_ctx;
-  struct REGEX_INTERNAL_Search *info = ctx->info;
-  struct GNUNET_DHT_GetHandle *get_h;
-  struct GNUNET_HashCode *hash;
+  struct RegexSearchContext *ctx;
+  struct ValueCollector vc;
   const char *rest;
-  int result;
-
-  LOG (GNUNET_ERROR_TYPE_DEBUG, "Next edge\n");
-  /* Find the longest match for the current string position,
-   * among tokens in the given block */
-  ctx->longest_match = 0;
-  result = REGEX_BLOCK_iterate (block, size,
-                                &regex_edge_iterator, ctx);
-  GNUNET_break (GNUNET_OK == result);
-
-  /* Did anything match? */
-  if (0 == ctx->longest_match)
+  unsigned int i;
+
+  memset (&vc, 0, sizeof (vc));
+  collect_values (info->branches, key, &vc);
+  for (i = 0; i < vc.n_values; i++)
   {
-    LOG (GNUNET_ERROR_TYPE_DEBUG,
-	 "no match in block\n");
-    return;
+    ctx = vc.values[i];
+    if (ctx->position == position)
+    {
+      GNUNET_free (vc.values);
+      return; /* We are already looking for it */
+    }
   }
+  GNUNET_free_non_null (vc.values);
 
-  hash = &ctx->hash;
-  new_ctx = GNUNET_new (struct RegexSearchContext);
-  new_ctx->info = info;
-  new_ctx->position = ctx->position + ctx->longest_match;
-  GNUNET_array_append (info->contexts, info->n_contexts, new_ctx);
+  ctx = GNUNET_new (struct RegexSearchContext);
+  ctx->info = info;
+  ctx->key = *key;
+  ctx->position = position;
+  ctx->parent = parent;
+  ctx->parent_block = parent_block;
+  GNUNET_array_append (info->contexts, info->n_contexts, ctx);
+  GNUNET_break (GNUNET_OK ==
+                GNUNET_CONTAINER_multihashmap_put (info->branches,
+                                                   key, ctx,
+                                                   GNUNET_CONTAINER_MULTIHASHMAPOPTION_MULTIPLE));
+  GNUNET_STATISTICS_update (info->stats, "# regex branches started",
+                            1, GNUNET_NO);
 
-  /* Check whether we already have a DHT GET running for it */
-  if (GNUNET_YES ==
-      GNUNET_CONTAINER_multihashmap_contains (info->dht_get_handles, hash))
-  {
-    LOG (GNUNET_ERROR_TYPE_DEBUG,
-	 "GET for %s running, END\n",
-         GNUNET_h2s (hash));
-    GNUNET_CONTAINER_multihashmap_get_multiple (info->dht_get_results,
-                                                hash,
-                                                &regex_result_iterator,
-                                                new_ctx);
-    return; /* We are already looking for it */
-  }
+  /* Other branches may already have found blocks for this state */
+  memset (&vc, 0, sizeof (vc));
+  collect_values (info->dht_get_results, key, &vc);
+  for (i = 0; i < vc.n_values; i++)
+    regex_process_block (ctx, vc.values[i]);
+  GNUNET_free_non_null (vc.values);
+  if (NULL != info->cache)
+    regex_seed_from_cache (info, key);
+  if (GNUNET_YES == ctx->cancelled)
+    return;
 
   GNUNET_STATISTICS_update (info->stats, "# regex nodes traversed",
                             1, GNUNET_NO);
-
   LOG (GNUNET_ERROR_TYPE_INFO,
        "looking for %s\n",
-       GNUNET_h2s (hash));
-  rest = &new_ctx->info->description[new_ctx->position];
-  get_h =
+       GNUNET_h2s (key));
+  rest = &info->description[position];
+  ctx->get_h =
       GNUNET_DHT_get_start (info->dht,    /* handle */
                             GNUNET_BLOCK_TYPE_REGEX, /* type */
-                            hash,     /* key to search */
+                            key,     /* key to search */
                             DHT_REPLICATION, /* replication level */
                             DHT_OPT,
                             rest, /* xquery */
+                            // FIXME add BLOOMFILTER to exclude filtered peers
                             strlen (rest) + 1,     /* xquery bits */
-                            &dht_get_string_handler, new_ctx);
-  if (GNUNET_OK !=
-      GNUNET_CONTAINER_multihashmap_put(info->dht_get_handles,
-                                        hash,
-                                        get_h,
-                                        GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_FAST))
-  {
-    GNUNET_break (0);
-    return;
-  }
+                            // FIXME add BLOOMFILTER SIZE
+                            &dht_get_string_handler, ctx);
 }
 
 
@@ -666,11 +1281,19 @@ regex_next_edge (const struct RegexBlock *block,
  * The search runs until REGEX_INTERNAL_search_cancel is called, even if results
  * are returned.
  *
+ * Blocks are followed along all edges matching the rest of the string
+ * (up to #MAX_SEARCH_BRANCHES), so that states compressed with
+ * different strides are looked up in parallel.  Once a branch reaches
+ * an accepting state, the branches following the same blocks with a
+ * different stride are stopped; the others keep looking for more
+ * peers.
+ *
  * @param dht An existing and valid DHT service handle.
  * @param string String to match against the regexes in the DHT.
  * @param callback Callback for found peers.
  * @param callback_cls Closure for @c callback.
  * @param stats Optional statistics handle to report usage. Can be NULL.
+ * @param cache Optional block cache to use and fill. Can be NULL.
  *
  * @return Handle to stop search and free resources.
  *         Must be freed by calling REGEX_INTERNAL_search_cancel.
@@ -680,11 +1303,10 @@ REGEX_INTERNAL_search (struct GNUNET_DHT_Handle *dht,
                      const char *string,
                      REGEX_INTERNAL_Found callback,
                      void *callback_cls,
-                     struct GNUNET_STATISTICS_Handle *stats)
+                     struct GNUNET_STATISTICS_Handle *stats,
+                     struct REGEX_INTERNAL_BlockCache *cache)
 {
   struct REGEX_INTERNAL_Search *h;
-  struct GNUNET_DHT_GetHandle *get_h;
-  struct RegexSearchContext *ctx;
   struct GNUNET_HashCode key;
   size_t size;
   size_t len;
@@ -699,8 +1321,10 @@ REGEX_INTERNAL_search (struct GNUNET_DHT_Handle *dht,
   h->callback = callback;
   h->callback_cls = callback_cls;
   h->stats = stats;
-  h->dht_get_handles = GNUNET_CONTAINER_multihashmap_create (32, GNUNET_NO);
+  h->cache = cache;
+  h->accept_get_handles = GNUNET_CONTAINER_multihashmap_create (4, GNUNET_NO);
   h->dht_get_results = GNUNET_CONTAINER_multihashmap_create (32, GNUNET_NO);
+  h->branches = GNUNET_CONTAINER_multihashmap_create (32, GNUNET_NO);
 
   /* Initialize context */
   len = strlen (string);
@@ -708,34 +1332,13 @@ REGEX_INTERNAL_search (struct GNUNET_DHT_Handle *dht,
   LOG (GNUNET_ERROR_TYPE_INFO,
        "  initial key for %s: %s (%.*s)\n",
        string, GNUNET_h2s (&key), size, string);
-  ctx = GNUNET_new (struct RegexSearchContext);
-  ctx->position = size;
-  ctx->info = h;
-  GNUNET_array_append (h->contexts, h->n_contexts, ctx);
   LOG (GNUNET_ERROR_TYPE_DEBUG,
        "consumed %u bits out of %u, now looking for %s\n",
        size, len,
        GNUNET_h2s (&key));
 
   /* Start search in DHT */
-  get_h = GNUNET_DHT_get_start (h->dht,    /* handle */
-                                GNUNET_BLOCK_TYPE_REGEX, /* type */
-                                &key,     /* key to search */
-                                DHT_REPLICATION, /* replication level */
-                                DHT_OPT,
-                                &h->description[size],           /* xquery */
-                                // FIXME add BLOOMFILTER to exclude filtered peers
-                                len + 1 - size,                /* xquery bits */
-                                // FIXME add BLOOMFILTER SIZE
-                                &dht_get_string_handler, ctx);
-  GNUNET_break (
-    GNUNET_OK ==
-    GNUNET_CONTAINER_multihashmap_put (h->dht_get_handles,
-                                       &key,
-                                       get_h,
-                                       GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_FAST)
-               );
-
+  regex_branch_start (h, NULL, NULL, &key, size);
   return h;
 }
 
@@ -793,16 +1396,21 @@ REGEX_INTERNAL_search_cancel (struct REGEX_INTERNAL_Search *h)
   unsigned int i;
 
   GNUNET_free (h->description);
-  GNUNET_CONTAINER_multihashmap_iterate (h->dht_get_handles,
+  GNUNET_CONTAINER_multihashmap_iterate (h->accept_get_handles,
                                          &regex_cancel_dht_get, NULL);
   GNUNET_CONTAINER_multihashmap_iterate (h->dht_get_results,
                                          &regex_free_result, NULL);
   GNUNET_CONTAINER_multihashmap_destroy (h->dht_get_results);
-  GNUNET_CONTAINER_multihashmap_destroy (h->dht_get_handles);
+  GNUNET_CONTAINER_multihashmap_destroy (h->accept_get_handles);
+  GNUNET_CONTAINER_multihashmap_destroy (h->branches);
   if (0 < h->n_contexts)
   {
     for (i = 0; i < h->n_contexts; i++)
+    {
+      if (NULL != h->contexts[i]->get_h)
+        GNUNET_DHT_get_stop (h->contexts[i]->get_h);
       GNUNET_free (h->contexts[i]);
+    }
     GNUNET_free (h->contexts);
   }
   GNUNET_free (h);
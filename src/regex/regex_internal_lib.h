@@ -91,6 +91,48 @@ REGEX_INTERNAL_eval (struct REGEX_INTERNAL_Automaton *a,
                    const char *string);
 
 
+/**
+ * Table-driven form of a DFA, for matching many strings quickly.
+ */
+struct REGEX_INTERNAL_CompiledDfa;
+
+
+/**
+ * Compile the given DFA into a table-driven matcher.  The matcher does not
+ * reference 'a' and remains valid after 'a' was destroyed.
+ *
+ * @param a automaton, type must be DFA.
+ *
+ * @return compiled DFA, NULL on error. Needs to be freed using
+ *         REGEX_INTERNAL_compiled_dfa_destroy.
+ */
+struct REGEX_INTERNAL_CompiledDfa *
+REGEX_INTERNAL_dfa_compile (struct REGEX_INTERNAL_Automaton *a);
+
+
+/**
+ * Evaluates the given 'string' against the given compiled DFA. Gives the
+ * same result as REGEX_INTERNAL_eval on the DFA it was compiled from.
+ *
+ * @param c compiled DFA.
+ * @param string string to check.
+ *
+ * @return 0 if string matches, non 0 otherwise.
+ */
+int
+REGEX_INTERNAL_compiled_eval (const struct REGEX_INTERNAL_CompiledDfa *c,
+                              const char *string);
+
+
+/**
+ * Free the memory used by a compiled DFA.
+ *
+ * @param c compiled DFA to be destroyed.
+ */
+void
+REGEX_INTERNAL_compiled_dfa_destroy (struct REGEX_INTERNAL_CompiledDfa *c);
+
+
 /**
  * Get the first key for the given 'input_string'. This hashes
  * the first x bits of the 'input_string'.
@@ -166,6 +208,11 @@ struct REGEX_INTERNAL_Announcement;
  */
 struct REGEX_INTERNAL_Search;
 
+/**
+ * Cache of regex blocks fetched from the DHT, shared between searches.
+ */
+struct REGEX_INTERNAL_BlockCache;
+
 
 /**
  * Announce a regular expression: put all states of the automaton in the DHT.
@@ -226,6 +273,78 @@ typedef void (*REGEX_INTERNAL_Found)(void *cls,
                                    unsigned int put_path_length);
 
 
+/**
+ * Create a cache for regex blocks found in the DHT.  Searches using
+ * the cache start from the blocks other searches already fetched
+ * instead of waiting for the DHT.
+ *
+ * @param max_blocks maximum number of blocks to keep, the least
+ *        recently used ones are dropped first
+ * @return the cache, free with REGEX_INTERNAL_block_cache_destroy
+ */
+struct REGEX_INTERNAL_BlockCache *
+REGEX_INTERNAL_block_cache_create (unsigned int max_blocks);
+
+
+/**
+ * Destroy a block cache.  All searches using it must have been
+ * cancelled before.
+ *
+ * @param cache cache to destroy
+ */
+void
+REGEX_INTERNAL_block_cache_destroy (struct REGEX_INTERNAL_BlockCache *cache);
+
+
+/**
+ * Add a block found in the DHT to a cache.  Blocks already in the
+ * cache only get their expiration time updated.
+ *
+ * @param cache the cache
+ * @param key key of the block
+ * @param expiration when does the block expire
+ * @param data the block
+ * @param size number of bytes in @a data
+ */
+void
+REGEX_INTERNAL_block_cache_put (struct REGEX_INTERNAL_BlockCache *cache,
+                                const struct GNUNET_HashCode *key,
+                                struct GNUNET_TIME_Absolute expiration,
+                                const void *data,
+                                size_t size);
+
+
+/**
+ * Function called on a block in a cache.
+ *
+ * @param cls closure
+ * @param key key of the block
+ * @param data the block
+ * @param size number of bytes in @a data
+ */
+typedef void (*REGEX_INTERNAL_BlockCacheIterator)(void *cls,
+                                                  const struct GNUNET_HashCode *key,
+                                                  const void *data,
+                                                  size_t size);
+
+
+/**
+ * Get the blocks stored in a cache under a key.  Expired blocks are
+ * dropped, the others become the most recently used ones.
+ *
+ * @param cache the cache
+ * @param key key to look for
+ * @param it function to call on each block, must not modify the cache
+ * @param it_cls closure for @a it
+ * @return number of blocks passed to @a it
+ */
+unsigned int
+REGEX_INTERNAL_block_cache_get (struct REGEX_INTERNAL_BlockCache *cache,
+                                const struct GNUNET_HashCode *key,
+                                REGEX_INTERNAL_BlockCacheIterator it,
+                                void *it_cls);
+
+
 /**
  * Search for a peer offering a regex matching certain string in the DHT.
  * The search runs until REGEX_INTERNAL_search_cancel is called, even if results
@@ -236,6 +355,7 @@ typedef void (*REGEX_INTERNAL_Found)(void *cls,
  * @param callback Callback for found peers.
  * @param callback_cls Closure for @c callback.
  * @param stats Optional statistics handle to report usage. Can be NULL.
+ * @param cache Optional block cache to use and fill. Can be NULL.
  *
  * @return Handle to stop search and free resources.
  *         Must be freed by calling REGEX_INTERNAL_search_cancel.
@@ -245,7 +365,8 @@ REGEX_INTERNAL_search (struct GNUNET_DHT_Handle *dht,
                      const char *string,
                      REGEX_INTERNAL_Found callback,
                      void *callback_cls,
-                     struct GNUNET_STATISTICS_Handle *stats);
+                     struct GNUNET_STATISTICS_Handle *stats,
+                     struct REGEX_INTERNAL_BlockCache *cache);
 
 /**
  * Stop search and free all data used by a REGEX_INTERNAL_search call.
@@ -0,0 +1,252 @@
+/*
+     This file is part of GNUnet
+     (C) 2014 Christian Grothoff (and other contributing authors)
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+     Boston, MA 02111-1307, USA.
+*/
+/**
+ * @file regex/test_regex_block_cache.c
+ * @brief test for the regex block cache: LRU order, expiration and
+ *        duplicate blocks
+ */
+#include "platform.h"
+#include "gnunet_util_lib.h"
+#include "regex_internal_lib.h"
+
+#define MAX_BLOCKS 4
+
+
+/**
+ * Content of the last block passed by the cache.
+ */
+static char last;
+
+
+/**
+ * Remember the last block passed by the cache.
+ *
+ * @param cls NULL
+ * @param key key of the block (unused)
+ * @param data the block
+ * @param size number of bytes in @a data
+ */
+static void
+remember_block (void *cls,
+                const struct GNUNET_HashCode *key,
+                const void *data,
+                size_t size)
+{
+  GNUNET_assert (1 == size);
+  last = *(const char *) data;
+}
+
+
+/**
+ * Number of blocks in the cache under the key of @a i.
+ *
+ * @param cache the cache
+ * @param i which key
+ * @return number of blocks
+ */
+static unsigned int
+get (struct REGEX_INTERNAL_BlockCache *cache,
+     unsigned int i)
+{
+  struct GNUNET_HashCode key;
+
+  GNUNET_CRYPTO_hash (&i, sizeof (i), &key);
+  return REGEX_INTERNAL_block_cache_get (cache, &key, &remember_block, NULL);
+}
+
+
+/**
+ * Add a one-byte block under the key of @a i.
+ *
+ * @param cache the cache
+ * @param i which key
+ * @param c content of the block
+ * @param expiration when does the block expire
+ */
+static void
+put (struct REGEX_INTERNAL_BlockCache *cache,
+     unsigned int i,
+     char c,
+     struct GNUNET_TIME_Absolute expiration)
+{
+  struct GNUNET_HashCode key;
+
+  GNUNET_CRYPTO_hash (&i, sizeof (i), &key);
+  REGEX_INTERNAL_block_cache_put (cache, &key, expiration, &c, 1);
+}
+
+
+/**
+ * The least recently used block is dropped first; looking a block up
+ * counts as a use.
+ *
+ * @return 0 on success
+ */
+static int
+test_lru ()
+{
+  struct REGEX_INTERNAL_BlockCache *cache;
+  struct GNUNET_TIME_Absolute later;
+  unsigned int i;
+  int ret;
+
+  later = GNUNET_TIME_relative_to_absolute (GNUNET_TIME_UNIT_HOURS);
+  cache = REGEX_INTERNAL_block_cache_create (MAX_BLOCKS);
+  for (i = 0; i < MAX_BLOCKS; i++)
+    put (cache, i, 'a', later);
+  ret = 0;
+  /* 0 becomes the most recently used, so 1 is dropped next */
+  if (1 != get (cache, 0))
+    ret = 1;
+  put (cache, MAX_BLOCKS, 'a', later);
+  if ( (1 != get (cache, 0)) ||
+       (0 != get (cache, 1)) ||
+       (1 != get (cache, 2)) ||
+       (1 != get (cache, MAX_BLOCKS)) )
+    ret = 1;
+  /* 3 is the least recently used one now */
+  put (cache, MAX_BLOCKS + 1, 'a', later);
+  if ( (0 != get (cache, 3)) ||
+       (1 != get (cache, MAX_BLOCKS + 1)) )
+    ret = 1;
+  REGEX_INTERNAL_block_cache_destroy (cache);
+  /* a cache for no blocks keeps nothing */
+  cache = REGEX_INTERNAL_block_cache_create (0);
+  put (cache, 0, 'a', later);
+  if (0 != get (cache, 0))
+    ret = 1;
+  REGEX_INTERNAL_block_cache_destroy (cache);
+  return ret;
+}
+
+
+/**
+ * Expired blocks are not returned and free their slot; adding a
+ * block again extends its expiration.
+ *
+ * @return 0 on success
+ */
+static int
+test_expiration ()
+{
+  struct REGEX_INTERNAL_BlockCache *cache;
+  struct GNUNET_TIME_Absolute past;
+  struct GNUNET_TIME_Absolute later;
+  unsigned int i;
+  int ret;
+
+  past = GNUNET_TIME_absolute_subtract (GNUNET_TIME_absolute_get (),
+                                        GNUNET_TIME_UNIT_HOURS);
+  later = GNUNET_TIME_relative_to_absolute (GNUNET_TIME_UNIT_HOURS);
+  cache = REGEX_INTERNAL_block_cache_create (MAX_BLOCKS);
+  ret = 0;
+  put (cache, 0, 'a', past);
+  if (0 != get (cache, 0))
+    ret = 1;
+  put (cache, 0, 'a', past);
+  put (cache, 0, 'a', later);
+  if (1 != get (cache, 0))
+    ret = 1;
+  /* the expiration is never shortened */
+  put (cache, 0, 'a', past);
+  if (1 != get (cache, 0))
+    ret = 1;
+  /* the expired block was dropped, so all of these fit */
+  put (cache, 1, 'a', past);
+  (void) get (cache, 1);
+  for (i = 2; i < MAX_BLOCKS + 1; i++)
+    put (cache, i, 'a', later);
+  if (1 != get (cache, 0))
+    ret = 1;
+  REGEX_INTERNAL_block_cache_destroy (cache);
+  return ret;
+}
+
+
+/**
+ * The same block found twice is kept once; different blocks under
+ * the same key are all kept.
+ *
+ * @return 0 on success
+ */
+static int
+test_duplicates ()
+{
+  struct REGEX_INTERNAL_BlockCache *cache;
+  struct GNUNET_TIME_Absolute later;
+  unsigned int i;
+  int ret;
+
+  later = GNUNET_TIME_relative_to_absolute (GNUNET_TIME_UNIT_HOURS);
+  cache = REGEX_INTERNAL_block_cache_create (MAX_BLOCKS);
+  ret = 0;
+  for (i = 0; i < 3; i++)
+    put (cache, 0, 'a', later);
+  put (cache, 0, 'b', later);
+  if (2 != get (cache, 0))
+    ret = 1;
+  /* the duplicates did not take any slots */
+  put (cache, 1, 'a', later);
+  put (cache, 2, 'a', later);
+  if ( (2 != get (cache, 0)) ||
+       (1 != get (cache, 1)) ||
+       (1 != get (cache, 2)) )
+    ret = 1;
+  /* a duplicate becomes the most recently used block, so the
+     other block of 0 and then 1 are dropped */
+  put (cache, 0, 'b', later);
+  put (cache, 3, 'a', later);
+  put (cache, 4, 'a', later);
+  if ( (1 != get (cache, 0)) ||
+       ('b' != last) ||
+       (0 != get (cache, 1)) ||
+       (1 != get (cache, 2)) )
+    ret = 1;
+  REGEX_INTERNAL_block_cache_destroy (cache);
+  return ret;
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  int ret;
+
+  GNUNET_log_setup ("test-regex-block-cache", "WARNING", NULL);
+  ret = 0;
+  if (0 != test_lru ())
+  {
+    FPRINTF (stderr, "%s", "LRU order of the block cache is wrong\n");
+    ret = 1;
+  }
+  if (0 != test_expiration ())
+  {
+    FPRINTF (stderr, "%s", "Expiration in the block cache is wrong\n");
+    ret = 1;
+  }
+  if (0 != test_duplicates ())
+  {
+    FPRINTF (stderr, "%s", "Duplicate blocks in the block cache\n");
+    ret = 1;
+  }
+  return ret;
+}
+
+/* end of test_regex_block_cache.c */
@@ -44,6 +44,32 @@ struct Regex_String_Pair
 };
 
 
+/**
+ * Match 'str' using the compiled form of 'dfa'.
+ *
+ * @param dfa automaton.
+ * @param str string to match.
+ *
+ * @return result of REGEX_INTERNAL_compiled_eval, -1 if compiling failed.
+ */
+static int
+test_compiled (struct REGEX_INTERNAL_Automaton *dfa, const char *str)
+{
+  struct REGEX_INTERNAL_CompiledDfa *c;
+  int eval;
+
+  c = REGEX_INTERNAL_dfa_compile (dfa);
+  if (NULL == c)
+  {
+    GNUNET_log (GNUNET_ERROR_TYPE_ERROR, "Compiling DFA failed\n");
+    return -1;
+  }
+  eval = REGEX_INTERNAL_compiled_eval (c, str);
+  REGEX_INTERNAL_compiled_dfa_destroy (c);
+  return eval;
+}
+
+
 /**
  * Random regex test. Generate a random regex as well as 'str_count' strings to
  * match it against. Will match using GNUNET_REGEX implementation and compare
@@ -101,6 +127,8 @@ test_random (unsigned int rx_length, unsigned int max_str_len,
     }
 
     eval = REGEX_INTERNAL_eval (dfa, matching_str);
+    if (eval != test_compiled (dfa, matching_str))
+      result += 1;
     /* save the canonical regex for later comparison */
     canonical_regex = GNUNET_strdup (REGEX_INTERNAL_get_canonical_regex (dfa));
     REGEX_INTERNAL_automaton_destroy (dfa);
@@ -215,6 +243,14 @@ test_automaton (struct REGEX_INTERNAL_Automaton *a, regex_t * rx,
   {
     eval = REGEX_INTERNAL_eval (a, rxstr->strings[i]);
     eval_check = regexec (rx, rxstr->strings[i], 1, matchptr, 0);
+    if ( (DFA == a->type) &&
+         (eval != test_compiled (a, rxstr->strings[i])) )
+    {
+      GNUNET_log (GNUNET_ERROR_TYPE_ERROR,
+                  "Compiled DFA disagrees for regex %s and string %s\n",
+                  rxstr->regex, rxstr->strings[i]);
+      result = 1;
+    }
 
     /* We only want to match the whole string, because that's what our DFA does,
      * too. */
@@ -350,6 +386,11 @@ main (int argc, char *argv[])
     a = REGEX_INTERNAL_construct_dfa (check_proof, strlen (check_proof), 0);
     check_dfa += test_automaton (a, &rx, &rxstr[i]);
     REGEX_INTERNAL_automaton_destroy (a);
+
+    /* DFA without path compression (single character labels) */
+    a = REGEX_INTERNAL_construct_dfa (rxstr[i].regex, strlen (rxstr[i].regex), 1);
+    check_dfa += test_automaton (a, &rx, &rxstr[i]);
+    REGEX_INTERNAL_automaton_destroy (a);
     if (0 != check_dfa)
       GNUNET_log (GNUNET_ERROR_TYPE_DEBUG, "check_proof: %s\n", check_proof);
     GNUNET_free_non_null (check_proof);
@@ -79,6 +79,64 @@ static const struct GNUNET_CONFIGURATION_Handle *cfg;
  */
 static unsigned long long matching_bits;
 
+/**
+ * Number of threads to search for the proof of work with.
+ */
+static unsigned long long pow_threads;
+
+/**
+ * Search for the proof of work.
+ */
+static struct GNUNET_CRYPTO_PowSearch *pow_search;
+
+/**
+ * Revocation data we are searching the proof of work for.
+ */
+static struct RevocationData *pow_rd;
+
+
+/**
+ * Data needed to perform a revocation.
+ */
+struct RevocationData
+{
+  /**
+   * Public key.
+   */
+  struct GNUNET_CRYPTO_EcdsaPublicKey key;
+
+  /**
+   * Revocation signature data.
+   */
+  struct GNUNET_CRYPTO_EcdsaSignature sig;
+
+  /**
+   * Proof of work (in NBO).
+   */
+  uint64_t pow GNUNET_PACKED;
+};
+
+
+/**
+ * Store the revocation data in the file given with "-f", if any.
+ *
+ * @param rd the revocation data
+ */
+static void
+store_revocation_data (const struct RevocationData *rd)
+{
+  if ( (NULL != filename) &&
+       (sizeof (struct RevocationData) !=
+        GNUNET_DISK_fn_write (filename,
+                              rd,
+                              sizeof (struct RevocationData),
+                              GNUNET_DISK_PERM_USER_READ |
+                              GNUNET_DISK_PERM_USER_WRITE)) )
+    GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_ERROR,
+                              "write",
+                              filename);
+}
+
 
 /**
  * Function run if the user aborts with CTRL-C.
@@ -105,6 +163,14 @@ do_shutdown (void *cls,
     GNUNET_REVOCATION_revoke_cancel (h);
     h = NULL;
   }
+  if (NULL != pow_search)
+  {
+    pow_rd->pow = GNUNET_CRYPTO_pow_search_stop (pow_search);
+    pow_search = NULL;
+    store_revocation_data (pow_rd);
+    GNUNET_free (pow_rd);
+    pow_rd = NULL;
+  }
 }
 
 
@@ -190,28 +256,6 @@ print_revocation_result (void *cls,
 }
 
 
-/**
- * Data needed to perform a revocation.
- */
-struct RevocationData
-{
-  /**
-   * Public key.
-   */
-  struct GNUNET_CRYPTO_EcdsaPublicKey key;
-
-  /**
-   * Revocation signature data.
-   */
-  struct GNUNET_CRYPTO_EcdsaSignature sig;
-
-  /**
-   * Proof of work (in NBO).
-   */
-  uint64_t pow GNUNET_PACKED;
-};
-
-
 /**
  * Perform the revocation.
  */
@@ -228,79 +272,66 @@ perform_revocation (const struct RevocationData *rd)
 
 
 /**
- * Perform the proof-of-work calculation.
+ * Called with the progress of the proof-of-work calculation,
+ * or with the proof once it was found.
  *
  * @param cls the `struct RevocationData`
- * @param tc scheduler context
+ * @param pow the proof, or the value to resume the calculation at
+ * @param hash_rate hashes per second calculated recently
+ * @param found #GNUNET_YES if @a pow is the proof of work
  */
 static void
-calculate_pow (void *cls,
-               const struct GNUNET_SCHEDULER_TaskContext *tc)
+pow_search_cb (void *cls,
+               uint64_t pow,
+               uint64_t hash_rate,
+               int found)
 {
   struct RevocationData *rd = cls;
 
+  rd->pow = pow;
   /* store temporary results */
-  if ( (0 != (GNUNET_SCHEDULER_REASON_SHUTDOWN & tc->reason)) ||
-       (0 == (rd->pow % 128) ) )
+  store_revocation_data (rd);
+  if (GNUNET_YES != found)
   {
-    if ( (NULL != filename) &&
-         (sizeof (struct RevocationData) ==
-          GNUNET_DISK_fn_write (filename,
-                                &rd,
-                                sizeof (rd),
-                                GNUNET_DISK_PERM_USER_READ |
-                                GNUNET_DISK_PERM_USER_WRITE)) )
-      GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_ERROR,
-                                "write",
-                                filename);
-  }
-  /* display progress estimate */
-  if ( (0 == ((1 << matching_bits) / 100 / 50)) ||
-       (0 == (rd->pow % ((1 << matching_bits) / 100 / 50))) )
-    FPRINTF (stderr, "%s", ".");
-  if ( (0 != rd->pow) &&
-       ( (0 == ((1 << matching_bits) / 100)) ||
-         (0 == (rd->pow % ((1 << matching_bits) / 100))) ) )
-    FPRINTF (stderr, " - @ %3u%% (estimate)\n",
-             (unsigned int) (rd->pow * 100) / (1 << matching_bits));
-  if (0 != (GNUNET_SCHEDULER_REASON_SHUTDOWN & tc->reason))
-  {
-    GNUNET_free (rd);
+    /* display progress estimate */
+    FPRINTF (stderr, " - @ %3u%% (estimate), %llu hashes/s\n",
+             (unsigned int) GNUNET_MIN (100,
+                                        pow * 100 / (1LLU << matching_bits)),
+             (unsigned long long) hash_rate);
     return;
   }
-  /* actually do POW calculation */
-  rd->pow++;
-  if (GNUNET_OK ==
-      GNUNET_REVOCATION_check_pow (&rd->key,
-                                   rd->pow,
-                                   (unsigned int) matching_bits))
+  pow_search = NULL;
+  pow_rd = NULL;
+  if (perform)
+    perform_revocation (rd);
+  else
   {
-    if ( (NULL != filename) &&
-         (sizeof (struct RevocationData) !=
-          GNUNET_DISK_fn_write (filename,
-                                rd,
-                                sizeof (struct RevocationData),
-                                GNUNET_DISK_PERM_USER_READ |
-                                GNUNET_DISK_PERM_USER_WRITE)) )
-      GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_ERROR,
-                                "write",
-                                filename);
-    if (perform)
-      perform_revocation (rd);
-    else
-    {
-      FPRINTF (stderr, "%s", "\n");
-      FPRINTF (stderr,
-               _("Revocation certificate for `%s' stored in `%s'\n"),
-               revoke_ego,
-               filename);
-      GNUNET_SCHEDULER_shutdown ();
-    }
-    GNUNET_free (rd);
-    return;
+    FPRINTF (stderr,
+             _("Revocation certificate for `%s' stored in `%s'\n"),
+             revoke_ego,
+             filename);
+    GNUNET_SCHEDULER_shutdown ();
   }
-  GNUNET_SCHEDULER_add_now (&calculate_pow,
-                            rd);
+  GNUNET_free (rd);
+}
+
+
+/**
+ * Start the proof-of-work calculation.
+ *
+ * @param rd revocation data to calculate the proof of work for,
+ *        will be freed once done
+ */
+static void
+start_pow_search (struct RevocationData *rd)
+{
+  pow_rd = rd;
+  pow_search = GNUNET_REVOCATION_pow_search_start (&rd->key,
+                                                   rd->pow,
+                                                   (unsigned int) matching_bits,
+                                                   (unsigned int) pow_threads,
+                                                   &pow_search_cb,
+                                                   rd);
 }
 
 
@@ -373,8 +404,7 @@ ego_callback (void *cls,
   FPRINTF (stderr,
            "%s",
            _("Revocation certificate not ready, calculating proof of work\n"));
-  GNUNET_SCHEDULER_add_now (&calculate_pow,
-                            rd);
+  start_pow_search (rd);
 }
 
 
@@ -432,6 +462,12 @@ run (void *cls,
                                "WORKBITS");
     return;
   }
+  if (GNUNET_OK !=
+      GNUNET_CONFIGURATION_get_value_number (cfg,
+                                             "REVOCATION",
+                                             "WORKTHREADS",
+                                             &pow_threads))
+    pow_threads = 0;
   if (NULL != revoke_ego)
   {
     if ( !perform && (NULL == filename) )
@@ -475,8 +511,7 @@ run (void *cls,
       struct RevocationData *cp = GNUNET_new (struct RevocationData);
 
       *cp = rd;
-      GNUNET_SCHEDULER_add_now (&calculate_pow,
-                                cp);
+      start_pow_search (cp);
       return;
 
     }
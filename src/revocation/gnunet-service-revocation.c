@@ -49,6 +49,14 @@
 #include <gcrypt.h>
 
 
+/**
+ * How many revocations from other peers may be waiting for
+ * verification at most?  Further revocations are dropped; they are
+ * offered again by the next set union with a peer that knows them.
+ */
+#define MAX_PENDING_REVOCATIONS 1024
+
+
 /**
  * Per-peer information.
  */
@@ -78,6 +86,54 @@ struct PeerEntry
 };
 
 
+/**
+ * A revocation whose proof of work and signature are being
+ * verified by the #verify_pool.
+ */
+struct PendingRevocation
+{
+
+  /**
+   * Kept in a DLL.
+   */
+  struct PendingRevocation *next;
+
+  /**
+   * Kept in a DLL.
+   */
+  struct PendingRevocation *prev;
+
+  /**
+   * Job verifying the revocation.
+   */
+  struct GNUNET_CRYPTO_WorkerJob *job;
+
+  /**
+   * Client that asked us to revoke, NULL if we got the
+   * revocation from another peer or if the client disconnected.
+   */
+  struct GNUNET_SERVER_Client *client;
+
+  /**
+   * #GNUNET_YES if a client asked us to revoke (even if it
+   * disconnected since), #GNUNET_NO if we got the revocation
+   * from another peer.
+   */
+  int from_client;
+
+  /**
+   * Hash of the public key in @e rm, key in #pending_map.
+   */
+  struct GNUNET_HashCode hc;
+
+  /**
+   * The revocation.
+   */
+  struct RevokeMessage rm;
+
+};
+
+
 /**
  * Set from all revocations known to us.
  */
@@ -139,6 +195,31 @@ static struct GNUNET_SET_ListenHandle *revocation_union_listen_handle;
  */
 static unsigned long long revocation_work_required;
 
+/**
+ * Threads verifying revocations.
+ */
+static struct GNUNET_CRYPTO_WorkerPool *verify_pool;
+
+/**
+ * Head of revocations being verified.
+ */
+static struct PendingRevocation *pr_head;
+
+/**
+ * Tail of revocations being verified.
+ */
+static struct PendingRevocation *pr_tail;
+
+/**
+ * Revocations being verified, by the hash of their public key.
+ */
+static struct GNUNET_CONTAINER_MultiHashMap *pending_map;
+
+/**
+ * Number of revocations from other peers being verified.
+ */
+static unsigned int pr_p2p_count;
+
 /**
  * Our application ID for set union operations.  Must be the
  * same for all (compatible) peers.
@@ -149,33 +230,29 @@ static struct GNUNET_HashCode revocation_set_union_app_id;
 
 /**
  * An revoke message has been received, check that it is well-formed.
+ * Runs in a thread of the #verify_pool.
  *
- * @param rm the message to verify
+ * @param cls the `struct PendingRevocation` with the message to verify
  * @return #GNUNET_YES if the message is verified
  *         #GNUNET_NO if the key/signature don't verify
  */
 static int
-verify_revoke_message (const struct RevokeMessage *rm)
+verify_revoke_message (void *cls)
 {
+  const struct PendingRevocation *pr = cls;
+  const struct RevokeMessage *rm = &pr->rm;
+
   if (GNUNET_YES !=
       GNUNET_REVOCATION_check_pow (&rm->public_key,
 				   rm->proof_of_work,
 				   (unsigned int) revocation_work_required))
-  {
-    GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
-		"Proof of work invalid!\n");
-    GNUNET_break_op (0);
     return GNUNET_NO;
-  }
   if (GNUNET_OK !=
       GNUNET_CRYPTO_ecdsa_verify (GNUNET_SIGNATURE_PURPOSE_REVOCATION,
 				&rm->purpose,
 				&rm->signature,
 				&rm->public_key))
-  {
-    GNUNET_break_op (0);
     return GNUNET_NO;
-  }
   return GNUNET_YES;
 }
 
@@ -248,11 +325,11 @@ do_flood (void *cls,
 /**
  * Publicize revocation message.   Stores the message locally in the
  * database and passes it to all connected neighbours (and adds it to
- * the set for future connections).
+ * the set for future connections).  The message must have been
+ * verified.
  *
  * @param rm message to publicize
- * @return #GNUNET_OK on success, #GNUNET_NO if we encountered an error,
- *         #GNUNET_SYSERR if the message was malformed
+ * @return #GNUNET_OK on success, #GNUNET_NO if we encountered an error
  */
 static int
 publicize_rm (const struct RevokeMessage *rm)
@@ -272,12 +349,6 @@ publicize_rm (const struct RevokeMessage *rm)
                 _("Duplicate revocation received from peer. Ignored.\n"));
     return GNUNET_OK;
   }
-  if (GNUNET_OK !=
-      verify_revoke_message (rm))
-  {
-    GNUNET_break_op (0);
-    return GNUNET_SYSERR;
-  }
   /* write to disk */
   if (sizeof (struct RevokeMessage) !=
       GNUNET_DISK_file_write (revocation_db,
@@ -328,30 +399,17 @@ publicize_rm (const struct RevokeMessage *rm)
 
 
 /**
- * Handle REVOKE message from client.
+ * Tell a client whether the key it asked us to revoke is now revoked.
  *
- * @param cls unused
- * @param client who sent the message
- * @param message the message received
+ * @param client the client
+ * @param ret result of #publicize_rm()
  */
 static void
-handle_revoke_message (void *cls,
-                       struct GNUNET_SERVER_Client *client,
-                       const struct GNUNET_MessageHeader *message)
+send_revoke_response (struct GNUNET_SERVER_Client *client,
+                      int ret)
 {
-  const struct RevokeMessage *rm;
   struct RevocationResponseMessage rrm;
-  int ret;
 
-  GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
-	      "Received REVOKE message from client\n");
-  rm = (const struct RevokeMessage *) message;
-  if (GNUNET_SYSERR == (ret = publicize_rm (rm)))
-  {
-    GNUNET_break_op (0);
-    GNUNET_SERVER_receive_done (client, GNUNET_SYSERR);
-    return;
-  }
   rrm.header.size = htons (sizeof (struct RevocationResponseMessage));
   rrm.header.type = htons (GNUNET_MESSAGE_TYPE_REVOCATION_REVOKE_RESPONSE);
   rrm.is_valid = htonl ((GNUNET_OK == ret) ? GNUNET_NO : GNUNET_YES);
@@ -365,6 +423,180 @@ handle_revoke_message (void *cls,
 }
 
 
+/**
+ * The #verify_pool is done verifying a revocation.  If it is valid,
+ * publicize it.
+ *
+ * @param cls the `struct PendingRevocation`
+ * @param result #GNUNET_YES if the revocation is valid
+ */
+static void
+revocation_verified (void *cls,
+                     int result)
+{
+  struct PendingRevocation *pr = cls;
+  int ret;
+
+  GNUNET_CONTAINER_DLL_remove (pr_head, pr_tail, pr);
+  GNUNET_assert (GNUNET_YES ==
+                 GNUNET_CONTAINER_multihashmap_remove (pending_map,
+                                                       &pr->hc, pr));
+  if (GNUNET_NO == pr->from_client)
+    pr_p2p_count--;
+  if (GNUNET_YES != result)
+  {
+    GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
+		"Proof of work or signature invalid!\n");
+    GNUNET_break_op (0);
+    GNUNET_STATISTICS_update (stats,
+                              "# revocations discarded (invalid proof or signature)",
+                              1, GNUNET_NO);
+    if (NULL != pr->client)
+      GNUNET_SERVER_receive_done (pr->client, GNUNET_SYSERR);
+    GNUNET_free (pr);
+    return;
+  }
+  ret = publicize_rm (&pr->rm);
+  if (NULL != pr->client)
+    send_revoke_response (pr->client, ret);
+  GNUNET_free (pr);
+}
+
+
+/**
+ * Check if a revocation being verified is the same as the given one.
+ *
+ * @param cls the `const struct RevokeMessage` to look for
+ * @param key hash of the public key (unused)
+ * @param value a `struct PendingRevocation`
+ * @return #GNUNET_NO if it is the same (stops the iteration),
+ *         #GNUNET_YES to continue
+ */
+static int
+check_pending (void *cls,
+               const struct GNUNET_HashCode *key,
+               void *value)
+{
+  const struct RevokeMessage *rm = cls;
+  const struct PendingRevocation *pr = value;
+
+  if (0 == memcmp (&pr->rm,
+                   rm,
+                   sizeof (struct RevokeMessage)))
+    return GNUNET_NO;
+  return GNUNET_YES;
+}
+
+
+/**
+ * Verify and then publicize a revocation message.  Revocations
+ * we already know are not verified again.  Revocations from other
+ * peers that are already being verified, or beyond
+ * #MAX_PENDING_REVOCATIONS, are dropped; clients only send their
+ * next revocation once we answered, so they need no limit.
+ *
+ * @param rm the revocation
+ * @param client client that asked us to revoke, NULL if we got
+ *        the revocation from another peer
+ */
+static void
+verify_rm (const struct RevokeMessage *rm,
+           struct GNUNET_SERVER_Client *client)
+{
+  struct PendingRevocation *pr;
+  struct GNUNET_HashCode hc;
+
+  GNUNET_CRYPTO_hash (&rm->public_key,
+                      sizeof (struct GNUNET_CRYPTO_EcdsaPublicKey),
+                      &hc);
+  if (GNUNET_YES ==
+      GNUNET_CONTAINER_multihashmap_contains (revocation_map,
+                                              &hc))
+  {
+    GNUNET_log (GNUNET_ERROR_TYPE_INFO,
+                _("Duplicate revocation received from peer. Ignored.\n"));
+    if (NULL != client)
+      send_revoke_response (client, GNUNET_OK);
+    return;
+  }
+  if (NULL == client)
+  {
+    if (GNUNET_SYSERR ==
+        GNUNET_CONTAINER_multihashmap_get_multiple (pending_map,
+                                                    &hc,
+                                                    &check_pending,
+                                                    (void *) rm))
+    {
+      GNUNET_STATISTICS_update (stats,
+                                "# revocations ignored (already being verified)",
+                                1, GNUNET_NO);
+      return;
+    }
+    if (pr_p2p_count >= MAX_PENDING_REVOCATIONS)
+    {
+      GNUNET_STATISTICS_update (stats,
+                                "# revocations dropped (too many being verified)",
+                                1, GNUNET_NO);
+      return;
+    }
+    pr_p2p_count++;
+  }
+  pr = GNUNET_new (struct PendingRevocation);
+  pr->client = client;
+  pr->from_client = (NULL != client) ? GNUNET_YES : GNUNET_NO;
+  pr->hc = hc;
+  pr->rm = *rm;
+  (void) GNUNET_CONTAINER_multihashmap_put (pending_map,
+                                            &hc, pr,
+                                            GNUNET_CONTAINER_MULTIHASHMAPOPTION_MULTIPLE);
+  GNUNET_CONTAINER_DLL_insert_tail (pr_head, pr_tail, pr);
+  pr->job = GNUNET_CRYPTO_worker_pool_submit (verify_pool,
+                                              &verify_revoke_message, pr,
+                                              &revocation_verified, pr);
+}
+
+
+/**
+ * Handle REVOKE message from client.
+ *
+ * @param cls unused
+ * @param client who sent the message
+ * @param message the message received
+ */
+static void
+handle_revoke_message (void *cls,
+                       struct GNUNET_SERVER_Client *client,
+                       const struct GNUNET_MessageHeader *message)
+{
+  GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
+	      "Received REVOKE message from client\n");
+  verify_rm ((const struct RevokeMessage *) message,
+             client);
+}
+
+
+/**
+ * A client disconnected.  Its revocations that are still being
+ * verified are still publicized if they are valid, we just do not
+ * answer the client anymore.
+ *
+ * @param cls NULL
+ * @param client the client
+ */
+static void
+handle_client_disconnect (void *cls,
+                          struct GNUNET_SERVER_Client *client)
+{
+  struct PendingRevocation *pr;
+
+  if (NULL == client)
+    return;
+  for (pr = pr_head; NULL != pr; pr = pr->next)
+    if (pr->client == client)
+      pr->client = NULL;
+}
+
+
 /**
  * Core handler for flooded revocation messages.
  *
@@ -377,12 +609,10 @@ handle_p2p_revoke_message (void *cls,
 			   const struct GNUNET_PeerIdentity *peer,
 			   const struct GNUNET_MessageHeader *message)
 {
-  const struct RevokeMessage *rm;
-
   GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
 	      "Received REVOKE message from peer\n");
-  rm = (const struct RevokeMessage *) message;
-  GNUNET_break_op (GNUNET_SYSERR != publicize_rm (rm));
+  verify_rm ((const struct RevokeMessage *) message,
+             NULL);
   return GNUNET_OK;
 }
 
@@ -616,6 +846,29 @@ static void
 shutdown_task (void *cls,
 	       const struct GNUNET_SCHEDULER_TaskContext *tc)
 {
+  struct PendingRevocation *pr;
+
+  while (NULL != (pr = pr_head))
+  {
+    GNUNET_CONTAINER_DLL_remove (pr_head, pr_tail, pr);
+    GNUNET_assert (GNUNET_YES ==
+                   GNUNET_CONTAINER_multihashmap_remove (pending_map,
+                                                         &pr->hc, pr));
+    if (GNUNET_NO == pr->from_client)
+      pr_p2p_count--;
+    GNUNET_CRYPTO_worker_job_cancel (pr->job);
+    GNUNET_free (pr);
+  }
+  if (NULL != pending_map)
+  {
+    GNUNET_CONTAINER_multihashmap_destroy (pending_map);
+    pending_map = NULL;
+  }
+  if (NULL != verify_pool)
+  {
+    GNUNET_CRYPTO_worker_pool_destroy (verify_pool);
+    verify_pool = NULL;
+  }
   if (NULL != revocation_set)
   {
     GNUNET_SET_destroy (revocation_set);
@@ -765,6 +1018,7 @@ run (void *cls,
   uint64_t left;
   struct RevokeMessage *rm;
   struct GNUNET_HashCode hc;
+  unsigned long long verify_threads;
 
   if (GNUNET_OK !=
       GNUNET_CONFIGURATION_get_value_filename (c,
@@ -781,6 +1035,7 @@ run (void *cls,
   cfg = c;
   srv = server;
   revocation_map = GNUNET_CONTAINER_multihashmap_create (16, GNUNET_NO);
+  pending_map = GNUNET_CONTAINER_multihashmap_create (16, GNUNET_NO);
   nc = GNUNET_SERVER_notification_context_create (server, 1);
   if (GNUNET_OK !=
       GNUNET_CONFIGURATION_get_value_number (cfg, "REVOCATION", "WORKBITS",
@@ -859,8 +1114,14 @@ run (void *cls,
 
   GNUNET_SCHEDULER_add_delayed (GNUNET_TIME_UNIT_FOREVER_REL, &shutdown_task,
                                 NULL);
+  if (GNUNET_OK !=
+      GNUNET_CONFIGURATION_get_value_number (cfg, "REVOCATION", "VERIFYTHREADS",
+					     &verify_threads))
+    verify_threads = 0;
+  verify_pool = GNUNET_CRYPTO_worker_pool_create ((unsigned int) verify_threads);
   peers = GNUNET_CONTAINER_multipeermap_create (128, GNUNET_NO);
   GNUNET_SERVER_add_handlers (srv, handlers);
+  GNUNET_SERVER_disconnect_notify (srv, &handle_client_disconnect, NULL);
    /* Connect to core service and register core handlers */
   core_api = GNUNET_CORE_connect (cfg,   /* Main configuration */
                                  NULL,       /* Closure passed to functions */
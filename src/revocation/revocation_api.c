@@ -27,7 +27,16 @@
 #include "gnunet_signatures.h"
 #include "gnunet_protocols.h"
 #include "revocation.h"
-#include <gcrypt.h>
+
+/**
+ * Salt for the proof-of-work hash.
+ */
+#define REVOCATION_POW_SALT "gnunet-revocation-proof-of-work"
+
+/**
+ * How often do we report progress while searching for a proof of work?
+ */
+#define REVOCATION_POW_PROGRESS_FREQ GNUNET_TIME_relative_multiply (GNUNET_TIME_UNIT_SECONDS, 5)
 
 
 /**
@@ -386,47 +395,6 @@ GNUNET_REVOCATION_revoke_cancel (struct GNUNET_REVOCATION_Handle *h)
 
 
 
-/**
- * Calculate the 'proof-of-work' hash (an expensive hash).
- *
- * @param buf data to hash
- * @param buf_len number of bytes in @a buf
- * @param result where to write the resulting hash
- */
-static void
-pow_hash (const void *buf,
-	  size_t buf_len,
-	  struct GNUNET_HashCode *result)
-{
-  GNUNET_break (0 ==
-		gcry_kdf_derive (buf, buf_len,
-				 GCRY_KDF_SCRYPT,
-				 1 /* subalgo */,
-				 "gnunet-revocation-proof-of-work",
-				 strlen ("gnunet-revocation-proof-of-work"),
-				 2 /* iterations; keep cost of individual op small */,
-				 sizeof (struct GNUNET_HashCode), result));
-}
-
-
-/**
- * Count the leading zeroes in hash.
- *
- * @param hash to count leading zeros in
- * @return the number of leading zero bits.
- */
-static unsigned int
-count_leading_zeroes (const struct GNUNET_HashCode *hash)
-{
-  unsigned int hash_count;
-
-  hash_count = 0;
-  while ((0 == GNUNET_CRYPTO_hash_get_bit (hash, hash_count)))
-    hash_count++;
-  return hash_count;
-}
-
-
 /**
  * Check if the given proof-of-work value
  * would be acceptable for revoking the given key.
@@ -448,12 +416,45 @@ GNUNET_REVOCATION_check_pow (const struct GNUNET_CRYPTO_EcdsaPublicKey *key,
   memcpy (buf, &pow, sizeof (pow));
   memcpy (&buf[sizeof (pow)], key,
           sizeof (struct GNUNET_CRYPTO_EcdsaPublicKey));
-  pow_hash (buf, sizeof (buf), &result);
-  return (count_leading_zeroes (&result) >=
+  GNUNET_CRYPTO_pow_hash (REVOCATION_POW_SALT,
+                          buf, sizeof (buf), &result);
+  return (GNUNET_CRYPTO_hash_count_leading_zeros (&result) >=
           matching_bits) ? GNUNET_YES : GNUNET_NO;
 }
 
 
+/**
+ * Search for a proof of work for revoking the given key.
+ * Progress is reported every #REVOCATION_POW_PROGRESS_FREQ.
+ *
+ * @param key key to revoke
+ * @param start first proof-of-work value to test
+ * @param matching_bits how many bits must match (configuration)
+ * @param threads number of worker threads, 0 for one per CPU
+ * @param cb function to call with the progress and the result
+ * @param cb_cls closure for @a cb
+ * @return handle to stop the search with #GNUNET_CRYPTO_pow_search_stop()
+ */
+struct GNUNET_CRYPTO_PowSearch *
+GNUNET_REVOCATION_pow_search_start (const struct GNUNET_CRYPTO_EcdsaPublicKey *key,
+                                    uint64_t start,
+                                    unsigned int matching_bits,
+                                    unsigned int threads,
+                                    GNUNET_CRYPTO_PowSearchCallback cb,
+                                    void *cb_cls)
+{
+  return GNUNET_CRYPTO_pow_search_start (REVOCATION_POW_SALT,
+                                         key,
+                                         sizeof (struct GNUNET_CRYPTO_EcdsaPublicKey),
+                                         start,
+                                         matching_bits,
+                                         threads,
+                                         GNUNET_TIME_UNIT_ZERO,
+                                         REVOCATION_POW_PROGRESS_FREQ,
+                                         cb, cb_cls);
+}
+
+
 /**
  * Create a revocation signature.
  *
@@ -63,6 +63,12 @@
  */
 #define IBF_ALPHA 4
 
+/**
+ * Number of keys we collect before inserting them into
+ * an ibf with #ibf_insert_batch().
+ */
+#define IBF_INSERT_BATCH 256
+
 
 /**
  * Current phase we are in for a union operation.
@@ -502,9 +508,32 @@ op_register_element (struct Operation *op, struct ElementEntry *ee)
 
 
 /**
- * Insert a key into an ibf.
+ * Keys waiting to be inserted into an ibf with #ibf_insert_batch().
+ */
+struct IBFBatch
+{
+  /**
+   * The ibf to insert into.
+   */
+  struct InvertibleBloomFilter *ibf;
+
+  /**
+   * Number of valid entries in @e keys.
+   */
+  unsigned int num_keys;
+
+  /**
+   * Keys to insert.
+   */
+  struct IBF_Key keys[IBF_INSERT_BATCH];
+};
+
+
+/**
+ * Insert a key into an ibf.  Keys are collected and inserted in
+ * batches of #IBF_INSERT_BATCH.
  *
- * @param cls the ibf
+ * @param cls the `struct IBFBatch`
  * @param key unused
  * @param value the key entry to get the key from
  */
@@ -513,12 +542,17 @@ prepare_ibf_iterator (void *cls,
                       uint32_t key,
                       void *value)
 {
-  struct InvertibleBloomFilter *ibf = cls;
+  struct IBFBatch *batch = cls;
   struct KeyEntry *ke = value;
 
   GNUNET_log (GNUNET_ERROR_TYPE_DEBUG, "inserting %x into ibf\n", ke->ibf_key.key_val);
 
-  ibf_insert (ibf, ke->ibf_key);
+  batch->keys[batch->num_keys++] = ke->ibf_key;
+  if (IBF_INSERT_BATCH == batch->num_keys)
+  {
+    ibf_insert_batch (batch->ibf, batch->keys, batch->num_keys);
+    batch->num_keys = 0;
+  }
   return GNUNET_YES;
 }
 
@@ -566,6 +600,8 @@ init_key_to_element_iterator (void *cls,
 static void
 prepare_ibf (struct Operation *op, uint16_t size)
 {
+  struct IBFBatch batch;
+
   if (NULL == op->state->key_to_element)
   {
     unsigned int len;
@@ -577,8 +613,11 @@ prepare_ibf (struct Operation *op, uint16_t size)
   if (NULL != op->state->local_ibf)
     ibf_destroy (op->state->local_ibf);
   op->state->local_ibf = ibf_create (size, SE_IBF_HASH_NUM);
+  batch.ibf = op->state->local_ibf;
+  batch.num_keys = 0;
   GNUNET_CONTAINER_multihashmap32_iterate (op->state->key_to_element,
-                                           prepare_ibf_iterator, op->state->local_ibf);
+                                           &prepare_ibf_iterator, &batch);
+  ibf_insert_batch (batch.ibf, batch.keys, batch.num_keys);
 }
 
 
@@ -48,6 +48,12 @@ static struct GNUNET_CONTAINER_MultiHashMap *key_to_hashcode;
 static struct InvertibleBloomFilter *ibf_a;
 static struct InvertibleBloomFilter *ibf_b;
 
+/* keys of the elements in A and B, for batch insertion */
+static struct IBF_Key *keys_a;
+static struct IBF_Key *keys_b;
+static unsigned int num_keys_a;
+static unsigned int num_keys_b;
+
 
 static void
 register_hashcode (struct GNUNET_HashCode *hash)
@@ -80,6 +86,18 @@ insert_iterator (void *cls,
 }
 
 
+static int
+collect_iterator (void *cls,
+                  const struct GNUNET_HashCode *key,
+                  void *value)
+{
+  struct IBF_Key **pos = cls;
+
+  *(*pos)++ = ibf_key_from_hashcode (key);
+  return GNUNET_YES;
+}
+
+
 static int
 remove_iterator (void *cls,
                  const struct GNUNET_HashCode *key,
@@ -92,6 +110,70 @@ remove_iterator (void *cls,
 }
 
 
+/**
+ * Print how many items per second were processed.
+ *
+ * @param what description of the operation
+ * @param n number of items processed
+ * @param unit what the items are
+ * @param delta_time time it took
+ */
+static void
+print_rate (const char *what, unsigned long long n, const char *unit,
+            struct GNUNET_TIME_Relative delta_time)
+{
+  printf ("%s in: %s (%llu %s/s)\n",
+          what,
+          GNUNET_STRINGS_relative_time_to_string (delta_time, GNUNET_NO),
+          n * 1000LL * 1000LL / (1 + delta_time.rel_value_us),
+          unit);
+}
+
+
+/**
+ * Subtract one IBF from another one bucket at a time, as a baseline
+ * for #ibf_subtract().
+ *
+ * @param ibf1 IBF that is subtracted from
+ * @param ibf2 IBF that will be subtracted from ibf1
+ */
+static void
+scalar_subtract (struct InvertibleBloomFilter *ibf1,
+                 const struct InvertibleBloomFilter *ibf2)
+{
+  uint32_t i;
+
+  for (i = 0; i < ibf1->size; i++)
+  {
+    ibf1->count[i].count_val -= ibf2->count[i].count_val;
+    ibf1->key_hash_sum[i].key_hash_val ^= ibf2->key_hash_sum[i].key_hash_val;
+    ibf1->key_sum[i].key_val ^= ibf2->key_sum[i].key_val;
+  }
+}
+
+
+/**
+ * Check if two IBFs have the same contents.
+ *
+ * @param ibf1 first IBF
+ * @param ibf2 second IBF
+ * @return #GNUNET_YES if they are equal
+ */
+static int
+ibf_equal (const struct InvertibleBloomFilter *ibf1,
+           const struct InvertibleBloomFilter *ibf2)
+{
+  if ( (0 != memcmp (ibf1->count, ibf2->count,
+                     ibf1->size * sizeof (struct IBF_Count))) ||
+       (0 != memcmp (ibf1->key_hash_sum, ibf2->key_hash_sum,
+                     ibf1->size * sizeof (struct IBF_KeyHash))) ||
+       (0 != memcmp (ibf1->key_sum, ibf2->key_sum,
+                     ibf1->size * sizeof (struct IBF_Key))) )
+    return GNUNET_NO;
+  return GNUNET_YES;
+}
+
+
 static void
 run (void *cls, char *const *args, const char *cfgfile,
      const struct GNUNET_CONFIGURATION_Handle *cfg)
@@ -103,6 +185,10 @@ run (void *cls, char *const *args, const char *cfgfile,
   int res;
   struct GNUNET_TIME_Absolute start_time;
   struct GNUNET_TIME_Relative delta_time;
+  struct InvertibleBloomFilter *batch_a;
+  struct InvertibleBloomFilter *batch_b;
+  struct InvertibleBloomFilter *diff;
+  struct IBF_Key *pos;
 
   set_a = GNUNET_CONTAINER_multihashmap_create (((asize == 0) ? 1 : (asize + csize)),
                                                  GNUNET_NO);
@@ -160,6 +246,18 @@ run (void *cls, char *const *args, const char *cfgfile,
   ibf_a = ibf_create (ibf_size, hash_num);
   ibf_b = ibf_create (ibf_size, hash_num);
 
+  num_keys_a = asize + csize;
+  num_keys_b = bsize + csize;
+  keys_a = GNUNET_malloc_large ((num_keys_a + 1) * sizeof (struct IBF_Key));
+  keys_b = GNUNET_malloc_large ((num_keys_b + 1) * sizeof (struct IBF_Key));
+  GNUNET_assert ( (NULL != keys_a) && (NULL != keys_b) );
+  pos = keys_a;
+  GNUNET_CONTAINER_multihashmap_iterate (set_a, &collect_iterator, &pos);
+  GNUNET_CONTAINER_multihashmap_iterate (set_c, &collect_iterator, &pos);
+  pos = keys_b;
+  GNUNET_CONTAINER_multihashmap_iterate (set_b, &collect_iterator, &pos);
+  GNUNET_CONTAINER_multihashmap_iterate (set_c, &collect_iterator, &pos);
+
   printf ("generated sets\n");
 
   start_time = GNUNET_TIME_absolute_get ();
@@ -171,9 +269,36 @@ run (void *cls, char *const *args, const char *cfgfile,
 
   delta_time = GNUNET_TIME_absolute_get_duration (start_time);
 
-  printf ("encoded in: %s\n", GNUNET_STRINGS_relative_time_to_string (delta_time, GNUNET_NO));
+  print_rate ("encoded", num_keys_a + num_keys_b, "elements", delta_time);
+
+  batch_a = ibf_create (ibf_size, hash_num);
+  batch_b = ibf_create (ibf_size, hash_num);
+  start_time = GNUNET_TIME_absolute_get ();
+  ibf_insert_batch (batch_a, keys_a, num_keys_a);
+  ibf_insert_batch (batch_b, keys_b, num_keys_b);
+  delta_time = GNUNET_TIME_absolute_get_duration (start_time);
+  print_rate ("batch encoded", num_keys_a + num_keys_b, "elements", delta_time);
+  if ( (GNUNET_YES != ibf_equal (ibf_a, batch_a)) ||
+       (GNUNET_YES != ibf_equal (ibf_b, batch_b)) )
+    printf ("batch encoding differs (should never happen)\n");
+  ibf_destroy (batch_a);
+  ibf_destroy (batch_b);
+  GNUNET_free (keys_a);
+  GNUNET_free (keys_b);
+
+  diff = ibf_dup (ibf_a);
+  start_time = GNUNET_TIME_absolute_get ();
+  scalar_subtract (diff, ibf_b);
+  delta_time = GNUNET_TIME_absolute_get_duration (start_time);
+  print_rate ("subtracted (scalar)", ibf_size, "buckets", delta_time);
 
+  start_time = GNUNET_TIME_absolute_get ();
   ibf_subtract (ibf_a, ibf_b);
+  delta_time = GNUNET_TIME_absolute_get_duration (start_time);
+  print_rate ("subtracted", ibf_size, "buckets", delta_time);
+  if (GNUNET_YES != ibf_equal (ibf_a, diff))
+    printf ("subtraction differs (should never happen)\n");
+  ibf_destroy (diff);
 
 
   start_time = GNUNET_TIME_absolute_get ();
@@ -194,7 +319,7 @@ run (void *cls, char *const *args, const char *cfgfile,
           (0 == GNUNET_CONTAINER_multihashmap_size (set_a)))
       {
         delta_time = GNUNET_TIME_absolute_get_duration (start_time);
-        printf ("decoded successfully in: %s\n", GNUNET_STRINGS_relative_time_to_string (delta_time, GNUNET_NO));
+        print_rate ("decoded successfully", asize + bsize, "elements", delta_time);
       }
       else
       {
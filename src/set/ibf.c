@@ -25,6 +25,11 @@
  */
 
 #include "ibf.h"
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 /**
  * Compute the key's hash from the key.
@@ -32,6 +37,178 @@
  */
 #define IBF_KEY_HASH_VAL(k) (GNUNET_CRYPTO_crc32_n (&(k), sizeof (struct IBF_KeyHash)))
 
+/**
+ * Number of keys #ibf_insert_batch() hashes before it starts
+ * updating the buckets of these keys.
+ */
+#define IBF_BATCH_SIZE 64
+
+/**
+ * Largest number of buckets an element can be hashed into
+ * by #ibf_insert_batch().
+ */
+#define IBF_BATCH_MAX_HASH_NUM 8
+
+#if defined(__AVX2__)
+/**
+ * Vector type used by the bulk kernels.
+ */
+typedef __m256i IBF_Vector;
+#define IBF_VLOAD(p) _mm256_loadu_si256 ((const __m256i *) (p))
+#define IBF_VSTORE(p,v) _mm256_storeu_si256 ((__m256i *) (p), (v))
+#define IBF_VXOR(a,b) _mm256_xor_si256 ((a), (b))
+#define IBF_VOR(a,b) _mm256_or_si256 ((a), (b))
+#define IBF_VSUB8(a,b) _mm256_sub_epi8 ((a), (b))
+#define IBF_VZERO() _mm256_setzero_si256 ()
+#define IBF_VTEST_ZERO(v) _mm256_testz_si256 ((v), (v))
+#define IBF_VSET8(c) _mm256_set1_epi8 (c)
+#define IBF_VCMPEQ8(a,b) _mm256_cmpeq_epi8 ((a), (b))
+#define IBF_VMASK8(v) ((uint32_t) _mm256_movemask_epi8 (v))
+#elif defined(__SSE2__)
+typedef __m128i IBF_Vector;
+#define IBF_VLOAD(p) _mm_loadu_si128 ((const __m128i *) (p))
+#define IBF_VSTORE(p,v) _mm_storeu_si128 ((__m128i *) (p), (v))
+#define IBF_VXOR(a,b) _mm_xor_si128 ((a), (b))
+#define IBF_VOR(a,b) _mm_or_si128 ((a), (b))
+#define IBF_VSUB8(a,b) _mm_sub_epi8 ((a), (b))
+#define IBF_VZERO() _mm_setzero_si128 ()
+#define IBF_VTEST_ZERO(v) \
+  (0xFFFF == _mm_movemask_epi8 (_mm_cmpeq_epi8 ((v), _mm_setzero_si128 ())))
+#define IBF_VSET8(c) _mm_set1_epi8 (c)
+#define IBF_VCMPEQ8(a,b) _mm_cmpeq_epi8 ((a), (b))
+#define IBF_VMASK8(v) ((uint32_t) _mm_movemask_epi8 (v))
+#endif
+
+
+/**
+ * XOR @a len bytes of @a src into @a dst.  Both the key sums and the
+ * key hash sums of an IBF are combined bytewise, so one kernel serves
+ * both arrays.
+ *
+ * @param dst array to modify
+ * @param src array to XOR into @a dst
+ * @param len number of bytes in both arrays
+ */
+static void
+xor_bytes (void *dst, const void *src, size_t len)
+{
+  char *d = dst;
+  const char *s = src;
+  size_t i;
+
+  i = 0;
+#ifdef IBF_VLOAD
+  for (; i + sizeof (IBF_Vector) <= len; i += sizeof (IBF_Vector))
+    IBF_VSTORE (&d[i], IBF_VXOR (IBF_VLOAD (&d[i]), IBF_VLOAD (&s[i])));
+#endif
+  for (; i + sizeof (uint64_t) <= len; i += sizeof (uint64_t))
+  {
+    uint64_t a;
+    uint64_t b;
+
+    memcpy (&a, &d[i], sizeof (a));
+    memcpy (&b, &s[i], sizeof (b));
+    a ^= b;
+    memcpy (&d[i], &a, sizeof (a));
+  }
+  for (; i < len; i++)
+    d[i] ^= s[i];
+}
+
+
+/**
+ * Subtract the counts in @a src from the counts in @a dst.
+ *
+ * @param dst counts to modify
+ * @param src counts to subtract
+ * @param n number of counts in both arrays
+ */
+static void
+subtract_counts (struct IBF_Count *dst, const struct IBF_Count *src, uint32_t n)
+{
+  uint32_t i;
+
+  i = 0;
+#ifdef IBF_VLOAD
+  for (; i + sizeof (IBF_Vector) <= n; i += sizeof (IBF_Vector))
+    IBF_VSTORE (&dst[i], IBF_VSUB8 (IBF_VLOAD (&dst[i]), IBF_VLOAD (&src[i])));
+#endif
+  for (; i < n; i++)
+    dst[i].count_val -= src[i].count_val;
+}
+
+
+/**
+ * Find the first bucket at or after @a start whose count is 1 or -1,
+ * that is a bucket that may be pure and thus decodable.
+ *
+ * @param ibf the IBF to search
+ * @param start first bucket to look at
+ * @return index of the bucket, ibf->size if there is none
+ */
+static uint32_t
+find_pure_candidate (const struct InvertibleBloomFilter *ibf, uint32_t start)
+{
+  uint32_t i;
+
+  i = start;
+#ifdef IBF_VLOAD
+  {
+    const IBF_Vector plus_one = IBF_VSET8 (1);
+    const IBF_Vector minus_one = IBF_VSET8 (-1);
+    IBF_Vector v;
+    uint32_t mask;
+
+    for (; i + sizeof (IBF_Vector) <= ibf->size; i += sizeof (IBF_Vector))
+    {
+      v = IBF_VLOAD (&ibf->count[i]);
+      mask = IBF_VMASK8 (IBF_VOR (IBF_VCMPEQ8 (v, plus_one),
+                                  IBF_VCMPEQ8 (v, minus_one)));
+      if (0 != mask)
+        return i + __builtin_ctz (mask);
+    }
+  }
+#endif
+  for (; i < ibf->size; i++)
+    if ( (1 == ibf->count[i].count_val) ||
+         (-1 == ibf->count[i].count_val) )
+      return i;
+  return ibf->size;
+}
+
+
+/**
+ * Test if all @a len bytes at @a buf are zero.
+ *
+ * @param buf memory to inspect
+ * @param len number of bytes at @a buf
+ * @return #GNUNET_YES if all bytes are zero, #GNUNET_NO otherwise
+ */
+static int
+is_zero (const void *buf, size_t len)
+{
+  const char *b = buf;
+  size_t i;
+
+  i = 0;
+#ifdef IBF_VLOAD
+  {
+    IBF_Vector acc;
+
+    acc = IBF_VZERO ();
+    for (; i + sizeof (IBF_Vector) <= len; i += sizeof (IBF_Vector))
+      acc = IBF_VOR (acc, IBF_VLOAD (&b[i]));
+    if (! IBF_VTEST_ZERO (acc))
+      return GNUNET_NO;
+  }
+#endif
+  for (; i < len; i++)
+    if (0 != b[i])
+      return GNUNET_NO;
+  return GNUNET_YES;
+}
+
+
 /**
  * Create a key from a hashcode.
  *
@@ -120,6 +297,7 @@ ibf_insert_into  (struct InvertibleBloomFilter *ibf,
                   struct IBF_Key key,
                   const int *buckets, int side)
 {
+  const uint32_t key_hash_val = IBF_KEY_HASH_VAL (key);
   int i;
 
   for (i = 0; i < ibf->hash_num; i++)
@@ -127,8 +305,7 @@ ibf_insert_into  (struct InvertibleBloomFilter *ibf,
     const int bucket = buckets[i];
     ibf->count[bucket].count_val += side;
     ibf->key_sum[bucket].key_val ^= key.key_val;
-    ibf->key_hash_sum[bucket].key_hash_val
-        ^= IBF_KEY_HASH_VAL (key);
+    ibf->key_hash_sum[bucket].key_hash_val ^= key_hash_val;
   }
 }
 
@@ -149,6 +326,55 @@ ibf_insert (struct InvertibleBloomFilter *ibf, struct IBF_Key key)
 }
 
 
+/**
+ * Insert multiple keys into an IBF.  Equivalent to calling
+ * #ibf_insert() for each key, but first computes the bucket indices
+ * of a batch of keys and then updates the buckets, which keeps the
+ * hashing and the (cache-missing) bucket updates in separate loops.
+ *
+ * @param ibf the IBF
+ * @param keys the keys to insert
+ * @param num_keys number of entries in @a keys
+ */
+void
+ibf_insert_batch (struct InvertibleBloomFilter *ibf,
+                  const struct IBF_Key *keys,
+                  unsigned int num_keys)
+{
+  int buckets[IBF_BATCH_SIZE][IBF_BATCH_MAX_HASH_NUM];
+  unsigned int off;
+  unsigned int n;
+  unsigned int i;
+  unsigned int j;
+
+  GNUNET_assert (ibf->hash_num <= ibf->size);
+  if (ibf->hash_num > IBF_BATCH_MAX_HASH_NUM)
+  {
+    for (i = 0; i < num_keys; i++)
+      ibf_insert (ibf, keys[i]);
+    return;
+  }
+  for (off = 0; off < num_keys; off += n)
+  {
+    n = GNUNET_MIN (num_keys - off, IBF_BATCH_SIZE);
+    for (i = 0; i < n; i++)
+    {
+      ibf_get_indices (ibf, keys[off + i], buckets[i]);
+#ifdef __GNUC__
+      for (j = 0; j < ibf->hash_num; j++)
+      {
+        __builtin_prefetch (&ibf->count[buckets[i][j]], 1);
+        __builtin_prefetch (&ibf->key_sum[buckets[i][j]], 1);
+        __builtin_prefetch (&ibf->key_hash_sum[buckets[i][j]], 1);
+      }
+#endif
+    }
+    for (i = 0; i < n; i++)
+      ibf_insert_into (ibf, keys[off + i], buckets[i], 1);
+  }
+}
+
+
 /**
  * Remove a key from an IBF.
  *
@@ -171,17 +397,14 @@ ibf_remove (struct InvertibleBloomFilter *ibf, struct IBF_Key key)
 static int
 ibf_is_empty (struct InvertibleBloomFilter *ibf)
 {
-  int i;
-  for (i = 0; i < ibf->size; i++)
-  {
-    if (0 != ibf->count[i].count_val)
-      return GNUNET_NO;
-    if (0 != ibf->key_hash_sum[i].key_hash_val)
-      return GNUNET_NO;
-    if (0 != ibf->key_sum[i].key_val)
-      return GNUNET_NO;
-  }
-  return GNUNET_YES;
+  if (GNUNET_NO == is_zero (ibf->count,
+                            ibf->size * sizeof (struct IBF_Count)))
+    return GNUNET_NO;
+  if (GNUNET_NO == is_zero (ibf->key_hash_sum,
+                            ibf->size * sizeof (struct IBF_KeyHash)))
+    return GNUNET_NO;
+  return is_zero (ibf->key_sum,
+                  ibf->size * sizeof (struct IBF_Key));
 }
 
 
@@ -207,14 +430,14 @@ ibf_decode (struct InvertibleBloomFilter *ibf,
 
   GNUNET_assert (NULL != ibf);
 
-  for (i = 0; i < ibf->size; i++)
+  for (i = find_pure_candidate (ibf, 0);
+       i < ibf->size;
+       i = find_pure_candidate (ibf, i + 1))
   {
     int j;
     int hit;
 
-    /* we can only decode from pure buckets */
-    if ((1 != ibf->count[i].count_val) && (-1 != ibf->count[i].count_val))
-      continue;
+    /* we can only decode from pure buckets (count is 1 or -1) */
 
     hash.key_hash_val = IBF_KEY_HASH_VAL (ibf->key_sum[i]);
 
@@ -324,17 +547,14 @@ ibf_read_slice (const void *buf, uint32_t start, uint32_t count, struct Invertib
 void
 ibf_subtract (struct InvertibleBloomFilter *ibf1, const struct InvertibleBloomFilter *ibf2)
 {
-  int i;
-
   GNUNET_assert (ibf1->size == ibf2->size);
   GNUNET_assert (ibf1->hash_num == ibf2->hash_num);
 
-  for (i = 0; i < ibf1->size; i++)
-  {
-    ibf1->count[i].count_val -= ibf2->count[i].count_val;
-    ibf1->key_hash_sum[i].key_hash_val ^= ibf2->key_hash_sum[i].key_hash_val;
-    ibf1->key_sum[i].key_val ^= ibf2->key_sum[i].key_val;
-  }
+  subtract_counts (ibf1->count, ibf2->count, ibf1->size);
+  xor_bytes (ibf1->key_hash_sum, ibf2->key_hash_sum,
+             ibf1->size * sizeof (struct IBF_KeyHash));
+  xor_bytes (ibf1->key_sum, ibf2->key_sum,
+             ibf1->size * sizeof (struct IBF_Key));
 }
 
 
@@ -180,6 +180,19 @@ void
 ibf_insert (struct InvertibleBloomFilter *ibf, struct IBF_Key key);
 
 
+/**
+ * Insert multiple keys into an IBF.
+ *
+ * @param ibf the IBF
+ * @param keys the keys to insert
+ * @param num_keys number of entries in @a keys
+ */
+void
+ibf_insert_batch (struct InvertibleBloomFilter *ibf,
+                  const struct IBF_Key *keys,
+                  unsigned int num_keys);
+
+
 /**
  * Remove a key from an IBF.
  *
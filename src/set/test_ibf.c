@@ -0,0 +1,136 @@
+/*
+     This file is part of GNUnet.
+     (C) 2014 Christian Grothoff (and other contributing authors)
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+     Boston, MA 02111-1307, USA.
+*/
+
+/**
+ * @file set/test_ibf.c
+ * @brief testcase for the invertible bloom filter
+ */
+#include "platform.h"
+#include "gnunet_util_lib.h"
+#include "ibf.h"
+
+/**
+ * Number of keys inserted into the IBFs.
+ */
+#define NUM_KEYS 1000
+
+
+static int
+ibf_equal (const struct InvertibleBloomFilter *ibf1,
+           const struct InvertibleBloomFilter *ibf2)
+{
+  if ( (0 != memcmp (ibf1->count, ibf2->count,
+                     ibf1->size * sizeof (struct IBF_Count))) ||
+       (0 != memcmp (ibf1->key_hash_sum, ibf2->key_hash_sum,
+                     ibf1->size * sizeof (struct IBF_KeyHash))) ||
+       (0 != memcmp (ibf1->key_sum, ibf2->key_sum,
+                     ibf1->size * sizeof (struct IBF_Key))) )
+    return GNUNET_NO;
+  return GNUNET_YES;
+}
+
+
+/**
+ * Check batch insertion, subtraction and decoding of an IBF.
+ *
+ * @param size number of buckets to use, deliberately not a multiple
+ *        of the vector width for some runs
+ * @return 0 on success
+ */
+static int
+test_size (uint32_t size)
+{
+  struct IBF_Key keys[NUM_KEYS + 1];
+  struct InvertibleBloomFilter *ibf;
+  struct InvertibleBloomFilter *batch;
+  struct InvertibleBloomFilter *diff;
+  struct InvertibleBloomFilter *expected;
+  struct IBF_Key key;
+  unsigned int i;
+  int side;
+
+  for (i = 0; i < NUM_KEYS + 1; i++)
+    GNUNET_CRYPTO_random_block (GNUNET_CRYPTO_QUALITY_WEAK,
+                                &keys[i], sizeof (struct IBF_Key));
+  ibf = ibf_create (size, 4);
+  batch = ibf_create (size, 4);
+  for (i = 0; i < NUM_KEYS; i++)
+    ibf_insert (ibf, keys[i]);
+  ibf_insert_batch (batch, keys, 1);
+  ibf_insert_batch (batch, &keys[1], NUM_KEYS - 1);
+  if (GNUNET_YES != ibf_equal (ibf, batch))
+  {
+    GNUNET_break (0);
+    return 1;
+  }
+
+  /* batch now has one extra key, the difference must decode to it */
+  ibf_insert (batch, keys[NUM_KEYS]);
+  diff = ibf_dup (batch);
+  expected = ibf_dup (batch);
+  ibf_subtract (diff, ibf);
+  for (i = 0; i < size; i++)
+  {
+    expected->count[i].count_val -= ibf->count[i].count_val;
+    expected->key_hash_sum[i].key_hash_val ^= ibf->key_hash_sum[i].key_hash_val;
+    expected->key_sum[i].key_val ^= ibf->key_sum[i].key_val;
+  }
+  if (GNUNET_YES != ibf_equal (diff, expected))
+  {
+    GNUNET_break (0);
+    return 1;
+  }
+  if ( (GNUNET_YES != ibf_decode (diff, &side, &key)) ||
+       (1 != side) ||
+       (keys[NUM_KEYS].key_val != key.key_val) ||
+       (GNUNET_NO != ibf_decode (diff, &side, &key)) )
+  {
+    GNUNET_break (0);
+    return 1;
+  }
+
+  /* the difference of an IBF with itself is empty */
+  ibf_subtract (batch, batch);
+  if (GNUNET_NO != ibf_decode (batch, &side, &key))
+  {
+    GNUNET_break (0);
+    return 1;
+  }
+  ibf_destroy (ibf);
+  ibf_destroy (batch);
+  ibf_destroy (diff);
+  ibf_destroy (expected);
+  return 0;
+}
+
+
+int
+main (int argc, char **argv)
+{
+  int ret;
+
+  GNUNET_log_setup ("test-ibf", "WARNING", NULL);
+  ret = 0;
+  ret |= test_size (256);
+  ret |= test_size (331);
+  return ret;
+}
+
+/* end of test_ibf.c */
@@ -176,6 +176,12 @@ static const struct GNUNET_CONFIGURATION_Handle *cfg;
  */
 static struct StatsEntry *start;
 
+/**
+ * Index of our active statistics, mapping the hash of the service
+ * name and the name of the value to the 'struct StatsEntry'.
+ */
+static struct GNUNET_CONTAINER_MultiHashMap *stats_map;
+
 /**
  * Head of linked list of connected clients.
  */
@@ -401,6 +407,119 @@ matches (const struct StatsEntry *e, const char *service, const char *name)
 }
 
 
+/**
+ * Compute the key of a value in the #stats_map.  The @a name must
+ * directly follow the 0-terminated @a service in memory, which is
+ * the case for the strings in all of our messages.
+ *
+ * @param service name of the service
+ * @param name name of the value
+ * @param key where to store the key
+ */
+static void
+get_entry_key (const char *service,
+               const char *name,
+               struct GNUNET_HashCode *key)
+{
+  size_t slen;
+
+  slen = strlen (service) + 1;
+  GNUNET_assert (name == &service[slen]);
+  GNUNET_CRYPTO_hash (service, slen + strlen (name) + 1, key);
+}
+
+
+/**
+ * Closure for #find_entry_it().
+ */
+struct FindEntryContext
+{
+  /**
+   * Name of the service to find.
+   */
+  const char *service;
+
+  /**
+   * Name of the value to find.
+   */
+  const char *name;
+
+  /**
+   * Set to the entry we found, NULL for none.
+   */
+  struct StatsEntry *res;
+};
+
+
+/**
+ * Check if an entry from the #stats_map is the one we are looking
+ * for (we might have a hash collision).
+ *
+ * @param cls the `struct FindEntryContext`
+ * @param key key of the entry (unused)
+ * @param value a `struct StatsEntry`
+ * @return #GNUNET_NO if we found the entry, #GNUNET_YES to continue
+ */
+static int
+find_entry_it (void *cls,
+               const struct GNUNET_HashCode *key,
+               void *value)
+{
+  struct FindEntryContext *fec = cls;
+  struct StatsEntry *e = value;
+
+  if ( (0 != strcmp (fec->service, e->service)) ||
+       (0 != strcmp (fec->name, e->name)) )
+    return GNUNET_YES;
+  fec->res = e;
+  return GNUNET_NO;
+}
+
+
+/**
+ * Find the entry for the given value.
+ *
+ * @param service name of the service, must not be empty
+ * @param name name of the value, must not be empty, must
+ *        directly follow @a service in memory
+ * @return NULL if we have no such value
+ */
+static struct StatsEntry *
+find_entry (const char *service,
+            const char *name)
+{
+  struct FindEntryContext fec;
+  struct GNUNET_HashCode key;
+
+  get_entry_key (service, name, &key);
+  fec.service = service;
+  fec.name = name;
+  fec.res = NULL;
+  GNUNET_CONTAINER_multihashmap_get_multiple (stats_map, &key,
+                                              &find_entry_it, &fec);
+  return fec.res;
+}
+
+
+/**
+ * Add a new entry to our list of values and the #stats_map.
+ *
+ * @param pos entry to add
+ */
+static void
+add_entry (struct StatsEntry *pos)
+{
+  struct GNUNET_HashCode key;
+
+  get_entry_key (pos->service, pos->name, &key);
+  pos->next = start;
+  start = pos;
+  GNUNET_assert (GNUNET_OK ==
+                 GNUNET_CONTAINER_multihashmap_put (stats_map, &key, pos,
+                                                    GNUNET_CONTAINER_MULTIHASHMAPOPTION_MULTIPLE));
+}
+
+
 /**
  * Find a client entry for the given client handle, or create one.
  *
@@ -467,9 +586,18 @@ handle_get (void *cls, struct GNUNET_SERVER_Client *client,
   GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
               "Received request for statistics on `%s:%s'\n",
               strlen (service) ? service : "*", strlen (name) ? name : "*");
-  for (pos = start; NULL != pos; pos = pos->next)
-    if (matches (pos, service, name))
+  if ( (0 != strlen (service)) &&
+       (0 != strlen (name)) )
+  {
+    if (NULL != (pos = find_entry (service, name)))
       transmit (client, pos);
+  }
+  else
+  {
+    for (pos = start; NULL != pos; pos = pos->next)
+      if (matches (pos, service, name))
+        transmit (client, pos);
+  }
   end.size = htons (sizeof (struct GNUNET_MessageHeader));
   end.type = htons (GNUNET_MESSAGE_TYPE_STATISTICS_END);
   GNUNET_SERVER_notification_context_unicast (nc, client, &end, GNUNET_NO);
@@ -530,7 +658,6 @@ handle_set (void *cls, struct GNUNET_SERVER_Client *client,
   uint16_t size;
   const struct GNUNET_STATISTICS_SetMessage *msg;
   struct StatsEntry *pos;
-  struct StatsEntry *prev;
   uint32_t flags;
   uint64_t value;
   int64_t delta;
@@ -563,61 +690,47 @@ handle_set (void *cls, struct GNUNET_SERVER_Client *client,
   GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
               "Received request to update statistic on `%s:%s' (%u) to/by %llu\n",
               service, name, (unsigned int) flags, (unsigned long long) value);
-  pos = start;
-  prev = NULL;
-  while (pos != NULL)
+  pos = find_entry (service, name);
+  if (NULL != pos)
   {
-    if (matches (pos, service, name))
+    initial_set = 0;
+    if ((flags & GNUNET_STATISTICS_SETFLAG_RELATIVE) == 0)
+    {
+      changed = (pos->value != value);
+      pos->value = value;
+    }
+    else
     {
-      initial_set = 0;
-      if ((flags & GNUNET_STATISTICS_SETFLAG_RELATIVE) == 0)
+      delta = (int64_t) value;
+      if ((delta < 0) && (pos->value < -delta))
       {
-        changed = (pos->value != value);
-        pos->value = value;
+        changed = (pos->value != 0);
+        pos->value = 0;
       }
       else
       {
-        delta = (int64_t) value;
-        if ((delta < 0) && (pos->value < -delta))
-        {
-          changed = (pos->value != 0);
-          pos->value = 0;
-        }
-        else
-        {
-          changed = (delta != 0);
-          GNUNET_break ((delta <= 0) || (pos->value + delta > pos->value));
-          pos->value += delta;
-        }
+        changed = (delta != 0);
+        GNUNET_break ((delta <= 0) || (pos->value + delta > pos->value));
+        pos->value += delta;
       }
-      if (GNUNET_NO == pos->set)
-      {
-        pos->set = GNUNET_YES;
-        initial_set = 1;
-      }
-      pos->msg->value = GNUNET_htonll (pos->value);
-      pos->msg->flags = msg->flags;
-      pos->persistent = (0 != (flags & GNUNET_STATISTICS_SETFLAG_PERSISTENT));
-      if (prev != NULL)
-      {
-        /* move to front for faster setting next time! */
-        prev->next = pos->next;
-        pos->next = start;
-        start = pos;
-      }
-      GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
-                  "Statistic `%s:%s' updated to value %llu.\n", service, name,
-                  pos->value);
-      if ((changed) || (1 == initial_set))
-        notify_change (pos);
-      GNUNET_SERVER_receive_done (client, GNUNET_OK);
-      return;
     }
-    prev = pos;
-    pos = pos->next;
+    if (GNUNET_NO == pos->set)
+    {
+      pos->set = GNUNET_YES;
+      initial_set = 1;
+    }
+    pos->msg->value = GNUNET_htonll (pos->value);
+    pos->msg->flags = msg->flags;
+    pos->persistent = (0 != (flags & GNUNET_STATISTICS_SETFLAG_PERSISTENT));
+    GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
+                "Statistic `%s:%s' updated to value %llu.\n", service, name,
+                pos->value);
+    if ((changed) || (1 == initial_set))
+      notify_change (pos);
+    GNUNET_SERVER_receive_done (client, GNUNET_OK);
+    return;
   }
   pos = GNUNET_malloc (sizeof (struct StatsEntry) + msize);
-  pos->next = start;
   if (((flags & GNUNET_STATISTICS_SETFLAG_RELATIVE) == 0) ||
       (0 < (int64_t) GNUNET_ntohll (msg->value)))
   {
@@ -634,8 +747,7 @@ handle_set (void *cls, struct GNUNET_SERVER_Client *client,
   memcpy (pos->msg, message, ntohs (message->size));
   pos->service = (const char *) &pos->msg[1];
   pos->name = &pos->service[strlen (pos->service) + 1];
-
-  start = pos;
+  add_entry (pos);
   GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
               "New statistic on `%s:%s' with value %llu created.\n", service,
               name, pos->value);
@@ -689,19 +801,12 @@ handle_watch (void *cls, struct GNUNET_SERVER_Client *client,
   GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
               "Received request to watch statistic on `%s:%s'\n", service,
               name);
-  pos = start;
-  while (pos != NULL)
-  {
-    if (matches (pos, service, name))
-      break;
-    pos = pos->next;
-  }
+  pos = find_entry (service, name);
   if (pos == NULL)
   {
     pos =
         GNUNET_malloc (sizeof (struct StatsEntry) +
                        sizeof (struct GNUNET_STATISTICS_SetMessage) + size);
-    pos->next = start;
     pos->uid = uidgen++;
     pos->set = GNUNET_NO;
     pos->msg = (void *) &pos[1];
@@ -713,7 +818,7 @@ handle_watch (void *cls, struct GNUNET_SERVER_Client *client,
     memcpy ((void *) pos->service, service, slen);
     pos->name = &pos->service[slen];
     memcpy ((void *) pos->name, name, strlen (name) + 1);
-    start = pos;
+    add_entry (pos);
     GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
                 "New statistic on `%s:%s' with value %llu created.\n", service,
                 name, pos->value);
@@ -740,6 +845,8 @@ do_shutdown ()
 
   if (NULL == nc)
     return;
+  GNUNET_CONTAINER_multihashmap_destroy (stats_map);
+  stats_map = NULL;
   save ();
   GNUNET_SERVER_notification_context_destroy (nc);
   nc = NULL;
@@ -839,6 +946,7 @@ run (void *cls, struct GNUNET_SERVER_Handle *server,
   srv = server;
   GNUNET_SERVER_add_handlers (server, handlers);
   nc = GNUNET_SERVER_notification_context_create (server, 16);
+  stats_map = GNUNET_CONTAINER_multihashmap_create (128, GNUNET_NO);
   GNUNET_SERVER_disconnect_notify (server, &handle_client_disconnect, NULL);
   load (server);
   GNUNET_SCHEDULER_add_delayed (GNUNET_TIME_UNIT_FOREVER_REL, &shutdown_task,
@@ -0,0 +1,202 @@
+/*
+     This file is part of GNUnet.
+     (C) 2014 Christian Grothoff (and other contributing authors)
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+     Boston, MA 02111-1307, USA.
+*/
+/**
+ * @file statistics/perf_statistics_api.c
+ * @brief measure how many updates per second the statistics
+ *        service sustains when many values are updated
+ */
+#include "platform.h"
+#include "gnunet_util_lib.h"
+#include "gnunet_statistics_service.h"
+#include <gauger.h>
+
+/**
+ * Number of distinct values we update.
+ */
+#define NUM_VALUES 4096
+
+/**
+ * Number of updates we do per scheduler task.
+ */
+#define UPDATES_PER_ROUND 1024
+
+/**
+ * Number of rounds we do.
+ */
+#define ROUNDS 1024
+
+
+static struct GNUNET_STATISTICS_Handle *h;
+
+static struct GNUNET_TIME_Absolute start_time;
+
+static unsigned int round_num;
+
+static unsigned int found;
+
+static int ok;
+
+
+/**
+ * Check the values we got back from the service.
+ *
+ * @param cls NULL
+ * @param subsystem name of the subsystem
+ * @param name name of the value
+ * @param value final value
+ * @param is_persistent is the value persistent?
+ * @return #GNUNET_OK to continue
+ */
+static int
+check_value (void *cls, const char *subsystem, const char *name,
+             uint64_t value, int is_persistent)
+{
+  if (value != (uint64_t) ROUNDS * UPDATES_PER_ROUND / NUM_VALUES)
+  {
+    FPRINTF (stderr,
+             "Value `%s' is %llu, expected %llu\n",
+             name,
+             (unsigned long long) value,
+             (unsigned long long) ROUNDS * UPDATES_PER_ROUND / NUM_VALUES);
+    ok = 1;
+  }
+  found++;
+  return GNUNET_OK;
+}
+
+
+/**
+ * All values were retrieved, report the rate.
+ *
+ * @param cls NULL
+ * @param success #GNUNET_OK if the GET completed
+ */
+static void
+done (void *cls, int success)
+{
+  struct GNUNET_TIME_Relative duration;
+  unsigned long long rate;
+
+  duration = GNUNET_TIME_absolute_get_duration (start_time);
+  GNUNET_STATISTICS_destroy (h, GNUNET_NO);
+  h = NULL;
+  if ( (GNUNET_OK != success) ||
+       (NUM_VALUES != found) )
+  {
+    FPRINTF (stderr,
+             "Got %u of %u values back\n",
+             found,
+             NUM_VALUES);
+    ok = 1;
+    return;
+  }
+  rate = (unsigned long long) ROUNDS * UPDATES_PER_ROUND * 1000LL * 1000LL
+    / (1 + duration.rel_value_us);
+  printf ("%u updates of %u values took %s (%llu updates/s)\n",
+          ROUNDS * UPDATES_PER_ROUND,
+          NUM_VALUES,
+          GNUNET_STRINGS_relative_time_to_string (duration, GNUNET_YES),
+          rate);
+  GAUGER ("STATISTICS", "Sustained updates", rate, "updates/s");
+}
+
+
+/**
+ * Perform one round of updates, then yield to the scheduler
+ * so that the updates can be transmitted.
+ *
+ * @param cls NULL
+ * @param tc scheduler context
+ */
+static void
+do_round (void *cls,
+          const struct GNUNET_SCHEDULER_TaskContext *tc)
+{
+  static unsigned int ctr;
+  unsigned int i;
+  char name[32];
+
+  for (i = 0; i < UPDATES_PER_ROUND; i++)
+  {
+    GNUNET_snprintf (name, sizeof (name), "v-%u", ctr++ % NUM_VALUES);
+    GNUNET_STATISTICS_update (h, name, 1, GNUNET_NO);
+  }
+  if (++round_num < ROUNDS)
+  {
+    GNUNET_SCHEDULER_add_now (&do_round, NULL);
+    return;
+  }
+  /* the GET is only answered once all updates were processed */
+  GNUNET_break (NULL !=
+                GNUNET_STATISTICS_get (h, "perf-statistics-api", NULL,
+                                       GNUNET_TIME_UNIT_MINUTES, &done,
+                                       &check_value, NULL));
+}
+
+
+static void
+run (void *cls, char *const *args, const char *cfgfile,
+     const struct GNUNET_CONFIGURATION_Handle *cfg)
+{
+  h = GNUNET_STATISTICS_create ("perf-statistics-api", cfg);
+  start_time = GNUNET_TIME_absolute_get ();
+  GNUNET_SCHEDULER_add_now (&do_round, NULL);
+}
+
+
+int
+main (int argc, char *argv_ign[])
+{
+  char *const argv[] = { "perf-statistics-api",
+    "-c",
+    "test_statistics_api_data.conf",
+    NULL
+  };
+  struct GNUNET_GETOPT_CommandLineOption options[] = {
+    GNUNET_GETOPT_OPTION_END
+  };
+  struct GNUNET_OS_Process *proc;
+  char *binary;
+
+  GNUNET_log_setup ("perf-statistics-api", "WARNING", NULL);
+  binary = GNUNET_OS_get_libexec_binary_path ("gnunet-service-statistics");
+  proc =
+    GNUNET_OS_start_process (GNUNET_YES, GNUNET_OS_INHERIT_STD_OUT_AND_ERR,
+			     NULL, NULL, NULL,
+			     binary,
+			     "gnunet-service-statistics",
+			     "-c", "test_statistics_api_data.conf", NULL);
+  GNUNET_assert (NULL != proc);
+  ok = 0;
+  GNUNET_PROGRAM_run (3, argv, "perf-statistics-api", "nohelp", options, &run,
+                      NULL);
+  if (0 != GNUNET_OS_process_kill (proc, GNUNET_TERM_SIG))
+  {
+    GNUNET_log_strerror (GNUNET_ERROR_TYPE_WARNING, "kill");
+    ok = 1;
+  }
+  GNUNET_OS_process_wait (proc);
+  GNUNET_OS_process_destroy (proc);
+  proc = NULL;
+  GNUNET_free (binary);
+  return ok;
+}
+
+/* end of perf_statistics_api.c */
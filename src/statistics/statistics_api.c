@@ -37,6 +37,14 @@
  */
 #define SET_TRANSMIT_TIMEOUT GNUNET_TIME_relative_multiply (GNUNET_TIME_UNIT_SECONDS, 2)
 
+/**
+ * How long do we accumulate SET and UPDATE requests before we
+ * transmit them to the service?  Changes to the same value within
+ * this timeframe are combined, and all pending changes are sent
+ * together in as few transmissions as possible.
+ */
+#define SET_FLUSH_DELAY GNUNET_TIME_relative_multiply (GNUNET_TIME_UNIT_MILLISECONDS, 50)
+
 #define LOG(kind,...) GNUNET_log_from (kind, "statistics-api",__VA_ARGS__)
 
 /**
@@ -171,6 +179,12 @@ struct GNUNET_STATISTICS_GetHandle
    */
   enum ActionType type;
 
+  /**
+   * Hash of @e name, key in the `pending_setters` map of the
+   * handle (for SET/UPDATE actions only).
+   */
+  struct GNUNET_HashCode name_hash;
+
   /**
    * Size of the message that we will be transmitting.
    */
@@ -222,6 +236,13 @@ struct GNUNET_STATISTICS_Handle
    */
   struct GNUNET_STATISTICS_GetHandle *current;
 
+  /**
+   * SET and UPDATE actions in the action queue, indexed by the hash
+   * of the name of the value (the subsystem is always ours), so that
+   * further changes to the same value can be merged into them.
+   */
+  struct GNUNET_CONTAINER_MultiHashMap *pending_setters;
+
   /**
    * Array of watch entries.
    */
@@ -232,6 +253,11 @@ struct GNUNET_STATISTICS_Handle
    */
   GNUNET_SCHEDULER_TaskIdentifier backoff_task;
 
+  /**
+   * Task that transmits accumulated SET and UPDATE requests.
+   */
+  GNUNET_SCHEDULER_TaskIdentifier flush_task;
+
   /**
    * Time for next connect retry.
    */
@@ -378,6 +404,26 @@ free_action_item (struct GNUNET_STATISTICS_GetHandle *gh)
 }
 
 
+/**
+ * Remove an action item from the action queue of its handle.
+ *
+ * @param h statistics handle
+ * @param ai action item to remove
+ */
+static void
+dequeue_action (struct GNUNET_STATISTICS_Handle *h,
+                struct GNUNET_STATISTICS_GetHandle *ai)
+{
+  GNUNET_CONTAINER_DLL_remove (h->action_head, h->action_tail, ai);
+  if ( (ACTION_SET == ai->type) ||
+       (ACTION_UPDATE == ai->type) )
+    GNUNET_assert (GNUNET_YES ==
+                   GNUNET_CONTAINER_multihashmap_remove (h->pending_setters,
+                                                         &ai->name_hash,
+                                                         ai));
+}
+
+
 /**
  * Disconnect from the statistics service.
  *
@@ -854,7 +900,46 @@ transmit_watch (struct GNUNET_STATISTICS_Handle *handle,
 
 
 /**
- * Transmit a SET/UPDATE request.
+ * Write the SET message for the given SET or UPDATE action.
+ *
+ * @param ai the action
+ * @param buf where to write the message, must have room
+ *        for at least `ai->msize` bytes
+ * @return number of bytes written to @a buf
+ */
+static size_t
+fill_set_message (const struct GNUNET_STATISTICS_GetHandle *ai,
+                  void *buf)
+{
+  struct GNUNET_STATISTICS_SetMessage *r;
+  size_t slen;
+  size_t nlen;
+
+  slen = strlen (ai->subsystem) + 1;
+  nlen = strlen (ai->name) + 1;
+  GNUNET_assert (ai->msize ==
+                 sizeof (struct GNUNET_STATISTICS_SetMessage) + slen + nlen);
+  r = buf;
+  r->header.size = htons (ai->msize);
+  r->header.type = htons (GNUNET_MESSAGE_TYPE_STATISTICS_SET);
+  r->flags = 0;
+  r->value = GNUNET_htonll (ai->value);
+  if (ai->make_persistent)
+    r->flags |= htonl (GNUNET_STATISTICS_SETFLAG_PERSISTENT);
+  if (ai->type == ACTION_UPDATE)
+    r->flags |= htonl (GNUNET_STATISTICS_SETFLAG_RELATIVE);
+  GNUNET_assert (slen + nlen ==
+                 GNUNET_STRINGS_buffer_fill ((char *) &r[1], slen + nlen, 2,
+                                             ai->subsystem,
+                                             ai->name));
+  return ai->msize;
+}
+
+
+/**
+ * Transmit a SET/UPDATE request.  Further SET/UPDATE requests
+ * waiting at the head of the queue are appended to the same
+ * transmission as long as they fit into @a buf.
  *
  * @param handle statistics handle
  * @param size how many bytes can we write to @a buf
@@ -866,10 +951,8 @@ transmit_set (struct GNUNET_STATISTICS_Handle *handle,
               size_t size,
               void *buf)
 {
-  struct GNUNET_STATISTICS_SetMessage *r;
-  size_t slen;
-  size_t nlen;
-  size_t nsize;
+  struct GNUNET_STATISTICS_GetHandle *ai;
+  size_t off;
 
   if (NULL == buf)
   {
@@ -877,34 +960,28 @@ transmit_set (struct GNUNET_STATISTICS_Handle *handle,
     reconnect_later (handle);
     return 0;
   }
-  slen = strlen (handle->current->subsystem) + 1;
-  nlen = strlen (handle->current->name) + 1;
-  nsize = sizeof (struct GNUNET_STATISTICS_SetMessage) + slen + nlen;
-  if (size < nsize)
+  if (size < handle->current->msize)
   {
     GNUNET_break (0);
     do_disconnect (handle);
     reconnect_later (handle);
     return 0;
   }
-  r = buf;
-  r->header.size = htons (nsize);
-  r->header.type = htons (GNUNET_MESSAGE_TYPE_STATISTICS_SET);
-  r->flags = 0;
-  r->value = GNUNET_htonll (handle->current->value);
-  if (handle->current->make_persistent)
-    r->flags |= htonl (GNUNET_STATISTICS_SETFLAG_PERSISTENT);
-  if (handle->current->type == ACTION_UPDATE)
-    r->flags |= htonl (GNUNET_STATISTICS_SETFLAG_RELATIVE);
-  GNUNET_assert (slen + nlen ==
-                 GNUNET_STRINGS_buffer_fill ((char *) &r[1], slen + nlen, 2,
-                                             handle->current->subsystem,
-                                             handle->current->name));
+  off = fill_set_message (handle->current, buf);
   GNUNET_assert (NULL == handle->current->cont);
   free_action_item (handle->current);
   handle->current = NULL;
+  while ( (NULL != (ai = handle->action_head)) &&
+          ( (ACTION_SET == ai->type) ||
+            (ACTION_UPDATE == ai->type) ) &&
+          (size - off >= ai->msize) )
+  {
+    dequeue_action (handle, ai);
+    off += fill_set_message (ai, &((char *) buf)[off]);
+    free_action_item (ai);
+  }
   update_memory_statistics (handle);
-  return nsize;
+  return off;
 }
 
 
@@ -968,6 +1045,7 @@ GNUNET_STATISTICS_create (const char *subsystem,
   ret->cfg = cfg;
   ret->subsystem = GNUNET_strdup (subsystem);
   ret->backoff = GNUNET_TIME_UNIT_MILLISECONDS;
+  ret->pending_setters = GNUNET_CONTAINER_multihashmap_create (16, GNUNET_NO);
   return ret;
 }
 
@@ -997,6 +1075,11 @@ GNUNET_STATISTICS_destroy (struct GNUNET_STATISTICS_Handle *h,
     GNUNET_SCHEDULER_cancel (h->backoff_task);
     h->backoff_task = GNUNET_SCHEDULER_NO_TASK;
   }
+  if (GNUNET_SCHEDULER_NO_TASK != h->flush_task)
+  {
+    GNUNET_SCHEDULER_cancel (h->flush_task);
+    h->flush_task = GNUNET_SCHEDULER_NO_TASK;
+  }
   if (sync_first)
   {
     if (NULL != h->current)
@@ -1026,9 +1109,10 @@ GNUNET_STATISTICS_destroy (struct GNUNET_STATISTICS_Handle *h,
     }
     if ( (NULL == h->current) &&
 	 (NULL != (h->current = h->action_head)) )
-      GNUNET_CONTAINER_DLL_remove (h->action_head,
-				   h->action_tail,
-				   h->current);
+      dequeue_action (h, h->current);
+    if ( (NULL != h->current) &&
+         (NULL == h->client) )
+      (void) try_connect (h); /* flush task may not have connected us yet */
     h->do_destroy = GNUNET_YES;
     if ((NULL != h->current) && (NULL == h->th) &&
 	(NULL != h->client))
@@ -1045,9 +1129,7 @@ GNUNET_STATISTICS_destroy (struct GNUNET_STATISTICS_Handle *h,
   }
   while (NULL != (pos = h->action_head))
   {
-    GNUNET_CONTAINER_DLL_remove (h->action_head,
-				 h->action_tail,
-				 pos);
+    dequeue_action (h, pos);
     free_action_item (pos);
   }
   do_disconnect (h);
@@ -1060,6 +1142,7 @@ GNUNET_STATISTICS_destroy (struct GNUNET_STATISTICS_Handle *h,
     GNUNET_free (h->watches[i]);
   }
   GNUNET_array_grow (h->watches, h->watches_size, 0);
+  GNUNET_CONTAINER_multihashmap_destroy (h->pending_setters);
   GNUNET_free (h->subsystem);
   GNUNET_free (h);
 }
@@ -1141,7 +1224,7 @@ schedule_action (struct GNUNET_STATISTICS_Handle *h)
     }
     return;
   }
-  GNUNET_CONTAINER_DLL_remove (h->action_head, h->action_tail, h->current);
+  dequeue_action (h, h->current);
   timeout = GNUNET_TIME_absolute_get_remaining (h->current->timeout);
   if (NULL ==
       (h->th =
@@ -1340,6 +1423,24 @@ GNUNET_STATISTICS_watch_cancel (struct GNUNET_STATISTICS_Handle *handle,
 
 
 
+/**
+ * Transmit the SET and UPDATE requests accumulated since the
+ * last flush.
+ *
+ * @param cls the `struct GNUNET_STATISTICS_Handle`
+ * @param tc scheduler context (unused)
+ */
+static void
+flush_task (void *cls,
+            const struct GNUNET_SCHEDULER_TaskContext *tc)
+{
+  struct GNUNET_STATISTICS_Handle *h = cls;
+
+  h->flush_task = GNUNET_SCHEDULER_NO_TASK;
+  schedule_action (h);
+}
+
+
 /**
  * Queue a request to change a statistic.
  *
@@ -1357,6 +1458,7 @@ add_setter_action (struct GNUNET_STATISTICS_Handle *h,
                    enum ActionType type)
 {
   struct GNUNET_STATISTICS_GetHandle *ai;
+  struct GNUNET_HashCode name_hash;
   size_t slen;
   size_t nlen;
   size_t nsize;
@@ -1370,13 +1472,11 @@ add_setter_action (struct GNUNET_STATISTICS_Handle *h,
     GNUNET_break (0);
     return;
   }
-  for (ai = h->action_head; NULL != ai; ai = ai->next)
+  GNUNET_CRYPTO_hash (name, nlen - 1, &name_hash);
+  ai = GNUNET_CONTAINER_multihashmap_get (h->pending_setters, &name_hash);
+  if (NULL != ai)
   {
-    if (! ( (0 == strcmp (ai->subsystem, h->subsystem)) &&
-	    (0 == strcmp (ai->name, name)) &&
-	    ( (ACTION_UPDATE == ai->type) ||
-	      (ACTION_SET == ai->type) ) ) )
-      continue;
+    GNUNET_break (0 == strcmp (ai->name, name));
     if (ACTION_SET == ai->type)
     {
       if (ACTION_UPDATE == type)
@@ -1431,9 +1531,16 @@ add_setter_action (struct GNUNET_STATISTICS_Handle *h,
   ai->msize = nsize;
   ai->value = value;
   ai->type = type;
+  ai->name_hash = name_hash;
   GNUNET_CONTAINER_DLL_insert_tail (h->action_head, h->action_tail,
 				    ai);
-  schedule_action (h);
+  GNUNET_assert (GNUNET_OK ==
+                 GNUNET_CONTAINER_multihashmap_put (h->pending_setters,
+                                                    &name_hash, ai,
+                                                    GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_ONLY));
+  if (GNUNET_SCHEDULER_NO_TASK == h->flush_task)
+    h->flush_task = GNUNET_SCHEDULER_add_delayed (SET_FLUSH_DELAY,
+                                                  &flush_task, h);
 }
 
 
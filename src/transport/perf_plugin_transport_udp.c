@@ -0,0 +1,474 @@
+/*
+ This file is part of GNUnet.
+ (C) 2014 Christian Grothoff (and other contributing authors)
+
+ GNUnet is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published
+ by the Free Software Foundation; either version 3, or (at your
+ option) any later version.
+
+ GNUnet is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with GNUnet; see the file COPYING.  If not, write to the
+ Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ Boston, MA 02111-1307, USA.
+ */
+/**
+ * @file transport/perf_plugin_transport_udp.c
+ * @brief measure the throughput of the UDP plugin on loopback, with
+ *        and without batched datagram I/O; the plugin sends messages
+ *        to its own address
+ */
+#include "platform.h"
+#include "gnunet_util_lib.h"
+#include "gnunet_hello_lib.h"
+#include "gnunet_protocols.h"
+#include "gnunet_transport_plugin.h"
+#include "plugin_transport_udp.h"
+#include <gauger.h>
+
+/**
+ * Default number of messages we send per round.
+ */
+#define DEFAULT_MESSAGES 50000
+
+/**
+ * Size of each message (including the header).
+ */
+#define MESSAGE_SIZE 1024
+
+/**
+ * Maximum number of messages queued in the plugin at any time.
+ */
+#define WINDOW 256
+
+/**
+ * Message type we use.
+ */
+#define MTYPE 12345
+
+/**
+ * How long do we wait for messages still in flight after the last
+ * transmission completed?
+ */
+#define GRACE GNUNET_TIME_relative_multiply (GNUNET_TIME_UNIT_MILLISECONDS, 250)
+
+/**
+ * Give up on a round after this time.
+ */
+#define TIMEOUT GNUNET_TIME_relative_multiply (GNUNET_TIME_UNIT_MINUTES, 2)
+
+
+/**
+ * Our configuration.
+ */
+static const struct GNUNET_CONFIGURATION_Handle *cfg;
+
+/**
+ * Configuration for the current round.
+ */
+static struct GNUNET_CONFIGURATION_Handle *round_cfg;
+
+/**
+ * Environment for the plugin.
+ */
+static struct GNUNET_TRANSPORT_PluginEnvironment env;
+
+/**
+ * Our (fake) identity.
+ */
+static struct GNUNET_PeerIdentity my_identity;
+
+/**
+ * Our HELLO.
+ */
+static struct GNUNET_HELLO_Message *hello;
+
+/**
+ * The plugin.
+ */
+static struct GNUNET_TRANSPORT_PluginFunctions *api;
+
+/**
+ * Session to our own address.
+ */
+static struct Session *session;
+
+/**
+ * The message we send.
+ */
+static char msgbuf[MESSAGE_SIZE];
+
+/**
+ * Number of messages to send per round.
+ */
+static unsigned int num_messages;
+
+/**
+ * Number of messages passed to the plugin in this round.
+ */
+static unsigned int sent;
+
+/**
+ * Number of transmissions completed in this round.
+ */
+static unsigned int done;
+
+/**
+ * Number of messages received in this round.
+ */
+static unsigned int received;
+
+/**
+ * Is batched I/O enabled in this round?
+ */
+static int batch_io;
+
+/**
+ * When did the round start?
+ */
+static struct GNUNET_TIME_Absolute start_time;
+
+/**
+ * When did we receive the last message?
+ */
+static struct GNUNET_TIME_Absolute last_receive;
+
+/**
+ * Task that ends the round.
+ */
+static GNUNET_SCHEDULER_TaskIdentifier end_task;
+
+/**
+ * Return value from main.
+ */
+static int ok;
+
+
+static void
+start_round (void *cls,
+             const struct GNUNET_SCHEDULER_TaskContext *tc);
+
+
+/**
+ * Report the results of the round, unload the plugin and start the
+ * next round (if any).
+ *
+ * @param cls NULL
+ * @param tc scheduler context
+ */
+static void
+end_round (void *cls,
+           const struct GNUNET_SCHEDULER_TaskContext *tc)
+{
+  struct GNUNET_TRANSPORT_PluginFunctions *p;
+  struct GNUNET_TIME_Relative duration;
+  unsigned long long rate;
+  char name[64];
+
+  end_task = GNUNET_SCHEDULER_NO_TASK;
+  duration = GNUNET_TIME_absolute_get_difference (start_time, last_receive);
+  rate = received * 1000LL * 1000LL / (1 + duration.rel_value_us);
+  printf ("%s I/O: received %u of %u messages in %s (%llu messages/s, %llu KiB/s)\n",
+          (GNUNET_YES == batch_io) ? "Batched" : "Single",
+          received,
+          num_messages,
+          GNUNET_STRINGS_relative_time_to_string (duration, GNUNET_YES),
+          rate,
+          rate * MESSAGE_SIZE / 1024);
+  GNUNET_snprintf (name, sizeof (name),
+                   "UDP plugin loopback throughput (%s I/O)",
+                   (GNUNET_YES == batch_io) ? "batched" : "single");
+  GAUGER ("TRANSPORT", name, rate * MESSAGE_SIZE / 1024, "kb/s");
+  if (done < num_messages)
+  {
+    FPRINTF (stderr,
+             "Only %u of %u transmissions completed\n",
+             done,
+             num_messages);
+    ok = 1;
+  }
+  /* unloading fails pending transmissions, do not send more then */
+  p = api;
+  api = NULL;
+  session = NULL;
+  GNUNET_break (NULL ==
+                GNUNET_PLUGIN_unload ("libgnunet_plugin_transport_udp", p));
+  GNUNET_CONFIGURATION_destroy (round_cfg);
+  round_cfg = NULL;
+  if (GNUNET_YES == batch_io)
+  {
+    batch_io = GNUNET_NO;
+    GNUNET_SCHEDULER_add_now (&start_round, NULL);
+    return;
+  }
+  GNUNET_free (hello);
+  hello = NULL;
+}
+
+
+/**
+ * Give more messages to the plugin, keeping at most #WINDOW queued.
+ */
+static void
+send_more (void);
+
+
+/**
+ * A transmission completed.
+ *
+ * @param cls NULL
+ * @param target our identity
+ * @param result #GNUNET_OK on success
+ * @param size_payload bytes of payload
+ * @param size_on_wire bytes on the wire
+ */
+static void
+transmit_cont (void *cls,
+               const struct GNUNET_PeerIdentity *target,
+               int result,
+               size_t size_payload,
+               size_t size_on_wire)
+{
+  if (NULL == api)
+    return;
+  done++;
+  if (GNUNET_OK != result)
+    GNUNET_break (0);
+  if (done == num_messages)
+  {
+    /* wait a bit for the last messages to arrive */
+    if (GNUNET_SCHEDULER_NO_TASK != end_task)
+      GNUNET_SCHEDULER_cancel (end_task);
+    end_task = GNUNET_SCHEDULER_add_delayed (GRACE, &end_round, NULL);
+    return;
+  }
+  send_more ();
+}
+
+
+static void
+send_more ()
+{
+  while ( (sent < num_messages) &&
+          (sent - done < WINDOW) )
+  {
+    sent++;
+    if (-1 == api->send (api->cls, session,
+                         msgbuf, sizeof (msgbuf),
+                         0, TIMEOUT,
+                         &transmit_cont, NULL))
+    {
+      GNUNET_break (0);
+      done++;
+    }
+  }
+}
+
+
+static struct GNUNET_TIME_Relative
+env_receive (void *cls,
+             const struct GNUNET_HELLO_Address *address,
+             struct Session *session,
+             const struct GNUNET_MessageHeader *message)
+{
+  if (MTYPE == ntohs (message->type))
+  {
+    received++;
+    last_receive = GNUNET_TIME_absolute_get ();
+    if ( (received == num_messages) &&
+         (GNUNET_SCHEDULER_NO_TASK != end_task) )
+    {
+      GNUNET_SCHEDULER_cancel (end_task);
+      end_task = GNUNET_SCHEDULER_add_now (&end_round, NULL);
+    }
+  }
+  return GNUNET_TIME_UNIT_ZERO;
+}
+
+
+static void
+env_notify_address (void *cls,
+                    int add_remove,
+                    const struct GNUNET_HELLO_Address *address)
+{
+  /* do nothing */
+}
+
+
+static struct GNUNET_ATS_Information
+env_get_address_type (void *cls,
+                      const struct sockaddr *addr,
+                      size_t addrlen)
+{
+  struct GNUNET_ATS_Information ats;
+
+  ats.type = htonl (GNUNET_ATS_NETWORK_TYPE);
+  ats.value = htonl (GNUNET_ATS_NET_LOOPBACK);
+  return ats;
+}
+
+
+static const struct GNUNET_MessageHeader *
+env_get_our_hello ()
+{
+  return (const struct GNUNET_MessageHeader *) hello;
+}
+
+
+static void
+env_session_start (void *cls,
+                   struct GNUNET_HELLO_Address *address,
+                   struct Session *session,
+                   const struct GNUNET_ATS_Information *ats,
+                   uint32_t ats_count)
+{
+  /* do nothing */
+}
+
+
+static void
+env_session_end (void *cls,
+                 const struct GNUNET_HELLO_Address *address,
+                 struct Session *session)
+{
+  /* do nothing */
+}
+
+
+static void
+env_update_metrics (void *cls,
+                    const struct GNUNET_HELLO_Address *address,
+                    struct Session *session,
+                    const struct GNUNET_ATS_Information *ats,
+                    uint32_t ats_count)
+{
+  /* do nothing */
+}
+
+
+/**
+ * Load the plugin with batched I/O enabled or disabled, connect to
+ * our own address and start sending.
+ *
+ * @param cls NULL
+ * @param tc scheduler context
+ */
+static void
+start_round (void *cls,
+             const struct GNUNET_SCHEDULER_TaskContext *tc)
+{
+  struct GNUNET_HELLO_Address *address;
+  struct IPv4UdpAddress u4;
+  unsigned long long port;
+
+  round_cfg = GNUNET_CONFIGURATION_dup (cfg);
+  GNUNET_CONFIGURATION_set_value_string (round_cfg, "transport-udp",
+                                         "BATCH_IO",
+                                         (GNUNET_YES == batch_io) ? "YES" : "NO");
+  GNUNET_CONFIGURATION_set_value_string (round_cfg, "transport-udp",
+                                         "BROADCAST", "NO");
+  if (GNUNET_OK !=
+      GNUNET_CONFIGURATION_get_value_number (round_cfg, "transport-udp",
+                                             "PORT", &port))
+    port = 2086;
+  memset (&env, 0, sizeof (env));
+  env.cfg = round_cfg;
+  env.cls = &env;
+  env.my_identity = &my_identity;
+  env.max_connections = 16;
+  env.receive = &env_receive;
+  env.notify_address = &env_notify_address;
+  env.get_address_type = &env_get_address_type;
+  env.update_address_metrics = &env_update_metrics;
+  env.get_our_hello = &env_get_our_hello;
+  env.session_start = &env_session_start;
+  env.session_end = &env_session_end;
+  api = GNUNET_PLUGIN_load ("libgnunet_plugin_transport_udp", &env);
+  if (NULL == api)
+  {
+    FPRINTF (stderr, "%s", "Failed to load UDP plugin\n");
+    GNUNET_CONFIGURATION_destroy (round_cfg);
+    ok = 1;
+    return;
+  }
+  memset (&u4, 0, sizeof (u4));
+  u4.ipv4_addr = htonl (INADDR_LOOPBACK);
+  u4.u4_port = htons ((uint16_t) port);
+  address = GNUNET_HELLO_address_allocate (&my_identity, "udp",
+                                           &u4, sizeof (u4),
+                                           GNUNET_HELLO_ADDRESS_INFO_NONE);
+  session = api->get_session (api->cls, address);
+  GNUNET_HELLO_address_free (address);
+  if (NULL == session)
+  {
+    GNUNET_break (0);
+    ok = 1;
+    return;
+  }
+  sent = 0;
+  done = 0;
+  received = 0;
+  start_time = GNUNET_TIME_absolute_get ();
+  last_receive = start_time;
+  end_task = GNUNET_SCHEDULER_add_delayed (TIMEOUT, &end_round, NULL);
+  send_more ();
+}
+
+
+static void
+run (void *cls, char * const *args, const char *cfgfile,
+     const struct GNUNET_CONFIGURATION_Handle *c)
+{
+  struct GNUNET_MessageHeader *hdr;
+
+  cfg = c;
+  GNUNET_CRYPTO_random_block (GNUNET_CRYPTO_QUALITY_WEAK,
+                              &my_identity, sizeof (my_identity));
+  hello = GNUNET_HELLO_create (&my_identity.public_key, NULL, NULL, GNUNET_NO);
+  hdr = (struct GNUNET_MessageHeader *) msgbuf;
+  memset (msgbuf, 42, sizeof (msgbuf));
+  hdr->size = htons (sizeof (msgbuf));
+  hdr->type = htons (MTYPE);
+  batch_io = GNUNET_YES;
+  start_round (NULL, NULL);
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  static struct GNUNET_GETOPT_CommandLineOption options[] = {
+    GNUNET_GETOPT_OPTION_END
+  };
+  char *const argv_prog[] = {
+    "perf_plugin_transport_udp",
+    "-c",
+    "test_plugin_transport_data.conf",
+    NULL
+  };
+
+  num_messages = DEFAULT_MESSAGES;
+  if ( (argc > 1) &&
+       ( (1 != sscanf (argv[1], "%u", &num_messages)) ||
+         (0 == num_messages) ) )
+  {
+    FPRINTF (stderr, "Usage: %s [MESSAGES]\n", argv[0]);
+    return 1;
+  }
+  GNUNET_DISK_directory_remove ("/tmp/test-gnunetd-plugin-transport");
+  GNUNET_log_setup ("perf-plugin-transport-udp", "WARNING", NULL);
+  ok = 0;
+  if (GNUNET_OK !=
+      GNUNET_PROGRAM_run (3, argv_prog, "perf-plugin-transport-udp",
+                          "nohelp", options, &run, NULL))
+    ok = 1;
+  GNUNET_DISK_directory_remove ("/tmp/test-gnunetd-plugin-transport");
+  return ok;
+}
+
+/* end of perf_plugin_transport_udp.c */
@@ -691,44 +691,9 @@ tcp_string_to_address (void *cls,
 
 
 /**
- * Closure for #session_lookup_by_client_it().
- */
-struct SessionClientCtx
-{
-  /**
-   * Client we are looking for.
-   */
-  const struct GNUNET_SERVER_Client *client;
-
-  /**
-   * Session that was found.
-   */
-  struct Session *ret;
-};
-
-
-static int
-session_lookup_by_client_it (void *cls,
-                             const struct GNUNET_PeerIdentity *key,
-                             void *value)
-{
-  struct SessionClientCtx *sc_ctx = cls;
-  struct Session *s = value;
-
-  if (s->client == sc_ctx->client)
-  {
-    sc_ctx->ret = s;
-    return GNUNET_NO;
-  }
-  return GNUNET_YES;
-}
-
-
-/**
- * Find the session handle for the given client.
- * Currently uses both the hashmap and the client
- * context, as the client context is new and the
- * logic still needs to be tested.
+ * Find the session handle for the given client.  The session is
+ * stored in the client context whenever a session is associated with
+ * a client, so this does not need to look at the session map.
  *
  * @param plugin the plugin
  * @param client which client to find the session handle for
@@ -739,16 +704,14 @@ lookup_session_by_client (struct Plugin *plugin,
                           struct GNUNET_SERVER_Client *client)
 {
   struct Session *ret;
-  struct SessionClientCtx sc_ctx;
 
   ret = GNUNET_SERVER_client_get_user_context (client, struct Session);
-  sc_ctx.client = client;
-  sc_ctx.ret = NULL;
-  GNUNET_CONTAINER_multipeermap_iterate (plugin->sessionmap,
-      &session_lookup_by_client_it, &sc_ctx);
-  /* check both methods yield the same result */
-  GNUNET_break(ret == sc_ctx.ret);
-  return sc_ctx.ret;
+  GNUNET_STATISTICS_update (plugin->env->stats,
+                            (NULL != ret)
+                            ? gettext_noop ("# TCP, sessions, client lookups hit")
+                            : gettext_noop ("# TCP, sessions, client lookups missed"),
+                            1, GNUNET_NO);
+  return ret;
 }
 
 
@@ -1363,8 +1326,16 @@ tcp_plugin_update_session_timeout (void *cls,
 {
   struct Plugin *plugin = cls;
 
-  if (GNUNET_SYSERR == find_session (plugin, session))
+  if ( (GNUNET_YES !=
+        GNUNET_CONTAINER_multipeermap_contains_value (plugin->sessionmap,
+                                                      peer, session)) &&
+       (GNUNET_YES !=
+        GNUNET_CONTAINER_multipeermap_contains_value (plugin->nat_wait_conns,
+                                                      peer, session)) )
+  {
+    GNUNET_break (0);
     return;
+  }
   reschedule_session_timeout (session);
 }
 
@@ -2002,7 +1973,6 @@ handle_tcp_nat_probe (void *cls, struct GNUNET_SERVER_Client *client,
   }
   GNUNET_assert(
       GNUNET_CONTAINER_multipeermap_remove (plugin->nat_wait_conns, &tcp_nat_probe->clientIdentity, session) == GNUNET_YES);
-  GNUNET_SERVER_client_set_user_context(client, session);
   GNUNET_CONTAINER_multipeermap_put (plugin->sessionmap, &session->target,
       session, GNUNET_CONTAINER_MULTIHASHMAPOPTION_MULTIPLE);
   session->last_activity = GNUNET_TIME_absolute_get ();
@@ -2044,6 +2014,8 @@ handle_tcp_nat_probe (void *cls, struct GNUNET_SERVER_Client *client,
   GNUNET_break(NULL == session->client);
   GNUNET_SERVER_client_keep (client);
   session->client = client;
+  /* only now, the error paths above free the session */
+  GNUNET_SERVER_client_set_user_context(client, session);
   GNUNET_STATISTICS_update (plugin->env->stats,
       gettext_noop ("# TCP sessions active"), 1, GNUNET_NO);
   process_pending_messages (session);
@@ -440,6 +440,36 @@ struct UDP_MessageWrapper
 };
 
 
+#if UDP_USE_MMSG
+/**
+ * Buffers for receiving a batch of datagrams with a single
+ * call to recvmmsg().
+ */
+struct UDP_ReceiveBatch
+{
+  /**
+   * Message headers passed to recvmmsg().
+   */
+  struct mmsghdr msgs[UDP_MMSG_BATCH];
+
+  /**
+   * I/O vectors, one per datagram.
+   */
+  struct iovec iov[UDP_MMSG_BATCH];
+
+  /**
+   * Sender addresses.
+   */
+  struct sockaddr_storage addrs[UDP_MMSG_BATCH];
+
+  /**
+   * Datagram buffers.
+   */
+  char bufs[UDP_MMSG_BATCH][65536] GNUNET_ALIGN;
+};
+#endif
+
+
 /**
  * UDP ACK Message-Packet header (after defragmentation).
  */
@@ -1101,6 +1131,107 @@ free_session (struct Session *s)
 }
 
 
+/**
+ * Compute the key under which a session with the given UDP address
+ * is stored in the `sessions_by_sockaddr` index.  Only the address
+ * family, IP address and port are used; the options are ignored.
+ * This runs for every received packet, so instead of hashing we
+ * copy these fields into the key and put a CRC of them into the
+ * first word (which the map uses to pick the bucket).
+ *
+ * @param addr either a `struct IPv4UdpAddress` or a `struct IPv6UdpAddress`
+ * @param addrlen number of bytes in @a addr
+ * @param key where to write the key
+ * @return #GNUNET_OK on success, #GNUNET_SYSERR if @a addrlen is invalid
+ */
+static int
+udp_address_to_sockaddr_key (const void *addr,
+                             size_t addrlen,
+                             struct GNUNET_HashCode *key)
+{
+  const struct IPv4UdpAddress *u4;
+  const struct IPv6UdpAddress *u6;
+  struct
+  {
+    uint16_t family;
+    uint16_t port;
+    struct in6_addr ip;
+  } k;
+
+  memset (&k, 0, sizeof (k));
+  if (sizeof (struct IPv4UdpAddress) == addrlen)
+  {
+    u4 = addr;
+    k.family = AF_INET;
+    k.port = u4->u4_port;
+    memcpy (&k.ip, &u4->ipv4_addr, sizeof (u4->ipv4_addr));
+  }
+  else if (sizeof (struct IPv6UdpAddress) == addrlen)
+  {
+    u6 = addr;
+    k.family = AF_INET6;
+    k.port = u6->u6_port;
+    k.ip = u6->ipv6_addr;
+  }
+  else
+  {
+    GNUNET_break (0);
+    return GNUNET_SYSERR;
+  }
+  memset (key, 0, sizeof (*key));
+  key->bits[0] = GNUNET_CRYPTO_crc32_n (&k, sizeof (k));
+  memcpy (&key->bits[1], &k, sizeof (k));
+  return GNUNET_OK;
+}
+
+
+/**
+ * Add a session to the `sessions_by_sockaddr` index.
+ *
+ * @param plugin the plugin
+ * @param s session to add
+ */
+static void
+sockaddr_index_add (struct Plugin *plugin,
+                    struct Session *s)
+{
+  struct GNUNET_HashCode key;
+
+  if (GNUNET_OK !=
+      udp_address_to_sockaddr_key (s->address->address,
+                                   s->address->address_length,
+                                   &key))
+    return;
+  GNUNET_assert (GNUNET_OK ==
+                 GNUNET_CONTAINER_multihashmap_put (plugin->sessions_by_sockaddr,
+                                                    &key, s,
+                                                    GNUNET_CONTAINER_MULTIHASHMAPOPTION_MULTIPLE));
+}
+
+
+/**
+ * Remove a session from the `sessions_by_sockaddr` index.
+ *
+ * @param plugin the plugin
+ * @param s session to remove
+ */
+static void
+sockaddr_index_remove (struct Plugin *plugin,
+                       struct Session *s)
+{
+  struct GNUNET_HashCode key;
+
+  if (GNUNET_OK !=
+      udp_address_to_sockaddr_key (s->address->address,
+                                   s->address->address_length,
+                                   &key))
+    return;
+  GNUNET_break (GNUNET_YES ==
+                GNUNET_CONTAINER_multihashmap_remove (plugin->sessions_by_sockaddr,
+                                                      &key, s));
+}
+
+
 static void
 dequeue (struct Plugin *plugin,
          struct UDP_MessageWrapper * udpw)
@@ -1116,6 +1247,15 @@ dequeue (struct Plugin *plugin,
   }
   GNUNET_STATISTICS_update (plugin->env->stats, "# UDP, total, msgs in buffers",
       -1, GNUNET_NO);
+#if UDP_USE_MMSG
+  {
+    unsigned int i;
+
+    for (i = 0; i < plugin->sbatch_size; i++)
+      if (plugin->sbatch[i] == udpw)
+        plugin->sbatch[i] = NULL;
+  }
+#endif
   if (udpw->session->address->address_length == sizeof(struct IPv4UdpAddress))
     GNUNET_CONTAINER_DLL_remove(plugin->ipv4_queue_head,
         plugin->ipv4_queue_tail, udpw);
@@ -1305,6 +1445,7 @@ udp_disconnect_session (void *cls, struct Session *s)
 
   GNUNET_assert(
       GNUNET_YES == GNUNET_CONTAINER_multipeermap_remove (plugin->sessions, &s->target, s));
+  sockaddr_index_remove (plugin, s);
   GNUNET_STATISTICS_set (plugin->env->stats, "# UDP sessions active",
       GNUNET_CONTAINER_multipeermap_size (plugin->sessions), GNUNET_NO);
   if (s->rc > 0)
@@ -1592,6 +1733,7 @@ udp_plugin_create_session (void *cls,
       udp_address_to_string( NULL,address->address,address->address_length));
   GNUNET_assert(
       GNUNET_OK == GNUNET_CONTAINER_multipeermap_put (plugin->sessions, &s->target, s, GNUNET_CONTAINER_MULTIHASHMAPOPTION_MULTIPLE));
+  sockaddr_index_add (plugin, s);
   GNUNET_STATISTICS_set (plugin->env->stats, "# UDP sessions active",
       GNUNET_CONTAINER_multipeermap_size (plugin->sessions), GNUNET_NO);
   return s;
@@ -2086,14 +2228,15 @@ struct LookupContext
   struct Session *res;
 
   /**
-   * The socket address
+   * The UDP address (`struct IPv4UdpAddress` or `struct IPv6UdpAddress`)
+   * corresponding to the socket address
    */
-  const struct sockaddr *address;
+  const void *arg;
 
   /**
-   * The socket address length
+   * Number of bytes in @e arg
    */
-  size_t addr_len;
+  size_t args;
 
   /**
    * Is a fragmentation context required for the session
@@ -2102,56 +2245,96 @@ struct LookupContext
 };
 
 
+/**
+ * Check if a session from the `sessions_by_sockaddr` index matches
+ * the address we are looking for.
+ *
+ * @param cls the `struct LookupContext`
+ * @param key hash of the socket address (unused)
+ * @param value a `struct Session`
+ * @return #GNUNET_NO if we found the session, #GNUNET_YES to continue
+ */
 static int
 lookup_session_by_sockaddr_it (void *cls,
-                               const struct GNUNET_PeerIdentity *key,
+                               const struct GNUNET_HashCode *key,
                                void *value)
 {
   struct LookupContext *l_ctx = cls;
-  struct Session * s = value;
+  struct Session *s = value;
+
+  if ((GNUNET_YES == l_ctx->must_have_frag_ctx) && (NULL == s->frag_ctx))
+    return GNUNET_YES;
+
+  /* Does not compare peer identities but addresses */
+  if ((l_ctx->args == s->address->address_length) &&
+      (0 == memcmp (l_ctx->arg, s->address->address, l_ctx->args)))
+  {
+    l_ctx->res = s;
+    return GNUNET_NO;
+  }
+  return GNUNET_YES;
+}
+
+
+/**
+ * Find the session for the given socket address, irrespective of
+ * the peer identity.
+ *
+ * @param plugin the plugin
+ * @param address the socket address
+ * @param addr_len number of bytes in @a address
+ * @param must_have_frag_ctx #GNUNET_YES to only consider sessions
+ *        with a fragmentation context
+ * @return NULL if no matching session exists
+ */
+static struct Session *
+lookup_session_by_sockaddr (struct Plugin *plugin,
+                            const struct sockaddr *address,
+                            socklen_t addr_len,
+                            int must_have_frag_ctx)
+{
+  struct LookupContext l_ctx;
+  struct GNUNET_HashCode key;
   struct IPv4UdpAddress u4;
   struct IPv6UdpAddress u6;
-  void *arg;
-  size_t args;
 
   /* convert address */
-  switch (l_ctx->address->sa_family)
+  switch (address->sa_family)
   {
   case AF_INET:
-    GNUNET_assert(l_ctx->addr_len == sizeof(struct sockaddr_in));
+    GNUNET_assert(addr_len == sizeof(struct sockaddr_in));
     memset (&u4, 0, sizeof(u4));
-    u6.options = htonl (0);
-    u4.ipv4_addr = ((struct sockaddr_in *) l_ctx->address)->sin_addr.s_addr;
-    u4.u4_port = ((struct sockaddr_in *) l_ctx->address)->sin_port;
-    arg = &u4;
-    args = sizeof(u4);
+    u4.ipv4_addr = ((struct sockaddr_in *) address)->sin_addr.s_addr;
+    u4.u4_port = ((struct sockaddr_in *) address)->sin_port;
+    l_ctx.arg = &u4;
+    l_ctx.args = sizeof(u4);
     break;
   case AF_INET6:
-    GNUNET_assert(l_ctx->addr_len == sizeof(struct sockaddr_in6));
+    GNUNET_assert(addr_len == sizeof(struct sockaddr_in6));
     memset (&u6, 0, sizeof(u6));
-    u6.options = htonl (0);
-    u6.ipv6_addr = ((struct sockaddr_in6 *) l_ctx->address)->sin6_addr;
-    u6.u6_port = ((struct sockaddr_in6 *) l_ctx->address)->sin6_port;
-    arg = &u6;
-    args = sizeof(u6);
+    u6.ipv6_addr = ((struct sockaddr_in6 *) address)->sin6_addr;
+    u6.u6_port = ((struct sockaddr_in6 *) address)->sin6_port;
+    l_ctx.arg = &u6;
+    l_ctx.args = sizeof(u6);
     break;
   default:
     GNUNET_break(0);
-    return GNUNET_YES;
-  }
-
-
-  if ((GNUNET_YES == l_ctx->must_have_frag_ctx) && (NULL == s->frag_ctx))
-    return GNUNET_YES;
-
-  /* Does not compare peer identities but addresses */
-  if ((args == s->address->address_length) &&
-      (0 == memcmp (arg, s->address->address, args)))
-  {
-    l_ctx->res = s;
-    return GNUNET_YES;
+    return NULL;
   }
-  return GNUNET_YES;
+  l_ctx.res = NULL;
+  l_ctx.must_have_frag_ctx = must_have_frag_ctx;
+  if (GNUNET_OK != udp_address_to_sockaddr_key (l_ctx.arg, l_ctx.args, &key))
+    return NULL;
+  GNUNET_CONTAINER_multihashmap_get_multiple (plugin->sessions_by_sockaddr,
+                                              &key,
+                                              &lookup_session_by_sockaddr_it,
+                                              &l_ctx);
+  GNUNET_STATISTICS_update (plugin->env->stats,
+                            (NULL != l_ctx.res)
+                            ? gettext_noop ("# UDP, sessions, address lookups hit")
+                            : gettext_noop ("# UDP, sessions, address lookups missed"),
+                            1, GNUNET_NO);
+  return l_ctx.res;
 }
 
 
@@ -2171,15 +2354,9 @@ ack_proc (void *cls, uint32_t id, const struct GNUNET_MessageHeader *msg)
   uint32_t delay = 0;
   struct UDP_MessageWrapper *udpw;
   struct Session *s;
-  struct LookupContext l_ctx;
 
-  l_ctx.address = rc->src_addr;
-  l_ctx.addr_len = rc->addr_len;
-  l_ctx.must_have_frag_ctx = GNUNET_NO;
-  l_ctx.res = NULL;
-  GNUNET_CONTAINER_multipeermap_iterate (rc->plugin->sessions,
-      &lookup_session_by_sockaddr_it, &l_ctx);
-  s = l_ctx.res;
+  s = lookup_session_by_sockaddr (rc->plugin, rc->src_addr, rc->addr_len,
+                                  GNUNET_NO);
   if (NULL == s)
   {
     GNUNET_log (GNUNET_ERROR_TYPE_ERROR,
@@ -2239,7 +2416,6 @@ read_process_ack (struct Plugin *plugin,
 {
   const struct GNUNET_MessageHeader *ack;
   const struct UDP_ACK_Message *udp_ack;
-  struct LookupContext l_ctx;
   struct Session *s;
   struct GNUNET_TIME_Relative flow_delay;
 
@@ -2252,13 +2428,7 @@ read_process_ack (struct Plugin *plugin,
   udp_ack = (const struct UDP_ACK_Message *) msg;
 
   /* Lookup session based on sockaddr */
-  l_ctx.address = addr;
-  l_ctx.addr_len = fromlen;
-  l_ctx.res = NULL;
-  l_ctx.must_have_frag_ctx = GNUNET_YES;
-  GNUNET_CONTAINER_multipeermap_iterate (plugin->sessions,
-      &lookup_session_by_sockaddr_it, &l_ctx);
-  s = l_ctx.res;
+  s = lookup_session_by_sockaddr (plugin, addr, fromlen, GNUNET_YES);
   if ((NULL == s) || (NULL == s->frag_ctx))
   {
     return;
@@ -2277,7 +2447,7 @@ read_process_ack (struct Plugin *plugin,
   }
 
   if (0
-      != memcmp (&l_ctx.res->target, &udp_ack->sender,
+      != memcmp (&s->target, &udp_ack->sender,
           sizeof(struct GNUNET_PeerIdentity)))
     GNUNET_break(0);
   if (GNUNET_OK != GNUNET_FRAGMENT_process_ack (s->frag_ctx->frag, ack))
@@ -2364,46 +2534,23 @@ read_process_fragment (struct Plugin *plugin,
 
 
 /**
- * Read and process a message from the given socket.
+ * Process a datagram we received.
  *
  * @param plugin the overall plugin
- * @param rsock socket to read from
+ * @param buf the datagram
+ * @param size number of bytes in @a buf
+ * @param addr address of the sender
+ * @param fromlen number of bytes in @a addr
  */
 static void
-udp_select_read (struct Plugin *plugin,
-                 struct GNUNET_NETWORK_Handle *rsock)
+process_datagram (struct Plugin *plugin,
+                  const char *buf,
+                  ssize_t size,
+                  const struct sockaddr_storage *addr,
+                  socklen_t fromlen)
 {
-  socklen_t fromlen;
-  struct sockaddr_storage addr;
-  char buf[65536] GNUNET_ALIGN;
-  ssize_t size;
   const struct GNUNET_MessageHeader *msg;
 
-  fromlen = sizeof(addr);
-  memset (&addr, 0, sizeof(addr));
-  size = GNUNET_NETWORK_socket_recvfrom (rsock, buf, sizeof(buf),
-      (struct sockaddr *) &addr, &fromlen);
-#if MINGW
-  /* On SOCK_DGRAM UDP sockets recvfrom might fail with a
-   * WSAECONNRESET error to indicate that previous sendto() (yes, sendto!)
-   * on this socket has failed.
-   * Quote from MSDN:
-   *   WSAECONNRESET - The virtual circuit was reset by the remote side
-   *   executing a hard or abortive close. The application should close
-   *   the socket; it is no longer usable. On a UDP-datagram socket this
-   *   error indicates a previous send operation resulted in an ICMP Port
-   *   Unreachable message.
-   */
-  if ( (-1 == size) && (ECONNRESET == errno) )
-  return;
-#endif
-  if (-1 == size)
-  {
-    LOG(GNUNET_ERROR_TYPE_DEBUG, "UDP failed to receive data: %s\n",
-        STRERROR (errno));
-    /* Connection failure or something. Not a protocol violation. */
-    return;
-  }
   if (size < sizeof(struct GNUNET_MessageHeader))
   {
     LOG(GNUNET_ERROR_TYPE_WARNING,
@@ -2418,7 +2565,7 @@ udp_select_read (struct Plugin *plugin,
 
   LOG(GNUNET_ERROR_TYPE_DEBUG,
       "UDP received %u-byte message from `%s' type %u\n", (unsigned int ) size,
-      GNUNET_a2s ((const struct sockaddr * ) &addr, fromlen),
+      GNUNET_a2s ((const struct sockaddr * ) addr, fromlen),
       ntohs (msg->type));
 
   if (size != ntohs (msg->size))
@@ -2437,17 +2584,17 @@ udp_select_read (struct Plugin *plugin,
   {
   case GNUNET_MESSAGE_TYPE_TRANSPORT_BROADCAST_BEACON:
     if (GNUNET_YES == plugin->enable_broadcasting_receiving)
-      udp_broadcast_receive (plugin, buf, size, (const struct sockaddr *) &addr,
+      udp_broadcast_receive (plugin, buf, size, (const struct sockaddr *) addr,
           fromlen);
     return;
   case GNUNET_MESSAGE_TYPE_TRANSPORT_UDP_MESSAGE:
-    read_process_msg (plugin, msg, (const struct sockaddr *) &addr, fromlen);
+    read_process_msg (plugin, msg, (const struct sockaddr *) addr, fromlen);
     return;
   case GNUNET_MESSAGE_TYPE_TRANSPORT_UDP_ACK:
-    read_process_ack (plugin, msg, (const struct sockaddr *) &addr, fromlen);
+    read_process_ack (plugin, msg, (const struct sockaddr *) addr, fromlen);
     return;
   case GNUNET_MESSAGE_TYPE_FRAGMENT:
-    read_process_fragment (plugin, msg, (const struct sockaddr *) &addr,
+    read_process_fragment (plugin, msg, (const struct sockaddr *) addr,
         fromlen);
     return;
   default:
@@ -2457,6 +2604,113 @@ udp_select_read (struct Plugin *plugin,
 }
 
 
+#if UDP_USE_MMSG
+/**
+ * Read and process up to #UDP_MMSG_BATCH datagrams from the given
+ * socket with a single system call.
+ *
+ * @param plugin the overall plugin
+ * @param rsock socket to read from
+ * @return #GNUNET_OK on success (or transient errors),
+ *         #GNUNET_SYSERR if the system does not support recvmmsg()
+ */
+static int
+udp_select_read_batch (struct Plugin *plugin,
+                       struct GNUNET_NETWORK_Handle *rsock)
+{
+  struct UDP_ReceiveBatch *rb = plugin->rbatch;
+  unsigned int i;
+  int n;
+
+  for (i = 0; i < UDP_MMSG_BATCH; i++)
+  {
+    rb->iov[i].iov_base = rb->bufs[i];
+    rb->iov[i].iov_len = sizeof (rb->bufs[i]);
+    memset (&rb->msgs[i], 0, sizeof (struct mmsghdr));
+    rb->msgs[i].msg_hdr.msg_name = &rb->addrs[i];
+    rb->msgs[i].msg_hdr.msg_namelen = sizeof (rb->addrs[i]);
+    rb->msgs[i].msg_hdr.msg_iov = &rb->iov[i];
+    rb->msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+  n = recvmmsg (GNUNET_NETWORK_get_fd (rsock),
+                rb->msgs, UDP_MMSG_BATCH,
+                MSG_DONTWAIT, NULL);
+  if (-1 == n)
+  {
+    if (ENOSYS == errno)
+      return GNUNET_SYSERR;
+    LOG(GNUNET_ERROR_TYPE_DEBUG, "UDP failed to receive data: %s\n",
+        STRERROR (errno));
+    /* Connection failure or something. Not a protocol violation. */
+    return GNUNET_OK;
+  }
+  for (i = 0; i < (unsigned int) n; i++)
+    process_datagram (plugin,
+                      rb->bufs[i],
+                      rb->msgs[i].msg_len,
+                      &rb->addrs[i],
+                      rb->msgs[i].msg_hdr.msg_namelen);
+  return GNUNET_OK;
+}
+#endif
+
+
+/**
+ * Read and process a message (or, if supported, a batch of messages)
+ * from the given socket.
+ *
+ * @param plugin the overall plugin
+ * @param rsock socket to read from
+ */
+static void
+udp_select_read (struct Plugin *plugin,
+                 struct GNUNET_NETWORK_Handle *rsock)
+{
+  socklen_t fromlen;
+  struct sockaddr_storage addr;
+  char buf[65536] GNUNET_ALIGN;
+  ssize_t size;
+
+#if UDP_USE_MMSG
+  if (NULL != plugin->rbatch)
+  {
+    if (GNUNET_OK == udp_select_read_batch (plugin, rsock))
+      return;
+    LOG (GNUNET_ERROR_TYPE_INFO,
+         "recvmmsg() not supported by the kernel, disabling batched I/O\n");
+    GNUNET_free (plugin->rbatch);
+    plugin->rbatch = NULL;
+  }
+#endif
+  fromlen = sizeof(addr);
+  memset (&addr, 0, sizeof(addr));
+  size = GNUNET_NETWORK_socket_recvfrom (rsock, buf, sizeof(buf),
+      (struct sockaddr *) &addr, &fromlen);
+#if MINGW
+  /* On SOCK_DGRAM UDP sockets recvfrom might fail with a
+   * WSAECONNRESET error to indicate that previous sendto() (yes, sendto!)
+   * on this socket has failed.
+   * Quote from MSDN:
+   *   WSAECONNRESET - The virtual circuit was reset by the remote side
+   *   executing a hard or abortive close. The application should close
+   *   the socket; it is no longer usable. On a UDP-datagram socket this
+   *   error indicates a previous send operation resulted in an ICMP Port
+   *   Unreachable message.
+   */
+  if ( (-1 == size) && (ECONNRESET == errno) )
+  return;
+#endif
+  if (-1 == size)
+  {
+    LOG(GNUNET_ERROR_TYPE_DEBUG, "UDP failed to receive data: %s\n",
+        STRERROR (errno));
+    /* Connection failure or something. Not a protocol violation. */
+    return;
+  }
+  process_datagram (plugin, buf, size, &addr, fromlen);
+}
+
+
 static struct UDP_MessageWrapper *
 remove_timeout_messages_and_select (struct UDP_MessageWrapper *head,
                                     struct GNUNET_NETWORK_Handle *sock)
@@ -2616,68 +2870,75 @@ analyze_send_error (struct Plugin *plugin,
 }
 
 
-static size_t
-udp_select_send (struct Plugin *plugin,
-                 struct GNUNET_NETWORK_Handle *sock)
+/**
+ * Convert the address of the session of @a udpw to a socket address.
+ *
+ * @param udpw message to send
+ * @param ss where to write the address
+ * @return number of bytes used in @a ss, 0 if the address is malformed
+ */
+static socklen_t
+udpw_to_sockaddr (const struct UDP_MessageWrapper *udpw,
+                  struct sockaddr_storage *ss)
 {
-  ssize_t sent;
-  socklen_t slen;
-  struct sockaddr *a;
   const struct IPv4UdpAddress *u4;
-  struct sockaddr_in a4;
+  struct sockaddr_in *a4;
   const struct IPv6UdpAddress *u6;
-  struct sockaddr_in6 a6;
-  struct UDP_MessageWrapper *udpw;
-
-  /* Find message to send */
-  udpw = remove_timeout_messages_and_select ((sock == plugin->sockv4)
-                                             ? plugin->ipv4_queue_head
-                                             : plugin->ipv6_queue_head,
-                                             sock);
-  if (NULL == udpw)
-    return 0; /* No message to send */
+  struct sockaddr_in6 *a6;
 
   if (sizeof (struct IPv4UdpAddress) == udpw->session->address->address_length)
   {
     u4 = udpw->session->address->address;
-    memset (&a4, 0, sizeof(a4));
-    a4.sin_family = AF_INET;
+    a4 = (struct sockaddr_in *) ss;
+    memset (a4, 0, sizeof(struct sockaddr_in));
+    a4->sin_family = AF_INET;
 #if HAVE_SOCKADDR_IN_SIN_LEN
-    a4.sin_len = sizeof (a4);
+    a4->sin_len = sizeof (struct sockaddr_in);
 #endif
-    a4.sin_port = u4->u4_port;
-    memcpy (&a4.sin_addr, &u4->ipv4_addr, sizeof(struct in_addr));
-    a = (struct sockaddr *) &a4;
-    slen = sizeof (a4);
+    a4->sin_port = u4->u4_port;
+    memcpy (&a4->sin_addr, &u4->ipv4_addr, sizeof(struct in_addr));
+    return sizeof (struct sockaddr_in);
   }
-  else if (sizeof (struct IPv6UdpAddress) == udpw->session->address->address_length)
+  if (sizeof (struct IPv6UdpAddress) == udpw->session->address->address_length)
   {
     u6 = udpw->session->address->address;
-    memset (&a6, 0, sizeof(a6));
-    a6.sin6_family = AF_INET6;
+    a6 = (struct sockaddr_in6 *) ss;
+    memset (a6, 0, sizeof(struct sockaddr_in6));
+    a6->sin6_family = AF_INET6;
 #if HAVE_SOCKADDR_IN_SIN_LEN
-    a6.sin6_len = sizeof (a6);
+    a6->sin6_len = sizeof (struct sockaddr_in6);
 #endif
-    a6.sin6_port = u6->u6_port;
-    memcpy (&a6.sin6_addr, &u6->ipv6_addr, sizeof(struct in6_addr));
-    a = (struct sockaddr *) &a6;
-    slen = sizeof (a6);
-  }
-  else
-  {
-    call_continuation (udpw, GNUNET_OK);
-    dequeue (plugin, udpw);
-    GNUNET_free (udpw);
-    return GNUNET_SYSERR;
+    a6->sin6_port = u6->u6_port;
+    memcpy (&a6->sin6_addr, &u6->ipv6_addr, sizeof(struct in6_addr));
+    return sizeof (struct sockaddr_in6);
   }
+  return 0;
+}
 
-  sent = GNUNET_NETWORK_socket_sendto (sock, udpw->msg_buf, udpw->msg_size, a,
-      slen);
 
+/**
+ * We tried to transmit @a udpw.  Update statistics, notify the
+ * continuation and remove the message from the queue.
+ *
+ * @param plugin the plugin
+ * @param udpw the message
+ * @param a address the message was sent to
+ * @param slen number of bytes in @a a
+ * @param sent number of bytes sent, #GNUNET_SYSERR on failure
+ * @param error errno of the failure
+ */
+static void
+udp_send_done (struct Plugin *plugin,
+               struct UDP_MessageWrapper *udpw,
+               const struct sockaddr *a,
+               socklen_t slen,
+               ssize_t sent,
+               int error)
+{
   if (GNUNET_SYSERR == sent)
   {
     /* Failure */
-    analyze_send_error (plugin, a, slen, errno);
+    analyze_send_error (plugin, a, slen, error);
     call_continuation (udpw, GNUNET_SYSERR);
     GNUNET_STATISTICS_update (plugin->env->stats,
         "# UDP, total, bytes, sent, failure", sent, GNUNET_NO);
@@ -2702,8 +2963,168 @@ udp_select_send (struct Plugin *plugin,
   }
   dequeue (plugin, udpw);
   GNUNET_free(udpw);
-  udpw = NULL;
+}
+
 
+#if UDP_USE_MMSG
+/**
+ * Find the next message after @a udpw that can be transmitted right
+ * now, that is it neither timed out nor is delayed by the other peer.
+ * Timed out messages are left for #remove_timeout_messages_and_select.
+ *
+ * @param udpw message to start after
+ * @return NULL if there is no such message
+ */
+static struct UDP_MessageWrapper *
+next_sendable (struct UDP_MessageWrapper *udpw)
+{
+  for (udpw = udpw->next; NULL != udpw; udpw = udpw->next)
+  {
+    if (0 == GNUNET_TIME_absolute_get_remaining (udpw->timeout).rel_value_us)
+      continue;
+    if (0 == GNUNET_TIME_absolute_get_remaining (udpw->session->flow_delay_from_other_peer).rel_value_us)
+      return udpw;
+  }
+  return NULL;
+}
+
+
+/**
+ * Transmit up to #UDP_MMSG_BATCH queued messages with a single
+ * call to sendmmsg().
+ *
+ * @param plugin the plugin
+ * @param sock socket to send on
+ * @param sent set to the number of bytes transmitted
+ * @return #GNUNET_OK on success (or transient errors),
+ *         #GNUNET_SYSERR if the system does not support sendmmsg()
+ *         (nothing was sent)
+ */
+static int
+udp_select_send_batch (struct Plugin *plugin,
+                       struct GNUNET_NETWORK_Handle *sock,
+                       ssize_t *sent)
+{
+  struct mmsghdr msgs[UDP_MMSG_BATCH];
+  struct iovec iov[UDP_MMSG_BATCH];
+  struct sockaddr_storage addrs[UDP_MMSG_BATCH];
+  struct UDP_MessageWrapper *udpw;
+  socklen_t slen;
+  unsigned int n;
+  unsigned int i;
+  int ret;
+  int error;
+
+  /* Collect messages to send */
+  udpw = remove_timeout_messages_and_select ((sock == plugin->sockv4)
+                                             ? plugin->ipv4_queue_head
+                                             : plugin->ipv6_queue_head,
+                                             sock);
+  n = 0;
+  while ( (NULL != udpw) &&
+          (n < UDP_MMSG_BATCH) )
+  {
+    slen = udpw_to_sockaddr (udpw, &addrs[n]);
+    if (0 == slen)
+    {
+      if (n > 0)
+        break; /* send what we have, deal with this one next time */
+      call_continuation (udpw, GNUNET_OK);
+      dequeue (plugin, udpw);
+      GNUNET_free (udpw);
+      *sent = GNUNET_SYSERR;
+      return GNUNET_OK;
+    }
+    iov[n].iov_base = udpw->msg_buf;
+    iov[n].iov_len = udpw->msg_size;
+    memset (&msgs[n], 0, sizeof (struct mmsghdr));
+    msgs[n].msg_hdr.msg_name = &addrs[n];
+    msgs[n].msg_hdr.msg_namelen = slen;
+    msgs[n].msg_hdr.msg_iov = &iov[n];
+    msgs[n].msg_hdr.msg_iovlen = 1;
+    plugin->sbatch[n++] = udpw;
+    udpw = next_sendable (udpw);
+  }
+  *sent = 0;
+  if (0 == n)
+    return GNUNET_OK; /* No message to send */
+  ret = sendmmsg (GNUNET_NETWORK_get_fd (sock), msgs, n, 0);
+  error = errno;
+  if ( (-1 == ret) &&
+       (ENOSYS == error) )
+    return GNUNET_SYSERR;
+  /* Completing a message may dequeue others from our batch (i.e. if a
+     session is destroyed), which then clears their slot */
+  plugin->sbatch_size = n;
+  for (i = 0; i < n; i++)
+  {
+    if (NULL == (udpw = plugin->sbatch[i]))
+      continue;
+    plugin->sbatch[i] = NULL;
+    if ( (-1 == ret) && (0 == i) )
+    {
+      /* the first message failed, as with sendto() */
+      udp_send_done (plugin, udpw,
+                     (const struct sockaddr *) &addrs[i],
+                     msgs[i].msg_hdr.msg_namelen,
+                     GNUNET_SYSERR, error);
+      continue;
+    }
+    if (i >= (unsigned int) ret)
+      continue; /* not sent, keep it in the queue */
+    *sent += msgs[i].msg_len;
+    udp_send_done (plugin, udpw,
+                   (const struct sockaddr *) &addrs[i],
+                   msgs[i].msg_hdr.msg_namelen,
+                   msgs[i].msg_len, 0);
+  }
+  plugin->sbatch_size = 0;
+  return GNUNET_OK;
+}
+#endif
+
+
+static ssize_t
+udp_select_send (struct Plugin *plugin,
+                 struct GNUNET_NETWORK_Handle *sock)
+{
+  ssize_t sent;
+  socklen_t slen;
+  struct sockaddr_storage ss;
+  struct UDP_MessageWrapper *udpw;
+
+#if UDP_USE_MMSG
+  if (NULL != plugin->rbatch)
+  {
+    if (GNUNET_OK == udp_select_send_batch (plugin, sock, &sent))
+      return sent;
+    LOG (GNUNET_ERROR_TYPE_INFO,
+         "sendmmsg() not supported by the kernel, disabling batched I/O\n");
+    GNUNET_free (plugin->rbatch);
+    plugin->rbatch = NULL;
+  }
+#endif
+  /* Find message to send */
+  udpw = remove_timeout_messages_and_select ((sock == plugin->sockv4)
+                                             ? plugin->ipv4_queue_head
+                                             : plugin->ipv6_queue_head,
+                                             sock);
+  if (NULL == udpw)
+    return 0; /* No message to send */
+
+  slen = udpw_to_sockaddr (udpw, &ss);
+  if (0 == slen)
+  {
+    call_continuation (udpw, GNUNET_OK);
+    dequeue (plugin, udpw);
+    GNUNET_free (udpw);
+    return GNUNET_SYSERR;
+  }
+
+  sent = GNUNET_NETWORK_socket_sendto (sock, udpw->msg_buf, udpw->msg_size,
+      (const struct sockaddr *) &ss, slen);
+  udp_send_done (plugin, udpw, (const struct sockaddr *) &ss, slen,
+                 sent, errno);
   return sent;
 }
 
@@ -3140,6 +3561,7 @@ libgnunet_plugin_transport_udp_init (void *cls)
   p->enable_broadcasting_receiving = enable_broadcasting_recv;
   p->env = env;
   p->sessions = GNUNET_CONTAINER_multipeermap_create (10, GNUNET_NO);
+  p->sessions_by_sockaddr = GNUNET_CONTAINER_multihashmap_create (10, GNUNET_NO);
   p->defrag_ctxs = GNUNET_CONTAINER_heap_create (
       GNUNET_CONTAINER_HEAP_ORDER_MIN);
   p->mst = GNUNET_SERVER_mst_create (&process_inbound_tokenized_messages, p);
@@ -3156,12 +3578,21 @@ libgnunet_plugin_transport_udp_init (void *cls)
     LOG (GNUNET_ERROR_TYPE_ERROR,
         _("Failed to create network sockets, plugin failed\n"));
     GNUNET_CONTAINER_multipeermap_destroy (p->sessions);
+    GNUNET_CONTAINER_multihashmap_destroy (p->sessions_by_sockaddr);
     GNUNET_CONTAINER_heap_destroy (p->defrag_ctxs);
     GNUNET_SERVER_mst_destroy (p->mst);
     GNUNET_free (p);
     return NULL;
   }
 
+#if UDP_USE_MMSG
+  /* Send and receive batches of datagrams per system call */
+  if (GNUNET_NO !=
+      GNUNET_CONFIGURATION_get_value_yesno (env->cfg, "transport-udp",
+                                            "BATCH_IO"))
+    p->rbatch = GNUNET_new (struct UDP_ReceiveBatch);
+#endif
+
   /* Setup broadcasting and receiving beacons */
   setup_broadcast (p, &server_addrv6, &server_addrv4);
 
@@ -3307,6 +3738,7 @@ libgnunet_plugin_transport_udp_done (void *cls)
   GNUNET_CONTAINER_multipeermap_iterate (plugin->sessions,
                                          &disconnect_and_free_it, plugin);
   GNUNET_CONTAINER_multipeermap_destroy (plugin->sessions);
+  GNUNET_CONTAINER_multihashmap_destroy (plugin->sessions_by_sockaddr);
 
   next = ppc_dll_head;
   for (cur = next; NULL != cur; cur = next)
@@ -3319,6 +3751,9 @@ libgnunet_plugin_transport_udp_done (void *cls)
     GNUNET_RESOLVER_request_cancel (cur->resolver_handle);
     GNUNET_free (cur);
   }
+#if UDP_USE_MMSG
+  GNUNET_free_non_null (plugin->rbatch);
+#endif
   GNUNET_free (plugin);
   GNUNET_free (api);
   return NULL;
@@ -55,6 +55,22 @@
  */
 #define UDP_MTU 1400
 
+/**
+ * Can we send and receive batches of datagrams with a single
+ * system call (recvmmsg() and sendmmsg())?
+ */
+#if HAVE_RECVMMSG && HAVE_SENDMMSG
+#define UDP_USE_MMSG 1
+#else
+#define UDP_USE_MMSG 0
+#endif
+
+/**
+ * Maximum number of datagrams we send or receive per system call
+ * if #UDP_USE_MMSG is set.
+ */
+#define UDP_MMSG_BATCH 16
+
 
 GNUNET_NETWORK_STRUCT_BEGIN
 /**
@@ -126,6 +142,11 @@ struct UDPMessage
 
 struct UDP_MessageWrapper;
 
+/**
+ * Buffers for receiving a batch of datagrams at once.
+ */
+struct UDP_ReceiveBatch;
+
 
 /**
  * Encapsulation of all of the state of the plugin.
@@ -144,6 +165,14 @@ struct Plugin
    */
   struct GNUNET_CONTAINER_MultiPeerMap *sessions;
 
+  /**
+   * Secondary index over @e sessions, mapping the hash of the
+   * address family, IP address and port of a session to the
+   * 'struct Session', so that inbound datagrams can be matched
+   * to their session without iterating over all sessions.
+   */
+  struct GNUNET_CONTAINER_MultiHashMap *sessions_by_sockaddr;
+
   /**
    * Heap with all of our defragmentation activities.
    */
@@ -285,6 +314,26 @@ struct Plugin
 
   struct UDP_MessageWrapper *ipv6_queue_head;
   struct UDP_MessageWrapper *ipv6_queue_tail;
+
+#if UDP_USE_MMSG
+  /**
+   * Buffers for receiving datagrams with recvmmsg(), NULL if
+   * batched I/O is disabled.
+   */
+  struct UDP_ReceiveBatch *rbatch;
+
+  /**
+   * Messages passed to the last sendmmsg() that have not yet been
+   * completed; entries are set to NULL if the message is dequeued
+   * by someone else while we process the batch.
+   */
+  struct UDP_MessageWrapper *sbatch[UDP_MMSG_BATCH];
+
+  /**
+   * Number of valid entries in @e sbatch.
+   */
+  unsigned int sbatch_size;
+#endif
 };
 
 
@@ -474,6 +474,42 @@ GNUNET_CLIENT_disconnect (struct GNUNET_CLIENT_Connection *client)
 }
 
 
+/**
+ * Check if messages to the service may be passed through a
+ * shared-memory ring: the connection must run over a UNIX domain
+ * socket and the service's configuration must set the option
+ * "SHM_RING" to YES.
+ *
+ * @param client handle to the service connection
+ * @return #GNUNET_YES if a ring may be offered, #GNUNET_NO if not
+ */
+int
+GNUNET_CLIENT_test_shm_ring_ (struct GNUNET_CLIENT_Connection *client)
+{
+  struct sockaddr *addr;
+  size_t addrlen;
+  int ret;
+
+  if ( (NULL == client->connection) ||
+       (GNUNET_YES !=
+        GNUNET_CONFIGURATION_get_value_yesno (client->cfg,
+                                              client->service_name,
+                                              "SHM_RING")) ||
+       (GNUNET_OK !=
+        GNUNET_CONNECTION_get_address (client->connection,
+                                       (void **) &addr,
+                                       &addrlen)) )
+    return GNUNET_NO;
+#if AF_UNIX
+  ret = (AF_UNIX == addr->sa_family) ? GNUNET_YES : GNUNET_NO;
+#else
+  ret = GNUNET_NO;
+#endif
+  GNUNET_free (addr);
+  return ret;
+}
+
+
 /**
  * Check if message is complete.  Sets the "msg_complete" member
  * in the client struct.
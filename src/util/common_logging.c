@@ -26,6 +26,9 @@
 #include "platform.h"
 #include "gnunet_util_lib.h"
 #include <regex.h>
+#if HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
 
 
 /**
@@ -155,6 +158,14 @@ int skip_log = 0;
  */
 static FILE *GNUNET_stderr;
 
+#if HAVE_PTHREAD_H
+/**
+ * Serializes log calls from worker threads with those from the
+ * main thread.  Recursive, as a custom logger may log again.
+ */
+static pthread_mutex_t log_lock;
+#endif
+
 /**
  * Represents a single logging definition
  */
@@ -887,6 +898,9 @@ mylog (enum GNUNET_ErrorType kind,
   GNUNET_assert (0 != size);
   va_end (vacp);
   memset (date, 0, DATE_STR_SIZE);
+#if HAVE_PTHREAD_H
+  (void) pthread_mutex_lock (&log_lock);
+#endif
   {
     char buf[size];
     long long offset;
@@ -962,16 +976,21 @@ mylog (enum GNUNET_ErrorType kind,
 	    BULK_DELAY_THRESHOLD) ||
 	   (last_bulk_repeat > BULK_REPEAT_THRESHOLD) )
         flush_bulk (date);
-      return;
     }
-    flush_bulk (date);
-    strncpy (last_bulk, buf, sizeof (last_bulk));
-    last_bulk_repeat = 0;
-    last_bulk_kind = kind;
-    last_bulk_time = GNUNET_TIME_absolute_get ();
-    strncpy (last_bulk_comp, comp, COMP_TRACK_SIZE);
-    output_message (kind, comp, date, buf);
+    else
+    {
+      flush_bulk (date);
+      strncpy (last_bulk, buf, sizeof (last_bulk));
+      last_bulk_repeat = 0;
+      last_bulk_kind = kind;
+      last_bulk_time = GNUNET_TIME_absolute_get ();
+      strncpy (last_bulk_comp, comp, COMP_TRACK_SIZE);
+      output_message (kind, comp, date, buf);
+    }
   }
+#if HAVE_PTHREAD_H
+  (void) pthread_mutex_unlock (&log_lock);
+#endif
 }
 
 
@@ -1243,6 +1262,10 @@ GNUNET_log_config_invalid (enum GNUNET_ErrorType kind,
 void __attribute__ ((constructor))
 GNUNET_util_cl_init ()
 {
+#if HAVE_PTHREAD_H
+  pthread_mutexattr_t attr;
+#endif
+
   GNUNET_stderr = stderr;
 #ifdef MINGW
   GNInitWinEnv (NULL);
@@ -1251,6 +1274,13 @@ GNUNET_util_cl_init ()
   if (!InitializeCriticalSectionAndSpinCount (&output_message_cs, 0x00000400))
     GNUNET_abort ();
 #endif
+#if HAVE_PTHREAD_H
+  if ( (0 != pthread_mutexattr_init (&attr)) ||
+       (0 != pthread_mutexattr_settype (&attr, PTHREAD_MUTEX_RECURSIVE)) ||
+       (0 != pthread_mutex_init (&log_lock, &attr)) )
+    GNUNET_abort ();
+  (void) pthread_mutexattr_destroy (&attr);
+#endif
 }
 
 
@@ -1263,6 +1293,9 @@ GNUNET_util_cl_fini ()
 #if WINDOWS
   DeleteCriticalSection (&output_message_cs);
 #endif
+#if HAVE_PTHREAD_H
+  (void) pthread_mutex_destroy (&log_lock);
+#endif
 #ifdef MINGW
   GNShutdownWinEnv ();
 #endif
@@ -307,6 +307,61 @@ GNUNET_CONNECTION_create_from_existing (struct GNUNET_NETWORK_Handle *osSocket)
 }
 
 
+/**
+ * Obtain the credentials of the process at the other end of a
+ * UNIX domain socket.
+ *
+ * @param sock the socket
+ * @param gc where to store the credentials
+ * @return #GNUNET_OK on success, #GNUNET_SYSERR if the platform
+ *         cannot tell
+ */
+static int
+get_peer_credentials (struct GNUNET_NETWORK_Handle *sock,
+                      struct GNUNET_CONNECTION_Credentials *gc)
+{
+#if HAVE_GETPEEREID
+  /* most BSDs */
+  if (0 == getpeereid (GNUNET_NETWORK_get_fd (sock), &gc->uid, &gc->gid))
+    return GNUNET_OK;
+#else
+#ifdef SO_PEERCRED
+  /* largely traditional GNU/Linux */
+  struct ucred uc;
+  socklen_t olen;
+
+  olen = sizeof (uc);
+  if ((0 ==
+       getsockopt (GNUNET_NETWORK_get_fd (sock), SOL_SOCKET, SO_PEERCRED, &uc,
+                   &olen)) && (olen == sizeof (uc)))
+  {
+    gc->uid = uc.uid;
+    gc->gid = uc.gid;
+    return GNUNET_OK;
+  }
+#else
+#if HAVE_GETPEERUCRED
+  /* this is for Solaris 10 */
+  ucred_t *uc;
+  int ret;
+
+  uc = NULL;
+  ret = GNUNET_SYSERR;
+  if (0 == getpeerucred (GNUNET_NETWORK_get_fd (sock), &uc))
+  {
+    gc->uid = ucred_geteuid (uc);
+    gc->gid = ucred_getegid (uc);
+    ret = GNUNET_OK;
+  }
+  ucred_free (uc);
+  return ret;
+#endif
+#endif
+#endif
+  return GNUNET_SYSERR;
+}
+
+
 /**
  * Create a connection handle by accepting on a listen socket.  This
  * function may block if the listen socket has no connection ready.
@@ -332,10 +387,6 @@ GNUNET_CONNECTION_create_from_accept (GNUNET_CONNECTION_AccessCheck access,
   void *uaddr;
   struct GNUNET_CONNECTION_Credentials *gcp;
   struct GNUNET_CONNECTION_Credentials gc;
-#ifdef SO_PEERCRED
-  struct ucred uc;
-  socklen_t olen;
-#endif
 
   addrlen = sizeof (addr);
   sock =
@@ -379,41 +430,9 @@ GNUNET_CONNECTION_create_from_accept (GNUNET_CONNECTION_AccessCheck access,
   gcp = NULL;
   gc.uid = 0;
   gc.gid = 0;
-  if (AF_UNIX == sa->sa_family)
-  {
-#if HAVE_GETPEEREID
-    /* most BSDs */
-    if (0 == getpeereid (GNUNET_NETWORK_get_fd (sock), &gc.uid, &gc.gid))
-      gcp = &gc;
-#else
-#ifdef SO_PEERCRED
-    /* largely traditional GNU/Linux */
-    olen = sizeof (uc);
-    if ((0 ==
-         getsockopt (GNUNET_NETWORK_get_fd (sock), SOL_SOCKET, SO_PEERCRED, &uc,
-                     &olen)) && (olen == sizeof (uc)))
-    {
-      gc.uid = uc.uid;
-      gc.gid = uc.gid;
-      gcp = &gc;
-    }
-#else
-#if HAVE_GETPEERUCRED
-    /* this is for Solaris 10 */
-    ucred_t *uc;
-
-    uc = NULL;
-    if (0 == getpeerucred (GNUNET_NETWORK_get_fd (sock), &uc))
-    {
-      gc.uid = ucred_geteuid (uc);
-      gc.gid = ucred_getegid (uc);
-      gcp = &gc;
-    }
-    ucred_free (uc);
-#endif
-#endif
-#endif
-  }
+  if ( (AF_UNIX == sa->sa_family) &&
+       (GNUNET_OK == get_peer_credentials (sock, &gc)) )
+    gcp = &gc;
 
   if ((NULL != access) &&
       (GNUNET_YES != (aret = access (access_cls, gcp, uaddr, addrlen))))
@@ -462,6 +481,29 @@ GNUNET_CONNECTION_get_address (struct GNUNET_CONNECTION_Handle *connection,
 }
 
 
+/**
+ * Obtain the credentials of the other party, which must be
+ * connected to us over a UNIX domain socket.
+ *
+ * @param connection the connection
+ * @param gc where to store the credentials
+ * @return #GNUNET_OK on success, #GNUNET_SYSERR if the connection
+ *         is not over a UNIX domain socket or the platform cannot tell
+ */
+int
+GNUNET_CONNECTION_get_credentials (struct GNUNET_CONNECTION_Handle *connection,
+                                   struct GNUNET_CONNECTION_Credentials *gc)
+{
+#if AF_UNIX
+  if ( (NULL != connection->sock) &&
+       (NULL != connection->addr) &&
+       (AF_UNIX == connection->addr->sa_family) )
+    return get_peer_credentials (connection->sock, gc);
+#endif
+  return GNUNET_SYSERR;
+}
+
+
 /**
  * Tell the receiver callback that we had an IO error.
  *
@@ -1177,14 +1219,32 @@ process_notify (struct GNUNET_CONNECTION_Handle *connection)
     connection->write_buffer_off -= connection->write_buffer_pos;
     connection->write_buffer_pos = 0;
   }
-  avail = connection->write_buffer_size - connection->write_buffer_off;
-  GNUNET_assert (avail >= size);
-  size =
-      notify (connection->nth.notify_ready_cls, avail,
-              &connection->write_buffer[connection->write_buffer_off]);
-  GNUNET_assert (size <= avail);
-  if (0 != size)
-    connection->write_buffer_off += size;
+  while (1)
+  {
+    avail = connection->write_buffer_size - connection->write_buffer_off;
+    GNUNET_assert (avail >= size);
+    size =
+        notify (connection->nth.notify_ready_cls, avail,
+                &connection->write_buffer[connection->write_buffer_off]);
+    GNUNET_assert (size <= avail);
+    if (0 != size)
+      connection->write_buffer_off += size;
+    /* if the callback already asked to transmit again and the
+       buffer has room, serve it now so that both leave with the
+       same send() instead of a scheduler round trip each */
+    if (NULL == (notify = connection->nth.notify_ready))
+      break;
+    size = connection->nth.notify_size;
+    if ( (0 == size) ||
+         (connection->write_buffer_size - connection->write_buffer_off < size) )
+      break;
+    if (GNUNET_SCHEDULER_NO_TASK != connection->write_task)
+    {
+      GNUNET_SCHEDULER_cancel (connection->write_task);
+      connection->write_task = GNUNET_SCHEDULER_NO_TASK;
+    }
+    connection->nth.notify_ready = NULL;
+  }
   return GNUNET_YES;
 }
 
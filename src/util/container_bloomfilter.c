@@ -33,7 +33,8 @@
  *
  * To be able to delete entries from the bloom filter, we maintain
  * a 4 bit counter in the file on the drive (we still use only one
- * bit in memory).
+ * bit in memory).  The counter file is memory-mapped where possible,
+ * so that updating a counter does not cost any system calls.
  *
  * @author Igor Wronsky
  * @author Christian Grothoff
@@ -66,6 +67,17 @@ struct GNUNET_CONTAINER_BloomFilter
    */
   struct GNUNET_DISK_FileHandle *fh;
 
+  /**
+   * Mapping of the bit counter file, NULL if we could not map it
+   * (then the counters are updated with reads and writes on @e fh).
+   */
+  struct GNUNET_DISK_MapHandle *map;
+
+  /**
+   * The mapped bit counters (two per byte), NULL if not mapped.
+   */
+  unsigned char *counters;
+
   /**
    * How many bits we set for each stored element
    */
@@ -191,10 +203,12 @@ testBit (char *bitArray, unsigned int bitIdx)
  * @param bitArray memory area to set the bit in
  * @param bitIdx which bit to test
  * @param fh A file to keep the 4 bit address usage counters in
+ * @param counters mapping of @a fh, NULL if not mapped
  */
 static void
 incrementBit (char *bitArray, unsigned int bitIdx,
-              const struct GNUNET_DISK_FileHandle *fh)
+              const struct GNUNET_DISK_FileHandle *fh,
+              unsigned char *counters)
 {
   off_t fileSlot;
   unsigned char value;
@@ -203,16 +217,24 @@ incrementBit (char *bitArray, unsigned int bitIdx,
   unsigned int targetLoc;
 
   setBit (bitArray, bitIdx);
-  if (GNUNET_DISK_handle_invalid (fh))
+  if ( (NULL == counters) &&
+       (GNUNET_DISK_handle_invalid (fh)) )
     return;
   /* Update the counter file on disk */
   fileSlot = bitIdx / 2;
   targetLoc = bitIdx % 2;
 
-  GNUNET_assert (fileSlot ==
-                 GNUNET_DISK_file_seek (fh, fileSlot, GNUNET_DISK_SEEK_SET));
-  if (1 != GNUNET_DISK_file_read (fh, &value, 1))
-    value = 0;
+  if (NULL != counters)
+  {
+    value = counters[fileSlot];
+  }
+  else
+  {
+    GNUNET_assert (fileSlot ==
+                   GNUNET_DISK_file_seek (fh, fileSlot, GNUNET_DISK_SEEK_SET));
+    if (1 != GNUNET_DISK_file_read (fh, &value, 1))
+      value = 0;
+  }
   low = value & 0xF;
   high = (value & (~0xF)) >> 4;
 
@@ -227,6 +249,11 @@ incrementBit (char *bitArray, unsigned int bitIdx,
       high++;
   }
   value = ((high << 4) | low);
+  if (NULL != counters)
+  {
+    counters[fileSlot] = value;
+    return;
+  }
   GNUNET_assert (fileSlot ==
                  GNUNET_DISK_file_seek (fh, fileSlot, GNUNET_DISK_SEEK_SET));
   GNUNET_assert (1 == GNUNET_DISK_file_write (fh, &value, 1));
@@ -239,10 +266,12 @@ incrementBit (char *bitArray, unsigned int bitIdx,
  * @param bitArray memory area to set the bit in
  * @param bitIdx which bit to test
  * @param fh A file to keep the 4bit address usage counters in
+ * @param counters mapping of @a fh, NULL if not mapped
  */
 static void
 decrementBit (char *bitArray, unsigned int bitIdx,
-              const struct GNUNET_DISK_FileHandle *fh)
+              const struct GNUNET_DISK_FileHandle *fh,
+              unsigned char *counters)
 {
   off_t fileslot;
   unsigned char value;
@@ -250,18 +279,26 @@ decrementBit (char *bitArray, unsigned int bitIdx,
   unsigned int low;
   unsigned int targetLoc;
 
-  if (GNUNET_DISK_handle_invalid (fh))
+  if ( (NULL == counters) &&
+       (GNUNET_DISK_handle_invalid (fh)) )
     return;                     /* cannot decrement! */
   /* Each char slot in the counter file holds two 4 bit counters */
   fileslot = bitIdx / 2;
   targetLoc = bitIdx % 2;
-  if (GNUNET_SYSERR == GNUNET_DISK_file_seek (fh, fileslot, GNUNET_DISK_SEEK_SET))
-    {
-      GNUNET_log_strerror (GNUNET_ERROR_TYPE_ERROR, "seek");
-      return;
-    }
-  if (1 != GNUNET_DISK_file_read (fh, &value, 1))
-    value = 0;
+  if (NULL != counters)
+  {
+    value = counters[fileslot];
+  }
+  else
+  {
+    if (GNUNET_SYSERR == GNUNET_DISK_file_seek (fh, fileslot, GNUNET_DISK_SEEK_SET))
+      {
+        GNUNET_log_strerror (GNUNET_ERROR_TYPE_ERROR, "seek");
+        return;
+      }
+    if (1 != GNUNET_DISK_file_read (fh, &value, 1))
+      value = 0;
+  }
   low = value & 0xF;
   high = (value & 0xF0) >> 4;
 
@@ -285,6 +322,11 @@ decrementBit (char *bitArray, unsigned int bitIdx,
     }
   }
   value = ((high << 4) | low);
+  if (NULL != counters)
+  {
+    counters[fileslot] = value;
+    return;
+  }
   if (GNUNET_SYSERR == GNUNET_DISK_file_seek (fh, fileslot, GNUNET_DISK_SEEK_SET))
     {
       GNUNET_log_strerror (GNUNET_ERROR_TYPE_ERROR, "seek");
@@ -333,6 +375,45 @@ make_empty_file (const struct GNUNET_DISK_FileHandle *fh, size_t size)
   return GNUNET_OK;
 }
 
+
+/**
+ * Map the counter file of a bloom filter into memory.  If this
+ * fails, the counters are updated with reads and writes instead.
+ *
+ * @param bf the filter, its counter file must already have the
+ *        right size
+ */
+static void
+map_counters (struct GNUNET_CONTAINER_BloomFilter *bf)
+{
+  bf->counters = GNUNET_DISK_file_map (bf->fh,
+                                       &bf->map,
+                                       GNUNET_DISK_MAP_TYPE_READWRITE,
+                                       bf->bitArraySize * 4LL);
+  if (NULL == bf->counters)
+  {
+    LOG_STRERROR_FILE (GNUNET_ERROR_TYPE_DEBUG, "mmap", bf->filename);
+    bf->map = NULL;
+  }
+}
+
+
+/**
+ * Unmap the counter file of a bloom filter, if it is mapped.
+ *
+ * @param bf the filter
+ */
+static void
+unmap_counters (struct GNUNET_CONTAINER_BloomFilter *bf)
+{
+  if (NULL == bf->map)
+    return;
+  if (GNUNET_OK != GNUNET_DISK_file_unmap (bf->map))
+    LOG_STRERROR_FILE (GNUNET_ERROR_TYPE_WARNING, "munmap", bf->filename);
+  bf->map = NULL;
+  bf->counters = NULL;
+}
+
 /* ************** GNUNET_CONTAINER_BloomFilter iterator ********* */
 
 /**
@@ -412,7 +493,7 @@ incrementBitCallback (void *cls, const struct GNUNET_CONTAINER_BloomFilter *bf,
 {
   struct GNUNET_CONTAINER_BloomFilter *b = cls;
 
-  incrementBit (b->bitArray, bit, bf->fh);
+  incrementBit (b->bitArray, bit, bf->fh, b->counters);
   return GNUNET_YES;
 }
 
@@ -431,7 +512,7 @@ decrementBitCallback (void *cls, const struct GNUNET_CONTAINER_BloomFilter *bf,
 {
   struct GNUNET_CONTAINER_BloomFilter *b = cls;
 
-  decrementBit (b->bitArray, bit, bf->fh);
+  decrementBit (b->bitArray, bit, bf->fh, b->counters);
   return GNUNET_YES;
 }
 
@@ -573,8 +654,23 @@ GNUNET_CONTAINER_bloomfilter_load (const char *filename, size_t size,
   }
   bf->bitArraySize = size;
   bf->addressesPerElement = k;
+  map_counters (bf);
   if (GNUNET_YES != must_read)
     return bf; /* already done! */
+  if (NULL != bf->counters)
+  {
+    /* Take the bits from the mapped counters */
+    for (ui = 0; ui < size * 4LL; ui++)
+    {
+      if (0 == bf->counters[ui])
+        continue;
+      if ((bf->counters[ui] & 0x0F) != 0)
+        setBit (bf->bitArray, ui * 2);
+      if ((bf->counters[ui] & 0xF0) != 0)
+        setBit (bf->bitArray, ui * 2 + 1);
+    }
+    return bf;
+  }
   /* Read from the file what bits we can */
   rbuff = GNUNET_malloc (BUFFSIZE);
   pos = 0;
@@ -683,6 +779,13 @@ GNUNET_CONTAINER_bloomfilter_free (struct GNUNET_CONTAINER_BloomFilter *bf)
 {
   if (NULL == bf)
     return;
+  if (NULL != bf->map)
+  {
+    unmap_counters (bf);
+    /* make sure the counters updated via the mapping hit the disk */
+    if (GNUNET_OK != GNUNET_DISK_file_sync (bf->fh))
+      LOG_STRERROR_FILE (GNUNET_ERROR_TYPE_WARNING, "fsync", bf->filename);
+  }
   if (bf->fh != NULL)
     GNUNET_DISK_file_close (bf->fh);
   GNUNET_free_non_null (bf->filename);
@@ -703,7 +806,9 @@ GNUNET_CONTAINER_bloomfilter_clear (struct GNUNET_CONTAINER_BloomFilter *bf)
     return;
 
   memset (bf->bitArray, 0, bf->bitArraySize);
-  if (bf->filename != NULL)
+  if (NULL != bf->counters)
+    memset (bf->counters, 0, bf->bitArraySize * 4LL);
+  else if (bf->filename != NULL)
     make_empty_file (bf->fh, bf->bitArraySize * 4LL);
 }
 
@@ -863,10 +968,14 @@ GNUNET_CONTAINER_bloomfilter_resize (struct GNUNET_CONTAINER_BloomFilter *bf,
     i *= 2;
   size = i;                     /* make sure it's a power of 2 */
 
+  unmap_counters (bf);
   bf->bitArraySize = size;
   bf->bitArray = GNUNET_malloc (size);
   if (bf->filename != NULL)
+  {
     make_empty_file (bf->fh, bf->bitArraySize * 4LL);
+    map_counters (bf);
+  }
   while (GNUNET_YES == iterator (iterator_cls, &hc))
     GNUNET_CONTAINER_bloomfilter_add (bf, &hc);
 }
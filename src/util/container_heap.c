@@ -32,6 +32,13 @@
 
 #define EXTRA_CHECKS 0
 
+/**
+ * Number of children of each node in the heap.  With four children,
+ * the children of a node are adjacent in memory and the tree is only
+ * half as deep as a binary heap.
+ */
+#define ARITY 4
+
 /**
  * Node in the heap.
  */
@@ -43,38 +50,44 @@ struct GNUNET_CONTAINER_HeapNode
   struct GNUNET_CONTAINER_Heap *heap;
 
   /**
-   * Parent node.
+   * Our element.  While the node is on the free list of the
+   * heap, this points to the next free node instead.
    */
-  struct GNUNET_CONTAINER_HeapNode *parent;
+  void *element;
 
   /**
-   * Left child.
+   * Position of this node in the array of the heap.
    */
-  struct GNUNET_CONTAINER_HeapNode *left_child;
+  unsigned int index;
 
   /**
-   * Right child.
+   * Value of the 'epoch' of the heap when this node was last
+   * visited by #GNUNET_CONTAINER_heap_iterate().
    */
-  struct GNUNET_CONTAINER_HeapNode *right_child;
+  unsigned int visited;
 
-  /**
-   * Our element.
-   */
-  void *element;
+};
 
+
+/**
+ * Entry in the array of a heap.  The cost is stored in the array
+ * (and not in the node) so that comparisons do not need to access
+ * the nodes.
+ */
+struct HeapEntry
+{
   /**
    * Cost for this element.
    */
   GNUNET_CONTAINER_HeapCostType cost;
 
   /**
-   * Number of elements below this node in the heap
-   * (excluding this node itself).
+   * The node.
    */
-  unsigned int tree_size;
-
+  struct GNUNET_CONTAINER_HeapNode *node;
 };
 
+
 /**
  * Handle to a node in a heap.
  */
@@ -82,20 +95,44 @@ struct GNUNET_CONTAINER_Heap
 {
 
   /**
-   * Root of the heap.
+   * The heap, with the root at index 0 and the children of the
+   * entry at index i at indices ARITY * i + 1 to ARITY * i + ARITY.
    */
-  struct GNUNET_CONTAINER_HeapNode *root;
+  struct HeapEntry *array;
 
   /**
-   * Current position of our random walk.
+   * Nodes that are currently unused, linked via their 'element'.
    */
-  struct GNUNET_CONTAINER_HeapNode *walk_pos;
+  struct GNUNET_CONTAINER_HeapNode *free_nodes;
 
   /**
    * Number of elements in the heap.
    */
   unsigned int size;
 
+  /**
+   * Allocated length of @e array.
+   */
+  unsigned int array_length;
+
+  /**
+   * Current position of our random walk.
+   */
+  unsigned int walk_pos;
+
+  /**
+   * Incremented for each call to #GNUNET_CONTAINER_heap_iterate(),
+   * so that it can tell which nodes it already visited.
+   */
+  unsigned int epoch;
+
+  /**
+   * Lowest position in @e array at which a node that was not yet
+   * visited in the current @e epoch was stored since the last
+   * call to the iterator.
+   */
+  unsigned int low_mark;
+
   /**
    * How is the heap sorted?
    */
@@ -104,30 +141,51 @@ struct GNUNET_CONTAINER_Heap
 };
 
 
+/**
+ * Check if an entry with cost @a a belongs above an entry with
+ * cost @a b in the heap.
+ *
+ * @param heap the heap
+ * @param a first cost
+ * @param b second cost
+ * @return non-zero if @a a must be closer to the root than @a b
+ */
+static int
+before (const struct GNUNET_CONTAINER_Heap *heap,
+        GNUNET_CONTAINER_HeapCostType a,
+        GNUNET_CONTAINER_HeapCostType b)
+{
+  if (GNUNET_CONTAINER_HEAP_ORDER_MAX == heap->order)
+    return a > b;
+  return a < b;
+}
+
+
 #if EXTRA_CHECKS
 /**
- * Check if internal invariants hold for the given node.
+ * Check if internal invariants hold for the given heap.
  *
- * @param node subtree to check
+ * @param heap heap to check
  */
 static void
-check (const struct GNUNET_CONTAINER_HeapNode *node)
+check (const struct GNUNET_CONTAINER_Heap *heap)
 {
-  if (NULL == node)
-    return;
-  GNUNET_assert (node->tree_size ==
-                 ((node->left_child ==
-                   NULL) ? 0 : 1 + node->left_child->tree_size) +
-                 ((node->right_child ==
-                   NULL) ? 0 : 1 + node->right_child->tree_size));
-  check (node->left_child);
-  check (node->right_child);
+  unsigned int i;
+
+  for (i = 0; i < heap->size; i++)
+  {
+    GNUNET_assert (heap->array[i].node->index == i);
+    if (i > 0)
+      GNUNET_assert (! before (heap,
+                               heap->array[i].cost,
+                               heap->array[(i - 1) / ARITY].cost));
+  }
 }
 
 
-#define CHECK(n) check(n)
+#define CHECK(h) check(h)
 #else
-#define CHECK(n) do {} while (0)
+#define CHECK(h) do {} while (0)
 #endif
 
 
@@ -157,7 +215,18 @@ GNUNET_CONTAINER_heap_create (enum GNUNET_CONTAINER_HeapOrder order)
 void
 GNUNET_CONTAINER_heap_destroy (struct GNUNET_CONTAINER_Heap *heap)
 {
+  struct GNUNET_CONTAINER_HeapNode *node;
+  unsigned int i;
+
   GNUNET_break (heap->size == 0);
+  for (i = 0; i < heap->size; i++)
+    GNUNET_free (heap->array[i].node);
+  while (NULL != (node = heap->free_nodes))
+  {
+    heap->free_nodes = node->element;
+    GNUNET_free (node);
+  }
+  GNUNET_array_grow (heap->array, heap->array_length, 0);
   GNUNET_free (heap);
 }
 
@@ -171,9 +240,9 @@ GNUNET_CONTAINER_heap_destroy (struct GNUNET_CONTAINER_Heap *heap)
 void *
 GNUNET_CONTAINER_heap_peek (const struct GNUNET_CONTAINER_Heap *heap)
 {
-  if (heap->root == NULL)
+  if (0 == heap->size)
     return NULL;
-  return heap->root->element;
+  return heap->array[0].node->element;
 }
 
 
@@ -191,12 +260,12 @@ GNUNET_CONTAINER_heap_peek2 (const struct GNUNET_CONTAINER_Heap *heap,
                              void **element,
                              GNUNET_CONTAINER_HeapCostType *cost)
 {
-  if (NULL == heap->root)
+  if (0 == heap->size)
     return GNUNET_NO;
   if (NULL != element)
-    *element = heap->root->element;
+    *element = heap->array[0].node->element;
   if (NULL != cost)
-    *cost = heap->root->cost;
+    *cost = heap->array[0].cost;
   return GNUNET_YES;
 }
 
@@ -224,38 +293,15 @@ GNUNET_CONTAINER_HeapCostType
 GNUNET_CONTAINER_heap_node_get_cost (const struct GNUNET_CONTAINER_HeapNode
                                      *node)
 {
-  return node->cost;
-}
-
-
-/**
- * Iterate over the children of the given node.
- *
- * @param heap argument to give to iterator
- * @param node node to iterate over
- * @param iterator function to call on each node
- * @param iterator_cls closure for iterator
- * @return GNUNET_YES to continue to iterate
- */
-static int
-node_iterator (const struct GNUNET_CONTAINER_Heap *heap,
-               struct GNUNET_CONTAINER_HeapNode *node,
-               GNUNET_CONTAINER_HeapIterator iterator, void *iterator_cls)
-{
-  if (node == NULL)
-    return GNUNET_YES;
-  if (GNUNET_YES !=
-      node_iterator (heap, node->left_child, iterator, iterator_cls))
-    return GNUNET_NO;
-  if (GNUNET_YES !=
-      node_iterator (heap, node->right_child, iterator, iterator_cls))
-    return GNUNET_NO;
-  return iterator (iterator_cls, node, node->element, node->cost);
+  return node->heap->array[node->index].cost;
 }
 
 
 /**
- * Iterate over all entries in the heap.
+ * Iterate over all entries in the heap.  The iterator may remove
+ * nodes from the heap (removed nodes are not visited anymore);
+ * nodes inserted during the iteration may or may not be visited.
+ * The iterator must not iterate over the same heap again.
  *
  * @param heap the heap
  * @param iterator function to call on each entry
@@ -266,7 +312,37 @@ GNUNET_CONTAINER_heap_iterate (const struct GNUNET_CONTAINER_Heap *heap,
                                GNUNET_CONTAINER_HeapIterator iterator,
                                void *iterator_cls)
 {
-  (void) node_iterator (heap, heap->root, iterator, iterator_cls);
+  struct GNUNET_CONTAINER_Heap *h = (struct GNUNET_CONTAINER_Heap *) heap;
+  struct GNUNET_CONTAINER_HeapNode *node;
+  unsigned int i;
+
+  /* Removing or updating a node moves others around in the array.
+     All nodes before position 'i' have been visited in this epoch;
+     if the iterator moves an unvisited node in front of 'i', we
+     continue from there. */
+  if (0 == ++h->epoch)
+  {
+    for (i = 0; i < h->size; i++)
+      h->array[i].node->visited = 0;
+    h->epoch = 1;
+  }
+  i = 0;
+  while (i < h->size)
+  {
+    node = h->array[i].node;
+    if (h->epoch == node->visited)
+    {
+      i++;
+      continue;
+    }
+    node->visited = h->epoch;
+    h->low_mark = UINT_MAX;
+    if (GNUNET_YES !=
+        iterator (iterator_cls, node, node->element,
+                  h->array[i].cost))
+      break;
+    i = GNUNET_MIN (i + 1, h->low_mark);
+  }
 }
 
 
@@ -284,81 +360,120 @@ GNUNET_CONTAINER_heap_iterate (const struct GNUNET_CONTAINER_Heap *heap,
 void *
 GNUNET_CONTAINER_heap_walk_get_next (struct GNUNET_CONTAINER_Heap *heap)
 {
-  struct GNUNET_CONTAINER_HeapNode *pos;
-  void *element;
+  unsigned int pos;
 
-  if (heap->root == NULL)
+  if (0 == heap->size)
     return NULL;
   pos = heap->walk_pos;
-  if (pos == NULL)
-    pos = heap->root;
-  element = pos->element;
-  heap->walk_pos =
-      (0 ==
-       GNUNET_CRYPTO_random_u32 (GNUNET_CRYPTO_QUALITY_WEAK,
-                                 2)) ? pos->right_child : pos->left_child;
-  return element;
+  if (pos >= heap->size)
+    pos = 0;
+  heap->walk_pos = ARITY * pos + 1 +
+      GNUNET_CRYPTO_random_u32 (GNUNET_CRYPTO_QUALITY_WEAK, ARITY);
+  return heap->array[pos].node->element;
 }
 
 
 /**
- * Insert the given node 'node' into the subtree starting
- * at 'pos' (while keeping the tree somewhat balanced).
+ * Store an entry at the given position of the array.
  *
  * @param heap heap to modify
- * @param pos existing tree
- * @param node node to insert (which may be a subtree itself)
+ * @param pos position to use
+ * @param e entry to store
  */
 static void
-insert_node (struct GNUNET_CONTAINER_Heap *heap,
-             struct GNUNET_CONTAINER_HeapNode *pos,
-             struct GNUNET_CONTAINER_HeapNode *node)
+set_entry (struct GNUNET_CONTAINER_Heap *heap,
+           unsigned int pos,
+           const struct HeapEntry *e)
 {
-  struct GNUNET_CONTAINER_HeapNode *parent;
+  heap->array[pos] = *e;
+  e->node->index = pos;
+  if ( (heap->epoch != e->node->visited) &&
+       (pos < heap->low_mark) )
+    heap->low_mark = pos;
+}
+
 
-  GNUNET_assert (node->parent == NULL);
-  while ((heap->order == GNUNET_CONTAINER_HEAP_ORDER_MAX) ? (pos->cost >=
-                                                             node->cost)
-         : (pos->cost <= node->cost))
+/**
+ * Move the entry at the given position towards the root
+ * until the heap property holds.
+ *
+ * @param heap heap to modify
+ * @param pos position of the entry to move
+ */
+static void
+sift_up (struct GNUNET_CONTAINER_Heap *heap,
+         unsigned int pos)
+{
+  struct HeapEntry e;
+  unsigned int parent;
+
+  e = heap->array[pos];
+  while (pos > 0)
   {
-    /* node is descendent of pos */
-    pos->tree_size += (1 + node->tree_size);
-    if (pos->left_child == NULL)
-    {
-      pos->left_child = node;
-      node->parent = pos;
-      return;
-    }
-    if (pos->right_child == NULL)
-    {
-      pos->right_child = node;
-      node->parent = pos;
-      return;
-    }
-    /* keep it balanced by descending into smaller subtree */
-    if (pos->left_child->tree_size < pos->right_child->tree_size)
-      pos = pos->left_child;
-    else
-      pos = pos->right_child;
+    parent = (pos - 1) / ARITY;
+    if (! before (heap, e.cost, heap->array[parent].cost))
+      break;
+    set_entry (heap, pos, &heap->array[parent]);
+    pos = parent;
   }
-  /* make 'node' parent of 'pos' */
-  parent = pos->parent;
-  pos->parent = NULL;
-  node->parent = parent;
-  if (NULL == parent)
+  set_entry (heap, pos, &e);
+}
+
+
+/**
+ * Move the entry at the given position away from the root
+ * until the heap property holds.
+ *
+ * @param heap heap to modify
+ * @param pos position of the entry to move
+ */
+static void
+sift_down (struct GNUNET_CONTAINER_Heap *heap,
+           unsigned int pos)
+{
+  struct HeapEntry e;
+  unsigned int child;
+  unsigned int best;
+  unsigned int last;
+
+  e = heap->array[pos];
+  while (1)
   {
-    heap->root = node;
+    child = ARITY * pos + 1;
+    if (child >= heap->size)
+      break;
+    last = GNUNET_MIN (child + ARITY, heap->size);
+    best = child;
+    for (child++; child < last; child++)
+      if (before (heap, heap->array[child].cost, heap->array[best].cost))
+        best = child;
+    if (! before (heap, heap->array[best].cost, e.cost))
+      break;
+    set_entry (heap, pos, &heap->array[best]);
+    pos = best;
   }
+  set_entry (heap, pos, &e);
+}
+
+
+/**
+ * Restore the heap property after the cost of the entry at
+ * the given position changed (or a new entry was placed there).
+ *
+ * @param heap heap to modify
+ * @param pos position of the entry
+ */
+static void
+sift (struct GNUNET_CONTAINER_Heap *heap,
+      unsigned int pos)
+{
+  if ( (pos > 0) &&
+       before (heap,
+               heap->array[pos].cost,
+               heap->array[(pos - 1) / ARITY].cost) )
+    sift_up (heap, pos);
   else
-  {
-    if (parent->left_child == pos)
-      parent->left_child = node;
-    else
-      parent->right_child = node;
-  }
-  /* insert 'pos' below 'node' */
-  insert_node (heap, node, pos);
-  CHECK (pos);
+    sift_down (heap, pos);
 }
 
 
@@ -375,135 +490,71 @@ GNUNET_CONTAINER_heap_insert (struct GNUNET_CONTAINER_Heap *heap, void *element,
                               GNUNET_CONTAINER_HeapCostType cost)
 {
   struct GNUNET_CONTAINER_HeapNode *node;
+  struct HeapEntry e;
 
-  node = GNUNET_new (struct GNUNET_CONTAINER_HeapNode);
+  if (NULL != (node = heap->free_nodes))
+    heap->free_nodes = node->element;
+  else
+    node = GNUNET_new (struct GNUNET_CONTAINER_HeapNode);
   node->heap = heap;
   node->element = element;
-  node->cost = cost;
-  heap->size++;
-  if (NULL == heap->root)
-    heap->root = node;
-  else
-    insert_node (heap, heap->root, node);
-  GNUNET_assert (heap->size == heap->root->tree_size + 1);
-  CHECK (heap->root);
+  node->visited = heap->epoch;
+  if (heap->size == heap->array_length)
+    GNUNET_array_grow (heap->array,
+                       heap->array_length,
+                       GNUNET_MAX (16, 2 * heap->array_length));
+  e.cost = cost;
+  e.node = node;
+  set_entry (heap, heap->size++, &e);
+  sift_up (heap, node->index);
+  CHECK (heap);
   return node;
 }
 
 
 /**
- * Remove root of the heap.
+ * Remove the entry at the given position from the heap and
+ * put its node on the free list.
  *
  * @param heap heap to modify
- * @return element data stored at the root node, NULL if heap is empty
+ * @param pos position of the entry to remove
+ * @return element data stored at the node
  */
-void *
-GNUNET_CONTAINER_heap_remove_root (struct GNUNET_CONTAINER_Heap *heap)
+static void *
+remove_at (struct GNUNET_CONTAINER_Heap *heap,
+           unsigned int pos)
 {
+  struct GNUNET_CONTAINER_HeapNode *node;
   void *ret;
-  struct GNUNET_CONTAINER_HeapNode *root;
 
-  if (NULL == (root = heap->root))
-    return NULL;
+  node = heap->array[pos].node;
+  ret = node->element;
   heap->size--;
-  ret = root->element;
-  if (root->left_child == NULL)
-  {
-    heap->root = root->right_child;
-    if (root->right_child != NULL)
-      root->right_child->parent = NULL;
-  }
-  else if (root->right_child == NULL)
+  if (pos != heap->size)
   {
-    heap->root = root->left_child;
-    root->left_child->parent = NULL;
+    set_entry (heap, pos, &heap->array[heap->size]);
+    sift (heap, pos);
   }
-  else
-  {
-    root->left_child->parent = NULL;
-    root->right_child->parent = NULL;
-    heap->root = root->left_child;
-    insert_node (heap, heap->root, root->right_child);
-  }
-  if (heap->walk_pos == root)
-    heap->walk_pos = heap->root;
-  GNUNET_free (root);
-#if EXTRA_CHECKS
-  GNUNET_assert (((heap->size == 0) && (heap->root == NULL)) ||
-                 (heap->size == heap->root->tree_size + 1));
-  CHECK (heap->root);
-#endif
+  node->heap = NULL;
+  node->element = heap->free_nodes;
+  heap->free_nodes = node;
+  CHECK (heap);
   return ret;
 }
 
 
 /**
- * Remove the given node 'node' from the tree and update
- * the 'tree_size' fields accordingly.  Preserves the
- * children of 'node' and does NOT change the overall
- * 'size' field of the tree.
+ * Remove root of the heap.
+ *
+ * @param heap heap to modify
+ * @return element data stored at the root node, NULL if heap is empty
  */
-static void
-remove_node (struct GNUNET_CONTAINER_HeapNode *node)
+void *
+GNUNET_CONTAINER_heap_remove_root (struct GNUNET_CONTAINER_Heap *heap)
 {
-  struct GNUNET_CONTAINER_HeapNode *ancestor;
-  struct GNUNET_CONTAINER_Heap *heap = node->heap;
-
-  /* update 'size' of the ancestors */
-  ancestor = node;
-  while (NULL != (ancestor = ancestor->parent))
-    ancestor->tree_size--;
-
-  /* update 'size' of node itself */
-  if (node->left_child != NULL)
-    node->tree_size -= (1 + node->left_child->tree_size);
-  if (node->right_child != NULL)
-    node->tree_size -= (1 + node->right_child->tree_size);
-
-  /* unlink 'node' itself and insert children in its place */
-  if (node->parent == NULL)
-  {
-    if (node->left_child != NULL)
-    {
-      heap->root = node->left_child;
-      node->left_child->parent = NULL;
-      if (node->right_child != NULL)
-      {
-        node->right_child->parent = NULL;
-        insert_node (heap, heap->root, node->right_child);
-      }
-    }
-    else
-    {
-      heap->root = node->right_child;
-      if (node->right_child != NULL)
-        node->right_child->parent = NULL;
-    }
-  }
-  else
-  {
-    if (node->parent->left_child == node)
-      node->parent->left_child = NULL;
-    else
-      node->parent->right_child = NULL;
-    if (node->left_child != NULL)
-    {
-      node->left_child->parent = NULL;
-      node->parent->tree_size -= (1 + node->left_child->tree_size);
-      insert_node (heap, node->parent, node->left_child);
-    }
-    if (node->right_child != NULL)
-    {
-      node->right_child->parent = NULL;
-      node->parent->tree_size -= (1 + node->right_child->tree_size);
-      insert_node (heap, node->parent, node->right_child);
-    }
-  }
-  node->parent = NULL;
-  node->left_child = NULL;
-  node->right_child = NULL;
-  GNUNET_assert (node->tree_size == 0);
-  CHECK (heap->root);
+  if (0 == heap->size)
+    return NULL;
+  return remove_at (heap, 0);
 }
 
 
@@ -516,25 +567,10 @@ remove_node (struct GNUNET_CONTAINER_HeapNode *node)
 void *
 GNUNET_CONTAINER_heap_remove_node (struct GNUNET_CONTAINER_HeapNode *node)
 {
-  void *ret;
-  struct GNUNET_CONTAINER_Heap *heap;
+  struct GNUNET_CONTAINER_Heap *heap = node->heap;
 
-  heap = node->heap;
-  CHECK (heap->root);
-  if (heap->walk_pos == node)
-    (void) GNUNET_CONTAINER_heap_walk_get_next (heap);
-  remove_node (node);
-  heap->size--;
-  ret = node->element;
-  if (heap->walk_pos == node)
-    heap->walk_pos = NULL;
-  GNUNET_free (node);
-#if EXTRA_CHECKS
-  CHECK (heap->root);
-  GNUNET_assert (((heap->size == 0) && (heap->root == NULL)) ||
-                 (heap->size == heap->root->tree_size + 1));
-#endif
-  return ret;
+  GNUNET_assert (heap->array[node->index].node == node);
+  return remove_at (heap, node->index);
 }
 
 
@@ -550,27 +586,10 @@ GNUNET_CONTAINER_heap_update_cost (struct GNUNET_CONTAINER_Heap *heap,
                                    struct GNUNET_CONTAINER_HeapNode *node,
                                    GNUNET_CONTAINER_HeapCostType new_cost)
 {
-#if EXTRA_CHECKS
-  GNUNET_assert (((heap->size == 0) && (heap->root == NULL)) ||
-                 (heap->size == heap->root->tree_size + 1));
-  CHECK (heap->root);
-#endif
-  remove_node (node);
-#if EXTRA_CHECKS
-  CHECK (heap->root);
-  GNUNET_assert (((heap->size == 1) && (heap->root == NULL)) ||
-                 (heap->size == heap->root->tree_size + 2));
-#endif
-  node->cost = new_cost;
-  if (heap->root == NULL)
-    heap->root = node;
-  else
-    insert_node (heap, heap->root, node);
-#if EXTRA_CHECKS
-  CHECK (heap->root);
-  GNUNET_assert (((heap->size == 0) && (heap->root == NULL)) ||
-                 (heap->size == heap->root->tree_size + 1));
-#endif
+  GNUNET_assert (node->heap == heap);
+  heap->array[node->index].cost = new_cost;
+  sift (heap, node->index);
+  CHECK (heap);
 }
 
 
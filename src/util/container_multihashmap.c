@@ -76,6 +76,55 @@ struct SmallMapEntry
 };
 
 
+/**
+ * An entry in a hash map using open addressing.  The key is always
+ * stored inline so that lookups do not have to follow pointers.
+ */
+struct FlatMapEntry
+{
+
+  /**
+   * Key for the entry.
+   */
+  struct GNUNET_HashCode key;
+
+  /**
+   * Value of the entry.
+   */
+  void *value;
+
+  /**
+   * #GNUNET_YES if the entry was removed while the map was being
+   * iterated over.  Such entries are ignored and purged once there
+   * are too many of them.
+   */
+  int removed;
+
+};
+
+
+/**
+ * Probing information for a slot in a hash map using open
+ * addressing.  Kept separate from the (much larger) entries so that
+ * probing only touches a few cache lines.
+ */
+struct FlatMapProbe
+{
+
+  /**
+   * Distance of the slot of this entry from the slot the key hashes
+   * to, plus one; 0 if the slot is empty.
+   */
+  uint32_t dist;
+
+  /**
+   * First 32 bits of the key of the entry.
+   */
+  uint32_t tag;
+
+};
+
+
 /**
  * Entry in the map.
  */
@@ -99,20 +148,44 @@ union MapEntry
 struct GNUNET_CONTAINER_MultiHashMap
 {
   /**
-   * All of our buckets.
+   * All of our buckets, NULL if the map uses open addressing.
    */
   union MapEntry *map;
 
+  /**
+   * All of our slots if the map uses open addressing, otherwise NULL.
+   * The number of slots is always a power of two.
+   */
+  struct FlatMapEntry *slots;
+
+  /**
+   * Probing information for each of the "slots".
+   */
+  struct FlatMapProbe *probes;
+
   /**
    * Number of entries in the map.
    */
   unsigned int size;
 
   /**
-   * Length of the "map" array.
+   * Length of the "map" (or "slots") array.
    */
   unsigned int map_length;
 
+  /**
+   * Number of entries in "slots" that are marked as removed.
+   */
+  unsigned int removed;
+
+  /**
+   * Number of calls to iterate or get_multiple that are currently
+   * running on a map using open addressing.  While this is non-zero,
+   * removed entries are only marked, so that the iteration does
+   * not miss entries that would otherwise be moved.
+   */
+  unsigned int iteration_depth;
+
   /**
    * #GNUNET_NO if the map entries are of type 'struct BigMapEntry',
    * #GNUNET_YES if the map entries are of type 'struct SmallMapEntry'.
@@ -186,6 +259,47 @@ GNUNET_CONTAINER_multihashmap_create (unsigned int len,
 }
 
 
+/**
+ * Create a multi hash map that uses open addressing (with Robin Hood
+ * hashing) instead of chaining.  Keys are always copied into the
+ * table, and no memory is allocated per entry, which makes lookups
+ * and insertions considerably cheaper for large maps.  Removing
+ * entries (including the current one) while iterating is safe, but
+ * unlike with #GNUNET_CONTAINER_multihashmap_create(), adding entries
+ * during an iteration may move entries that were already visited, so
+ * they may be skipped or visited again.
+ *
+ * @param len initial size (map will grow as needed)
+ * @return NULL on error
+ */
+struct GNUNET_CONTAINER_MultiHashMap *
+GNUNET_CONTAINER_multihashmap_create_flat (unsigned int len)
+{
+  struct GNUNET_CONTAINER_MultiHashMap *map;
+  unsigned int slots;
+
+  GNUNET_assert (len > 0);
+  slots = 16;
+  while ( (slots < len) &&
+          (slots < INT_MAX / 2) )
+    slots *= 2;
+  map = GNUNET_new (struct GNUNET_CONTAINER_MultiHashMap);
+  map->slots = GNUNET_malloc_large (slots * sizeof (struct FlatMapEntry));
+  map->probes = GNUNET_malloc_large (slots * sizeof (struct FlatMapProbe));
+  if ( (NULL == map->slots) ||
+       (NULL == map->probes) )
+  {
+    GNUNET_free_non_null (map->slots);
+    GNUNET_free_non_null (map->probes);
+    GNUNET_free (map);
+    return NULL;
+  }
+  memset (map->probes, 0, slots * sizeof (struct FlatMapProbe));
+  map->map_length = slots;
+  return map;
+}
+
+
 /**
  * Destroy a hash map.  Will not free any values
  * stored in the hash map!
@@ -199,6 +313,14 @@ GNUNET_CONTAINER_multihashmap_destroy (struct GNUNET_CONTAINER_MultiHashMap
   unsigned int i;
   union MapEntry me;
 
+  if (NULL != map->slots)
+  {
+    GNUNET_break (0 == map->iteration_depth);
+    GNUNET_free (map->slots);
+    GNUNET_free (map->probes);
+    GNUNET_free (map);
+    return;
+  }
   for (i = 0; i < map->map_length; i++)
   {
     me = map->map[i];
@@ -250,6 +372,247 @@ idx_of (const struct GNUNET_CONTAINER_MultiHashMap *map,
 }
 
 
+/**
+ * Store a key-value pair in a map using open addressing, moving
+ * entries that are closer to their home slot further out ("Robin
+ * Hood" hashing).  There must be at least one free slot.
+ *
+ * @param map the map
+ * @param key key to store
+ * @param value value to store
+ */
+static void
+flat_insert (struct GNUNET_CONTAINER_MultiHashMap *map,
+             const struct GNUNET_HashCode *key,
+             void *value)
+{
+  struct FlatMapEntry e;
+  struct FlatMapEntry tmp;
+  struct FlatMapProbe pe;
+  struct FlatMapProbe ptmp;
+  unsigned int mask = map->map_length - 1;
+  unsigned int i;
+
+  e.key = *key;
+  e.value = value;
+  e.removed = GNUNET_NO;
+  pe.dist = 1;
+  pe.tag = key->bits[0];
+  i = pe.tag & mask;
+  while (0 != map->probes[i].dist)
+  {
+    if (map->probes[i].dist < pe.dist)
+    {
+      tmp = map->slots[i];
+      map->slots[i] = e;
+      e = tmp;
+      ptmp = map->probes[i];
+      map->probes[i] = pe;
+      pe = ptmp;
+    }
+    pe.dist++;
+    i = (i + 1) & mask;
+  }
+  map->slots[i] = e;
+  map->probes[i] = pe;
+}
+
+
+/**
+ * Re-hash all entries of a map using open addressing into new
+ * arrays of slots, dropping entries marked as removed.
+ *
+ * @param map the map
+ * @param new_len new number of slots, must be a power of two
+ */
+static void
+flat_rehash (struct GNUNET_CONTAINER_MultiHashMap *map,
+             unsigned int new_len)
+{
+  struct FlatMapEntry *old_slots;
+  struct FlatMapProbe *old_probes;
+  unsigned int old_len;
+  unsigned int i;
+
+  map->modification_counter++;
+  old_slots = map->slots;
+  old_probes = map->probes;
+  old_len = map->map_length;
+  map->slots = GNUNET_malloc_large (new_len * sizeof (struct FlatMapEntry));
+  map->probes = GNUNET_malloc_large (new_len * sizeof (struct FlatMapProbe));
+  GNUNET_assert ( (NULL != map->slots) &&
+                  (NULL != map->probes) );
+  memset (map->probes, 0, new_len * sizeof (struct FlatMapProbe));
+  map->map_length = new_len;
+  map->removed = 0;
+  for (i = 0; i < old_len; i++)
+    if ( (0 != old_probes[i].dist) &&
+         (GNUNET_NO == old_slots[i].removed) )
+      flat_insert (map, &old_slots[i].key, old_slots[i].value);
+  GNUNET_free (old_slots);
+  GNUNET_free (old_probes);
+}
+
+
+/**
+ * Clear the given slot of a map using open addressing by shifting
+ * the following entries of its cluster back by one slot.
+ *
+ * @param map the map
+ * @param i index of the slot to clear
+ */
+static void
+flat_shift_back (struct GNUNET_CONTAINER_MultiHashMap *map,
+                 unsigned int i)
+{
+  unsigned int mask = map->map_length - 1;
+  unsigned int j;
+
+  j = (i + 1) & mask;
+  while (map->probes[j].dist > 1)
+  {
+    map->slots[i] = map->slots[j];
+    map->probes[i].dist = map->probes[j].dist - 1;
+    map->probes[i].tag = map->probes[j].tag;
+    i = j;
+    j = (j + 1) & mask;
+  }
+  map->probes[i].dist = 0;
+}
+
+
+/**
+ * Remove the entry in the given slot of a map using open addressing.
+ * If an iteration is in progress, the entry is only marked as
+ * removed; otherwise, the following entries are shifted back.
+ *
+ * @param map the map
+ * @param i index of the slot to clear
+ */
+static void
+flat_remove_at (struct GNUNET_CONTAINER_MultiHashMap *map,
+                unsigned int i)
+{
+  map->size--;
+  if (map->iteration_depth > 0)
+  {
+    map->slots[i].removed = GNUNET_YES;
+    map->removed++;
+    return;
+  }
+  flat_shift_back (map, i);
+}
+
+
+/**
+ * Clear all slots of a map using open addressing that are marked
+ * as removed, in place.  The scan starts after an empty slot, so
+ * shifting entries back never moves them into slots that were
+ * already looked at.
+ *
+ * @param map the map
+ */
+static void
+flat_purge (struct GNUNET_CONTAINER_MultiHashMap *map)
+{
+  unsigned int mask = map->map_length - 1;
+  unsigned int start;
+  unsigned int n;
+  unsigned int i;
+
+  map->modification_counter++;
+  /* the load factor is below 3/4, so there is an empty slot */
+  start = 0;
+  while (0 != map->probes[start].dist)
+    start++;
+  for (n = 1; n <= map->map_length; n++)
+  {
+    i = (start + n) & mask;
+    while ( (0 != map->probes[i].dist) &&
+            (GNUNET_YES == map->slots[i].removed) )
+      flat_shift_back (map, i);
+  }
+  map->removed = 0;
+}
+
+
+/**
+ * Find the next slot (starting at @a *pos) that holds a value for the
+ * given key in a map using open addressing.
+ *
+ * @param map the map
+ * @param key key to look for
+ * @param[in,out] pos probe position (0 to start at the home slot),
+ *        updated to point past the returned slot
+ * @return index of the slot, -1 if there are no more matches
+ */
+static int
+flat_find (const struct GNUNET_CONTAINER_MultiHashMap *map,
+           const struct GNUNET_HashCode *key,
+           unsigned int *pos)
+{
+  const struct FlatMapProbe *p;
+  const struct FlatMapEntry *e;
+  unsigned int mask = map->map_length - 1;
+  unsigned int i;
+
+  while (1)
+  {
+    i = (key->bits[0] + *pos) & mask;
+    p = &map->probes[i];
+    /* Robin Hood invariant: our key cannot be any further out */
+    if (p->dist < *pos + 1)
+      return -1;
+    (*pos)++;
+    if (p->tag != key->bits[0])
+      continue;
+    e = &map->slots[i];
+    if ( (GNUNET_NO == e->removed) &&
+         (0 == memcmp (key, &e->key, sizeof (struct GNUNET_HashCode))) )
+      return (int) i;
+  }
+}
+
+
+/**
+ * Note the start of an iteration over a map using open addressing.
+ *
+ * @param map the map
+ * @return @a map, as a mutable pointer
+ */
+static struct GNUNET_CONTAINER_MultiHashMap *
+flat_begin_iteration (const struct GNUNET_CONTAINER_MultiHashMap *map)
+{
+  struct GNUNET_CONTAINER_MultiHashMap *m;
+
+  /* iterating does not change the contents of the map, but we
+     must know about it to safely handle removals */
+  m = (struct GNUNET_CONTAINER_MultiHashMap *) map;
+  m->iteration_depth++;
+  return m;
+}
+
+
+/**
+ * Note the end of an iteration over a map using open addressing.
+ * Entries removed during the iteration stay marked, so that removing
+ * a few entries does not cost a pass over all slots; once this was
+ * the outermost iteration and more than 1/8 of the slots are marked,
+ * they are purged.
+ *
+ * @param map the map
+ */
+static void
+flat_end_iteration (struct GNUNET_CONTAINER_MultiHashMap *map)
+{
+  GNUNET_assert (map->iteration_depth > 0);
+  map->iteration_depth--;
+  if ( (0 == map->iteration_depth) &&
+       (map->removed > map->map_length / 8) )
+    flat_purge (map);
+}
+
+
 /**
  * Get the number of key-value pairs in the map.
  *
@@ -279,7 +642,15 @@ GNUNET_CONTAINER_multihashmap_get (const struct GNUNET_CONTAINER_MultiHashMap
                                    *map, const struct GNUNET_HashCode *key)
 {
   union MapEntry me;
+  unsigned int pos;
+  int i;
 
+  if (NULL != map->slots)
+  {
+    pos = 0;
+    i = flat_find (map, key, &pos);
+    return (-1 == i) ? NULL : map->slots[i].value;
+  }
   me = map->map[idx_of (map, key)];
   if (map->use_small_entries)
   {
@@ -323,6 +694,32 @@ GNUNET_CONTAINER_multihashmap_iterate (const struct
 
   count = 0;
   GNUNET_assert (NULL != map);
+  if (NULL != map->slots)
+  {
+    struct GNUNET_CONTAINER_MultiHashMap *m;
+    struct FlatMapEntry *e;
+
+    m = flat_begin_iteration (map);
+    for (i = 0; i < m->map_length; i++)
+    {
+      e = &m->slots[i];
+      if ( (0 == m->probes[i].dist) ||
+           (GNUNET_YES == e->removed) )
+        continue;
+      if (NULL != it)
+      {
+        kc = e->key;
+        if (GNUNET_OK != it (it_cls, &kc, e->value))
+        {
+          count = GNUNET_SYSERR;
+          break;
+        }
+      }
+      count++;
+    }
+    flat_end_iteration (m);
+    return count;
+  }
   for (i = 0; i < map->map_length; i++)
   {
     me = map->map[i];
@@ -387,6 +784,21 @@ GNUNET_CONTAINER_multihashmap_remove (struct GNUNET_CONTAINER_MultiHashMap *map,
 
   map->modification_counter++;
 
+  if (NULL != map->slots)
+  {
+    unsigned int pos;
+    int j;
+
+    pos = 0;
+    while (-1 != (j = flat_find (map, key, &pos)))
+    {
+      if (value != map->slots[j].value)
+        continue;
+      flat_remove_at (map, j);
+      return GNUNET_YES;
+    }
+    return GNUNET_NO;
+  }
   i = idx_of (map, key);
   me = map->map[i];
   if (map->use_small_entries)
@@ -456,6 +868,23 @@ GNUNET_CONTAINER_multihashmap_remove_all (struct GNUNET_CONTAINER_MultiHashMap
   map->modification_counter++;
 
   ret = 0;
+  if (NULL != map->slots)
+  {
+    unsigned int pos;
+    int j;
+
+    pos = 0;
+    while (-1 != (j = flat_find (map, key, &pos)))
+    {
+      flat_remove_at (map, j);
+      ret++;
+      /* unless the entry was only marked, the next entry was
+         shifted into the slot we just looked at */
+      if (0 == map->iteration_depth)
+        pos--;
+    }
+    return ret;
+  }
   i = idx_of (map, key);
   me = map->map[i];
   if (map->use_small_entries)
@@ -537,7 +966,13 @@ GNUNET_CONTAINER_multihashmap_contains (const struct
                                         const struct GNUNET_HashCode *key)
 {
   union MapEntry me;
+  unsigned int pos;
 
+  if (NULL != map->slots)
+  {
+    pos = 0;
+    return (-1 == flat_find (map, key, &pos)) ? GNUNET_NO : GNUNET_YES;
+  }
   me = map->map[idx_of (map, key)];
   if (map->use_small_entries)
   {
@@ -576,7 +1011,17 @@ GNUNET_CONTAINER_multihashmap_contains_value (const struct
                                               const void *value)
 {
   union MapEntry me;
+  unsigned int pos;
+  int i;
 
+  if (NULL != map->slots)
+  {
+    pos = 0;
+    while (-1 != (i = flat_find (map, key, &pos)))
+      if (map->slots[i].value == value)
+        return GNUNET_YES;
+    return GNUNET_NO;
+  }
   me = map->map[idx_of (map, key)];
   if (map->use_small_entries)
   {
@@ -675,6 +1120,33 @@ GNUNET_CONTAINER_multihashmap_put (struct GNUNET_CONTAINER_MultiHashMap *map,
   union MapEntry me;
   unsigned int i;
 
+  if (NULL != map->slots)
+  {
+    unsigned int pos;
+    int j;
+
+    if ((opt != GNUNET_CONTAINER_MULTIHASHMAPOPTION_MULTIPLE) &&
+        (opt != GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_FAST))
+    {
+      pos = 0;
+      if (-1 != (j = flat_find (map, key, &pos)))
+      {
+        if (opt == GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_ONLY)
+          return GNUNET_SYSERR;
+        map->slots[j].value = value;
+        return GNUNET_NO;
+      }
+    }
+    /* keep the load factor below 3/4 */
+    if ((map->size + map->removed + 1) * 4 > map->map_length * 3)
+      flat_rehash (map,
+                   (map->size + 1) * 2 > map->map_length
+                   ? map->map_length * 2
+                   : map->map_length);
+    flat_insert (map, key, value);
+    map->size++;
+    return GNUNET_OK;
+  }
   i = idx_of (map, key);
   if ((opt != GNUNET_CONTAINER_MULTIHASHMAPOPTION_MULTIPLE) &&
       (opt != GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_FAST))
@@ -758,6 +1230,26 @@ GNUNET_CONTAINER_multihashmap_get_multiple (const struct
   union MapEntry me;
 
   count = 0;
+  if (NULL != map->slots)
+  {
+    struct GNUNET_CONTAINER_MultiHashMap *m;
+    unsigned int pos;
+    int i;
+
+    m = flat_begin_iteration (map);
+    pos = 0;
+    while (-1 != (i = flat_find (m, key, &pos)))
+    {
+      if ((it != NULL) && (GNUNET_OK != it (it_cls, key, m->slots[i].value)))
+      {
+        count = GNUNET_SYSERR;
+        break;
+      }
+      count++;
+    }
+    flat_end_iteration (m);
+    return count;
+  }
   me = map->map[idx_of (map, key)];
   if (map->use_small_entries)
   {
@@ -815,7 +1307,8 @@ GNUNET_CONTAINER_multihashmap_iterator_create (const struct GNUNET_CONTAINER_Mul
   iter = GNUNET_new (struct GNUNET_CONTAINER_MultiHashMapIterator);
   iter->map = map;
   iter->modification_counter = map->modification_counter;
-  iter->me = map->map[0];
+  if (NULL == map->slots)
+    iter->me = map->map[0];
   return iter;
 }
 
@@ -842,6 +1335,25 @@ GNUNET_CONTAINER_multihashmap_iterator_next (struct GNUNET_CONTAINER_MultiHashMa
   /* make sure the map has not been modified */
   GNUNET_assert (iter->modification_counter == iter->map->modification_counter);
 
+  if (NULL != iter->map->slots)
+  {
+    const struct FlatMapEntry *e;
+
+    while (iter->idx < iter->map->map_length)
+    {
+      e = &iter->map->slots[iter->idx];
+      if ( (0 == iter->map->probes[iter->idx++].dist) ||
+           (GNUNET_YES == e->removed) )
+        continue;
+      if (NULL != key)
+        *key = e->key;
+      if (NULL != value)
+        *value = e->value;
+      return GNUNET_YES;
+    }
+    return GNUNET_NO;
+  }
+
   /* look for the next entry, skipping empty buckets */
   while (1)
   {
@@ -0,0 +1,711 @@
+/*
+     This file is part of GNUnet.
+     (C) 2014 Christian Grothoff (and other contributing authors)
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+     Boston, MA 02111-1307, USA.
+*/
+
+/**
+ * @file util/crypto_pow.c
+ * @brief search for proofs of work (as used by NSE and revocation)
+ *        in background threads
+ */
+#include "platform.h"
+#include "gnunet_util_lib.h"
+#include <gcrypt.h>
+#if HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+#if HAVE_SYS_RESOURCE_H
+#include <sys/resource.h>
+#endif
+
+#define LOG(kind,...) GNUNET_log_from (kind, "util", __VA_ARGS__)
+
+/**
+ * Upper bound on the number of threads used for one search.
+ */
+#define MAX_POW_THREADS 64
+
+/**
+ * How many values does a worker thread claim at a time?
+ */
+#define POW_BLOCK_SIZE 16
+
+/**
+ * How many values do we test per task when searching in the scheduler?
+ */
+#define POW_ROUND_SIZE 10
+
+/**
+ * Nice value for the worker threads.
+ */
+#define POW_THREAD_NICE 19
+
+#if HAVE_PTHREAD_H
+#define LOCK(ps) GNUNET_assert (0 == pthread_mutex_lock (&(ps)->lock))
+#define UNLOCK(ps) GNUNET_assert (0 == pthread_mutex_unlock (&(ps)->lock))
+#else
+#define LOCK(ps)
+#define UNLOCK(ps)
+#endif
+
+
+/**
+ * State of a worker thread.
+ */
+struct PowWorker
+{
+  /**
+   * Search the worker is part of.
+   */
+  struct GNUNET_CRYPTO_PowSearch *ps;
+
+#if HAVE_PTHREAD_H
+  /**
+   * The thread.
+   */
+  pthread_t tid;
+#endif
+
+  /**
+   * First value of the block the worker is currently testing,
+   * only valid if @e busy is set.
+   */
+  uint64_t block;
+
+  /**
+   * #GNUNET_YES while the worker is testing @e block.
+   */
+  int busy;
+};
+
+
+/**
+ * Handle for a search for a proof of work.
+ */
+struct GNUNET_CRYPTO_PowSearch
+{
+  /**
+   * Function to call with progress and result.
+   */
+  GNUNET_CRYPTO_PowSearchCallback cb;
+
+  /**
+   * Closure for @e cb.
+   */
+  void *cb_cls;
+
+  /**
+   * Salt for the hash.
+   */
+  char *salt;
+
+  /**
+   * Data we prove work for.
+   */
+  void *data;
+
+  /**
+   * Number of bytes in @e data.
+   */
+  size_t data_size;
+
+  /**
+   * Buffer used when searching in the scheduler.
+   */
+  char *buf;
+
+  /**
+   * Worker threads, NULL if we search in the scheduler.
+   */
+  struct PowWorker *workers;
+
+  /**
+   * Number of entries in @e workers.
+   */
+  unsigned int num_workers;
+
+  /**
+   * Number of leading zero bits required.
+   */
+  unsigned int matching_bits;
+
+  /**
+   * Pause between rounds when searching in the scheduler.
+   */
+  struct GNUNET_TIME_Relative delay;
+
+  /**
+   * How often do we report progress?
+   */
+  struct GNUNET_TIME_Relative progress_freq;
+
+  /**
+   * When did we last report progress?
+   */
+  struct GNUNET_TIME_Absolute last_progress;
+
+  /**
+   * Value of @e hashes when we last reported progress.
+   */
+  uint64_t last_hashes;
+
+  /**
+   * Task testing the next round of values in the scheduler.
+   */
+  GNUNET_SCHEDULER_TaskIdentifier round_task;
+
+  /**
+   * Task reporting progress.
+   */
+  GNUNET_SCHEDULER_TaskIdentifier progress_task;
+
+  /**
+   * Task waiting for a worker thread to find the proof.
+   */
+  GNUNET_SCHEDULER_TaskIdentifier result_task;
+
+  /**
+   * Next value that has not been handed to a worker.
+   */
+  uint64_t next;
+
+  /**
+   * Number of hashes calculated so far.
+   */
+  uint64_t hashes;
+
+  /**
+   * The proof of work, if @e found is set.
+   */
+  uint64_t pow;
+
+  /**
+   * Has a worker found the proof of work?
+   */
+  int found;
+
+  /**
+   * Should the workers stop?
+   */
+  int stop;
+
+#if HAVE_PTHREAD_H
+  /**
+   * Lock protecting @e next, @e hashes, @e pow, @e found, @e stop
+   * and the state of the @e workers.
+   */
+  pthread_mutex_t lock;
+
+  /**
+   * Pipe a worker writes to once it found the proof.
+   */
+  struct GNUNET_DISK_PipeHandle *wakeup;
+#endif
+};
+
+
+/**
+ * Calculate a proof-of-work hash (SCRYPT with a small cost).
+ *
+ * @param salt salt to use, specific to the type of the proof
+ * @param buf data to hash
+ * @param buf_len number of bytes in @a buf
+ * @param result where to write the resulting hash
+ */
+void
+GNUNET_CRYPTO_pow_hash (const char *salt,
+                        const void *buf,
+                        size_t buf_len,
+                        struct GNUNET_HashCode *result)
+{
+  GNUNET_break (0 ==
+		gcry_kdf_derive (buf, buf_len,
+				 GCRY_KDF_SCRYPT,
+				 1 /* subalgo */,
+				 salt, strlen (salt),
+				 2 /* iterations; keep cost of individual op small */,
+				 sizeof (struct GNUNET_HashCode), result));
+}
+
+
+/**
+ * Count the number of leading zero bits in a hash, in the bit
+ * order of #GNUNET_CRYPTO_hash_get_bit().
+ *
+ * @param hash hash to count the leading zero bits of
+ * @return the number of leading zero bits
+ */
+unsigned int
+GNUNET_CRYPTO_hash_count_leading_zeros (const struct GNUNET_HashCode *hash)
+{
+  const unsigned char *bytes = (const unsigned char *) hash;
+  unsigned int count;
+  unsigned int i;
+
+  count = 0;
+  for (i = 0; i < sizeof (struct GNUNET_HashCode); i++)
+  {
+    if (0 == bytes[i])
+    {
+      count += 8;
+      continue;
+    }
+    while (0 == (bytes[i] & (1 << (count % 8))))
+      count++;
+    break;
+  }
+  return count;
+}
+
+
+/**
+ * Create a buffer with room for a value followed by the data of
+ * a search.
+ *
+ * @param ps the search
+ * @return the buffer
+ */
+static char *
+make_buffer (const struct GNUNET_CRYPTO_PowSearch *ps)
+{
+  char *buf;
+
+  buf = GNUNET_malloc (sizeof (uint64_t) + ps->data_size);
+  memcpy (&buf[sizeof (uint64_t)], ps->data, ps->data_size);
+  return buf;
+}
+
+
+/**
+ * Test if a value is a proof of work.
+ *
+ * @param ps the search
+ * @param buf buffer from #make_buffer()
+ * @param value value to test
+ * @return #GNUNET_YES if @a value is a proof of work
+ */
+static int
+test_value (const struct GNUNET_CRYPTO_PowSearch *ps,
+            char *buf,
+            uint64_t value)
+{
+  struct GNUNET_HashCode result;
+
+  memcpy (buf, &value, sizeof (uint64_t));
+  GNUNET_CRYPTO_pow_hash (ps->salt,
+                          buf, sizeof (uint64_t) + ps->data_size,
+                          &result);
+  return (GNUNET_CRYPTO_hash_count_leading_zeros (&result) >=
+          ps->matching_bits) ? GNUNET_YES : GNUNET_NO;
+}
+
+
+/**
+ * Compute the hash rate since the last report.
+ *
+ * @param ps the search
+ * @return hashes per second
+ */
+static uint64_t
+get_hash_rate (struct GNUNET_CRYPTO_PowSearch *ps)
+{
+  struct GNUNET_TIME_Relative elapsed;
+  uint64_t hashes;
+  uint64_t rate;
+
+  LOCK (ps);
+  hashes = ps->hashes;
+  UNLOCK (ps);
+  elapsed = GNUNET_TIME_absolute_get_duration (ps->last_progress);
+  rate = (hashes - ps->last_hashes) * 1000LL * 1000LL
+    / (1 + elapsed.rel_value_us);
+  ps->last_hashes = hashes;
+  ps->last_progress = GNUNET_TIME_absolute_get ();
+  return rate;
+}
+
+
+/**
+ * Stop and join all worker threads.
+ *
+ * @param ps the search
+ */
+static void
+join_workers (struct GNUNET_CRYPTO_PowSearch *ps)
+{
+#if HAVE_PTHREAD_H
+  unsigned int i;
+
+  if (0 == ps->num_workers)
+    return;
+  LOCK (ps);
+  ps->stop = GNUNET_YES;
+  UNLOCK (ps);
+  for (i = 0; i < ps->num_workers; i++)
+    GNUNET_assert (0 == pthread_join (ps->workers[i].tid, NULL));
+  ps->num_workers = 0;
+#endif
+}
+
+
+/**
+ * Release all resources of a search.  The workers must have
+ * been joined.
+ *
+ * @param ps the search
+ */
+static void
+destroy_search (struct GNUNET_CRYPTO_PowSearch *ps)
+{
+  if (GNUNET_SCHEDULER_NO_TASK != ps->round_task)
+    GNUNET_SCHEDULER_cancel (ps->round_task);
+  if (GNUNET_SCHEDULER_NO_TASK != ps->progress_task)
+    GNUNET_SCHEDULER_cancel (ps->progress_task);
+  if (GNUNET_SCHEDULER_NO_TASK != ps->result_task)
+    GNUNET_SCHEDULER_cancel (ps->result_task);
+#if HAVE_PTHREAD_H
+  if (NULL != ps->wakeup)
+    GNUNET_DISK_pipe_close (ps->wakeup);
+  GNUNET_assert (0 == pthread_mutex_destroy (&ps->lock));
+#endif
+  GNUNET_free_non_null (ps->workers);
+  GNUNET_free_non_null (ps->buf);
+  GNUNET_free (ps->data);
+  GNUNET_free (ps->salt);
+  GNUNET_free (ps);
+}
+
+
+/**
+ * The proof of work was found; tell the client and clean up.
+ *
+ * @param ps the search
+ */
+static void
+finish_search (struct GNUNET_CRYPTO_PowSearch *ps)
+{
+  uint64_t rate;
+
+  join_workers (ps);
+  rate = get_hash_rate (ps);
+  LOG (GNUNET_ERROR_TYPE_DEBUG,
+       "Proof of work found: %llu\n",
+       (unsigned long long) ps->pow);
+  ps->cb (ps->cb_cls, ps->pow, rate, GNUNET_YES);
+  destroy_search (ps);
+}
+
+
+/**
+ * Report progress of the search.
+ *
+ * @param cls the `struct GNUNET_CRYPTO_PowSearch`
+ * @param tc scheduler context
+ */
+static void
+report_progress (void *cls,
+                 const struct GNUNET_SCHEDULER_TaskContext *tc)
+{
+  struct GNUNET_CRYPTO_PowSearch *ps = cls;
+  uint64_t resume;
+  uint64_t rate;
+  unsigned int i;
+
+  ps->progress_task = GNUNET_SCHEDULER_NO_TASK;
+  if (0 != (tc->reason & GNUNET_SCHEDULER_REASON_SHUTDOWN))
+    return;
+  LOCK (ps);
+  resume = ps->next;
+  for (i = 0; i < ps->num_workers; i++)
+    if ( (GNUNET_YES == ps->workers[i].busy) &&
+         (ps->workers[i].block < resume) )
+      resume = ps->workers[i].block;
+  UNLOCK (ps);
+  rate = get_hash_rate (ps);
+  LOG (GNUNET_ERROR_TYPE_DEBUG,
+       "Testing proofs of work at %llu, %llu hashes/s\n",
+       (unsigned long long) resume,
+       (unsigned long long) rate);
+  /* schedule first, the callback may stop the search */
+  ps->progress_task = GNUNET_SCHEDULER_add_delayed (ps->progress_freq,
+                                                    &report_progress,
+                                                    ps);
+  ps->cb (ps->cb_cls, resume, rate, GNUNET_NO);
+}
+
+
+/**
+ * Test the next round of values in the scheduler.
+ *
+ * @param cls the `struct GNUNET_CRYPTO_PowSearch`
+ * @param tc scheduler context
+ */
+static void
+search_round (void *cls,
+              const struct GNUNET_SCHEDULER_TaskContext *tc)
+{
+  struct GNUNET_CRYPTO_PowSearch *ps = cls;
+  unsigned int i;
+
+  ps->round_task = GNUNET_SCHEDULER_NO_TASK;
+  if (0 != (tc->reason & GNUNET_SCHEDULER_REASON_SHUTDOWN))
+    return;
+  for (i = 0; (i < POW_ROUND_SIZE) && (UINT64_MAX != ps->next); i++)
+  {
+    ps->hashes++;
+    if (GNUNET_YES == test_value (ps, ps->buf, ps->next))
+    {
+      ps->pow = ps->next;
+      ps->found = GNUNET_YES;
+      finish_search (ps);
+      return;
+    }
+    ps->next++;
+  }
+  if (UINT64_MAX == ps->next)
+  {
+    GNUNET_break (0);
+    return;
+  }
+  ps->round_task =
+      GNUNET_SCHEDULER_add_delayed_with_priority (ps->delay,
+                                                  GNUNET_SCHEDULER_PRIORITY_IDLE,
+                                                  &search_round, ps);
+}
+
+
+#if HAVE_PTHREAD_H
+/**
+ * Main function of a worker thread: claim blocks of values and
+ * test them until the proof is found or the search is stopped.
+ *
+ * @param cls the `struct PowWorker`
+ * @return NULL
+ */
+static void *
+search_worker (void *cls)
+{
+  struct PowWorker *w = cls;
+  struct GNUNET_CRYPTO_PowSearch *ps = w->ps;
+  const struct GNUNET_DISK_FileHandle *fh;
+  char *buf;
+  uint64_t value;
+  uint64_t end;
+  int found;
+
+#if LINUX && HAVE_SYS_RESOURCE_H
+  /* on Linux, this only changes the priority of this thread */
+  (void) setpriority (PRIO_PROCESS, 0, POW_THREAD_NICE);
+#endif
+  buf = make_buffer (ps);
+  LOCK (ps);
+  while ( (GNUNET_NO == ps->stop) &&
+          (GNUNET_NO == ps->found) &&
+          (ps->next <= UINT64_MAX - POW_BLOCK_SIZE) )
+  {
+    w->block = ps->next;
+    w->busy = GNUNET_YES;
+    ps->next += POW_BLOCK_SIZE;
+    UNLOCK (ps);
+    end = w->block + POW_BLOCK_SIZE;
+    found = GNUNET_NO;
+    for (value = w->block; value < end; value++)
+      if (GNUNET_YES == (found = test_value (ps, buf, value)))
+        break;
+    LOCK (ps);
+    w->busy = GNUNET_NO;
+    ps->hashes += (GNUNET_YES == found) ? value - w->block + 1 : POW_BLOCK_SIZE;
+    if ( (GNUNET_YES == found) &&
+         (GNUNET_NO == ps->found) )
+    {
+      ps->pow = value;
+      ps->found = GNUNET_YES;
+      fh = GNUNET_DISK_pipe_handle (ps->wakeup,
+                                    GNUNET_DISK_PIPE_END_WRITE);
+      GNUNET_break (1 == GNUNET_DISK_file_write (fh, "", 1));
+    }
+  }
+  UNLOCK (ps);
+  GNUNET_free (buf);
+  return NULL;
+}
+
+
+/**
+ * A worker thread found the proof of work.
+ *
+ * @param cls the `struct GNUNET_CRYPTO_PowSearch`
+ * @param tc scheduler context
+ */
+static void
+worker_done (void *cls,
+             const struct GNUNET_SCHEDULER_TaskContext *tc)
+{
+  struct GNUNET_CRYPTO_PowSearch *ps = cls;
+
+  ps->result_task = GNUNET_SCHEDULER_NO_TASK;
+  if (0 != (tc->reason & GNUNET_SCHEDULER_REASON_SHUTDOWN))
+    return;
+  finish_search (ps);
+}
+
+
+/**
+ * Start the worker threads of a search.
+ *
+ * @param ps the search
+ * @param threads number of threads to start
+ */
+static void
+start_workers (struct GNUNET_CRYPTO_PowSearch *ps,
+               unsigned int threads)
+{
+  unsigned int i;
+
+  ps->wakeup = GNUNET_DISK_pipe (GNUNET_NO, GNUNET_NO, GNUNET_NO, GNUNET_NO);
+  if (NULL == ps->wakeup)
+    return;
+  ps->workers = GNUNET_malloc (threads * sizeof (struct PowWorker));
+  for (i = 0; i < threads; i++)
+  {
+    ps->workers[i].ps = ps;
+    if (0 != pthread_create (&ps->workers[i].tid, NULL,
+                             &search_worker, &ps->workers[i]))
+    {
+      LOG (GNUNET_ERROR_TYPE_WARNING,
+           "Failed to start proof-of-work thread: %s\n",
+           STRERROR (errno));
+      break;
+    }
+    ps->num_workers++;
+  }
+  if (0 == ps->num_workers)
+  {
+    GNUNET_free (ps->workers);
+    ps->workers = NULL;
+    GNUNET_DISK_pipe_close (ps->wakeup);
+    ps->wakeup = NULL;
+    return;
+  }
+  ps->result_task =
+      GNUNET_SCHEDULER_add_read_file (GNUNET_TIME_UNIT_FOREVER_REL,
+                                      GNUNET_DISK_pipe_handle (ps->wakeup,
+                                                               GNUNET_DISK_PIPE_END_READ),
+                                      &worker_done, ps);
+}
+#endif
+
+
+/**
+ * Search for a proof of work, that is a value @e pow such that the
+ * #GNUNET_CRYPTO_pow_hash() of @e pow (in host byte order) followed
+ * by @a data has at least @a matching_bits leading zero bits.  Values
+ * are tested in worker threads running at the lowest priority; if
+ * threads are not available, the search runs in the scheduler at
+ * idle priority.
+ *
+ * @param salt salt for #GNUNET_CRYPTO_pow_hash()
+ * @param data data to prove work for
+ * @param data_size number of bytes in @a data
+ * @param start first value to test
+ * @param matching_bits number of leading zero bits required
+ * @param threads number of worker threads, 0 for one per CPU
+ * @param delay pause between rounds when searching in the scheduler
+ * @param progress_freq how often to report progress
+ * @param cb function to call with the progress and the result
+ * @param cb_cls closure for @a cb
+ * @return handle to stop the search
+ */
+struct GNUNET_CRYPTO_PowSearch *
+GNUNET_CRYPTO_pow_search_start (const char *salt,
+                                const void *data,
+                                size_t data_size,
+                                uint64_t start,
+                                unsigned int matching_bits,
+                                unsigned int threads,
+                                struct GNUNET_TIME_Relative delay,
+                                struct GNUNET_TIME_Relative progress_freq,
+                                GNUNET_CRYPTO_PowSearchCallback cb,
+                                void *cb_cls)
+{
+  struct GNUNET_CRYPTO_PowSearch *ps;
+
+  ps = GNUNET_new (struct GNUNET_CRYPTO_PowSearch);
+  ps->cb = cb;
+  ps->cb_cls = cb_cls;
+  ps->salt = GNUNET_strdup (salt);
+  ps->data = GNUNET_malloc (data_size);
+  memcpy (ps->data, data, data_size);
+  ps->data_size = data_size;
+  ps->matching_bits = matching_bits;
+  ps->delay = delay;
+  ps->progress_freq = progress_freq;
+  ps->next = start;
+  ps->last_progress = GNUNET_TIME_absolute_get ();
+#if HAVE_PTHREAD_H
+  GNUNET_assert (0 == pthread_mutex_init (&ps->lock, NULL));
+#if HAVE_SYSCONF && defined(_SC_NPROCESSORS_ONLN)
+  if (0 == threads)
+  {
+    long cpus;
+
+    cpus = sysconf (_SC_NPROCESSORS_ONLN);
+    threads = (cpus > 0) ? cpus : 1;
+  }
+#endif
+  if (0 == threads)
+    threads = 1;
+  if (threads > MAX_POW_THREADS)
+    threads = MAX_POW_THREADS;
+  start_workers (ps, threads);
+#endif
+  if (0 == ps->num_workers)
+  {
+    ps->buf = make_buffer (ps);
+    ps->round_task =
+        GNUNET_SCHEDULER_add_with_priority (GNUNET_SCHEDULER_PRIORITY_IDLE,
+                                            &search_round, ps);
+  }
+  ps->progress_task = GNUNET_SCHEDULER_add_delayed (progress_freq,
+                                                    &report_progress,
+                                                    ps);
+  return ps;
+}
+
+
+/**
+ * Stop a search for a proof of work.
+ *
+ * @param ps search to stop
+ * @return value at which a later search can resume
+ */
+uint64_t
+GNUNET_CRYPTO_pow_search_stop (struct GNUNET_CRYPTO_PowSearch *ps)
+{
+  uint64_t resume;
+
+  /* workers finish their current block before they exit, so
+     afterwards all values below 'next' have been tested */
+  join_workers (ps);
+  resume = (GNUNET_YES == ps->found) ? ps->pow : ps->next;
+  destroy_search (ps);
+  return resume;
+}
+
+
+/* end of crypto_pow.c */
@@ -49,62 +49,124 @@ GNUNET_CRYPTO_symmetric_create_session_key (struct GNUNET_CRYPTO_SymmetricSessio
 
 
 /**
- * Initialize AES cipher.
+ * Cipher state for a session key: one handle per cipher of the
+ * AES+TWOFISH cascade, with the key schedule already computed.
+ */
+struct GNUNET_CRYPTO_SymmetricContext
+{
+  /**
+   * AES256 in CFB mode.
+   */
+  gcry_cipher_hd_t aes;
+
+  /**
+   * TWOFISH in CFB mode.
+   */
+  gcry_cipher_hd_t twofish;
+};
+
+
+/**
+ * Open a cipher in CFB mode and set its key.
  *
  * @param handle handle to initialize
- * @param sessionkey session key to use
- * @param iv initialization vector to use
- * @return #GNUNET_OK on success, #GNUNET_SYSERR on error
+ * @param algo gcrypt cipher algorithm to use
+ * @param key key material
+ * @param key_len number of bytes in @a key
  */
-static int
-setup_cipher_aes (gcry_cipher_hd_t *handle,
-                  const struct GNUNET_CRYPTO_SymmetricSessionKey *sessionkey,
-                  const struct GNUNET_CRYPTO_SymmetricInitializationVector *iv)
+static void
+setup_cipher (gcry_cipher_hd_t *handle,
+              int algo,
+              const void *key,
+              size_t key_len)
 {
   int rc;
 
   GNUNET_assert (0 ==
-                 gcry_cipher_open (handle, GCRY_CIPHER_AES256,
+                 gcry_cipher_open (handle, algo,
                                    GCRY_CIPHER_MODE_CFB, 0));
-  rc = gcry_cipher_setkey (*handle,
-                           sessionkey->aes_key,
-                           sizeof (sessionkey->aes_key));
+  rc = gcry_cipher_setkey (*handle, key, key_len);
   GNUNET_assert ((0 == rc) || ((char) rc == GPG_ERR_WEAK_KEY));
-  rc = gcry_cipher_setiv (*handle,
-                          iv->aes_iv,
-                          sizeof (iv->aes_iv));
-  GNUNET_assert ((0 == rc) || ((char) rc == GPG_ERR_WEAK_KEY));
-  return GNUNET_OK;
 }
 
 
 /**
- * Initialize TWOFISH cipher.
+ * Initialize both ciphers of @a ctx for @a sessionkey.
  *
- * @param handle handle to initialize
+ * @param ctx context to initialize
  * @param sessionkey session key to use
+ */
+static void
+setup_context (struct GNUNET_CRYPTO_SymmetricContext *ctx,
+               const struct GNUNET_CRYPTO_SymmetricSessionKey *sessionkey)
+{
+  setup_cipher (&ctx->aes, GCRY_CIPHER_AES256,
+                sessionkey->aes_key, sizeof (sessionkey->aes_key));
+  setup_cipher (&ctx->twofish, GCRY_CIPHER_TWOFISH,
+                sessionkey->twofish_key, sizeof (sessionkey->twofish_key));
+}
+
+
+/**
+ * Release the cipher handles of @a ctx.
+ *
+ * @param ctx context to clean up
+ */
+static void
+cleanup_context (struct GNUNET_CRYPTO_SymmetricContext *ctx)
+{
+  gcry_cipher_close (ctx->aes);
+  gcry_cipher_close (ctx->twofish);
+}
+
+
+/**
+ * Encrypt @a result in place, first with AES, then with TWOFISH.
+ *
+ * @param ctx ciphers to use
  * @param iv initialization vector to use
- * @return #GNUNET_OK on success, #GNUNET_SYSERR on error
+ * @param result buffer to encrypt
+ * @param size number of bytes in @a result
  */
-static int
-setup_cipher_twofish (gcry_cipher_hd_t *handle,
-                      const struct GNUNET_CRYPTO_SymmetricSessionKey *sessionkey,
-                      const struct GNUNET_CRYPTO_SymmetricInitializationVector *iv)
+static void
+encrypt_in_place (struct GNUNET_CRYPTO_SymmetricContext *ctx,
+                  const struct GNUNET_CRYPTO_SymmetricInitializationVector *iv,
+                  void *result,
+                  size_t size)
 {
-  int rc;
+  GNUNET_assert (0 == gcry_cipher_setiv (ctx->aes,
+                                         iv->aes_iv,
+                                         sizeof (iv->aes_iv)));
+  GNUNET_assert (0 == gcry_cipher_encrypt (ctx->aes, result, size, NULL, 0));
+  GNUNET_assert (0 == gcry_cipher_setiv (ctx->twofish,
+                                         iv->twofish_iv,
+                                         sizeof (iv->twofish_iv)));
+  GNUNET_assert (0 == gcry_cipher_encrypt (ctx->twofish, result, size, NULL, 0));
+}
 
-  GNUNET_assert (0 ==
-                 gcry_cipher_open (handle, GCRY_CIPHER_TWOFISH,
-                                   GCRY_CIPHER_MODE_CFB, 0));
-  rc = gcry_cipher_setkey (*handle,
-                           sessionkey->twofish_key,
-                           sizeof (sessionkey->twofish_key));
-  GNUNET_assert ((0 == rc) || ((char) rc == GPG_ERR_WEAK_KEY));
-  rc = gcry_cipher_setiv (*handle,
-                          iv->twofish_iv,
-                          sizeof (iv->twofish_iv));
-  GNUNET_assert ((0 == rc) || ((char) rc == GPG_ERR_WEAK_KEY));
-  return GNUNET_OK;
+
+/**
+ * Decrypt @a result in place, first with TWOFISH, then with AES.
+ *
+ * @param ctx ciphers to use
+ * @param iv initialization vector to use
+ * @param result buffer to decrypt
+ * @param size number of bytes in @a result
+ */
+static void
+decrypt_in_place (struct GNUNET_CRYPTO_SymmetricContext *ctx,
+                  const struct GNUNET_CRYPTO_SymmetricInitializationVector *iv,
+                  void *result,
+                  size_t size)
+{
+  GNUNET_assert (0 == gcry_cipher_setiv (ctx->twofish,
+                                         iv->twofish_iv,
+                                         sizeof (iv->twofish_iv)));
+  GNUNET_assert (0 == gcry_cipher_decrypt (ctx->twofish, result, size, NULL, 0));
+  GNUNET_assert (0 == gcry_cipher_setiv (ctx->aes,
+                                         iv->aes_iv,
+                                         sizeof (iv->aes_iv)));
+  GNUNET_assert (0 == gcry_cipher_decrypt (ctx->aes, result, size, NULL, 0));
 }
 
 
@@ -128,18 +190,13 @@ GNUNET_CRYPTO_symmetric_encrypt (const void *block,
                                  const struct GNUNET_CRYPTO_SymmetricInitializationVector *iv,
                                  void *result)
 {
-  gcry_cipher_hd_t handle;
-  char tmp[size];
-
-  if (GNUNET_OK != setup_cipher_aes (&handle, sessionkey, iv))
-    return -1;
-  GNUNET_assert (0 == gcry_cipher_encrypt (handle, tmp, size, block, size));
-  gcry_cipher_close (handle);
-  if (GNUNET_OK != setup_cipher_twofish (&handle, sessionkey, iv))
-    return -1;
-  GNUNET_assert (0 == gcry_cipher_encrypt (handle, result, size, tmp, size));
-  gcry_cipher_close (handle);
-  memset (tmp, 0, sizeof (tmp));
+  struct GNUNET_CRYPTO_SymmetricContext ctx;
+
+  setup_context (&ctx, sessionkey);
+  if (result != block)
+    memmove (result, block, size);
+  encrypt_in_place (&ctx, iv, result, size);
+  cleanup_context (&ctx);
   return size;
 }
 
@@ -163,18 +220,91 @@ GNUNET_CRYPTO_symmetric_decrypt (const void *block, size_t size,
                                  const struct GNUNET_CRYPTO_SymmetricInitializationVector *iv,
                                  void *result)
 {
-  gcry_cipher_hd_t handle;
-  char tmp[size];
-
-  if (GNUNET_OK != setup_cipher_twofish (&handle, sessionkey, iv))
-    return -1;
-  GNUNET_assert (0 == gcry_cipher_decrypt (handle, tmp, size, block, size));
-  gcry_cipher_close (handle);
-  if (GNUNET_OK != setup_cipher_aes (&handle, sessionkey, iv))
-    return -1;
-  GNUNET_assert (0 == gcry_cipher_decrypt (handle, result, size, tmp, size));
-  gcry_cipher_close (handle);
-  memset (tmp, 0, sizeof (tmp));
+  struct GNUNET_CRYPTO_SymmetricContext ctx;
+
+  setup_context (&ctx, sessionkey);
+  if (result != block)
+    memmove (result, block, size);
+  decrypt_in_place (&ctx, iv, result, size);
+  cleanup_context (&ctx);
+  return size;
+}
+
+
+/**
+ * Set up the ciphers for a session key so that many blocks can be
+ * processed without re-initializing the key schedule each time.
+ *
+ * @param sessionkey the key to use
+ * @return the context, NULL on error
+ */
+struct GNUNET_CRYPTO_SymmetricContext *
+GNUNET_CRYPTO_symmetric_context_create (const struct GNUNET_CRYPTO_SymmetricSessionKey *sessionkey)
+{
+  struct GNUNET_CRYPTO_SymmetricContext *ctx;
+
+  ctx = GNUNET_new (struct GNUNET_CRYPTO_SymmetricContext);
+  setup_context (ctx, sessionkey);
+  return ctx;
+}
+
+
+/**
+ * Destroy a symmetric context, wiping the key material.
+ *
+ * @param ctx context to destroy
+ */
+void
+GNUNET_CRYPTO_symmetric_context_destroy (struct GNUNET_CRYPTO_SymmetricContext *ctx)
+{
+  /* gcry_cipher_close() wipes the key schedule */
+  cleanup_context (ctx);
+  GNUNET_free (ctx);
+}
+
+
+/**
+ * Encrypt a block using a prepared symmetric context.
+ *
+ * @param ctx the context to use
+ * @param block the block to encrypt
+ * @param size the size of the @a block
+ * @param iv the initialization vector to use
+ * @param result where to store the result, can be the same as @a block
+ * @return the size of the encrypted block, -1 for errors
+ */
+ssize_t
+GNUNET_CRYPTO_symmetric_context_encrypt (struct GNUNET_CRYPTO_SymmetricContext *ctx,
+                                         const void *block, size_t size,
+                                         const struct GNUNET_CRYPTO_SymmetricInitializationVector *iv,
+                                         void *result)
+{
+  if (result != block)
+    memmove (result, block, size);
+  encrypt_in_place (ctx, iv, result, size);
+  return size;
+}
+
+
+/**
+ * Decrypt a block using a prepared symmetric context.
+ *
+ * @param ctx the context to use
+ * @param block the data to decrypt
+ * @param size the size of the @a block
+ * @param iv the initialization vector to use
+ * @param result where to store the result, can be the same as @a block
+ * @return -1 on failure, size of decrypted block on success
+ */
+ssize_t
+GNUNET_CRYPTO_symmetric_context_decrypt (struct GNUNET_CRYPTO_SymmetricContext *ctx,
+                                         const void *block, size_t size,
+                                         const struct GNUNET_CRYPTO_SymmetricInitializationVector *iv,
+                                         void *result)
+{
+  if (result != block)
+    memmove (result, block, size);
+  decrypt_in_place (ctx, iv, result, size);
   return size;
 }
 
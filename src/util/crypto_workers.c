@@ -0,0 +1,596 @@
+/*
+     This file is part of GNUnet.
+     (C) 2014 Christian Grothoff (and other contributing authors)
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+     Boston, MA 02111-1307, USA.
+*/
+
+/**
+ * @file util/crypto_workers.c
+ * @brief pool of threads performing cryptographic work (such as
+ *        signature verification) outside of the scheduler thread
+ */
+#include "platform.h"
+#include "gnunet_util_lib.h"
+#if HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+#define LOG(kind,...) GNUNET_log_from (kind, "util", __VA_ARGS__)
+
+/**
+ * Upper bound on the number of threads of a pool.
+ */
+#define MAX_WORKER_THREADS 64
+
+/**
+ * How many jobs does a worker take from the queue at a time, and
+ * how many jobs do we run per task if we have no threads?
+ */
+#define WORKER_BATCH_SIZE 16
+
+#if HAVE_PTHREAD_H
+#define LOCK(pool) GNUNET_assert (0 == pthread_mutex_lock (&(pool)->lock))
+#define UNLOCK(pool) GNUNET_assert (0 == pthread_mutex_unlock (&(pool)->lock))
+#else
+#define LOCK(pool)
+#define UNLOCK(pool)
+#endif
+
+
+/**
+ * State of a job.
+ */
+enum JobState
+{
+  /**
+   * Job is in the queue of the pool.
+   */
+  JS_QUEUED,
+
+  /**
+   * Job was taken from the queue by a worker.
+   */
+  JS_RUNNING,
+
+  /**
+   * Job is done and waits for its continuation to be called.
+   */
+  JS_DONE,
+
+  /**
+   * The continuation of the job is being called.
+   */
+  JS_DELIVERING
+};
+
+
+/**
+ * A job submitted to a worker pool.
+ */
+struct GNUNET_CRYPTO_WorkerJob
+{
+  /**
+   * Kept in a DLL (queue, batch of a worker, or done list).
+   */
+  struct GNUNET_CRYPTO_WorkerJob *next;
+
+  /**
+   * Kept in a DLL (queue, batch of a worker, or done list).
+   */
+  struct GNUNET_CRYPTO_WorkerJob *prev;
+
+  /**
+   * Pool the job was submitted to.
+   */
+  struct GNUNET_CRYPTO_WorkerPool *pool;
+
+  /**
+   * Function to run.
+   */
+  GNUNET_CRYPTO_WorkerFunction work;
+
+  /**
+   * Closure for @e work.
+   */
+  void *work_cls;
+
+  /**
+   * Function to call with the result.
+   */
+  GNUNET_CRYPTO_WorkerContinuation cont;
+
+  /**
+   * Closure for @e cont.
+   */
+  void *cont_cls;
+
+  /**
+   * Result of @e work, valid in state #JS_DONE.
+   */
+  int result;
+
+  /**
+   * State of the job.
+   */
+  enum JobState state;
+};
+
+
+/**
+ * Handle for a pool of worker threads.
+ */
+struct GNUNET_CRYPTO_WorkerPool
+{
+  /**
+   * Jobs not yet taken by a worker.
+   */
+  struct GNUNET_CRYPTO_WorkerJob *queue_head;
+
+  /**
+   * Jobs not yet taken by a worker.
+   */
+  struct GNUNET_CRYPTO_WorkerJob *queue_tail;
+
+  /**
+   * Jobs whose continuation is still to be called.
+   */
+  struct GNUNET_CRYPTO_WorkerJob *done_head;
+
+  /**
+   * Jobs whose continuation is still to be called.
+   */
+  struct GNUNET_CRYPTO_WorkerJob *done_tail;
+
+  /**
+   * Task delivering results (or running jobs if we have no threads).
+   */
+  GNUNET_SCHEDULER_TaskIdentifier deliver_task;
+
+  /**
+   * Number of jobs submitted whose continuation was not yet called
+   * and that were not cancelled.
+   */
+  unsigned int pending;
+
+  /**
+   * Maximum number of worker threads.
+   */
+  unsigned int max_workers;
+
+  /**
+   * Number of worker threads started.
+   */
+  unsigned int num_workers;
+
+  /**
+   * Number of workers waiting for jobs.
+   */
+  unsigned int idle_workers;
+
+  /**
+   * #GNUNET_YES while we are calling continuations.
+   */
+  int in_deliver;
+
+  /**
+   * #GNUNET_YES if the pool was destroyed from a continuation.
+   */
+  int destroyed;
+
+  /**
+   * Should the workers terminate?
+   */
+  int stop;
+
+#if HAVE_PTHREAD_H
+  /**
+   * Worker threads, array of length @e max_workers.
+   */
+  pthread_t *workers;
+
+  /**
+   * Lock protecting the job lists, the job states and the
+   * worker counters.
+   */
+  pthread_mutex_t lock;
+
+  /**
+   * Signalled when jobs are added to the queue or the workers
+   * should stop.
+   */
+  pthread_cond_t work_cond;
+
+  /**
+   * Signalled when a worker finished a batch of jobs.
+   */
+  pthread_cond_t done_cond;
+
+  /**
+   * Pipe workers write to if the done list became non-empty.
+   */
+  struct GNUNET_DISK_PipeHandle *wakeup;
+#endif
+};
+
+
+#if HAVE_PTHREAD_H
+/**
+ * Main function of a worker thread: take batches of jobs from the
+ * queue, run them and pass them back to the scheduler thread.
+ *
+ * @param cls the `struct GNUNET_CRYPTO_WorkerPool`
+ * @return NULL
+ */
+static void *
+worker_main (void *cls)
+{
+  struct GNUNET_CRYPTO_WorkerPool *pool = cls;
+  struct GNUNET_CRYPTO_WorkerJob *batch_head;
+  struct GNUNET_CRYPTO_WorkerJob *batch_tail;
+  struct GNUNET_CRYPTO_WorkerJob *job;
+  const struct GNUNET_DISK_FileHandle *fh;
+  unsigned int i;
+  int notify;
+
+  LOCK (pool);
+  while (GNUNET_NO == pool->stop)
+  {
+    if (NULL == pool->queue_head)
+    {
+      pool->idle_workers++;
+      GNUNET_assert (0 == pthread_cond_wait (&pool->work_cond, &pool->lock));
+      pool->idle_workers--;
+      continue;
+    }
+    batch_head = NULL;
+    batch_tail = NULL;
+    for (i = 0; (i < WORKER_BATCH_SIZE) && (NULL != (job = pool->queue_head)); i++)
+    {
+      GNUNET_CONTAINER_DLL_remove (pool->queue_head, pool->queue_tail, job);
+      GNUNET_CONTAINER_DLL_insert_tail (batch_head, batch_tail, job);
+      job->state = JS_RUNNING;
+    }
+    UNLOCK (pool);
+    for (job = batch_head; NULL != job; job = job->next)
+      job->result = job->work (job->work_cls);
+    LOCK (pool);
+    notify = (NULL == pool->done_head);
+    while (NULL != (job = batch_head))
+    {
+      GNUNET_CONTAINER_DLL_remove (batch_head, batch_tail, job);
+      GNUNET_CONTAINER_DLL_insert_tail (pool->done_head, pool->done_tail, job);
+      job->state = JS_DONE;
+    }
+    GNUNET_assert (0 == pthread_cond_broadcast (&pool->done_cond));
+    if (notify)
+    {
+      /* one byte per batch that made the done list non-empty */
+      fh = GNUNET_DISK_pipe_handle (pool->wakeup,
+                                    GNUNET_DISK_PIPE_END_WRITE);
+      GNUNET_break (1 == GNUNET_DISK_file_write (fh, "", 1));
+    }
+  }
+  UNLOCK (pool);
+  return NULL;
+}
+#endif
+
+
+static void
+deliver_results (void *cls,
+                 const struct GNUNET_SCHEDULER_TaskContext *tc);
+
+
+/**
+ * Make sure we deliver results while jobs are pending, and do not
+ * keep the scheduler alive otherwise.
+ *
+ * @param pool the pool
+ */
+static void
+schedule_deliver (struct GNUNET_CRYPTO_WorkerPool *pool)
+{
+  if (0 == pool->pending)
+  {
+    if (GNUNET_SCHEDULER_NO_TASK != pool->deliver_task)
+    {
+      GNUNET_SCHEDULER_cancel (pool->deliver_task);
+      pool->deliver_task = GNUNET_SCHEDULER_NO_TASK;
+    }
+    return;
+  }
+  if (GNUNET_SCHEDULER_NO_TASK != pool->deliver_task)
+    return;
+#if HAVE_PTHREAD_H
+  if (0 != pool->num_workers)
+  {
+    pool->deliver_task =
+        GNUNET_SCHEDULER_add_read_file (GNUNET_TIME_UNIT_FOREVER_REL,
+                                        GNUNET_DISK_pipe_handle (pool->wakeup,
+                                                                 GNUNET_DISK_PIPE_END_READ),
+                                        &deliver_results, pool);
+    return;
+  }
+#endif
+  pool->deliver_task = GNUNET_SCHEDULER_add_now (&deliver_results, pool);
+}
+
+
+/**
+ * Release all resources of a pool, discarding all jobs.
+ *
+ * @param pool the pool
+ */
+static void
+destroy_pool (struct GNUNET_CRYPTO_WorkerPool *pool)
+{
+  struct GNUNET_CRYPTO_WorkerJob *job;
+#if HAVE_PTHREAD_H
+  unsigned int i;
+
+  LOCK (pool);
+  pool->stop = GNUNET_YES;
+  GNUNET_assert (0 == pthread_cond_broadcast (&pool->work_cond));
+  UNLOCK (pool);
+  for (i = 0; i < pool->num_workers; i++)
+    GNUNET_assert (0 == pthread_join (pool->workers[i], NULL));
+  GNUNET_free_non_null (pool->workers);
+  if (NULL != pool->wakeup)
+    GNUNET_DISK_pipe_close (pool->wakeup);
+  GNUNET_assert (0 == pthread_cond_destroy (&pool->work_cond));
+  GNUNET_assert (0 == pthread_cond_destroy (&pool->done_cond));
+  GNUNET_assert (0 == pthread_mutex_destroy (&pool->lock));
+#endif
+  if (GNUNET_SCHEDULER_NO_TASK != pool->deliver_task)
+    GNUNET_SCHEDULER_cancel (pool->deliver_task);
+  while (NULL != (job = pool->queue_head))
+  {
+    GNUNET_CONTAINER_DLL_remove (pool->queue_head, pool->queue_tail, job);
+    GNUNET_free (job);
+  }
+  while (NULL != (job = pool->done_head))
+  {
+    GNUNET_CONTAINER_DLL_remove (pool->done_head, pool->done_tail, job);
+    GNUNET_free (job);
+  }
+  GNUNET_free (pool);
+}
+
+
+/**
+ * Call the continuations of finished jobs.  If the pool has no
+ * worker threads, run a batch of jobs first.
+ *
+ * @param cls the `struct GNUNET_CRYPTO_WorkerPool`
+ * @param tc scheduler context
+ */
+static void
+deliver_results (void *cls,
+                 const struct GNUNET_SCHEDULER_TaskContext *tc)
+{
+  struct GNUNET_CRYPTO_WorkerPool *pool = cls;
+  struct GNUNET_CRYPTO_WorkerJob *job;
+  unsigned int i;
+
+  pool->deliver_task = GNUNET_SCHEDULER_NO_TASK;
+#if HAVE_PTHREAD_H
+  if (0 != pool->num_workers)
+  {
+    char buf[WORKER_BATCH_SIZE];
+
+    /* the workers write at most one byte per batch, but a short
+       read just means we are woken up again for nothing */
+    (void) GNUNET_DISK_file_read (GNUNET_DISK_pipe_handle (pool->wakeup,
+                                                           GNUNET_DISK_PIPE_END_READ),
+                                  buf, sizeof (buf));
+  }
+  else
+#endif
+  {
+    for (i = 0; i < WORKER_BATCH_SIZE; i++)
+    {
+      LOCK (pool);
+      job = pool->queue_head;
+      if (NULL != job)
+        GNUNET_CONTAINER_DLL_remove (pool->queue_head, pool->queue_tail, job);
+      UNLOCK (pool);
+      if (NULL == job)
+        break;
+      job->result = job->work (job->work_cls);
+      LOCK (pool);
+      job->state = JS_DONE;
+      GNUNET_CONTAINER_DLL_insert_tail (pool->done_head, pool->done_tail, job);
+      UNLOCK (pool);
+    }
+  }
+  pool->in_deliver = GNUNET_YES;
+  while (GNUNET_NO == pool->destroyed)
+  {
+    LOCK (pool);
+    job = pool->done_head;
+    if (NULL != job)
+    {
+      GNUNET_CONTAINER_DLL_remove (pool->done_head, pool->done_tail, job);
+      job->state = JS_DELIVERING;
+    }
+    UNLOCK (pool);
+    if (NULL == job)
+      break;
+    pool->pending--;
+    job->cont (job->cont_cls, job->result);
+    GNUNET_free (job);
+  }
+  pool->in_deliver = GNUNET_NO;
+  if (GNUNET_YES == pool->destroyed)
+  {
+    destroy_pool (pool);
+    return;
+  }
+  schedule_deliver (pool);
+}
+
+
+/**
+ * Create a pool of threads for cryptographic work.  The threads
+ * are started when jobs are submitted.  If threads are not
+ * available, jobs are run (in batches) by the scheduler.
+ *
+ * @param threads maximum number of threads, 0 for one per CPU
+ * @return the pool
+ */
+struct GNUNET_CRYPTO_WorkerPool *
+GNUNET_CRYPTO_worker_pool_create (unsigned int threads)
+{
+  struct GNUNET_CRYPTO_WorkerPool *pool;
+
+  pool = GNUNET_new (struct GNUNET_CRYPTO_WorkerPool);
+#if HAVE_PTHREAD_H
+#if HAVE_SYSCONF && defined(_SC_NPROCESSORS_ONLN)
+  if (0 == threads)
+  {
+    long cpus;
+
+    cpus = sysconf (_SC_NPROCESSORS_ONLN);
+    threads = (cpus > 0) ? cpus : 1;
+  }
+#endif
+  if (0 == threads)
+    threads = 1;
+  if (threads > MAX_WORKER_THREADS)
+    threads = MAX_WORKER_THREADS;
+  GNUNET_assert (0 == pthread_mutex_init (&pool->lock, NULL));
+  GNUNET_assert (0 == pthread_cond_init (&pool->work_cond, NULL));
+  GNUNET_assert (0 == pthread_cond_init (&pool->done_cond, NULL));
+  pool->wakeup = GNUNET_DISK_pipe (GNUNET_NO, GNUNET_NO, GNUNET_NO, GNUNET_NO);
+  if (NULL != pool->wakeup)
+  {
+    pool->max_workers = threads;
+    pool->workers = GNUNET_malloc (threads * sizeof (pthread_t));
+  }
+#endif
+  return pool;
+}
+
+
+/**
+ * Destroy a worker pool.  Continuations of jobs that are still
+ * pending are not called; jobs being run are completed first.
+ *
+ * @param pool pool to destroy
+ */
+void
+GNUNET_CRYPTO_worker_pool_destroy (struct GNUNET_CRYPTO_WorkerPool *pool)
+{
+  if (GNUNET_YES == pool->in_deliver)
+  {
+    /* called from a continuation, clean up once it returns */
+    pool->destroyed = GNUNET_YES;
+    return;
+  }
+  destroy_pool (pool);
+}
+
+
+/**
+ * Submit a job to a worker pool.  Jobs submitted together are
+ * handed to the workers and passed back to the scheduler in
+ * batches.
+ *
+ * @param pool pool to use
+ * @param work function to run in a worker thread
+ * @param work_cls closure for @a work, must remain valid until
+ *        @a cont was called or the job was cancelled
+ * @param cont function to call (from the scheduler) with the result
+ * @param cont_cls closure for @a cont
+ * @return handle to cancel the job
+ */
+struct GNUNET_CRYPTO_WorkerJob *
+GNUNET_CRYPTO_worker_pool_submit (struct GNUNET_CRYPTO_WorkerPool *pool,
+                                  GNUNET_CRYPTO_WorkerFunction work,
+                                  void *work_cls,
+                                  GNUNET_CRYPTO_WorkerContinuation cont,
+                                  void *cont_cls)
+{
+  struct GNUNET_CRYPTO_WorkerJob *job;
+
+  job = GNUNET_new (struct GNUNET_CRYPTO_WorkerJob);
+  job->pool = pool;
+  job->work = work;
+  job->work_cls = work_cls;
+  job->cont = cont;
+  job->cont_cls = cont_cls;
+  job->state = JS_QUEUED;
+  LOCK (pool);
+  GNUNET_CONTAINER_DLL_insert_tail (pool->queue_head, pool->queue_tail, job);
+#if HAVE_PTHREAD_H
+  if ( (0 == pool->idle_workers) &&
+       (pool->num_workers < pool->max_workers) )
+  {
+    if (0 == pthread_create (&pool->workers[pool->num_workers], NULL,
+                             &worker_main, pool))
+      pool->num_workers++;
+    else
+      LOG (GNUNET_ERROR_TYPE_WARNING,
+           "Failed to start crypto worker thread: %s\n",
+           STRERROR (errno));
+  }
+  GNUNET_assert (0 == pthread_cond_signal (&pool->work_cond));
+#endif
+  UNLOCK (pool);
+  pool->pending++;
+  schedule_deliver (pool);
+  return job;
+}
+
+
+/**
+ * Cancel a job.  If a worker is currently running the job, this
+ * waits for it to finish.  The continuation is not called.  Must
+ * not be used once the continuation returned; calling it from the
+ * continuation of the job itself has no effect.
+ *
+ * @param job job to cancel
+ */
+void
+GNUNET_CRYPTO_worker_job_cancel (struct GNUNET_CRYPTO_WorkerJob *job)
+{
+  struct GNUNET_CRYPTO_WorkerPool *pool = job->pool;
+
+  LOCK (pool);
+  if (JS_DELIVERING == job->state)
+  {
+    /* not in any list anymore, freed once the continuation returns */
+    UNLOCK (pool);
+    return;
+  }
+#if HAVE_PTHREAD_H
+  while (JS_RUNNING == job->state)
+    GNUNET_assert (0 == pthread_cond_wait (&pool->done_cond, &pool->lock));
+#endif
+  if (JS_QUEUED == job->state)
+    GNUNET_CONTAINER_DLL_remove (pool->queue_head, pool->queue_tail, job);
+  else
+    GNUNET_CONTAINER_DLL_remove (pool->done_head, pool->done_tail, job);
+  UNLOCK (pool);
+  GNUNET_free (job);
+  pool->pending--;
+  if (GNUNET_NO == pool->in_deliver)
+    schedule_deliver (pool);
+}
+
+
+/* end of crypto_workers.c */
@@ -26,7 +26,6 @@
  */
 #include "platform.h"
 #include "gnunet_util_lib.h"
-#include <gcrypt.h>
 
 /**
  * Amount of work required (W-bit collisions) for NSE proofs, in collision-bits.
@@ -34,13 +33,18 @@
 static unsigned long long nse_work_required;
 
 /**
- * Interval between proof find runs.
+ * Interval between proof find runs (if we search without threads).
  */
 static struct GNUNET_TIME_Relative proof_find_delay;
 
+/**
+ * Number of threads to search with, 0 for one per CPU.
+ */
+static unsigned int proof_find_threads;
+
 static struct GNUNET_CRYPTO_EddsaPublicKey pub;
 uint64_t proof;
-GNUNET_SCHEDULER_TaskIdentifier proof_task;
+struct GNUNET_CRYPTO_PowSearch *proof_search;
 const struct GNUNET_CONFIGURATION_Handle *cfg;
 
 char *pkfn;
@@ -56,119 +60,60 @@ write_proof ()
       GNUNET_DISK_fn_write (pwfn, &proof, sizeof (proof),
                             GNUNET_DISK_PERM_USER_READ |
                             GNUNET_DISK_PERM_USER_WRITE))
-    GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_WARNING, "write", proof);
+    GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_WARNING, "write", pwfn);
 }
 
 
 /**
- * Calculate the 'proof-of-work' hash (an expensive hash).
+ * Called with the progress of the search for the proof of work,
+ * or with the proof once it was found.
  *
- * @param buf data to hash
- * @param buf_len number of bytes in @a buf
- * @param result where to write the resulting hash
+ * @param cls closure (unused)
+ * @param pow the proof, or the value to resume the search at
+ * @param hash_rate hashes per second calculated recently
+ * @param found #GNUNET_YES if @a pow is the proof of work
  */
 static void
-pow_hash (const void *buf,
-          size_t buf_len,
-          struct GNUNET_HashCode *result)
-{
-  GNUNET_break (0 ==
-  gcry_kdf_derive (buf, buf_len,
-                   GCRY_KDF_SCRYPT,
-                   1 /* subalgo */,
-                   "gnunet-proof-of-work", strlen ("gnunet-proof-of-work"),
-                   2 /* iterations; keep cost of individual op small */,
-                   sizeof (struct GNUNET_HashCode), result));
-}
-
-
-
-/**
- * Count the leading zeroes in hash.
- *
- * @param hash to count leading zeros in
- * @return the number of leading zero bits.
- */
-static unsigned int
-count_leading_zeroes (const struct GNUNET_HashCode *hash)
+proof_search_cb (void *cls,
+                 uint64_t pow,
+                 uint64_t hash_rate,
+                 int found)
 {
-  unsigned int hash_count;
-
-  hash_count = 0;
-  while (0 == GNUNET_CRYPTO_hash_get_bit (hash, hash_count))
-    hash_count++;
-  return hash_count;
+  proof = pow;
+  if (GNUNET_YES == found)
+  {
+    proof_search = NULL;
+    FPRINTF (stdout, "Proof of work found: %llu!\n",
+             (unsigned long long) proof);
+    write_proof ();
+    GNUNET_SCHEDULER_shutdown ();
+    return;
+  }
+  GNUNET_log (GNUNET_ERROR_TYPE_INFO,
+              "Current: %llu [%llu proofs/s]\n",
+              (unsigned long long) proof,
+              (unsigned long long) hash_rate);
+  /* remember progress */
+  write_proof ();
 }
 
 
 /**
- * Find our proof of work.
+ * Stop the search and remember how far we got.
  *
  * @param cls closure (unused)
- * @param tc task context
+ * @param tc scheduler context
  */
 static void
-find_proof (void *cls,
-            const struct GNUNET_SCHEDULER_TaskContext *tc)
+do_shutdown (void *cls,
+             const struct GNUNET_SCHEDULER_TaskContext *tc)
 {
-  #define ROUND_SIZE 10
-  uint64_t counter;
-  char buf[sizeof (struct GNUNET_CRYPTO_EddsaPublicKey) +
-           sizeof (uint64_t)] GNUNET_ALIGN;
-  struct GNUNET_HashCode result;
-  unsigned int i;
-  struct GNUNET_TIME_Absolute timestamp;
-  struct GNUNET_TIME_Relative elapsed;
-
-  if (0 != (GNUNET_SCHEDULER_REASON_SHUTDOWN & tc->reason))
-  {
-    write_proof ();
-    return;
-  }
-  GNUNET_log (GNUNET_ERROR_TYPE_DEBUG, "Got Proof of Work %llu\n", proof);
-  proof_task = GNUNET_SCHEDULER_NO_TASK;
-  memcpy (&buf[sizeof (uint64_t)], &pub,
-          sizeof (struct GNUNET_CRYPTO_EddsaPublicKey));
-  i = 0;
-  counter = proof;
-  timestamp = GNUNET_TIME_absolute_get ();
-  while ((counter != UINT64_MAX) && (i < ROUND_SIZE))
-  {
-    memcpy (buf, &counter, sizeof (uint64_t));
-    pow_hash (buf, sizeof (buf), &result);
-    if (nse_work_required <= count_leading_zeroes (&result))
-    {
-      proof = counter;
-      FPRINTF (stdout, "Proof of work found: %llu!\n",
-               (unsigned long long) proof);
-      write_proof ();
-      return;
-    }
-    counter++;
-    i++;
-  }
-  elapsed = GNUNET_TIME_absolute_get_duration (timestamp);
-  elapsed = GNUNET_TIME_relative_divide (elapsed, ROUND_SIZE);
-  GNUNET_log (GNUNET_ERROR_TYPE_INFO,
-              "Current: %llu [%s/proof]\n",
-              (unsigned long long) counter,
-              GNUNET_STRINGS_relative_time_to_string (elapsed, 0));
-  if (proof / (100 * ROUND_SIZE) < counter / (100 * ROUND_SIZE))
+  if (NULL != proof_search)
   {
-    GNUNET_log (GNUNET_ERROR_TYPE_DEBUG, "Testing proofs currently at %llu\n",
-                (unsigned long long) counter);
-    /* remember progress every 100 rounds */
-    proof = counter;
+    proof = GNUNET_CRYPTO_pow_search_stop (proof_search);
+    proof_search = NULL;
     write_proof ();
   }
-  else
-  {
-    proof = counter;
-  }
-  proof_task =
-  GNUNET_SCHEDULER_add_delayed_with_priority (proof_find_delay,
-                                              GNUNET_SCHEDULER_PRIORITY_IDLE,
-                                              &find_proof, NULL);
 }
 
 
@@ -259,8 +204,17 @@ run (void *cls, char *const *args, const char *cfgfile,
 
   GNUNET_log (GNUNET_ERROR_TYPE_DEBUG, "Delay between tries: %s\n",
               GNUNET_STRINGS_relative_time_to_string (proof_find_delay, 1));
-  GNUNET_SCHEDULER_add_with_priority (GNUNET_SCHEDULER_PRIORITY_IDLE,
-                                      &find_proof, NULL);
+  proof_search =
+      GNUNET_CRYPTO_pow_search_start ("gnunet-proof-of-work",
+                                      &pub, sizeof (pub),
+                                      proof,
+                                      (unsigned int) nse_work_required,
+                                      proof_find_threads,
+                                      proof_find_delay,
+                                      GNUNET_TIME_UNIT_SECONDS,
+                                      &proof_search_cb, NULL);
+  GNUNET_SCHEDULER_add_delayed (GNUNET_TIME_UNIT_FOREVER_REL,
+                                &do_shutdown, NULL);
 }
 
 
@@ -285,8 +239,11 @@ main (int argc, char *const *argv)
       gettext_noop ("file with proof of work, otherwise default is used"),
       1, &GNUNET_GETOPT_set_filename, &pwfn },
     { 't', "timeout", "TIME",
-      gettext_noop ("time to wait between calculations"),
+      gettext_noop ("time to wait between calculations (without threads)"),
       1, &GNUNET_GETOPT_set_relative_time, &proof_find_delay },
+    { 'T', "threads", "THREADS",
+      gettext_noop ("number of threads to use, 0 (default) for one per CPU"),
+      1, &GNUNET_GETOPT_set_uint, &proof_find_threads },
     GNUNET_GETOPT_OPTION_END
   };
   int ret;
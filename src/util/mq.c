@@ -25,6 +25,8 @@
  */
 #include "platform.h"
 #include "gnunet_util_lib.h"
+#include "gnunet_protocols.h"
+#include "shm_ring.h"
 
 #define LOG(kind,...) GNUNET_log_from (kind, "mq",__VA_ARGS__)
 
@@ -63,6 +65,13 @@ struct GNUNET_MQ_Envelope
    * Closure for send_cb
    */
   void *sent_cls;
+
+  /**
+   * #GNUNET_YES if the message was already copied into the
+   * transmission buffer together with the current message,
+   * and only waits for its sent notification.
+   */
+  int flushed;
 };
 
 
@@ -125,6 +134,18 @@ struct GNUNET_MQ_Handle
    */
   struct GNUNET_MQ_Envelope *current_envelope;
 
+  /**
+   * Messages that were transmitted in the same batch as
+   * @e current_envelope, waiting for their sent notification.
+   */
+  struct GNUNET_MQ_Envelope *flushed_head;
+
+  /**
+   * Messages that were transmitted in the same batch as
+   * @e current_envelope, waiting for their sent notification.
+   */
+  struct GNUNET_MQ_Envelope *flushed_tail;
+
   /**
    * Map of associations, lazily allocated
    */
@@ -184,9 +205,33 @@ struct ClientConnectionState
   struct GNUNET_CLIENT_Connection *connection;
 
   /**
-   * Active transmission request (or NULL).
+   * Active transmission request (or NULL).  Once @e ring_ready,
+   * this only carries doorbells.
    */
   struct GNUNET_CLIENT_TransmitHandle *th;
+
+  /**
+   * Shared-memory ring we offered to the service, or NULL.
+   */
+  struct GNUNET_SHM_Ring *ring;
+
+  /**
+   * Task to write the current message again after the ring
+   * was full.
+   */
+  GNUNET_SCHEDULER_TaskIdentifier retry_task;
+
+  /**
+   * #GNUNET_YES once the offer of the ring went out; all further
+   * messages are then written to the ring.
+   */
+  int ring_ready;
+
+  /**
+   * #GNUNET_YES if the current message is in the ring, but we
+   * wait for the doorbell to go out before continuing.
+   */
+  int continue_on_doorbell;
 };
 
 
@@ -306,6 +351,8 @@ impl_send_continue (void *cls,
 {
   struct GNUNET_MQ_Handle *mq = cls;
   struct GNUNET_MQ_Envelope *current_envelope;
+  struct GNUNET_MQ_Envelope *flushed;
+  struct GNUNET_MQ_Envelope *ev;
 
   if ((tc->reason & GNUNET_SCHEDULER_REASON_SHUTDOWN) != 0)
     return;
@@ -316,6 +363,16 @@ impl_send_continue (void *cls,
   current_envelope = mq->current_envelope;
   GNUNET_assert (NULL != current_envelope);
   current_envelope->parent_queue = NULL;
+  /* detach the rest of the batch, the sent callbacks may
+     queue new messages or even destroy the queue */
+  flushed = mq->flushed_head;
+  mq->flushed_head = NULL;
+  mq->flushed_tail = NULL;
+  for (ev = flushed; NULL != ev; ev = ev->next)
+  {
+    ev->parent_queue = NULL;
+    ev->flushed = GNUNET_NO;
+  }
   if (NULL == mq->envelope_head)
   {
     mq->current_envelope = NULL;
@@ -331,6 +388,13 @@ impl_send_continue (void *cls,
   if (NULL != current_envelope->sent_cb)
     current_envelope->sent_cb (current_envelope->sent_cls);
   GNUNET_free (current_envelope);
+  while (NULL != (ev = flushed))
+  {
+    flushed = ev->next;
+    if (NULL != ev->sent_cb)
+      ev->sent_cb (ev->sent_cls);
+    GNUNET_free (ev);
+  }
 }
 
 
@@ -478,6 +542,74 @@ GNUNET_MQ_msg_nested_mh_ (struct GNUNET_MessageHeader **mhp,
 }
 
 
+/**
+ * Compute how much buffer space to ask for to transmit @a msg
+ * together with the messages queued behind it.
+ *
+ * @param mq message queue
+ * @param msg the current message of @a mq
+ * @return number of bytes to request, below #GNUNET_SERVER_MAX_MESSAGE_SIZE
+ */
+static size_t
+batch_size (struct GNUNET_MQ_Handle *mq,
+            const struct GNUNET_MessageHeader *msg)
+{
+  struct GNUNET_MQ_Envelope *ev;
+  size_t total;
+
+  total = ntohs (msg->size);
+  for (ev = mq->envelope_head; NULL != ev; ev = ev->next)
+  {
+    if (total + ntohs (ev->mh->size) >= GNUNET_SERVER_MAX_MESSAGE_SIZE)
+      break;
+    total += ntohs (ev->mh->size);
+  }
+  return total;
+}
+
+
+/**
+ * Copy the current message and as many of the queued messages
+ * as fit into @a buf, so that they leave with a single write.
+ * The queued messages copied are moved to the flushed list and
+ * are notified as sent together with the current message.
+ *
+ * @param mq message queue
+ * @param size number of bytes available in @a buf
+ * @param buf where to copy the messages
+ * @return number of bytes written to @a buf
+ */
+static size_t
+pack_batch (struct GNUNET_MQ_Handle *mq,
+            size_t size,
+            void *buf)
+{
+  const struct GNUNET_MessageHeader *msg = GNUNET_MQ_impl_current (mq);
+  struct GNUNET_MQ_Envelope *ev;
+  char *cbuf = buf;
+  size_t off;
+  size_t msg_size;
+
+  off = ntohs (msg->size);
+  GNUNET_assert (size >= off);
+  memcpy (cbuf, msg, off);
+  while ( (NULL != (ev = mq->envelope_head)) &&
+          (off + (msg_size = ntohs (ev->mh->size)) <= size) )
+  {
+    GNUNET_CONTAINER_DLL_remove (mq->envelope_head,
+                                 mq->envelope_tail,
+                                 ev);
+    memcpy (&cbuf[off], ev->mh, msg_size);
+    off += msg_size;
+    ev->flushed = GNUNET_YES;
+    GNUNET_CONTAINER_DLL_insert_tail (mq->flushed_head,
+                                      mq->flushed_tail,
+                                      ev);
+  }
+  return off;
+}
+
+
 /**
  * Transmit a queued message to the session's client.
  *
@@ -492,14 +624,11 @@ transmit_queued (void *cls, size_t size,
 {
   struct GNUNET_MQ_Handle *mq = cls;
   struct ServerClientSocketState *state = GNUNET_MQ_impl_state (mq);
-  const struct GNUNET_MessageHeader *msg = GNUNET_MQ_impl_current (mq);
   size_t msg_size;
 
   GNUNET_assert (NULL != buf);
 
-  msg_size = ntohs (msg->size);
-  GNUNET_assert (size >= msg_size);
-  memcpy (buf, msg, msg_size);
+  msg_size = pack_batch (mq, size, buf);
   state->th = NULL;
 
   GNUNET_MQ_impl_send_continue (mq);
@@ -537,7 +666,8 @@ server_client_send_impl (struct GNUNET_MQ_Handle *mq,
   GNUNET_assert (NULL != mq);
   GNUNET_assert (NULL != state);
   state->th =
-      GNUNET_SERVER_notify_transmit_ready (state->client, ntohs (msg->size),
+      GNUNET_SERVER_notify_transmit_ready (state->client,
+                                           batch_size (mq, msg),
                                            GNUNET_TIME_UNIT_FOREVER_REL,
                                            &transmit_queued, mq);
 }
@@ -603,12 +733,10 @@ connection_client_transmit_queued (void *cls,
                                    void *buf)
 {
   struct GNUNET_MQ_Handle *mq = cls;
-  const struct GNUNET_MessageHeader *msg;
   struct ClientConnectionState *state = mq->impl_state;
   size_t msg_size;
 
   GNUNET_assert (NULL != mq);
-  msg = GNUNET_MQ_impl_current (mq);
 
   if (NULL == buf)
   {
@@ -624,10 +752,10 @@ connection_client_transmit_queued (void *cls,
                            GNUNET_TIME_UNIT_FOREVER_REL);
   }
 
-  msg_size = ntohs (msg->size);
-  GNUNET_assert (size >= msg_size);
-  memcpy (buf, msg, msg_size);
+  msg_size = pack_batch (mq, size, buf);
   state->th = NULL;
+  if (NULL != state->ring)
+    state->ring_ready = GNUNET_YES; /* the offer was the first message */
 
   GNUNET_MQ_impl_send_continue (mq);
 
@@ -635,10 +763,162 @@ connection_client_transmit_queued (void *cls,
 }
 
 
+/**
+ * Tell the service over the socket that there are messages
+ * in the ring.
+ *
+ * @param cls the message queue
+ * @param size number of bytes available in @a buf
+ * @param buf where the callee should write the message
+ * @return number of bytes written to buf
+ */
+static size_t
+ring_transmit_doorbell (void *cls,
+                        size_t size,
+                        void *buf)
+{
+  struct GNUNET_MQ_Handle *mq = cls;
+  struct ClientConnectionState *state = mq->impl_state;
+  struct GNUNET_MessageHeader *msg = buf;
+
+  state->th = NULL;
+  if (NULL == buf)
+  {
+    GNUNET_MQ_inject_error (mq, GNUNET_MQ_ERROR_WRITE);
+    return 0;
+  }
+  GNUNET_assert (size >= sizeof (struct GNUNET_MessageHeader));
+  msg->size = htons (sizeof (struct GNUNET_MessageHeader));
+  msg->type = htons (GNUNET_MESSAGE_TYPE_SHM_RING_DOORBELL);
+  if (GNUNET_YES == state->continue_on_doorbell)
+  {
+    state->continue_on_doorbell = GNUNET_NO;
+    GNUNET_MQ_impl_send_continue (mq);
+  }
+  return sizeof (struct GNUNET_MessageHeader);
+}
+
+
+/**
+ * Write the current message and the messages queued behind it to
+ * the ring, and ring the doorbell if the service went to sleep.
+ *
+ * @param mq message queue with a ready ring
+ */
+static void
+ring_send (struct GNUNET_MQ_Handle *mq);
+
+
+/**
+ * The ring was full, try again.
+ *
+ * @param cls the message queue
+ * @param tc scheduler context
+ */
+static void
+ring_retry (void *cls,
+            const struct GNUNET_SCHEDULER_TaskContext *tc)
+{
+  struct GNUNET_MQ_Handle *mq = cls;
+  struct ClientConnectionState *state = mq->impl_state;
+
+  state->retry_task = GNUNET_SCHEDULER_NO_TASK;
+  ring_send (mq);
+}
+
+
+static void
+ring_send (struct GNUNET_MQ_Handle *mq)
+{
+  struct ClientConnectionState *state = mq->impl_state;
+  struct GNUNET_MQ_Envelope *ev;
+
+  if (GNUNET_OK !=
+      GNUNET_SHM_ring_write_ (state->ring, GNUNET_MQ_impl_current (mq)))
+  {
+    /* the service is busy with what is in the ring already */
+    state->retry_task =
+        GNUNET_SCHEDULER_add_delayed (GNUNET_TIME_UNIT_MILLISECONDS,
+                                      &ring_retry, mq);
+    return;
+  }
+  while ( (NULL != (ev = mq->envelope_head)) &&
+          (GNUNET_OK == GNUNET_SHM_ring_write_ (state->ring, ev->mh)) )
+  {
+    GNUNET_CONTAINER_DLL_remove (mq->envelope_head,
+                                 mq->envelope_tail,
+                                 ev);
+    ev->flushed = GNUNET_YES;
+    GNUNET_CONTAINER_DLL_insert_tail (mq->flushed_head,
+                                      mq->flushed_tail,
+                                      ev);
+  }
+  GNUNET_SHM_ring_unlink_attached_ (state->ring);
+  if ( (GNUNET_YES == GNUNET_SHM_ring_wake_ (state->ring)) &&
+       (NULL == state->th) )
+  {
+    state->th =
+        GNUNET_CLIENT_notify_transmit_ready (state->connection,
+                                             sizeof (struct GNUNET_MessageHeader),
+                                             GNUNET_TIME_UNIT_FOREVER_REL,
+                                             GNUNET_NO,
+                                             &ring_transmit_doorbell, mq);
+    GNUNET_assert (NULL != state->th);
+  }
+  if (NULL != state->th)
+  {
+    /* only report the messages as sent once the service
+       will surely look at them */
+    state->continue_on_doorbell = GNUNET_YES;
+    return;
+  }
+  GNUNET_MQ_impl_send_continue (mq);
+}
+
+
+/**
+ * Offer the service to pass all further messages through a
+ * shared-memory ring.  If the ring cannot be created, we just
+ * stay with the socket.
+ *
+ * @param mq the message queue
+ */
+static void
+ring_offer (struct GNUNET_MQ_Handle *mq)
+{
+  struct ClientConnectionState *state = mq->impl_state;
+  struct GNUNET_SHM_RingOfferMessage *offer;
+  struct GNUNET_MQ_Envelope *env;
+  const char *filename;
+  size_t slen;
+
+  state->ring = GNUNET_SHM_ring_create_ (GNUNET_SHM_RING_SIZE);
+  if (NULL == state->ring)
+    return;
+  filename = GNUNET_SHM_ring_get_name_ (state->ring);
+  slen = strlen (filename) + 1;
+  env = GNUNET_MQ_msg_extra (offer, slen, GNUNET_MESSAGE_TYPE_SHM_RING_OFFER);
+  memcpy (&offer[1], filename, slen);
+  GNUNET_MQ_send (mq, env);
+}
+
+
 static void
 connection_client_destroy_impl (struct GNUNET_MQ_Handle *mq,
                                 void *impl_state)
 {
+  struct ClientConnectionState *state = impl_state;
+
+  if (GNUNET_SCHEDULER_NO_TASK != state->retry_task)
+  {
+    GNUNET_SCHEDULER_cancel (state->retry_task);
+    state->retry_task = GNUNET_SCHEDULER_NO_TASK;
+  }
+  if (NULL != state->ring)
+  {
+    GNUNET_SHM_ring_destroy_ (state->ring);
+    state->ring = NULL;
+  }
   GNUNET_free (impl_state);
 }
 
@@ -651,9 +931,15 @@ connection_client_send_impl (struct GNUNET_MQ_Handle *mq,
   struct ClientConnectionState *state = impl_state;
 
   GNUNET_assert (NULL != state);
+  if (GNUNET_YES == state->ring_ready)
+  {
+    ring_send (mq);
+    return;
+  }
   GNUNET_assert (NULL == state->th);
   state->th =
-      GNUNET_CLIENT_notify_transmit_ready (state->connection, ntohs (msg->size),
+      GNUNET_CLIENT_notify_transmit_ready (state->connection,
+                                           batch_size (mq, msg),
                                            GNUNET_TIME_UNIT_FOREVER_REL, GNUNET_NO,
                                            &connection_client_transmit_queued, mq);
   GNUNET_assert (NULL != state->th);
@@ -665,6 +951,19 @@ connection_client_cancel_impl (struct GNUNET_MQ_Handle *mq,
                                void *impl_state)
 {
   struct ClientConnectionState *state = impl_state;
+
+  if (GNUNET_YES == state->ring_ready)
+  {
+    /* a message in the ring cannot be taken back, but the
+       doorbell may be needed for earlier ones */
+    if (GNUNET_SCHEDULER_NO_TASK != state->retry_task)
+    {
+      GNUNET_SCHEDULER_cancel (state->retry_task);
+      state->retry_task = GNUNET_SCHEDULER_NO_TASK;
+    }
+    state->continue_on_doorbell = GNUNET_NO;
+    return;
+  }
   GNUNET_assert (NULL != state->th);
   GNUNET_CLIENT_notify_transmit_ready_cancel (state->th);
   state->th = NULL;
@@ -694,6 +993,8 @@ GNUNET_MQ_queue_for_connection_client (struct GNUNET_CLIENT_Connection *connecti
   mq->cancel_impl = connection_client_cancel_impl;
   if (NULL != handlers)
     state->receive_requested = GNUNET_YES;
+  if (GNUNET_YES == GNUNET_CLIENT_test_shm_ring_ (connection))
+    ring_offer (mq);
 
   return mq;
 }
@@ -789,6 +1090,15 @@ GNUNET_MQ_destroy (struct GNUNET_MQ_Handle *mq)
     GNUNET_MQ_discard (ev);
   }
 
+  while (NULL != mq->flushed_head)
+  {
+    struct GNUNET_MQ_Envelope *ev;
+    ev = mq->flushed_head;
+    GNUNET_CONTAINER_DLL_remove (mq->flushed_head, mq->flushed_tail, ev);
+    ev->parent_queue = NULL;
+    GNUNET_MQ_discard (ev);
+  }
+
   if (NULL != mq->current_envelope)
   {
     /* we can only discard envelopes that
@@ -874,6 +1184,10 @@ GNUNET_MQ_send_cancel (struct GNUNET_MQ_Envelope *ev)
                                    mq->current_envelope);
       mq->send_impl (mq, mq->current_envelope->mh, mq->impl_state);
     }
+  } else if (GNUNET_YES == ev->flushed) {
+    // message already left with the current one, just
+    // suppress the sent notification
+    GNUNET_CONTAINER_DLL_remove (mq->flushed_head, mq->flushed_tail, ev);
   } else {
     // simple case, message is still waiting in the queue
     GNUNET_CONTAINER_DLL_remove (mq->envelope_head, mq->envelope_tail, ev);
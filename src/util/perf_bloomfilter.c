@@ -0,0 +1,145 @@
+/*
+     This file is part of GNUnet.
+     (C) 2014 Christian Grothoff (and other contributing authors)
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+     Boston, MA 02111-1307, USA.
+*/
+
+/**
+ * @file util/perf_bloomfilter.c
+ * @brief measure how many elements per second we add to and remove
+ *        from file-backed and in-memory bloom filters
+ */
+#include "platform.h"
+#include "gnunet_util_lib.h"
+#include <gauger.h>
+
+/**
+ * Number of elements to add and remove.
+ */
+#define NUM_KEYS (256 * 1024)
+
+/**
+ * Size of the filters in bytes.
+ */
+#define SIZE (1024 * 1024)
+
+/**
+ * Number of bits set per element (as used by the datastore).
+ */
+#define K 5
+
+
+/**
+ * Print the rate of operations since @a start.
+ *
+ * @param what what kind of operation was measured
+ * @param start when the measurement started
+ */
+static void
+report (const char *what,
+        struct GNUNET_TIME_Absolute start)
+{
+  struct GNUNET_TIME_Relative duration;
+  unsigned long long rate;
+
+  duration = GNUNET_TIME_absolute_get_duration (start);
+  rate = NUM_KEYS * 1000LL * 1000LL / (1 + duration.rel_value_us);
+  printf ("%s: %llu ops/s\n", what, rate);
+  GAUGER ("UTIL", what, rate, "ops/s");
+}
+
+
+/**
+ * Add, test and remove all keys.
+ *
+ * @param name name of the filter type
+ * @param bf filter to use
+ * @param keys keys to use
+ */
+static void
+measure (const char *name,
+         struct GNUNET_CONTAINER_BloomFilter *bf,
+         const struct GNUNET_HashCode *keys)
+{
+  struct GNUNET_TIME_Absolute start;
+  char *what;
+  unsigned int i;
+
+  start = GNUNET_TIME_absolute_get ();
+  for (i = 0; i < NUM_KEYS; i++)
+    GNUNET_CONTAINER_bloomfilter_add (bf, &keys[i]);
+  GNUNET_asprintf (&what, "Bloom filter add (%s)", name);
+  report (what, start);
+  GNUNET_free (what);
+
+  start = GNUNET_TIME_absolute_get ();
+  for (i = 0; i < NUM_KEYS; i++)
+    GNUNET_assert (GNUNET_YES ==
+                   GNUNET_CONTAINER_bloomfilter_test (bf, &keys[i]));
+  GNUNET_asprintf (&what, "Bloom filter test (%s)", name);
+  report (what, start);
+  GNUNET_free (what);
+
+  start = GNUNET_TIME_absolute_get ();
+  for (i = 0; i < NUM_KEYS; i++)
+    GNUNET_CONTAINER_bloomfilter_remove (bf, &keys[i]);
+  GNUNET_asprintf (&what, "Bloom filter remove (%s)", name);
+  report (what, start);
+  GNUNET_free (what);
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  struct GNUNET_CONTAINER_BloomFilter *bf;
+  struct GNUNET_HashCode *keys;
+  char *fn;
+  unsigned int i;
+
+  GNUNET_log_setup ("perf-bloomfilter", "WARNING", NULL);
+  keys = GNUNET_malloc (NUM_KEYS * sizeof (struct GNUNET_HashCode));
+  for (i = 0; i < NUM_KEYS; i++)
+    GNUNET_CRYPTO_hash (&i, sizeof (i), &keys[i]);
+
+  fn = GNUNET_DISK_mktemp ("perf-bloomfilter");
+  if (NULL == fn)
+  {
+    GNUNET_free (keys);
+    return 1;
+  }
+  bf = GNUNET_CONTAINER_bloomfilter_load (fn, SIZE, K);
+  if (NULL == bf)
+  {
+    GNUNET_free (fn);
+    GNUNET_free (keys);
+    return 1;
+  }
+  measure ("file", bf, keys);
+  GNUNET_CONTAINER_bloomfilter_free (bf);
+  if (0 != UNLINK (fn))
+    GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_WARNING, "unlink", fn);
+  GNUNET_free (fn);
+
+  bf = GNUNET_CONTAINER_bloomfilter_init (NULL, SIZE, K);
+  measure ("memory", bf, keys);
+  GNUNET_CONTAINER_bloomfilter_free (bf);
+  GNUNET_free (keys);
+  return 0;
+}
+
+/* end of perf_bloomfilter.c */
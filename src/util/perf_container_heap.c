@@ -0,0 +1,92 @@
+/*
+     This file is part of GNUnet.
+     (C) 2014 Christian Grothoff (and other contributing authors)
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+     Boston, MA 02111-1307, USA.
+*/
+
+/**
+ * @file util/perf_container_heap.c
+ * @brief measure performance of the heap
+ */
+#include "platform.h"
+#include "gnunet_util_lib.h"
+#include <gauger.h>
+
+/**
+ * Number of elements to put into the heap.
+ */
+#define NUM_ELEMENTS (1000 * 1000)
+
+
+/**
+ * Insert #NUM_ELEMENTS elements with random costs, change the cost
+ * of each of them once and then remove them all via the root.
+ *
+ * @param nodes array to store the nodes in
+ */
+static void
+perfHeap (struct GNUNET_CONTAINER_HeapNode **nodes)
+{
+  struct GNUNET_CONTAINER_Heap *heap;
+  GNUNET_CONTAINER_HeapCostType last;
+  GNUNET_CONTAINER_HeapCostType cost;
+  unsigned int i;
+
+  heap = GNUNET_CONTAINER_heap_create (GNUNET_CONTAINER_HEAP_ORDER_MIN);
+  for (i = 0; i < NUM_ELEMENTS; i++)
+    nodes[i] = GNUNET_CONTAINER_heap_insert (heap, nodes,
+                                             GNUNET_CRYPTO_random_u64 (GNUNET_CRYPTO_QUALITY_WEAK,
+                                                                       UINT64_MAX));
+  for (i = 0; i < NUM_ELEMENTS; i++)
+    GNUNET_CONTAINER_heap_update_cost (heap, nodes[i],
+                                       GNUNET_CRYPTO_random_u64 (GNUNET_CRYPTO_QUALITY_WEAK,
+                                                                 UINT64_MAX));
+  last = 0;
+  for (i = 0; i < NUM_ELEMENTS; i++)
+  {
+    GNUNET_assert (GNUNET_YES ==
+                   GNUNET_CONTAINER_heap_peek2 (heap, NULL, &cost));
+    GNUNET_assert (cost >= last);
+    last = cost;
+    GNUNET_assert (NULL != GNUNET_CONTAINER_heap_remove_root (heap));
+  }
+  GNUNET_CONTAINER_heap_destroy (heap);
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  struct GNUNET_CONTAINER_HeapNode **nodes;
+  struct GNUNET_TIME_Absolute start;
+  struct GNUNET_TIME_Relative duration;
+
+  nodes = GNUNET_malloc (NUM_ELEMENTS * sizeof (struct GNUNET_CONTAINER_HeapNode *));
+  start = GNUNET_TIME_absolute_get ();
+  perfHeap (nodes);
+  duration = GNUNET_TIME_absolute_get_duration (start);
+  GNUNET_free (nodes);
+  printf ("Heap perf took %s\n",
+          GNUNET_STRINGS_relative_time_to_string (duration,
+                                                  GNUNET_YES));
+  GAUGER ("UTIL", "Heap insert/update/remove",
+          3 * NUM_ELEMENTS / (1 + duration.rel_value_us / 1000LL),
+          "ops/ms");
+  return 0;
+}
+
+/* end of perf_container_heap.c */
@@ -0,0 +1,124 @@
+/*
+     This file is part of GNUnet.
+     (C) 2014 Christian Grothoff (and other contributing authors)
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+     Boston, MA 02111-1307, USA.
+*/
+
+/**
+ * @file util/perf_container_multihashmap.c
+ * @brief compare the performance of chained and open addressing
+ *        multi hash maps
+ */
+#include "platform.h"
+#include "gnunet_util_lib.h"
+#include <gauger.h>
+
+/**
+ * Number of entries to put into the map.
+ */
+#define NUM_KEYS (256 * 1024)
+
+
+/**
+ * Prime used to look up the keys in a different order than the one
+ * they were inserted in (so that the benchmark does not benefit from
+ * entries being allocated in insertion order).
+ */
+#define STRIDE 7919
+
+
+/**
+ * Put, look up and remove #NUM_KEYS entries.
+ *
+ * @param m map to use
+ * @param keys keys to use
+ */
+static void
+perfMap (struct GNUNET_CONTAINER_MultiHashMap *m,
+         struct GNUNET_HashCode *keys)
+{
+  unsigned int i;
+  unsigned int j;
+  unsigned int round;
+
+  for (i = 0; i < NUM_KEYS; i++)
+    GNUNET_assert (GNUNET_OK ==
+                   GNUNET_CONTAINER_multihashmap_put (m, &keys[i], &keys[i],
+                                                      GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_FAST));
+  for (round = 0; round < 4; round++)
+    for (i = 0; i < NUM_KEYS; i++)
+    {
+      j = (i * STRIDE) % NUM_KEYS;
+      GNUNET_assert (&keys[j] ==
+                     GNUNET_CONTAINER_multihashmap_get (m, &keys[j]));
+    }
+  for (i = 0; i < NUM_KEYS; i++)
+    GNUNET_assert (GNUNET_YES ==
+                   GNUNET_CONTAINER_multihashmap_remove (m, &keys[i], &keys[i]));
+  GNUNET_assert (0 == GNUNET_CONTAINER_multihashmap_size (m));
+}
+
+
+/**
+ * Run the benchmark on a map and report the result.
+ *
+ * @param name name of the map type
+ * @param m map to use (destroyed)
+ * @param keys keys to use
+ */
+static void
+measure (const char *name,
+         struct GNUNET_CONTAINER_MultiHashMap *m,
+         struct GNUNET_HashCode *keys)
+{
+  struct GNUNET_TIME_Absolute start;
+  struct GNUNET_TIME_Relative duration;
+
+  start = GNUNET_TIME_absolute_get ();
+  perfMap (m, keys);
+  duration = GNUNET_TIME_absolute_get_duration (start);
+  GNUNET_CONTAINER_multihashmap_destroy (m);
+  printf ("%s multihashmap took %s\n",
+          name,
+          GNUNET_STRINGS_relative_time_to_string (duration,
+                                                  GNUNET_YES));
+  GAUGER ("UTIL", name,
+          6 * NUM_KEYS / (1 + duration.rel_value_us / 1000LL),
+          "ops/ms");
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  struct GNUNET_HashCode *keys;
+  unsigned int i;
+
+  keys = GNUNET_malloc (NUM_KEYS * sizeof (struct GNUNET_HashCode));
+  for (i = 0; i < NUM_KEYS; i++)
+    GNUNET_CRYPTO_hash (&i, sizeof (i), &keys[i]);
+  measure ("Chained",
+           GNUNET_CONTAINER_multihashmap_create (16, GNUNET_NO),
+           keys);
+  measure ("Open addressing",
+           GNUNET_CONTAINER_multihashmap_create_flat (16),
+           keys);
+  GNUNET_free (keys);
+  return 0;
+}
+
+/* end of perf_container_multihashmap.c */
@@ -28,48 +28,86 @@
 #include <gauger.h>
 
 
+/**
+ * Total number of bytes to process per benchmark.
+ */
+#define TOTAL_BYTES (16 * 1024 * 1024)
+
+
+/**
+ * Encrypt and decrypt #TOTAL_BYTES in blocks of @a size bytes, either
+ * setting up the ciphers for each block or using a cached context.
+ *
+ * @param size block size to use
+ * @param cached #GNUNET_YES to use a #GNUNET_CRYPTO_SymmetricContext
+ */
 static void
-perfEncrypt ()
+perfEncrypt (size_t size,
+             int cached)
 {
   unsigned int i;
-  char buf[64 * 1024];
-  char rbuf[64 * 1024];
+  unsigned int rounds;
+  char buf[size];
+  char rbuf[size];
+  char name[64];
   struct GNUNET_CRYPTO_SymmetricSessionKey sk;
   struct GNUNET_CRYPTO_SymmetricInitializationVector iv;
+  struct GNUNET_CRYPTO_SymmetricContext *ctx;
+  struct GNUNET_TIME_Absolute start;
+  struct GNUNET_TIME_Relative duration;
 
   GNUNET_CRYPTO_symmetric_create_session_key (&sk);
-
+  ctx = GNUNET_CRYPTO_symmetric_context_create (&sk);
   memset (buf, 1, sizeof (buf));
-  for (i = 0; i < 1024; i++)
+  rounds = TOTAL_BYTES / size;
+  start = GNUNET_TIME_absolute_get ();
+  for (i = 0; i < rounds; i++)
   {
     memset (&iv, (int8_t) i, sizeof (iv));
-    GNUNET_CRYPTO_symmetric_encrypt (buf, sizeof (buf),
-                               &sk, &iv,
-                               rbuf);
-    GNUNET_CRYPTO_symmetric_decrypt (rbuf, sizeof (buf),
-                               &sk, &iv,
-                               buf);
+    if (GNUNET_YES == cached)
+    {
+      GNUNET_CRYPTO_symmetric_context_encrypt (ctx, buf, size, &iv, rbuf);
+      GNUNET_CRYPTO_symmetric_context_decrypt (ctx, rbuf, size, &iv, buf);
+    }
+    else
+    {
+      GNUNET_CRYPTO_symmetric_encrypt (buf, size, &sk, &iv, rbuf);
+      GNUNET_CRYPTO_symmetric_decrypt (rbuf, size, &sk, &iv, buf);
+    }
   }
+  duration = GNUNET_TIME_absolute_get_duration (start);
+  GNUNET_CRYPTO_symmetric_context_destroy (ctx);
   memset (rbuf, 1, sizeof (rbuf));
   GNUNET_assert (0 == memcmp (rbuf, buf, sizeof (buf)));
+  /* each byte is encrypted and decrypted once */
+  printf ("%s, %5u byte blocks: %s (%llu MB/s)\n",
+          (GNUNET_YES == cached) ? "cached context" : "per-call setup",
+          (unsigned int) size,
+          GNUNET_STRINGS_relative_time_to_string (duration, GNUNET_YES),
+          (unsigned long long) (2LL * TOTAL_BYTES /
+                                (1 + duration.rel_value_us)));
+  GNUNET_snprintf (name, sizeof (name),
+                   "Symmetric encryption %u byte blocks%s",
+                   (unsigned int) size,
+                   (GNUNET_YES == cached) ? " (cached)" : "");
+  GAUGER ("UTIL", name,
+          2LL * TOTAL_BYTES / (1 + duration.rel_value_us),
+          "MB/s");
 }
 
 
 int
 main (int argc, char *argv[])
 {
-  struct GNUNET_TIME_Absolute start;
+  static const size_t sizes[] = { 64, 1024, 32 * 1024, 64 * 1024 };
+  unsigned int i;
 
-  start = GNUNET_TIME_absolute_get ();
-  perfEncrypt ();
-  printf ("Encrypt perf took %s\n",
-          GNUNET_STRINGS_relative_time_to_string (GNUNET_TIME_absolute_get_duration (start),
-						  GNUNET_YES));
-  GAUGER ("UTIL", "Symmetric encryption",
-          64 * 1024 / (1 +
-		       GNUNET_TIME_absolute_get_duration
-		       (start).rel_value_us / 1000LL), "kb/ms");
+  for (i = 0; i < sizeof (sizes) / sizeof (sizes[0]); i++)
+  {
+    perfEncrypt (sizes[i], GNUNET_NO);
+    perfEncrypt (sizes[i], GNUNET_YES);
+  }
   return 0;
 }
 
-/* end of perf_crypto_aes.c */
+/* end of perf_crypto_symmetric.c */
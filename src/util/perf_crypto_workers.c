@@ -0,0 +1,127 @@
+/*
+     This file is part of GNUnet.
+     (C) 2014 Christian Grothoff (and other contributing authors)
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+     Boston, MA 02111-1307, USA.
+*/
+
+/**
+ * @file util/perf_crypto_workers.c
+ * @brief measure how many signatures per second we verify,
+ *        synchronously and with a worker pool
+ */
+#include "platform.h"
+#include "gnunet_util_lib.h"
+#include "gnunet_signatures.h"
+#include <gauger.h>
+
+#define NUM_SIGS 1024
+
+
+static struct GNUNET_CRYPTO_EddsaPublicKey pkey;
+
+static struct GNUNET_CRYPTO_EccSignaturePurpose purpose;
+
+static struct GNUNET_CRYPTO_EddsaSignature sig;
+
+static struct GNUNET_CRYPTO_WorkerPool *pool;
+
+static struct GNUNET_TIME_Absolute start;
+
+static unsigned int remaining;
+
+static int ok;
+
+
+static int
+verify_sig (void *cls)
+{
+  return GNUNET_CRYPTO_eddsa_verify (GNUNET_SIGNATURE_PURPOSE_TEST,
+                                     &purpose, &sig, &pkey);
+}
+
+
+/**
+ * Print the rate of verifications since #start.
+ *
+ * @param what what kind of verification was measured
+ */
+static void
+report (const char *what)
+{
+  struct GNUNET_TIME_Relative duration;
+  unsigned long long rate;
+
+  duration = GNUNET_TIME_absolute_get_duration (start);
+  rate = NUM_SIGS * 1000LL * 1000LL / (1 + duration.rel_value_us);
+  printf ("%s: %llu verifications/s\n", what, rate);
+  GAUGER ("UTIL", what, rate, "verifications/s");
+}
+
+
+static void
+verified (void *cls,
+          int result)
+{
+  if (GNUNET_OK != result)
+    ok = 1;
+  if (0 != --remaining)
+    return;
+  report ("EdDSA verification (worker pool)");
+  GNUNET_CRYPTO_worker_pool_destroy (pool);
+  pool = NULL;
+}
+
+
+static void
+run (void *cls,
+     const struct GNUNET_SCHEDULER_TaskContext *tc)
+{
+  unsigned int i;
+
+  pool = GNUNET_CRYPTO_worker_pool_create (0);
+  remaining = NUM_SIGS;
+  start = GNUNET_TIME_absolute_get ();
+  for (i = 0; i < NUM_SIGS; i++)
+    GNUNET_CRYPTO_worker_pool_submit (pool,
+                                      &verify_sig, NULL,
+                                      &verified, NULL);
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  struct GNUNET_CRYPTO_EddsaPrivateKey *key;
+  unsigned int i;
+
+  GNUNET_log_setup ("perf-crypto-workers", "WARNING", NULL);
+  key = GNUNET_CRYPTO_eddsa_key_create ();
+  GNUNET_CRYPTO_eddsa_key_get_public (key, &pkey);
+  purpose.purpose = htonl (GNUNET_SIGNATURE_PURPOSE_TEST);
+  purpose.size = htonl (sizeof (purpose));
+  GNUNET_assert (GNUNET_OK == GNUNET_CRYPTO_eddsa_sign (key, &purpose, &sig));
+  GNUNET_free (key);
+  start = GNUNET_TIME_absolute_get ();
+  for (i = 0; i < NUM_SIGS; i++)
+    if (GNUNET_OK != verify_sig (NULL))
+      ok = 1;
+  report ("EdDSA verification (synchronous)");
+  GNUNET_SCHEDULER_run (&run, NULL);
+  return ok;
+}
+
+/* end of perf_crypto_workers.c */
@@ -0,0 +1,255 @@
+/*
+     This file is part of GNUnet.
+     (C) 2014 Christian Grothoff (and other contributing authors)
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+     Boston, MA 02111-1307, USA.
+*/
+
+/**
+ * @file util/perf_mq_client.c
+ * @brief measure how many small messages per second a message queue
+ *        moves between a client and a server over loopback
+ */
+#include "platform.h"
+#include "gnunet_util_lib.h"
+#include <gauger.h>
+
+#define PORT 23337
+
+/**
+ * Type of the messages the client sends to the server.
+ */
+#define MY_TYPE 128
+
+/**
+ * Type of the messages the server sends to the client.
+ */
+#define MY_TYPE2 129
+
+/**
+ * Number of messages to send in each direction.
+ */
+#define NUM_MSGS (64 * 1024)
+
+/**
+ * Size of each message (including the header).
+ */
+#define MSG_SIZE 64
+
+
+static struct GNUNET_SERVER_Handle *server;
+
+static struct GNUNET_CLIENT_Connection *client;
+
+static struct GNUNET_CONFIGURATION_Handle *cfg;
+
+static struct GNUNET_MQ_Handle *client_mq;
+
+static struct GNUNET_MQ_Handle *server_mq;
+
+static struct GNUNET_TIME_Absolute start;
+
+static unsigned int received;
+
+static int ok;
+
+
+/**
+ * Print the rate of messages since #start.
+ *
+ * @param what which direction was measured
+ */
+static void
+report (const char *what)
+{
+  struct GNUNET_TIME_Relative duration;
+  unsigned long long rate;
+
+  duration = GNUNET_TIME_absolute_get_duration (start);
+  rate = NUM_MSGS * 1000LL * 1000LL / (1 + duration.rel_value_us);
+  printf ("%s: %llu messages/s\n", what, rate);
+  GAUGER ("UTIL", what, rate, "messages/s");
+}
+
+
+/**
+ * Tear everything down.
+ *
+ * @param cls NULL
+ * @param tc scheduler context
+ */
+static void
+clean_up (void *cls,
+          const struct GNUNET_SCHEDULER_TaskContext *tc)
+{
+  GNUNET_MQ_destroy (client_mq);
+  client_mq = NULL;
+  GNUNET_MQ_destroy (server_mq);
+  server_mq = NULL;
+  GNUNET_CLIENT_disconnect (client);
+  client = NULL;
+  GNUNET_SERVER_destroy (server);
+  server = NULL;
+  GNUNET_CONFIGURATION_destroy (cfg);
+  cfg = NULL;
+}
+
+
+/**
+ * The client got a message from the server.
+ *
+ * @param cls NULL
+ * @param msg the message, NULL on error
+ */
+static void
+client_recv_cb (void *cls,
+                const struct GNUNET_MessageHeader *msg)
+{
+  if ( (NULL == msg) ||
+       (MY_TYPE2 != ntohs (msg->type)) )
+  {
+    GNUNET_break (0);
+    GNUNET_SCHEDULER_add_now (&clean_up, NULL);
+    return;
+  }
+  if (NUM_MSGS == ++received)
+  {
+    report ("MQ server to client");
+    ok = 0;
+    GNUNET_SCHEDULER_add_now (&clean_up, NULL);
+    return;
+  }
+  GNUNET_CLIENT_receive (client, &client_recv_cb, NULL,
+                         GNUNET_TIME_UNIT_FOREVER_REL);
+}
+
+
+/**
+ * Flood the client with messages.
+ *
+ * @param sc client to send to
+ */
+static void
+server_flood (struct GNUNET_SERVER_Client *sc)
+{
+  struct GNUNET_MQ_Envelope *env;
+  struct GNUNET_MessageHeader *msg;
+  unsigned int i;
+
+  received = 0;
+  GNUNET_CLIENT_receive (client, &client_recv_cb, NULL,
+                         GNUNET_TIME_UNIT_FOREVER_REL);
+  server_mq = GNUNET_MQ_queue_for_server_client (sc);
+  start = GNUNET_TIME_absolute_get ();
+  for (i = 0; i < NUM_MSGS; i++)
+  {
+    env = GNUNET_MQ_msg_extra (msg,
+                               MSG_SIZE - sizeof (struct GNUNET_MessageHeader),
+                               MY_TYPE2);
+    GNUNET_MQ_send (server_mq, env);
+  }
+}
+
+
+/**
+ * The server got a message from the client.
+ *
+ * @param cls NULL
+ * @param sc client that sent the message
+ * @param message the message
+ */
+static void
+server_recv_cb (void *cls,
+                struct GNUNET_SERVER_Client *sc,
+                const struct GNUNET_MessageHeader *message)
+{
+  GNUNET_SERVER_receive_done (sc, GNUNET_OK);
+  if (NUM_MSGS != ++received)
+    return;
+  report ("MQ client to server");
+  server_flood (sc);
+}
+
+
+static struct GNUNET_SERVER_MessageHandler handlers[] = {
+  {&server_recv_cb, NULL, MY_TYPE, MSG_SIZE},
+  {NULL, NULL, 0, 0}
+};
+
+
+/**
+ * Start the server and flood it from the client.
+ *
+ * @param cls NULL
+ * @param tc scheduler context
+ */
+static void
+task (void *cls,
+      const struct GNUNET_SCHEDULER_TaskContext *tc)
+{
+  struct GNUNET_MQ_Envelope *env;
+  struct GNUNET_MessageHeader *msg;
+  struct sockaddr_in sa;
+  struct sockaddr *sap[2];
+  socklen_t slens[2];
+  unsigned int i;
+
+  sap[0] = (struct sockaddr *) &sa;
+  slens[0] = sizeof (sa);
+  sap[1] = NULL;
+  slens[1] = 0;
+  memset (&sa, 0, sizeof (sa));
+#if HAVE_SOCKADDR_IN_SIN_LEN
+  sa.sin_len = sizeof (sa);
+#endif
+  sa.sin_family = AF_INET;
+  sa.sin_port = htons (PORT);
+  server =
+      GNUNET_SERVER_create (NULL, NULL, sap, slens,
+                            GNUNET_TIME_UNIT_FOREVER_REL, GNUNET_NO);
+  GNUNET_assert (NULL != server);
+  GNUNET_SERVER_add_handlers (server, handlers);
+  cfg = GNUNET_CONFIGURATION_create ();
+  GNUNET_CONFIGURATION_set_value_number (cfg, "test", "PORT", PORT);
+  GNUNET_CONFIGURATION_set_value_string (cfg, "test", "HOSTNAME", "localhost");
+  GNUNET_CONFIGURATION_set_value_string (cfg, "resolver", "HOSTNAME",
+                                         "localhost");
+  client = GNUNET_CLIENT_connect ("test", cfg);
+  GNUNET_assert (NULL != client);
+  client_mq = GNUNET_MQ_queue_for_connection_client (client, NULL, NULL, NULL);
+  start = GNUNET_TIME_absolute_get ();
+  for (i = 0; i < NUM_MSGS; i++)
+  {
+    env = GNUNET_MQ_msg_extra (msg,
+                               MSG_SIZE - sizeof (struct GNUNET_MessageHeader),
+                               MY_TYPE);
+    GNUNET_MQ_send (client_mq, env);
+  }
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  GNUNET_log_setup ("perf-mq-client",
+                    "WARNING",
+                    NULL);
+  ok = 1;
+  GNUNET_SCHEDULER_run (&task, NULL);
+  return ok;
+}
+
+/* end of perf_mq_client.c */
@@ -0,0 +1,375 @@
+/*
+     This file is part of GNUnet.
+     (C) 2014 Christian Grothoff (and other contributing authors)
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+     Boston, MA 02111-1307, USA.
+*/
+
+/**
+ * @file util/perf_mq_shm.c
+ * @brief compare throughput and round-trip latency of a client message
+ *        queue to a service over a UNIX domain socket, first with the
+ *        plain socket and then with the shared-memory ring
+ */
+#include "platform.h"
+#include "gnunet_util_lib.h"
+#include <gauger.h>
+
+/**
+ * Type of the messages flooded from the client to the server.
+ */
+#define MY_TYPE 128
+
+/**
+ * Type of the ping the client sends to the server.
+ */
+#define MY_TYPE_PING 129
+
+/**
+ * Type of the pong the server sends back.
+ */
+#define MY_TYPE_PONG 130
+
+/**
+ * Number of messages to flood.
+ */
+#define NUM_MSGS (64 * 1024)
+
+/**
+ * Number of ping-pong round trips.
+ */
+#define NUM_PINGS (8 * 1024)
+
+
+GNUNET_NETWORK_STRUCT_BEGIN
+
+/**
+ * Message flooded from the client to the server.
+ */
+struct FloodMessage
+{
+  /**
+   * Type is #MY_TYPE.
+   */
+  struct GNUNET_MessageHeader header;
+
+  /**
+   * Sequence number, to check that the order is kept.
+   */
+  uint32_t seq GNUNET_PACKED;
+
+  /**
+   * Make the message 64 bytes in total.
+   */
+  char pad[56];
+};
+
+GNUNET_NETWORK_STRUCT_END
+
+
+static const char *unixpath = "/tmp/perf-mq-shm.sock";
+
+static struct GNUNET_SERVER_Handle *server;
+
+static struct GNUNET_CLIENT_Connection *client;
+
+static struct GNUNET_CONFIGURATION_Handle *cfg;
+
+static struct GNUNET_MQ_Handle *client_mq;
+
+static struct GNUNET_MQ_Handle *server_mq;
+
+static struct GNUNET_TIME_Absolute start;
+
+/**
+ * #GNUNET_YES while we measure the shared-memory ring.
+ */
+static int use_ring;
+
+static unsigned int received;
+
+static unsigned int pings;
+
+static int ok;
+
+
+/**
+ * Name of the current round, for the report.
+ *
+ * @param what what was measured
+ * @return static string
+ */
+static const char *
+label (const char *what)
+{
+  static char buf[128];
+
+  GNUNET_snprintf (buf, sizeof (buf),
+                   "MQ %s (%s)",
+                   what,
+                   (GNUNET_YES == use_ring) ? "shared-memory ring" : "UNIX socket");
+  return buf;
+}
+
+
+/**
+ * Start a round: connect the client and flood the server.
+ */
+static void
+run_round (void);
+
+
+/**
+ * Tear down the client of this round and start the next one, or
+ * stop the server.
+ *
+ * @param cls NULL
+ * @param tc scheduler context
+ */
+static void
+end_round (void *cls,
+           const struct GNUNET_SCHEDULER_TaskContext *tc)
+{
+  GNUNET_MQ_destroy (client_mq);
+  client_mq = NULL;
+  if (NULL != server_mq)
+  {
+    GNUNET_MQ_destroy (server_mq);
+    server_mq = NULL;
+  }
+  GNUNET_CLIENT_disconnect (client);
+  client = NULL;
+  GNUNET_CONFIGURATION_destroy (cfg);
+  cfg = NULL;
+  if ( (0 == ok) &&
+       (GNUNET_NO == use_ring) )
+  {
+    use_ring = GNUNET_YES;
+    run_round ();
+    return;
+  }
+  GNUNET_SERVER_destroy (server);
+  server = NULL;
+}
+
+
+/**
+ * Send the next ping.
+ */
+static void
+send_ping ()
+{
+  struct GNUNET_MQ_Envelope *env;
+  struct GNUNET_MessageHeader *msg;
+
+  env = GNUNET_MQ_msg (msg, MY_TYPE_PING);
+  GNUNET_MQ_send (client_mq, env);
+}
+
+
+/**
+ * The client got a pong back.
+ *
+ * @param cls NULL
+ * @param msg the pong
+ */
+static void
+client_pong_cb (void *cls,
+                const struct GNUNET_MessageHeader *msg)
+{
+  struct GNUNET_TIME_Relative duration;
+  unsigned long long latency;
+
+  if (NUM_PINGS != ++pings)
+  {
+    send_ping ();
+    return;
+  }
+  duration = GNUNET_TIME_absolute_get_duration (start);
+  latency = duration.rel_value_us / NUM_PINGS;
+  printf ("%s: %llu us per round trip\n",
+          label ("latency"), latency);
+  GAUGER ("UTIL", label ("latency"), latency, "us/round trip");
+  ok = 0;
+  GNUNET_SCHEDULER_add_now (&end_round, NULL);
+}
+
+
+/**
+ * The connection to the server failed.
+ *
+ * @param cls NULL
+ * @param error what went wrong
+ */
+static void
+client_error_cb (void *cls,
+                 enum GNUNET_MQ_Error error)
+{
+  GNUNET_break (0);
+  ok = 1;
+  GNUNET_SCHEDULER_add_now (&end_round, NULL);
+}
+
+
+static const struct GNUNET_MQ_MessageHandler mq_handlers[] = {
+  {&client_pong_cb, MY_TYPE_PONG, sizeof (struct GNUNET_MessageHeader)},
+  GNUNET_MQ_HANDLERS_END
+};
+
+
+/**
+ * The server got a flood message.
+ *
+ * @param cls NULL
+ * @param sc client that sent the message
+ * @param message the message
+ */
+static void
+server_flood_cb (void *cls,
+                 struct GNUNET_SERVER_Client *sc,
+                 const struct GNUNET_MessageHeader *message)
+{
+  const struct FloodMessage *fm = (const struct FloodMessage *) message;
+  struct GNUNET_TIME_Relative duration;
+  unsigned long long rate;
+
+  if (received != ntohl (fm->seq))
+  {
+    GNUNET_break (0);
+    GNUNET_SERVER_receive_done (sc, GNUNET_SYSERR);
+    return;
+  }
+  GNUNET_SERVER_receive_done (sc, GNUNET_OK);
+  if (NUM_MSGS != ++received)
+    return;
+  duration = GNUNET_TIME_absolute_get_duration (start);
+  rate = NUM_MSGS * 1000LL * 1000LL / (1 + duration.rel_value_us);
+  printf ("%s: %llu messages/s\n",
+          label ("throughput"), rate);
+  GAUGER ("UTIL", label ("throughput"), rate, "messages/s");
+  server_mq = GNUNET_MQ_queue_for_server_client (sc);
+  pings = 0;
+  start = GNUNET_TIME_absolute_get ();
+  send_ping ();
+}
+
+
+/**
+ * The server got a ping, answer it.
+ *
+ * @param cls NULL
+ * @param sc client that sent the message
+ * @param message the ping
+ */
+static void
+server_ping_cb (void *cls,
+                struct GNUNET_SERVER_Client *sc,
+                const struct GNUNET_MessageHeader *message)
+{
+  struct GNUNET_MQ_Envelope *env;
+  struct GNUNET_MessageHeader *msg;
+
+  env = GNUNET_MQ_msg (msg, MY_TYPE_PONG);
+  GNUNET_MQ_send (server_mq, env);
+  GNUNET_SERVER_receive_done (sc, GNUNET_OK);
+}
+
+
+static struct GNUNET_SERVER_MessageHandler handlers[] = {
+  {&server_flood_cb, NULL, MY_TYPE, sizeof (struct FloodMessage)},
+  {&server_ping_cb, NULL, MY_TYPE_PING, sizeof (struct GNUNET_MessageHeader)},
+  {NULL, NULL, 0, 0}
+};
+
+
+static void
+run_round ()
+{
+  struct GNUNET_MQ_Envelope *env;
+  struct FloodMessage *fm;
+  unsigned int i;
+
+  ok = 1;
+  cfg = GNUNET_CONFIGURATION_create ();
+  GNUNET_CONFIGURATION_set_value_string (cfg, "test", "UNIXPATH", unixpath);
+  GNUNET_CONFIGURATION_set_value_string (cfg, "test", "SHM_RING",
+                                         (GNUNET_YES == use_ring) ? "YES" : "NO");
+  GNUNET_CONFIGURATION_set_value_string (cfg, "resolver", "HOSTNAME",
+                                         "localhost");
+  client = GNUNET_CLIENT_connect ("test", cfg);
+  GNUNET_assert (NULL != client);
+  client_mq = GNUNET_MQ_queue_for_connection_client (client, mq_handlers,
+                                                     &client_error_cb, NULL);
+  received = 0;
+  start = GNUNET_TIME_absolute_get ();
+  for (i = 0; i < NUM_MSGS; i++)
+  {
+    env = GNUNET_MQ_msg (fm, MY_TYPE);
+    fm->seq = htonl (i);
+    GNUNET_MQ_send (client_mq, env);
+  }
+}
+
+
+/**
+ * Start the server on a UNIX domain socket and run the first round.
+ *
+ * @param cls NULL
+ * @param tc scheduler context
+ */
+static void
+task (void *cls,
+      const struct GNUNET_SCHEDULER_TaskContext *tc)
+{
+  struct sockaddr_un un;
+  struct sockaddr *sap[2];
+  socklen_t slens[2];
+
+  memset (&un, 0, sizeof (un));
+  un.sun_family = AF_UNIX;
+  strncpy (un.sun_path, unixpath, sizeof (un.sun_path) - 1);
+#if HAVE_SOCKADDR_IN_SIN_LEN
+  un.sun_len = (u_char) sizeof (un);
+#endif
+  sap[0] = (struct sockaddr *) &un;
+  slens[0] = sizeof (un);
+  sap[1] = NULL;
+  slens[1] = 0;
+  server =
+      GNUNET_SERVER_create (NULL, NULL, sap, slens,
+                            GNUNET_TIME_UNIT_FOREVER_REL, GNUNET_NO);
+  GNUNET_assert (NULL != server);
+  GNUNET_SERVER_add_handlers (server, handlers);
+  GNUNET_SERVER_enable_shm_ring (server, GNUNET_YES);
+  use_ring = GNUNET_NO;
+  run_round ();
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  GNUNET_log_setup ("perf-mq-shm",
+                    "WARNING",
+                    NULL);
+  (void) UNLINK (unixpath);
+  ok = 1;
+  GNUNET_SCHEDULER_run (&task, NULL);
+  (void) UNLINK (unixpath);
+  return ok;
+}
+
+/* end of perf_mq_shm.c */
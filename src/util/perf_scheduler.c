@@ -0,0 +1,209 @@
+/*
+     This file is part of GNUnet.
+     (C) 2014 Christian Grothoff (and other contributing authors)
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+     Boston, MA 02111-1307, USA.
+*/
+
+/**
+ * @file util/perf_scheduler.c
+ * @brief measure how many tasks per second the scheduler can run
+ */
+#include "platform.h"
+#include "gnunet_util_lib.h"
+#include <gauger.h>
+
+/**
+ * Total number of tasks to run per benchmark.
+ */
+#define TOTAL_TASKS (1024 * 1024)
+
+/**
+ * Number of task chains we run in parallel.
+ */
+#define CHAINS 256
+
+/**
+ * Number of tasks run so far in the current benchmark.
+ */
+static unsigned int tasks;
+
+/**
+ * Socket that always has data available for reading.
+ */
+static struct GNUNET_NETWORK_Handle *sock;
+
+
+static void
+now_task (void *cls,
+          const struct GNUNET_SCHEDULER_TaskContext *tc)
+{
+  if (++tasks >= TOTAL_TASKS)
+    return;
+  GNUNET_SCHEDULER_add_now (&now_task, NULL);
+}
+
+
+static void
+run_now (void *cls,
+         const struct GNUNET_SCHEDULER_TaskContext *tc)
+{
+  unsigned int i;
+
+  for (i = 0; i < CHAINS; i++)
+    GNUNET_SCHEDULER_add_now (&now_task, NULL);
+}
+
+
+static void
+delayed_task (void *cls,
+              const struct GNUNET_SCHEDULER_TaskContext *tc)
+{
+  if (++tasks >= TOTAL_TASKS)
+    return;
+  GNUNET_SCHEDULER_add_delayed (GNUNET_TIME_UNIT_MICROSECONDS,
+                                &delayed_task, NULL);
+}
+
+
+static void
+run_delayed (void *cls,
+             const struct GNUNET_SCHEDULER_TaskContext *tc)
+{
+  unsigned int i;
+
+  for (i = 0; i < CHAINS; i++)
+    GNUNET_SCHEDULER_add_delayed (GNUNET_TIME_relative_multiply
+                                  (GNUNET_TIME_UNIT_MICROSECONDS, i),
+                                  &delayed_task, NULL);
+}
+
+
+static void
+read_task (void *cls,
+           const struct GNUNET_SCHEDULER_TaskContext *tc)
+{
+  GNUNET_assert (GNUNET_NETWORK_fdset_isset (tc->read_ready, sock));
+  if (++tasks >= TOTAL_TASKS)
+    return;
+  GNUNET_SCHEDULER_add_read_net (GNUNET_TIME_UNIT_FOREVER_REL,
+                                 sock,
+                                 &read_task, NULL);
+}
+
+
+static void
+run_read (void *cls,
+          const struct GNUNET_SCHEDULER_TaskContext *tc)
+{
+  unsigned int i;
+
+  for (i = 0; i < CHAINS; i++)
+    GNUNET_SCHEDULER_add_read_net (GNUNET_TIME_UNIT_FOREVER_REL,
+                                   sock,
+                                   &read_task, NULL);
+}
+
+
+/**
+ * Create a UDP socket bound to the loopback interface that has
+ * a datagram queued to itself, so that it is always readable.
+ *
+ * @return #GNUNET_OK on success
+ */
+static int
+setup_socket ()
+{
+  struct sockaddr_in sa;
+  socklen_t slen;
+  char c;
+
+  sock = GNUNET_NETWORK_socket_create (AF_INET, SOCK_DGRAM, 0);
+  if (NULL == sock)
+    return GNUNET_SYSERR;
+  memset (&sa, 0, sizeof (sa));
+  sa.sin_family = AF_INET;
+#if HAVE_SOCKADDR_IN_SIN_LEN
+  sa.sin_len = sizeof (sa);
+#endif
+  sa.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+  slen = sizeof (sa);
+  c = 'x';
+  if ( (GNUNET_OK !=
+        GNUNET_NETWORK_socket_bind (sock,
+                                    (const struct sockaddr *) &sa,
+                                    sizeof (sa))) ||
+       (0 != getsockname (GNUNET_NETWORK_get_fd (sock),
+                          (struct sockaddr *) &sa,
+                          &slen)) ||
+       (sizeof (c) !=
+        GNUNET_NETWORK_socket_sendto (sock, &c, sizeof (c),
+                                      (const struct sockaddr *) &sa,
+                                      slen)) )
+  {
+    GNUNET_break (GNUNET_OK == GNUNET_NETWORK_socket_close (sock));
+    sock = NULL;
+    return GNUNET_SYSERR;
+  }
+  return GNUNET_OK;
+}
+
+
+/**
+ * Run a benchmark and report the result.
+ *
+ * @param name name of the benchmark
+ * @param main_task task that starts the benchmark
+ */
+static void
+measure (const char *name,
+         GNUNET_SCHEDULER_Task main_task)
+{
+  struct GNUNET_TIME_Absolute start;
+  struct GNUNET_TIME_Relative duration;
+
+  tasks = 0;
+  start = GNUNET_TIME_absolute_get ();
+  GNUNET_SCHEDULER_run (main_task, NULL);
+  duration = GNUNET_TIME_absolute_get_duration (start);
+  printf ("%s: %u tasks took %s\n",
+          name,
+          tasks,
+          GNUNET_STRINGS_relative_time_to_string (duration,
+                                                  GNUNET_YES));
+  GAUGER ("UTIL", name,
+          tasks / (1 + duration.rel_value_us / 1000LL),
+          "tasks/ms");
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  GNUNET_log_setup ("perf-scheduler", "WARNING", NULL);
+  measure ("Scheduler add_now", &run_now);
+  measure ("Scheduler add_delayed", &run_delayed);
+  if (GNUNET_OK != setup_socket ())
+  {
+    fprintf (stderr, "Failed to create UDP socket, skipping read test\n");
+    return 0;
+  }
+  measure ("Scheduler add_read_net", &run_read);
+  GNUNET_break (GNUNET_OK == GNUNET_NETWORK_socket_close (sock));
+  return 0;
+}
+
+/* end of perf_scheduler.c */
@@ -283,6 +283,7 @@ GNUNET_PROGRAM_run2 (int argc, char *const *argv, const char *binaryName,
   cc.args = &argv[ret];
   if (GNUNET_NO == run_without_scheduler)
   {
+    (void) GNUNET_SCHEDULER_configure (cc.cfg);
     GNUNET_SCHEDULER_run (&program_main, &cc);
   }
   else
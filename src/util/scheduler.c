@@ -31,6 +31,22 @@
 
 #define LOG_STRERROR(kind,syscall) GNUNET_log_from_strerror (kind, "util-scheduler", syscall)
 
+#if HAVE_SYS_EPOLL_H && HAVE_EPOLL_CREATE1
+#include <sys/epoll.h>
+
+/**
+ * Is the epoll() backend available on this system?
+ */
+#define EPOLL_SUPPORTED GNUNET_YES
+
+/**
+ * Maximum number of events we fetch from epoll() per iteration.
+ */
+#define EPOLL_MAX_EVENTS 256
+#else
+#define EPOLL_SUPPORTED GNUNET_NO
+#endif
+
 
 #if HAVE_EXECINFO_H
 #include "execinfo.h"
@@ -63,6 +79,22 @@
  */
 #define PROFILE_DELAYS GNUNET_NO
 
+/**
+ * Number of tasks we allocate at once when the free list is empty.
+ */
+#define TASK_SLAB_SIZE 64
+
+/**
+ * Number of unused tasks we keep around at least; slabs that
+ * become entirely unused are only released above this mark.
+ */
+#define TASK_FREE_LOW_WATER (4 * TASK_SLAB_SIZE)
+
+/**
+ * Maximum number of unused FD sets we keep around for re-use.
+ */
+#define MAX_FREE_FDSETS 32
+
 /**
  * Task that were in the queue for longer than this are reported if
  * PROFILE_DELAYS is active.
@@ -80,6 +112,54 @@ struct Task
    */
   struct Task *next;
 
+  /**
+   * This is a linked list.
+   */
+  struct Task *prev;
+
+  /**
+   * Head of the list (pending or ready queue) this task is in.
+   */
+  struct Task **queue_head;
+
+  /**
+   * Tail of the list (pending or ready queue) this task is in.
+   */
+  struct Task **queue_tail;
+
+  /**
+   * Slab this task was allocated from.
+   */
+  struct TaskSlab *slab;
+
+  /**
+   * Entry of this task in the #timeout_heap, NULL once the
+   * task is ready.
+   */
+  struct GNUNET_CONTAINER_HeapNode *timeout_node;
+
+#if EPOLL_SUPPORTED
+  /**
+   * Next task waiting for @e read_fd to become readable (epoll only).
+   */
+  struct Task *next_rd;
+
+  /**
+   * Previous task waiting for @e read_fd to become readable (epoll only).
+   */
+  struct Task *prev_rd;
+
+  /**
+   * Next task waiting for @e write_fd to become writable (epoll only).
+   */
+  struct Task *next_wr;
+
+  /**
+   * Previous task waiting for @e write_fd to become writable (epoll only).
+   */
+  struct Task *prev_wr;
+#endif
+
   /**
    * Function to run when ready.
    */
@@ -169,24 +249,153 @@ struct Task
 
 
 /**
- * List of tasks waiting for an event.
+ * A block of tasks allocated together.
+ */
+struct TaskSlab
+{
+  /**
+   * This is a DLL.
+   */
+  struct TaskSlab *next;
+
+  /**
+   * This is a DLL.
+   */
+  struct TaskSlab *prev;
+
+  /**
+   * Unused tasks of this slab, linked via their 'next' field.
+   */
+  struct Task *free_tasks;
+
+  /**
+   * Number of tasks in @e free_tasks.
+   */
+  unsigned int num_free;
+
+  /**
+   * The tasks of this slab.
+   */
+  struct Task tasks[TASK_SLAB_SIZE];
+};
+
+
+#if EPOLL_SUPPORTED
+/**
+ * Information we keep per file descriptor when using epoll().
  */
-static struct Task *pending;
+struct FdInfo
+{
+  /**
+   * Head of list of tasks waiting for this FD to become readable.
+   */
+  struct Task *readers_head;
+
+  /**
+   * Tail of list of tasks waiting for this FD to become readable.
+   */
+  struct Task *readers_tail;
+
+  /**
+   * Head of list of tasks waiting for this FD to become writable.
+   */
+  struct Task *writers_head;
+
+  /**
+   * Tail of list of tasks waiting for this FD to become writable.
+   */
+  struct Task *writers_tail;
+
+  /**
+   * Number of tasks (including those using FD sets) interested
+   * in reading from this FD.
+   */
+  unsigned int num_readers;
+
+  /**
+   * Number of tasks (including those using FD sets) interested
+   * in writing to this FD.
+   */
+  unsigned int num_writers;
+
+  /**
+   * Events we have currently registered with the kernel.
+   */
+  uint32_t registered;
+
+  /**
+   * Set to #GNUNET_YES if the interest set changed since the
+   * last call to epoll_wait().
+   */
+  int dirty;
+
+  /**
+   * Set to #GNUNET_YES if the kernel registration must be refreshed,
+   * either because it fired (we use EPOLLONESHOT) or because the FD
+   * had no interested task at some point and may have been closed
+   * (and re-used) in the meantime.
+   */
+  int rearm;
+
+  /**
+   * Set to #GNUNET_YES if the FD cannot be used with epoll()
+   * (i.e. a regular file); such FDs are always considered ready.
+   */
+  int unpollable;
+};
+#endif
+
+
+/**
+ * Head of list of tasks waiting for an event on a single file
+ * descriptor (or added via #GNUNET_SCHEDULER_add_select() without
+ * any file descriptors).
+ */
+static struct Task *pending_head;
 
 /**
- * List of tasks waiting ONLY for a timeout event.
- * Sorted by timeout (earliest first).  Used so that
- * we do not traverse the list of these tasks when
- * building select sets (we just look at the head
- * to determine the respective timeout ONCE).
+ * Tail of list of tasks waiting for an event on a single file
+ * descriptor.
  */
-static struct Task *pending_timeout;
+static struct Task *pending_tail;
 
 /**
- * Last inserted task waiting ONLY for a timeout event.
- * Used to (heuristically) speed up insertion.
+ * Head of list of tasks waiting for an event on a set of
+ * file descriptors.
  */
-static struct Task *pending_timeout_last;
+static struct Task *pending_sets_head;
+
+/**
+ * Tail of list of tasks waiting for an event on a set of
+ * file descriptors.
+ */
+static struct Task *pending_sets_tail;
+
+/**
+ * Head of list of tasks waiting ONLY for a timeout event.  The list
+ * itself is unsorted, the timeouts are tracked in #timeout_heap.
+ * Used so that we do not traverse these tasks when building select
+ * sets.
+ */
+static struct Task *pending_timeout_head;
+
+/**
+ * Tail of list of tasks waiting ONLY for a timeout event.
+ */
+static struct Task *pending_timeout_tail;
+
+/**
+ * Heap with all tasks that are not yet ready, sorted by timeout
+ * (earliest first).  Tasks marked for shutdown are moved to the
+ * front (cost zero).
+ */
+static struct GNUNET_CONTAINER_Heap *timeout_heap;
+
+/**
+ * Map from (the lower 32 bits of) the task identifier to all
+ * tasks that have not yet run, used to cancel tasks.
+ */
+static struct GNUNET_CONTAINER_MultiHashMap32 *task_map;
 
 /**
  * ID of the task that is running right now.
@@ -194,10 +403,140 @@ static struct Task *pending_timeout_last;
 static struct Task *active_task;
 
 /**
- * List of tasks ready to run right now,
+ * Heads of lists of tasks ready to run right now,
  * grouped by importance.
  */
-static struct Task *ready[GNUNET_SCHEDULER_PRIORITY_COUNT];
+static struct Task *ready_head[GNUNET_SCHEDULER_PRIORITY_COUNT];
+
+/**
+ * Tails of lists of tasks ready to run right now,
+ * grouped by importance.
+ */
+static struct Task *ready_tail[GNUNET_SCHEDULER_PRIORITY_COUNT];
+
+/**
+ * Number of pending (not yet ready) tasks that count towards
+ * the lifeness of the process.
+ */
+static unsigned int pending_lifeness;
+
+/**
+ * Head of the slabs that have unused tasks.  Tasks are never
+ * returned to the allocator individually; a slab is released once
+ * all of its tasks are unused and we have more than
+ * #TASK_FREE_LOW_WATER unused tasks, and all slabs are released at
+ * the end of #GNUNET_SCHEDULER_run().
+ */
+static struct TaskSlab *avail_slabs_head;
+
+/**
+ * Tail of the slabs that have unused tasks.
+ */
+static struct TaskSlab *avail_slabs_tail;
+
+/**
+ * Head of the slabs all of whose tasks are in use.
+ */
+static struct TaskSlab *full_slabs_head;
+
+/**
+ * Tail of the slabs all of whose tasks are in use.
+ */
+static struct TaskSlab *full_slabs_tail;
+
+/**
+ * Total number of unused tasks in all slabs.
+ */
+static unsigned int num_free_tasks;
+
+/**
+ * Unused FD sets available for re-use.
+ */
+static struct GNUNET_NETWORK_FDSet *free_fdsets[MAX_FREE_FDSETS];
+
+/**
+ * Number of entries used in #free_fdsets.
+ */
+static unsigned int free_fdsets_count;
+
+/**
+ * How many tasks were taken from the free list (without allocating
+ * a new slab)?
+ */
+static unsigned long long task_pool_hits;
+
+/**
+ * How many slabs of tasks did we have to allocate?
+ */
+static unsigned long long task_pool_misses;
+
+/**
+ * How many slabs of tasks did we release while running?
+ */
+static unsigned long long task_pool_releases;
+
+/**
+ * How many FD sets were re-used from #free_fdsets?
+ */
+static unsigned long long fdset_pool_hits;
+
+/**
+ * How many FD sets did we have to allocate?
+ */
+static unsigned long long fdset_pool_misses;
+
+#if EPOLL_SUPPORTED
+/**
+ * Should the next call to #GNUNET_SCHEDULER_run() use epoll()?
+ */
+static int use_epoll;
+
+/**
+ * epoll() handle of the running scheduler, -1 if we use select().
+ */
+static int epoll_fd = -1;
+
+/**
+ * Per-FD state for epoll(), indexed by the FD.
+ */
+static struct FdInfo *fd_infos;
+
+/**
+ * Length of the #fd_infos array.
+ */
+static unsigned int fd_infos_size;
+
+/**
+ * FDs whose interest set changed since the last epoll_wait().
+ */
+static int *dirty_fds;
+
+/**
+ * Number of entries used in #dirty_fds.
+ */
+static unsigned int dirty_fds_count;
+
+/**
+ * Allocated length of #dirty_fds.
+ */
+static unsigned int dirty_fds_size;
+
+/**
+ * FDs that cannot be used with epoll() and that some task is
+ * currently interested in.
+ */
+static int *unpollable_fds;
+
+/**
+ * Number of entries used in #unpollable_fds.
+ */
+static unsigned int unpollable_fds_count;
+
+/**
+ * Allocated length of #unpollable_fds.
+ */
+static unsigned int unpollable_fds_size;
+#endif
 
 /**
  * Identity of the last task queued.  Incremented for each task to
@@ -260,6 +599,42 @@ GNUNET_SCHEDULER_set_select (GNUNET_SCHEDULER_select new_select,
 }
 
 
+/**
+ * Configure the scheduler based on the given configuration.  The
+ * "BACKEND" option in section "[scheduler]" selects the event
+ * notification mechanism ("select" or "epoll") used by the next call
+ * to #GNUNET_SCHEDULER_run().  The epoll backend is only used if no
+ * custom select function was set with #GNUNET_SCHEDULER_set_select().
+ *
+ * @param cfg configuration to use
+ * @return #GNUNET_OK on success, #GNUNET_NO if the requested
+ *         backend is not available and we fall back to select()
+ */
+int
+GNUNET_SCHEDULER_configure (const struct GNUNET_CONFIGURATION_Handle *cfg)
+{
+  static const char *const backends[] = { "select", "epoll", NULL };
+  const char *backend;
+
+  if (GNUNET_OK !=
+      GNUNET_CONFIGURATION_get_value_choice (cfg, "scheduler", "BACKEND",
+                                             backends, &backend))
+    backend = backends[0];
+#if EPOLL_SUPPORTED
+  use_epoll = (backend == backends[1]) ? GNUNET_YES : GNUNET_NO;
+  return GNUNET_OK;
+#else
+  if (backend == backends[1])
+  {
+    LOG (GNUNET_ERROR_TYPE_WARNING,
+         _("epoll() is not supported on this system, using select()\n"));
+    return GNUNET_NO;
+  }
+  return GNUNET_OK;
+#endif
+}
+
+
 /**
  * Check that the given priority is legal (and return it).
  *
@@ -276,6 +651,378 @@ check_priority (enum GNUNET_SCHEDULER_Priority p)
 }
 
 
+#if EPOLL_SUPPORTED
+/**
+ * Remember that the registration of the given FD with epoll()
+ * needs to be updated before the next call to epoll_wait().
+ *
+ * @param fd the file descriptor
+ */
+static void
+mark_fd_dirty (int fd)
+{
+  if (GNUNET_YES == fd_infos[fd].dirty)
+    return;
+  fd_infos[fd].dirty = GNUNET_YES;
+  if (dirty_fds_count == dirty_fds_size)
+    GNUNET_array_grow (dirty_fds, dirty_fds_size, 2 * dirty_fds_size + 16);
+  dirty_fds[dirty_fds_count++] = fd;
+}
+
+
+/**
+ * Note that a task is interested in the given FD.
+ *
+ * @param fd the file descriptor
+ * @param on_read #GNUNET_YES if the task wants to read
+ * @param on_write #GNUNET_YES if the task wants to write
+ */
+static void
+acquire_fd (int fd, int on_read, int on_write)
+{
+  struct FdInfo *fi;
+
+  GNUNET_assert (fd >= 0);
+  if ((unsigned int) fd >= fd_infos_size)
+    GNUNET_array_grow (fd_infos, fd_infos_size,
+                       GNUNET_MAX ((unsigned int) fd + 1, 2 * fd_infos_size));
+  fi = &fd_infos[fd];
+  if ( (GNUNET_YES == on_read) &&
+       (0 == fi->num_readers++) )
+    mark_fd_dirty (fd);
+  if ( (GNUNET_YES == on_write) &&
+       (0 == fi->num_writers++) )
+    mark_fd_dirty (fd);
+}
+
+
+/**
+ * Note that a task is no longer interested in the given FD.
+ *
+ * @param fd the file descriptor
+ * @param on_read #GNUNET_YES if the task wanted to read
+ * @param on_write #GNUNET_YES if the task wanted to write
+ */
+static void
+release_fd (int fd, int on_read, int on_write)
+{
+  struct FdInfo *fi;
+
+  fi = &fd_infos[fd];
+  if ( (GNUNET_YES == on_read) &&
+       (0 == --fi->num_readers) )
+    mark_fd_dirty (fd);
+  if ( (GNUNET_YES == on_write) &&
+       (0 == --fi->num_writers) )
+    mark_fd_dirty (fd);
+  if ( (0 == fi->num_readers) &&
+       (0 == fi->num_writers) )
+  {
+    /* the FD may be closed (and re-used) before we
+       next look at it, so we must not trust our registration */
+    fi->rearm = GNUNET_YES;
+  }
+}
+
+
+/**
+ * Update the interest counters for all FDs in the given set.
+ *
+ * @param fds set of file descriptors
+ * @param on_read #GNUNET_YES if the task wants to read
+ * @param on_write #GNUNET_YES if the task wants to write
+ * @param acquire #GNUNET_YES to add interest, #GNUNET_NO to drop it
+ */
+static void
+update_fd_set (const struct GNUNET_NETWORK_FDSet *fds,
+               int on_read, int on_write, int acquire)
+{
+  int fd;
+
+  for (fd = 0; fd < fds->nsds; fd++)
+  {
+    if (! FD_ISSET (fd, &fds->sds))
+      continue;
+    if (GNUNET_YES == acquire)
+      acquire_fd (fd, on_read, on_write);
+    else
+      release_fd (fd, on_read, on_write);
+  }
+}
+
+
+/**
+ * Register the FDs of a pending task with epoll().
+ *
+ * @param t task to register
+ */
+static void
+epoll_add_task (struct Task *t)
+{
+  struct FdInfo *fi;
+
+  if (-1 != t->read_fd)
+  {
+    acquire_fd (t->read_fd, GNUNET_YES, GNUNET_NO);
+    fi = &fd_infos[t->read_fd];
+    GNUNET_CONTAINER_MDLL_insert (rd, fi->readers_head, fi->readers_tail, t);
+  }
+  if (-1 != t->write_fd)
+  {
+    acquire_fd (t->write_fd, GNUNET_NO, GNUNET_YES);
+    fi = &fd_infos[t->write_fd];
+    GNUNET_CONTAINER_MDLL_insert (wr, fi->writers_head, fi->writers_tail, t);
+  }
+  if (NULL != t->read_set)
+    update_fd_set (t->read_set, GNUNET_YES, GNUNET_NO, GNUNET_YES);
+  if (NULL != t->write_set)
+    update_fd_set (t->write_set, GNUNET_NO, GNUNET_YES, GNUNET_YES);
+}
+
+
+/**
+ * Remove the FDs of a task that is no longer pending from epoll().
+ *
+ * @param t task to unregister
+ */
+static void
+epoll_remove_task (struct Task *t)
+{
+  struct FdInfo *fi;
+
+  if (-1 != t->read_fd)
+  {
+    fi = &fd_infos[t->read_fd];
+    GNUNET_CONTAINER_MDLL_remove (rd, fi->readers_head, fi->readers_tail, t);
+    release_fd (t->read_fd, GNUNET_YES, GNUNET_NO);
+  }
+  if (-1 != t->write_fd)
+  {
+    fi = &fd_infos[t->write_fd];
+    GNUNET_CONTAINER_MDLL_remove (wr, fi->writers_head, fi->writers_tail, t);
+    release_fd (t->write_fd, GNUNET_NO, GNUNET_YES);
+  }
+  if (NULL != t->read_set)
+    update_fd_set (t->read_set, GNUNET_YES, GNUNET_NO, GNUNET_NO);
+  if (NULL != t->write_set)
+    update_fd_set (t->write_set, GNUNET_NO, GNUNET_YES, GNUNET_NO);
+}
+
+
+/**
+ * Remove an FD from the list of FDs that cannot be polled.
+ *
+ * @param fd the file descriptor
+ */
+static void
+remove_unpollable (int fd)
+{
+  unsigned int i;
+
+  for (i = 0; i < unpollable_fds_count; i++)
+    if (unpollable_fds[i] == fd)
+    {
+      unpollable_fds[i] = unpollable_fds[--unpollable_fds_count];
+      break;
+    }
+  fd_infos[fd].unpollable = GNUNET_NO;
+}
+
+
+/**
+ * Update the kernel's view of all FDs whose interest set changed
+ * since the last call.  FDs are registered with EPOLLONESHOT, so a
+ * stale registration (i.e. of an FD that was closed while a
+ * duplicate was kept open elsewhere) can fire at most once.
+ */
+static void
+sync_epoll ()
+{
+  struct epoll_event ev;
+  struct FdInfo *fi;
+  uint32_t want;
+  unsigned int i;
+  int fd;
+  int op;
+
+  for (i = 0; i < dirty_fds_count; i++)
+  {
+    fd = dirty_fds[i];
+    fi = &fd_infos[fd];
+    want = 0;
+    if (fi->num_readers > 0)
+      want |= EPOLLIN;
+    if (fi->num_writers > 0)
+      want |= EPOLLOUT;
+    fi->dirty = GNUNET_NO;
+    if (GNUNET_YES == fi->unpollable)
+    {
+      if (0 == want)
+        remove_unpollable (fd);
+      continue;
+    }
+    if (0 == want)
+    {
+      /* may fail if the FD was closed already, which is fine */
+      if (0 != fi->registered)
+        (void) epoll_ctl (epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+      fi->registered = 0;
+      fi->rearm = GNUNET_NO;
+      continue;
+    }
+    if ( (want == fi->registered) &&
+         (GNUNET_NO == fi->rearm) )
+      continue;
+    memset (&ev, 0, sizeof (ev));
+    ev.events = want | EPOLLONESHOT;
+    ev.data.fd = fd;
+    op = (0 == fi->registered) ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+    if ( (0 != epoll_ctl (epoll_fd, op, fd, &ev)) &&
+         ( ( (EPOLL_CTL_ADD == op) && (EEXIST == errno) ) ||
+           ( (EPOLL_CTL_MOD == op) && (ENOENT == errno) ) ) )
+    {
+      op = (EPOLL_CTL_ADD == op) ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+      if (0 == epoll_ctl (epoll_fd, op, fd, &ev))
+        errno = 0;
+    }
+    else
+    {
+      errno = 0;
+    }
+    fi->rearm = GNUNET_NO;
+    if (0 == errno)
+    {
+      fi->registered = want;
+      continue;
+    }
+    if (EPERM != errno)
+      LOG_STRERROR (GNUNET_ERROR_TYPE_WARNING,
+                    "epoll_ctl");
+    /* regular files and broken FDs are always "ready", just like
+       with select(); the task will find out */
+    fi->registered = 0;
+    fi->unpollable = GNUNET_YES;
+    if (unpollable_fds_count == unpollable_fds_size)
+      GNUNET_array_grow (unpollable_fds, unpollable_fds_size,
+                         2 * unpollable_fds_size + 4);
+    unpollable_fds[unpollable_fds_count++] = fd;
+  }
+  dirty_fds_count = 0;
+}
+
+
+/**
+ * Mark the given FD as ready in the respective sets.
+ *
+ * @param fd file descriptor that is ready
+ * @param events events reported for @a fd
+ * @param rs set of FDs ready for reading (updated)
+ * @param ws set of FDs ready for writing (updated)
+ */
+static void
+epoll_fd_ready (int fd,
+                uint32_t events,
+                struct GNUNET_NETWORK_FDSet *rs,
+                struct GNUNET_NETWORK_FDSet *ws)
+{
+  struct FdInfo *fi;
+
+  if ((unsigned int) fd >= fd_infos_size)
+    return;
+  fi = &fd_infos[fd];
+  if (GNUNET_NO == fi->unpollable)
+  {
+    /* EPOLLONESHOT disabled the registration */
+    fi->rearm = GNUNET_YES;
+    mark_fd_dirty (fd);
+  }
+  if ( (0 != (events & (EPOLLIN | EPOLLERR | EPOLLHUP))) &&
+       (fi->num_readers > 0) )
+    GNUNET_NETWORK_fdset_set_native (rs, fd);
+  if ( (0 != (events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) &&
+       (fi->num_writers > 0) )
+    GNUNET_NETWORK_fdset_set_native (ws, fd);
+}
+
+
+/**
+ * Events returned by the last call to epoll_wait().
+ */
+static struct epoll_event epoll_events[EPOLL_MAX_EVENTS];
+
+/**
+ * Number of valid entries in #epoll_events.
+ */
+static unsigned int epoll_events_count;
+
+
+/**
+ * Wait for events using epoll().  Has the same semantics as
+ * select(), except that @a rs and @a ws are only filled with the
+ * FDs that are ready (instead of being used as input as well).
+ *
+ * @param rs set of FDs ready for reading (updated)
+ * @param ws set of FDs ready for writing (updated)
+ * @param timeout how long to wait at most
+ * @return number of FDs ready, #GNUNET_SYSERR on error
+ */
+static int
+epoll_select (struct GNUNET_NETWORK_FDSet *rs,
+              struct GNUNET_NETWORK_FDSet *ws,
+              struct GNUNET_TIME_Relative timeout)
+{
+  unsigned int i;
+  int ms;
+  int ret;
+
+  sync_epoll ();
+  if (unpollable_fds_count > 0)
+    timeout = GNUNET_TIME_UNIT_ZERO;
+  if (timeout.rel_value_us == GNUNET_TIME_UNIT_FOREVER_REL.rel_value_us)
+    ms = -1;
+  else
+    ms = (int) GNUNET_MIN ((timeout.rel_value_us + 999) / 1000, INT_MAX);
+  epoll_events_count = 0;
+  ret = epoll_wait (epoll_fd,
+                    epoll_events,
+                    EPOLL_MAX_EVENTS,
+                    ms);
+  if (-1 == ret)
+    return GNUNET_SYSERR;
+  epoll_events_count = ret;
+  for (i = 0; i < epoll_events_count; i++)
+    epoll_fd_ready (epoll_events[i].data.fd,
+                    epoll_events[i].events,
+                    rs, ws);
+  for (i = 0; i < unpollable_fds_count; i++)
+    epoll_fd_ready (unpollable_fds[i],
+                    EPOLLIN | EPOLLOUT,
+                    rs, ws);
+  return ret + unpollable_fds_count;
+}
+#endif
+
+
+/**
+ * Determine how long we may block until the next
+ * task times out.
+ *
+ * @return time until the earliest timeout
+ */
+static struct GNUNET_TIME_Relative
+get_timeout ()
+{
+  struct Task *pos;
+
+  pos = GNUNET_CONTAINER_heap_peek (timeout_heap);
+  if (NULL == pos)
+    return GNUNET_TIME_UNIT_FOREVER_REL;
+  if (0 != pos->reason)
+    return GNUNET_TIME_UNIT_ZERO;
+  return GNUNET_TIME_absolute_get_remaining (pos->timeout);
+}
+
+
 /**
  * Update all sets and timeout for select.
  *
@@ -288,39 +1035,22 @@ update_sets (struct GNUNET_NETWORK_FDSet *rs, struct GNUNET_NETWORK_FDSet *ws,
              struct GNUNET_TIME_Relative *timeout)
 {
   struct Task *pos;
-  struct GNUNET_TIME_Absolute now;
-  struct GNUNET_TIME_Relative to;
 
-  now = GNUNET_TIME_absolute_get ();
-  pos = pending_timeout;
-  if (NULL != pos)
-  {
-    to = GNUNET_TIME_absolute_get_difference (now, pos->timeout);
-    if (timeout->rel_value_us > to.rel_value_us)
-      *timeout = to;
-    if (pos->reason != 0)
-      *timeout = GNUNET_TIME_UNIT_ZERO;
-  }
-  pos = pending;
-  while (NULL != pos)
+  *timeout = GNUNET_TIME_relative_min (*timeout,
+                                       get_timeout ());
+  for (pos = pending_head; NULL != pos; pos = pos->next)
   {
-    if (pos->timeout.abs_value_us != GNUNET_TIME_UNIT_FOREVER_ABS.abs_value_us)
-    {
-      to = GNUNET_TIME_absolute_get_difference (now, pos->timeout);
-      if (timeout->rel_value_us > to.rel_value_us)
-        *timeout = to;
-    }
     if (-1 != pos->read_fd)
       GNUNET_NETWORK_fdset_set_native (rs, pos->read_fd);
     if (-1 != pos->write_fd)
       GNUNET_NETWORK_fdset_set_native (ws, pos->write_fd);
+  }
+  for (pos = pending_sets_head; NULL != pos; pos = pos->next)
+  {
     if (NULL != pos->read_set)
       GNUNET_NETWORK_fdset_add (rs, pos->read_set);
     if (NULL != pos->write_set)
       GNUNET_NETWORK_fdset_add (ws, pos->write_set);
-    if (0 != pos->reason)
-      *timeout = GNUNET_TIME_UNIT_ZERO;
-    pos = pos->next;
   }
 }
 
@@ -366,45 +1096,178 @@ is_ready (struct Task *task, struct GNUNET_TIME_Absolute now,
           const struct GNUNET_NETWORK_FDSet *rs,
           const struct GNUNET_NETWORK_FDSet *ws)
 {
-  enum GNUNET_SCHEDULER_Reason reason;
+  enum GNUNET_SCHEDULER_Reason reason;
+
+  reason = task->reason;
+  if (now.abs_value_us >= task->timeout.abs_value_us)
+    reason |= GNUNET_SCHEDULER_REASON_TIMEOUT;
+  if ((0 == (reason & GNUNET_SCHEDULER_REASON_READ_READY)) &&
+      (((task->read_fd != -1) &&
+        (GNUNET_YES == GNUNET_NETWORK_fdset_test_native (rs, task->read_fd))) ||
+       (set_overlaps (rs, task->read_set))))
+    reason |= GNUNET_SCHEDULER_REASON_READ_READY;
+  if ((0 == (reason & GNUNET_SCHEDULER_REASON_WRITE_READY)) &&
+      (((task->write_fd != -1) &&
+        (GNUNET_YES == GNUNET_NETWORK_fdset_test_native (ws, task->write_fd)))
+       || (set_overlaps (ws, task->write_set))))
+    reason |= GNUNET_SCHEDULER_REASON_WRITE_READY;
+  if (0 == reason)
+    return GNUNET_NO;           /* not ready */
+  reason |= GNUNET_SCHEDULER_REASON_PREREQ_DONE;
+  task->reason = reason;
+  return GNUNET_YES;
+}
+
+
+/**
+ * Put a task that is ready for execution into the ready queue.
+ *
+ * @param task task ready for execution
+ */
+static void
+queue_ready_task (struct Task *task)
+{
+  enum GNUNET_SCHEDULER_Priority p = task->priority;
+
+  if (0 != (task->reason & GNUNET_SCHEDULER_REASON_SHUTDOWN))
+    p = GNUNET_SCHEDULER_PRIORITY_SHUTDOWN;
+  p = check_priority (p);
+  task->queue_head = &ready_head[p];
+  task->queue_tail = &ready_tail[p];
+  GNUNET_CONTAINER_DLL_insert (ready_head[p],
+                               ready_tail[p],
+                               task);
+  ready_count++;
+}
+
+
+/**
+ * Put a task into the given list of pending tasks
+ * and track its timeout (and file descriptors).
+ *
+ * @param task task to wait for
+ * @param head head of the pending list to use
+ * @param tail tail of the pending list to use
+ */
+static void
+queue_pending_task (struct Task *task,
+                    struct Task **head,
+                    struct Task **tail)
+{
+  task->queue_head = head;
+  task->queue_tail = tail;
+  GNUNET_CONTAINER_DLL_insert (*head,
+                               *tail,
+                               task);
+  task->timeout_node = GNUNET_CONTAINER_heap_insert (timeout_heap,
+                                                     task,
+                                                     task->timeout.abs_value_us);
+  if (GNUNET_YES == task->lifeness)
+    pending_lifeness++;
+#if EPOLL_SUPPORTED
+  if (-1 != epoll_fd)
+    epoll_add_task (task);
+#endif
+}
+
+
+/**
+ * Remove a task from the pending lists (it is either
+ * ready or being cancelled).
+ *
+ * @param task task to remove
+ */
+static void
+dequeue_pending_task (struct Task *task)
+{
+  GNUNET_CONTAINER_DLL_remove (*task->queue_head,
+                               *task->queue_tail,
+                               task);
+  GNUNET_CONTAINER_heap_remove_node (task->timeout_node);
+  task->timeout_node = NULL;
+  if (GNUNET_YES == task->lifeness)
+    pending_lifeness--;
+#if EPOLL_SUPPORTED
+  if (-1 != epoll_fd)
+    epoll_remove_task (task);
+#endif
+}
+
+
+/**
+ * Check which tasks in the given pending list are ready and move
+ * them to the respective ready queue.
+ *
+ * @param head head of the pending list
+ * @param now the current time
+ * @param rs FDs ready for reading
+ * @param ws FDs ready for writing
+ */
+static void
+check_ready_list (struct Task *head,
+                  struct GNUNET_TIME_Absolute now,
+                  const struct GNUNET_NETWORK_FDSet *rs,
+                  const struct GNUNET_NETWORK_FDSet *ws)
+{
+  struct Task *pos;
+  struct Task *next;
 
-  reason = task->reason;
-  if (now.abs_value_us >= task->timeout.abs_value_us)
-    reason |= GNUNET_SCHEDULER_REASON_TIMEOUT;
-  if ((0 == (reason & GNUNET_SCHEDULER_REASON_READ_READY)) &&
-      (((task->read_fd != -1) &&
-        (GNUNET_YES == GNUNET_NETWORK_fdset_test_native (rs, task->read_fd))) ||
-       (set_overlaps (rs, task->read_set))))
-    reason |= GNUNET_SCHEDULER_REASON_READ_READY;
-  if ((0 == (reason & GNUNET_SCHEDULER_REASON_WRITE_READY)) &&
-      (((task->write_fd != -1) &&
-        (GNUNET_YES == GNUNET_NETWORK_fdset_test_native (ws, task->write_fd)))
-       || (set_overlaps (ws, task->write_set))))
-    reason |= GNUNET_SCHEDULER_REASON_WRITE_READY;
-  if (0 == reason)
-    return GNUNET_NO;           /* not ready */
-  reason |= GNUNET_SCHEDULER_REASON_PREREQ_DONE;
-  task->reason = reason;
-  return GNUNET_YES;
+  for (pos = head; NULL != pos; pos = next)
+  {
+    LOG (GNUNET_ERROR_TYPE_DEBUG,
+	 "Checking readiness of task: %llu / %p\n",
+         pos->id, pos->callback_cls);
+    next = pos->next;
+    if (GNUNET_YES == is_ready (pos, now, rs, ws))
+    {
+      dequeue_pending_task (pos);
+      queue_ready_task (pos);
+    }
+  }
 }
 
 
+#if EPOLL_SUPPORTED
 /**
- * Put a task that is ready for execution into the ready queue.
+ * Check which tasks waiting for an FD reported by epoll()
+ * are ready and move them to the respective ready queue.
  *
- * @param task task ready for execution
+ * @param fd file descriptor that is ready
+ * @param now the current time
+ * @param rs FDs ready for reading
+ * @param ws FDs ready for writing
  */
 static void
-queue_ready_task (struct Task *task)
+check_ready_fd (int fd,
+                struct GNUNET_TIME_Absolute now,
+                const struct GNUNET_NETWORK_FDSet *rs,
+                const struct GNUNET_NETWORK_FDSet *ws)
 {
-  enum GNUNET_SCHEDULER_Priority p = task->priority;
+  struct Task *pos;
+  struct Task *next;
 
-  if (0 != (task->reason & GNUNET_SCHEDULER_REASON_SHUTDOWN))
-    p = GNUNET_SCHEDULER_PRIORITY_SHUTDOWN;
-  task->next = ready[check_priority (p)];
-  ready[check_priority (p)] = task;
-  ready_count++;
+  if ((unsigned int) fd >= fd_infos_size)
+    return;
+  for (pos = fd_infos[fd].readers_head; NULL != pos; pos = next)
+  {
+    next = pos->next_rd;
+    if (GNUNET_YES == is_ready (pos, now, rs, ws))
+    {
+      dequeue_pending_task (pos);
+      queue_ready_task (pos);
+    }
+  }
+  for (pos = fd_infos[fd].writers_head; NULL != pos; pos = next)
+  {
+    next = pos->next_wr;
+    if (GNUNET_YES == is_ready (pos, now, rs, ws))
+    {
+      dequeue_pending_task (pos);
+      queue_ready_task (pos);
+    }
+  }
 }
+#endif
 
 
 /**
@@ -419,45 +1282,59 @@ check_ready (const struct GNUNET_NETWORK_FDSet *rs,
              const struct GNUNET_NETWORK_FDSet *ws)
 {
   struct Task *pos;
-  struct Task *prev;
-  struct Task *next;
   struct GNUNET_TIME_Absolute now;
+#if EPOLL_SUPPORTED
+  unsigned int i;
+#endif
 
   now = GNUNET_TIME_absolute_get ();
-  prev = NULL;
-  pos = pending_timeout;
-  while (NULL != pos)
+  while (NULL != (pos = GNUNET_CONTAINER_heap_peek (timeout_heap)))
   {
-    next = pos->next;
     if (now.abs_value_us >= pos->timeout.abs_value_us)
       pos->reason |= GNUNET_SCHEDULER_REASON_TIMEOUT;
     if (0 == pos->reason)
       break;
-    pending_timeout = next;
-    if (pending_timeout_last == pos)
-      pending_timeout_last = NULL;
+    if (&pending_timeout_head != pos->queue_head)
+      (void) is_ready (pos, now, rs, ws); /* collect other readiness-factors */
+    dequeue_pending_task (pos);
     queue_ready_task (pos);
-    pos = next;
   }
-  pos = pending;
-  while (NULL != pos)
+  check_ready_list (pending_sets_head, now, rs, ws);
+#if EPOLL_SUPPORTED
+  if (-1 != epoll_fd)
   {
-    LOG (GNUNET_ERROR_TYPE_DEBUG,
-	 "Checking readiness of task: %llu / %p\n",
-         pos->id, pos->callback_cls);
-    next = pos->next;
-    if (GNUNET_YES == is_ready (pos, now, rs, ws))
-    {
-      if (NULL == prev)
-        pending = next;
-      else
-        prev->next = next;
-      queue_ready_task (pos);
-      pos = next;
-      continue;
-    }
-    prev = pos;
-    pos = next;
+    for (i = 0; i < epoll_events_count; i++)
+      check_ready_fd (epoll_events[i].data.fd, now, rs, ws);
+    for (i = 0; i < unpollable_fds_count; i++)
+      check_ready_fd (unpollable_fds[i], now, rs, ws);
+    epoll_events_count = 0;
+    return;
+  }
+#endif
+  check_ready_list (pending_head, now, rs, ws);
+}
+
+
+/**
+ * Mark all tasks in the given pending list as ready because of
+ * shutdown.  We don't move the tasks into the ready queue yet;
+ * check_ready will do that later, possibly adding additional
+ * readiness-factors.  Moving them to the front of the timeout
+ * heap makes sure check_ready finds them right away.
+ *
+ * @param head head of the pending list
+ */
+static void
+shutdown_pending (struct Task *head)
+{
+  struct Task *pos;
+
+  for (pos = head; NULL != pos; pos = pos->next)
+  {
+    pos->reason |= GNUNET_SCHEDULER_REASON_SHUTDOWN;
+    GNUNET_CONTAINER_heap_update_cost (timeout_heap,
+                                       pos->timeout_node,
+                                       0);
   }
 }
 
@@ -475,27 +1352,12 @@ GNUNET_SCHEDULER_shutdown ()
   struct Task *pos;
   int i;
 
-  pos = pending_timeout;
-  while (NULL != pos)
-  {
-    pos->reason |= GNUNET_SCHEDULER_REASON_SHUTDOWN;
-    /* we don't move the task into the ready queue yet; check_ready
-     * will do that later, possibly adding additional
-     * readiness-factors */
-    pos = pos->next;
-  }
-  pos = pending;
-  while (NULL != pos)
-  {
-    pos->reason |= GNUNET_SCHEDULER_REASON_SHUTDOWN;
-    /* we don't move the task into the ready queue yet; check_ready
-     * will do that later, possibly adding additional
-     * readiness-factors */
-    pos = pos->next;
-  }
+  shutdown_pending (pending_timeout_head);
+  shutdown_pending (pending_head);
+  shutdown_pending (pending_sets_head);
   for (i = 0; i < GNUNET_SCHEDULER_PRIORITY_COUNT; i++)
   {
-    pos = ready[i];
+    pos = ready_head[i];
     while (NULL != pos)
     {
       pos->reason |= GNUNET_SCHEDULER_REASON_SHUTDOWN;
@@ -508,6 +1370,181 @@ GNUNET_SCHEDULER_shutdown ()
 }
 
 
+/**
+ * Obtain a fresh (zeroed) task, preferably from the free list.
+ *
+ * @return new task
+ */
+static struct Task *
+new_task ()
+{
+  struct TaskSlab *slab;
+  struct Task *t;
+  unsigned int i;
+
+  if (NULL == (slab = avail_slabs_head))
+  {
+    task_pool_misses++;
+    slab = GNUNET_new (struct TaskSlab);
+    for (i = 0; i < TASK_SLAB_SIZE; i++)
+    {
+      slab->tasks[i].next = slab->free_tasks;
+      slab->free_tasks = &slab->tasks[i];
+    }
+    slab->num_free = TASK_SLAB_SIZE;
+    num_free_tasks += TASK_SLAB_SIZE;
+    GNUNET_CONTAINER_DLL_insert (avail_slabs_head,
+                                 avail_slabs_tail,
+                                 slab);
+  }
+  else
+  {
+    task_pool_hits++;
+  }
+  t = slab->free_tasks;
+  slab->free_tasks = t->next;
+  num_free_tasks--;
+  if (0 == --slab->num_free)
+  {
+    GNUNET_CONTAINER_DLL_remove (avail_slabs_head,
+                                 avail_slabs_tail,
+                                 slab);
+    GNUNET_CONTAINER_DLL_insert (full_slabs_head,
+                                 full_slabs_tail,
+                                 slab);
+  }
+  memset (t, 0, sizeof (struct Task));
+  t->slab = slab;
+  return t;
+}
+
+
+/**
+ * Obtain an FD set that is a copy of @a src, preferably re-using
+ * an FD set of a task that was destroyed earlier.
+ *
+ * @param src FD set to copy
+ * @return copy of @a src
+ */
+static struct GNUNET_NETWORK_FDSet *
+new_fdset (const struct GNUNET_NETWORK_FDSet *src)
+{
+  struct GNUNET_NETWORK_FDSet *fds;
+
+  if (0 == free_fdsets_count)
+  {
+    fdset_pool_misses++;
+    fds = GNUNET_NETWORK_fdset_create ();
+  }
+  else
+  {
+    fdset_pool_hits++;
+    fds = free_fdsets[--free_fdsets_count];
+  }
+  GNUNET_NETWORK_fdset_copy (fds, src);
+  return fds;
+}
+
+
+/**
+ * Return an FD set that is no longer needed.
+ *
+ * @param fds FD set to release
+ */
+static void
+free_fdset (struct GNUNET_NETWORK_FDSet *fds)
+{
+  if (MAX_FREE_FDSETS == free_fdsets_count)
+  {
+    GNUNET_NETWORK_fdset_destroy (fds);
+    return;
+  }
+  free_fdsets[free_fdsets_count++] = fds;
+}
+
+
+/**
+ * Return a task that is no longer needed to its slab.  Release the
+ * slab if none of its tasks are in use anymore and we keep enough
+ * unused tasks in other slabs.
+ *
+ * @param t task to release
+ */
+static void
+release_task (struct Task *t)
+{
+  struct TaskSlab *slab = t->slab;
+
+  if (0 == slab->num_free)
+  {
+    GNUNET_CONTAINER_DLL_remove (full_slabs_head,
+                                 full_slabs_tail,
+                                 slab);
+    /* slabs that are almost entirely in use are preferred by
+       new_task(), so that the others can become unused */
+    GNUNET_CONTAINER_DLL_insert (avail_slabs_head,
+                                 avail_slabs_tail,
+                                 slab);
+  }
+  t->next = slab->free_tasks;
+  slab->free_tasks = t;
+  slab->num_free++;
+  num_free_tasks++;
+  if ( (TASK_SLAB_SIZE == slab->num_free) &&
+       (num_free_tasks >= TASK_FREE_LOW_WATER + TASK_SLAB_SIZE) )
+  {
+    GNUNET_CONTAINER_DLL_remove (avail_slabs_head,
+                                 avail_slabs_tail,
+                                 slab);
+    num_free_tasks -= TASK_SLAB_SIZE;
+    task_pool_releases++;
+    GNUNET_free (slab);
+  }
+}
+
+
+/**
+ * Release all tasks and FD sets kept for re-use.  Must only be
+ * called once no task exists anymore.
+ */
+static void
+release_pools ()
+{
+  struct TaskSlab *slab;
+
+  LOG (GNUNET_ERROR_TYPE_DEBUG,
+       "Task pool: %llu hits, %llu slabs, %llu released; FD set pool: %llu hits, %llu misses\n",
+       task_pool_hits,
+       task_pool_misses,
+       task_pool_releases,
+       fdset_pool_hits,
+       fdset_pool_misses);
+  GNUNET_break (NULL == full_slabs_head);
+  while (NULL != (slab = full_slabs_head))
+  {
+    GNUNET_CONTAINER_DLL_remove (full_slabs_head,
+                                 full_slabs_tail,
+                                 slab);
+    GNUNET_free (slab);
+  }
+  while (NULL != (slab = avail_slabs_head))
+  {
+    GNUNET_CONTAINER_DLL_remove (avail_slabs_head,
+                                 avail_slabs_tail,
+                                 slab);
+    GNUNET_free (slab);
+  }
+  num_free_tasks = 0;
+  while (free_fdsets_count > 0)
+    GNUNET_NETWORK_fdset_destroy (free_fdsets[--free_fdsets_count]);
+  task_pool_hits = 0;
+  task_pool_misses = 0;
+  task_pool_releases = 0;
+  fdset_pool_hits = 0;
+  fdset_pool_misses = 0;
+}
+
+
 /**
  * Destroy a task (release associated resources)
  *
@@ -516,14 +1553,94 @@ GNUNET_SCHEDULER_shutdown ()
 static void
 destroy_task (struct Task *t)
 {
+  GNUNET_assert (GNUNET_YES ==
+                 GNUNET_CONTAINER_multihashmap32_remove (task_map,
+                                                         (uint32_t) t->id,
+                                                         t));
   if (NULL != t->read_set)
-    GNUNET_NETWORK_fdset_destroy (t->read_set);
+    free_fdset (t->read_set);
   if (NULL != t->write_set)
-    GNUNET_NETWORK_fdset_destroy (t->write_set);
+    free_fdset (t->write_set);
 #if EXECINFO
   GNUNET_free (t->backtrace_strings);
 #endif
-  GNUNET_free (t);
+  release_task (t);
+}
+
+
+/**
+ * Remember a newly created task so that it can be cancelled.
+ *
+ * @param t task to track
+ */
+static void
+track_task (struct Task *t)
+{
+  (void) GNUNET_CONTAINER_multihashmap32_put (task_map,
+                                              (uint32_t) t->id,
+                                              t,
+                                              GNUNET_CONTAINER_MULTIHASHMAPOPTION_MULTIPLE);
+}
+
+
+/**
+ * Closure for #find_task_it().
+ */
+struct FindTaskContext
+{
+  /**
+   * Task identifier we are looking for.
+   */
+  GNUNET_SCHEDULER_TaskIdentifier id;
+
+  /**
+   * Set to the task, if found.
+   */
+  struct Task *task;
+};
+
+
+/**
+ * Check if a task from the #task_map is the one we are looking for.
+ *
+ * @param cls the `struct FindTaskContext`
+ * @param key lower 32 bits of the task identifier
+ * @param value a `struct Task`
+ * @return #GNUNET_NO if we found the task, #GNUNET_YES to continue
+ */
+static int
+find_task_it (void *cls,
+              uint32_t key,
+              void *value)
+{
+  struct FindTaskContext *ftc = cls;
+  struct Task *t = value;
+
+  if (t->id != ftc->id)
+    return GNUNET_YES;
+  ftc->task = t;
+  return GNUNET_NO;
+}
+
+
+/**
+ * Find a task that has not yet run.
+ *
+ * @param id identifier of the task
+ * @return NULL if no such task exists
+ */
+static struct Task *
+find_task (GNUNET_SCHEDULER_TaskIdentifier id)
+{
+  struct FindTaskContext ftc;
+
+  ftc.id = id;
+  ftc.task = NULL;
+  GNUNET_CONTAINER_multihashmap32_get_multiple (task_map,
+                                                (uint32_t) id,
+                                                &find_task_it,
+                                                &ftc);
+  return ftc.task;
 }
 
 
@@ -550,17 +1667,19 @@ run_ready (struct GNUNET_NETWORK_FDSet *rs,
   {
     if (0 == ready_count)
       return;
-    GNUNET_assert (ready[GNUNET_SCHEDULER_PRIORITY_KEEP] == NULL);
+    GNUNET_assert (ready_head[GNUNET_SCHEDULER_PRIORITY_KEEP] == NULL);
     /* yes, p>0 is correct, 0 is "KEEP" which should
      * always be an empty queue (see assertion)! */
     for (p = GNUNET_SCHEDULER_PRIORITY_COUNT - 1; p > 0; p--)
     {
-      pos = ready[p];
+      pos = ready_head[p];
       if (NULL != pos)
         break;
     }
     GNUNET_assert (NULL != pos);        /* ready_count wrong? */
-    ready[p] = pos->next;
+    GNUNET_CONTAINER_DLL_remove (ready_head[p],
+                                 ready_tail[p],
+                                 pos);
     ready_count--;
     current_priority = pos->priority;
     current_lifeness = pos->lifeness;
@@ -607,7 +1726,9 @@ run_ready (struct GNUNET_NETWORK_FDSet *rs,
     destroy_task (pos);
     tasks_run++;
   }
-  while ((NULL == pending) || (p >= max_priority_added));
+  while ( ( (NULL == pending_head) &&
+            (NULL == pending_sets_head) ) ||
+          (p >= max_priority_added) );
 }
 
 /**
@@ -680,17 +1801,11 @@ sighandler_shutdown ()
 static int
 check_lifeness ()
 {
-  struct Task *t;
-
   if (ready_count > 0)
     return GNUNET_OK;
-  for (t = pending; NULL != t; t = t->next)
-    if (t->lifeness == GNUNET_YES)
-      return GNUNET_OK;
-  for (t = pending_timeout; NULL != t; t = t->next)
-    if (t->lifeness == GNUNET_YES)
-      return GNUNET_OK;
-  if ((NULL != pending) || (NULL != pending_timeout))
+  if (pending_lifeness > 0)
+    return GNUNET_OK;
+  if (0 != GNUNET_CONTAINER_heap_get_size (timeout_heap))
   {
     GNUNET_SCHEDULER_shutdown ();
     return GNUNET_OK;
@@ -735,8 +1850,13 @@ GNUNET_SCHEDULER_run (GNUNET_SCHEDULER_Task task, void *task_cls)
   unsigned int busy_wait_warning;
   const struct GNUNET_DISK_FileHandle *pr;
   char c;
+#if EPOLL_SUPPORTED
+  int pr_fd;
+#endif
 
   GNUNET_assert (NULL == active_task);
+  timeout_heap = GNUNET_CONTAINER_heap_create (GNUNET_CONTAINER_HEAP_ORDER_MIN);
+  task_map = GNUNET_CONTAINER_multihashmap32_create (32);
   rs = GNUNET_NETWORK_fdset_create ();
   ws = GNUNET_NETWORK_fdset_create ();
   GNUNET_assert (NULL == shutdown_pipe_handle);
@@ -745,6 +1865,21 @@ GNUNET_SCHEDULER_run (GNUNET_SCHEDULER_Task task, void *task_cls)
   pr = GNUNET_DISK_pipe_handle (shutdown_pipe_handle,
                                 GNUNET_DISK_PIPE_END_READ);
   GNUNET_assert (pr != NULL);
+#if EPOLL_SUPPORTED
+  if ( (GNUNET_YES == use_epoll) &&
+       (NULL == scheduler_select) )
+  {
+    epoll_fd = epoll_create1 (EPOLL_CLOEXEC);
+    if (-1 == epoll_fd)
+      LOG_STRERROR (GNUNET_ERROR_TYPE_WARNING,
+                    "epoll_create1");
+  }
+  if (-1 != epoll_fd)
+  {
+    GNUNET_DISK_internal_file_handle_ (pr, &pr_fd, sizeof (int));
+    acquire_fd (pr_fd, GNUNET_YES, GNUNET_NO);
+  }
+#endif
   my_pid = getpid ();
   LOG (GNUNET_ERROR_TYPE_DEBUG, "Registering signal handlers\n");
   shc_int = GNUNET_SIGNAL_handler_install (SIGINT, &sighandler_shutdown);
@@ -773,13 +1908,25 @@ GNUNET_SCHEDULER_run (GNUNET_SCHEDULER_Task task, void *task_cls)
     GNUNET_NETWORK_fdset_zero (rs);
     GNUNET_NETWORK_fdset_zero (ws);
     timeout = GNUNET_TIME_UNIT_FOREVER_REL;
-    update_sets (rs, ws, &timeout);
-    GNUNET_NETWORK_fdset_handle_set (rs, pr);
+#if EPOLL_SUPPORTED
+    if (-1 != epoll_fd)
+      timeout = get_timeout ();
+    else
+#endif
+    {
+      update_sets (rs, ws, &timeout);
+      GNUNET_NETWORK_fdset_handle_set (rs, pr);
+    }
     if (ready_count > 0)
     {
       /* no blocking, more work already ready! */
       timeout = GNUNET_TIME_UNIT_ZERO;
     }
+#if EPOLL_SUPPORTED
+    if (-1 != epoll_fd)
+      ret = epoll_select (rs, ws, timeout);
+    else
+#endif
     if (NULL == scheduler_select)
       ret = GNUNET_NETWORK_socket_select (rs, ws, NULL, timeout);
     else
@@ -842,11 +1989,30 @@ GNUNET_SCHEDULER_run (GNUNET_SCHEDULER_Task task, void *task_cls)
   GNUNET_SIGNAL_handler_uninstall (shc_pipe);
   GNUNET_SIGNAL_handler_uninstall (shc_quit);
   GNUNET_SIGNAL_handler_uninstall (shc_hup);
+#endif
+#if EPOLL_SUPPORTED
+  if (-1 != epoll_fd)
+  {
+    release_fd (pr_fd, GNUNET_YES, GNUNET_NO);
+    GNUNET_break (0 == close (epoll_fd));
+    epoll_fd = -1;
+    GNUNET_array_grow (fd_infos, fd_infos_size, 0);
+    GNUNET_array_grow (dirty_fds, dirty_fds_size, 0);
+    GNUNET_array_grow (unpollable_fds, unpollable_fds_size, 0);
+    dirty_fds_count = 0;
+    unpollable_fds_count = 0;
+    epoll_events_count = 0;
+  }
 #endif
   GNUNET_DISK_pipe_close (shutdown_pipe_handle);
   shutdown_pipe_handle = NULL;
   GNUNET_NETWORK_fdset_destroy (rs);
   GNUNET_NETWORK_fdset_destroy (ws);
+  GNUNET_CONTAINER_heap_destroy (timeout_heap);
+  timeout_heap = NULL;
+  GNUNET_CONTAINER_multihashmap32_destroy (task_map);
+  task_map = NULL;
+  release_pools ();
 }
 
 
@@ -886,7 +2052,7 @@ GNUNET_SCHEDULER_get_load (enum GNUNET_SCHEDULER_Priority p)
   if (p == GNUNET_SCHEDULER_PRIORITY_KEEP)
     p = current_priority;
   ret = 0;
-  pos = ready[check_priority (p)];
+  pos = ready_head[check_priority (p)];
   while (NULL != pos)
   {
     pos = pos->next;
@@ -907,82 +2073,27 @@ void *
 GNUNET_SCHEDULER_cancel (GNUNET_SCHEDULER_TaskIdentifier task)
 {
   struct Task *t;
-  struct Task *prev;
-  enum GNUNET_SCHEDULER_Priority p;
-  int to;
   void *ret;
 
   GNUNET_assert (NULL != active_task);
-  to = 0;
-  prev = NULL;
-  t = pending;
-  while (NULL != t)
-  {
-    if (t->id == task)
-      break;
-    prev = t;
-    t = t->next;
-  }
+  t = find_task (task);
   if (NULL == t)
   {
-    prev = NULL;
-    to = 1;
-    t = pending_timeout;
-    while (t != NULL)
-    {
-      if (t->id == task)
-        break;
-      prev = t;
-      t = t->next;
-    }
-    if (pending_timeout_last == t)
-      pending_timeout_last = NULL;
-  }
-  p = 0;
-  while (NULL == t)
-  {
-    p++;
-    if (p >= GNUNET_SCHEDULER_PRIORITY_COUNT)
-    {
-      LOG (GNUNET_ERROR_TYPE_ERROR,
-           _("Attempt to cancel dead task %llu!\n"),
-           (unsigned long long) task);
-      GNUNET_assert (0);
-    }
-    prev = NULL;
-    t = ready[p];
-    while (NULL != t)
-    {
-      if (t->id == task)
-      {
-        ready_count--;
-        break;
-      }
-      prev = t;
-      t = t->next;
-    }
+    LOG (GNUNET_ERROR_TYPE_ERROR,
+         _("Attempt to cancel dead task %llu!\n"),
+         (unsigned long long) task);
+    GNUNET_assert (0);
   }
-  if (NULL == prev)
+  if (NULL != t->timeout_node)
   {
-    if (0 == p)
-    {
-      if (0 == to)
-      {
-        pending = t->next;
-      }
-      else
-      {
-        pending_timeout = t->next;
-      }
-    }
-    else
-    {
-      ready[p] = t->next;
-    }
+    dequeue_pending_task (t);
   }
   else
   {
-    prev->next = t->next;
+    GNUNET_CONTAINER_DLL_remove (*t->queue_head,
+                                 *t->queue_tail,
+                                 t);
+    ready_count--;
   }
   ret = t->callback_cls;
   LOG (GNUNET_ERROR_TYPE_DEBUG,
@@ -1018,7 +2129,7 @@ GNUNET_SCHEDULER_add_continuation_with_priority (GNUNET_SCHEDULER_Task task, voi
   GNUNET_assert (NULL != task);
   GNUNET_assert ((NULL != active_task) ||
                  (GNUNET_SCHEDULER_REASON_STARTUP == reason));
-  t = GNUNET_new (struct Task);
+  t = new_task ();
 #if EXECINFO
   t->num_backtrace_strings = backtrace (backtrace_array, 50);
   t->backtrace_strings =
@@ -1039,6 +2150,7 @@ GNUNET_SCHEDULER_add_continuation_with_priority (GNUNET_SCHEDULER_Task task, voi
        "Adding continuation task: %llu / %p\n",
        t->id,
        t->callback_cls);
+  track_task (t);
   queue_ready_task (t);
 }
 
@@ -1100,8 +2212,6 @@ GNUNET_SCHEDULER_add_delayed_with_priority (struct GNUNET_TIME_Relative delay,
 					    GNUNET_SCHEDULER_Task task, void *task_cls)
 {
   struct Task *t;
-  struct Task *pos;
-  struct Task *prev;
 
 #if EXECINFO
   void *backtrace_array[MAX_TRACE_DEPTH];
@@ -1109,7 +2219,7 @@ GNUNET_SCHEDULER_add_delayed_with_priority (struct GNUNET_TIME_Relative delay,
 
   GNUNET_assert (NULL != active_task);
   GNUNET_assert (NULL != task);
-  t = GNUNET_new (struct Task);
+  t = new_task ();
   t->callback = task;
   t->callback_cls = task_cls;
 #if EXECINFO
@@ -1126,35 +2236,10 @@ GNUNET_SCHEDULER_add_delayed_with_priority (struct GNUNET_TIME_Relative delay,
   t->timeout = GNUNET_TIME_relative_to_absolute (delay);
   t->priority = priority;
   t->lifeness = current_lifeness;
-  /* try tail first (optimization in case we are
-   * appending to a long list of tasks with timeouts) */
-  prev = pending_timeout_last;
-  if (prev != NULL)
-  {
-    if (prev->timeout.abs_value_us > t->timeout.abs_value_us)
-      prev = NULL;
-    else
-      pos = prev->next;         /* heuristic success! */
-  }
-  if (prev == NULL)
-  {
-    /* heuristic failed, do traversal of timeout list */
-    pos = pending_timeout;
-  }
-  while ((pos != NULL) &&
-         ((pos->timeout.abs_value_us <= t->timeout.abs_value_us) ||
-          (0 != pos->reason)))
-  {
-    prev = pos;
-    pos = pos->next;
-  }
-  if (prev == NULL)
-    pending_timeout = t;
-  else
-    prev->next = t;
-  t->next = pos;
-  /* hyper-optimization... */
-  pending_timeout_last = t;
+  track_task (t);
+  queue_pending_task (t,
+                      &pending_timeout_head,
+                      &pending_timeout_tail);
 
   LOG (GNUNET_ERROR_TYPE_DEBUG, "Adding task: %llu / %p\n", t->id,
        t->callback_cls);
@@ -1238,8 +2323,12 @@ GNUNET_SCHEDULER_add_now_with_lifeness (int lifeness,
       GNUNET_SCHEDULER_add_select (GNUNET_SCHEDULER_PRIORITY_DEFAULT,
                                    GNUNET_TIME_UNIT_ZERO, NULL, NULL, task,
                                    task_cls);
-  GNUNET_assert (pending->id == ret);
-  pending->lifeness = lifeness;
+  GNUNET_assert (pending_head->id == ret);
+  if (GNUNET_YES == pending_head->lifeness)
+    pending_lifeness--;
+  pending_head->lifeness = lifeness;
+  if (GNUNET_YES == pending_head->lifeness)
+    pending_lifeness++;
   return ret;
 }
 
@@ -1286,7 +2375,7 @@ add_without_sets (struct GNUNET_TIME_Relative delay,
 
   GNUNET_assert (NULL != active_task);
   GNUNET_assert (NULL != task);
-  t = GNUNET_new (struct Task);
+  t = new_task ();
   t->callback = task;
   t->callback_cls = task_cls;
 #if EXECINFO
@@ -1346,8 +2435,10 @@ add_without_sets (struct GNUNET_TIME_Relative delay,
   t->timeout = GNUNET_TIME_relative_to_absolute (delay);
   t->priority = check_priority ((priority == GNUNET_SCHEDULER_PRIORITY_KEEP) ? current_priority : priority);
   t->lifeness = current_lifeness;
-  t->next = pending;
-  pending = t;
+  track_task (t);
+  queue_pending_task (t,
+                      &pending_head,
+                      &pending_tail);
   max_priority_added = GNUNET_MAX (max_priority_added, t->priority);
   LOG (GNUNET_ERROR_TYPE_DEBUG,
        "Adding task: %llu / %p\n",
@@ -1650,7 +2741,7 @@ GNUNET_SCHEDULER_add_select (enum GNUNET_SCHEDULER_Priority prio,
 
   GNUNET_assert (NULL != active_task);
   GNUNET_assert (NULL != task);
-  t = GNUNET_new (struct Task);
+  t = new_task ();
   t->callback = task;
   t->callback_cls = task_cls;
 #if EXECINFO
@@ -1662,13 +2753,11 @@ GNUNET_SCHEDULER_add_select (enum GNUNET_SCHEDULER_Priority prio,
   t->write_fd = -1;
   if (NULL != rs)
   {
-    t->read_set = GNUNET_NETWORK_fdset_create ();
-    GNUNET_NETWORK_fdset_copy (t->read_set, rs);
+    t->read_set = new_fdset (rs);
   }
   if (NULL != ws)
   {
-    t->write_set = GNUNET_NETWORK_fdset_create ();
-    GNUNET_NETWORK_fdset_copy (t->write_set, ws);
+    t->write_set = new_fdset (ws);
   }
   t->id = ++last_id;
 #if PROFILE_DELAYS
@@ -1680,8 +2769,16 @@ GNUNET_SCHEDULER_add_select (enum GNUNET_SCHEDULER_Priority prio,
                        GNUNET_SCHEDULER_PRIORITY_KEEP) ? current_priority :
                       prio);
   t->lifeness = current_lifeness;
-  t->next = pending;
-  pending = t;
+  track_task (t);
+  if ( (NULL == t->read_set) &&
+       (NULL == t->write_set) )
+    queue_pending_task (t,
+                        &pending_head,
+                        &pending_tail);
+  else
+    queue_pending_task (t,
+                        &pending_sets_head,
+                        &pending_sets_tail);
   max_priority_added = GNUNET_MAX (max_priority_added, t->priority);
   LOG (GNUNET_ERROR_TYPE_DEBUG,
        "Adding task: %llu / %p\n",
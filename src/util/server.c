@@ -27,6 +27,7 @@
 #include "platform.h"
 #include "gnunet_util_lib.h"
 #include "gnunet_protocols.h"
+#include "shm_ring.h"
 
 #define LOG(kind,...) GNUNET_log_from (kind, "util", __VA_ARGS__)
 
@@ -172,6 +173,11 @@ struct GNUNET_SERVER_Handle
    */
   int require_found;
 
+  /**
+   * Do we let clients pass messages through a shared-memory ring?
+   */
+  int shm_ring;
+
   /**
    * Set to #GNUNET_YES once we are in 'soft' shutdown where we wait for
    * all non-monitor clients to disconnect before we call
@@ -332,6 +338,17 @@ struct GNUNET_SERVER_Client
    */
   int is_monitor;
 
+  /**
+   * Are there messages left in @e ring that we did not process
+   * yet because a handler was not done?
+   */
+  int ring_pending;
+
+  /**
+   * Shared-memory ring the client passes messages through, or NULL.
+   */
+  struct GNUNET_SHM_Ring *ring;
+
   /**
    * Type of last message processed (for warn_no_receive_done).
    */
@@ -871,6 +888,22 @@ GNUNET_SERVER_set_callbacks (struct GNUNET_SERVER_Handle *server,
 }
 
 
+/**
+ * Allow clients connected over a UNIX domain socket and running as
+ * our own user to pass their messages through a shared-memory ring
+ * (see the "SHM_RING" option).
+ *
+ * @param server server to modify
+ * @param enable #GNUNET_YES to accept rings, #GNUNET_NO to refuse them
+ */
+void
+GNUNET_SERVER_enable_shm_ring (struct GNUNET_SERVER_Handle *server,
+                               int enable)
+{
+  server->shm_ring = enable;
+}
+
+
 /**
  * Task run to warn about missing calls to #GNUNET_SERVER_receive_done.
  *
@@ -1148,6 +1181,100 @@ process_incoming (void *cls, const void *buf, size_t available,
 }
 
 
+/**
+ * Dispatch the messages the client passed through its shared-memory
+ * ring until the ring is empty or a handler is not immediately done
+ * (then wait for restart_processing).
+ *
+ * @param client the client to process
+ * @return #GNUNET_OK if the ring is empty and the client will wake
+ *         us up over the socket, #GNUNET_NO if processing was
+ *         suspended, #GNUNET_SYSERR if the client must be disconnected
+ */
+static int
+process_ring (struct GNUNET_SERVER_Client *client)
+{
+  const struct GNUNET_MessageHeader *msg;
+  int ret;
+
+  client->ring_pending = GNUNET_YES;
+  while ((NULL != client->server) && (GNUNET_YES != client->shutdown_now) &&
+         (0 == client->suspended))
+  {
+    ret = GNUNET_SHM_ring_read_ (client->ring, &msg);
+    if (GNUNET_SYSERR == ret)
+      return GNUNET_SYSERR;
+    if (GNUNET_NO == ret)
+    {
+      if (GNUNET_YES != GNUNET_SHM_ring_sleep_ (client->ring))
+        continue;
+      client->ring_pending = GNUNET_NO;
+      return GNUNET_OK;
+    }
+    client->in_process_client_buffer = GNUNET_YES;
+    ret = GNUNET_SERVER_inject (client->server, client, msg);
+    client->in_process_client_buffer = GNUNET_NO;
+    if (GNUNET_OK != ret)
+      return GNUNET_SYSERR;
+  }
+  if ((NULL == client->server) || (GNUNET_YES == client->shutdown_now))
+    return GNUNET_SYSERR;
+  return GNUNET_NO;
+}
+
+
+/**
+ * The client asks us to read further messages from a shared-memory
+ * ring.  Map it, if rings are enabled and the client runs as our own
+ * user on this host (a client could crash us by truncating the ring,
+ * so we only accept rings from those who could kill us anyway).
+ *
+ * @param client the client
+ * @param message the #GNUNET_MESSAGE_TYPE_SHM_RING_OFFER message
+ * @return #GNUNET_OK on success, #GNUNET_SYSERR if the client must
+ *         be disconnected
+ */
+static int
+handle_ring_offer (struct GNUNET_SERVER_Client *client,
+                   const struct GNUNET_MessageHeader *message)
+{
+  struct GNUNET_CONNECTION_Credentials cred;
+  const char *filename;
+  uint16_t size;
+
+  size = ntohs (message->size);
+  filename = (const char *) &message[1];
+  if ((GNUNET_YES != client->server->shm_ring) ||
+      (NULL != client->ring) ||
+      (size <= sizeof (struct GNUNET_SHM_RingOfferMessage)) ||
+      ('\0' != filename[size - sizeof (struct GNUNET_SHM_RingOfferMessage) - 1]))
+  {
+    GNUNET_break_op (0);
+    return GNUNET_SYSERR;
+  }
+  if ((GNUNET_OK !=
+       GNUNET_CONNECTION_get_credentials (client->connection, &cred)) ||
+      (geteuid () != cred.uid))
+  {
+    LOG (GNUNET_ERROR_TYPE_WARNING,
+         _("Refusing shared-memory ring from a client of another user or host\n"));
+    return GNUNET_SYSERR;
+  }
+  client->ring = GNUNET_SHM_ring_attach_ (filename, cred.uid);
+  if (NULL == client->ring)
+  {
+    LOG (GNUNET_ERROR_TYPE_WARNING,
+         _("Failed to attach to shared-memory ring `%s'\n"),
+         filename);
+    return GNUNET_SYSERR;
+  }
+  LOG (GNUNET_ERROR_TYPE_DEBUG,
+       "Client passes further messages through ring `%s'\n",
+       filename);
+  return GNUNET_OK;
+}
+
+
 /**
  * Task run to start again receiving from the network
  * and process requests.
@@ -1159,9 +1286,22 @@ static void
 restart_processing (void *cls, const struct GNUNET_SCHEDULER_TaskContext *tc)
 {
   struct GNUNET_SERVER_Client *client = cls;
+  int ret;
 
   GNUNET_assert (GNUNET_YES != client->shutdown_now);
   client->restart_task = GNUNET_SCHEDULER_NO_TASK;
+  if (GNUNET_YES == client->ring_pending)
+  {
+    /* messages from the ring go first, the socket only
+       carries wakeups after them */
+    GNUNET_SERVER_client_keep (client);
+    ret = process_ring (client);
+    if (GNUNET_SYSERR == ret)
+      GNUNET_SERVER_client_disconnect (client);
+    GNUNET_SERVER_client_drop (client);
+    if (GNUNET_OK != ret)
+      return;
+  }
   if (GNUNET_NO == client->receive_pending)
   {
     LOG (GNUNET_ERROR_TYPE_DEBUG, "Server begins to read again from client.\n");
@@ -1201,9 +1341,28 @@ client_message_tokenizer_callback (void *cls, void *client,
   LOG (GNUNET_ERROR_TYPE_DEBUG,
        "Tokenizer gives server message of type %u from client\n",
        ntohs (message->type));
-  sender->in_process_client_buffer = GNUNET_YES;
-  ret = GNUNET_SERVER_inject (server, sender, message);
-  sender->in_process_client_buffer = GNUNET_NO;
+  switch (ntohs (message->type))
+  {
+  case GNUNET_MESSAGE_TYPE_SHM_RING_OFFER:
+    ret = handle_ring_offer (sender, message);
+    break;
+  case GNUNET_MESSAGE_TYPE_SHM_RING_DOORBELL:
+    if (NULL == sender->ring)
+    {
+      GNUNET_break_op (0);
+      ret = GNUNET_SYSERR;
+      break;
+    }
+    ret = process_ring (sender);
+    if (GNUNET_NO == ret)
+      ret = GNUNET_OK;          /* suspended, restart_processing continues */
+    break;
+  default:
+    sender->in_process_client_buffer = GNUNET_YES;
+    ret = GNUNET_SERVER_inject (server, sender, message);
+    sender->in_process_client_buffer = GNUNET_NO;
+    break;
+  }
   if ( (GNUNET_OK != ret) || (GNUNET_YES == sender->shutdown_now) )
   {
     GNUNET_SERVER_client_disconnect (sender);
@@ -1488,6 +1647,12 @@ GNUNET_SERVER_client_disconnect (struct GNUNET_SERVER_Client *client)
   }
   client->shutdown_now = GNUNET_YES;
   client->reference_count++; /* make sure nobody else clean up client... */
+  if (NULL != client->ring)
+  {
+    GNUNET_SHM_ring_destroy_ (client->ring);
+    client->ring = NULL;
+    client->ring_pending = GNUNET_NO;
+  }
   if ( (NULL != client->mst) &&
        (NULL != server) )
   {
@@ -1172,6 +1172,10 @@ service_task (void *cls, const struct GNUNET_SCHEDULER_TaskContext *tc)
     sctx->ret = GNUNET_SYSERR;
     return;
   }
+  if (GNUNET_YES ==
+      GNUNET_CONFIGURATION_get_value_yesno (sctx->cfg, sctx->service_name,
+                                            "SHM_RING"))
+    GNUNET_SERVER_enable_shm_ring (sctx->server, GNUNET_YES);
 #ifndef WINDOWS
   if (NULL != sctx->addrs)
     for (i = 0; NULL != sctx->addrs[i]; i++)
@@ -1495,6 +1499,7 @@ GNUNET_SERVICE_run (int argc, char *const *argv,
   }
   /* actually run service */
   err = 0;
+  (void) GNUNET_SCHEDULER_configure (sctx.cfg);
   GNUNET_SCHEDULER_run (&service_task, &sctx);
   /* shutdown */
   if ((1 == do_daemonize) && (NULL != sctx.server))
@@ -1594,6 +1599,10 @@ GNUNET_SERVICE_start (const char *service_name,
     GNUNET_SERVICE_stop (sctx);
     return NULL;
   }
+  if (GNUNET_YES ==
+      GNUNET_CONFIGURATION_get_value_yesno (sctx->cfg, sctx->service_name,
+                                            "SHM_RING"))
+    GNUNET_SERVER_enable_shm_ring (sctx->server, GNUNET_YES);
 #ifndef WINDOWS
   if (NULL != sctx->addrs)
     for (i = 0; NULL != sctx->addrs[i]; i++)
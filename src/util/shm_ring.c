@@ -0,0 +1,554 @@
+/*
+     This file is part of GNUnet.
+     (C) 2014 Christian Grothoff (and other contributing authors)
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+     Boston, MA 02111-1307, USA.
+*/
+
+/**
+ * @file util/shm_ring.c
+ * @brief single-producer/single-consumer message ring in shared memory
+ *
+ * The ring lives in a file on the tmpfs in #RING_DIR mapped by both
+ * processes.  The producer only ever advances 'head', the consumer
+ * only ever advances 'tail'; both count bytes since the start and
+ * are reduced modulo the (power of two) size of the data area.
+ * Messages are padded to 8 bytes and never wrap: if a message does
+ * not fit before the end of the data area, the producer writes a
+ * header with size zero there and continues at the start.
+ */
+#include "platform.h"
+#include "gnunet_util_lib.h"
+#include "shm_ring.h"
+
+#define LOG(kind,...) GNUNET_log_from (kind, "util", __VA_ARGS__)
+
+#define LOG_STRERROR_FILE(kind,syscall,filename) GNUNET_log_from_strerror_file (kind, "util", syscall, filename)
+
+/**
+ * Magic value at the start of a ring file ("GNRI").
+ */
+#define RING_MAGIC 0x474e5249
+
+/**
+ * Directory with the ring files.
+ */
+#define RING_DIR "/dev/shm"
+
+/**
+ * Prefix of the names of ring files.
+ */
+#define RING_PREFIX "gnunet-shm-ring"
+
+/**
+ * Largest ring we accept to map from a client.
+ */
+#define MAX_RING_SIZE (64 * 1024 * 1024)
+
+/**
+ * Round @a n up to a multiple of 8.
+ */
+#define ALIGN8(n) (((n) + 7) & ~((size_t) 7))
+
+
+/**
+ * Layout of the start of the shared mapping; producer and consumer
+ * fields are kept on separate cache lines.
+ */
+struct RingHeader
+{
+  /**
+   * #RING_MAGIC.
+   */
+  uint32_t magic;
+
+  /**
+   * Size of the data area that follows this header.
+   */
+  uint32_t size;
+
+  char pad0[56];
+
+  /**
+   * Bytes ever written by the producer.
+   */
+  volatile uint64_t head;
+
+  char pad1[56];
+
+  /**
+   * Bytes ever consumed by the consumer.
+   */
+  volatile uint64_t tail;
+
+  /**
+   * 1 if the consumer waits for a wakeup over the socket.
+   */
+  volatile uint32_t sleeping;
+
+  /**
+   * Set to 1 by the consumer once it mapped the ring, so that the
+   * producer can remove the file.
+   */
+  volatile uint32_t attached;
+
+  char pad2[48];
+};
+
+
+/**
+ * Handle to one end of a shared-memory ring.
+ */
+struct GNUNET_SHM_Ring
+{
+  /**
+   * Name of the backing file.
+   */
+  char *filename;
+
+  /**
+   * Open backing file.
+   */
+  struct GNUNET_DISK_FileHandle *fh;
+
+  /**
+   * Mapping of the backing file.
+   */
+  struct GNUNET_DISK_MapHandle *map;
+
+  /**
+   * Shared header at the start of the mapping.
+   */
+  struct RingHeader *hdr;
+
+  /**
+   * Data area after the header.
+   */
+  char *data;
+
+  /**
+   * Consumer: private copy of the message being processed.
+   */
+  char *buf;
+
+  /**
+   * Our private copy of our own position (head for the producer,
+   * tail for the consumer).
+   */
+  uint64_t pos;
+
+  /**
+   * Last seen value of the other side's position.
+   */
+  uint64_t other;
+
+  /**
+   * Size of the data area.
+   */
+  uint32_t size;
+
+  /**
+   * #GNUNET_YES if we created (and hence must unlink) the file.
+   */
+  int is_producer;
+
+  /**
+   * #GNUNET_YES if the producer removed the file already.
+   */
+  int unlinked;
+};
+
+
+/**
+ * Map an open ring file.
+ *
+ * @param fh the open file, closed on error
+ * @param filename name of the file, for logging
+ * @param len number of bytes to map
+ * @return NULL on error
+ */
+static struct GNUNET_SHM_Ring *
+map_ring (struct GNUNET_DISK_FileHandle *fh,
+          const char *filename,
+          size_t len)
+{
+  struct GNUNET_SHM_Ring *ring;
+
+  ring = GNUNET_new (struct GNUNET_SHM_Ring);
+  ring->fh = fh;
+  ring->hdr = GNUNET_DISK_file_map (ring->fh,
+                                    &ring->map,
+                                    GNUNET_DISK_MAP_TYPE_READWRITE,
+                                    len);
+  if (NULL == ring->hdr)
+  {
+    LOG_STRERROR_FILE (GNUNET_ERROR_TYPE_WARNING, "mmap", filename);
+    GNUNET_break (GNUNET_OK == GNUNET_DISK_file_close (ring->fh));
+    GNUNET_free (ring);
+    return NULL;
+  }
+  ring->data = (char *) &ring->hdr[1];
+  ring->filename = GNUNET_strdup (filename);
+  return ring;
+}
+
+
+/**
+ * Create a ring as the producer.  The ring starts out with the
+ * consumer asleep, so the first write needs a wakeup.
+ *
+ * @param size number of bytes in the data area, a power of two
+ * @return NULL on error
+ */
+struct GNUNET_SHM_Ring *
+GNUNET_SHM_ring_create_ (size_t size)
+{
+  struct GNUNET_SHM_Ring *ring;
+  struct GNUNET_DISK_FileHandle *fh;
+  char *fn;
+  char zero;
+  size_t len;
+
+  GNUNET_assert (0 == (size & (size - 1)));
+  GNUNET_assert (size <= MAX_RING_SIZE);
+  /* the ring must never hit the disk, and the consumer only
+     accepts rings from this directory */
+  if (GNUNET_YES != GNUNET_DISK_directory_test (RING_DIR, GNUNET_YES))
+    return NULL;
+  fn = GNUNET_DISK_mktemp (RING_DIR "/" RING_PREFIX);
+  if (NULL == fn)
+    return NULL;
+  len = sizeof (struct RingHeader) + size;
+  zero = 0;
+  fh = GNUNET_DISK_file_open (fn,
+                              GNUNET_DISK_OPEN_READWRITE,
+                              GNUNET_DISK_PERM_NONE);
+  if ( (NULL == fh) ||
+       ((off_t) (len - 1) !=
+        GNUNET_DISK_file_seek (fh, len - 1, GNUNET_DISK_SEEK_SET)) ||
+       (1 != GNUNET_DISK_file_write (fh, &zero, 1)) )
+  {
+    LOG_STRERROR_FILE (GNUNET_ERROR_TYPE_WARNING, "write", fn);
+    if (NULL != fh)
+      GNUNET_break (GNUNET_OK == GNUNET_DISK_file_close (fh));
+    if (0 != UNLINK (fn))
+      LOG_STRERROR_FILE (GNUNET_ERROR_TYPE_WARNING, "unlink", fn);
+    GNUNET_free (fn);
+    return NULL;
+  }
+  ring = map_ring (fh, fn, len);
+  if (NULL == ring)
+  {
+    if (0 != UNLINK (fn))
+      LOG_STRERROR_FILE (GNUNET_ERROR_TYPE_WARNING, "unlink", fn);
+    GNUNET_free (fn);
+    return NULL;
+  }
+  GNUNET_free (fn);
+  ring->is_producer = GNUNET_YES;
+  ring->size = size;
+  ring->hdr->size = size;
+  ring->hdr->head = 0;
+  ring->hdr->tail = 0;
+  ring->hdr->sleeping = 1;
+  __sync_synchronize ();
+  ring->hdr->magic = RING_MAGIC;
+  return ring;
+}
+
+
+/**
+ * Attach to a ring created by another process as the consumer.
+ * Only regular files in #RING_DIR with a name starting with
+ * #RING_PREFIX owned by @a uid are accepted.  The file is not
+ * removed, the producer does that once it sees we are attached.
+ *
+ * @param name name of the file backing the ring, without directory
+ * @param uid user that must own the file
+ * @return NULL if @a name is not a valid ring
+ */
+struct GNUNET_SHM_Ring *
+GNUNET_SHM_ring_attach_ (const char *name,
+                         uid_t uid)
+{
+#ifdef O_NOFOLLOW
+  struct GNUNET_SHM_Ring *ring;
+  struct GNUNET_DISK_FileHandle *fh;
+  struct stat st;
+  char *fn;
+  uint32_t size;
+  int fd;
+
+  if ( (0 != strncmp (name, RING_PREFIX, strlen (RING_PREFIX))) ||
+       (NULL != strchr (name, '/')) )
+  {
+    GNUNET_break_op (0);
+    return NULL;
+  }
+  GNUNET_asprintf (&fn, "%s/%s", RING_DIR, name);
+  /* do not follow links, the file must be the one the client made */
+  fd = open (fn, O_RDWR | O_NOFOLLOW);
+  if (-1 == fd)
+  {
+    LOG_STRERROR_FILE (GNUNET_ERROR_TYPE_WARNING, "open", fn);
+    GNUNET_free (fn);
+    return NULL;
+  }
+  if ( (0 != fstat (fd, &st)) ||
+       (! S_ISREG (st.st_mode)) ||
+       (uid != st.st_uid) ||
+       (st.st_size <= sizeof (struct RingHeader)) ||
+       (st.st_size > sizeof (struct RingHeader) + MAX_RING_SIZE) ||
+       (NULL == (fh = GNUNET_DISK_get_handle_from_int_fd (fd))) )
+  {
+    GNUNET_break_op (0);
+    GNUNET_break (0 == close (fd));
+    GNUNET_free (fn);
+    return NULL;
+  }
+  ring = map_ring (fh, fn, st.st_size);
+  GNUNET_free (fn);
+  if (NULL == ring)
+    return NULL;
+  size = ring->hdr->size;
+  if ( (RING_MAGIC != ring->hdr->magic) ||
+       (size < GNUNET_SERVER_MAX_MESSAGE_SIZE) ||
+       (0 != (size & (size - 1))) ||
+       (sizeof (struct RingHeader) + size != st.st_size) )
+  {
+    GNUNET_break_op (0);
+    GNUNET_SHM_ring_destroy_ (ring);
+    return NULL;
+  }
+  ring->size = size;
+  ring->pos = ring->hdr->tail;
+  ring->buf = GNUNET_malloc (GNUNET_SERVER_MAX_MESSAGE_SIZE);
+  __sync_synchronize ();
+  ring->hdr->attached = 1;
+  return ring;
+#else
+  return NULL;
+#endif
+}
+
+
+/**
+ * Get the name of the file backing a ring we created, without the
+ * directory, as the consumer expects it in #GNUNET_SHM_ring_attach_().
+ *
+ * @param ring the ring
+ * @return file name
+ */
+const char *
+GNUNET_SHM_ring_get_name_ (const struct GNUNET_SHM_Ring *ring)
+{
+  const char *slash;
+
+  slash = strrchr (ring->filename, '/');
+  return (NULL == slash) ? ring->filename : &slash[1];
+}
+
+
+/**
+ * Remove the file backing the ring once the consumer attached to
+ * it (producer only).  Cheap enough to call after every write.
+ *
+ * @param ring the ring
+ */
+void
+GNUNET_SHM_ring_unlink_attached_ (struct GNUNET_SHM_Ring *ring)
+{
+  if ( (GNUNET_YES == ring->unlinked) ||
+       (1 != ring->hdr->attached) )
+    return;
+  ring->unlinked = GNUNET_YES;
+  if (0 != UNLINK (ring->filename))
+    LOG_STRERROR_FILE (GNUNET_ERROR_TYPE_WARNING, "unlink", ring->filename);
+}
+
+
+/**
+ * Unmap a ring (and remove its file if we created it).
+ *
+ * @param ring ring to destroy
+ */
+void
+GNUNET_SHM_ring_destroy_ (struct GNUNET_SHM_Ring *ring)
+{
+  if (GNUNET_OK != GNUNET_DISK_file_unmap (ring->map))
+    LOG_STRERROR_FILE (GNUNET_ERROR_TYPE_WARNING, "munmap", ring->filename);
+  GNUNET_break (GNUNET_OK == GNUNET_DISK_file_close (ring->fh));
+  if ( (GNUNET_YES == ring->is_producer) &&
+       (GNUNET_YES != ring->unlinked) &&
+       (0 != UNLINK (ring->filename)) )
+    LOG_STRERROR_FILE (GNUNET_ERROR_TYPE_WARNING, "unlink", ring->filename);
+  GNUNET_free_non_null (ring->buf);
+  GNUNET_free (ring->filename);
+  GNUNET_free (ring);
+}
+
+
+/**
+ * Append a message to the ring (producer only).
+ *
+ * @param ring the ring
+ * @param msg message to append
+ * @return #GNUNET_OK on success, #GNUNET_NO if the ring is full
+ */
+int
+GNUNET_SHM_ring_write_ (struct GNUNET_SHM_Ring *ring,
+                        const struct GNUNET_MessageHeader *msg)
+{
+  struct GNUNET_MessageHeader *skip;
+  size_t msize;
+  size_t need;
+  size_t off;
+  size_t contig;
+  size_t total;
+
+  msize = ntohs (msg->size);
+  need = ALIGN8 (msize);
+  off = ring->pos & (ring->size - 1);
+  contig = ring->size - off;
+  total = (need > contig) ? contig + need : need;
+  if (ring->size - (ring->pos - ring->other) < total)
+  {
+    /* only look at the consumer's position if we seem full */
+    ring->other = ring->hdr->tail;
+    __sync_synchronize ();
+    if (ring->size - (ring->pos - ring->other) < total)
+      return GNUNET_NO;
+  }
+  if (need > contig)
+  {
+    skip = (struct GNUNET_MessageHeader *) &ring->data[off];
+    skip->size = htons (0);
+    skip->type = htons (0);
+    ring->pos += contig;
+    off = 0;
+  }
+  memcpy (&ring->data[off], msg, msize);
+  ring->pos += need;
+  /* publish the message only after it was written */
+  __sync_synchronize ();
+  ring->hdr->head = ring->pos;
+  return GNUNET_OK;
+}
+
+
+/**
+ * Check if the consumer went to sleep and must be woken up over
+ * the socket (producer only, after writing).  Only the first
+ * caller after the consumer fell asleep gets #GNUNET_YES.
+ *
+ * @param ring the ring
+ * @return #GNUNET_YES if the caller must wake up the consumer
+ */
+int
+GNUNET_SHM_ring_wake_ (struct GNUNET_SHM_Ring *ring)
+{
+  /* full barrier: the consumer must either see our new head
+     or we must see it asleep */
+  __sync_synchronize ();
+  if (1 == __sync_val_compare_and_swap (&ring->hdr->sleeping, 1, 0))
+    return GNUNET_YES;
+  return GNUNET_NO;
+}
+
+
+/**
+ * Take the next message from the ring (consumer only).  The
+ * message is copied out of the shared memory, so the producer
+ * cannot change it while it is being processed.
+ *
+ * @param ring the ring
+ * @param[out] msg set to the message, valid until the next read
+ * @return #GNUNET_OK if a message was read, #GNUNET_NO if the
+ *         ring is empty, #GNUNET_SYSERR if the ring is corrupt
+ */
+int
+GNUNET_SHM_ring_read_ (struct GNUNET_SHM_Ring *ring,
+                       const struct GNUNET_MessageHeader **msg)
+{
+  struct GNUNET_MessageHeader *hdr;
+  size_t off;
+  size_t msize;
+
+  while (1)
+  {
+    if (ring->pos == ring->other)
+    {
+      ring->other = ring->hdr->head;
+      __sync_synchronize ();
+      if (ring->pos == ring->other)
+        return GNUNET_NO;
+    }
+    if (ring->other - ring->pos > ring->size)
+    {
+      GNUNET_break_op (0);
+      return GNUNET_SYSERR;
+    }
+    off = ring->pos & (ring->size - 1);
+    hdr = (struct GNUNET_MessageHeader *) &ring->data[off];
+    msize = ntohs (hdr->size);
+    if (0 != msize)
+      break;
+    /* skip to the start of the data area */
+    ring->pos += ring->size - off;
+  }
+  if ( (msize < sizeof (struct GNUNET_MessageHeader)) ||
+       (ALIGN8 (msize) > ring->size - off) ||
+       (ALIGN8 (msize) > ring->other - ring->pos) )
+  {
+    GNUNET_break_op (0);
+    return GNUNET_SYSERR;
+  }
+  memcpy (ring->buf, hdr, msize);
+  /* the producer may have changed the size meanwhile */
+  ((struct GNUNET_MessageHeader *) ring->buf)->size = htons (msize);
+  ring->pos += ALIGN8 (msize);
+  __sync_synchronize ();
+  ring->hdr->tail = ring->pos;
+  *msg = (const struct GNUNET_MessageHeader *) ring->buf;
+  return GNUNET_OK;
+}
+
+
+/**
+ * Go to sleep after the ring was found empty (consumer only).
+ * The producer will send a wakeup for the next message.
+ *
+ * @param ring the ring
+ * @return #GNUNET_YES if we are asleep, #GNUNET_NO if messages
+ *         arrived in the meantime and we should continue reading
+ */
+int
+GNUNET_SHM_ring_sleep_ (struct GNUNET_SHM_Ring *ring)
+{
+  ring->hdr->sleeping = 1;
+  /* full barrier: the producer must either see us asleep or we
+     must see its new head */
+  __sync_synchronize ();
+  if (ring->pos == ring->hdr->head)
+    return GNUNET_YES;
+  /* if the producer already claimed the wakeup, the extra one
+     will simply find the ring empty */
+  (void) __sync_val_compare_and_swap (&ring->hdr->sleeping, 1, 0);
+  return GNUNET_NO;
+}
+
+
+/* end of shm_ring.c */
@@ -0,0 +1,172 @@
+/*
+     This file is part of GNUnet.
+     (C) 2014 Christian Grothoff (and other contributing authors)
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+     Boston, MA 02111-1307, USA.
+*/
+
+/**
+ * @file util/shm_ring.h
+ * @brief internal single-producer/single-consumer message ring in
+ *        shared memory, used between clients and co-located services
+ */
+#ifndef SHM_RING_H_
+#define SHM_RING_H_
+
+#include "gnunet_util_lib.h"
+
+/**
+ * Default size of the data area of a ring (must be a power of two).
+ */
+#define GNUNET_SHM_RING_SIZE (1024 * 1024)
+
+
+/**
+ * Handle to one end of a shared-memory ring.
+ */
+struct GNUNET_SHM_Ring;
+
+
+GNUNET_NETWORK_STRUCT_BEGIN
+
+/**
+ * Message sent by a client over the socket to ask the service to
+ * read all further messages from a shared-memory ring.  The service
+ * acknowledges by marking the ring as attached.
+ */
+struct GNUNET_SHM_RingOfferMessage
+{
+  /**
+   * Type is #GNUNET_MESSAGE_TYPE_SHM_RING_OFFER.
+   */
+  struct GNUNET_MessageHeader header;
+
+  /* followed by 0-terminated name of the file backing the ring,
+     without the directory */
+};
+
+GNUNET_NETWORK_STRUCT_END
+
+
+/**
+ * Create a ring as the producer.  The ring starts out with the
+ * consumer asleep, so the first write needs a wakeup.
+ *
+ * @param size number of bytes in the data area, a power of two
+ * @return NULL on error
+ */
+struct GNUNET_SHM_Ring *
+GNUNET_SHM_ring_create_ (size_t size);
+
+
+/**
+ * Attach to a ring created by another process as the consumer.
+ * Only rings created by #GNUNET_SHM_ring_create_() and owned by
+ * @a uid are accepted.  Marks the ring as attached, so that the
+ * producer removes the backing file.
+ *
+ * @param name name of the file backing the ring, as returned by
+ *        #GNUNET_SHM_ring_get_name_()
+ * @param uid user that must own the file
+ * @return NULL if @a name is not a valid ring
+ */
+struct GNUNET_SHM_Ring *
+GNUNET_SHM_ring_attach_ (const char *name,
+                         uid_t uid);
+
+
+/**
+ * Get the name of the file backing a ring we created, without the
+ * directory, as the consumer expects it in #GNUNET_SHM_ring_attach_().
+ *
+ * @param ring the ring
+ * @return file name
+ */
+const char *
+GNUNET_SHM_ring_get_name_ (const struct GNUNET_SHM_Ring *ring);
+
+
+/**
+ * Remove the file backing the ring once the consumer attached to
+ * it (producer only).  Cheap enough to call after every write.
+ *
+ * @param ring the ring
+ */
+void
+GNUNET_SHM_ring_unlink_attached_ (struct GNUNET_SHM_Ring *ring);
+
+
+/**
+ * Unmap a ring (and remove its file if we created it).
+ *
+ * @param ring ring to destroy
+ */
+void
+GNUNET_SHM_ring_destroy_ (struct GNUNET_SHM_Ring *ring);
+
+
+/**
+ * Append a message to the ring (producer only).
+ *
+ * @param ring the ring
+ * @param msg message to append
+ * @return #GNUNET_OK on success, #GNUNET_NO if the ring is full
+ */
+int
+GNUNET_SHM_ring_write_ (struct GNUNET_SHM_Ring *ring,
+                        const struct GNUNET_MessageHeader *msg);
+
+
+/**
+ * Check if the consumer went to sleep and must be woken up over
+ * the socket (producer only, after writing).  Only the first
+ * caller after the consumer fell asleep gets #GNUNET_YES.
+ *
+ * @param ring the ring
+ * @return #GNUNET_YES if the caller must wake up the consumer
+ */
+int
+GNUNET_SHM_ring_wake_ (struct GNUNET_SHM_Ring *ring);
+
+
+/**
+ * Take the next message from the ring (consumer only).  The
+ * message is copied out of the shared memory, so the producer
+ * cannot change it while it is being processed.
+ *
+ * @param ring the ring
+ * @param[out] msg set to the message, valid until the next read
+ * @return #GNUNET_OK if a message was read, #GNUNET_NO if the
+ *         ring is empty, #GNUNET_SYSERR if the ring is corrupt
+ */
+int
+GNUNET_SHM_ring_read_ (struct GNUNET_SHM_Ring *ring,
+                       const struct GNUNET_MessageHeader **msg);
+
+
+/**
+ * Go to sleep after the ring was found empty (consumer only).
+ * The producer will send a wakeup for the next message.
+ *
+ * @param ring the ring
+ * @return #GNUNET_YES if we are asleep, #GNUNET_NO if messages
+ *         arrived in the meantime and we should continue reading
+ */
+int
+GNUNET_SHM_ring_sleep_ (struct GNUNET_SHM_Ring *ring);
+
+
+#endif  /* SHM_RING_H_ */
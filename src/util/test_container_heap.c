@@ -34,6 +34,82 @@ iterator_callback (void *cls, struct GNUNET_CONTAINER_HeapNode *node,
   return GNUNET_OK;
 }
 
+#define NUM_ITERATE 100
+
+static struct GNUNET_CONTAINER_HeapNode *iterate_nodes[NUM_ITERATE];
+
+static unsigned int iterate_visits[NUM_ITERATE];
+
+/**
+ * Remove every even node when visiting it, and the node after each
+ * odd node when visiting the odd node.  Also move some odd nodes
+ * (visited or not) to the root by lowering their cost.
+ */
+static int
+removing_iterator (void *cls, struct GNUNET_CONTAINER_HeapNode *node,
+                   void *element, GNUNET_CONTAINER_HeapCostType cost)
+{
+  struct GNUNET_CONTAINER_Heap *heap = cls;
+  unsigned int i = (unsigned int *) element - iterate_visits;
+
+  GNUNET_assert (node == iterate_nodes[i]);
+  iterate_visits[i]++;
+  if (0 == i % 2)
+  {
+    GNUNET_CONTAINER_heap_remove_node (node);
+    iterate_nodes[i] = NULL;
+  }
+  else if ( (i + 1 < NUM_ITERATE) &&
+            (NULL != iterate_nodes[i + 1]) )
+  {
+    GNUNET_CONTAINER_heap_remove_node (iterate_nodes[i + 1]);
+    iterate_nodes[i + 1] = NULL;
+    if (1 == i % 4)
+      GNUNET_CONTAINER_heap_update_cost (heap, node, 0);
+    else if ( (i + 2 < NUM_ITERATE) &&
+              (NULL != iterate_nodes[i + 2]) )
+      GNUNET_CONTAINER_heap_update_cost (heap, iterate_nodes[i + 2], 0);
+  }
+  return GNUNET_OK;
+}
+
+static int
+check_iterate_remove ()
+{
+  struct GNUNET_CONTAINER_Heap *heap;
+  GNUNET_CONTAINER_HeapCostType last;
+  GNUNET_CONTAINER_HeapCostType cost;
+  unsigned int i;
+
+  heap = GNUNET_CONTAINER_heap_create (GNUNET_CONTAINER_HEAP_ORDER_MIN);
+  for (i = 0; i < NUM_ITERATE; i++)
+    iterate_nodes[i] = GNUNET_CONTAINER_heap_insert (heap, &iterate_visits[i],
+                                                     (i * 37) % 101);
+  GNUNET_CONTAINER_heap_iterate (heap, &removing_iterator, heap);
+  for (i = 0; i < NUM_ITERATE; i++)
+  {
+    /* removed nodes are not visited, all others exactly once */
+    if (iterate_visits[i] > 1)
+      return 1;
+    if ( (NULL != iterate_nodes[i]) &&
+         (1 != iterate_visits[i]) )
+      return 1;
+  }
+  /* the heap is still in order */
+  last = 0;
+  while (0 < GNUNET_CONTAINER_heap_get_size (heap))
+  {
+    GNUNET_assert (GNUNET_YES ==
+                   GNUNET_CONTAINER_heap_peek2 (heap, NULL, &cost));
+    if (cost < last)
+      return 1;
+    last = cost;
+    GNUNET_CONTAINER_heap_remove_root (heap);
+  }
+  GNUNET_CONTAINER_heap_destroy (heap);
+  return 0;
+}
+
 static int
 nstrcmp (const char *a, const char *b)
 {
@@ -283,6 +359,8 @@ int
 main (int argc, char **argv)
 {
   GNUNET_log_setup ("test-container-heap", "WARNING", NULL);
+  if (0 != check_iterate_remove ())
+    return 1;
   return check ();
 }
 
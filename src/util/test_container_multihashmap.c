@@ -30,8 +30,24 @@
 #define ABORT() { fprintf(stderr, "Error at %s:%d\n", __FILE__, __LINE__); if (m != NULL) GNUNET_CONTAINER_multihashmap_destroy(m); return 1; }
 #define CHECK(c) { if (! (c)) ABORT(); }
 
+/**
+ * Remove each entry we visit from the map given in @a cls.
+ */
+static int
+remove_it (void *cls,
+           const struct GNUNET_HashCode *key,
+           void *value)
+{
+  struct GNUNET_CONTAINER_MultiHashMap *m = cls;
+
+  GNUNET_assert (GNUNET_YES ==
+                 GNUNET_CONTAINER_multihashmap_remove (m, key, value));
+  return GNUNET_OK;
+}
+
+
 static int
-testMap (int i)
+testMap (int i, int flat)
 {
   struct GNUNET_CONTAINER_MultiHashMap *m;
   struct GNUNET_HashCode k1;
@@ -41,7 +57,10 @@ testMap (int i)
   const char *ret;
   int j;
 
-  CHECK (NULL != (m = GNUNET_CONTAINER_multihashmap_create (i, GNUNET_NO)));
+  m = (GNUNET_YES == flat)
+    ? GNUNET_CONTAINER_multihashmap_create_flat (i)
+    : GNUNET_CONTAINER_multihashmap_create (i, GNUNET_NO);
+  CHECK (NULL != m);
   memset (&k1, 0, sizeof (k1));
   memset (&k2, 1, sizeof (k2));
   CHECK (GNUNET_NO == GNUNET_CONTAINER_multihashmap_contains (m, &k1));
@@ -99,6 +118,41 @@ testMap (int i)
   CHECK (GNUNET_NO == GNUNET_CONTAINER_multihashmap_iterator_next (iter, NULL, NULL));
   GNUNET_free (iter);
 
+  /* removing entries while iterating must visit each entry once */
+  for (j = 0; j < 64; j++)
+  {
+    k2.bits[0] = j;
+    CHECK (GNUNET_OK ==
+           GNUNET_CONTAINER_multihashmap_put (m, &k2, "v4",
+                                              GNUNET_CONTAINER_MULTIHASHMAPOPTION_MULTIPLE));
+  }
+  CHECK (1024 == GNUNET_CONTAINER_multihashmap_get_multiple (m, &k1, &remove_it, m));
+  CHECK (64 == GNUNET_CONTAINER_multihashmap_size (m));
+  CHECK (64 == GNUNET_CONTAINER_multihashmap_iterate (m, &remove_it, m));
+  CHECK (0 == GNUNET_CONTAINER_multihashmap_size (m));
+  CHECK (0 == GNUNET_CONTAINER_multihashmap_iterate (m, NULL, NULL));
+
+  /* a single removal while iterating must not leave anything visible */
+  for (j = 0; j < 64; j++)
+  {
+    k2.bits[0] = j;
+    CHECK (GNUNET_OK ==
+           GNUNET_CONTAINER_multihashmap_put (m, &k2, "v4",
+                                              GNUNET_CONTAINER_MULTIHASHMAPOPTION_MULTIPLE));
+  }
+  k2.bits[0] = 7;
+  CHECK (1 == GNUNET_CONTAINER_multihashmap_get_multiple (m, &k2, &remove_it, m));
+  CHECK (GNUNET_NO == GNUNET_CONTAINER_multihashmap_contains (m, &k2));
+  CHECK (63 == GNUNET_CONTAINER_multihashmap_size (m));
+  CHECK (63 == GNUNET_CONTAINER_multihashmap_iterate (m, NULL, NULL));
+  k2.bits[0] = 8;
+  CHECK (GNUNET_YES == GNUNET_CONTAINER_multihashmap_remove (m, &k2, "v4"));
+  k2.bits[0] = 9;
+  CHECK (GNUNET_YES == GNUNET_CONTAINER_multihashmap_contains (m, &k2));
+  CHECK (62 == GNUNET_CONTAINER_multihashmap_iterate (m, &remove_it, m));
+  CHECK (0 == GNUNET_CONTAINER_multihashmap_size (m));
+  CHECK (0 == GNUNET_CONTAINER_multihashmap_iterate (m, NULL, NULL));
+
   GNUNET_CONTAINER_multihashmap_destroy (m);
   return 0;
 }
@@ -111,7 +165,10 @@ main (int argc, char *argv[])
 
   GNUNET_log_setup ("test-container-multihashmap", "WARNING", NULL);
   for (i = 1; i < 255; i++)
-    failureCount += testMap (i);
+  {
+    failureCount += testMap (i, GNUNET_NO);
+    failureCount += testMap (i, GNUNET_YES);
+  }
   if (failureCount != 0)
     return 1;
   return 0;
@@ -0,0 +1,170 @@
+/*
+     This file is part of GNUnet.
+     (C) 2014 Christian Grothoff (and other contributing authors)
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+     Boston, MA 02111-1307, USA.
+*/
+
+/**
+ * @file util/test_crypto_pow.c
+ * @brief Test for crypto_pow.c
+ */
+#include "platform.h"
+#include "gnunet_util_lib.h"
+
+#define SALT "gnunet-test-proof-of-work"
+
+#define BITS 8
+
+static struct GNUNET_CRYPTO_PowSearch *ps;
+
+static GNUNET_SCHEDULER_TaskIdentifier timeout_task;
+
+static char data[32];
+
+static uint64_t resume;
+
+static int ok = 1;
+
+
+/**
+ * Check if @a pow is a proof of work for #data.
+ *
+ * @param pow value to check
+ * @return number of leading zero bits of the hash
+ */
+static unsigned int
+check_pow (uint64_t pow)
+{
+  char buf[sizeof (uint64_t) + sizeof (data)];
+  struct GNUNET_HashCode result;
+
+  memcpy (buf, &pow, sizeof (pow));
+  memcpy (&buf[sizeof (pow)], data, sizeof (data));
+  GNUNET_CRYPTO_pow_hash (SALT, buf, sizeof (buf), &result);
+  return GNUNET_CRYPTO_hash_count_leading_zeros (&result);
+}
+
+
+static int
+test_leading_zeros ()
+{
+  struct GNUNET_HashCode hc;
+  unsigned int i;
+  unsigned int bits;
+
+  for (i = 0; i < 1000; i++)
+  {
+    GNUNET_CRYPTO_hash (&i, sizeof (i), &hc);
+    /* force some leading zeros */
+    memset (&hc, 0, i % 4);
+    ((unsigned char *) &hc)[i % 4] &= (unsigned char) (0xFF << (i % 8));
+    bits = 0;
+    while (0 == GNUNET_CRYPTO_hash_get_bit (&hc, bits))
+      bits++;
+    if (bits != GNUNET_CRYPTO_hash_count_leading_zeros (&hc))
+      return 1;
+  }
+  memset (&hc, 0, sizeof (hc));
+  if (8 * sizeof (hc) != GNUNET_CRYPTO_hash_count_leading_zeros (&hc))
+    return 1;
+  return 0;
+}
+
+
+static void
+do_timeout (void *cls,
+            const struct GNUNET_SCHEDULER_TaskContext *tc)
+{
+  timeout_task = GNUNET_SCHEDULER_NO_TASK;
+  FPRINTF (stderr, "%s", "Timeout searching for proof of work\n");
+  if (NULL != ps)
+  {
+    (void) GNUNET_CRYPTO_pow_search_stop (ps);
+    ps = NULL;
+  }
+}
+
+
+static void
+search_cb (void *cls,
+           uint64_t pow,
+           uint64_t hash_rate,
+           int found)
+{
+  if (GNUNET_YES != found)
+    return;
+  ps = NULL;
+  GNUNET_SCHEDULER_cancel (timeout_task);
+  timeout_task = GNUNET_SCHEDULER_NO_TASK;
+  if (pow < resume)
+  {
+    FPRINTF (stderr, "Proof %llu is below start %llu\n",
+             (unsigned long long) pow,
+             (unsigned long long) resume);
+    return;
+  }
+  if (BITS > check_pow (pow))
+  {
+    FPRINTF (stderr, "Value %llu is not a proof of work\n",
+             (unsigned long long) pow);
+    return;
+  }
+  ok = 0;
+}
+
+
+static void
+run (void *cls,
+     const struct GNUNET_SCHEDULER_TaskContext *tc)
+{
+  unsigned int threads = (unsigned int) (uintptr_t) cls;
+
+  timeout_task = GNUNET_SCHEDULER_add_delayed (GNUNET_TIME_UNIT_MINUTES,
+                                               &do_timeout, NULL);
+  /* stop a search right away; we must be able to resume where it ended */
+  ps = GNUNET_CRYPTO_pow_search_start (SALT, data, sizeof (data),
+                                       0, 8 * sizeof (struct GNUNET_HashCode),
+                                       threads, GNUNET_TIME_UNIT_ZERO,
+                                       GNUNET_TIME_UNIT_SECONDS,
+                                       &search_cb, NULL);
+  resume = GNUNET_CRYPTO_pow_search_stop (ps);
+  ps = GNUNET_CRYPTO_pow_search_start (SALT, data, sizeof (data),
+                                       resume, BITS,
+                                       threads, GNUNET_TIME_UNIT_ZERO,
+                                       GNUNET_TIME_UNIT_SECONDS,
+                                       &search_cb, NULL);
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  int failures;
+
+  GNUNET_log_setup ("test-crypto-pow", "WARNING", NULL);
+  GNUNET_CRYPTO_random_block (GNUNET_CRYPTO_QUALITY_WEAK, data, sizeof (data));
+  failures = test_leading_zeros ();
+  ok = 1;
+  GNUNET_SCHEDULER_run (&run, (void *) (uintptr_t) 1);
+  failures += ok;
+  ok = 1;
+  GNUNET_SCHEDULER_run (&run, (void *) (uintptr_t) 4);
+  failures += ok;
+  return (0 == failures) ? 0 : 1;
+}
+
+/* end of test_crypto_pow.c */
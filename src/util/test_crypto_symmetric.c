@@ -149,6 +149,54 @@ error:
 }
 
 
+static int
+testContext ()
+{
+  struct GNUNET_CRYPTO_SymmetricSessionKey key;
+  struct GNUNET_CRYPTO_SymmetricInitializationVector iv;
+  struct GNUNET_CRYPTO_SymmetricContext *ctx;
+  char plain[1000];
+  char expect[sizeof (plain)];
+  char buf[sizeof (plain)];
+  unsigned int i;
+  int ret;
+
+  ret = 0;
+  GNUNET_CRYPTO_symmetric_create_session_key (&key);
+  GNUNET_CRYPTO_random_block (GNUNET_CRYPTO_QUALITY_WEAK, plain, sizeof (plain));
+  ctx = GNUNET_CRYPTO_symmetric_context_create (&key);
+  for (i = 0; i < 16; i++)
+  {
+    /* the IV must be reset on every call */
+    memset (&iv, (int) i, sizeof (iv));
+    GNUNET_CRYPTO_symmetric_encrypt (plain, sizeof (plain) - i, &key, &iv,
+                                     expect);
+    memcpy (buf, plain, sizeof (plain));
+    if ( (sizeof (plain) - i !=
+          GNUNET_CRYPTO_symmetric_context_encrypt (ctx, buf, sizeof (plain) - i,
+                                                   &iv, buf)) ||
+         (0 != memcmp (buf, expect, sizeof (plain) - i)) )
+    {
+      printf ("Context encryption differs from one-shot encryption.\n");
+      ret = 1;
+      break;
+    }
+    if ( (sizeof (plain) - i !=
+          GNUNET_CRYPTO_symmetric_context_decrypt (ctx, expect,
+                                                   sizeof (plain) - i,
+                                                   &iv, buf)) ||
+         (0 != memcmp (buf, plain, sizeof (plain) - i)) )
+    {
+      printf ("Context decryption does not match input.\n");
+      ret = 1;
+      break;
+    }
+  }
+  GNUNET_CRYPTO_symmetric_context_destroy (ctx);
+  return ret;
+}
+
+
 int
 main (int argc, char *argv[])
 {
@@ -159,6 +207,7 @@ main (int argc, char *argv[])
                  sizeof (struct GNUNET_CRYPTO_SymmetricInitializationVector));
   failureCount += testSymcipher ();
   failureCount += verifyCrypto ();
+  failureCount += testContext ();
 
   if (failureCount != 0)
   {
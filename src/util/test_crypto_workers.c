@@ -0,0 +1,166 @@
+/*
+     This file is part of GNUnet.
+     (C) 2014 Christian Grothoff (and other contributing authors)
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+     Boston, MA 02111-1307, USA.
+*/
+
+/**
+ * @file util/test_crypto_workers.c
+ * @brief Test for crypto_workers.c
+ */
+#include "platform.h"
+#include "gnunet_util_lib.h"
+#include "gnunet_signatures.h"
+
+#define NUM_JOBS 64
+
+/**
+ * A signature to verify.
+ */
+struct Job
+{
+  struct GNUNET_CRYPTO_EccSignaturePurpose purpose;
+
+  struct GNUNET_CRYPTO_EddsaSignature sig;
+
+  struct GNUNET_CRYPTO_WorkerJob *job;
+
+  unsigned int done;
+};
+
+
+static struct GNUNET_CRYPTO_EddsaPrivateKey *key;
+
+static struct GNUNET_CRYPTO_EddsaPublicKey pkey;
+
+static struct GNUNET_CRYPTO_WorkerPool *pool;
+
+static struct Job jobs[NUM_JOBS];
+
+static unsigned int remaining;
+
+static int ok;
+
+
+static int
+verify_job (void *cls)
+{
+  struct Job *j = cls;
+
+  return GNUNET_CRYPTO_eddsa_verify (GNUNET_SIGNATURE_PURPOSE_TEST,
+                                     &j->purpose, &j->sig, &pkey);
+}
+
+
+static void
+job_done (void *cls,
+          int result)
+{
+  struct Job *j = cls;
+  unsigned int i = j - jobs;
+
+  /* cancelling the job from its own continuation has no effect */
+  if (0 == i % 5)
+    GNUNET_CRYPTO_worker_job_cancel (j->job);
+  j->job = NULL;
+  j->done++;
+  /* every 4th signature was corrupted */
+  if (result != ((0 == i % 4) ? GNUNET_SYSERR : GNUNET_OK))
+  {
+    FPRINTF (stderr, "Wrong result %d for job %u\n", result, i);
+    ok = 1;
+  }
+  if (0 == --remaining)
+  {
+    /* destroying the pool from a continuation must be safe */
+    GNUNET_CRYPTO_worker_pool_destroy (pool);
+    pool = NULL;
+  }
+}
+
+
+static void
+run (void *cls,
+     const struct GNUNET_SCHEDULER_TaskContext *tc)
+{
+  unsigned int threads = (unsigned int) (uintptr_t) cls;
+  unsigned int i;
+
+  pool = GNUNET_CRYPTO_worker_pool_create (threads);
+  remaining = NUM_JOBS;
+  for (i = 0; i < NUM_JOBS; i++)
+  {
+    jobs[i].done = 0;
+    jobs[i].job = GNUNET_CRYPTO_worker_pool_submit (pool,
+                                                    &verify_job, &jobs[i],
+                                                    &job_done, &jobs[i]);
+  }
+  /* cancel a few jobs, wherever they are */
+  for (i = 1; i < NUM_JOBS; i += 7)
+  {
+    GNUNET_CRYPTO_worker_job_cancel (jobs[i].job);
+    jobs[i].job = NULL;
+    remaining--;
+  }
+}
+
+
+static int
+check_done ()
+{
+  unsigned int i;
+
+  for (i = 0; i < NUM_JOBS; i++)
+    if (jobs[i].done != ((1 == i % 7) ? 0 : 1))
+    {
+      FPRINTF (stderr, "Job %u completed %u times\n", i, jobs[i].done);
+      return 1;
+    }
+  return 0;
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  unsigned int i;
+  int failures;
+
+  GNUNET_log_setup ("test-crypto-workers", "WARNING", NULL);
+  key = GNUNET_CRYPTO_eddsa_key_create ();
+  GNUNET_CRYPTO_eddsa_key_get_public (key, &pkey);
+  for (i = 0; i < NUM_JOBS; i++)
+  {
+    jobs[i].purpose.purpose = htonl (GNUNET_SIGNATURE_PURPOSE_TEST);
+    jobs[i].purpose.size = htonl (sizeof (struct GNUNET_CRYPTO_EccSignaturePurpose));
+    GNUNET_assert (GNUNET_OK ==
+                   GNUNET_CRYPTO_eddsa_sign (key, &jobs[i].purpose, &jobs[i].sig));
+    if (0 == i % 4)
+      ((char *) &jobs[i].sig)[i % sizeof (jobs[i].sig)] ^= 1;
+  }
+  GNUNET_free (key);
+  failures = 0;
+  ok = 0;
+  GNUNET_SCHEDULER_run (&run, (void *) (uintptr_t) 1);
+  failures += ok + check_done ();
+  ok = 0;
+  GNUNET_SCHEDULER_run (&run, (void *) (uintptr_t) 4);
+  failures += ok + check_done ();
+  return (0 == failures) ? 0 : 1;
+}
+
+/* end of test_crypto_workers.c */
@@ -0,0 +1,324 @@
+/*
+     This file is part of GNUnet.
+     (C) 2014 Christian Grothoff (and other contributing authors)
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+     Boston, MA 02111-1307, USA.
+*/
+
+/**
+ * @file util/test_mq_client_shm.c
+ * @brief tests for mq with connection client passing messages through
+ *        a shared-memory ring: order across the switch from the socket
+ *        to the ring, deferred receive_done, and cancelling a message
+ *        while the doorbell is pending
+ */
+#include "platform.h"
+#include "gnunet_util_lib.h"
+
+#define MY_TYPE 128
+
+#define MY_TYPE_REPLY 129
+
+/**
+ * Number of messages in the first phase; more than fit into the
+ * ring at once.
+ */
+#define NUM_MSGS 20000
+
+/**
+ * The server defers #GNUNET_SERVER_receive_done for every
+ * DEFER_EVERY-th message.
+ */
+#define DEFER_EVERY 1000
+
+
+GNUNET_NETWORK_STRUCT_BEGIN
+
+struct SeqMessage
+{
+  struct GNUNET_MessageHeader header;
+
+  uint32_t seq GNUNET_PACKED;
+
+  char pad[120];
+};
+
+GNUNET_NETWORK_STRUCT_END
+
+
+static const char *unixpath = "/tmp/test-mq-client-shm.sock";
+
+static struct GNUNET_SERVER_Handle *server;
+
+static struct GNUNET_CLIENT_Connection *client;
+
+static struct GNUNET_CONFIGURATION_Handle *cfg;
+
+static struct GNUNET_MQ_Handle *client_mq;
+
+static struct GNUNET_MQ_Handle *server_mq;
+
+static GNUNET_SCHEDULER_TaskIdentifier die_task;
+
+static unsigned int expected;
+
+static int notify;
+
+static int ok;
+
+
+static void
+clean_up (void *cls,
+          const struct GNUNET_SCHEDULER_TaskContext *tc)
+{
+  die_task = GNUNET_SCHEDULER_NO_TASK;
+  if (NULL != client_mq)
+  {
+    GNUNET_MQ_destroy (client_mq);
+    client_mq = NULL;
+  }
+  if (NULL != server_mq)
+  {
+    GNUNET_MQ_destroy (server_mq);
+    server_mq = NULL;
+  }
+  if (NULL != client)
+  {
+    GNUNET_CLIENT_disconnect (client);
+    client = NULL;
+  }
+  GNUNET_SERVER_destroy (server);
+  server = NULL;
+  GNUNET_CONFIGURATION_destroy (cfg);
+  cfg = NULL;
+}
+
+
+static void
+finish (int result)
+{
+  ok = result;
+  GNUNET_SCHEDULER_cancel (die_task);
+  die_task = GNUNET_SCHEDULER_add_now (&clean_up, NULL);
+}
+
+
+static void
+send_seq (unsigned int seq,
+          GNUNET_MQ_NotifyCallback cb)
+{
+  struct GNUNET_MQ_Envelope *env;
+  struct SeqMessage *sm;
+
+  env = GNUNET_MQ_msg (sm, MY_TYPE);
+  sm->seq = htonl (seq);
+  if (NULL != cb)
+    GNUNET_MQ_notify_sent (env, cb, NULL);
+  GNUNET_MQ_send (client_mq, env);
+}
+
+
+/**
+ * The last message was sent; the test is done once the server got
+ * it as well.
+ */
+static void
+send_cb (void *cls)
+{
+  GNUNET_assert (GNUNET_NO == notify);
+  notify = GNUNET_YES;
+  if (NUM_MSGS + 2 == expected)
+    finish (0);
+}
+
+
+static void
+send_trap_cb (void *cls)
+{
+  GNUNET_abort ();
+}
+
+
+/**
+ * The server got all messages of the first phase.  The service is
+ * now asleep, so the next message needs a doorbell; cancel it while
+ * the doorbell is pending.  It is in the ring already, so it still
+ * arrives, just without a sent notification.
+ */
+static void
+client_reply_cb (void *cls,
+                 const struct GNUNET_MessageHeader *msg)
+{
+  struct GNUNET_MQ_Envelope *env;
+  struct SeqMessage *sm;
+
+  env = GNUNET_MQ_msg (sm, MY_TYPE);
+  sm->seq = htonl (NUM_MSGS);
+  GNUNET_MQ_notify_sent (env, &send_trap_cb, NULL);
+  GNUNET_MQ_send (client_mq, env);
+  GNUNET_MQ_send_cancel (env);
+  send_seq (NUM_MSGS + 1, &send_cb);
+}
+
+
+static void
+client_error_cb (void *cls,
+                 enum GNUNET_MQ_Error error)
+{
+  GNUNET_break (0);
+  finish (1);
+}
+
+
+static const struct GNUNET_MQ_MessageHandler mq_handlers[] = {
+  {&client_reply_cb, MY_TYPE_REPLY, sizeof (struct GNUNET_MessageHeader)},
+  GNUNET_MQ_HANDLERS_END
+};
+
+
+static void
+receive_done_later (void *cls,
+                    const struct GNUNET_SCHEDULER_TaskContext *tc)
+{
+  struct GNUNET_SERVER_Client *sc = cls;
+
+  GNUNET_SERVER_receive_done (sc, GNUNET_OK);
+  GNUNET_SERVER_client_drop (sc);
+}
+
+
+static void
+recv_cb (void *cls,
+         struct GNUNET_SERVER_Client *sc,
+         const struct GNUNET_MessageHeader *message)
+{
+  const struct SeqMessage *sm = (const struct SeqMessage *) message;
+  struct GNUNET_MQ_Envelope *env;
+  struct GNUNET_MessageHeader *reply;
+
+  if (expected != ntohl (sm->seq))
+  {
+    FPRINTF (stderr, "Expected message %u, got %u\n",
+             expected, ntohl (sm->seq));
+    GNUNET_SERVER_receive_done (sc, GNUNET_SYSERR);
+    finish (1);
+    return;
+  }
+  expected++;
+  if (NUM_MSGS + 2 == expected)
+  {
+    GNUNET_SERVER_receive_done (sc, GNUNET_OK);
+    if (GNUNET_YES == notify)
+      finish (0);
+    return;
+  }
+  if (NUM_MSGS == expected)
+  {
+    server_mq = GNUNET_MQ_queue_for_server_client (sc);
+    env = GNUNET_MQ_msg (reply, MY_TYPE_REPLY);
+    GNUNET_MQ_send (server_mq, env);
+  }
+  if ( (0 == expected % DEFER_EVERY) &&
+       (NUM_MSGS != expected) )
+  {
+    /* processing must stop until we are done */
+    GNUNET_SERVER_client_keep (sc);
+    GNUNET_SCHEDULER_add_delayed (GNUNET_TIME_UNIT_MILLISECONDS,
+                                  &receive_done_later, sc);
+    return;
+  }
+  GNUNET_SERVER_receive_done (sc, GNUNET_OK);
+}
+
+
+static struct GNUNET_SERVER_MessageHandler handlers[] = {
+  {&recv_cb, NULL, MY_TYPE, sizeof (struct SeqMessage)},
+  {NULL, NULL, 0, 0}
+};
+
+
+static void
+timeout_task (void *cls,
+              const struct GNUNET_SCHEDULER_TaskContext *tc)
+{
+  FPRINTF (stderr, "Timeout after %u messages\n", expected);
+  ok = 1;
+  clean_up (NULL, tc);
+}
+
+
+static void
+task (void *cls,
+      const struct GNUNET_SCHEDULER_TaskContext *tc)
+{
+  struct sockaddr_un un;
+  struct sockaddr *sap[2];
+  socklen_t slens[2];
+  unsigned int i;
+
+  memset (&un, 0, sizeof (un));
+  un.sun_family = AF_UNIX;
+  strncpy (un.sun_path, unixpath, sizeof (un.sun_path) - 1);
+#if HAVE_SOCKADDR_IN_SIN_LEN
+  un.sun_len = (u_char) sizeof (un);
+#endif
+  sap[0] = (struct sockaddr *) &un;
+  slens[0] = sizeof (un);
+  sap[1] = NULL;
+  slens[1] = 0;
+  server =
+      GNUNET_SERVER_create (NULL, NULL, sap, slens,
+                            GNUNET_TIME_UNIT_FOREVER_REL, GNUNET_NO);
+  GNUNET_assert (NULL != server);
+  GNUNET_SERVER_add_handlers (server, handlers);
+  GNUNET_SERVER_enable_shm_ring (server, GNUNET_YES);
+  cfg = GNUNET_CONFIGURATION_create ();
+  GNUNET_CONFIGURATION_set_value_string (cfg, "test", "UNIXPATH", unixpath);
+  GNUNET_CONFIGURATION_set_value_string (cfg, "test", "SHM_RING", "YES");
+  GNUNET_CONFIGURATION_set_value_string (cfg, "resolver", "HOSTNAME",
+                                         "localhost");
+  client = GNUNET_CLIENT_connect ("test", cfg);
+  GNUNET_assert (NULL != client);
+  client_mq = GNUNET_MQ_queue_for_connection_client (client, mq_handlers,
+                                                     &client_error_cb, NULL);
+  die_task = GNUNET_SCHEDULER_add_delayed (GNUNET_TIME_relative_multiply
+                                           (GNUNET_TIME_UNIT_SECONDS, 30),
+                                           &timeout_task, NULL);
+  /* the first messages leave over the socket together with the offer */
+  for (i = 0; i < NUM_MSGS; i++)
+    send_seq (i, NULL);
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  GNUNET_log_setup ("test-mq-client-shm",
+                    "WARNING",
+                    NULL);
+  if (GNUNET_YES != GNUNET_DISK_directory_test ("/dev/shm", GNUNET_YES))
+  {
+    FPRINTF (stderr, "%s", "No /dev/shm, skipping test\n");
+    return 77;
+  }
+  (void) UNLINK (unixpath);
+  ok = 1;
+  GNUNET_SCHEDULER_run (&task, NULL);
+  (void) UNLINK (unixpath);
+  return ok;
+}
+
+/* end of test_mq_client_shm.c */
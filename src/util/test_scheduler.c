@@ -230,12 +230,27 @@ checkCancel ()
 }
 
 
-int
-main (int argc, char *argv[])
+/**
+ * Run all checks with the given scheduler backend.
+ *
+ * @param backend name of the backend to use
+ * @return 0 on success
+ */
+static int
+check_backend (const char *backend)
 {
+  struct GNUNET_CONFIGURATION_Handle *cfg;
   int ret = 0;
 
-  GNUNET_log_setup ("test_scheduler", "WARNING", NULL);
+  cfg = GNUNET_CONFIGURATION_create ();
+  GNUNET_CONFIGURATION_set_value_string (cfg, "scheduler", "BACKEND",
+                                         backend);
+  if (GNUNET_OK != GNUNET_SCHEDULER_configure (cfg))
+  {
+    GNUNET_CONFIGURATION_destroy (cfg);
+    return 0;                   /* not supported, skip */
+  }
+  GNUNET_CONFIGURATION_destroy (cfg);
   ret += check ();
 #ifndef MINGW
   ret += checkSignal ();
@@ -243,7 +258,19 @@ main (int argc, char *argv[])
   ret += checkShutdown ();
   ret += checkCancel ();
   GNUNET_DISK_pipe_close (p);
+  p = NULL;
+  return ret;
+}
 
+
+int
+main (int argc, char *argv[])
+{
+  int ret = 0;
+
+  GNUNET_log_setup ("test_scheduler", "WARNING", NULL);
+  ret += check_backend ("select");
+  ret += check_backend ("epoll");
   return ret;
 }
 
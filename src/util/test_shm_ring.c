@@ -0,0 +1,239 @@
+/*
+     This file is part of GNUnet.
+     (C) 2014 Christian Grothoff (and other contributing authors)
+
+     GNUnet is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 3, or (at your
+     option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with GNUnet; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+     Boston, MA 02111-1307, USA.
+*/
+
+/**
+ * @file util/test_shm_ring.c
+ * @brief testcase for the shared-memory message ring
+ */
+#include "platform.h"
+#include "gnunet_util_lib.h"
+#include "shm_ring.h"
+
+#define RING_SIZE GNUNET_SERVER_MAX_MESSAGE_SIZE
+
+
+/**
+ * Fill a message of the given size with a pattern derived from
+ * @a seq.
+ *
+ * @param buf where to build the message
+ * @param size total size of the message
+ * @param seq sequence number
+ * @return the message
+ */
+static struct GNUNET_MessageHeader *
+make_msg (char *buf, uint16_t size, unsigned int seq)
+{
+  struct GNUNET_MessageHeader *msg = (struct GNUNET_MessageHeader *) buf;
+
+  memset (&msg[1], seq & 0xFF, size - sizeof (struct GNUNET_MessageHeader));
+  msg->size = htons (size);
+  msg->type = htons (seq & 0xFFFF);
+  return msg;
+}
+
+
+/**
+ * Check that a message read from the ring is the one we wrote.
+ *
+ * @param msg message read
+ * @param size expected size
+ * @param seq expected sequence number
+ * @return 0 if the message is right
+ */
+static int
+check_msg (const struct GNUNET_MessageHeader *msg, uint16_t size,
+           unsigned int seq)
+{
+  const char *payload = (const char *) &msg[1];
+  uint16_t i;
+
+  if ( (size != ntohs (msg->size)) ||
+       ((seq & 0xFFFF) != ntohs (msg->type)) )
+    return 1;
+  for (i = 0; i < size - sizeof (struct GNUNET_MessageHeader); i++)
+    if ((char) (seq & 0xFF) != payload[i])
+      return 1;
+  return 0;
+}
+
+
+/**
+ * Fill the ring until it is full, then drain it.
+ *
+ * @param prod producer end
+ * @param cons consumer end
+ * @return 0 on success
+ */
+static int
+test_fill (struct GNUNET_SHM_Ring *prod,
+           struct GNUNET_SHM_Ring *cons)
+{
+  const struct GNUNET_MessageHeader *msg;
+  char buf[1024];
+  unsigned int written;
+  unsigned int i;
+
+  if (GNUNET_NO != GNUNET_SHM_ring_read_ (cons, &msg))
+    return 1;
+  written = 0;
+  while (GNUNET_OK ==
+         GNUNET_SHM_ring_write_ (prod, make_msg (buf, 1000, written)))
+    written++;
+  /* 1000 bytes are padded to 1000, so exactly this many fit */
+  if (RING_SIZE / 1000 != written)
+    return 1;
+  for (i = 0; i < written; i++)
+    if ( (GNUNET_OK != GNUNET_SHM_ring_read_ (cons, &msg)) ||
+         (0 != check_msg (msg, 1000, i)) )
+      return 1;
+  if (GNUNET_NO != GNUNET_SHM_ring_read_ (cons, &msg))
+    return 1;
+  return 0;
+}
+
+
+/**
+ * Stream messages of odd sizes through the ring, so that they
+ * wrap around the end of the data area many times.
+ *
+ * @param prod producer end
+ * @param cons consumer end
+ * @return 0 on success
+ */
+static int
+test_wrap (struct GNUNET_SHM_Ring *prod,
+           struct GNUNET_SHM_Ring *cons)
+{
+  const struct GNUNET_MessageHeader *msg;
+  char buf[4096];
+  unsigned int wseq;
+  unsigned int rseq;
+
+  wseq = 0;
+  rseq = 0;
+  while (rseq < 10000)
+  {
+    while ( (wseq < 10000) &&
+            (GNUNET_OK ==
+             GNUNET_SHM_ring_write_ (prod,
+                                     make_msg (buf, 4 + (wseq * 37) % 4000,
+                                               wseq))) )
+      wseq++;
+    /* drain a few at a time to keep head and tail apart */
+    while (rseq < wseq)
+    {
+      if ( (GNUNET_OK != GNUNET_SHM_ring_read_ (cons, &msg)) ||
+           (0 != check_msg (msg, 4 + (rseq * 37) % 4000, rseq)) )
+        return 1;
+      if (0 == ++rseq % 7)
+        break;
+    }
+  }
+  return 0;
+}
+
+
+/**
+ * Check that exactly one wakeup is requested per sleep.
+ *
+ * @param prod producer end
+ * @param cons consumer end
+ * @return 0 on success
+ */
+static int
+test_wakeup (struct GNUNET_SHM_Ring *prod,
+             struct GNUNET_SHM_Ring *cons)
+{
+  const struct GNUNET_MessageHeader *msg;
+  char buf[64];
+
+  if (GNUNET_YES != GNUNET_SHM_ring_sleep_ (cons))
+    return 1;
+  if (GNUNET_OK != GNUNET_SHM_ring_write_ (prod, make_msg (buf, 64, 1)))
+    return 1;
+  if ( (GNUNET_YES != GNUNET_SHM_ring_wake_ (prod)) ||
+       (GNUNET_NO != GNUNET_SHM_ring_wake_ (prod)) )
+    return 1;
+  if (GNUNET_OK != GNUNET_SHM_ring_read_ (cons, &msg))
+    return 1;
+  /* message arrives while falling asleep */
+  if (GNUNET_OK != GNUNET_SHM_ring_write_ (prod, make_msg (buf, 64, 2)))
+    return 1;
+  if (GNUNET_NO != GNUNET_SHM_ring_sleep_ (cons))
+    return 1;
+  if ( (GNUNET_OK != GNUNET_SHM_ring_read_ (cons, &msg)) ||
+       (0 != check_msg (msg, 64, 2)) )
+    return 1;
+  if (GNUNET_YES != GNUNET_SHM_ring_sleep_ (cons))
+    return 1;
+  return 0;
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  struct GNUNET_SHM_Ring *prod;
+  struct GNUNET_SHM_Ring *cons;
+  char *fn;
+  int ret;
+
+  GNUNET_log_setup ("test-shm-ring", "WARNING", NULL);
+  prod = GNUNET_SHM_ring_create_ (RING_SIZE);
+  if (NULL == prod)
+  {
+    FPRINTF (stderr, "%s", "Failed to create ring, skipping test\n");
+    return 77;
+  }
+  GNUNET_asprintf (&fn, "/dev/shm/%s", GNUNET_SHM_ring_get_name_ (prod));
+  ret = 0;
+  /* only names of rings are accepted */
+  if ( (NULL != GNUNET_SHM_ring_attach_ ("../etc/passwd", getuid ())) ||
+       (NULL != GNUNET_SHM_ring_attach_ ("gnunet-shm-ring/../x", getuid ())) )
+    ret = 1;
+  /* the file must belong to the user at the other end */
+  if (NULL != GNUNET_SHM_ring_attach_ (GNUNET_SHM_ring_get_name_ (prod),
+                                       getuid () + 1))
+    ret = 1;
+  cons = GNUNET_SHM_ring_attach_ (GNUNET_SHM_ring_get_name_ (prod), getuid ());
+  GNUNET_assert (NULL != cons);
+  /* the producer removes the file once the consumer is attached */
+  GNUNET_SHM_ring_unlink_attached_ (prod);
+  if (GNUNET_YES == GNUNET_DISK_file_test (fn))
+    ret = 1;
+  GNUNET_free (fn);
+  /* a fresh ring needs a wakeup for the first message */
+  if (GNUNET_YES != GNUNET_SHM_ring_wake_ (prod))
+    ret = 1;
+  if (0 == ret)
+    ret = test_fill (prod, cons);
+  if (0 == ret)
+    ret = test_wrap (prod, cons);
+  if (0 == ret)
+    ret = test_wakeup (prod, cons);
+  GNUNET_SHM_ring_destroy_ (cons);
+  GNUNET_SHM_ring_destroy_ (prod);
+  if (0 != ret)
+    FPRINTF (stderr, "%s", "Shared-memory ring test failed\n");
+  return ret;
+}
+
+/* end of test_shm_ring.c */